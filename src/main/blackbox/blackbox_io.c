@@ -170,7 +170,6 @@ void blackboxPrintfHeaderLine(const char *fmt, ...)
 int blackboxPrint(const char *s)
 {
     int length;
-    const uint8_t *pos;
 
     switch (masterConfig.blackbox_device) {
 
@@ -190,13 +189,8 @@ int blackboxPrint(const char *s)
 
         case BLACKBOX_DEVICE_SERIAL:
         default:
-            pos = (uint8_t*) s;
-            while (*pos) {
-                serialWrite(blackboxPort, *pos);
-                pos++;
-            }
-
-            length = pos - (uint8_t*) s;
+            length = strlen(s);
+            serialWriteBuf(blackboxPort, (uint8_t*) s, length);
         break;
     }
 
@@ -715,11 +709,12 @@ static void blackboxCreateLogFile()
 }
 
 /**
- * Begin a new log on the SDCard.
+ * Open the log directory on the SDCard (creating it if needed), find the highest log number in use and make it the
+ * working directory.
  *
- * Keep calling until the function returns true (open is complete).
+ * Keep calling until the function returns true (the log directory is the working directory).
  */
-static bool blackboxSDCardBeginLog()
+bool blackboxSDCardChangeIntoLogDirectory(void)
 {
     fatDirectoryEntry_t *directoryEntry;
 
@@ -774,12 +769,35 @@ static bool blackboxSDCardBeginLog()
             }
             break;
 
+        case BLACKBOX_SDCARD_READY_TO_CREATE_LOG:
+        case BLACKBOX_SDCARD_READY_TO_LOG:
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Begin a new log on the SDCard.
+ *
+ * Keep calling until the function returns true (open is complete).
+ */
+static bool blackboxSDCardBeginLog()
+{
+    if (!blackboxSDCardChangeIntoLogDirectory()) {
+        return false;
+    }
+
+    switch (blackboxSDCard.state) {
         case BLACKBOX_SDCARD_READY_TO_CREATE_LOG:
             blackboxCreateLogFile();
             break;
 
         case BLACKBOX_SDCARD_READY_TO_LOG:
             return true; // Log has been created!
+
+        default:
+            ;
     }
 
     // Not finished init yet
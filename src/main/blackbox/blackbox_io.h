@@ -80,6 +80,10 @@ void blackboxDeviceClose(void);
 bool blackboxDeviceBeginLog(void);
 bool blackboxDeviceEndLog(bool retainLog);
 
+#ifdef USE_SDCARD
+bool blackboxSDCardChangeIntoLogDirectory(void);
+#endif
+
 bool isBlackboxDeviceFull(void);
 
 void blackboxReplenishHeaderBudget();
@@ -0,0 +1,470 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lists and reads back the Blackbox logs on the SD card, so they can be downloaded over MSP without removing the card.
+ *
+ * MSP requests never wait on the card. They start an operation and report BUSY, and the host asks again later. The
+ * work is done by blackboxLogReaderPoll() from a low priority scheduler task, a little at a time and only from the
+ * filesystem cache, so the craft stays responsive. The reader gives up whenever the craft is armed or logging.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#if defined(BLACKBOX) && defined(USE_SDCARD)
+
+#include "blackbox/blackbox.h"
+#include "blackbox/blackbox_io.h"
+#include "blackbox/blackbox_log_reader.h"
+
+#include "fc/runtime_config.h"
+
+#include "io/asyncfatfs/asyncfatfs.h"
+
+// "LOG00001.TXT" and a null terminator
+#define BLACKBOX_LOG_READER_FILENAME_LENGTH (FAT_FILENAME_LENGTH + 2)
+
+typedef enum {
+    LOG_LIST_IDLE,
+    LOG_LIST_BEGIN,             // Waiting to open the log directory
+    LOG_LIST_OPENING,
+    LOG_LIST_SEARCHING,
+    LOG_LIST_CLOSING,           // Waiting to close the log directory
+    LOG_LIST_DONE,
+    LOG_LIST_FAILED,
+} logListState_e;
+
+typedef enum {
+    LOG_FILE_CLOSED,
+    LOG_FILE_OPEN_PENDING,      // Waiting to begin opening the log
+    LOG_FILE_OPENING,
+    LOG_FILE_OPEN,
+    LOG_FILE_FAILED,
+} logFileState_e;
+
+static struct {
+    logListState_e state;
+    bool failed;
+
+    afatfsFilePtr_t directory;
+    afatfsFinder_t finder;
+
+    uint16_t startIndex;
+    uint16_t logIndex;
+
+    uint8_t count;
+    bool more;
+    blackboxLogReaderEntry_t entries[BLACKBOX_LOG_READER_LIST_PAGE_SIZE];
+} logList;
+
+static struct {
+    logFileState_e state;
+    char filename[BLACKBOX_LOG_READER_FILENAME_LENGTH];
+
+    afatfsFilePtr_t file;
+    afatfsFilePtr_t closingFile; // A log we're done with, which couldn't be closed yet
+
+    bool seekPending;
+    uint32_t seekOffset;
+
+    // The buffer holds the file contents starting from bufferOffset
+    uint32_t bufferOffset;
+    uint16_t bufferFill;
+    uint8_t buffer[BLACKBOX_LOG_READER_BUFFER_SIZE];
+} logFile;
+
+static bool blackboxLogReaderMayRun(void)
+{
+    return !ARMING_FLAG(ARMED) && blackboxMayEditConfig() && afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_READY;
+}
+
+static bool blackboxLogReaderIsLogFile(fatDirectoryEntry_t *entry)
+{
+    return !fat_isDirectoryEntryEmpty(entry)
+        && (entry->attrib & (FAT_FILE_ATTRIBUTE_DIRECTORY | FAT_FILE_ATTRIBUTE_VOLUME_ID)) == 0
+        && memcmp(entry->filename, "LOG", 3) == 0 && memcmp(entry->filename + 8, "TXT", 3) == 0;
+}
+
+static void blackboxLogReaderDirectoryOpened(afatfsFilePtr_t directory)
+{
+    if (!directory) {
+        logList.state = LOG_LIST_FAILED;
+    } else if (!blackboxLogReaderMayRun()) {
+        // We were abandoned while we were waiting
+        logList.directory = directory;
+        logList.failed = true;
+        logList.state = LOG_LIST_CLOSING;
+    } else {
+        logList.directory = directory;
+
+        afatfs_findFirst(directory, &logList.finder);
+
+        logList.state = LOG_LIST_SEARCHING;
+    }
+}
+
+static void blackboxLogReaderFileOpened(afatfsFilePtr_t file)
+{
+    if (file && !blackboxLogReaderMayRun()) {
+        logFile.closingFile = file;
+        logFile.state = LOG_FILE_FAILED;
+    } else if (file) {
+        logFile.file = file;
+        logFile.bufferOffset = 0;
+        logFile.bufferFill = 0;
+        logFile.seekPending = false;
+
+        logFile.state = LOG_FILE_OPEN;
+    } else {
+        logFile.state = LOG_FILE_FAILED;
+    }
+}
+
+static void blackboxLogReaderListContinue(void)
+{
+    fatDirectoryEntry_t *entry;
+    bool finished = false;
+
+    while (afatfs_findNext(logList.directory, &logList.finder, &entry) == AFATFS_OPERATION_SUCCESS) {
+        if (!entry || fat_isDirectoryEntryTerminator(entry)) {
+            finished = true;
+            break;
+        }
+
+        if (blackboxLogReaderIsLogFile(entry)) {
+            if (logList.logIndex >= logList.startIndex) {
+                if (logList.count == BLACKBOX_LOG_READER_LIST_PAGE_SIZE) {
+                    logList.more = true;
+                    finished = true;
+                    break;
+                }
+
+                memcpy(logList.entries[logList.count].filename, entry->filename, FAT_FILENAME_LENGTH);
+                logList.entries[logList.count].size = entry->fileSize;
+                logList.count++;
+            }
+
+            logList.logIndex++;
+        }
+    }
+
+    if (finished) {
+        afatfs_findLast(logList.directory);
+
+        logList.failed = false;
+        logList.state = LOG_LIST_CLOSING;
+    }
+}
+
+/**
+ * Top up the read-ahead buffer from the filesystem cache, without waiting for the card.
+ */
+static void blackboxLogReaderFill(void)
+{
+    if (logFile.seekPending) {
+        // Once the seek is queued, reads fail until it completes
+        if (afatfs_fseek(logFile.file, logFile.seekOffset, AFATFS_SEEK_SET) == AFATFS_OPERATION_FAILURE) {
+            return;
+        }
+
+        logFile.bufferOffset = logFile.seekOffset;
+        logFile.bufferFill = 0;
+        logFile.seekPending = false;
+    }
+
+    while (logFile.bufferFill < BLACKBOX_LOG_READER_BUFFER_SIZE) {
+        uint32_t bytesRead = afatfs_fread(logFile.file, logFile.buffer + logFile.bufferFill, BLACKBOX_LOG_READER_BUFFER_SIZE - logFile.bufferFill);
+
+        if (bytesRead == 0) {
+            break;
+        }
+
+        logFile.bufferFill += bytesRead;
+    }
+}
+
+/**
+ * Abandon whatever the host asked for, because the craft is about to fly or the card has gone away.
+ */
+static void blackboxLogReaderAbort(void)
+{
+    switch (logList.state) {
+        case LOG_LIST_BEGIN:
+            logList.state = LOG_LIST_FAILED;
+        break;
+        case LOG_LIST_SEARCHING:
+            afatfs_findLast(logList.directory);
+
+            logList.failed = true;
+            logList.state = LOG_LIST_CLOSING;
+        break;
+        default:
+            ;
+    }
+
+    switch (logFile.state) {
+        case LOG_FILE_OPEN:
+            if (!logFile.closingFile) {
+                logFile.closingFile = logFile.file;
+            }
+            // Fall through
+        case LOG_FILE_OPEN_PENDING:
+            logFile.file = NULL;
+            logFile.state = LOG_FILE_FAILED;
+            // Let the host open the same log again once we're disarmed
+            logFile.filename[0] = '\0';
+        break;
+        default:
+            ;
+    }
+}
+
+/**
+ * Call periodically to make progress on the host's requests.
+ */
+void blackboxLogReaderPoll(void)
+{
+    // Release handles we've finished with first, Blackbox will need them
+    if (logFile.closingFile && afatfs_fclose(logFile.closingFile, NULL)) {
+        logFile.closingFile = NULL;
+    }
+
+    if (logList.state == LOG_LIST_CLOSING && afatfs_fclose(logList.directory, NULL)) {
+        logList.directory = NULL;
+        logList.state = logList.failed ? LOG_LIST_FAILED : LOG_LIST_DONE;
+    }
+
+    if (!blackboxLogReaderMayRun()) {
+        blackboxLogReaderAbort();
+        return;
+    }
+
+    if (logList.state == LOG_LIST_BEGIN || logFile.state == LOG_FILE_OPEN_PENDING) {
+        // Logs are opened by name from the log directory
+        if (!blackboxSDCardChangeIntoLogDirectory()) {
+            return;
+        }
+    }
+
+    switch (logList.state) {
+        case LOG_LIST_BEGIN:
+            logList.state = LOG_LIST_OPENING;
+
+            if (!afatfs_fopen(".", "r", blackboxLogReaderDirectoryOpened)) {
+                logList.state = LOG_LIST_FAILED;
+            }
+        break;
+        case LOG_LIST_SEARCHING:
+            blackboxLogReaderListContinue();
+        break;
+        default:
+            ;
+    }
+
+    switch (logFile.state) {
+        case LOG_FILE_OPEN_PENDING:
+            // Wait for the previous log to be closed so we don't run out of file handles
+            if (!logFile.closingFile) {
+                logFile.state = LOG_FILE_OPENING;
+
+                if (!afatfs_fopen(logFile.filename, "r", blackboxLogReaderFileOpened)) {
+                    logFile.state = LOG_FILE_FAILED;
+                }
+            }
+        break;
+        case LOG_FILE_OPEN:
+            blackboxLogReaderFill();
+        break;
+        default:
+            ;
+    }
+}
+
+/**
+ * Get a page of the list of logs on the card, starting from the log with the given index (the first log has index 0).
+ *
+ * If the page isn't ready yet, BUSY is returned and the listing is started in the background, call again with the same
+ * startIndex later to collect it. `more` is set if there are logs after this page.
+ */
+blackboxLogReaderStatus_e blackboxLogReaderList(uint16_t startIndex, const blackboxLogReaderEntry_t **entries, uint8_t *count, bool *more)
+{
+    if (!blackboxLogReaderMayRun()) {
+        return BLACKBOX_LOG_READER_FAILED;
+    }
+
+    switch (logList.state) {
+        case LOG_LIST_DONE:
+            if (logList.startIndex == startIndex) {
+                *entries = logList.entries;
+                *count = logList.count;
+                *more = logList.more;
+
+                return BLACKBOX_LOG_READER_READY;
+            }
+        break;
+        case LOG_LIST_IDLE:
+        case LOG_LIST_FAILED:
+        break;
+        default:
+            // Still busy listing (maybe a different page, it'll be restarted once that finishes)
+            return BLACKBOX_LOG_READER_BUSY;
+    }
+
+    logList.startIndex = startIndex;
+    logList.logIndex = 0;
+    logList.count = 0;
+    logList.more = false;
+    logList.state = LOG_LIST_BEGIN;
+
+    return BLACKBOX_LOG_READER_BUSY;
+}
+
+/**
+ * Begin opening the log with the given name from the log directory for reading, closing any log that's already open.
+ *
+ * The name is given as it's stored on disk (FAT_FILENAME_LENGTH bytes, e.g. "LOG00001TXT").
+ *
+ * Returns READY if that log is already open, otherwise BUSY while it's opened in the background.
+ */
+blackboxLogReaderStatus_e blackboxLogReaderOpen(const char *filename)
+{
+    char name[BLACKBOX_LOG_READER_FILENAME_LENGTH];
+    int nameLength = 0;
+
+    if (!blackboxLogReaderMayRun()) {
+        return BLACKBOX_LOG_READER_FAILED;
+    }
+
+    // Convert to "NAME.EXT" for afatfs_fopen()
+    for (int i = 0; i < 8 && filename[i] != ' '; i++) {
+        name[nameLength++] = filename[i];
+    }
+    name[nameLength++] = '.';
+    for (int i = 8; i < FAT_FILENAME_LENGTH && filename[i] != ' '; i++) {
+        name[nameLength++] = filename[i];
+    }
+    name[nameLength] = '\0';
+
+    if (strcmp(name, logFile.filename) == 0) {
+        switch (logFile.state) {
+            case LOG_FILE_OPEN:
+                return BLACKBOX_LOG_READER_READY;
+            case LOG_FILE_OPEN_PENDING:
+            case LOG_FILE_OPENING:
+                return BLACKBOX_LOG_READER_BUSY;
+            case LOG_FILE_FAILED:
+                // Report the failure once, asking again will retry
+                logFile.state = LOG_FILE_CLOSED;
+                return BLACKBOX_LOG_READER_FAILED;
+            default:
+                ;
+        }
+    }
+
+    if (logFile.state == LOG_FILE_OPENING) {
+        // Can't cancel an open, so the host will have to try again
+        return BLACKBOX_LOG_READER_BUSY;
+    }
+
+    blackboxLogReaderClose();
+
+    memcpy(logFile.filename, name, sizeof(name));
+    logFile.state = LOG_FILE_OPEN_PENDING;
+
+    return BLACKBOX_LOG_READER_BUSY;
+}
+
+/**
+ * Close the open log, if any.
+ */
+void blackboxLogReaderClose(void)
+{
+    if (logFile.state == LOG_FILE_OPEN && !logFile.closingFile) {
+        logFile.closingFile = logFile.file;
+        logFile.file = NULL;
+    }
+
+    if (logFile.state != LOG_FILE_OPENING) {
+        logFile.state = LOG_FILE_CLOSED;
+        logFile.filename[0] = '\0';
+    }
+}
+
+/**
+ * Read from the open log, starting at the given offset. On success, `data` and `length` are set to the data available
+ * from that offset (which may be less than the host asked for). Returns READY with zero length at the end of the log.
+ *
+ * Asking for a given offset tells us the host is done with the data before it, so reading sequentially keeps the
+ * buffer full. Any other offset causes a seek, and BUSY is returned until data from there is available.
+ */
+blackboxLogReaderStatus_e blackboxLogReaderRead(uint32_t offset, const uint8_t **data, uint16_t *length, uint32_t *fileSize)
+{
+    *length = 0;
+    *fileSize = 0;
+
+    if (!blackboxLogReaderMayRun()) {
+        return BLACKBOX_LOG_READER_FAILED;
+    }
+
+    switch (logFile.state) {
+        case LOG_FILE_OPEN:
+        break;
+        case LOG_FILE_OPEN_PENDING:
+        case LOG_FILE_OPENING:
+            return BLACKBOX_LOG_READER_BUSY;
+        default:
+            return BLACKBOX_LOG_READER_FAILED;
+    }
+
+    *fileSize = afatfs_fileSize(logFile.file);
+    *data = logFile.buffer;
+
+    if (offset >= *fileSize) {
+        return BLACKBOX_LOG_READER_READY;
+    }
+
+    if (!logFile.seekPending && offset >= logFile.bufferOffset && offset <= logFile.bufferOffset + logFile.bufferFill) {
+        uint16_t consumed = offset - logFile.bufferOffset;
+
+        if (consumed > 0) {
+            memmove(logFile.buffer, logFile.buffer + consumed, logFile.bufferFill - consumed);
+
+            logFile.bufferFill -= consumed;
+            logFile.bufferOffset = offset;
+        }
+
+        if (logFile.bufferFill == 0) {
+            return BLACKBOX_LOG_READER_BUSY;
+        }
+
+        *length = logFile.bufferFill;
+
+        return BLACKBOX_LOG_READER_READY;
+    }
+
+    logFile.seekPending = true;
+    logFile.seekOffset = offset;
+    logFile.bufferFill = 0;
+
+    return BLACKBOX_LOG_READER_BUSY;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "io/asyncfatfs/fat_standard.h"
+
+// How many logs are listed per request
+#define BLACKBOX_LOG_READER_LIST_PAGE_SIZE  8
+
+// How much of the open log is read ahead of the host's requests
+#define BLACKBOX_LOG_READER_BUFFER_SIZE     2048
+
+typedef enum {
+    BLACKBOX_LOG_READER_BUSY = 0,   // The request is being worked on, ask again later
+    BLACKBOX_LOG_READER_READY = 1,
+    BLACKBOX_LOG_READER_FAILED = 2, // No card, the craft is armed, or the log couldn't be opened
+} blackboxLogReaderStatus_e;
+
+typedef struct blackboxLogReaderEntry_s {
+    char filename[FAT_FILENAME_LENGTH]; // As stored on disk, e.g. "LOG00001TXT"
+    uint32_t size;
+} blackboxLogReaderEntry_t;
+
+blackboxLogReaderStatus_e blackboxLogReaderList(uint16_t startIndex, const blackboxLogReaderEntry_t **entries, uint8_t *count, bool *more);
+
+blackboxLogReaderStatus_e blackboxLogReaderOpen(const char *filename);
+void blackboxLogReaderClose(void);
+blackboxLogReaderStatus_e blackboxLogReaderRead(uint32_t offset, const uint8_t **data, uint16_t *length, uint32_t *fileSize);
+
+void blackboxLogReaderPoll(void);
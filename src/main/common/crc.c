@@ -0,0 +1,73 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "crc.h"
+
+/**
+ * CRC-8 with polynomial 0xD5, as used by DVB-S2. Start from a crc of zero.
+ */
+uint8_t crc8DvbS2(uint8_t crc, uint8_t a)
+{
+    crc ^= a;
+
+    for (int i = 0; i < 8; i++) {
+        if (crc & 0x80) {
+            crc = (crc << 1) ^ 0xD5;
+        } else {
+            crc = crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+uint8_t crc8DvbS2Update(uint8_t crc, const void *data, uint32_t length)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *pend = p + length;
+
+    for (; p != pend; p++) {
+        crc = crc8DvbS2(crc, *p);
+    }
+
+    return crc;
+}
+
+/**
+ * CRC-16/MCRF4XX, polynomial 0x1021 reflected, as used by MAVLink. Start from a crc of 0xFFFF.
+ */
+uint16_t crc16Mcrf4xx(uint16_t crc, uint8_t a)
+{
+    uint8_t tmp = a ^ (uint8_t)crc;
+    tmp ^= tmp << 4;
+
+    return (crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4);
+}
+
+uint16_t crc16Mcrf4xxUpdate(uint16_t crc, const void *data, uint32_t length)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *pend = p + length;
+
+    for (; p != pend; p++) {
+        crc = crc16Mcrf4xx(crc, *p);
+    }
+
+    return crc;
+}
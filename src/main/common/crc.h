@@ -0,0 +1,25 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+uint8_t crc8DvbS2(uint8_t crc, uint8_t a);
+uint8_t crc8DvbS2Update(uint8_t crc, const void *data, uint32_t length);
+uint16_t crc16Mcrf4xx(uint16_t crc, uint8_t a);
+uint16_t crc16Mcrf4xxUpdate(uint16_t crc, const void *data, uint32_t length);
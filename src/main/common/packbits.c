@@ -0,0 +1,159 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * PackBits run-length encoding, as used by TIFF and MacPaint.
+ *
+ * The encoded stream is a series of packets, each starting with a header byte n:
+ *
+ *   0...127   n + 1 literal bytes follow
+ *   129...255 the following byte is repeated 257 - n times
+ *   128       no operation
+ *
+ * It is cheap enough to run on the flight controller while streaming, needs no tables, and at worst expands the
+ * input by one byte in every 128. Blackbox logs compress mostly thanks to runs of zeros and of erased (0xFF) flash.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "packbits.h"
+
+// Shorter runs than this are cheaper to store as part of a literal packet
+#define PACKBITS_MIN_RUN 3
+
+static void packbitsOutput(packbitsEncoder_t *encoder, uint8_t data)
+{
+    if (encoder->writer) {
+        encoder->writer(encoder->arg, data);
+    }
+    encoder->encodedSize++;
+}
+
+static void packbitsFlushLiterals(packbitsEncoder_t *encoder)
+{
+    if (encoder->literalCount > 0) {
+        packbitsOutput(encoder, encoder->literalCount - 1);
+
+        for (int i = 0; i < encoder->literalCount; i++) {
+            packbitsOutput(encoder, encoder->literals[i]);
+        }
+
+        encoder->literalCount = 0;
+    }
+}
+
+static void packbitsFlushRun(packbitsEncoder_t *encoder)
+{
+    if (encoder->runLength >= PACKBITS_MIN_RUN) {
+        packbitsFlushLiterals(encoder);
+
+        packbitsOutput(encoder, (uint8_t) (257 - encoder->runLength));
+        packbitsOutput(encoder, encoder->runByte);
+    } else {
+        for (int i = 0; i < encoder->runLength; i++) {
+            encoder->literals[encoder->literalCount++] = encoder->runByte;
+
+            if (encoder->literalCount == PACKBITS_MAX_LITERALS) {
+                packbitsFlushLiterals(encoder);
+            }
+        }
+    }
+
+    encoder->runLength = 0;
+}
+
+/**
+ * Prepare to encode a new stream. Encoded bytes are passed to `writer` as they become available, pass NULL instead
+ * to only count them.
+ */
+void packbitsEncoderInit(packbitsEncoder_t *encoder, packbitsWrite_t writer, void *arg)
+{
+    memset(encoder, 0, sizeof(*encoder));
+
+    encoder->writer = writer;
+    encoder->arg = arg;
+}
+
+/**
+ * Add bytes to the stream. The input can be supplied in pieces of any size, the output is the same as if it had been
+ * supplied in one go.
+ */
+void packbitsEncode(packbitsEncoder_t *encoder, const uint8_t *data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (encoder->runLength > 0 && data[i] == encoder->runByte && encoder->runLength < PACKBITS_MAX_RUN) {
+            encoder->runLength++;
+        } else {
+            packbitsFlushRun(encoder);
+
+            encoder->runByte = data[i];
+            encoder->runLength = 1;
+        }
+    }
+}
+
+/**
+ * Write out any buffered input, completing the stream.
+ *
+ * Returns the total size of the encoded stream.
+ */
+uint32_t packbitsEncoderFinish(packbitsEncoder_t *encoder)
+{
+    packbitsFlushRun(encoder);
+    packbitsFlushLiterals(encoder);
+
+    return encoder->encodedSize;
+}
+
+/**
+ * Decode a complete PackBits stream into `output`.
+ *
+ * Returns the number of bytes decoded, or -1 if the stream is truncated or doesn't fit in the output buffer.
+ */
+int packbitsDecode(const uint8_t *data, int len, uint8_t *output, int outputSize)
+{
+    int outputIndex = 0;
+    int i = 0;
+
+    while (i < len) {
+        uint8_t header = data[i++];
+
+        if (header < 128) {
+            int count = header + 1;
+
+            if (i + count > len || outputIndex + count > outputSize) {
+                return -1;
+            }
+
+            memcpy(output + outputIndex, data + i, count);
+            i += count;
+            outputIndex += count;
+        } else if (header > 128) {
+            int count = 257 - header;
+
+            if (i >= len || outputIndex + count > outputSize) {
+                return -1;
+            }
+
+            memset(output + outputIndex, data[i++], count);
+            outputIndex += count;
+        }
+    }
+
+    return outputIndex;
+}
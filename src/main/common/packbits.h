@@ -0,0 +1,45 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PACKBITS_MAX_LITERALS 128
+#define PACKBITS_MAX_RUN      128
+
+// Called for each byte of encoded output, may be NULL to only measure the encoded size.
+typedef void (*packbitsWrite_t)(void *arg, uint8_t data);
+
+typedef struct packbitsEncoder_s {
+    packbitsWrite_t writer;
+    void *arg;
+
+    uint32_t encodedSize;
+
+    uint8_t runByte;
+    uint8_t runLength;
+
+    uint8_t literalCount;
+    uint8_t literals[PACKBITS_MAX_LITERALS];
+} packbitsEncoder_t;
+
+void packbitsEncoderInit(packbitsEncoder_t *encoder, packbitsWrite_t writer, void *arg);
+void packbitsEncode(packbitsEncoder_t *encoder, const uint8_t *data, int len);
+uint32_t packbitsEncoderFinish(packbitsEncoder_t *encoder);
+
+int packbitsDecode(const uint8_t *data, int len, uint8_t *output, int outputSize);
@@ -174,7 +174,7 @@ static uint32_t activeFeaturesLatch = 0;
 static uint8_t currentControlRateProfileIndex = 0;
 controlRateConfig_t *currentControlRateProfile;
 
-static const uint8_t EEPROM_CONF_VERSION = 143;
+static const uint8_t EEPROM_CONF_VERSION = 145;
 
 static void resetAccelerometerTrims(flightDynamicsTrims_t *accelerometerTrims)
 {
@@ -584,6 +584,7 @@ void createDefaultConfig(master_t *config)
     config->gpsConfig.sbasMode = SBAS_AUTO;
     config->gpsConfig.autoConfig = GPS_AUTOCONFIG_ON;
     config->gpsConfig.autoBaud = GPS_AUTOBAUD_OFF;
+    config->gpsConfig.ubloxNavPvt = GPS_NAV_PVT_OFF;
 #endif
 
     resetSerialConfig(&config->serialConfig);
@@ -685,6 +686,11 @@ void createDefaultConfig(master_t *config)
     config->blackbox_rate_denom = 1;
 #endif // BLACKBOX
 
+#ifdef USE_FLASHFS
+    config->flashfs_erase_ahead_sectors = 0;
+    config->flashfs_wrap = 0;
+#endif
+
 #ifdef SERIALRX_UART
     if (featureConfigured(FEATURE_RX_SERIAL)) {
         config->serialConfig.portConfigs[SERIALRX_UART].functionMask = FUNCTION_RX_SERIAL;
@@ -161,6 +161,11 @@ typedef struct master_t {
     uint8_t blackbox_device;
 #endif
 
+#ifdef USE_FLASHFS
+    uint8_t flashfs_erase_ahead_sectors;    // Sectors to keep erased ahead of the write pointer, 0 to disable rolling mode
+    uint8_t flashfs_wrap;                   // In rolling mode, overwrite the oldest data when the flash is full
+#endif
+
     uint32_t beeper_off_flags;
     uint32_t preferred_beeper_off_flags;
 
@@ -36,7 +36,6 @@
 
 #include "common/color.h"
 #include "common/colorconversion.h"
-#include "dma.h"
 #include "light_ws2811strip.h"
 
 uint8_t ledStripDMABuffer[WS2811_DMA_BUFFER_SIZE];
@@ -44,9 +43,22 @@ volatile uint8_t ws2811LedDataTransferInProgress = 0;
 
 static hsvColor_t ledColorBuffer[WS2811_LED_STRIP_LENGTH];
 
+// Colors already in ledStripDMABuffer, and which LEDs may have changed since
+static rgbColor24bpp_t ledRgbBuffer[WS2811_LED_STRIP_LENGTH];
+static uint32_t ledDirty[(WS2811_LED_STRIP_LENGTH + 31) / 32];
+static bool ledStripResendPending;
+
+static void markLedDirty(uint16_t index)
+{
+    ledDirty[index / 32] |= 1U << (index % 32);
+}
+
 void setLedHsv(uint16_t index, const hsvColor_t *color)
 {
-    ledColorBuffer[index] = *color;
+    if (memcmp(&ledColorBuffer[index], color, sizeof(*color))) {
+        ledColorBuffer[index] = *color;
+        markLedDirty(index);
+    }
 }
 
 void getLedHsv(uint16_t index, hsvColor_t *color)
@@ -56,12 +68,15 @@ void getLedHsv(uint16_t index, hsvColor_t *color)
 
 void setLedValue(uint16_t index, const uint8_t value)
 {
-    ledColorBuffer[index].v = value;
+    if (ledColorBuffer[index].v != value) {
+        ledColorBuffer[index].v = value;
+        markLedDirty(index);
+    }
 }
 
 void scaleLedValue(uint16_t index, const uint8_t scalePercent)
 {
-    ledColorBuffer[index].v = ((uint16_t)ledColorBuffer[index].v * scalePercent / 100);
+    setLedValue(index, ((uint16_t)ledColorBuffer[index].v * scalePercent / 100));
 }
 
 void setStripColor(const hsvColor_t *color)
@@ -82,9 +97,23 @@ void setStripColors(const hsvColor_t *colors)
 
 void ws2811LedStripInit(void)
 {
-    memset(&ledStripDMABuffer, 0, WS2811_DMA_BUFFER_SIZE);
+    // start with every LED black, matching the zeroed color buffers
+    memset(&ledStripDMABuffer, BIT_COMPARE_0, WS2811_DATA_BUFFER_SIZE);
+    memset(&ledStripDMABuffer[WS2811_DATA_BUFFER_SIZE], 0, WS2811_DELAY_BUFFER_LENGTH);
+    memset(&ledColorBuffer, 0, sizeof(ledColorBuffer));
+    memset(&ledRgbBuffer, 0, sizeof(ledRgbBuffer));
+    memset(&ledDirty, 0, sizeof(ledDirty));
+    ledStripResendPending = false;
+
     ws2811LedStripHardwareInit();
-    ws2811UpdateStrip();
+    ws2811LedDataTransferInProgress = 1;
+    ws2811LedStripDMAEnable();
+}
+
+// Send the whole strip with the next update even if no LED changed, in case LEDs were powered up late or upset by noise
+void ws2811ResendStrip(void)
+{
+    ledStripResendPending = true;
 }
 
 bool isWS2811LedStripReady(void)
@@ -129,25 +158,36 @@ STATIC_UNIT_TESTED void updateLEDDMABuffer(uint8_t componentValue)
 /*
  * This method is non-blocking unless an existing LED update is in progress.
  * it does not wait until all the LEDs have been updated, that happens in the background.
+ *
+ * Only the LEDs whose color changed are converted and rewritten in the DMA buffer, and nothing is sent when none did,
+ * unless ws2811ResendStrip() has asked for the strip to be sent again.
  */
 void ws2811UpdateStrip(void)
 {
     static rgbColor24bpp_t *rgb24;
+    bool changed = false;
 
     // don't wait - risk of infinite block, just get an update next time round
     if (ws2811LedDataTransferInProgress) {
         return;
     }
 
-    dmaBufferOffset = 0;                // reset buffer memory index
-    ledIndex = 0;                       // reset led index
-
     // fill transmit buffer with correct compare values to achieve
     // correct pulse widths according to color values
-    while (ledIndex < WS2811_LED_STRIP_LENGTH)
+    for (ledIndex = 0; ledIndex < WS2811_LED_STRIP_LENGTH; ledIndex++)
     {
+        if (!(ledDirty[ledIndex / 32] & (1U << (ledIndex % 32)))) {
+            continue;
+        }
+
         rgb24 = hsvToRgb24(&ledColorBuffer[ledIndex]);
+        if (memcmp(&ledRgbBuffer[ledIndex], rgb24, sizeof(*rgb24)) == 0) {
+            continue;
+        }
+        ledRgbBuffer[ledIndex] = *rgb24;
+        changed = true;
 
+        dmaBufferOffset = ledIndex * WS2811_BITS_PER_LED;
 #ifdef USE_FAST_DMA_BUFFER_IMPL
         fastUpdateLEDDMABuffer(rgb24);
 #else
@@ -155,9 +195,13 @@ void ws2811UpdateStrip(void)
         updateLEDDMABuffer(rgb24->rgb.r);
         updateLEDDMABuffer(rgb24->rgb.b);
 #endif
+    }
+    memset(&ledDirty, 0, sizeof(ledDirty));
 
-        ledIndex++;
+    if (!changed && !ledStripResendPending) {
+        return;
     }
+    ledStripResendPending = false;
 
     ws2811LedDataTransferInProgress = 1;
     ws2811LedStripDMAEnable();
@@ -39,6 +39,7 @@ void ws2811LedStripHardwareInit(void);
 void ws2811LedStripDMAEnable(void);
 
 void ws2811UpdateStrip(void);
+void ws2811ResendStrip(void);
 
 void setLedHsv(uint16_t index, const hsvColor_t *color);
 void getLedHsv(uint16_t index, hsvColor_t *color);
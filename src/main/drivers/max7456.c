@@ -22,6 +22,8 @@
 
 #ifdef USE_MAX7456
 
+#include "build/build_config.h"
+
 #include "common/printf.h"
 
 #include "bus_spi.h"
@@ -37,13 +39,29 @@
 #define DISABLE_MAX7456       IOHi(max7456CsPin)
 #define ENABLE_MAX7456        IOLo(max7456CsPin)
 
+// Runs of changed characters closer than this are sent as one, resending the unchanged characters between them. Starting
+// a run costs as much as sending this many characters: DMAH, DMAL and DMM, then the 0xFF that ends auto-increment mode.
+#define MAX7456_RUN_OVERHEAD    4
+
 uint16_t max_screen_size;
-static MAX7456_CHAR_TYPE max7456_screen[VIDEO_BUFFER_CHARS_PAL + 5];
-#define SCREEN_BUFFER ((MAX7456_CHAR_TYPE*)&max7456_screen[3])
+
+// The OSD draws into max7456_screen, max7456_shadow holds what the chip's display memory has been sent. Only the runs
+// of characters which differ between the two go over the bus.
+static MAX7456_CHAR_TYPE max7456_screen[VIDEO_BUFFER_CHARS_PAL];
+static MAX7456_CHAR_TYPE max7456_shadow[VIDEO_BUFFER_CHARS_PAL];
+#define SCREEN_BUFFER max7456_screen
 
 #ifdef MAX7456_DMA_CHANNEL_TX
 volatile uint8_t dma_transaction_in_progress = 0;
+
+// Register writes for one screen update: room for the VM0 write of a resync, a single run covering the whole screen and
+// the DMM write at the end. Runs split by 0xFF characters can be closer together than MAX7456_RUN_OVERHEAD, so whatever
+// doesn't fit is left for the next update.
+#define MAX7456_TX_SIZE         (1 + VIDEO_BUFFER_CHARS_PAL + MAX7456_RUN_OVERHEAD + 1)
+STATIC_UNIT_TESTED uint16_t max7456_tx[MAX7456_TX_SIZE];
 #endif
+static uint16_t max7456_tx_length;
+static bool max7456_resync_pending;
 
 static uint8_t  video_signal_type   = 0;
 static uint8_t  max7456_lock        = 0;
@@ -77,7 +95,7 @@ static void max7456_send_dma(void* tx_buffer, void* rx_buffer, uint16_t buffer_s
 
     // Common to both channels
     DMA_StructInit(&DMA_InitStructure);
-    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)(&(MAX7456_SPI_INSTANCE->DR));
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)(uintptr_t)(&(MAX7456_SPI_INSTANCE->DR));
     DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
     DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
     DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
@@ -88,10 +106,10 @@ static void max7456_send_dma(void* tx_buffer, void* rx_buffer, uint16_t buffer_s
 #ifdef MAX7456_DMA_CHANNEL_RX
     // Rx Channel
 #ifdef STM32F4
-    DMA_InitStructure.DMA_Memory0BaseAddr = rx_buffer ? (uint32_t)rx_buffer : (uint32_t)(dummy);
+    DMA_InitStructure.DMA_Memory0BaseAddr = rx_buffer ? (uint32_t)(uintptr_t)rx_buffer : (uint32_t)(uintptr_t)(dummy);
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
 #else
-    DMA_InitStructure.DMA_MemoryBaseAddr = rx_buffer ? (uint32_t)rx_buffer : (uint32_t)(dummy);
+    DMA_InitStructure.DMA_MemoryBaseAddr = rx_buffer ? (uint32_t)(uintptr_t)rx_buffer : (uint32_t)(uintptr_t)(dummy);
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
 #endif
     DMA_InitStructure.DMA_MemoryInc = rx_buffer ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable;
@@ -102,10 +120,10 @@ static void max7456_send_dma(void* tx_buffer, void* rx_buffer, uint16_t buffer_s
     // Tx channel
 
 #ifdef STM32F4
-    DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)tx_buffer; //max7456_screen;
+    DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)(uintptr_t)tx_buffer; //max7456_screen;
     DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
 #else
-    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)tx_buffer; //max7456_screen;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)(uintptr_t)tx_buffer; //max7456_screen;
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
 #endif
     DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
@@ -151,8 +169,6 @@ void max7456_dma_irq_handler(dmaChannelDescriptor_t* descriptor) {
                 SPI_I2S_DMAReq_Tx, DISABLE);
 
         DISABLE_MAX7456;
-        for (uint16_t x = 0; x < max_screen_size; x++)
-            max7456_screen[x + 3] = MAX7456_CHAR(' ');
         dma_transaction_in_progress = 0;
     }
 }
@@ -213,19 +229,18 @@ void max7456_init(uint8_t video_system)
     // make sure the Max7456 is enabled
     max7456_send(VM0_REG, OSD_ENABLE | video_signal_type);
 
+    // start from a known display memory, every character 0x00
+    max7456_send(MAX7456ADD_DMM, CLEAR_DISPLAY);
+
     DISABLE_MAX7456;
     delay(100);
 
-    for (x = 0; x < max_screen_size; x++)
+    for (x = 0; x < max_screen_size; x++) {
         SCREEN_BUFFER[x] = MAX7456_CHAR(' ');
+        max7456_shadow[x] = MAX7456_CHAR(0);
+    }
 
 #ifdef MAX7456_DMA_CHANNEL_TX
-    max7456_screen[0] = (uint16_t)(MAX7456ADD_DMAH | (0 << 8));
-    max7456_screen[1] = (uint16_t)(MAX7456ADD_DMAL | (0 << 8));
-    max7456_screen[2] = (uint16_t)(MAX7456ADD_DMM | (1 << 8));
-    max7456_screen[max_screen_size + 3] = (uint16_t)(MAX7456ADD_DMDI | (0xFF << 8));
-    max7456_screen[max_screen_size + 4] = (uint16_t)(MAX7456ADD_DMM  | (0 << 8));
-
     dmaSetHandler(MAX7456_DMA_IRQ_HANDLER_ID, max7456_dma_irq_handler, NVIC_PRIO_MAX7456_DMA, 0);
 #endif
 }
@@ -244,28 +259,132 @@ void max7456_write_string(const char *string, int16_t address) {
     }
 }
 
-void max7456_draw_screen(void) {
-    if (!max7456_lock) {
+void max7456_clear_screen(void) {
+    for (uint16_t x = 0; x < max_screen_size; x++)
+        SCREEN_BUFFER[x] = MAX7456_CHAR(' ');
+}
+
+// Send the whole screen with the next update, in case the MAX7456 has lost it to a reset or brownout
+void max7456_invalidate_screen(void) {
+    max7456_resync_pending = true;
+}
+
+static void max7456_queue(uint8_t add, uint8_t data)
+{
 #ifdef MAX7456_DMA_CHANNEL_TX
-        max7456_send_dma(max7456_screen, NULL, max_screen_size * 2 + 10);
+    max7456_tx[max7456_tx_length] = (uint16_t)(add | (data << 8));
 #else
-        uint16_t xx;
-        max7456_lock = 1;
-
-        ENABLE_MAX7456;
-        max7456_send(MAX7456ADD_DMAH, 0);
-        max7456_send(MAX7456ADD_DMAL, 0);
-        max7456_send(MAX7456ADD_DMM, 1);
-        for (xx = 0; xx < max_screen_size; ++xx) {
-            max7456_send(MAX7456ADD_DMDI, SCREEN_BUFFER[xx]);
-            SCREEN_BUFFER[xx] = MAX7456_CHAR(' ');
+    max7456_send(add, data);
+#endif
+    max7456_tx_length++;
+}
+
+static void max7456_queue_char(MAX7456_CHAR_TYPE c)
+{
+#ifdef MAX7456_DMA_CHANNEL_TX
+    max7456_tx[max7456_tx_length] = c;
+#else
+    max7456_send(MAX7456ADD_DMDI, c);
+#endif
+    max7456_tx_length++;
+}
+
+// 0xFF ends auto-increment mode, so it can't be put on the screen
+static bool max7456_char_sendable(uint16_t address)
+{
+    return SCREEN_BUFFER[address] != (MAX7456_CHAR_TYPE)MAX7456_CHAR(END_STRING);
+}
+
+static bool max7456_char_changed(uint16_t address)
+{
+    return SCREEN_BUFFER[address] != max7456_shadow[address] && max7456_char_sendable(address);
+}
+
+// Queue the register writes for every run of changed characters, returns false if some had to be left for next time
+static bool max7456_queue_changes(void)
+{
+    uint16_t address = 0;
+    bool complete = true;
+
+    max7456_tx_length = 0;
+
+    if (max7456_resync_pending) {
+        // a reset also turns the OSD off
+        max7456_queue(VM0_REG, OSD_ENABLE | video_signal_type);
+        // 0xFF is never sent, so it can't match what's on the screen
+        for (uint16_t x = 0; x < max_screen_size; x++)
+            max7456_shadow[x] = MAX7456_CHAR(END_STRING);
+        max7456_resync_pending = false;
+    }
+
+    while (address < max_screen_size) {
+        if (!max7456_char_changed(address)) {
+            address++;
+            continue;
         }
-        max7456_send(MAX7456ADD_DMDI, 0xFF);
-        max7456_send(MAX7456ADD_DMM, 0);
-        DISABLE_MAX7456;
-        max7456_lock = 0;
+
+        uint16_t runEnd = address + 1;
+        for (uint16_t next = runEnd; next < max_screen_size && next - runEnd < MAX7456_RUN_OVERHEAD; next++) {
+            if (!max7456_char_sendable(next))
+                break;
+            if (max7456_char_changed(next))
+                runEnd = next + 1;
+        }
+
+#ifdef MAX7456_DMA_CHANNEL_TX
+        // keep room for the DMM write at the end
+        const uint16_t room = MAX7456_TX_SIZE - 1 - max7456_tx_length;
+        if (room <= MAX7456_RUN_OVERHEAD) {
+            complete = false;
+            break;
+        }
+        if (runEnd - address > room - MAX7456_RUN_OVERHEAD)
+            runEnd = address + room - MAX7456_RUN_OVERHEAD;
 #endif
+
+        max7456_queue(MAX7456ADD_DMAH, address >> 8);
+        max7456_queue(MAX7456ADD_DMAL, address & 0xFF);
+        max7456_queue(MAX7456ADD_DMM, 1); // auto-increment the address after each character
+        for (; address < runEnd; address++) {
+            max7456_queue_char(SCREEN_BUFFER[address]);
+            max7456_shadow[address] = SCREEN_BUFFER[address];
+        }
+        max7456_queue(MAX7456ADD_DMDI, END_STRING);
     }
+
+    if (max7456_tx_length)
+        max7456_queue(MAX7456ADD_DMM, 0);
+
+    return complete;
+}
+
+// Returns false if some of the screen is still to be sent, because the MAX7456 was busy or the changes didn't all fit
+// in one DMA transfer
+bool max7456_draw_screen(void) {
+    if (max7456_lock)
+        return false;
+
+#ifdef MAX7456_DMA_CHANNEL_TX
+    // the changes are picked up by the next call instead of waiting for the bus
+    if (dma_transaction_in_progress)
+        return false;
+
+    const bool complete = max7456_queue_changes();
+
+    if (max7456_tx_length)
+        max7456_send_dma(max7456_tx, NULL, max7456_tx_length * 2);
+
+    return complete;
+#else
+    max7456_lock = 1;
+
+    ENABLE_MAX7456;
+    max7456_queue_changes();
+    DISABLE_MAX7456;
+    max7456_lock = 0;
+
+    return true;
+#endif
 }
 
 void max7456_write_nvm(uint8_t char_address, uint8_t *font_data) {
@@ -153,7 +153,9 @@ extern uint16_t max_screen_size;
 #endif
 
 void max7456_init(uint8_t system);
-void max7456_draw_screen(void);
+bool max7456_draw_screen(void);
+void max7456_clear_screen(void);
+void max7456_invalidate_screen(void);
 void max7456_write_string(const char *string, int16_t address);
 void max7456_write_nvm(uint8_t char_address, uint8_t *font_data);
 MAX7456_CHAR_TYPE* max7456_get_screen_buffer(void);
@@ -51,6 +51,12 @@
  */
 #define SDCARD_NON_DMA_CHUNK_SIZE 256
 
+/*
+ * During a multi-block write, up to this many further consecutive blocks can be queued behind the block being sent, so
+ * the next one can be started as soon as the card is ready for it, without waiting for the caller to supply it.
+ */
+#define SDCARD_WRITE_QUEUE_LENGTH 2
+
 #define STATIC_ASSERT(condition, name ) \
     typedef char assert_failed_ ## name [(condition) ? 1 : -1 ]
 
@@ -70,6 +76,12 @@ typedef enum {
     SDCARD_STATE_STOPPING_MULTIPLE_BLOCK_WRITE,
 } sdcardState_e;
 
+typedef struct sdcardQueuedWrite_t {
+    uint8_t *buffer;
+    sdcard_operationCompleteCallback_c callback;
+    uint32_t callbackData;
+} sdcardQueuedWrite_t;
+
 typedef struct sdcard_t {
     struct {
         uint8_t *buffer;
@@ -94,6 +106,11 @@ typedef struct sdcard_t {
     uint32_t multiWriteNextBlock;
     uint32_t multiWriteBlocksRemain;
 
+    // Writes waiting behind pendingOperation, for the blocks immediately following it
+    sdcardQueuedWrite_t writeQueue[SDCARD_WRITE_QUEUE_LENGTH];
+    uint8_t writeQueueHead;
+    uint8_t writeQueueCount;
+
     sdcardState_e state;
 
     sdcardMetadata_t metadata;
@@ -184,6 +201,26 @@ static void sdcard_deselect(void)
     SET_CS_HIGH;
 }
 
+/**
+ * Report the failure of all writes which are queued behind the current one.
+ */
+static void sdcard_failQueuedWrites(void)
+{
+    uint32_t blockIndex = sdcard.pendingOperation.blockIndex;
+
+    while (sdcard.writeQueueCount > 0) {
+        sdcardQueuedWrite_t *write = &sdcard.writeQueue[sdcard.writeQueueHead];
+
+        blockIndex++;
+        sdcard.writeQueueHead = (sdcard.writeQueueHead + 1) % SDCARD_WRITE_QUEUE_LENGTH;
+        sdcard.writeQueueCount--;
+
+        if (write->callback) {
+            write->callback(SDCARD_BLOCK_OPERATION_WRITE, blockIndex, NULL, write->callbackData);
+        }
+    }
+}
+
 /**
  * Handle a failure of an SD card operation by resetting the card back to its initialization phase.
  *
@@ -192,6 +229,8 @@ static void sdcard_deselect(void)
  */
 static void sdcard_reset(void)
 {
+    sdcard_failQueuedWrites();
+
     if (!sdcard_isInserted()) {
         sdcard.state = SDCARD_STATE_NOT_PRESENT;
         return;
@@ -631,6 +670,65 @@ static sdcardOperationStatus_e sdcard_endWriteBlocks()
     }
 }
 
+/**
+ * Begin transmitting the given buffer as the block with the given index. The card must be ready to receive the data
+ * block (a write command has been sent, or we're part way through a multi-block write).
+ */
+static void sdcard_startWrite(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    sdcard_sendDataBlockBegin(buffer, sdcard.state == SDCARD_STATE_WRITING_MULTIPLE_BLOCKS);
+
+    sdcard.pendingOperation.buffer = buffer;
+    sdcard.pendingOperation.blockIndex = blockIndex;
+    sdcard.pendingOperation.callback = callback;
+    sdcard.pendingOperation.callbackData = callbackData;
+    sdcard.pendingOperation.chunkIndex = 1; // (for non-DMA transfers) we've sent chunk #0 already
+    sdcard.state = SDCARD_STATE_SENDING_WRITE;
+}
+
+/**
+ * Queue a write behind the block that is currently being written, if it's the next block of the multi-block write
+ * that's in progress.
+ *
+ * Returns true if the write was queued.
+ */
+static bool sdcard_queueWrite(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    // Blocks beyond the end of the multi-block write would need a new write command, so they can't be queued
+    if (sdcard.writeQueueCount == SDCARD_WRITE_QUEUE_LENGTH
+        || sdcard.multiWriteBlocksRemain <= 1u + sdcard.writeQueueCount
+        || blockIndex != sdcard.pendingOperation.blockIndex + 1 + sdcard.writeQueueCount) {
+        return false;
+    }
+
+    sdcardQueuedWrite_t *write = &sdcard.writeQueue[(sdcard.writeQueueHead + sdcard.writeQueueCount) % SDCARD_WRITE_QUEUE_LENGTH];
+
+    write->buffer = buffer;
+    write->callback = callback;
+    write->callbackData = callbackData;
+
+    sdcard.writeQueueCount++;
+
+    return true;
+}
+
+/**
+ * Start sending the oldest queued write. Call when the card is ready for the next block of the multi-block write.
+ */
+static void sdcard_startQueuedWrite(void)
+{
+    sdcardQueuedWrite_t *write = &sdcard.writeQueue[sdcard.writeQueueHead];
+
+    sdcard.writeQueueHead = (sdcard.writeQueueHead + 1) % SDCARD_WRITE_QUEUE_LENGTH;
+    sdcard.writeQueueCount--;
+
+#ifdef SDCARD_PROFILING
+    sdcard.pendingOperation.profileStartTime = micros();
+#endif
+
+    sdcard_startWrite(sdcard.multiWriteNextBlock, write->buffer, write->callback, write->callbackData);
+}
+
 /**
  * Call periodically for the SD card to perform in-progress transfers.
  *
@@ -640,6 +738,7 @@ bool sdcard_poll(void)
 {
     uint8_t initStatus;
     bool sendComplete;
+    bool startQueuedWrite;
 
 #ifdef SDCARD_PROFILING
     bool profilingComplete;
@@ -773,6 +872,9 @@ bool sdcard_poll(void)
                     if (sdcard.pendingOperation.callback) {
                         sdcard.pendingOperation.callback(SDCARD_BLOCK_OPERATION_WRITE, sdcard.pendingOperation.blockIndex, sdcard.pendingOperation.buffer, sdcard.pendingOperation.callbackData);
                     }
+
+                    // Cards with a write buffer may already be ready for the next block, so check right away
+                    goto doMore;
                 } else {
                     /* Our write was rejected! This could be due to a bad address but we hope not to attempt that, so assume
                      * the card is broken and needs reset.
@@ -793,6 +895,7 @@ bool sdcard_poll(void)
 #ifdef SDCARD_PROFILING
                 profilingComplete = true;
 #endif
+                startQueuedWrite = false;
 
                 sdcard.failureCount = 0; // Assume the card is good if it can complete a write
 
@@ -801,6 +904,8 @@ bool sdcard_poll(void)
                     sdcard.multiWriteBlocksRemain--;
                     sdcard.multiWriteNextBlock++;
                     sdcard.state = SDCARD_STATE_WRITING_MULTIPLE_BLOCKS;
+
+                    startQueuedWrite = sdcard.writeQueueCount > 0;
                 } else if (sdcard.multiWriteBlocksRemain == 1) {
                     // This function changes the sd card state for us whether immediately succesful or delayed:
                     if (sdcard_endWriteBlocks() == SDCARD_OPERATION_SUCCESS) {
@@ -821,6 +926,11 @@ bool sdcard_poll(void)
                     sdcard.profiler(SDCARD_BLOCK_OPERATION_WRITE, sdcard.pendingOperation.blockIndex, micros() - sdcard.pendingOperation.profileStartTime);
                 }
 #endif
+
+                // The next block is already waiting, so we can keep the card busy without involving the caller
+                if (startQueuedWrite) {
+                    sdcard_startQueuedWrite();
+                }
             } else if (millis() > sdcard.operationStartTime + SDCARD_TIMEOUT_WRITE_MSEC) {
                 /*
                  * The caller has already been told that their write has completed, so they will have discarded
@@ -914,6 +1024,9 @@ bool sdcard_poll(void)
  * If the write does not complete immediately, your callback will be called later. If the write was successful, the
  * buffer pointer will be the same buffer you originally passed in, otherwise the buffer will be set to NULL.
  *
+ * While a block of a multi-block write is being written, the following blocks of that write can be submitted too. They
+ * are queued (up to SDCARD_WRITE_QUEUE_LENGTH of them) and sent as soon as the card is ready for each one.
+ *
  * Returns:
  *     SDCARD_OPERATION_IN_PROGRESS - Your buffer is currently being transmitted to the card and your callback will be
  *                                    called later to report the completion. The buffer pointer must remain valid until
@@ -927,11 +1040,19 @@ sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer,
     uint8_t status;
 
 #ifdef SDCARD_PROFILING
-    sdcard.pendingOperation.profileStartTime = micros();
+    uint32_t profileStartTime = micros();
 #endif
 
     doMore:
     switch (sdcard.state) {
+        case SDCARD_STATE_SENDING_WRITE:
+        case SDCARD_STATE_WAITING_FOR_WRITE:
+            if (sdcard_queueWrite(blockIndex, buffer, callback, callbackData)) {
+                return SDCARD_OPERATION_IN_PROGRESS;
+            }
+
+            return SDCARD_OPERATION_BUSY;
+
         case SDCARD_STATE_WRITING_MULTIPLE_BLOCKS:
             // Do we need to cancel the previous multi-block write?
             if (blockIndex != sdcard.multiWriteNextBlock) {
@@ -964,14 +1085,11 @@ sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer,
             return SDCARD_OPERATION_BUSY;
     }
 
-    sdcard_sendDataBlockBegin(buffer, sdcard.state == SDCARD_STATE_WRITING_MULTIPLE_BLOCKS);
+#ifdef SDCARD_PROFILING
+    sdcard.pendingOperation.profileStartTime = profileStartTime;
+#endif
 
-    sdcard.pendingOperation.buffer = buffer;
-    sdcard.pendingOperation.blockIndex = blockIndex;
-    sdcard.pendingOperation.callback = callback;
-    sdcard.pendingOperation.callbackData = callbackData;
-    sdcard.pendingOperation.chunkIndex = 1; // (for non-DMA transfers) we've sent chunk #0 already
-    sdcard.state = SDCARD_STATE_SENDING_WRITE;
+    sdcard_startWrite(blockIndex, buffer, callback, callbackData);
 
     return SDCARD_OPERATION_IN_PROGRESS;
 }
@@ -71,6 +71,37 @@ uint8_t serialRead(serialPort_t *instance)
     return instance->vTable->serialRead(instance);
 }
 
+/**
+ * Copy up to maxCount bytes that have already been received into data. Doesn't wait for more to arrive.
+ *
+ * Returns the number of bytes copied.
+ */
+int serialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    if (instance->vTable->readBuf) {
+        return instance->vTable->readBuf(instance, data, maxCount);
+    }
+
+    int count = 0;
+
+    while (count < maxCount && serialRxBytesWaiting(instance)) {
+        data[count++] = serialRead(instance);
+    }
+
+    return count;
+}
+
+/**
+ * Ask a port that was opened with a receive callback to hand over received data a burst at a time instead.
+ *
+ * UARTs with RX DMA deliver whatever has arrived when the line goes idle, which is normally one whole frame of a
+ * serial RX protocol. Other ports carry on calling the byte callback, so the protocol driver must handle both.
+ */
+void serialSetReceiveSpanCallback(serialPort_t *instance, serialReceiveSpanCallbackPtr spanCallback)
+{
+    instance->spanCallback = spanCallback;
+}
+
 void serialSetBaudRate(serialPort_t *instance, uint32_t baudRate)
 {
     instance->vTable->serialSetBaudRate(instance, baudRate);
@@ -35,6 +35,7 @@ typedef enum portOptions_t {
 } portOptions_t;
 
 typedef void (*serialReceiveCallbackPtr)(uint16_t data);   // used by serial drivers to return frames to app
+typedef void (*serialReceiveSpanCallbackPtr)(const uint8_t *data, int length);
 
 typedef struct serialPort_s {
 
@@ -57,6 +58,8 @@ typedef struct serialPort_s {
 
     // FIXME rename member to rxCallback
     serialReceiveCallbackPtr callback;
+    // Optional, used instead of callback by drivers which receive a burst at a time (see serialSetReceiveSpanCallback())
+    serialReceiveSpanCallbackPtr spanCallback;
 } serialPort_t;
 
 struct serialPortVTable {
@@ -75,6 +78,8 @@ struct serialPortVTable {
     void (*setMode)(serialPort_t *instance, portMode_t mode);
 
     void (*writeBuf)(serialPort_t *instance, void *data, int count);
+    // Optional, copies up to maxCount received bytes without waiting and returns how many were copied.
+    int (*readBuf)(serialPort_t *instance, uint8_t *data, int maxCount);
     // Optional functions used to buffer large writes.
     void (*beginWrite)(serialPort_t *instance);
     void (*endWrite)(serialPort_t *instance);
@@ -85,6 +90,8 @@ uint32_t serialRxBytesWaiting(serialPort_t *instance);
 uint8_t serialTxBytesFree(serialPort_t *instance);
 void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count);
 uint8_t serialRead(serialPort_t *instance);
+int serialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount);
+void serialSetReceiveSpanCallback(serialPort_t *instance, serialReceiveSpanCallbackPtr spanCallback);
 void serialSetBaudRate(serialPort_t *instance, uint32_t baudRate);
 void serialSetMode(serialPort_t *instance, portMode_t mode);
 bool isSerialTransmitBufferEmpty(serialPort_t *instance);
@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -25,6 +26,7 @@
 #include "build/build_config.h"
 #include "build/atomic.h"
 
+#include "common/maths.h"
 #include "common/utils.h"
 
 #include "nvic.h"
@@ -452,6 +454,51 @@ void softSerialWriteByte(serialPort_t *s, uint8_t ch)
     s->txBufferHead = (s->txBufferHead + 1) % s->txBufferSize;
 }
 
+void softSerialWriteBuf(serialPort_t *s, void *data, int count)
+{
+    if ((s->mode & MODE_TX) == 0) {
+        return;
+    }
+
+    const uint8_t *p = data;
+
+    while (count > 0) {
+        uint32_t chunk = softSerialTxBytesFree(s);
+        if (chunk == 0) {
+            continue; // Wait for the transmitter to make room, as serialWriteBuf() always has
+        }
+
+        chunk = MIN(chunk, (uint32_t)count);
+        chunk = MIN(chunk, s->txBufferSize - s->txBufferHead);
+
+        memcpy((uint8_t *)&s->txBuffer[s->txBufferHead], p, chunk);
+        s->txBufferHead = (s->txBufferHead + chunk) % s->txBufferSize;
+        p += chunk;
+        count -= chunk;
+    }
+}
+
+int softSerialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    int count = 0;
+
+    while (count < maxCount) {
+        uint32_t chunk = softSerialRxBytesWaiting(instance);
+        if (chunk == 0) {
+            break;
+        }
+
+        chunk = MIN(chunk, (uint32_t)(maxCount - count));
+        chunk = MIN(chunk, instance->rxBufferSize - instance->rxBufferTail);
+
+        memcpy(data + count, (const uint8_t *)&instance->rxBuffer[instance->rxBufferTail], chunk);
+        instance->rxBufferTail = (instance->rxBufferTail + chunk) % instance->rxBufferSize;
+        count += chunk;
+    }
+
+    return count;
+}
+
 void softSerialSetBaudRate(serialPort_t *s, uint32_t baudRate)
 {
     softSerial_t *softSerial = (softSerial_t *)s;
@@ -477,7 +524,8 @@ const struct serialPortVTable softSerialVTable[] = {
         .serialSetBaudRate = softSerialSetBaudRate,
         .isSerialTransmitBufferEmpty = isSoftSerialTransmitBufferEmpty,
         .setMode = softSerialSetMode,
-        .writeBuf = NULL,
+        .writeBuf = softSerialWriteBuf,
+        .readBuf = softSerialReadBuf,
         .beginWrite = NULL,
         .endWrite = NULL
     }
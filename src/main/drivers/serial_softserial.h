@@ -31,6 +31,8 @@ void softSerialWriteByte(serialPort_t *instance, uint8_t ch);
 uint32_t softSerialRxBytesWaiting(serialPort_t *instance);
 uint8_t softSerialTxBytesFree(serialPort_t *instance);
 uint8_t softSerialReadByte(serialPort_t *instance);
+void softSerialWriteBuf(serialPort_t *instance, void *data, int count);
+int softSerialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount);
 void softSerialSetBaudRate(serialPort_t *s, uint32_t baudRate);
 bool isSoftSerialTransmitBufferEmpty(serialPort_t *s);
 
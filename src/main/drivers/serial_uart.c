@@ -22,11 +22,13 @@
 */
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
 #include "build/build_config.h"
 
+#include "common/maths.h"
 #include "common/utils.h"
 #include "gpio.h"
 #include "inverter.h"
@@ -128,8 +130,9 @@ serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback,
     // common serial initialisation code should move to serialPort::init()
     s->port.rxBufferHead = s->port.rxBufferTail = 0;
     s->port.txBufferHead = s->port.txBufferTail = 0;
-    // callback works for IRQ-based RX ONLY
+    // callback works for IRQ-based RX, or RX DMA with idle line detection
     s->port.callback = callback;
+    s->port.spanCallback = NULL;
     s->port.mode = mode;
     s->port.baudRate = baudRate;
     s->port.options = options;
@@ -185,6 +188,10 @@ serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback,
             USART_DMACmd(s->USARTx, USART_DMAReq_Rx, ENABLE);
             s->rxDMAPos = DMA_GetCurrDataCounter(s->rxDMAChannel);
 #endif
+            if (callback) {
+                // Hand over what the DMA has received each time the line goes idle, instead of interrupting per byte
+                USART_ITConfig(s->USARTx, USART_IT_IDLE, ENABLE);
+            }
         } else {
             USART_ClearITPendingBit(s->USARTx, USART_IT_RXNE);
             USART_ITConfig(s->USARTx, USART_IT_RXNE, ENABLE);
@@ -301,10 +308,11 @@ uint32_t uartTotalRxBytesWaiting(serialPort_t *instance)
     if (s->rxDMAChannel) {
         uint32_t rxDMAHead = s->rxDMAChannel->CNDTR;
 #endif
-        if (rxDMAHead >= s->rxDMAPos) {
-            return rxDMAHead - s->rxDMAPos;
+        // rxDMAPos and rxDMAHead are distances from the end of the buffer, they count down as they advance
+        if (s->rxDMAPos >= rxDMAHead) {
+            return s->rxDMAPos - rxDMAHead;
         } else {
-            return s->port.rxBufferSize + rxDMAHead - s->rxDMAPos;
+            return s->port.rxBufferSize + s->rxDMAPos - rxDMAHead;
         }
     }
 
@@ -315,6 +323,45 @@ uint32_t uartTotalRxBytesWaiting(serialPort_t *instance)
     }
 }
 
+/**
+ * Pass what the RX DMA has received since last time to the port's receive callback. Called from the USART interrupt
+ * when the line goes idle, so a frame is passed on in one go once it has finished arriving.
+ */
+void uartRxDMAIdle(uartPort_t *s)
+{
+    if (!s->port.callback) {
+        return;
+    }
+
+#ifdef STM32F4
+    uint32_t rxDMAHead = s->rxDMAStream->NDTR;
+#else
+    uint32_t rxDMAHead = s->rxDMAChannel->CNDTR;
+#endif
+    if (rxDMAHead == 0) {
+        rxDMAHead = s->port.rxBufferSize; // About to be reloaded
+    }
+
+    // rxDMAPos and rxDMAHead are distances from the end of the buffer, and a span can't run past the end
+    while (s->rxDMAPos != rxDMAHead) {
+        const uint8_t *data = (const uint8_t *)&s->port.rxBuffer[s->port.rxBufferSize - s->rxDMAPos];
+        const uint32_t length = s->rxDMAPos > rxDMAHead ? s->rxDMAPos - rxDMAHead : s->rxDMAPos;
+
+        if (s->port.spanCallback) {
+            s->port.spanCallback(data, length);
+        } else {
+            for (uint32_t i = 0; i < length; i++) {
+                s->port.callback(data[i]);
+            }
+        }
+
+        s->rxDMAPos -= length;
+        if (s->rxDMAPos == 0) {
+            s->rxDMAPos = s->port.rxBufferSize;
+        }
+    }
+}
+
 uint8_t uartTotalTxBytesFree(serialPort_t *instance)
 {
     uartPort_t *s = (uartPort_t*)instance;
@@ -396,6 +443,21 @@ uint8_t uartRead(serialPort_t *instance)
     return ch;
 }
 
+static void uartStartTx(uartPort_t *s)
+{
+#ifdef STM32F4
+    if (s->txDMAStream) {
+        if (!(s->txDMAStream->CR & 1))
+#else
+    if (s->txDMAChannel) {
+        if (!(s->txDMAChannel->CCR & 1))
+#endif
+            uartStartTxDMA(s);
+    } else {
+        USART_ITConfig(s->USARTx, USART_IT_TXE, ENABLE);
+    }
+}
+
 void uartWrite(serialPort_t *instance, uint8_t ch)
 {
     uartPort_t *s = (uartPort_t *)instance;
@@ -406,17 +468,75 @@ void uartWrite(serialPort_t *instance, uint8_t ch)
         s->port.txBufferHead++;
     }
 
+    uartStartTx(s);
+}
+
+void uartWriteBuf(serialPort_t *instance, void *data, int count)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+    const uint8_t *p = data;
+
+    while (count > 0) {
+        uint32_t chunk = uartTotalTxBytesFree(instance);
+        if (chunk == 0) {
+            continue; // Wait for the transmitter to make room, as serialWriteBuf() always has
+        }
+
+        // Copy up to the end of the ring at most, the rest goes in on the next pass
+        chunk = MIN(chunk, (uint32_t)count);
+        chunk = MIN(chunk, s->port.txBufferSize - s->port.txBufferHead);
+
+        memcpy((uint8_t *)&s->port.txBuffer[s->port.txBufferHead], p, chunk);
+        if (s->port.txBufferHead + chunk >= s->port.txBufferSize) {
+            s->port.txBufferHead = 0;
+        } else {
+            s->port.txBufferHead += chunk;
+        }
+        p += chunk;
+        count -= chunk;
+
+        uartStartTx(s);
+    }
+}
+
+int uartReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+    int count = 0;
+
+    while (count < maxCount) {
+        uint32_t chunk = uartTotalRxBytesWaiting(instance);
+        if (chunk == 0) {
+            break;
+        }
+
 #ifdef STM32F4
-    if (s->txDMAStream) {
-        if (!(s->txDMAStream->CR & 1))
+        const bool rxDMA = s->rxDMAStream != NULL;
 #else
-    if (s->txDMAChannel) {
-        if (!(s->txDMAChannel->CCR & 1))
+        const bool rxDMA = s->rxDMAChannel != NULL;
 #endif
-            uartStartTxDMA(s);
-    } else {
-        USART_ITConfig(s->USARTx, USART_IT_TXE, ENABLE);
+        const uint32_t tail = rxDMA ? s->port.rxBufferSize - s->rxDMAPos : s->port.rxBufferTail;
+
+        // Copy up to the end of the ring at most, the rest comes from the start on the next pass
+        chunk = MIN(chunk, (uint32_t)(maxCount - count));
+        chunk = MIN(chunk, s->port.rxBufferSize - tail);
+
+        memcpy(data + count, (const uint8_t *)&s->port.rxBuffer[tail], chunk);
+        count += chunk;
+
+        if (rxDMA) {
+            s->rxDMAPos -= chunk;
+            if (s->rxDMAPos == 0) {
+                s->rxDMAPos = s->port.rxBufferSize;
+            }
+        } else if (tail + chunk >= s->port.rxBufferSize) {
+            s->port.rxBufferTail = 0;
+        } else {
+            s->port.rxBufferTail = tail + chunk;
+        }
     }
+
+    return count;
 }
 
 const struct serialPortVTable uartVTable[] = {
@@ -428,7 +548,8 @@ const struct serialPortVTable uartVTable[] = {
         .serialSetBaudRate = uartSetBaudRate,
         .isSerialTransmitBufferEmpty = isUartTransmitBufferEmpty,
         .setMode = uartSetMode,
-        .writeBuf = NULL,
+        .writeBuf = uartWriteBuf,
+        .readBuf = uartReadBuf,
         .beginWrite = NULL,
         .endWrite = NULL,
     }
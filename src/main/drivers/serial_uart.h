@@ -68,5 +68,7 @@ void uartWrite(serialPort_t *instance, uint8_t ch);
 uint32_t uartTotalRxBytesWaiting(serialPort_t *instance);
 uint8_t uartTotalTxBytesFree(serialPort_t *instance);
 uint8_t uartRead(serialPort_t *instance);
+void uartWriteBuf(serialPort_t *instance, void *data, int count);
+int uartReadBuf(serialPort_t *instance, uint8_t *data, int maxCount);
 void uartSetBaudRate(serialPort_t *s, uint32_t baudRate);
 bool isUartTransmitBufferEmpty(serialPort_t *s);
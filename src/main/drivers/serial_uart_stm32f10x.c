@@ -64,7 +64,11 @@ void uartIrqCallback(uartPort_t *s)
             }
         }
     }
-    if (SR & USART_FLAG_TXE) {
+    if ((SR & USART_FLAG_IDLE) && s->rxDMAChannel) {
+        (void)s->USARTx->DR; // Reading SR then DR clears the idle flag
+        uartRxDMAIdle(s);
+    }
+    if ((SR & USART_FLAG_TXE) && !s->txDMAChannel) {
         if (s->port.txBufferTail != s->port.txBufferHead) {
             s->USARTx->DR = s->port.txBuffer[s->port.txBufferTail++];
             if (s->port.txBufferTail >= s->port.txBufferSize) {
@@ -140,8 +144,7 @@ uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t option
     // DMA TX Interrupt
     dmaSetHandler(DMA1_CH4_HANDLER, uart_tx_dma_IRQHandler, NVIC_PRIO_SERIALUART1_TXDMA, (uint32_t)&uartPort1);
 
-#ifndef USE_UART1_RX_DMA
-    // RX/TX Interrupt
+    // RX/TX Interrupt, also needed with RX DMA for idle line detection
     NVIC_InitTypeDef NVIC_InitStructure;
 
     NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
@@ -149,7 +152,6 @@ uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t option
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(NVIC_PRIO_SERIALUART1);
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
-#endif
 
     return s;
 }
@@ -245,6 +245,11 @@ void uartIrqHandler(uartPort_t *s)
         }
     }
 
+    if (s->rxDMAStream && (USART_GetITStatus(s->USARTx, USART_IT_IDLE) == SET)) {
+        (void)s->USARTx->DR; // Reading SR then DR clears the idle flag
+        uartRxDMAIdle(s);
+    }
+
     if (!s->txDMAStream && (USART_GetITStatus(s->USARTx, USART_IT_TXE) == SET)) {
         if (s->port.txBufferTail != s->port.txBufferHead) {
             USART_SendData(s->USARTx, s->port.txBuffer[s->port.txBufferTail]);
@@ -353,13 +358,12 @@ uartPort_t *serialUART(UARTDevice device, uint32_t baudRate, portMode_t mode, po
     // DMA TX Interrupt
     dmaSetHandler(uart->txIrq, dmaIRQHandler, uart->txPriority, (uint32_t)uart);
 
-    if (!(s->rxDMAChannel)) {
-        NVIC_InitStructure.NVIC_IRQChannel = uart->rxIrq;
-        NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_PRIORITY_BASE(uart->rxPriority);
-        NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(uart->rxPriority);
-        NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-        NVIC_Init(&NVIC_InitStructure);
-    }
+    // Also needed with RX DMA for idle line detection
+    NVIC_InitStructure.NVIC_IRQChannel = uart->rxIrq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_PRIORITY_BASE(uart->rxPriority);
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(uart->rxPriority);
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
 
     return s;
 }
@@ -84,6 +84,13 @@ static uint8_t usbVcpRead(serialPort_t *instance)
     }
 }
 
+static int usbVcpReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    UNUSED(instance);
+
+    return CDC_Receive_DATA(data, maxCount);
+}
+
 static void usbVcpWriteBuf(serialPort_t *instance, void *data, int count)
 {
     UNUSED(instance);
@@ -173,6 +180,7 @@ static const struct serialPortVTable usbVTable[] = {
         .isSerialTransmitBufferEmpty = isUsbVcpTransmitBufferEmpty,
         .setMode = usbVcpSetMode,
         .writeBuf = usbVcpWriteBuf,
+        .readBuf = usbVcpReadBuf,
         .beginWrite = usbVcpBeginWrite,
         .endWrite = usbVcpEndWrite
     }
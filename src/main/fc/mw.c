@@ -64,6 +64,7 @@
 #include "io/serial_msp.h"
 #include "io/statusindicator.h"
 #include "io/asyncfatfs/asyncfatfs.h"
+#include "io/flashfs.h"
 #include "io/transponder_ir.h"
 #include "io/osd.h"
 
@@ -71,9 +72,11 @@
 
 #include "rx/rx.h"
 #include "rx/msp.h"
+#include "rx/rx_latency.h"
 
 #include "telemetry/telemetry.h"
 #include "blackbox/blackbox.h"
+#include "blackbox/blackbox_log_reader.h"
 
 #include "flight/mixer.h"
 #include "flight/pid.h"
@@ -264,6 +267,12 @@ void processRcCommand(void)
     }
 
     if (readyToCalculateRate || isRXDataNew) {
+#ifndef SKIP_RX_LATENCY
+        uint32_t frameStartedAt;
+        if (isRXDataNew && rxGetFrameStartedAt(&frameStartedAt)) {
+            rxLatencyRecord(RX_LATENCY_RC_COMMAND, frameStartedAt, micros());
+        }
+#endif
         for (int axis = 0; axis < 3; axis++) setpointRate[axis] = calculateSetpointRate(axis, rcCommand[axis]);
 
         isRXDataNew = false;
@@ -383,7 +392,7 @@ void mwDisarm(void)
     }
 }
 
-#define TELEMETRY_FUNCTION_MASK (FUNCTION_TELEMETRY_FRSKY | FUNCTION_TELEMETRY_HOTT | FUNCTION_TELEMETRY_LTM | FUNCTION_TELEMETRY_SMARTPORT)
+#define TELEMETRY_FUNCTION_MASK (FUNCTION_TELEMETRY_FRSKY | FUNCTION_TELEMETRY_HOTT | FUNCTION_TELEMETRY_LTM | FUNCTION_TELEMETRY_SMARTPORT | FUNCTION_TELEMETRY_MAVLINK)
 
 void releaseSharedTelemetryPorts(void) {
     serialPort_t *sharedPort = findSharedSerialPort(TELEMETRY_FUNCTION_MASK, FUNCTION_MSP);
@@ -799,6 +808,12 @@ void subTaskMotorUpdate(void)
 
     if (motorControlEnable) {
         writeMotors();
+#ifndef SKIP_RX_LATENCY
+        uint32_t frameStartedAt;
+        if (rxGetFrameStartedAt(&frameStartedAt)) {
+            rxLatencyRecord(RX_LATENCY_MOTORS, frameStartedAt, micros());
+        }
+#endif
     }
     if (debugMode == DEBUG_PIDLOOP) {debug[3] = micros() - startTime;}
 }
@@ -868,6 +883,11 @@ void taskHandleSerial(void)
     handleSerial();
 }
 
+void taskMspPushSubscriptions(void)
+{
+    mspPushSubscriptions();
+}
+
 void taskUpdateBeeper(void)
 {
     beeperUpdate();          //call periodic beeper handler
@@ -1032,3 +1052,17 @@ void taskUpdateOsd(void)
     }
 }
 #endif
+
+#ifdef USE_FLASHFS
+void taskFlashfs(void)
+{
+    flashfsEraseAhead();
+}
+#endif
+
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+void taskSdcardLogReader(void)
+{
+    blackboxLogReaderPoll();
+}
+#endif
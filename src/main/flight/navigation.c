@@ -266,10 +266,22 @@ void GPS_calculateDistanceAndDirectionToHome(void)
     }
 }
 
+#define GPS_MILLIS_PER_WEEK (7 * 24 * 60 * 60 * 1000UL)
+
+static uint32_t GPS_timeOfWeekDelta(uint32_t timeOfWeek, uint32_t lastTimeOfWeek)
+{
+    if (timeOfWeek < lastTimeOfWeek) {
+        // a new week started
+        timeOfWeek += GPS_MILLIS_PER_WEEK;
+    }
+    return timeOfWeek - lastTimeOfWeek;
+}
+
 void onGpsNewData(void)
 {
     int axis;
     static uint32_t nav_loopTimer;
+    static uint32_t last_timeOfWeek;
     uint16_t speed;
 
 
@@ -309,7 +321,13 @@ void onGpsNewData(void)
     // Calculate time delta for navigation loop, range 0-1.0f, in seconds
     //
     // Time for calculating x,y speed and navigation pids
-    dTnav = (float)(millis() - nav_loopTimer) / 1000.0f;
+    if (GPS_velnedValid) {
+        // Time the fixes themselves, so that jitter in when they arrive doesn't show up as a change in speed
+        dTnav = (float)GPS_timeOfWeekDelta(GPS_timeOfWeek, last_timeOfWeek) / 1000.0f;
+        last_timeOfWeek = GPS_timeOfWeek;
+    } else {
+        dTnav = (float)(millis() - nav_loopTimer) / 1000.0f;
+    }
     nav_loopTimer = millis();
     // prevent runup from bad GPS
     dTnav = MIN(dTnav, 1.0f);
@@ -490,7 +508,14 @@ static void GPS_calc_velocity(void)
     // y_GPS_speed positive = Up
     // x_GPS_speed positive = Right
 
-    if (init) {
+    if (GPS_velnedValid) {
+        // The receiver measures velocity itself (from doppler), at the same epoch as the position
+        actual_speed[GPS_X] = GPS_velned[VEL_EAST] / DISTANCE_BETWEEN_TWO_LONGITUDE_POINTS_AT_EQUATOR_IN_HUNDREDS_OF_KILOMETERS;
+        actual_speed[GPS_Y] = GPS_velned[VEL_NORTH] / DISTANCE_BETWEEN_TWO_LONGITUDE_POINTS_AT_EQUATOR_IN_HUNDREDS_OF_KILOMETERS;
+
+        speed_old[GPS_X] = actual_speed[GPS_X];
+        speed_old[GPS_Y] = actual_speed[GPS_Y];
+    } else if (init) {
         float tmp = 1.0f / dTnav;
         actual_speed[GPS_X] = (float)(GPS_coord[LON] - last_coord[LON]) * GPS_scaleLonDown * tmp;
         actual_speed[GPS_Y] = (float)(GPS_coord[LAT] - last_coord[LAT]) * tmp;
@@ -35,7 +35,25 @@
     #define ONLY_EXPOSE_FOR_TESTING static
 #endif
 
-#define AFATFS_NUM_CACHE_SECTORS 8
+// Targets may override the cache size in their target.h, each sector costs 512 bytes of RAM
+#ifndef AFATFS_NUM_CACHE_SECTORS
+    #ifdef STM32F4
+        #define AFATFS_NUM_CACHE_SECTORS 16
+    #else
+        #define AFATFS_NUM_CACHE_SECTORS 8
+    #endif
+#endif
+
+/*
+ * FAT and directory sectors are protected from eviction in favour of data sectors, as long as they don't occupy more
+ * than this many cache sectors.
+ */
+#define AFATFS_MAX_PROTECTED_CACHE_SECTORS (AFATFS_NUM_CACHE_SECTORS / 2)
+
+// The free space summary divides the FAT into this many regions, each costing two bits of RAM
+#ifndef AFATFS_FREE_SPACE_SUMMARY_REGIONS
+    #define AFATFS_FREE_SPACE_SUMMARY_REGIONS 1024
+#endif
 
 // FAT filesystems are allowed to differ from these parameters, but we choose not to support those weird filesystems:
 #define AFATFS_SECTOR_SIZE  512
@@ -80,10 +98,18 @@
 #define AFATFS_CACHE_DISCARDABLE  8
 // Increase the retain counter of the cache sector to prevent it from being discarded when in the in-sync state
 #define AFATFS_CACHE_RETAIN       16
+// The sector holds filesystem metadata (a directory), so prefer to keep it cached. FAT sectors are detected automatically.
+#define AFATFS_CACHE_METADATA     32
 
 // Turn the largest free block on the disk into one contiguous file for efficient fragment-free allocation
 #define AFATFS_USE_FREEFILE
 
+/*
+ * Scan the FAT in the background after mounting to summarise which regions of it are completely full or completely
+ * free, so that searches for free or occupied clusters can jump straight over regions which can't match.
+ */
+#define AFATFS_USE_FREE_SPACE_SUMMARY
+
 // When allocating a freefile, leave this many clusters un-allocated for regular files to use
 #define AFATFS_FREEFILE_LEAVE_CLUSTERS 100
 
@@ -191,6 +217,12 @@ typedef struct afatfsCacheBlockDescriptor_t {
      * is overridden by the locked and retainCount flags.
      */
     unsigned discardable:1;
+
+    /*
+     * This block holds a FAT or directory sector, which we're likely to need again soon, so it should be kept in the
+     * cache in preference to file data.
+     */
+    unsigned metadata:1;
 } afatfsCacheBlockDescriptor_t;
 
 typedef enum {
@@ -217,6 +249,20 @@ typedef struct afatfsFreeSpaceFAT_t {
     uint32_t endCluster;
 } afatfsFreeSpaceFAT_t;
 
+typedef struct afatfsFreeSpaceSummary_t {
+    uint32_t fatSectorsPerRegion; // Zero until the volume has been mounted
+
+    // The next FAT sector to be examined by the background scan, and what it found so far in that sector's region
+    uint32_t scanFATSector;
+    bool scanFoundFree;
+    bool scanFoundOccupied;
+    bool scanRegionModified;
+
+    // One bit per region, set when the region is known to contain no free (or no occupied) clusters
+    uint8_t noFreeClusters[AFATFS_FREE_SPACE_SUMMARY_REGIONS / 8];
+    uint8_t noOccupiedClusters[AFATFS_FREE_SPACE_SUMMARY_REGIONS / 8];
+} afatfsFreeSpaceSummary_t;
+
 typedef struct afatfsCreateFile_t {
     afatfsFileCallback_t callback;
 
@@ -442,7 +488,14 @@ typedef struct afatfs_t {
     uint32_t cacheTimer;
 
     int cacheDirtyEntries; // The number of cache entries in the AFATFS_CACHE_STATE_DIRTY state
-    bool cacheFlushInProgress;
+    int cacheWritesInProgress; // The number of sector writes handed to the card driver which haven't completed yet
+    uint32_t lastFlushedSector; // Physical index of the last sector handed to the card driver for writing
+
+    afatfsCacheStats_t cacheStats;
+
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+    afatfsFreeSpaceSummary_t freeSpaceSummary;
+#endif
 
     afatfsFile_t openFiles[AFATFS_MAX_OPEN_FILES];
 
@@ -615,6 +668,7 @@ static void afatfs_cacheSectorInit(afatfsCacheBlockDescriptor_t *descriptor, uin
     descriptor->locked = locked;
     descriptor->retainCount = 0;
     descriptor->discardable = 0;
+    descriptor->metadata = 0;
 }
 
 /**
@@ -651,7 +705,9 @@ static void afatfs_sdcardWriteComplete(sdcardBlockOperation_e operation, uint32_
     (void) operation;
     (void) callbackData;
 
-    afatfs.cacheFlushInProgress = false;
+    if (afatfs.cacheWritesInProgress > 0) {
+        afatfs.cacheWritesInProgress--;
+    }
 
     for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
         /* Keep in mind that someone may have marked the sector as dirty after writing had already begun. In this case we must leave
@@ -675,9 +731,10 @@ static void afatfs_sdcardWriteComplete(sdcardBlockOperation_e operation, uint32_
 }
 
 /**
- * Attempt to flush the dirty cache entry with the given index to the SDcard.
+ * Attempt to flush the dirty cache entry with the given index to the SDcard. Returns true if the card accepted the
+ * write.
  */
-static void afatfs_cacheFlushSector(int cacheIndex)
+static bool afatfs_cacheFlushSector(int cacheIndex)
 {
     afatfsCacheBlockDescriptor_t *cacheDescriptor = &afatfs.cacheDescriptor[cacheIndex];
 
@@ -692,19 +749,21 @@ static void afatfs_cacheFlushSector(int cacheIndex)
             // The card will call us back later when the buffer transmission finishes
             afatfs.cacheDirtyEntries--;
             cacheDescriptor->state = AFATFS_CACHE_STATE_WRITING;
-            afatfs.cacheFlushInProgress = true;
-            break;
+            afatfs.cacheWritesInProgress++;
+            afatfs.lastFlushedSector = cacheDescriptor->sectorIndex;
+            return true;
 
         case SDCARD_OPERATION_SUCCESS:
             // Buffer is already transmitted
             afatfs.cacheDirtyEntries--;
             cacheDescriptor->state = AFATFS_CACHE_STATE_IN_SYNC;
-            break;
+            afatfs.lastFlushedSector = cacheDescriptor->sectorIndex;
+            return true;
 
         case SDCARD_OPERATION_BUSY:
         case SDCARD_OPERATION_FAILURE:
         default:
-            ;
+            return false;
     }
 }
 
@@ -730,7 +789,11 @@ static afatfsCacheBlockDescriptor_t* afatfs_findCacheSector(uint32_t sectorIndex
  * - The requested sector that already exists in the cache
  * - The index of an empty sector
  * - The index of a synced discardable sector
- * - The index of the oldest synced sector
+ * - The index of the oldest synced data sector
+ * - The index of the oldest synced metadata (FAT or directory) sector
+ *
+ * Metadata sectors only lose their protection when they occupy more than AFATFS_MAX_PROTECTED_CACHE_SECTORS of the
+ * cache, then the oldest synced sector of either kind is chosen.
  *
  * Otherwise it returns -1 to signal failure (cache is full!)
  */
@@ -739,8 +802,9 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
     int allocateIndex;
     int emptyIndex = -1, discardableIndex = -1;
 
-    uint32_t oldestSyncedSectorLastUse = 0xFFFFFFFF;
-    int oldestSyncedSectorIndex = -1;
+    uint32_t oldestSyncedDataLastUse = 0xFFFFFFFF, oldestSyncedMetadataLastUse = 0xFFFFFFFF;
+    int oldestSyncedDataIndex = -1, oldestSyncedMetadataIndex = -1;
+    int metadataCount = 0;
 
     if (
         !afatfs_assert(
@@ -767,6 +831,10 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
             return i;
         }
 
+        if (afatfs.cacheDescriptor[i].state != AFATFS_CACHE_STATE_EMPTY && afatfs.cacheDescriptor[i].metadata) {
+            metadataCount++;
+        }
+
         switch (afatfs.cacheDescriptor[i].state) {
             case AFATFS_CACHE_STATE_EMPTY:
                 emptyIndex = i;
@@ -776,10 +844,15 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
                 if (!afatfs.cacheDescriptor[i].locked && afatfs.cacheDescriptor[i].retainCount == 0) {
                     if (afatfs.cacheDescriptor[i].discardable) {
                         discardableIndex = i;
-                    } else if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedSectorLastUse) {
+                    } else if (afatfs.cacheDescriptor[i].metadata) {
+                        if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedMetadataLastUse) {
+                            oldestSyncedMetadataLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
+                            oldestSyncedMetadataIndex = i;
+                        }
+                    } else if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedDataLastUse) {
                         // This is older than last block we decided to evict, so evict this one in preference
-                        oldestSyncedSectorLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
-                        oldestSyncedSectorIndex = i;
+                        oldestSyncedDataLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
+                        oldestSyncedDataIndex = i;
                     }
                 }
             break;
@@ -792,10 +865,16 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
         allocateIndex = emptyIndex;
     } else if (discardableIndex > -1) {
         allocateIndex = discardableIndex;
-    } else if (oldestSyncedSectorIndex > -1) {
-        allocateIndex = oldestSyncedSectorIndex;
+    } else if (
+        oldestSyncedMetadataIndex > -1
+        && (
+            oldestSyncedDataIndex == -1
+            || (metadataCount > AFATFS_MAX_PROTECTED_CACHE_SECTORS && oldestSyncedMetadataLastUse < oldestSyncedDataLastUse)
+        )
+    ) {
+        allocateIndex = oldestSyncedMetadataIndex;
     } else {
-        allocateIndex = -1;
+        allocateIndex = oldestSyncedDataIndex;
     }
 
     if (allocateIndex > -1) {
@@ -805,11 +884,38 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
     return allocateIndex;
 }
 
+/**
+ * Hand the card any dirty sectors which directly follow the last sector we flushed. The card driver can queue these
+ * while it is still busy with the previous block of a multi-block write, and start them without waiting for another
+ * poll, so a file being streamed to disk keeps the card busy back-to-back.
+ */
+static void afatfs_flushConsecutiveSectors()
+{
+    while (afatfs.cacheDirtyEntries > 0) {
+        afatfsCacheBlockDescriptor_t *descriptor = afatfs_findCacheSector(afatfs.lastFlushedSector + 1);
+
+        if (!descriptor || descriptor->state != AFATFS_CACHE_STATE_DIRTY || descriptor->locked
+#ifdef AFATFS_MIN_MULTIPLE_BLOCK_WRITE_COUNT
+            // This sector begins a new multi-block write, so it has to wait for the card to be ready
+            || descriptor->consecutiveEraseBlockCount
+#endif
+        ) {
+            break;
+        }
+
+        if (!afatfs_cacheFlushSector(descriptor - afatfs.cacheDescriptor)) {
+            break;
+        }
+    }
+}
+
 /**
  * Attempt to flush dirty cache pages out to the sdcard, returning true if all flushable data has been flushed.
  */
 bool afatfs_flush()
 {
+    afatfs_flushConsecutiveSectors();
+
     if (afatfs.cacheDirtyEntries > 0) {
         // Flush the oldest flushable sector
         uint32_t earliestSectorTime = 0xFFFFFFFF;
@@ -825,7 +931,9 @@ bool afatfs_flush()
         }
 
         if (earliestSectorIndex > -1) {
-            afatfs_cacheFlushSector(earliestSectorIndex);
+            if (afatfs_cacheFlushSector(earliestSectorIndex)) {
+                afatfs_flushConsecutiveSectors();
+            }
 
             // That flush will take time to complete so we may as well tell caller to come back later
             return false;
@@ -852,6 +960,72 @@ static uint32_t afatfs_fatSectorToPhysical(int fatIndex, uint32_t fatSectorIndex
     return afatfs.fatStartSector + (fatIndex ? afatfs.fatSectors : 0) + fatSectorIndex;
 }
 
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+
+static void afatfs_freeSpaceSummaryBegin()
+{
+    memset(&afatfs.freeSpaceSummary, 0, sizeof(afatfs.freeSpaceSummary));
+
+    afatfs.freeSpaceSummary.fatSectorsPerRegion = (afatfs.fatSectors + AFATFS_FREE_SPACE_SUMMARY_REGIONS - 1) / AFATFS_FREE_SPACE_SUMMARY_REGIONS;
+}
+
+static bool afatfs_freeSpaceSummaryGetBit(const uint8_t *bitmap, uint32_t region)
+{
+    return (bitmap[region / 8] & (1 << (region % 8))) != 0;
+}
+
+static void afatfs_freeSpaceSummarySetBit(uint8_t *bitmap, uint32_t region, bool value)
+{
+    if (value) {
+        bitmap[region / 8] |= 1 << (region % 8);
+    } else {
+        bitmap[region / 8] &= ~(1 << (region % 8));
+    }
+}
+
+/**
+ * Forget what the summary knows about the region of the FAT that the given physical sector lies in, because that
+ * sector is about to be modified.
+ */
+static void afatfs_freeSpaceSummaryInvalidate(uint32_t physicalSectorIndex)
+{
+    afatfsFreeSpaceSummary_t *summary = &afatfs.freeSpaceSummary;
+
+    if (summary->fatSectorsPerRegion == 0
+        || physicalSectorIndex < afatfs.fatStartSector || physicalSectorIndex >= afatfs.fatStartSector + afatfs.fatSectors) {
+        return;
+    }
+
+    uint32_t region = (physicalSectorIndex - afatfs.fatStartSector) / summary->fatSectorsPerRegion;
+
+    afatfs_freeSpaceSummarySetBit(summary->noFreeClusters, region, false);
+    afatfs_freeSpaceSummarySetBit(summary->noOccupiedClusters, region, false);
+
+    // If the background scan is part way through this region, what it has seen so far may be stale
+    if (region == summary->scanFATSector / summary->fatSectorsPerRegion) {
+        summary->scanRegionModified = true;
+    }
+}
+
+/**
+ * Returns true if the summary shows that the region containing the given FAT sector has no free clusters (if
+ * lookingForFree) or no occupied clusters (otherwise).
+ */
+static bool afatfs_freeSpaceSummaryCanSkipRegion(uint32_t fatSectorIndex, bool lookingForFree)
+{
+    afatfsFreeSpaceSummary_t *summary = &afatfs.freeSpaceSummary;
+
+    if (summary->fatSectorsPerRegion == 0) {
+        return false;
+    }
+
+    uint32_t region = fatSectorIndex / summary->fatSectorsPerRegion;
+
+    return afatfs_freeSpaceSummaryGetBit(lookingForFree ? summary->noFreeClusters : summary->noOccupiedClusters, region);
+}
+
+#endif
+
 static uint32_t afatfs_fileClusterToPhysical(uint32_t clusterNumber, uint32_t sectorIndex)
 {
     return afatfs.clusterStartSector + (clusterNumber - 2) * afatfs.sectorsPerCluster + sectorIndex;
@@ -906,9 +1080,20 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
 
     if (cacheSectorIndex == -1) {
         // We don't have enough free cache to service this request right now, try again later
+        afatfs.cacheStats.stalls++;
         return AFATFS_OPERATION_IN_PROGRESS;
     }
 
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+    if ((sectorFlags & AFATFS_CACHE_WRITE) != 0) {
+        afatfs_freeSpaceSummaryInvalidate(physicalSectorIndex);
+    }
+#endif
+
+    if ((sectorFlags & AFATFS_CACHE_METADATA) != 0 || physicalSectorIndex < afatfs.clusterStartSector) {
+        afatfs.cacheDescriptor[cacheSectorIndex].metadata = 1;
+    }
+
     switch (afatfs.cacheDescriptor[cacheSectorIndex].state) {
         case AFATFS_CACHE_STATE_READING:
             return AFATFS_OPERATION_IN_PROGRESS;
@@ -918,6 +1103,7 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             if ((sectorFlags & AFATFS_CACHE_READ) != 0) {
                 if (sdcard_readBlock(physicalSectorIndex, afatfs_cacheSectorGetMemory(cacheSectorIndex), afatfs_sdcardReadComplete, 0)) {
                     afatfs.cacheDescriptor[cacheSectorIndex].state = AFATFS_CACHE_STATE_READING;
+                    afatfs.cacheStats.misses++;
                 }
                 return AFATFS_OPERATION_IN_PROGRESS;
             }
@@ -946,6 +1132,9 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             // Fall through
 
         case AFATFS_CACHE_STATE_DIRTY:
+            if ((sectorFlags & AFATFS_CACHE_READ) != 0) {
+                afatfs.cacheStats.hits++;
+            }
             if ((sectorFlags & AFATFS_CACHE_LOCK) != 0) {
                 afatfs.cacheDescriptor[cacheSectorIndex].locked = 1;
             }
@@ -1223,10 +1412,24 @@ static afatfsFindClusterStatus_e afatfs_findClusterWithCondition(afatfsClusterSe
 
             // Maintain alignment
             *cluster = roundUpTo(*cluster, jump);
+
+            afatfs_getFATPositionForCluster(*cluster, &fatSectorIndex, &fatSectorEntryIndex);
             continue; // Go back to check that the new cluster number is within the volume
         }
 #endif
 
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+        // Skip straight to the next region of the FAT if this one can't contain what we're looking for
+        if (afatfs_freeSpaceSummaryCanSkipRegion(fatSectorIndex, lookingForFree)) {
+            uint32_t fatSectorsPerRegion = afatfs.freeSpaceSummary.fatSectorsPerRegion;
+
+            fatSectorIndex = (fatSectorIndex / fatSectorsPerRegion + 1) * fatSectorsPerRegion;
+            fatSectorEntryIndex = 0;
+            *cluster = fatSectorIndex * fatEntriesPerSector;
+            continue;
+        }
+#endif
+
         afatfsOperationStatus_e status = afatfs_cacheSector(afatfs_fatSectorToPhysical(0, fatSectorIndex), &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_DISCARDABLE, 0);
 
         switch (status) {
@@ -1280,6 +1483,85 @@ static afatfsFindClusterStatus_e afatfs_findClusterWithCondition(afatfsClusterSe
     return AFATFS_FIND_CLUSTER_NOT_FOUND;
 }
 
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+
+/**
+ * Examine the next sectors of the FAT to build up the free space summary. This only reads the FAT when the filesystem
+ * has nothing else to do, so call it periodically and it'll make progress when it can.
+ */
+static void afatfs_freeSpaceSummaryScanContinue()
+{
+    afatfsFreeSpaceSummary_t *summary = &afatfs.freeSpaceSummary;
+    uint32_t fatEntriesPerSector = afatfs_fatEntriesPerSector();
+    uint32_t clusterLimit = afatfs.numClusters + FAT_SMALLEST_LEGAL_CLUSTER_NUMBER;
+    afatfsFATSector_t sector;
+
+    if (summary->fatSectorsPerRegion == 0 || afatfs.cacheDirtyEntries > 0) {
+        return;
+    }
+
+    for (int i = 0; i < AFATFS_MAX_OPEN_FILES; i++) {
+        if (afatfs_fileIsBusy(&afatfs.openFiles[i])) {
+            return;
+        }
+    }
+
+    while (summary->scanFATSector < afatfs.fatSectors) {
+        uint32_t firstCluster = summary->scanFATSector * fatEntriesPerSector;
+        uint32_t endCluster = MIN(firstCluster + fatEntriesPerSector, clusterLimit);
+
+#ifdef AFATFS_USE_FREEFILE
+        uint32_t freeFileClusters = (afatfs.freeFile.logicalSize + afatfs_clusterSize() - 1) / afatfs_clusterSize();
+
+        // The freefile's clusters are all occupied, so there's no need to read its FAT sectors
+        if (afatfs.freeFile.logicalSize > 0 && firstCluster >= afatfs.freeFile.firstCluster
+            && endCluster <= afatfs.freeFile.firstCluster + freeFileClusters) {
+            summary->scanFoundOccupied = true;
+        } else
+#endif
+        {
+            if (afatfs_cacheSector(afatfs_fatSectorToPhysical(0, summary->scanFATSector), &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_DISCARDABLE, 0) != AFATFS_OPERATION_SUCCESS) {
+                return;
+            }
+
+            // The first two FAT entries are reserved, and the final sector may extend beyond the end of the volume
+            for (uint32_t cluster = MAX(firstCluster, FAT_SMALLEST_LEGAL_CLUSTER_NUMBER); cluster < endCluster; cluster++) {
+                uint32_t entryIndex = cluster - firstCluster;
+                uint32_t nextCluster;
+
+                if (afatfs.filesystemType == FAT_FILESYSTEM_TYPE_FAT16) {
+                    nextCluster = sector.fat16[entryIndex];
+                } else {
+                    nextCluster = fat32_decodeClusterNumber(sector.fat32[entryIndex]);
+                }
+
+                if (fat_isFreeSpace(nextCluster)) {
+                    summary->scanFoundFree = true;
+                } else {
+                    summary->scanFoundOccupied = true;
+                }
+            }
+        }
+
+        summary->scanFATSector++;
+
+        if (summary->scanFATSector % summary->fatSectorsPerRegion == 0 || summary->scanFATSector == afatfs.fatSectors) {
+            uint32_t region = (summary->scanFATSector - 1) / summary->fatSectorsPerRegion;
+
+            if (!summary->scanRegionModified) {
+                afatfs_freeSpaceSummarySetBit(summary->noFreeClusters, region, !summary->scanFoundFree);
+                afatfs_freeSpaceSummarySetBit(summary->noOccupiedClusters, region, !summary->scanFoundOccupied);
+            }
+
+            summary->scanFoundFree = false;
+            summary->scanFoundOccupied = false;
+            summary->scanRegionModified = false;
+        }
+    }
+}
+
+#endif
+
 /**
  * Get the cluster that follows the currentCluster in the FAT chain for the given file.
  *
@@ -1436,7 +1718,7 @@ static afatfsOperationStatus_e afatfs_saveDirectoryEntry(afatfsFilePtr_t file, a
         return AFATFS_OPERATION_SUCCESS; // Root directories don't have a directory entry
     }
 
-    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE, 0);
+    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
 #ifdef AFATFS_DEBUG_VERBOSE
     fprintf(stderr, "Saving directory entry to sector %u...\n", file->directoryEntryPos.sectorNumberPhysical);
@@ -1784,6 +2066,38 @@ static bool afatfs_isEndOfAllocatedFile(afatfsFilePtr_t file)
     }
 }
 
+/**
+ * Start reading the sector after the file's cursor sector into the cache, if it belongs to the file and the card is
+ * free, so that a sequential reader finds it already cached. Read-ahead stops at the end of the cluster, since finding
+ * the next cluster requires a FAT lookup.
+ *
+ * The sector is marked discardable, so read-ahead never pushes out more than one sector of useful data.
+ */
+static void afatfs_fileReadAhead(afatfsFilePtr_t file, uint32_t physicalSector)
+{
+    uint32_t nextSectorOffset = (file->cursorOffset & ~((uint32_t) AFATFS_SECTOR_SIZE - 1)) + AFATFS_SECTOR_SIZE;
+
+    if (nextSectorOffset >= file->logicalSize || afatfs_sectorIndexInCluster(nextSectorOffset) == 0) {
+        return;
+    }
+
+    afatfsCacheBlockDescriptor_t *descriptor = afatfs_findCacheSector(physicalSector + 1);
+
+    if (descriptor && descriptor->state != AFATFS_CACHE_STATE_EMPTY) {
+        return;
+    }
+
+    int cacheSectorIndex = afatfs_allocateCacheSector(physicalSector + 1);
+
+    if (cacheSectorIndex > -1 && afatfs.cacheDescriptor[cacheSectorIndex].state == AFATFS_CACHE_STATE_EMPTY) {
+        if (sdcard_readBlock(physicalSector + 1, afatfs_cacheSectorGetMemory(cacheSectorIndex), afatfs_sdcardReadComplete, 0)) {
+            afatfs.cacheDescriptor[cacheSectorIndex].state = AFATFS_CACHE_STATE_READING;
+            afatfs.cacheDescriptor[cacheSectorIndex].discardable = 1;
+            afatfs.cacheStats.readAheads++;
+        }
+    }
+}
+
 /**
  * Take a lock on the sector at the current file cursor position.
  *
@@ -1815,7 +2129,7 @@ static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file)
         afatfsOperationStatus_e status = afatfs_cacheSector(
             physicalSector,
             &result,
-            AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN,
+            AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN | (file->type == AFATFS_FILE_TYPE_NORMAL ? 0 : AFATFS_CACHE_METADATA),
             0
         );
 
@@ -1825,6 +2139,10 @@ static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file)
         }
 
         file->readRetainCacheIndex = afatfs_getCacheDescriptorIndexForBuffer(result);
+
+        if (file->type == AFATFS_FILE_TYPE_NORMAL) {
+            afatfs_fileReadAhead(file, physicalSector);
+        }
     }
 
     return result;
@@ -1860,7 +2178,7 @@ static uint8_t* afatfs_fileLockCursorSectorForWrite(afatfsFilePtr_t file)
         }
 
         uint32_t physicalSector = afatfs_fileGetCursorPhysicalSector(file);
-        uint8_t cacheFlags = AFATFS_CACHE_WRITE | AFATFS_CACHE_LOCK;
+        uint8_t cacheFlags = AFATFS_CACHE_WRITE | AFATFS_CACHE_LOCK | (file->type == AFATFS_FILE_TYPE_NORMAL ? 0 : AFATFS_CACHE_METADATA);
         uint32_t cursorOffsetInSector = file->cursorOffset % AFATFS_SECTOR_SIZE;
         uint32_t offsetOfStartOfSector = file->cursorOffset & ~((uint32_t) AFATFS_SECTOR_SIZE - 1);
         uint32_t offsetOfEndOfSector = offsetOfStartOfSector + AFATFS_SECTOR_SIZE;
@@ -3157,6 +3475,14 @@ uint32_t afatfs_fread(afatfsFilePtr_t file, uint8_t *buffer, uint32_t len)
     return readBytes;
 }
 
+/**
+ * Returns the size of the file in bytes.
+ */
+uint32_t afatfs_fileSize(afatfsFilePtr_t file)
+{
+    return file->logicalSize;
+}
+
 /**
  * Returns true if the file's pointer position currently lies at the end-of-file point (i.e. one byte beyond the last
  * byte in the file).
@@ -3388,6 +3714,10 @@ static void afatfs_initContinue()
         case AFATFS_INITIALIZATION_READ_VOLUME_ID:
             if (afatfs_cacheSector(afatfs.partitionStartSector, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_DISCARDABLE, 0) == AFATFS_OPERATION_SUCCESS) {
                 if (afatfs_parseVolumeID(sector)) {
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+                    afatfs_freeSpaceSummaryBegin();
+#endif
+
                     // Open the root directory
                     afatfs_chdir(NULL);
 
@@ -3505,10 +3835,17 @@ void afatfs_poll()
             break;
             case AFATFS_FILESYSTEM_STATE_READY:
                 afatfs_fileOperationsPoll();
+
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+                afatfs_freeSpaceSummaryScanContinue();
+#endif
             break;
             default:
                 ;
         }
+    } else {
+        // The card may still be able to queue up the next blocks of a multi-block write while it's busy
+        afatfs_flushConsecutiveSectors();
     }
 }
 
@@ -3572,6 +3909,10 @@ void afatfs_init()
     afatfs.initPhase = AFATFS_INITIALIZATION_READ_MBR;
     afatfs.lastClusterAllocated = FAT_SMALLEST_LEGAL_CLUSTER_NUMBER;
 
+#ifdef AFATFS_USE_FREE_SPACE_SUMMARY
+    afatfs.freeSpaceSummary.fatSectorsPerRegion = 0;
+#endif
+
 #ifdef AFATFS_USE_INTROSPECTIVE_LOGGING
     sdcard_setProfilerCallback(afatfs_sdcardProfilerCallback);
 #endif
@@ -3621,7 +3962,7 @@ bool afatfs_destroy(bool dirty)
             return false;
         }
 
-        if (afatfs.cacheFlushInProgress) {
+        if (afatfs.cacheWritesInProgress > 0) {
             return false;
         }
 
@@ -3645,6 +3986,17 @@ bool afatfs_destroy(bool dirty)
     return true;
 }
 
+/**
+ * Get the number of sectors in the cache and the counters of how well it has been performing since the filesystem was
+ * initialised.
+ */
+uint8_t afatfs_getCacheStats(afatfsCacheStats_t *stats)
+{
+    *stats = afatfs.cacheStats;
+
+    return AFATFS_NUM_CACHE_SECTORS;
+}
+
 /**
  * Get a pessimistic estimate of the amount of buffer space that we have available to write to immediately.
  */
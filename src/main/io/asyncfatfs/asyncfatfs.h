@@ -51,6 +51,13 @@ typedef struct afatfsDirEntryPointer_t {
 
 typedef afatfsDirEntryPointer_t afatfsFinder_t;
 
+typedef struct afatfsCacheStats_t {
+    uint32_t hits;       // Sector reads satisfied by the cache
+    uint32_t misses;     // Sector reads which had to go to the card
+    uint32_t stalls;     // Requests refused because every cache sector was in use
+    uint32_t readAheads; // Sectors read ahead of sequential file reads
+} afatfsCacheStats_t;
+
 typedef enum {
     AFATFS_SEEK_SET,
     AFATFS_SEEK_CUR,
@@ -66,6 +73,7 @@ bool afatfs_fclose(afatfsFilePtr_t file, afatfsCallback_t callback);
 bool afatfs_funlink(afatfsFilePtr_t file, afatfsCallback_t callback);
 
 bool afatfs_feof(afatfsFilePtr_t file);
+uint32_t afatfs_fileSize(afatfsFilePtr_t file);
 void afatfs_fputc(afatfsFilePtr_t file, uint8_t c);
 uint32_t afatfs_fwrite(afatfsFilePtr_t file, const uint8_t *buffer, uint32_t len);
 uint32_t afatfs_fread(afatfsFilePtr_t file, uint8_t *buffer, uint32_t len);
@@ -88,5 +96,7 @@ uint32_t afatfs_getFreeBufferSpace();
 uint32_t afatfs_getContiguousFreeSpace();
 bool afatfs_isFull();
 
+uint8_t afatfs_getCacheStats(afatfsCacheStats_t *stats);
+
 afatfsFilesystemState_e afatfs_getFilesystemState();
 afatfsError_e afatfs_getLastError();
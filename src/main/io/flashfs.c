@@ -27,6 +27,17 @@
  *
  * In future, we can add support for multiple different flash chips by adding a flash device driver vtable
  * and make calls through that, at the moment flashfs just calls m25p16_* routines explicitly.
+ *
+ * Rolling mode (enabled with flashfsSetRollingMode()) removes the need to erase the whole chip before logging.
+ * Writes are then only ever made into a window of sectors which is known to be erased, and flashfsEraseAhead()
+ * must be called periodically to erase new sectors ahead of the write pointer while the device is idle. If
+ * wrapping is enabled, the write pointer returns to the start of the device when it reaches the end, so the
+ * oldest data is overwritten.
+ *
+ * The device can't be programmed while a sector erase runs (about 0.6s on the M25P16), and the write buffer only
+ * holds FLASHFS_WRITE_BUFFER_SIZE bytes, so whatever is written during an erase is dropped. With one erase per 64KB
+ * sector, a 1kHz Blackbox log of about 40KB/s loses around a third of its data this way. Rolling mode suits lower
+ * logging rates, or logs where gaps are acceptable; erase the chip beforehand when every frame matters.
  */
 
 #include <stdint.h>
@@ -50,6 +61,20 @@ static uint8_t bufferHead = 0, bufferTail = 0;
 // The position of the buffer's tail in the overall flash address space:
 static uint32_t tailAddress = 0;
 
+// Rolling mode settings, rolling mode is disabled when eraseAheadSectors is zero
+static uint8_t eraseAheadSectors = 0;
+static bool wrapWhenFull = false;
+
+/*
+ * In rolling mode, the number of bytes starting at tailAddress (and wrapping around the end of the device if
+ * wrapping is enabled) that are known to be erased. tailAddress + erasedBytesAhead always lies on a sector boundary
+ * so that the next sector to be erased can be found from it.
+ */
+static uint32_t erasedBytesAhead = 0;
+
+// How long we're prepared to wait for a sector erase to complete when a synchronous write needs one
+#define FLASHFS_SECTOR_ERASE_TIMEOUT_MILLIS 5000
+
 static void flashfsClearBuffer()
 {
     bufferTail = bufferHead = 0;
@@ -60,6 +85,11 @@ static bool flashfsBufferIsEmpty()
     return bufferTail == bufferHead;
 }
 
+static bool flashfsIsRolling()
+{
+    return eraseAheadSectors > 0;
+}
+
 static void flashfsSetTailAddress(uint32_t address)
 {
     tailAddress = address;
@@ -72,6 +102,8 @@ void flashfsEraseCompletely()
     flashfsClearBuffer();
 
     flashfsSetTailAddress(0);
+
+    erasedBytesAhead = flashfsGetSize();
 }
 
 /**
@@ -143,6 +175,49 @@ const flashGeometry_t* flashfsGetGeometry()
     return m25p16_getGeometry();
 }
 
+/**
+ * Erase the sector which follows the erased region ahead of the write pointer, extending the erased region by one
+ * sector. This waits for the device to become ready first, so callers which mustn't block should check
+ * m25p16_isReady() beforehand.
+ *
+ * Returns false if there is no sector which can be erased without destroying the data we're about to write.
+ */
+static bool flashfsEraseNextSector()
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+    uint32_t nextSectorAddress = tailAddress + erasedBytesAhead;
+
+    if (geometry->sectorSize == 0) {
+        return false;
+    }
+
+    if (wrapWhenFull) {
+        /*
+         * The sector which holds the byte just before the tail holds our most recent data, so the erased region
+         * can't wrap around into it.
+         */
+        uint32_t recentBytes = tailAddress % geometry->sectorSize;
+
+        if (recentBytes == 0) {
+            recentBytes = geometry->sectorSize;
+        }
+
+        if (erasedBytesAhead + geometry->sectorSize + recentBytes > geometry->totalSize) {
+            return false;
+        }
+
+        nextSectorAddress %= geometry->totalSize;
+    } else if (nextSectorAddress >= geometry->totalSize) {
+        return false;
+    }
+
+    m25p16_eraseSector(nextSectorAddress);
+
+    erasedBytesAhead += geometry->sectorSize;
+
+    return true;
+}
+
 /**
  * Write the given buffers to flash sequentially at the current tail address, advancing the tail address after
  * each write.
@@ -200,6 +275,23 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
             break;
         }
 
+        if (flashfsIsRolling()) {
+            if (erasedBytesAhead == 0) {
+                /*
+                 * We've caught up with the erase-ahead process. Asynchronous writers will have to wait for it, but
+                 * synchronous writes mustn't be dropped so erase the next sector ourselves.
+                 */
+                if (!sync || !flashfsEraseNextSector() || !m25p16_waitForReady(FLASHFS_SECTOR_ERASE_TIMEOUT_MILLIS)) {
+                    break;
+                }
+            }
+
+            // Never write past the end of the erased region
+            if (bytesTotalThisIteration > erasedBytesAhead) {
+                bytesTotalThisIteration = erasedBytesAhead;
+            }
+        }
+
         m25p16_pageProgramBegin(tailAddress);
 
         bytesRemainThisIteration = bytesTotalThisIteration;
@@ -234,6 +326,15 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
         // Advance the cursor in the file system to match the bytes we wrote
         flashfsSetTailAddress(tailAddress + bytesTotalThisIteration);
 
+        if (flashfsIsRolling()) {
+            erasedBytesAhead -= bytesTotalThisIteration;
+
+            // Writes never cross a page boundary, so we land exactly on the end of the device
+            if (wrapWhenFull && tailAddress >= flashfsGetSize()) {
+                flashfsSetTailAddress(0);
+            }
+        }
+
         /*
          * We'll have to wait for that write to complete before we can issue the next one, so if
          * the user requested asynchronous writes, break now.
@@ -342,18 +443,32 @@ void flashfsFlushSync()
     flashfsClearBuffer();
 }
 
+/**
+ * Only the part of the erased region that lies ahead of the new tail address remains usable after a seek.
+ */
+static void flashfsSeekInErasedRegion(uint32_t offset)
+{
+    if (offset >= tailAddress && offset - tailAddress <= erasedBytesAhead) {
+        erasedBytesAhead -= offset - tailAddress;
+    } else {
+        erasedBytesAhead = 0;
+    }
+
+    flashfsSetTailAddress(offset);
+}
+
 void flashfsSeekAbs(uint32_t offset)
 {
     flashfsFlushSync();
 
-    flashfsSetTailAddress(offset);
+    flashfsSeekInErasedRegion(offset);
 }
 
 void flashfsSeekRel(int32_t offset)
 {
     flashfsFlushSync();
 
-    flashfsSetTailAddress(tailAddress + offset);
+    flashfsSeekInErasedRegion(tailAddress + offset);
 }
 
 /**
@@ -479,60 +594,65 @@ int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
     return bytesRead;
 }
 
-/**
- * Find the offset of the start of the free space on the device (or the size of the device if it is full).
- */
-int flashfsIdentifyStartOfFreeSpace()
-{
-    /* Find the start of the free space on the device by examining the beginning of blocks with a binary search,
-     * looking for ones that appear to be erased. We can achieve this with good accuracy because an erased block
-     * is all bits set to 1, which pretty much never appears in reasonable size substrings of blackbox logs.
-     *
-     * To do better we might write a volume header instead, which would mark how much free space remains. But keeping
-     * a header up to date while logging would incur more writes to the flash, which would consume precious write
-     * bandwidth and block more often.
+enum {
+    /* We can choose whatever power of 2 size we like, which determines how much wastage of free space we'll have
+     * at the end of the last written data. But smaller blocksizes will require more searching.
      */
+    FREE_BLOCK_SIZE = 2048,
 
-    enum {
-        /* We can choose whatever power of 2 size we like, which determines how much wastage of free space we'll have
-         * at the end of the last written data. But smaller blocksizes will require more searching.
-         */
-        FREE_BLOCK_SIZE = 2048,
-
-        /* We don't expect valid data to ever contain this many consecutive uint32_t's of all 1 bits: */
-        FREE_BLOCK_TEST_SIZE_INTS = 4, // i.e. 16 bytes
-        FREE_BLOCK_TEST_SIZE_BYTES = FREE_BLOCK_TEST_SIZE_INTS * sizeof(uint32_t),
-    };
+    /* We don't expect valid data to ever contain this many consecutive uint32_t's of all 1 bits: */
+    FREE_BLOCK_TEST_SIZE_INTS = 4, // i.e. 16 bytes
+    FREE_BLOCK_TEST_SIZE_BYTES = FREE_BLOCK_TEST_SIZE_INTS * sizeof(uint32_t),
+};
 
+/**
+ * Examine the start of the block at the given address to see if it appears to be erased.
+ *
+ * Returns false if the flash could not be read, otherwise the result of the test is stored in `erased`.
+ */
+static bool flashfsTestBlockErased(uint32_t address, bool *erased)
+{
     union {
         uint8_t bytes[FREE_BLOCK_TEST_SIZE_BYTES];
         uint32_t ints[FREE_BLOCK_TEST_SIZE_INTS];
     } testBuffer;
 
-    int left = 0; // Smallest block index in the search region
-    int right = flashfsGetSize() / FREE_BLOCK_SIZE; // One past the largest block index in the search region
+    if (m25p16_readBytes(address, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
+        return false;
+    }
+
+    // Checking the buffer 4 bytes at a time like this is probably faster than byte-by-byte, but I didn't benchmark it :)
+    *erased = true;
+    for (int i = 0; i < FREE_BLOCK_TEST_SIZE_INTS; i++) {
+        if (testBuffer.ints[i] != 0xFFFFFFFF) {
+            *erased = false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Binary search the blocks in the range [left...right) for the leftmost erased block, assuming that the range
+ * consists of used blocks followed by erased blocks.
+ *
+ * Returns the index of that block, or `right` if no erased block was found.
+ */
+static int flashfsFindFirstErasedBlock(int left, int right)
+{
     int mid;
     int result = right;
-    int i;
     bool blockErased;
 
     while (left < right) {
         mid = (left + right) / 2;
 
-        if (m25p16_readBytes(mid * FREE_BLOCK_SIZE, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
+        if (!flashfsTestBlockErased(mid * FREE_BLOCK_SIZE, &blockErased)) {
             // Unexpected timeout from flash, so bail early (reporting the device fuller than it really is)
             break;
         }
 
-        // Checking the buffer 4 bytes at a time like this is probably faster than byte-by-byte, but I didn't benchmark it :)
-        blockErased = true;
-        for (i = 0; i < FREE_BLOCK_TEST_SIZE_INTS; i++) {
-            if (testBuffer.ints[i] != 0xFFFFFFFF) {
-                blockErased = false;
-                break;
-            }
-        }
-
         if (blockErased) {
             /* This erased block might be the leftmost erased block in the volume, but we'll need to continue the
              * search leftwards to find out:
@@ -545,7 +665,75 @@ int flashfsIdentifyStartOfFreeSpace()
         }
     }
 
-    return result * FREE_BLOCK_SIZE;
+    return result;
+}
+
+/**
+ * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ */
+int flashfsIdentifyStartOfFreeSpace()
+{
+    /* Find the start of the free space on the device by examining the beginning of blocks with a binary search,
+     * looking for ones that appear to be erased. We can achieve this with good accuracy because an erased block
+     * is all bits set to 1, which pretty much never appears in reasonable size substrings of blackbox logs.
+     *
+     * To do better we might write a volume header instead, which would mark how much free space remains. But keeping
+     * a header up to date while logging would incur more writes to the flash, which would consume precious write
+     * bandwidth and block more often.
+     */
+    return flashfsFindFirstErasedBlock(0, flashfsGetSize() / FREE_BLOCK_SIZE) * FREE_BLOCK_SIZE;
+}
+
+/**
+ * Find the start of the free space on a device that was written in rolling mode, or the size of the device if no
+ * erased sector could be found.
+ *
+ * The device then doesn't consist of data followed by free space, since old data might follow the erased region
+ * or the log might have wrapped around, so the binary search can't be used across the whole device. Instead, find the
+ * first sector of the erased region, then search the sector before it for the exact end of the data.
+ */
+static uint32_t flashfsIdentifyStartOfRollingFreeSpace()
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+    const int blocksPerSector = geometry->sectorSize / FREE_BLOCK_SIZE;
+    bool erased;
+
+    for (int sector = 0; sector < geometry->sectors; sector++) {
+        if (!flashfsTestBlockErased(sector * geometry->sectorSize, &erased)) {
+            break;
+        }
+
+        if (!erased) {
+            continue;
+        }
+
+        // If the erased region begins at sector 0, it might have wrapped around from the end of the device
+        int firstErasedSector = sector;
+        int previousSector = (firstErasedSector + geometry->sectors - 1) % geometry->sectors;
+
+        while (previousSector != sector
+            && flashfsTestBlockErased(previousSector * geometry->sectorSize, &erased) && erased) {
+            firstErasedSector = previousSector;
+            previousSector = (firstErasedSector + geometry->sectors - 1) % geometry->sectors;
+        }
+
+        if (previousSector == sector) {
+            // The whole device is erased
+            return 0;
+        }
+
+        // The data might end partway through the sector before the erased region
+        int firstBlock = previousSector * blocksPerSector;
+        int freeBlock = flashfsFindFirstErasedBlock(firstBlock, firstBlock + blocksPerSector);
+
+        if (freeBlock == firstBlock + blocksPerSector) {
+            return firstErasedSector * geometry->sectorSize;
+        }
+
+        return freeBlock * FREE_BLOCK_SIZE;
+    }
+
+    return flashfsGetSize();
 }
 
 /**
@@ -555,6 +743,41 @@ bool flashfsIsEOF() {
     return tailAddress >= flashfsGetSize();
 }
 
+/**
+ * In rolling mode, keep the configured number of sectors erased ahead of the write pointer.
+ *
+ * This never waits for the flash, so it can be called periodically from a low priority task. Buffered data is
+ * flushed in preference to starting an erase, since the device can't accept writes until an erase completes.
+ */
+void flashfsEraseAhead()
+{
+    if (!flashfsIsRolling() || !m25p16_isReady()) {
+        return;
+    }
+
+    if (!flashfsBufferIsEmpty() && erasedBytesAhead > 0) {
+        flashfsFlushAsync();
+        return;
+    }
+
+    if (erasedBytesAhead < eraseAheadSectors * m25p16_getGeometry()->sectorSize) {
+        flashfsEraseNextSector();
+    }
+}
+
+/**
+ * Enable rolling mode with the given number of sectors to erase ahead of the write pointer (or disable it if zero).
+ *
+ * If `wrap` is true, writing continues at the start of the device when the end is reached.
+ *
+ * Call before flashfsInit().
+ */
+void flashfsSetRollingMode(uint8_t sectors, bool wrap)
+{
+    eraseAheadSectors = sectors;
+    wrapWhenFull = wrap && sectors > 0;
+}
+
 /**
  * Call after initializing the flash chip in order to set up the filesystem.
  */
@@ -562,7 +785,22 @@ void flashfsInit()
 {
     // If we have a flash chip present at all
     if (flashfsGetSize() > 0) {
-        // Start the file pointer off at the beginning of free space so caller can start writing immediately
-        flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace());
+        if (flashfsIsRolling()) {
+            const uint32_t sectorSize = m25p16_getGeometry()->sectorSize;
+            uint32_t startOfFreeSpace = flashfsIdentifyStartOfRollingFreeSpace();
+
+            if (startOfFreeSpace >= flashfsGetSize() && wrapWhenFull) {
+                // No free space at all, so start overwriting from the beginning of the device
+                startOfFreeSpace = 0;
+            }
+
+            flashfsSeekAbs(startOfFreeSpace);
+
+            // We only know that the remainder of the sector the free space begins in is erased
+            erasedBytesAhead = (sectorSize - startOfFreeSpace % sectorSize) % sectorSize;
+        } else {
+            // Start the file pointer off at the beginning of free space so caller can start writing immediately
+            flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace());
+        }
     }
 }
@@ -48,6 +48,9 @@ int flashfsReadAbs(uint32_t offset, uint8_t *data, unsigned int len);
 bool flashfsFlushAsync();
 void flashfsFlushSync();
 
+void flashfsEraseAhead();
+
+void flashfsSetRollingMode(uint8_t sectors, bool wrap);
 void flashfsInit();
 
 bool flashfsIsReady();
@@ -35,7 +35,6 @@
 
 #include "drivers/system.h"
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "drivers/gpio.h"
 #include "drivers/light_led.h"
 
@@ -63,6 +62,7 @@
 #define LOG_UBLOX_SVINFO 'I'
 #define LOG_UBLOX_POSLLH 'P'
 #define LOG_UBLOX_VELNED 'V'
+#define LOG_UBLOX_PVT    'T'
 
 #define GPS_SV_MAXSATS   16
 
@@ -82,6 +82,9 @@ uint8_t GPS_update = 0;             // it's a binary toggle to distinct a GPS po
 uint16_t GPS_altitude;              // altitude in 0.1m
 uint16_t GPS_speed;                 // speed in 0.1m/s
 uint16_t GPS_ground_course = 0;     // degrees * 10
+int16_t GPS_velned[3];              // cm/s
+uint32_t GPS_timeOfWeek;            // milliseconds
+bool GPS_velnedValid;
 
 uint8_t GPS_numCh;                          // Number of channels
 uint8_t GPS_svinfo_chn[GPS_SV_MAXSATS];     // Channel number
@@ -135,8 +138,11 @@ static const uint8_t ubloxInit[] = {
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x00, 0x00, 0xFA, 0x0F,           // GGA: Global positioning system fix data
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x02, 0x00, 0xFC, 0x13,           // GSA: GNSS DOP and Active Satellites
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x04, 0x00, 0xFE, 0x17,           // RMC: Recommended Minimum data
+};
 
-    // Enable UBLOX messages
+// Message rates for the separate POSLLH, STATUS, SOL and VELNED messages, which every u-blox receiver supports
+static const uint8_t ubloxInitMessages[] = {
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x07, 0x00, 0x12, 0x50,           // disable PVT MSG
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x02, 0x01, 0x0E, 0x47,           // set POSLLH MSG rate
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x03, 0x01, 0x0F, 0x49,           // set STATUS MSG rate
     0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x06, 0x01, 0x12, 0x4F,           // set SOL MSG rate
@@ -147,6 +153,18 @@ static const uint8_t ubloxInit[] = {
     0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xC8, 0x00, 0x01, 0x00, 0x01, 0x00, 0xDE, 0x6A,             // set rate to 5Hz (measurement period: 200ms, navigation rate: 1 cycle)
 };
 
+// Message rates for NAV-PVT (u-blox 7 and later), which carries the whole solution for a navigation epoch in one message
+static const uint8_t ubloxInitNavPvt[] = {
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x02, 0x00, 0x0D, 0x46,           // disable POSLLH MSG
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x03, 0x00, 0x0E, 0x48,           // disable STATUS MSG
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x06, 0x00, 0x11, 0x4E,           // disable SOL MSG
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x12, 0x00, 0x1D, 0x66,           // disable VELNED MSG
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x30, 0x0A, 0x45, 0xAC,           // set SVINFO MSG rate (every 10 cycles - 1Hz)
+    0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x07, 0x01, 0x13, 0x51,           // set PVT MSG rate
+
+    0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0x64, 0x00, 0x01, 0x00, 0x01, 0x00, 0x7A, 0x12,             // set rate to 10Hz (measurement period: 100ms, navigation rate: 1 cycle)
+};
+
 // UBlox 6 Protocol documentation - GPS.G6-SW-10018-F
 // SBAS Configuration Settings Desciption, Page 4/210
 // 31.21 CFG-SBAS (0x06 0x16), Page 142/210
@@ -367,6 +385,23 @@ void gpsInitUblox(void)
                 }
             }
 
+            if (gpsData.messageState == GPS_MESSAGE_STATE_MESSAGES) {
+                const uint8_t *messages = ubloxInitMessages;
+                uint32_t messagesLength = sizeof(ubloxInitMessages);
+                if (gpsConfig->ubloxNavPvt == GPS_NAV_PVT_ON) {
+                    messages = ubloxInitNavPvt;
+                    messagesLength = sizeof(ubloxInitNavPvt);
+                }
+
+                if (gpsData.state_position < messagesLength) {
+                    serialWrite(gpsPort, messages[gpsData.state_position]);
+                    gpsData.state_position++;
+                } else {
+                    gpsData.state_position = 0;
+                    gpsData.messageState++;
+                }
+            }
+
             if (gpsData.messageState == GPS_MESSAGE_STATE_SBAS) {
                 if (gpsData.state_position < UBLOX_SBAS_MESSAGE_LENGTH) {
                     serialWrite(gpsPort, ubloxSbas[gpsConfig->sbasMode].message[gpsData.state_position]);
@@ -401,8 +436,13 @@ void gpsThread(void)
 {
     // read out available GPS bytes
     if (gpsPort) {
-        while (serialRxBytesWaiting(gpsPort))
-            gpsNewData(serialRead(gpsPort));
+        uint8_t rxChunk[32];
+        int count;
+        while ((count = serialReadBuf(gpsPort, rxChunk, sizeof(rxChunk))) > 0) {
+            for (int i = 0; i < count; i++) {
+                gpsNewData(rxChunk[i]);
+            }
+        }
     }
 
     switch (gpsData.state) {
@@ -560,6 +600,7 @@ static uint32_t grab_fields(char *src, uint8_t mult)
 }
 
 typedef struct gpsDataNmea_s {
+    bool fix;
     int32_t latitude;
     int32_t longitude;
     uint8_t numSat;
@@ -618,11 +659,7 @@ static bool gpsNewFrameNMEA(char c)
                                 gps_Msg.longitude *= -1;
                             break;
                         case 6:
-                            if (string[0] > '0') {
-                                ENABLE_STATE(GPS_FIX);
-                            } else {
-                                DISABLE_STATE(GPS_FIX);
-                            }
+                            gps_Msg.fix = string[0] > '0';
                             break;
                         case 7:
                             gps_Msg.numSat = grab_fields(string, 0);
@@ -663,7 +700,7 @@ static bool gpsNewFrameNMEA(char c)
                     svSatNum    = svPacketIdx + (4 * (svMessageNum - 1)); // global satellite number
                     svSatParam  = param - 3 - (4 * (svPacketIdx - 1)); // parameter number for satellite
 
-                    if(svSatNum > GPS_SV_MAXSATS)
+                    if(svSatNum == 0 || svSatNum > GPS_SV_MAXSATS)    // from a message number of 0, or one past the end
                         break;
 
                     switch(svSatParam) {
@@ -709,11 +746,17 @@ static bool gpsNewFrameNMEA(char c)
                     case FRAME_GGA:
                       *gpsPacketLogChar = LOG_NMEA_GGA;
                       frameOK = 1;
+                      if (gps_Msg.fix) {
+                            ENABLE_STATE(GPS_FIX);
+                        } else {
+                            DISABLE_STATE(GPS_FIX);
+                        }
                       if (STATE(GPS_FIX)) {
                             GPS_coord[LAT] = gps_Msg.latitude;
                             GPS_coord[LON] = gps_Msg.longitude;
                             GPS_numSat = gps_Msg.numSat;
                             GPS_altitude = gps_Msg.altitude;
+                            GPS_velnedValid = false;
                         }
                         break;
                     case FRAME_RMC:
@@ -729,7 +772,7 @@ static bool gpsNewFrameNMEA(char c)
             checksum_param = 0;
             break;
         default:
-            if (offset < 15)
+            if (offset < sizeof(string) - 1)     // leave room for the terminator
                 string[offset++] = c;
             if (!checksum_param)
                 parity ^= c;
@@ -798,6 +841,40 @@ typedef struct {
     uint32_t heading_accuracy;
 } ubx_nav_velned;
 
+// Laid out so that every field is naturally aligned, so it can be read in place from the receive buffer
+typedef struct {
+    uint32_t time;              // GPS msToW
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t valid;
+    uint32_t time_accuracy;     // ns
+    int32_t time_nsec;
+    uint8_t fix_type;
+    uint8_t fix_status;
+    uint8_t fix_status2;
+    uint8_t satellites;
+    int32_t longitude;
+    int32_t latitude;
+    int32_t altitude_ellipsoid; // mm
+    int32_t altitude_msl;       // mm
+    uint32_t horizontal_accuracy;
+    uint32_t vertical_accuracy;
+    int32_t ned_north;          // mm/s
+    int32_t ned_east;
+    int32_t ned_down;
+    int32_t speed_2d;           // mm/s
+    int32_t heading_2d;         // deg * 100000
+    uint32_t speed_accuracy;
+    uint32_t heading_accuracy;
+    uint16_t position_DOP;
+    uint8_t res[6];
+    // u-blox 8 and later add heading of vehicle and magnetic declination here, which we don't use
+} ubx_nav_pvt;
+
 typedef struct {
     uint8_t chn;                // Channel number, 255 for SVx not assigned to channel
     uint8_t svid;               // Satellite ID
@@ -828,6 +905,7 @@ enum {
     MSG_POSLLH = 0x2,
     MSG_STATUS = 0x3,
     MSG_SOL = 0x6,
+    MSG_PVT = 0x7,
     MSG_VELNED = 0x12,
     MSG_SVINFO = 0x30,
     MSG_CFG_PRT = 0x00,
@@ -884,6 +962,8 @@ static bool _new_speed;
 // from the UBlox6 document, the largest payout we receive i the NAV-SVINFO and the payload size
 // is calculated as 8 + 12*numCh.  numCh in the case of a Glonass receiver is 28.
 #define UBLOX_PAYLOAD_SIZE 344
+// numCh is a byte, so no message we could be sent is longer than a NAV-SVINFO for 255 channels
+#define UBLOX_MAX_PAYLOAD_LENGTH (8 + 12 * 255)
 
 
 // Receive buffer
@@ -892,6 +972,7 @@ static union {
     ubx_nav_status status;
     ubx_nav_solution solution;
     ubx_nav_velned velned;
+    ubx_nav_pvt pvt;
     ubx_nav_svinfo svinfo;
     uint8_t bytes[UBLOX_PAYLOAD_SIZE];
 } _buffer;
@@ -919,6 +1000,7 @@ static bool UBLOX_parse_gps(void)
         GPS_coord[LON] = _buffer.posllh.longitude;
         GPS_coord[LAT] = _buffer.posllh.latitude;
         GPS_altitude = _buffer.posllh.altitude_msl / 10 / 100;  //alt in m
+        GPS_velnedValid = false;
         if (next_fix) {
             ENABLE_STATE(GPS_FIX);
         } else {
@@ -947,6 +1029,31 @@ static bool UBLOX_parse_gps(void)
         GPS_ground_course = (uint16_t) (_buffer.velned.heading_2d / 10000);     // Heading 2D deg * 100000 rescaled to deg * 10
         _new_speed = true;
         break;
+    case MSG_PVT:
+        *gpsPacketLogChar = LOG_UBLOX_PVT;
+        if (_payload_length < sizeof(ubx_nav_pvt)) {
+            return false;
+        }
+        // One message carries the whole navigation epoch, so there is nothing to wait for
+        if ((_buffer.pvt.fix_status & NAV_STATUS_FIX_VALID) && (_buffer.pvt.fix_type == FIX_3D)) {
+            ENABLE_STATE(GPS_FIX);
+        } else {
+            DISABLE_STATE(GPS_FIX);
+        }
+        GPS_timeOfWeek = _buffer.pvt.time;
+        GPS_numSat = _buffer.pvt.satellites;
+        GPS_coord[LON] = _buffer.pvt.longitude;
+        GPS_coord[LAT] = _buffer.pvt.latitude;
+        GPS_altitude = _buffer.pvt.altitude_msl / 1000;  // alt in m
+        GPS_hdop = _buffer.pvt.position_DOP;
+        GPS_velned[VEL_NORTH] = _buffer.pvt.ned_north / 10;      // cm/s
+        GPS_velned[VEL_EAST] = _buffer.pvt.ned_east / 10;
+        GPS_velned[VEL_DOWN] = _buffer.pvt.ned_down / 10;
+        GPS_velnedValid = true;
+        GPS_speed = _buffer.pvt.speed_2d / 10;  // cm/s
+        GPS_ground_course = (uint16_t) (_buffer.pvt.heading_2d / 10000);     // Heading 2D deg * 100000 rescaled to deg * 10
+        _new_speed = _new_position = false;
+        return true;
     case MSG_SVINFO:
         *gpsPacketLogChar = LOG_UBLOX_SVINFO;
         GPS_numCh = _buffer.svinfo.numCh;
@@ -1010,8 +1117,14 @@ static bool gpsNewFrameUBLOX(uint8_t data)
             _step++;
             _ck_b += (_ck_a += data);       // checksum byte
             _payload_length += (uint16_t)(data << 8);
+            if (_payload_length > UBLOX_MAX_PAYLOAD_LENGTH) {
+                // A corrupt length, so look for the next message rather than count out up to 64K bytes
+                _step = 0;
+                gpsData.errors++;
+                break;
+            }
             if (_payload_length > UBLOX_PAYLOAD_SIZE) {
-                _skip_packet = true;
+                _skip_packet = true;    // e.g. NAV-SVINFO from a receiver tracking more than 28 satellites
             }
             _payload_counter = 0;   // prepare to receive payload
             if (_payload_length == 0) {
@@ -20,6 +20,10 @@
 #define LAT 0
 #define LON 1
 
+#define VEL_NORTH 0
+#define VEL_EAST  1
+#define VEL_DOWN  2
+
 #define GPS_DEGREES_DIVIDER 10000000L
 
 typedef enum {
@@ -57,6 +61,11 @@ typedef enum {
     GPS_AUTOBAUD_ON
 } gpsAutoBaud_e;
 
+typedef enum {
+    GPS_NAV_PVT_OFF = 0,
+    GPS_NAV_PVT_ON
+} gpsNavPvt_e;
+
 #define GPS_BAUDRATE_MAX GPS_BAUDRATE_9600
 
 typedef struct gpsConfig_s {
@@ -64,6 +73,7 @@ typedef struct gpsConfig_s {
     sbasMode_e sbasMode;
     gpsAutoConfig_e autoConfig;
     gpsAutoBaud_e autoBaud;
+    gpsNavPvt_e ubloxNavPvt;        // Ask u-blox receivers for NAV-PVT at 10Hz instead of separate messages at 5Hz
 } gpsConfig_t;
 
 typedef struct gpsCoordinateDDDMMmmmm_s {
@@ -75,6 +85,7 @@ typedef struct gpsCoordinateDDDMMmmmm_s {
 typedef enum {
     GPS_MESSAGE_STATE_IDLE = 0,
     GPS_MESSAGE_STATE_INIT,
+    GPS_MESSAGE_STATE_MESSAGES,
     GPS_MESSAGE_STATE_SBAS,
     GPS_MESSAGE_STATE_MAX = GPS_MESSAGE_STATE_SBAS
 } gpsMessageState_e;
@@ -108,6 +119,9 @@ extern uint32_t GPS_svInfoReceivedCount;
 extern uint16_t GPS_altitude;              // altitude in 0.1m
 extern uint16_t GPS_speed;                 // speed in 0.1m/s
 extern uint16_t GPS_ground_course;         // degrees * 10
+extern int16_t GPS_velned[3];              // north, east and down speed in cm/s
+extern uint32_t GPS_timeOfWeek;            // GPS time of week of the fix in milliseconds
+extern bool GPS_velnedValid;               // GPS_velned and GPS_timeOfWeek came from the same navigation epoch as GPS_coord
 extern uint8_t GPS_numCh;                  // Number of channels
 extern uint8_t GPS_svinfo_chn[16];         // Channel number
 extern uint8_t GPS_svinfo_svid[16];        // Satellite ID
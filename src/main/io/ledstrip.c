@@ -95,6 +95,8 @@ static void ledStripDisable(void);
 #define LED_STRIP_HZ(hz) ((int32_t)((1000 * 1000) / (hz)))
 #define LED_STRIP_MS(ms) ((int32_t)(1000 * (ms)))
 
+#define LED_STRIP_RESEND_PERIOD LED_STRIP_MS(1000)  // how often the whole strip is sent again
+
 #if LED_MAX_STRIP_LENGTH > WS2811_LED_STRIP_LENGTH
 # error "Led strip length must match driver"
 #endif
@@ -898,6 +900,7 @@ typedef enum {
 } timId_e;
 
 static uint32_t timerVal[timTimerCount];
+static uint32_t nextResendAt;
 
 // function to apply layer.
 // function must replan self using timer pointer
@@ -953,7 +956,14 @@ void updateLedStrip(void)
         }
     }
 
-    if (!timActive)
+    // only changed LEDs are sent, so LEDs powered up after the FC, or upset by noise, would otherwise stay wrong
+    bool resend = cmp32(now, nextResendAt) >= 0;
+    if (resend) {
+        nextResendAt = now + LED_STRIP_RESEND_PERIOD;
+        ws2811ResendStrip();
+    }
+
+    if (!timActive && !resend)
         return;          // no change this update, keep old state
 
     // apply all layers; triggered timed functions has to update timers
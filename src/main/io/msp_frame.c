@@ -0,0 +1,281 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Receives MSP command frames from the host. Both framings can be used on the same port, and the reply is sent using
+ * the same framing as the command:
+ *
+ * MSPv1: '$' 'M' '<' size8 cmd8 payload checksum8                  (checksum is XOR of size, cmd and payload)
+ * MSPv2: '$' 'X' '<' flags8 cmd16 size16 payload checksum8         (checksum is CRC8-DVB-S2 of flags to payload)
+ *
+ * MSPv2 fields are little-endian.
+ *
+ * Replies are built in a buffer with room left at the front for the header. The header and checksum are filled in
+ * once the handler has finished, so the reply reaches the port in a single write whatever its size turned out to be.
+ * Replies that are declared too large for the buffer are streamed instead, with the declared size in the header.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "msp_frame.h"
+
+/**
+ * Feed one received byte to the port's frame parser. Returns false if the byte wasn't part of an MSP frame, so that
+ * it can be offered to other protocols (e.g. the CLI) sharing the port.
+ *
+ * Once a complete frame with a valid checksum arrives the port's state becomes COMMAND_RECEIVED. Frames with payloads
+ * too large for the port's buffer are dropped.
+ */
+bool mspFrameProcessReceivedData(mspPort_t *mspPort, uint8_t c)
+{
+    if (mspPort->c_state == IDLE) {
+        if (c == '$') {
+            mspPort->c_state = HEADER_START;
+        } else {
+            return false;
+        }
+    } else if (mspPort->c_state == HEADER_START) {
+        if (c == 'M') {
+            mspPort->c_state = HEADER_M;
+        } else if (c == 'X') {
+            mspPort->c_state = HEADER_X;
+        } else {
+            mspPort->c_state = IDLE;
+        }
+    } else if (mspPort->c_state == HEADER_M) {
+        mspPort->c_state = (c == '<') ? HEADER_ARROW : IDLE;
+    } else if (mspPort->c_state == HEADER_ARROW) {
+        uint16_t dataSize = c;
+
+        if (dataSize > MSP_PORT_INBUF_SIZE) {
+            mspPort->c_state = IDLE;
+
+        } else {
+            mspPort->mspVersion = MSP_V1;
+            mspPort->dataSize = dataSize;
+            mspPort->offset = 0;
+            mspPort->checksum = 0;
+            mspPort->indRX = 0;
+            mspPort->checksum ^= c;
+            mspPort->c_state = HEADER_SIZE;
+        }
+    } else if (mspPort->c_state == HEADER_SIZE) {
+        mspPort->cmdMSP = c;
+        mspPort->checksum ^= c;
+        mspPort->c_state = HEADER_CMD;
+    } else if (mspPort->c_state == HEADER_X) {
+        if (c == '<') {
+            mspPort->mspVersion = MSP_V2;
+            mspPort->offset = 0;
+            mspPort->checksum = 0;
+            mspPort->indRX = 0;
+            mspPort->c_state = HEADER_V2_NATIVE;
+        } else {
+            mspPort->c_state = IDLE;
+        }
+    } else if (mspPort->c_state == HEADER_V2_NATIVE) {
+        // The header is collected in the payload buffer, and the payload then overwrites it
+        mspPort->checksum = crc8DvbS2(mspPort->checksum, c);
+        mspPort->inBuf[mspPort->offset++] = c;
+
+        if (mspPort->offset == MSP_V2_HEADER_SIZE) {
+            // inBuf[0] holds the flags, which no command uses yet
+            uint16_t dataSize = mspPort->inBuf[3] | (mspPort->inBuf[4] << 8);
+
+            if (dataSize > MSP_PORT_INBUF_SIZE) {
+                mspPort->c_state = IDLE;
+            } else {
+                mspPort->cmdMSP = mspPort->inBuf[1] | (mspPort->inBuf[2] << 8);
+                mspPort->dataSize = dataSize;
+                mspPort->offset = 0;
+                mspPort->c_state = HEADER_CMD;
+            }
+        }
+    } else if (mspPort->c_state == HEADER_CMD && mspPort->offset < mspPort->dataSize) {
+        mspPort->checksum = mspChecksumUpdate(mspPort->mspVersion, mspPort->checksum, c);
+        mspPort->inBuf[mspPort->offset++] = c;
+    } else if (mspPort->c_state == HEADER_CMD && mspPort->offset >= mspPort->dataSize) {
+        if (mspPort->checksum == c) {
+            mspPort->c_state = COMMAND_RECEIVED;
+        } else {
+            mspPort->c_state = IDLE;
+        }
+    }
+    return true;
+}
+
+static uint8_t mspChecksumUpdateBuf(mspVersion_e mspVersion, uint8_t checksum, const uint8_t *data, int len)
+{
+    if (mspVersion == MSP_V2) {
+        return crc8DvbS2Update(checksum, data, len);
+    }
+
+    for (int i = 0; i < len; i++) {
+        checksum ^= data[i];
+    }
+
+    return checksum;
+}
+
+/**
+ * Write the reply header to `header`, returning its length. The checksum covers the header from the size/flags byte.
+ */
+static int mspReplyWriteHeader(const mspReply_t *reply, uint16_t size, uint8_t *header)
+{
+    int length = 0;
+
+    header[length++] = '$';
+    header[length++] = reply->mspVersion == MSP_V2 ? 'X' : 'M';
+    header[length++] = reply->error ? '!' : '>';
+
+    if (reply->mspVersion == MSP_V2) {
+        header[length++] = 0; // flags
+        header[length++] = reply->cmdMSP & 0xFF;
+        header[length++] = reply->cmdMSP >> 8;
+        header[length++] = size & 0xFF;
+        header[length++] = size >> 8;
+    } else if (size < JUMBO_FRAME_SIZE_LIMIT) {
+        header[length++] = size;
+        header[length++] = reply->cmdMSP;
+    } else {
+        header[length++] = JUMBO_FRAME_SIZE_LIMIT;
+        header[length++] = reply->cmdMSP;
+        header[length++] = size & 0xFF;
+        header[length++] = size >> 8;
+    }
+
+    return length;
+}
+
+static void mspReplyFlush(mspReply_t *reply)
+{
+    if (reply->length > 0) {
+        reply->write(reply->writeArg, reply->buf, reply->length);
+        reply->length = 0;
+    }
+}
+
+void mspReplyInit(mspReply_t *reply, uint8_t *buf, uint16_t capacity, mspReplyWrite_t write, void *writeArg)
+{
+    memset(reply, 0, sizeof(*reply));
+
+    reply->buf = buf;
+    reply->capacity = capacity;
+    reply->write = write;
+    reply->writeArg = writeArg;
+}
+
+/**
+ * Start a reply to the given command. `sizeHint` is only used if it's too large to buffer the reply, in which case
+ * the reply must be exactly that size.
+ *
+ * Returns false and leaves the reply alone if one has already been started, so the first header a handler sends
+ * (typically an error) is the one the host sees.
+ */
+bool mspReplyBegin(mspReply_t *reply, mspVersion_e mspVersion, uint16_t cmdMSP, bool error, uint16_t sizeHint)
+{
+    if (reply->active) {
+        return false;
+    }
+
+    reply->active = true;
+    reply->mspVersion = mspVersion;
+    reply->cmdMSP = cmdMSP;
+    reply->error = error;
+    reply->overflow = false;
+    reply->streaming = sizeHint > reply->capacity - MSP_REPLY_HEADER_MAX_SIZE - 1;
+
+    if (reply->streaming) {
+        reply->length = mspReplyWriteHeader(reply, sizeHint, reply->buf);
+        reply->checksum = mspChecksumUpdateBuf(mspVersion, 0, reply->buf + 3, reply->length - 3);
+    } else {
+        reply->length = MSP_REPLY_HEADER_MAX_SIZE;
+    }
+
+    return true;
+}
+
+void mspReplyAppend(mspReply_t *reply, uint8_t data)
+{
+    if (reply->streaming) {
+        if (reply->length == reply->capacity) {
+            mspReplyFlush(reply);
+        }
+        reply->checksum = mspChecksumUpdate(reply->mspVersion, reply->checksum, data);
+    } else if (reply->length >= reply->capacity - 1) {
+        // Leave room for the checksum
+        reply->overflow = true;
+        return;
+    }
+
+    reply->buf[reply->length++] = data;
+}
+
+/**
+ * Append a block of data to the reply. Streamed replies send it straight from the caller's memory.
+ */
+void mspReplyAppendBuf(mspReply_t *reply, const uint8_t *data, int len)
+{
+    if (reply->streaming) {
+        mspReplyFlush(reply);
+
+        reply->checksum = mspChecksumUpdateBuf(reply->mspVersion, reply->checksum, data, len);
+        reply->write(reply->writeArg, data, len);
+    } else if (reply->length + len > reply->capacity - 1) {
+        reply->overflow = true;
+    } else {
+        memcpy(reply->buf + reply->length, data, len);
+        reply->length += len;
+    }
+}
+
+/**
+ * Fill in the header and checksum and send the reply. A buffered reply that didn't fit is replaced by an empty error
+ * reply rather than being sent truncated.
+ */
+void mspReplyFinish(mspReply_t *reply)
+{
+    if (!reply->active) {
+        return;
+    }
+
+    if (!reply->streaming) {
+        if (reply->overflow) {
+            reply->error = true;
+            reply->length = MSP_REPLY_HEADER_MAX_SIZE;
+        }
+
+        uint8_t header[MSP_REPLY_HEADER_MAX_SIZE];
+        int headerLength = mspReplyWriteHeader(reply, reply->length - MSP_REPLY_HEADER_MAX_SIZE, header);
+        uint8_t *frame = reply->buf + MSP_REPLY_HEADER_MAX_SIZE - headerLength;
+
+        memcpy(frame, header, headerLength);
+
+        reply->checksum = mspChecksumUpdateBuf(reply->mspVersion, 0, frame + 3, reply->buf + reply->length - (frame + 3));
+        reply->buf[reply->length++] = reply->checksum;
+
+        reply->write(reply->writeArg, frame, reply->buf + reply->length - frame);
+        reply->length = 0;
+    } else {
+        mspReplyAppend(reply, reply->checksum);
+        mspReplyFlush(reply);
+    }
+
+    reply->active = false;
+}
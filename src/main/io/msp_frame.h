@@ -0,0 +1,120 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common/crc.h"
+
+typedef enum {
+    IDLE,
+    HEADER_START,
+    HEADER_M,
+    HEADER_ARROW,
+    HEADER_SIZE,
+    HEADER_CMD,
+    HEADER_X,
+    HEADER_V2_NATIVE,
+    COMMAND_RECEIVED
+} mspState_e;
+
+typedef enum {
+    MSP_V1 = 0, // $M, 8-bit command and size, XOR checksum
+    MSP_V2 = 1, // $X, 16-bit command and size, CRC8-DVB-S2
+} mspVersion_e;
+
+// MSPv1 frames at least this long carry their real size as a u16 after the command byte
+#define JUMBO_FRAME_SIZE_LIMIT 255
+
+// Flags, command and payload size
+#define MSP_V2_HEADER_SIZE 5
+
+/*
+ * The largest command payload that can be received. MSPv1 frames can't carry more than 255 bytes, MSPv2 frames can
+ * carry up to this size. Targets may override this to trade RAM for fewer round trips.
+ */
+#ifndef MSP_PORT_INBUF_SIZE
+#ifdef STM32F1
+#define MSP_PORT_INBUF_SIZE 64
+#else
+#define MSP_PORT_INBUF_SIZE 256
+#endif
+#endif
+
+struct serialPort_s;
+
+typedef struct mspPort_s {
+    struct serialPort_s *port; // null when port unused.
+    uint16_t offset;
+    uint16_t dataSize;
+    uint8_t checksum;
+    uint16_t indRX;
+    uint8_t inBuf[MSP_PORT_INBUF_SIZE];
+    mspState_e c_state;
+    mspVersion_e mspVersion;
+    uint16_t cmdMSP;
+} mspPort_t;
+
+static inline uint8_t mspChecksumUpdate(mspVersion_e mspVersion, uint8_t checksum, uint8_t a)
+{
+    return mspVersion == MSP_V2 ? crc8DvbS2(checksum, a) : checksum ^ a;
+}
+
+/*
+ * The largest reply that is assembled in memory before being sent. Larger replies (e.g. dataflash reads) are streamed
+ * to the port and must declare their size up front.
+ */
+#ifndef MSP_PORT_OUTBUF_SIZE
+#ifdef STM32F1
+#define MSP_PORT_OUTBUF_SIZE 128
+#else
+#define MSP_PORT_OUTBUF_SIZE 512
+#endif
+#endif
+
+// '$' 'X' '>' flags cmd16 size16
+#define MSP_REPLY_HEADER_MAX_SIZE 8
+
+typedef void (*mspReplyWrite_t)(void *arg, const uint8_t *data, int len);
+
+typedef struct mspReply_s {
+    uint8_t *buf;
+    uint16_t capacity;
+    uint16_t length;        // Bytes in buf, including any space reserved for the header
+
+    mspReplyWrite_t write;
+    void *writeArg;
+
+    mspVersion_e mspVersion;
+    uint16_t cmdMSP;
+    uint8_t checksum;       // Only kept up to date while streaming
+
+    bool active;
+    bool error;
+    bool streaming;
+    bool overflow;
+} mspReply_t;
+
+bool mspFrameProcessReceivedData(mspPort_t *mspPort, uint8_t c);
+
+void mspReplyInit(mspReply_t *reply, uint8_t *buf, uint16_t capacity, mspReplyWrite_t write, void *writeArg);
+bool mspReplyBegin(mspReply_t *reply, mspVersion_e mspVersion, uint16_t cmdMSP, bool error, uint16_t sizeHint);
+void mspReplyAppend(mspReply_t *reply, uint8_t data);
+void mspReplyAppendBuf(mspReply_t *reply, const uint8_t *data, int len);
+void mspReplyFinish(mspReply_t *reply);
@@ -59,7 +59,7 @@
 #define MSP_PROTOCOL_VERSION                0
 
 #define API_VERSION_MAJOR                   1 // increment when major changes are made
-#define API_VERSION_MINOR                   20 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
+#define API_VERSION_MINOR                   26 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
 
 #define API_VERSION_LENGTH                  2
 
@@ -210,6 +210,14 @@
 #define MSP_SENSOR_CONFIG               96
 #define MSP_SET_SENSOR_CONFIG           97
 
+#define MSP_SDCARD_CACHE_STATS          98 //out message         Get the SD card filesystem cache size and hit/miss/stall counters
+#define MSP_RX_LATENCY                  99 //out message         Get the histogram of latency from RX frames to a stage of the flight loop
+
+#define MSP_SDCARD_LOG_LIST             130 //out message        List a page of the Blackbox logs on the SD card
+#define MSP_SDCARD_LOG_OPEN             131 //out message        Open a log on the SD card for reading (or close it)
+#define MSP_SDCARD_LOG_READ             132 //out message        Read a chunk of the open log
+#define MSP_SUBSCRIPTIONS               133 //out message        Commands whose replies are pushed to this port, and their periods
+
 //
 // OSD specific
 //
@@ -271,6 +279,7 @@
 #define MSP_SET_RESET_CURR_PID   219    //in message          resetting the current pid profile to defaults
 #define MSP_SET_SENSOR_ALIGNMENT 220    //in message          set the orientation of the acc,gyro,mag
 #define MSP_SET_LED_STRIP_MODECOLOR 221 //in  message         Set LED strip mode_color settings
+#define MSP_SET_SUBSCRIPTIONS    222    //in message          Push replies to the given commands to this port periodically
 
 // #define MSP_BIND                 240    //in message          no param
 // #define MSP_ALARMS               242
@@ -119,7 +119,10 @@
 #define MICROSECONDS_IN_A_SECOND (1000 * 1000)
 
 #define OSD_UPDATE_FREQUENCY (MICROSECONDS_IN_A_SECOND / 5)
+#define OSD_HZ(hz) (MICROSECONDS_IN_A_SECOND / (hz))
+#define OSD_ELEMENT_BUDGET 250      // microseconds spent on elements per call, at least one due element is always checked
 #define OSD_LINE_LENGTH 30
+#define OSD_RESYNC_PERIOD (5 * MICROSECONDS_IN_A_SECOND) // how often the whole screen is sent again
 
 #define STICKMIN 10
 #define STICKMAX 90
@@ -131,6 +134,7 @@
 #define AHISIDEBARHEIGHTPOSITION 3
 
 static uint32_t next_osd_update_at = 0;
+static uint32_t next_resync_at     = 0;
 static uint32_t armed_seconds      = 0;
 static uint32_t armed_at           = 0;
 static uint8_t armed               = 0;
@@ -145,6 +149,30 @@ static uint8_t activating_menu     = 0;
 
 static char string_buffer[30];
 
+// What each element was last drawn from, so that it's only drawn again when that changes
+typedef struct osdElementState_s {
+    int32_t value;      // Source value the text on screen was made from
+    int16_t pos;        // Where it was drawn
+    uint8_t length;     // Characters it covers, blanked when the text gets shorter or moves
+    bool drawn;
+    uint32_t due_at;    // When the value is next checked
+} osdElementState_t;
+
+static osdElementState_t osd_element_state[OSD_MAX_ITEMS];
+static uint8_t next_element        = 0;
+static bool showing_elements       = false;
+static bool screen_changed         = false;
+
+static uint8_t blink               = 0;
+static uint8_t arming              = 0;
+
+// Artificial horizon bars on screen, blanked when the horizon moves
+#define AH_BAR_COUNT 8
+static uint16_t ah_bar_pos[AH_BAR_COUNT];
+static uint8_t ah_bar_count        = 0;
+static bool ah_drawn               = false;
+static bool ah_sidebars_drawn      = false;
+
 extern uint16_t rssi;
 
 enum {
@@ -657,10 +685,48 @@ void show_menu(void) {
     max7456_write_string(">", cursor_x + cursor_y * OSD_LINE_LENGTH);
 }
 
-// Write the artifical horizon to the screen buffer
+static void osdDrawArtificialHorizonSidebars(MAX7456_CHAR_TYPE decoration, MAX7456_CHAR_TYPE left, MAX7456_CHAR_TYPE right) {
+    uint16_t position = 194;
+    MAX7456_CHAR_TYPE *screenBuffer = max7456_get_screen_buffer();
+
+    int8_t hudwidth  = AHISIDEBARWIDTHPOSITION;
+    int8_t hudheight = AHISIDEBARHEIGHTPOSITION;
+    for (int8_t X = -hudheight; X <= hudheight; X++) {
+        screenBuffer[position - hudwidth + (X * LINE)] = decoration;
+        screenBuffer[position + hudwidth + (X * LINE)] = decoration;
+    }
+    // AH level indicators
+    screenBuffer[position-hudwidth+1] = left;
+    screenBuffer[position+hudwidth-1] = right;
+}
+
+// Remove the artifical horizon from the screen buffer
+static void osdEraseArtificialHorizon(void) {
+    uint16_t position = 194;
+    MAX7456_CHAR_TYPE *screenBuffer = max7456_get_screen_buffer();
+
+    for (uint8_t i = 0; i < ah_bar_count; i++)
+        screenBuffer[ah_bar_pos[i]] = MAX7456_CHAR(' ');
+    ah_bar_count = 0;
+
+    screenBuffer[position - 1] = MAX7456_CHAR(' ');
+    screenBuffer[position + 1] = MAX7456_CHAR(' ');
+    screenBuffer[position]     = MAX7456_CHAR(' ');
+
+    if (ah_sidebars_drawn) {
+        osdDrawArtificialHorizonSidebars(MAX7456_CHAR(' '), MAX7456_CHAR(' '), MAX7456_CHAR(' '));
+        ah_sidebars_drawn = false;
+    }
+    ah_drawn = false;
+}
+
+// Write the artifical horizon to the screen buffer, if it has moved since it was last written
 void osdDrawArtificialHorizon(int rollAngle, int pitchAngle, uint8_t show_sidebars) {
     uint16_t position = 194;
     MAX7456_CHAR_TYPE *screenBuffer = max7456_get_screen_buffer();
+    uint16_t bar_pos[AH_BAR_COUNT];
+    MAX7456_CHAR_TYPE bar_char[AH_BAR_COUNT];
+    uint8_t bar_count = 0;
 
     if (pitchAngle > AHIPITCHMAX)
         pitchAngle = AHIPITCHMAX;
@@ -671,6 +737,7 @@ void osdDrawArtificialHorizon(int rollAngle, int pitchAngle, uint8_t show_sideba
     if (rollAngle < -AHIROLLMAX)
         rollAngle = -AHIROLLMAX;
 
+    bool moved = !ah_drawn;
     for (uint8_t X = 0; X <= 8; X++) {
         if (X == 4)
             X = 5;
@@ -678,137 +745,397 @@ void osdDrawArtificialHorizon(int rollAngle, int pitchAngle, uint8_t show_sideba
         Y -= pitchAngle / 8;
         Y += 41;
         if (Y >= 0 && Y <= 81) {
-            uint16_t pos = position - 7 + LINE * (Y / 9) + 3 - 4 * LINE + X;
-            screenBuffer[pos] = MAX7456_CHAR(SYM_AH_BAR9_0 + (Y % 9));
+            bar_pos[bar_count] = position - 7 + LINE * (Y / 9) + 3 - 4 * LINE + X;
+            bar_char[bar_count] = MAX7456_CHAR(SYM_AH_BAR9_0 + (Y % 9));
+            if (bar_count >= ah_bar_count || bar_pos[bar_count] != ah_bar_pos[bar_count] || bar_char[bar_count] != screenBuffer[bar_pos[bar_count]])
+                moved = true;
+            bar_count++;
         }
     }
-    screenBuffer[position - 1] = MAX7456_CHAR(SYM_AH_CENTER_LINE);
-    screenBuffer[position + 1] = MAX7456_CHAR(SYM_AH_CENTER_LINE_RIGHT);
-    screenBuffer[position]     = MAX7456_CHAR(SYM_AH_CENTER);
+    if (bar_count != ah_bar_count)
+        moved = true;
+
+    if (moved) {
+        for (uint8_t i = 0; i < ah_bar_count; i++)
+            screenBuffer[ah_bar_pos[i]] = MAX7456_CHAR(' ');
+        for (uint8_t i = 0; i < bar_count; i++) {
+            screenBuffer[bar_pos[i]] = bar_char[i];
+            ah_bar_pos[i] = bar_pos[i];
+        }
+        ah_bar_count = bar_count;
 
-    if (show_sidebars) {
+        screenBuffer[position - 1] = MAX7456_CHAR(SYM_AH_CENTER_LINE);
+        screenBuffer[position + 1] = MAX7456_CHAR(SYM_AH_CENTER_LINE_RIGHT);
+        screenBuffer[position]     = MAX7456_CHAR(SYM_AH_CENTER);
+        ah_drawn = true;
+    }
+
+    if (show_sidebars && !ah_sidebars_drawn) {
         // Draw AH sides
-        int8_t hudwidth  = AHISIDEBARWIDTHPOSITION;
-        int8_t hudheight = AHISIDEBARHEIGHTPOSITION;
-        for (int8_t X = -hudheight; X <= hudheight; X++) {
-            screenBuffer[position - hudwidth + (X * LINE)] = MAX7456_CHAR(SYM_AH_DECORATION);
-            screenBuffer[position + hudwidth + (X * LINE)] = MAX7456_CHAR(SYM_AH_DECORATION);
-        }
-        // AH level indicators
-        screenBuffer[position-hudwidth+1] =  MAX7456_CHAR(SYM_AH_LEFT);
-        screenBuffer[position+hudwidth-1] =  MAX7456_CHAR(SYM_AH_RIGHT);
+        osdDrawArtificialHorizonSidebars(MAX7456_CHAR(SYM_AH_DECORATION), MAX7456_CHAR(SYM_AH_LEFT), MAX7456_CHAR(SYM_AH_RIGHT));
+        ah_sidebars_drawn = true;
+    } else if (!show_sidebars && ah_sidebars_drawn) {
+        osdDrawArtificialHorizonSidebars(MAX7456_CHAR(' '), MAX7456_CHAR(' '), MAX7456_CHAR(' '));
+        ah_sidebars_drawn = false;
     }
 }
 
-void updateOsd(void)
+// Write an element's text, blanking whatever is left of its previous text
+static void osdDrawElement(osd_items_t item, const char *text)
+{
+    osdElementState_t *state = &osd_element_state[item];
+    char padded[OSD_LINE_LENGTH + 1];
+    uint8_t length = 0;
+
+    while (text[length] && length < OSD_LINE_LENGTH) {
+        padded[length] = text[length];
+        length++;
+    }
+    for (uint8_t i = length; i < state->length; i++)
+        padded[i] = ' ';
+    padded[MAX(length, state->length)] = 0;
+
+    max7456_write_string(padded, state->pos);
+    state->length = length;
+}
+
+static void osdEraseElement(const osd_element_t *element)
+{
+    if (element->erase)
+        element->erase();
+    else
+        osdDrawElement(element->item, "");
+}
+
+// Check whether an element needs drawing because its value or position changed, erasing it if it moved or was
+// switched off
+static bool osdElementChanged(const osd_element_t *element, int32_t value)
+{
+    osdElementState_t *state = &osd_element_state[element->item];
+    int16_t pos = masterConfig.osdProfile.item_pos[element->item];
+
+    if (state->drawn && state->pos == pos && state->value == value)
+        return false;
+
+    if (state->drawn && state->pos != pos) {
+        osdEraseElement(element);
+        state->drawn = false;
+    }
+
+    if (pos == -1)
+        return false;
+
+    state->pos = pos;
+    state->value = value;
+    state->drawn = true;
+    return true;
+}
+
+static int32_t osdLowVoltageValue(void)
+{
+    return batteryWarningVoltage > vbat && (blink & 1);
+}
+
+static void osdDrawLowVoltage(osd_items_t item, int32_t value)
+{
+    osdDrawElement(item, value ? "LOW VOLTAGE" : "");
+}
+
+static int32_t osdArmedValue(void)
+{
+    return arming && (blink & 1);
+}
+
+static void osdDrawArmed(osd_items_t item, int32_t value)
+{
+    // shown for the first few blinks after arming
+    if (value)
+        arming--;
+    osdDrawElement(item, value ? "ARMED" : "");
+}
+
+static int32_t osdDisarmedValue(void)
+{
+    return !armed;
+}
+
+static void osdDrawDisarmed(osd_items_t item, int32_t value)
+{
+    osdDrawElement(item, value ? "DISARMED" : "");
+}
+
+static int32_t osdBattVoltageValue(void)
+{
+    return vbat;
+}
+
+static void osdDrawBattVoltage(osd_items_t item, int32_t value)
 {
-    static uint8_t blink = 0;
-    static uint8_t arming = 0;
-    uint32_t seconds;
     char line[30];
-    uint32_t now = micros();
 
-    bool updateNow = (int32_t)(now - next_osd_update_at) >= 0L;
-    if (!updateNow) {
-        return;
+    line[0] = SYM_VOLT;
+    sprintf(line+1, "%d.%1d", value / 10, value % 10);
+    osdDrawElement(item, line);
+}
+
+static int32_t osdCurrentDrawValue(void)
+{
+    return amperage;
+}
+
+static void osdDrawCurrentDraw(osd_items_t item, int32_t value)
+{
+    char line[30];
+
+    line[0] = SYM_AMP;
+    sprintf(line+1, "%d.%02d", value / 100, value % 100);
+    osdDrawElement(item, line);
+}
+
+static int32_t osdMahDrawnValue(void)
+{
+    return mAhDrawn;
+}
+
+static void osdDrawMahDrawn(osd_items_t item, int32_t value)
+{
+    char line[30];
+
+    line[0] = SYM_MAH;
+    sprintf(line+1, "%d", value);
+    osdDrawElement(item, line);
+}
+
+// The name can be changed over MSP, so it's drawn again when any of its characters change
+static int32_t osdCraftNameValue(void)
+{
+    int32_t nameHash = 0;
+
+    for (uint8_t i = 0; i < MAX_NAME_LENGTH && masterConfig.name[i]; i++) {
+        nameHash = nameHash * 31 + masterConfig.name[i];
     }
-    next_osd_update_at = now + OSD_UPDATE_FREQUENCY;
-    blink++;
+    return nameHash;
+}
 
-    if (ARMING_FLAG(ARMED)) {
-        if (!armed) {
-            armed = true;
-            armed_at = now;
-            in_menu = false;
-            arming = 5;
-        }
-    } else {
-        if (armed) {
-            armed = false;
-            armed_seconds += ((now - armed_at) / 1000000);
-        }
-        for (uint8_t channelIndex = 0; channelIndex < 4; channelIndex++) {
-            sticks[channelIndex] = (constrain(rcData[channelIndex], PWM_RANGE_MIN, PWM_RANGE_MAX) - PWM_RANGE_MIN) * 100 / (PWM_RANGE_MAX - PWM_RANGE_MIN);
-        }
-        if (!in_menu && sticks[YAW] > STICKMAX && sticks[THROTTLE] > STICKMIN && sticks[THROTTLE] < STICKMAX && sticks[ROLL] > STICKMIN && sticks[ROLL] < STICKMAX && sticks[PITCH] > STICKMAX) {
-            in_menu = true;
-            cursor_row = 255;
-            cursor_col = 2;
-            activating_menu = true;
-        }
+static void osdDrawCraftName(osd_items_t item, int32_t value)
+{
+    char line[MAX_NAME_LENGTH + 1];
+    uint8_t i;
+
+    UNUSED(value);
+
+    for (i = 0; i < MAX_NAME_LENGTH && masterConfig.name[i]; i++) {
+        line[i] = toupper((unsigned char)masterConfig.name[i]);
     }
-    if (in_menu) {
-        show_menu();
+    line[i] = 0;
+    osdDrawElement(item, line);
+}
+
+static int32_t osdRssiValue(void)
+{
+    return rssi / 10;
+}
+
+static void osdDrawRssi(osd_items_t item, int32_t value)
+{
+    char line[30];
+
+    line[0] = SYM_RSSI;
+    sprintf(line+1, "%d", value);
+    osdDrawElement(item, line);
+}
+
+static int32_t osdThrottleValue(void)
+{
+    return (constrain(rcData[THROTTLE], PWM_RANGE_MIN, PWM_RANGE_MAX) - PWM_RANGE_MIN) * 100 / (PWM_RANGE_MAX - PWM_RANGE_MIN);
+}
+
+static void osdDrawThrottle(osd_items_t item, int32_t value)
+{
+    char line[30];
+
+    line[0] = SYM_THR;
+    line[1] = SYM_THR1;
+    sprintf(line+2, "%3d", value);
+    osdDrawElement(item, line);
+}
+
+// Seconds armed, or since power on when disarmed, in the upper bits and whether armed in the lowest
+static int32_t osdTimerValue(void)
+{
+    uint32_t now = micros();
+    uint32_t seconds;
+
+    if (armed) {
+        seconds = armed_seconds + ((now-armed_at) / 1000000);
     } else {
-        if (batteryWarningVoltage > vbat && (blink & 1) && masterConfig.osdProfile.item_pos[OSD_VOLTAGE_WARNING] != -1) {
-            max7456_write_string("LOW VOLTAGE", masterConfig.osdProfile.item_pos[OSD_VOLTAGE_WARNING]);
-        }
-        if (arming && (blink & 1) && masterConfig.osdProfile.item_pos[OSD_ARMED] != -1) {
-            max7456_write_string("ARMED", masterConfig.osdProfile.item_pos[OSD_ARMED]);
-            arming--;
-        }
-        if (!armed && masterConfig.osdProfile.item_pos[OSD_DISARMED] != -1) {
-            max7456_write_string("DISARMED", masterConfig.osdProfile.item_pos[OSD_DISARMED]);
-        }
+        seconds = now / 1000000;
+    }
+    return seconds * 2 + armed;
+}
 
-        if (masterConfig.osdProfile.item_pos[OSD_MAIN_BATT_VOLTAGE] != -1) {
-            line[0] = SYM_VOLT;
-            sprintf(line+1, "%d.%1d", vbat / 10, vbat % 10);
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_MAIN_BATT_VOLTAGE]);
-        }
+static void osdDrawTimer(osd_items_t item, int32_t value)
+{
+    char line[30];
+    uint32_t seconds = value / 2;
 
-        if (masterConfig.osdProfile.item_pos[OSD_CURRENT_DRAW] != -1) {
-            line[0] = SYM_AMP;
-            sprintf(line+1, "%d.%02d", amperage / 100, amperage % 100);
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_CURRENT_DRAW]);
-        }
+    line[0] = (value & 1) ? SYM_FLY_M : SYM_ON_M;
+    sprintf(line+1, " %02d:%02d", seconds / 60, seconds % 60);
+    osdDrawElement(item, line);
+}
 
-        if (masterConfig.osdProfile.item_pos[OSD_MAH_DRAWN] != -1) {
-            line[0] = SYM_MAH;
-            sprintf(line+1, "%d", mAhDrawn);
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_MAH_DRAWN]);
-        }
+static int32_t osdCpuLoadValue(void)
+{
+    return averageSystemLoadPercent;
+}
 
-        if (masterConfig.osdProfile.item_pos[OSD_CRAFT_NAME] != -1) {
-            for (uint8_t i = 0; i < MAX_NAME_LENGTH; i++) {
-                line[i] = toupper((unsigned char)masterConfig.name[i]);
-                if (masterConfig.name[i] == 0)
-                    break;
-            }
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_CRAFT_NAME]);
-        }
+static void osdDrawCpuLoad(osd_items_t item, int32_t value)
+{
+    char line[30];
+
+    sprintf(line, "%d", value);
+    osdDrawElement(item, line);
+}
+
+// Roll and pitch as far as the horizon shows them, and whether the sidebars are on in the lowest bit
+static int32_t osdArtificialHorizonValue(void)
+{
+    int32_t roll = constrain(attitude.values.roll, -AHIROLLMAX, AHIROLLMAX) + AHIROLLMAX;
+    int32_t pitch = constrain(attitude.values.pitch, -AHIPITCHMAX, AHIPITCHMAX) + AHIPITCHMAX;
+
+    return (roll << 12) | (pitch << 1) | (masterConfig.osdProfile.item_pos[OSD_HORIZON_SIDEBARS] != -1);
+}
+
+static void osdDrawArtificialHorizonElement(osd_items_t item, int32_t value)
+{
+    UNUSED(item);
+
+    osdDrawArtificialHorizon((value >> 12) - AHIROLLMAX, ((value >> 1) & 0x3FF) - AHIPITCHMAX, value & 1);
+}
+
+// Elements shown in flight, with how often each one's value is checked
+static const osd_element_t osd_element_table[] = {
+    { OSD_ARTIFICIAL_HORIZON, OSD_HZ(30), osdArtificialHorizonValue, osdDrawArtificialHorizonElement, osdEraseArtificialHorizon },
+    { OSD_THROTTLE_POS,       OSD_HZ(10), osdThrottleValue,          osdDrawThrottle,                 NULL },
+    { OSD_RSSI_VALUE,         OSD_HZ(5),  osdRssiValue,              osdDrawRssi,                     NULL },
+    { OSD_CURRENT_DRAW,       OSD_HZ(5),  osdCurrentDrawValue,       osdDrawCurrentDraw,              NULL },
+    { OSD_VOLTAGE_WARNING,    OSD_HZ(5),  osdLowVoltageValue,        osdDrawLowVoltage,               NULL },
+    { OSD_ARMED,              OSD_HZ(5),  osdArmedValue,             osdDrawArmed,                    NULL },
+    { OSD_DISARMED,           OSD_HZ(5),  osdDisarmedValue,          osdDrawDisarmed,                 NULL },
+    { OSD_TIMER,              OSD_HZ(4),  osdTimerValue,             osdDrawTimer,                    NULL },
+    { OSD_MAIN_BATT_VOLTAGE,  OSD_HZ(2),  osdBattVoltageValue,       osdDrawBattVoltage,              NULL },
+    { OSD_MAH_DRAWN,          OSD_HZ(2),  osdMahDrawnValue,          osdDrawMahDrawn,                 NULL },
+    { OSD_CPU_LOAD,           OSD_HZ(2),  osdCpuLoadValue,           osdDrawCpuLoad,                  NULL },
+    { OSD_CRAFT_NAME,         OSD_HZ(1),  osdCraftNameValue,         osdDrawCraftName,                NULL },
+};
+
+#define OSD_ELEMENT_COUNT (sizeof(osd_element_table) / sizeof(osd_element_t))
+
+// Forget what's on screen so that every element is drawn again on a blank screen
+static void osdResetElements(uint32_t now)
+{
+    max7456_clear_screen();
+    memset(osd_element_state, 0, sizeof(osd_element_state));
+    for (uint8_t i = 0; i < OSD_MAX_ITEMS; i++)
+        osd_element_state[i].due_at = now;
+    ah_bar_count = 0;
+    ah_drawn = false;
+    ah_sidebars_drawn = false;
+}
+
+// Check the elements which are due and draw those that changed, until the time budget runs out. The elements not
+// reached are still due, and are checked first next time. Returns whether anything was drawn.
+static bool osdDrawElements(uint32_t now)
+{
+    bool drawn = false;
+    bool checked = false;
+
+    for (uint8_t i = 0; i < OSD_ELEMENT_COUNT; i++) {
+        uint8_t index = (next_element + i) % OSD_ELEMENT_COUNT;
+        const osd_element_t *element = &osd_element_table[index];
+        osdElementState_t *state = &osd_element_state[element->item];
+
+        if ((int32_t)(now - state->due_at) < 0)
+            continue;
 
-        if (masterConfig.osdProfile.item_pos[OSD_RSSI_VALUE] != -1) {
-            line[0] = SYM_RSSI;
-            sprintf(line+1, "%d", rssi / 10);
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_RSSI_VALUE]);
+        if (checked && micros() - now > OSD_ELEMENT_BUDGET) {
+            next_element = index;
+            break;
         }
-        if (masterConfig.osdProfile.item_pos[OSD_THROTTLE_POS] != -1) {
-            line[0] = SYM_THR;
-            line[1] = SYM_THR1;
-            sprintf(line+2, "%3d", (constrain(rcData[THROTTLE], PWM_RANGE_MIN, PWM_RANGE_MAX) - PWM_RANGE_MIN) * 100 / (PWM_RANGE_MAX - PWM_RANGE_MIN));
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_THROTTLE_POS]);
+
+        state->due_at = now + element->refresh_period;
+        checked = true;
+
+        int32_t value = element->value();
+        if (osdElementChanged(element, value)) {
+            element->draw(element->item, value);
+            drawn = true;
         }
-        if (masterConfig.osdProfile.item_pos[OSD_TIMER] != -1) {
+    }
+
+    return drawn;
+}
+
+void updateOsd(void)
+{
+    uint32_t now = micros();
+
+    // The menu and sticks are handled at OSD_UPDATE_FREQUENCY, the elements at their own rates
+    if ((int32_t)(now - next_osd_update_at) >= 0L) {
+        next_osd_update_at = now + OSD_UPDATE_FREQUENCY;
+        blink++;
+
+        if (ARMING_FLAG(ARMED)) {
+            if (!armed) {
+                armed = true;
+                armed_at = now;
+                in_menu = false;
+                arming = 5;
+            }
+        } else {
             if (armed) {
-                seconds = armed_seconds + ((now-armed_at) / 1000000);
-                line[0] = SYM_FLY_M;
-                sprintf(line+1, " %02d:%02d", seconds / 60, seconds % 60);
-            } else {
-                line[0] = SYM_ON_M;
-                seconds = now  / 1000000;
-                sprintf(line+1, " %02d:%02d", seconds / 60, seconds % 60);
+                armed = false;
+                armed_seconds += ((now - armed_at) / 1000000);
+            }
+            for (uint8_t channelIndex = 0; channelIndex < 4; channelIndex++) {
+                sticks[channelIndex] = (constrain(rcData[channelIndex], PWM_RANGE_MIN, PWM_RANGE_MAX) - PWM_RANGE_MIN) * 100 / (PWM_RANGE_MAX - PWM_RANGE_MIN);
+            }
+            if (!in_menu && sticks[YAW] > STICKMAX && sticks[THROTTLE] > STICKMIN && sticks[THROTTLE] < STICKMAX && sticks[ROLL] > STICKMIN && sticks[ROLL] < STICKMAX && sticks[PITCH] > STICKMAX) {
+                in_menu = true;
+                cursor_row = 255;
+                cursor_col = 2;
+                activating_menu = true;
             }
-            max7456_write_string(line, masterConfig.osdProfile.item_pos[OSD_TIMER]);
         }
-        if (masterConfig.osdProfile.item_pos[OSD_CPU_LOAD] != -1) {
-            print_average_system_load(masterConfig.osdProfile.item_pos[OSD_CPU_LOAD], 0);
+        if (in_menu) {
+            // the menu is drawn afresh each time, only the characters that change are sent to the MAX7456
+            max7456_clear_screen();
+            show_menu();
+            showing_elements = false;
+            screen_changed = true;
         }
-        if (masterConfig.osdProfile.item_pos[OSD_ARTIFICIAL_HORIZON] != -1) {
-            osdDrawArtificialHorizon(attitude.values.roll, attitude.values.pitch, masterConfig.osdProfile.item_pos[OSD_HORIZON_SIDEBARS] != -1);
+    }
+
+    if (!in_menu) {
+        if (!showing_elements) {
+            osdResetElements(now);
+            showing_elements = true;
+            screen_changed = true;
         }
+        if (osdDrawElements(now))
+            screen_changed = true;
     }
-    max7456_draw_screen();
+
+    // only changes are sent, so a MAX7456 that has been reset would otherwise stay blank
+    if ((int32_t)(now - next_resync_at) >= 0L) {
+        next_resync_at = now + OSD_RESYNC_PERIOD;
+        max7456_invalidate_screen();
+        screen_changed = true;
+    }
+
+    // whatever couldn't be sent, because the bus was busy or there was too much, is sent next time
+    if (screen_changed)
+        screen_changed = !max7456_draw_screen();
 }
 
 void osdInit(void)
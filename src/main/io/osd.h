@@ -57,6 +57,14 @@ typedef enum {
 } osd_items_t;
 
 
+typedef struct {
+    osd_items_t item;
+    uint32_t    refresh_period;                         // microseconds between checks of the value
+    int32_t     (*value)(void);                         // what's shown, the element is drawn again when it changes
+    void        (*draw)(osd_items_t item, int32_t value);
+    void        (*erase)(void);                         // NULL to blank the text the element last drew
+} osd_element_t;
+
 typedef struct {
     // AUTO / PAL / NTSC in VIDEO_TYPES enum
     uint8_t video_system;
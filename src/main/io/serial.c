@@ -486,27 +486,32 @@ void serialPassthrough(serialPort_t *left, serialPort_t *right, serialConsumer
     LED1_OFF;
 
     // Either port might be open in a mode other than MODE_RXTX. We rely on
-    // serialRxBytesWaiting() to do the right thing for a TX only port. No
+    // serialReadBuf() to do the right thing for a TX only port. No
     // special handling is necessary OR performed.
+    uint8_t chunk[32];
+    int count;
+
     while(1) {
         // TODO: maintain a timestamp of last data received. Use this to
         // implement a guard interval and check for `+++` as an escape sequence
         // to return to CLI command mode.
         // https://en.wikipedia.org/wiki/Escape_sequence#Modem_control
-        if (serialRxBytesWaiting(left)) {
+        if ((count = serialReadBuf(left, chunk, sizeof(chunk))) > 0) {
             LED0_ON;
-            uint8_t c = serialRead(left);
-            serialWrite(right, c);
-            leftC(c);
+            serialWriteBuf(right, chunk, count);
+            for (int i = 0; i < count; i++) {
+                leftC(chunk[i]);
+            }
             LED0_OFF;
-         }
-         if (serialRxBytesWaiting(right)) {
-             LED0_ON;
-             uint8_t c = serialRead(right);
-             serialWrite(left, c);
-             rightC(c);
-             LED0_OFF;
-         }
-     }
- }
+        }
+        if ((count = serialReadBuf(right, chunk, sizeof(chunk))) > 0) {
+            LED0_ON;
+            serialWriteBuf(left, chunk, count);
+            for (int i = 0; i < count; i++) {
+                rightC(chunk[i]);
+            }
+            LED0_OFF;
+        }
+    }
+}
  #endif
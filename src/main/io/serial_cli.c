@@ -65,6 +65,7 @@
 
 #include "rx/rx.h"
 #include "rx/spektrum.h"
+#include "rx/rx_latency.h"
 
 #include "sensors/battery.h"
 #include "sensors/boardalignment.h"
@@ -147,6 +148,9 @@ static void cliTasks(char *cmdline);
 #endif
 static void cliVersion(char *cmdline);
 static void cliRxRange(char *cmdline);
+#ifndef SKIP_RX_LATENCY
+static void cliRxLatency(char *cmdline);
+#endif
 #if (FLASH_SIZE > 64)
 static void cliResource(char *cmdline);
 #endif
@@ -328,6 +332,9 @@ const clicmd_t cmdTable[] = {
 #endif
     CLI_COMMAND_DEF("rxrange", "configure rx channel ranges", NULL, cliRxRange),
     CLI_COMMAND_DEF("rxfail", "show/set rx failsafe settings", NULL, cliRxFail),
+#ifndef SKIP_RX_LATENCY
+    CLI_COMMAND_DEF("rxlatency", "show rx to motor latency", "[reset]", cliRxLatency),
+#endif
     CLI_COMMAND_DEF("save", "save and reboot", NULL, cliSave),
     CLI_COMMAND_DEF("serial", "configure serial ports", NULL, cliSerial),
 #ifndef SKIP_SERIAL_PASSTHROUGH
@@ -426,7 +433,8 @@ static const char * const lookupTableSerialRX[] = {
     "XB-B",
     "XB-B-RJ01",
     "IBUS",
-    "JETIEXBUS"
+    "JETIEXBUS",
+    "CRSF"
 };
 #endif
 
@@ -488,6 +496,7 @@ static const char * const lookupTableDebug[DEBUG_COUNT] = {
     "RC_INTERPOLATION",
     "VELOCITY",
     "DFILTER",
+    "RX_LATENCY",
 };
 
 #ifdef OSD
@@ -693,6 +702,7 @@ const clivalue_t valueTable[] = {
     { "gps_sbas_mode",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gpsConfig.sbasMode, .config.lookup = { TABLE_GPS_SBAS_MODE } },
     { "gps_auto_config",            VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gpsConfig.autoConfig, .config.lookup = { TABLE_OFF_ON } },
     { "gps_auto_baud",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gpsConfig.autoBaud, .config.lookup = { TABLE_OFF_ON } },
+    { "gps_ublox_nav_pvt",          VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gpsConfig.ubloxNavPvt, .config.lookup = { TABLE_OFF_ON } },
 
     { "gps_pos_p",                  VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.P8[PIDPOS], .config.minmax = { 0,  200 } },
     { "gps_pos_i",                  VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.I8[PIDPOS], .config.minmax = { 0,  200 } },
@@ -888,6 +898,11 @@ const clivalue_t valueTable[] = {
     { "blackbox_device",            VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.blackbox_device, .config.lookup = { TABLE_BLACKBOX_DEVICE } },
 #endif
 
+#ifdef USE_FLASHFS
+    { "flashfs_erase_ahead",        VAR_UINT8  | MASTER_VALUE,  &masterConfig.flashfs_erase_ahead_sectors, .config.minmax = { 0,  16 } },
+    { "flashfs_wrap",               VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.flashfs_wrap, .config.lookup = { TABLE_OFF_ON } },
+#endif
+
 #ifdef VTX
     { "vtx_band",                   VAR_UINT8  | MASTER_VALUE,  &masterConfig.vtx_band, .config.minmax = { 1, 5 } },
     { "vtx_channel",                VAR_UINT8  | MASTER_VALUE,  &masterConfig.vtx_channel, .config.minmax = { 1, 8 } },
@@ -1572,6 +1587,47 @@ static void cliRxRange(char *cmdline)
     }
 }
 
+#ifndef SKIP_RX_LATENCY
+static void cliRxLatency(char *cmdline)
+{
+    static const char * const stageNames[RX_LATENCY_STAGE_COUNT] = { "rcCommand", "motors" };
+    rxLatencyStats_t stats[RX_LATENCY_STAGE_COUNT];
+
+    if (strcasecmp(cmdline, "reset") == 0) {
+        rxLatencyReset();
+        return;
+    }
+
+    for (int stage = 0; stage < RX_LATENCY_STAGE_COUNT; stage++) {
+        rxLatencyGetStats(stage, &stats[stage]);
+    }
+
+    cliPrintf("RX to         frames  min/us  avg/us  max/us\r\n");
+    for (int stage = 0; stage < RX_LATENCY_STAGE_COUNT; stage++) {
+        cliPrintf("%10s %9u %7u %7u %7u\r\n", stageNames[stage],
+            stats[stage].count, stats[stage].minUs, stats[stage].averageUs, stats[stage].maxUs);
+    }
+
+    cliPrintf("Latency/us    ");
+    for (int stage = 0; stage < RX_LATENCY_STAGE_COUNT; stage++) {
+        cliPrintf(" %10s", stageNames[stage]);
+    }
+    cliPrintf("\r\n");
+    for (int bucket = 0; bucket < RX_LATENCY_BUCKET_COUNT; bucket++) {
+        const int bucketMin = bucket * RX_LATENCY_BUCKET_WIDTH_US;
+        if (bucket < RX_LATENCY_BUCKET_COUNT - 1) {
+            cliPrintf("%5d - %5d ", bucketMin, bucketMin + RX_LATENCY_BUCKET_WIDTH_US - 1);
+        } else {
+            cliPrintf("%5d +       ", bucketMin);
+        }
+        for (int stage = 0; stage < RX_LATENCY_STAGE_COUNT; stage++) {
+            cliPrintf(" %10u", stats[stage].buckets[bucket]);
+        }
+        cliPrintf("\r\n");
+    }
+}
+#endif
+
 #ifdef LED_STRIP
 static void printLed(uint8_t dumpMask, master_t *defaultConfig)
 {
@@ -3314,6 +3370,9 @@ static void cliTasks(char *cmdline)
             if (taskId == TASK_GYROPID && masterConfig.pid_process_denom > 1) {
                 cliPrintf("   - (%12s) %6d\r\n", taskInfo.subTaskName, subTaskFrequency);
             }
+            if (taskInfo.timeBudget) {
+                cliPrintf("   - (      budget) %6d us, %d us carried over\r\n", taskInfo.timeBudget, taskInfo.timeBudgetCarry);
+            }
         }
     }
     cliPrintf("Total (excluding SERIAL) %22d.%1d%% %4d.%1d%%\r\n", maxLoadSum/10, maxLoadSum%10, averageLoadSum/10, averageLoadSum%10);
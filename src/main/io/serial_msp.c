@@ -30,6 +30,7 @@
 #include "common/axis.h"
 #include "common/color.h"
 #include "common/maths.h"
+#include "common/packbits.h"
 
 #include "drivers/system.h"
 
@@ -38,17 +39,18 @@
 #include "drivers/compass.h"
 
 #include "drivers/serial.h"
+#include "drivers/buf_writer.h"
 #include "drivers/bus_i2c.h"
 #include "drivers/io.h"
 #include "drivers/gpio.h"
 #include "drivers/timer.h"
 #include "drivers/pwm_rx.h"
 #include "drivers/sdcard.h"
-#include "drivers/buf_writer.h"
 #include "drivers/max7456.h"
 #include "drivers/vtx_soft_spi_rtc6705.h"
 #include "rx/rx.h"
 #include "rx/msp.h"
+#include "rx/rx_latency.h"
 
 #include "io/beeper.h"
 #include "io/escservo.h"
@@ -56,6 +58,7 @@
 #include "io/gps.h"
 #include "io/gimbal.h"
 #include "io/serial.h"
+#include "io/serial_cli.h"
 #include "io/ledstrip.h"
 #include "io/flashfs.h"
 #include "io/transponder_ir.h"
@@ -85,6 +88,7 @@
 #include "flight/altitudehold.h"
 
 #include "blackbox/blackbox.h"
+#include "blackbox/blackbox_log_reader.h"
 
 #include "fc/mw.h"
 
@@ -186,17 +190,72 @@ typedef enum {
 } mspSDCardState_e;
 
 
+#define MSP_DATAFLASH_READ_SIZE                 128
+// Only reached over the USB VCP, UART replies are cut to what fits in the port's TX buffer (at most 255 bytes)
+#define MSP_DATAFLASH_BULK_READ_MAX_SIZE        4096
+#define MSP_DATAFLASH_BULK_READ_BLOCK_SIZE      64
+// Compressed reads are read into RAM in one go, so that the flash is only read once
+#ifdef STM32F1
+#define MSP_DATAFLASH_COMPRESSED_READ_MAX_SIZE  256
+#else
+#define MSP_DATAFLASH_COMPRESSED_READ_MAX_SIZE  1024
+#endif
+// Frame header and checksum, address, size and compression type
+#define MSP_DATAFLASH_BULK_READ_OVERHEAD        (MSP_REPLY_HEADER_MAX_SIZE + 1 + 4 + 2 + 1)
+
+#define MSP_DATAFLASH_COMPRESSION_NONE          0
+#define MSP_DATAFLASH_COMPRESSION_PACKBITS      1
+
+#define MSP_SDCARD_LOG_READ_MAX_SIZE            BLACKBOX_LOG_READER_BUFFER_SIZE
+
 STATIC_UNIT_TESTED mspPort_t mspPorts[MAX_MSP_PORT_COUNT];
 
 STATIC_UNIT_TESTED mspPort_t *currentPort;
-STATIC_UNIT_TESTED bufWriter_t *writer;
+
+// Commands are processed one at a time, so all ports share the reply buffer
+static uint8_t mspReplyBuffer[MSP_PORT_OUTBUF_SIZE];
+STATIC_UNIT_TESTED mspReply_t mspReply;
+
+#define MSP_MAX_SUBSCRIPTIONS               8
+#define MSP_SUBSCRIPTION_MIN_PERIOD         5 // milliseconds, the rate of TASK_MSP_SUBSCRIPTIONS
+
+typedef struct mspSubscription_s {
+    uint16_t cmdMSP;
+    uint16_t period;        // milliseconds
+    uint32_t nextPushAt;    // millis()
+} mspSubscription_t;
+
+// Replies to these commands are sent to the port without being asked for
+typedef struct mspPortSubscriptions_s {
+    mspVersion_e mspVersion; // The framing used to make the subscriptions
+    uint8_t count;
+    mspSubscription_t subscriptions[MSP_MAX_SUBSCRIPTIONS];
+} mspPortSubscriptions_t;
+
+static mspPortSubscriptions_t mspPortSubscriptions[MAX_MSP_PORT_COUNT];
+
+static mspPortSubscriptions_t *mspGetPortSubscriptions(const mspPort_t *mspPort)
+{
+    return &mspPortSubscriptions[mspPort - mspPorts];
+}
+
+// How much is read from a port at a time
+#define MSP_RX_CHUNK_SIZE 32
+
+// Bytes read from a port that the parser hasn't been through yet, they are kept when mspProcess() stops early
+typedef struct mspRxChunk_s {
+    uint8_t data[MSP_RX_CHUNK_SIZE];
+    uint8_t length;
+    uint8_t position;
+} mspRxChunk_t;
+
+static mspRxChunk_t mspRxChunks[MAX_MSP_PORT_COUNT];
 
 #define RATEPROFILE_MASK (1 << 7)
 
 static void serialize8(uint8_t a)
 {
-    bufWriterAppend(writer, a);
-    currentPort->checksum ^= a;
+    mspReplyAppend(&mspReply, a);
 }
 
 static void serialize16(uint16_t a)
@@ -211,6 +270,26 @@ static void serialize32(uint32_t a)
     serialize16((uint16_t)(a >> 16));
 }
 
+/**
+ * Append a block of data to the reply. Large replies send it straight to the serial port's TX path.
+ */
+static void serializeBuf(const uint8_t *data, int len)
+{
+    mspReplyAppendBuf(&mspReply, data, len);
+}
+
+static void mspSerialWrite(void *arg, const uint8_t *data, int len)
+{
+    serialWriteBuf((serialPort_t *)arg, (uint8_t *)data, len);
+}
+
+static void serializePackbitsShim(void *arg, uint8_t data)
+{
+    UNUSED(arg);
+
+    serialize8(data);
+}
+
 static uint8_t read8(void)
 {
     return currentPort->inBuf[currentPort->indRX++] & 0xff;
@@ -230,19 +309,18 @@ static uint32_t read32(void)
     return t;
 }
 
-static void headSerialResponse(uint8_t err, uint8_t responseBodySize)
+/**
+ * Start the reply to the current command. The size is only needed by replies too large to be buffered, smaller
+ * replies have their size measured once they're complete.
+ */
+static void headSerialResponse(uint8_t err, uint16_t responseBodySize)
 {
-    serialBeginWrite(mspSerialPort);
-
-    serialize8('$');
-    serialize8('M');
-    serialize8(err ? '!' : '>');
-    currentPort->checksum = 0;               // start calculating a new checksum
-    serialize8(responseBodySize);
-    serialize8(currentPort->cmdMSP);
+    if (mspReplyBegin(&mspReply, currentPort->mspVersion, currentPort->cmdMSP, err, responseBodySize)) {
+        serialBeginWrite(mspSerialPort);
+    }
 }
 
-static void headSerialReply(uint8_t responseBodySize)
+static void headSerialReply(uint16_t responseBodySize)
 {
     headSerialResponse(0, responseBodySize);
 }
@@ -254,8 +332,10 @@ static void headSerialError(uint8_t responseBodySize)
 
 static void tailSerialReply(void)
 {
-    serialize8(currentPort->checksum);
-    serialEndWrite(mspSerialPort);
+    if (mspReply.active) {
+        mspReplyFinish(&mspReply);
+        serialEndWrite(mspSerialPort);
+    }
 }
 
 static void s_struct(uint8_t *cb, uint8_t siz)
@@ -378,6 +458,146 @@ static void serializeSDCardSummaryReply(void)
 #endif
 }
 
+static void serializeSDCardCacheStatsReply(void)
+{
+    headSerialReply(1 + 4 * 4);
+
+#ifdef USE_SDCARD
+    afatfsCacheStats_t stats;
+    uint8_t cacheSectors = afatfs_getCacheStats(&stats);
+
+    serialize8(cacheSectors);
+    serialize32(stats.hits);
+    serialize32(stats.misses);
+    serialize32(stats.stalls);
+    serialize32(stats.readAheads);
+#else
+    serialize8(0);
+    serialize32(0);
+    serialize32(0);
+    serialize32(0);
+    serialize32(0);
+#endif
+}
+
+#ifndef SKIP_RX_LATENCY
+/**
+ * RX latency reply for one stage (see rxLatencyStage_e): the stage (u8), number of stages (u8), number of buckets (u8),
+ * bucket width in microseconds (u16), frame count (u32), min, max and average latency in microseconds (u32 each), then
+ * the count in each bucket (u32).
+ */
+static void serializeRxLatencyReply(uint8_t stage)
+{
+    rxLatencyStats_t stats;
+
+    if (stage >= RX_LATENCY_STAGE_COUNT) {
+        stage = RX_LATENCY_RC_COMMAND;
+    }
+    rxLatencyGetStats(stage, &stats);
+
+    headSerialReply(3 + 2 + 4 * 4 + RX_LATENCY_BUCKET_COUNT * 4);
+
+    serialize8(stage);
+    serialize8(RX_LATENCY_STAGE_COUNT);
+    serialize8(RX_LATENCY_BUCKET_COUNT);
+    serialize16(RX_LATENCY_BUCKET_WIDTH_US);
+    serialize32(stats.count);
+    serialize32(stats.minUs);
+    serialize32(stats.maxUs);
+    serialize32(stats.averageUs);
+    for (int i = 0; i < RX_LATENCY_BUCKET_COUNT; i++) {
+        serialize32(stats.buckets[i]);
+    }
+}
+#endif
+
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+/**
+ * Log list reply: status (u8, see blackboxLogReaderStatus_e), index of the first log (u16), whether more logs follow
+ * (u8), number of logs (u8), then for each log its 11 byte FAT filename (e.g. "LOG00001TXT") and size (u32).
+ *
+ * Logs are only listed once the status is READY, until then the host should ask again.
+ */
+static void serializeSDCardLogListReply(uint16_t startIndex)
+{
+    const blackboxLogReaderEntry_t *entries = NULL;
+    uint8_t count = 0;
+    bool more = false;
+    blackboxLogReaderStatus_e status = blackboxLogReaderList(startIndex, &entries, &count, &more);
+
+    if (status != BLACKBOX_LOG_READER_READY) {
+        count = 0;
+        more = false;
+    }
+
+    headSerialReply(1 + 2 + 1 + 1 + count * (FAT_FILENAME_LENGTH + 4));
+
+    serialize8(status);
+    serialize16(startIndex);
+    serialize8(more ? 1 : 0);
+    serialize8(count);
+
+    for (int i = 0; i < count; i++) {
+        serializeBuf((const uint8_t *) entries[i].filename, FAT_FILENAME_LENGTH);
+        serialize32(entries[i].size);
+    }
+}
+
+/**
+ * Log read reply: status (u8), log size (u32), offset (u32), number of log bytes covered (u16), compression type (u8),
+ * then the data, compressed the same way as MSP_DATAFLASH_READ.
+ *
+ * Only data that has already been read ahead from the card is sent, so the reply may be shorter than requested (or
+ * empty with a BUSY status while the reader catches up or seeks).
+ */
+static void serializeSDCardLogReadReply(uint32_t offset, uint16_t size, bool allowCompression)
+{
+    const uint8_t *data = NULL;
+    uint16_t length;
+    uint32_t fileSize;
+    uint16_t payloadSize;
+    uint8_t compression = MSP_DATAFLASH_COMPRESSION_NONE;
+    packbitsEncoder_t encoder;
+
+    blackboxLogReaderStatus_e status = blackboxLogReaderRead(offset, &data, &length, &fileSize);
+
+    if (length > size) {
+        length = size;
+    }
+
+    payloadSize = length;
+
+    // The data is already in RAM, so sizing the compressed frame is cheap
+    if (allowCompression && length > 0) {
+        packbitsEncoderInit(&encoder, NULL, NULL);
+        packbitsEncode(&encoder, data, length);
+
+        uint32_t encodedSize = packbitsEncoderFinish(&encoder);
+
+        if (encodedSize < length) {
+            compression = MSP_DATAFLASH_COMPRESSION_PACKBITS;
+            payloadSize = encodedSize;
+        }
+    }
+
+    headSerialReply(1 + 4 + 4 + 2 + 1 + payloadSize);
+
+    serialize8(status);
+    serialize32(fileSize);
+    serialize32(offset);
+    serialize16(length);
+    serialize8(compression);
+
+    if (compression == MSP_DATAFLASH_COMPRESSION_PACKBITS) {
+        packbitsEncoderInit(&encoder, serializePackbitsShim, NULL);
+        packbitsEncode(&encoder, data, length);
+        packbitsEncoderFinish(&encoder);
+    } else if (length > 0) {
+        serializeBuf(data, length);
+    }
+}
+#endif
+
 static void serializeDataflashSummaryReply(void)
 {
     headSerialReply(1 + 3 * 4);
@@ -418,11 +638,94 @@ static void serializeDataflashReadReply(uint32_t address, uint8_t size)
         serialize8(buffer[i]);
     }
 }
+
+/**
+ * Stream the flash contents in the range [address...address + size) into the reply.
+ */
+static void serializeDataflashBlocks(uint32_t address, uint16_t size)
+{
+    uint8_t buffer[MSP_DATAFLASH_BULK_READ_BLOCK_SIZE];
+
+    while (size > 0) {
+        int bytesRead = flashfsReadAbs(address, buffer, MIN(size, sizeof(buffer)));
+
+        if (bytesRead <= 0) {
+            break;
+        }
+
+        serializeBuf(buffer, bytesRead);
+
+        address += bytesRead;
+        size -= bytesRead;
+    }
+}
+
+/**
+ * Bulk read reply: address (u32), number of flash bytes covered (u16), compression type (u8), then the data.
+ *
+ * Replies larger than 254 bytes are sent as jumbo frames. An uncompressed reply is streamed a block at a time. When
+ * compression is allowed the reply is read into RAM first, so it can be measured for the frame header without reading
+ * the flash twice, which limits it to MSP_DATAFLASH_COMPRESSED_READ_MAX_SIZE. Data which doesn't compress is sent
+ * uncompressed.
+ */
+static void serializeDataflashBulkReadReply(uint32_t address, uint16_t size, bool allowCompression)
+{
+    static uint8_t buffer[MSP_DATAFLASH_COMPRESSED_READ_MAX_SIZE];
+    packbitsEncoder_t encoder;
+    uint16_t payloadSize;
+    uint8_t compression = MSP_DATAFLASH_COMPRESSION_NONE;
+
+    // Truncate the request at the end of the volume
+    if (address >= flashfsGetSize()) {
+        size = 0;
+    } else if (size > flashfsGetSize() - address) {
+        size = flashfsGetSize() - address;
+    }
+
+    payloadSize = size;
+
+    if (allowCompression && size > 0) {
+        if (size > sizeof(buffer)) {
+            size = sizeof(buffer);
+        }
+
+        const int bytesRead = flashfsReadAbs(address, buffer, size);
+        size = payloadSize = bytesRead > 0 ? bytesRead : 0;
+
+        packbitsEncoderInit(&encoder, NULL, NULL);
+        packbitsEncode(&encoder, buffer, size);
+
+        uint32_t encodedSize = packbitsEncoderFinish(&encoder);
+
+        if (encodedSize < size) {
+            compression = MSP_DATAFLASH_COMPRESSION_PACKBITS;
+            payloadSize = encodedSize;
+        }
+    }
+
+    headSerialReply(4 + 2 + 1 + payloadSize);
+
+    serialize32(address);
+    serialize16(size);
+    serialize8(compression);
+
+    if (compression == MSP_DATAFLASH_COMPRESSION_PACKBITS) {
+        packbitsEncoderInit(&encoder, serializePackbitsShim, NULL);
+        packbitsEncode(&encoder, buffer, size);
+        packbitsEncoderFinish(&encoder);
+    } else if (allowCompression) {
+        serializeBuf(buffer, size);     // already read
+    } else {
+        serializeDataflashBlocks(address, size);
+    }
+}
 #endif
 
 static void resetMspPort(mspPort_t *mspPortToReset, serialPort_t *serialPort)
 {
     memset(mspPortToReset, 0, sizeof(mspPort_t));
+    memset(mspGetPortSubscriptions(mspPortToReset), 0, sizeof(mspPortSubscriptions_t));
+    memset(&mspRxChunks[mspPortToReset - mspPorts], 0, sizeof(mspRxChunk_t));
 
     mspPortToReset->port = serialPort;
 }
@@ -462,6 +765,8 @@ void mspReleasePortIfAllocated(serialPort_t *serialPort)
         if (candidateMspPort->port == serialPort) {
             closeSerialPort(serialPort);
             memset(candidateMspPort, 0, sizeof(mspPort_t));
+            memset(mspGetPortSubscriptions(candidateMspPort), 0, sizeof(mspPortSubscriptions_t));
+            memset(&mspRxChunks[portIndex], 0, sizeof(mspRxChunk_t));
         }
     }
 }
@@ -613,1275 +918,1963 @@ static uint32_t packFlightModeFlags(void)
     return junk;
 }
 
-static bool processOutCommand(uint8_t cmdMSP)
+/*
+ * Each command the host can send has a handler, found by looking its ID up in the tables below. Handlers for
+ * commands that fetch data (mspOut...) send a reply. Handlers for commands that change settings or start actions
+ * (mspIn...) are acknowledged with an empty reply once they return true, unless they've already replied. Returning
+ * false sends an error reply.
+ */
+// The command reads parameters from the host, so it can't be subscribed to
+#define MSP_FLAG_TAKES_PARAMETERS   (1 << 0)
+
+typedef struct mspOutCommand_s {
+    uint16_t cmdMSP;
+    void (*handler)(void);
+    uint8_t flags;
+} mspOutCommand_t;
+
+typedef struct mspInCommand_s {
+    uint16_t cmdMSP;
+    bool (*handler)(void);
+} mspInCommand_t;
+
+static void mspOutApiVersion(void)
+{
+    headSerialReply(
+        1 + // protocol version length
+        API_VERSION_LENGTH
+    );
+    serialize8(MSP_PROTOCOL_VERSION);
+
+    serialize8(API_VERSION_MAJOR);
+    serialize8(API_VERSION_MINOR);
+}
+
+static void mspOutFcVariant(void)
 {
     uint32_t i;
-    uint8_t len;
-#ifdef GPS
-    uint8_t wp_no;
-    int32_t lat = 0, lon = 0;
-#endif
 
-    switch (cmdMSP) {
-    case MSP_API_VERSION:
-        headSerialReply(
-            1 + // protocol version length
-            API_VERSION_LENGTH
-        );
-        serialize8(MSP_PROTOCOL_VERSION);
+    headSerialReply(FLIGHT_CONTROLLER_IDENTIFIER_LENGTH);
+
+    for (i = 0; i < FLIGHT_CONTROLLER_IDENTIFIER_LENGTH; i++) {
+        serialize8(flightControllerIdentifier[i]);
+    }
+}
+
+static void mspOutFcVersion(void)
+{
+    headSerialReply(FLIGHT_CONTROLLER_VERSION_LENGTH);
 
-        serialize8(API_VERSION_MAJOR);
-        serialize8(API_VERSION_MINOR);
-        break;
+    serialize8(FC_VERSION_MAJOR);
+    serialize8(FC_VERSION_MINOR);
+    serialize8(FC_VERSION_PATCH_LEVEL);
+}
 
-    case MSP_FC_VARIANT:
-        headSerialReply(FLIGHT_CONTROLLER_IDENTIFIER_LENGTH);
+static void mspOutBoardInfo(void)
+{
+    uint32_t i;
 
-        for (i = 0; i < FLIGHT_CONTROLLER_IDENTIFIER_LENGTH; i++) {
-            serialize8(flightControllerIdentifier[i]);
-        }
-        break;
-
-    case MSP_FC_VERSION:
-        headSerialReply(FLIGHT_CONTROLLER_VERSION_LENGTH);
-
-        serialize8(FC_VERSION_MAJOR);
-        serialize8(FC_VERSION_MINOR);
-        serialize8(FC_VERSION_PATCH_LEVEL);
-        break;
-
-    case MSP_BOARD_INFO:
-        headSerialReply(
-            BOARD_IDENTIFIER_LENGTH +
-            BOARD_HARDWARE_REVISION_LENGTH
-        );
-        for (i = 0; i < BOARD_IDENTIFIER_LENGTH; i++) {
-            serialize8(boardIdentifier[i]);
-        }
+    headSerialReply(
+        BOARD_IDENTIFIER_LENGTH +
+        BOARD_HARDWARE_REVISION_LENGTH
+    );
+    for (i = 0; i < BOARD_IDENTIFIER_LENGTH; i++) {
+        serialize8(boardIdentifier[i]);
+    }
 #ifdef USE_HARDWARE_REVISION_DETECTION
-        serialize16(hardwareRevision);
+    serialize16(hardwareRevision);
 #else
-        serialize16(0); // No other build targets currently have hardware revision detection.
+    serialize16(0); // No other build targets currently have hardware revision detection.
 #endif
-        break;
+}
 
-    case MSP_BUILD_INFO:
-        headSerialReply(
-                BUILD_DATE_LENGTH +
-                BUILD_TIME_LENGTH +
-                GIT_SHORT_REVISION_LENGTH
-        );
+static void mspOutBuildInfo(void)
+{
+    uint32_t i;
 
-        for (i = 0; i < BUILD_DATE_LENGTH; i++) {
-            serialize8(buildDate[i]);
-        }
-        for (i = 0; i < BUILD_TIME_LENGTH; i++) {
-            serialize8(buildTime[i]);
-        }
+    headSerialReply(
+            BUILD_DATE_LENGTH +
+            BUILD_TIME_LENGTH +
+            GIT_SHORT_REVISION_LENGTH
+    );
 
-        for (i = 0; i < GIT_SHORT_REVISION_LENGTH; i++) {
-            serialize8(shortGitRevision[i]);
-        }
-        break;
-
-    // DEPRECATED - Use MSP_API_VERSION
-    case MSP_IDENT:
-        headSerialReply(7);
-        serialize8(MW_VERSION);
-        serialize8(masterConfig.mixerMode);
-        serialize8(MSP_PROTOCOL_VERSION);
-        serialize32(CAP_DYNBALANCE); // "capability"
-        break;
-
-    case MSP_STATUS_EX:
-        headSerialReply(15);
-        serialize16(cycleTime);
-#ifdef USE_I2C
-        serialize16(i2cGetErrorCounter());
-#else
-        serialize16(0);
-#endif
-        serialize16(sensors(SENSOR_ACC) | sensors(SENSOR_BARO) << 1 | sensors(SENSOR_MAG) << 2 | sensors(SENSOR_GPS) << 3 | sensors(SENSOR_SONAR) << 4);
-        serialize32(packFlightModeFlags());
-        serialize8(getCurrentProfile());
-        serialize16(constrain(averageSystemLoadPercent, 0, 100));
-        serialize8(MAX_PROFILE_COUNT);
-        serialize8(getCurrentControlRateProfile());
-        break;
-
-    case MSP_NAME:
-        len = strlen(masterConfig.name);
-        headSerialReply(len);
-        for (uint8_t i=0; i<len; i++) {
-            serialize8(masterConfig.name[i]);
-        }
-        break;
+    for (i = 0; i < BUILD_DATE_LENGTH; i++) {
+        serialize8(buildDate[i]);
+    }
+    for (i = 0; i < BUILD_TIME_LENGTH; i++) {
+        serialize8(buildTime[i]);
+    }
+
+    for (i = 0; i < GIT_SHORT_REVISION_LENGTH; i++) {
+        serialize8(shortGitRevision[i]);
+    }
+}
+
+// DEPRECATED - Use MSP_API_VERSION
+static void mspOutIdent(void)
+{
+    headSerialReply(7);
+    serialize8(MW_VERSION);
+    serialize8(masterConfig.mixerMode);
+    serialize8(MSP_PROTOCOL_VERSION);
+    serialize32(CAP_DYNBALANCE); // "capability"
+}
 
-    case MSP_STATUS:
-        headSerialReply(11);
-        serialize16(cycleTime);
+static void mspOutStatusEx(void)
+{
+    headSerialReply(15);
+    serialize16(cycleTime);
 #ifdef USE_I2C
-        serialize16(i2cGetErrorCounter());
-#else
-        serialize16(0);
-#endif
-        serialize16(sensors(SENSOR_ACC) | sensors(SENSOR_BARO) << 1 | sensors(SENSOR_MAG) << 2 | sensors(SENSOR_GPS) << 3 | sensors(SENSOR_SONAR) << 4);
-        serialize32(packFlightModeFlags());
-        serialize8(masterConfig.current_profile_index);
-        break;
-    case MSP_RAW_IMU:
-        headSerialReply(18);
-
-        // Hack scale due to choice of units for sensor data in multiwii
-        const uint8_t scale = (acc.acc_1G > 512) ? 4 : 1;
-
-        for (i = 0; i < 3; i++)
-            serialize16(accSmooth[i] / scale);
-        for (i = 0; i < 3; i++)
-            serialize16(gyroADC[i]);
-        for (i = 0; i < 3; i++)
-            serialize16(magADC[i]);
-        break;
-#ifdef USE_SERVOS
-    case MSP_SERVO:
-        s_struct((uint8_t *)&servo, MAX_SUPPORTED_SERVOS * 2);
-        break;
-    case MSP_SERVO_CONFIGURATIONS:
-        headSerialReply(MAX_SUPPORTED_SERVOS * sizeof(servoParam_t));
-        for (i = 0; i < MAX_SUPPORTED_SERVOS; i++) {
-            serialize16(masterConfig.servoConf[i].min);
-            serialize16(masterConfig.servoConf[i].max);
-            serialize16(masterConfig.servoConf[i].middle);
-            serialize8(masterConfig.servoConf[i].rate);
-            serialize8(masterConfig.servoConf[i].angleAtMin);
-            serialize8(masterConfig.servoConf[i].angleAtMax);
-            serialize8(masterConfig.servoConf[i].forwardFromChannel);
-            serialize32(masterConfig.servoConf[i].reversedSources);
-        }
-        break;
-    case MSP_SERVO_MIX_RULES:
-        headSerialReply(MAX_SERVO_RULES * sizeof(servoMixer_t));
-        for (i = 0; i < MAX_SERVO_RULES; i++) {
-            serialize8(masterConfig.customServoMixer[i].targetChannel);
-            serialize8(masterConfig.customServoMixer[i].inputSource);
-            serialize8(masterConfig.customServoMixer[i].rate);
-            serialize8(masterConfig.customServoMixer[i].speed);
-            serialize8(masterConfig.customServoMixer[i].min);
-            serialize8(masterConfig.customServoMixer[i].max);
-            serialize8(masterConfig.customServoMixer[i].box);
-        }
-        break;
-#endif
-    case MSP_MOTOR:
-        s_struct((uint8_t *)motor, 16);
-        break;
-    case MSP_RC:
-        headSerialReply(2 * rxRuntimeConfig.channelCount);
-        for (i = 0; i < rxRuntimeConfig.channelCount; i++)
-            serialize16(rcData[i]);
-        break;
-    case MSP_ATTITUDE:
-        headSerialReply(6);
-        serialize16(attitude.values.roll);
-        serialize16(attitude.values.pitch);
-        serialize16(DECIDEGREES_TO_DEGREES(attitude.values.yaw));
-        break;
-    case MSP_ALTITUDE:
-        headSerialReply(6);
-#if defined(BARO) || defined(SONAR)
-        serialize32(altitudeHoldGetEstimatedAltitude());
-#else
-        serialize32(0);
-#endif
-        serialize16(vario);
-        break;
-    case MSP_SONAR_ALTITUDE:
-        headSerialReply(4);
-#if defined(SONAR)
-        serialize32(sonarGetLatestAltitude());
+    serialize16(i2cGetErrorCounter());
 #else
-        serialize32(0);
+    serialize16(0);
 #endif
-        break;
-    case MSP_ANALOG:
-        headSerialReply(7);
-        serialize8((uint8_t)constrain(vbat, 0, 255));
-        serialize16((uint16_t)constrain(mAhDrawn, 0, 0xFFFF)); // milliamp hours drawn from battery
-        serialize16(rssi);
-        if(masterConfig.batteryConfig.multiwiiCurrentMeterOutput) {
-            serialize16((uint16_t)constrain(amperage * 10, 0, 0xFFFF)); // send amperage in 0.001 A steps. Negative range is truncated to zero
-        } else
-            serialize16((int16_t)constrain(amperage, -0x8000, 0x7FFF)); // send amperage in 0.01 A steps, range is -320A to 320A
-        break;
-    case MSP_ARMING_CONFIG:
-        headSerialReply(2);
-        serialize8(masterConfig.auto_disarm_delay);
-        serialize8(masterConfig.disarm_kill_switch);
-        break;
-    case MSP_LOOP_TIME:
-        headSerialReply(2);
-        serialize16((uint16_t)gyro.targetLooptime);
-        break;
-    case MSP_RC_TUNING:
-        headSerialReply(12);
-        serialize8(currentControlRateProfile->rcRate8);
-        serialize8(currentControlRateProfile->rcExpo8);
-        for (i = 0 ; i < 3; i++) {
-            serialize8(currentControlRateProfile->rates[i]); // R,P,Y see flight_dynamics_index_t
-        }
-        serialize8(currentControlRateProfile->dynThrPID);
-        serialize8(currentControlRateProfile->thrMid8);
-        serialize8(currentControlRateProfile->thrExpo8);
-        serialize16(currentControlRateProfile->tpa_breakpoint);
-        serialize8(currentControlRateProfile->rcYawExpo8);
-        serialize8(currentControlRateProfile->rcYawRate8);
-        break;
-    case MSP_PID:
-        headSerialReply(3 * PID_ITEM_COUNT);
-        for (i = 0; i < PID_ITEM_COUNT; i++) {
-            serialize8(currentProfile->pidProfile.P8[i]);
-            serialize8(currentProfile->pidProfile.I8[i]);
-            serialize8(currentProfile->pidProfile.D8[i]);
-        }
-        break;
-    case MSP_PIDNAMES:
-        headSerialReply(sizeof(pidnames) - 1);
-        serializeNames(pidnames);
-        break;
-    case MSP_PID_CONTROLLER:
-        headSerialReply(1);
-        serialize8(currentProfile->pidProfile.pidController);
-        break;
-    case MSP_MODE_RANGES:
-        headSerialReply(4 * MAX_MODE_ACTIVATION_CONDITION_COUNT);
-        for (i = 0; i < MAX_MODE_ACTIVATION_CONDITION_COUNT; i++) {
-            modeActivationCondition_t *mac = &masterConfig.modeActivationConditions[i];
-            const box_t *box = &boxes[mac->modeId];
-            serialize8(box->permanentId);
-            serialize8(mac->auxChannelIndex);
-            serialize8(mac->range.startStep);
-            serialize8(mac->range.endStep);
-        }
-        break;
-    case MSP_ADJUSTMENT_RANGES:
-        headSerialReply(MAX_ADJUSTMENT_RANGE_COUNT * (
-                1 + // adjustment index/slot
-                1 + // aux channel index
-                1 + // start step
-                1 + // end step
-                1 + // adjustment function
-                1   // aux switch channel index
-        ));
-        for (i = 0; i < MAX_ADJUSTMENT_RANGE_COUNT; i++) {
-            adjustmentRange_t *adjRange = &masterConfig.adjustmentRanges[i];
-            serialize8(adjRange->adjustmentIndex);
-            serialize8(adjRange->auxChannelIndex);
-            serialize8(adjRange->range.startStep);
-            serialize8(adjRange->range.endStep);
-            serialize8(adjRange->adjustmentFunction);
-            serialize8(adjRange->auxSwitchChannelIndex);
-        }
-        break;
-    case MSP_BOXNAMES:
-        serializeBoxNamesReply();
-        break;
-    case MSP_BOXIDS:
-        headSerialReply(activeBoxIdCount);
-        for (i = 0; i < activeBoxIdCount; i++) {
-            const box_t *box = findBoxByActiveBoxId(activeBoxIds[i]);
-            if (!box) {
-                continue;
-            }
-            serialize8(box->permanentId);
-        }
-        break;
-    case MSP_MISC:
-        headSerialReply(2 * 5 + 3 + 3 + 2 + 4);
-        serialize16(masterConfig.rxConfig.midrc);
+    serialize16(sensors(SENSOR_ACC) | sensors(SENSOR_BARO) << 1 | sensors(SENSOR_MAG) << 2 | sensors(SENSOR_GPS) << 3 | sensors(SENSOR_SONAR) << 4);
+    serialize32(packFlightModeFlags());
+    serialize8(getCurrentProfile());
+    serialize16(constrain(averageSystemLoadPercent, 0, 100));
+    serialize8(MAX_PROFILE_COUNT);
+    serialize8(getCurrentControlRateProfile());
+}
 
-        serialize16(masterConfig.escAndServoConfig.minthrottle);
-        serialize16(masterConfig.escAndServoConfig.maxthrottle);
-        serialize16(masterConfig.escAndServoConfig.mincommand);
+static void mspOutName(void)
+{
+    uint8_t len;
 
-        serialize16(masterConfig.failsafeConfig.failsafe_throttle);
+    len = strlen(masterConfig.name);
+    headSerialReply(len);
+    for (uint8_t i=0; i<len; i++) {
+        serialize8(masterConfig.name[i]);
+    }
+}
 
-#ifdef GPS
-        serialize8(masterConfig.gpsConfig.provider); // gps_type
-        serialize8(0); // TODO gps_baudrate (an index, cleanflight uses a uint32_t
-        serialize8(masterConfig.gpsConfig.sbasMode); // gps_ubx_sbas
+static void mspOutStatus(void)
+{
+    headSerialReply(11);
+    serialize16(cycleTime);
+#ifdef USE_I2C
+    serialize16(i2cGetErrorCounter());
 #else
-        serialize8(0); // gps_type
-        serialize8(0); // TODO gps_baudrate (an index, cleanflight uses a uint32_t
-        serialize8(0); // gps_ubx_sbas
+    serialize16(0);
 #endif
-        serialize8(masterConfig.batteryConfig.multiwiiCurrentMeterOutput);
-        serialize8(masterConfig.rxConfig.rssi_channel);
-        serialize8(0);
-
-        serialize16(masterConfig.mag_declination / 10);
-
-        serialize8(masterConfig.batteryConfig.vbatscale);
-        serialize8(masterConfig.batteryConfig.vbatmincellvoltage);
-        serialize8(masterConfig.batteryConfig.vbatmaxcellvoltage);
-        serialize8(masterConfig.batteryConfig.vbatwarningcellvoltage);
-        break;
-
-    case MSP_MOTOR_PINS:
-        // FIXME This is hardcoded and should not be.
-        headSerialReply(8);
-        for (i = 0; i < 8; i++)
-            serialize8(i + 1);
-        break;
-#ifdef GPS
-    case MSP_RAW_GPS:
-        headSerialReply(16);
-        serialize8(STATE(GPS_FIX));
-        serialize8(GPS_numSat);
-        serialize32(GPS_coord[LAT]);
-        serialize32(GPS_coord[LON]);
-        serialize16(GPS_altitude);
-        serialize16(GPS_speed);
-        serialize16(GPS_ground_course);
-        break;
-    case MSP_COMP_GPS:
-        headSerialReply(5);
-        serialize16(GPS_distanceToHome);
-        serialize16(GPS_directionToHome);
-        serialize8(GPS_update & 1);
-        break;
-    case MSP_WP:
-        wp_no = read8();    // get the wp number
-        headSerialReply(18);
-        if (wp_no == 0) {
-            lat = GPS_home[LAT];
-            lon = GPS_home[LON];
-        } else if (wp_no == 16) {
-            lat = GPS_hold[LAT];
-            lon = GPS_hold[LON];
-        }
-        serialize8(wp_no);
-        serialize32(lat);
-        serialize32(lon);
-        serialize32(AltHold);           // altitude (cm) will come here -- temporary implementation to test feature with apps
-        serialize16(0);                 // heading  will come here (deg)
-        serialize16(0);                 // time to stay (ms) will come here
-        serialize8(0);                  // nav flag will come here
-        break;
-    case MSP_GPSSVINFO:
-        headSerialReply(1 + (GPS_numCh * 4));
-        serialize8(GPS_numCh);
-           for (i = 0; i < GPS_numCh; i++){
-               serialize8(GPS_svinfo_chn[i]);
-               serialize8(GPS_svinfo_svid[i]);
-               serialize8(GPS_svinfo_quality[i]);
-               serialize8(GPS_svinfo_cno[i]);
-           }
-        break;
-#endif
-    case MSP_DEBUG:
-        headSerialReply(DEBUG16_VALUE_COUNT * sizeof(debug[0]));
-
-        // output some useful QA statistics
-        // debug[x] = ((hse_value / 1000000) * 1000) + (SystemCoreClock / 1000000);         // XX0YY [crystal clock : core clock]
-
-        for (i = 0; i < DEBUG16_VALUE_COUNT; i++)
-            serialize16(debug[i]);      // 4 variables are here for general monitoring purpose
-        break;
-
-    // Additional commands that are not compatible with MultiWii
-    case MSP_ACC_TRIM:
-        headSerialReply(4);
-        serialize16(masterConfig.accelerometerTrims.values.pitch);
-        serialize16(masterConfig.accelerometerTrims.values.roll);
-        break;
-
-    case MSP_UID:
-        headSerialReply(12);
-        serialize32(U_ID_0);
-        serialize32(U_ID_1);
-        serialize32(U_ID_2);
-        break;
-
-    case MSP_FEATURE:
-        headSerialReply(4);
-        serialize32(featureMask());
-        break;
-
-    case MSP_BOARD_ALIGNMENT:
-        headSerialReply(6);
-        serialize16(masterConfig.boardAlignment.rollDegrees);
-        serialize16(masterConfig.boardAlignment.pitchDegrees);
-        serialize16(masterConfig.boardAlignment.yawDegrees);
-        break;
-
-    case MSP_VOLTAGE_METER_CONFIG:
-        headSerialReply(4);
-        serialize8(masterConfig.batteryConfig.vbatscale);
-        serialize8(masterConfig.batteryConfig.vbatmincellvoltage);
-        serialize8(masterConfig.batteryConfig.vbatmaxcellvoltage);
-        serialize8(masterConfig.batteryConfig.vbatwarningcellvoltage);
-        break;
-
-    case MSP_CURRENT_METER_CONFIG:
-        headSerialReply(7);
-        serialize16(masterConfig.batteryConfig.currentMeterScale);
-        serialize16(masterConfig.batteryConfig.currentMeterOffset);
-        serialize8(masterConfig.batteryConfig.currentMeterType);
-        serialize16(masterConfig.batteryConfig.batteryCapacity);
-        break;
-
-    case MSP_MIXER:
-        headSerialReply(1);
-        serialize8(masterConfig.mixerMode);
-        break;
-
-    case MSP_RX_CONFIG:
-        headSerialReply(16);
-        serialize8(masterConfig.rxConfig.serialrx_provider);
-        serialize16(masterConfig.rxConfig.maxcheck);
-        serialize16(masterConfig.rxConfig.midrc);
-        serialize16(masterConfig.rxConfig.mincheck);
-        serialize8(masterConfig.rxConfig.spektrum_sat_bind);
-        serialize16(masterConfig.rxConfig.rx_min_usec);
-        serialize16(masterConfig.rxConfig.rx_max_usec);
-        serialize8(masterConfig.rxConfig.rcInterpolation);
-        serialize8(masterConfig.rxConfig.rcInterpolationInterval);
-        serialize16(masterConfig.rxConfig.airModeActivateThreshold);
-        break;
-
-    case MSP_FAILSAFE_CONFIG:
-        headSerialReply(8);
-        serialize8(masterConfig.failsafeConfig.failsafe_delay);
-        serialize8(masterConfig.failsafeConfig.failsafe_off_delay);
-        serialize16(masterConfig.failsafeConfig.failsafe_throttle);
-        serialize8(masterConfig.failsafeConfig.failsafe_kill_switch);
-        serialize16(masterConfig.failsafeConfig.failsafe_throttle_low_delay);
-        serialize8(masterConfig.failsafeConfig.failsafe_procedure);
-        break;
-
-    case MSP_RXFAIL_CONFIG:
-        headSerialReply(3 * (rxRuntimeConfig.channelCount));
-        for (i = 0; i < rxRuntimeConfig.channelCount; i++) {
-            serialize8(masterConfig.rxConfig.failsafe_channel_configurations[i].mode);
-            serialize16(RXFAIL_STEP_TO_CHANNEL_VALUE(masterConfig.rxConfig.failsafe_channel_configurations[i].step));
-        }
-        break;
-
-    case MSP_RSSI_CONFIG:
-        headSerialReply(1);
-        serialize8(masterConfig.rxConfig.rssi_channel);
-        break;
+    serialize16(sensors(SENSOR_ACC) | sensors(SENSOR_BARO) << 1 | sensors(SENSOR_MAG) << 2 | sensors(SENSOR_GPS) << 3 | sensors(SENSOR_SONAR) << 4);
+    serialize32(packFlightModeFlags());
+    serialize8(masterConfig.current_profile_index);
+}
 
-    case MSP_RX_MAP:
-        headSerialReply(MAX_MAPPABLE_RX_INPUTS);
-        for (i = 0; i < MAX_MAPPABLE_RX_INPUTS; i++)
-            serialize8(masterConfig.rxConfig.rcmap[i]);
-        break;
+static void mspOutRawImu(void)
+{
+    uint32_t i;
 
-    case MSP_BF_CONFIG:
-        headSerialReply(1 + 4 + 1 + 2 + 2 + 2 + 2 + 2);
-        serialize8(masterConfig.mixerMode);
+    headSerialReply(18);
 
-        serialize32(featureMask());
+    // Hack scale due to choice of units for sensor data in multiwii
+    const uint8_t scale = (acc.acc_1G > 512) ? 4 : 1;
 
-        serialize8(masterConfig.rxConfig.serialrx_provider);
+    for (i = 0; i < 3; i++)
+        serialize16(accSmooth[i] / scale);
+    for (i = 0; i < 3; i++)
+        serialize16(gyroADC[i]);
+    for (i = 0; i < 3; i++)
+        serialize16(magADC[i]);
+}
 
-        serialize16(masterConfig.boardAlignment.rollDegrees);
-        serialize16(masterConfig.boardAlignment.pitchDegrees);
-        serialize16(masterConfig.boardAlignment.yawDegrees);
+#ifdef USE_SERVOS
+static void mspOutServo(void)
+{
+    s_struct((uint8_t *)&servo, MAX_SUPPORTED_SERVOS * 2);
+}
 
-        serialize16(masterConfig.batteryConfig.currentMeterScale);
-        serialize16(masterConfig.batteryConfig.currentMeterOffset);
-        break;
+static void mspOutServoConfigurations(void)
+{
+    uint32_t i;
 
-    case MSP_CF_SERIAL_CONFIG:
-        headSerialReply(
-            ((sizeof(uint8_t) + sizeof(uint16_t) + (sizeof(uint8_t) * 4)) * serialGetAvailablePortCount())
-        );
-        for (i = 0; i < SERIAL_PORT_COUNT; i++) {
-            if (!serialIsPortAvailable(masterConfig.serialConfig.portConfigs[i].identifier)) {
-                continue;
-            };
-            serialize8(masterConfig.serialConfig.portConfigs[i].identifier);
-            serialize16(masterConfig.serialConfig.portConfigs[i].functionMask);
-            serialize8(masterConfig.serialConfig.portConfigs[i].msp_baudrateIndex);
-            serialize8(masterConfig.serialConfig.portConfigs[i].gps_baudrateIndex);
-            serialize8(masterConfig.serialConfig.portConfigs[i].telemetry_baudrateIndex);
-            serialize8(masterConfig.serialConfig.portConfigs[i].blackbox_baudrateIndex);
-        }
-        break;
+    headSerialReply(MAX_SUPPORTED_SERVOS * sizeof(servoParam_t));
+    for (i = 0; i < MAX_SUPPORTED_SERVOS; i++) {
+        serialize16(masterConfig.servoConf[i].min);
+        serialize16(masterConfig.servoConf[i].max);
+        serialize16(masterConfig.servoConf[i].middle);
+        serialize8(masterConfig.servoConf[i].rate);
+        serialize8(masterConfig.servoConf[i].angleAtMin);
+        serialize8(masterConfig.servoConf[i].angleAtMax);
+        serialize8(masterConfig.servoConf[i].forwardFromChannel);
+        serialize32(masterConfig.servoConf[i].reversedSources);
+    }
+}
 
-#ifdef LED_STRIP
-    case MSP_LED_COLORS:
-        headSerialReply(LED_CONFIGURABLE_COLOR_COUNT * 4);
-        for (i = 0; i < LED_CONFIGURABLE_COLOR_COUNT; i++) {
-            hsvColor_t *color = &masterConfig.colors[i];
-            serialize16(color->h);
-            serialize8(color->s);
-            serialize8(color->v);
-        }
-        break;
+static void mspOutServoMixRules(void)
+{
+    uint32_t i;
 
-    case MSP_LED_STRIP_CONFIG:
-        headSerialReply(LED_MAX_STRIP_LENGTH * 4);
-        for (i = 0; i < LED_MAX_STRIP_LENGTH; i++) {
-            ledConfig_t *ledConfig = &masterConfig.ledConfigs[i];
-            serialize32(*ledConfig);
-        }
-        break;
-
-    case MSP_LED_STRIP_MODECOLOR:
-        headSerialReply(((LED_MODE_COUNT * LED_DIRECTION_COUNT) + LED_SPECIAL_COLOR_COUNT) * 3);
-        for (int i = 0; i < LED_MODE_COUNT; i++) {
-            for (int j = 0; j < LED_DIRECTION_COUNT; j++) {
-                serialize8(i);
-                serialize8(j);
-                serialize8(masterConfig.modeColors[i].color[j]);
-            }
-        }
+    headSerialReply(MAX_SERVO_RULES * sizeof(servoMixer_t));
+    for (i = 0; i < MAX_SERVO_RULES; i++) {
+        serialize8(masterConfig.customServoMixer[i].targetChannel);
+        serialize8(masterConfig.customServoMixer[i].inputSource);
+        serialize8(masterConfig.customServoMixer[i].rate);
+        serialize8(masterConfig.customServoMixer[i].speed);
+        serialize8(masterConfig.customServoMixer[i].min);
+        serialize8(masterConfig.customServoMixer[i].max);
+        serialize8(masterConfig.customServoMixer[i].box);
+    }
+}
 
-        for (int j = 0; j < LED_SPECIAL_COLOR_COUNT; j++) {
-            serialize8(LED_MODE_COUNT);
-            serialize8(j);
-            serialize8(masterConfig.specialColors.color[j]);
-        }
-        break;
 #endif
+static void mspOutMotor(void)
+{
+    s_struct((uint8_t *)motor, 16);
+}
 
-    case MSP_DATAFLASH_SUMMARY:
-        serializeDataflashSummaryReply();
-        break;
+static void mspOutRc(void)
+{
+    uint32_t i;
 
-#ifdef USE_FLASHFS
-    case MSP_DATAFLASH_READ:
-        {
-            uint32_t readAddress = read32();
+    headSerialReply(2 * rxRuntimeConfig.channelCount);
+    for (i = 0; i < rxRuntimeConfig.channelCount; i++)
+        serialize16(rcData[i]);
+}
 
-            serializeDataflashReadReply(readAddress, 128);
-        }
-        break;
-#endif
+static void mspOutAttitude(void)
+{
+    headSerialReply(6);
+    serialize16(attitude.values.roll);
+    serialize16(attitude.values.pitch);
+    serialize16(DECIDEGREES_TO_DEGREES(attitude.values.yaw));
+}
 
-    case MSP_BLACKBOX_CONFIG:
-        headSerialReply(4);
+static void mspOutAltitude(void)
+{
+    headSerialReply(6);
+#if defined(BARO) || defined(SONAR)
+    serialize32(altitudeHoldGetEstimatedAltitude());
+#else
+    serialize32(0);
+#endif
+    serialize16(vario);
+}
 
-#ifdef BLACKBOX
-        serialize8(1); //Blackbox supported
-        serialize8(masterConfig.blackbox_device);
-        serialize8(masterConfig.blackbox_rate_num);
-        serialize8(masterConfig.blackbox_rate_denom);
+static void mspOutSonarAltitude(void)
+{
+    headSerialReply(4);
+#if defined(SONAR)
+    serialize32(sonarGetLatestAltitude());
 #else
-        serialize8(0); // Blackbox not supported
-        serialize8(0);
-        serialize8(0);
-        serialize8(0);
+    serialize32(0);
 #endif
-        break;
+}
 
-    case MSP_SDCARD_SUMMARY:
-        serializeSDCardSummaryReply();
-        break;
+static void mspOutAnalog(void)
+{
+    headSerialReply(7);
+    serialize8((uint8_t)constrain(vbat, 0, 255));
+    serialize16((uint16_t)constrain(mAhDrawn, 0, 0xFFFF)); // milliamp hours drawn from battery
+    serialize16(rssi);
+    if(masterConfig.batteryConfig.multiwiiCurrentMeterOutput) {
+        serialize16((uint16_t)constrain(amperage * 10, 0, 0xFFFF)); // send amperage in 0.001 A steps. Negative range is truncated to zero
+    } else
+        serialize16((int16_t)constrain(amperage, -0x8000, 0x7FFF)); // send amperage in 0.01 A steps, range is -320A to 320A
+}
 
-    case MSP_TRANSPONDER_CONFIG:
-#ifdef TRANSPONDER
-        headSerialReply(1 + sizeof(masterConfig.transponderData));
+static void mspOutArmingConfig(void)
+{
+    headSerialReply(2);
+    serialize8(masterConfig.auto_disarm_delay);
+    serialize8(masterConfig.disarm_kill_switch);
+}
 
-        serialize8(1); //Transponder supported
+static void mspOutLoopTime(void)
+{
+    headSerialReply(2);
+    serialize16((uint16_t)gyro.targetLooptime);
+}
 
-        for (i = 0; i < sizeof(masterConfig.transponderData); i++) {
-            serialize8(masterConfig.transponderData[i]);
-        }
-#else
-        headSerialReply(1);
-        serialize8(0); // Transponder not supported
-#endif
-        break;
+static void mspOutRcTuning(void)
+{
+    uint32_t i;
 
-    case MSP_OSD_CONFIG:
-#ifdef OSD
-        headSerialReply(2 + (OSD_MAX_ITEMS * 2));
-        serialize8(1); // OSD supported
-        // send video system (AUTO/PAL/NTSC)
-        serialize8(masterConfig.osdProfile.video_system);
-        for (i = 0; i < OSD_MAX_ITEMS; i++) {
-            serialize16(masterConfig.osdProfile.item_pos[i]);
-        }
-#else
-        headSerialReply(1);
-        serialize8(0); // OSD not supported
-#endif
-        break;
-
-    case MSP_BF_BUILD_INFO:
-        headSerialReply(11 + 4 + 4);
-        for (i = 0; i < 11; i++)
-        serialize8(buildDate[i]); // MMM DD YYYY as ascii, MMM = Jan/Feb... etc
-        serialize32(0); // future exp
-        serialize32(0); // future exp
-        break;
-
-    case MSP_3D:
-        headSerialReply(2 * 3);
-        serialize16(masterConfig.flight3DConfig.deadband3d_low);
-        serialize16(masterConfig.flight3DConfig.deadband3d_high);
-        serialize16(masterConfig.flight3DConfig.neutral3d);
-        break;
-
-    case MSP_RC_DEADBAND:
-        headSerialReply(5);
-        serialize8(masterConfig.rcControlsConfig.deadband);
-        serialize8(masterConfig.rcControlsConfig.yaw_deadband);
-        serialize8(masterConfig.rcControlsConfig.alt_hold_deadband);
-        serialize16(masterConfig.flight3DConfig.deadband3d_throttle);
-        break;
-    case MSP_SENSOR_ALIGNMENT:
-        headSerialReply(3);
-        serialize8(masterConfig.sensorAlignmentConfig.gyro_align);
-        serialize8(masterConfig.sensorAlignmentConfig.acc_align);
-        serialize8(masterConfig.sensorAlignmentConfig.mag_align);
-        break;
-    case MSP_ADVANCED_CONFIG :
-        headSerialReply(6);
-        if (masterConfig.gyro_lpf) {
-            serialize8(8); // If gyro_lpf != OFF then looptime is set to 1000
-            serialize8(1);
-        } else {
-            serialize8(masterConfig.gyro_sync_denom);
-            serialize8(masterConfig.pid_process_denom);
-        }
-        serialize8(masterConfig.use_unsyncedPwm);
-        serialize8(masterConfig.motor_pwm_protocol);
-        serialize16(masterConfig.motor_pwm_rate);
-        break;
-    case MSP_FILTER_CONFIG :
-        headSerialReply(5);
-        serialize8(masterConfig.gyro_soft_lpf_hz);
-        serialize16(currentProfile->pidProfile.dterm_lpf_hz);
-        serialize16(currentProfile->pidProfile.yaw_lpf_hz);
-        break;
-    case MSP_PID_ADVANCED:
-        headSerialReply(17);
-        serialize16(currentProfile->pidProfile.rollPitchItermIgnoreRate);
-        serialize16(currentProfile->pidProfile.yawItermIgnoreRate);
-        serialize16(currentProfile->pidProfile.yaw_p_limit);
-        serialize8(currentProfile->pidProfile.deltaMethod);
-        serialize8(currentProfile->pidProfile.vbatPidCompensation);
-        serialize8(currentProfile->pidProfile.ptermSetpointWeight);
-        serialize8(currentProfile->pidProfile.dtermSetpointWeight);
-        serialize8(currentProfile->pidProfile.toleranceBand);
-        serialize8(currentProfile->pidProfile.toleranceBandReduction);
-        serialize8(currentProfile->pidProfile.itermThrottleGain);
-        serialize16(currentProfile->pidProfile.rateAccelLimit);
-        serialize16(currentProfile->pidProfile.yawRateAccelLimit);
-        break;
-    case MSP_SENSOR_CONFIG:
-        headSerialReply(3);
-        serialize8(masterConfig.acc_hardware);
-        serialize8(masterConfig.baro_hardware);
-        serialize8(masterConfig.mag_hardware);
-        break;
-
-    default:
-        return false;
+    headSerialReply(12);
+    serialize8(currentControlRateProfile->rcRate8);
+    serialize8(currentControlRateProfile->rcExpo8);
+    for (i = 0 ; i < 3; i++) {
+        serialize8(currentControlRateProfile->rates[i]); // R,P,Y see flight_dynamics_index_t
     }
-    return true;
+    serialize8(currentControlRateProfile->dynThrPID);
+    serialize8(currentControlRateProfile->thrMid8);
+    serialize8(currentControlRateProfile->thrExpo8);
+    serialize16(currentControlRateProfile->tpa_breakpoint);
+    serialize8(currentControlRateProfile->rcYawExpo8);
+    serialize8(currentControlRateProfile->rcYawRate8);
 }
 
-static bool processInCommand(void)
+static void mspOutPid(void)
 {
     uint32_t i;
-    uint16_t tmp;
-    uint8_t value;
-#ifdef GPS
-    uint8_t wp_no;
-    int32_t lat = 0, lon = 0, alt = 0;
-#endif
+
+    headSerialReply(3 * PID_ITEM_COUNT);
+    for (i = 0; i < PID_ITEM_COUNT; i++) {
+        serialize8(currentProfile->pidProfile.P8[i]);
+        serialize8(currentProfile->pidProfile.I8[i]);
+        serialize8(currentProfile->pidProfile.D8[i]);
+    }
+}
+
+static void mspOutPidnames(void)
+{
+    headSerialReply(sizeof(pidnames) - 1);
+    serializeNames(pidnames);
+}
+
+static void mspOutPidController(void)
+{
+    headSerialReply(1);
+    serialize8(currentProfile->pidProfile.pidController);
+}
+
+static void mspOutModeRanges(void)
+{
+    uint32_t i;
+
+    headSerialReply(4 * MAX_MODE_ACTIVATION_CONDITION_COUNT);
+    for (i = 0; i < MAX_MODE_ACTIVATION_CONDITION_COUNT; i++) {
+        modeActivationCondition_t *mac = &masterConfig.modeActivationConditions[i];
+        const box_t *box = &boxes[mac->modeId];
+        serialize8(box->permanentId);
+        serialize8(mac->auxChannelIndex);
+        serialize8(mac->range.startStep);
+        serialize8(mac->range.endStep);
+    }
+}
+
+static void mspOutAdjustmentRanges(void)
+{
+    uint32_t i;
+
+    headSerialReply(MAX_ADJUSTMENT_RANGE_COUNT * (
+            1 + // adjustment index/slot
+            1 + // aux channel index
+            1 + // start step
+            1 + // end step
+            1 + // adjustment function
+            1   // aux switch channel index
+    ));
+    for (i = 0; i < MAX_ADJUSTMENT_RANGE_COUNT; i++) {
+        adjustmentRange_t *adjRange = &masterConfig.adjustmentRanges[i];
+        serialize8(adjRange->adjustmentIndex);
+        serialize8(adjRange->auxChannelIndex);
+        serialize8(adjRange->range.startStep);
+        serialize8(adjRange->range.endStep);
+        serialize8(adjRange->adjustmentFunction);
+        serialize8(adjRange->auxSwitchChannelIndex);
+    }
+}
+
+static void mspOutBoxnames(void)
+{
+    serializeBoxNamesReply();
+}
+
+static void mspOutBoxids(void)
+{
+    uint32_t i;
+
+    headSerialReply(activeBoxIdCount);
+    for (i = 0; i < activeBoxIdCount; i++) {
+        const box_t *box = findBoxByActiveBoxId(activeBoxIds[i]);
+        if (!box) {
+            continue;
+        }
+        serialize8(box->permanentId);
+    }
+}
+
+static void mspOutMisc(void)
+{
+    headSerialReply(2 * 5 + 3 + 3 + 2 + 4);
+    serialize16(masterConfig.rxConfig.midrc);
+
+    serialize16(masterConfig.escAndServoConfig.minthrottle);
+    serialize16(masterConfig.escAndServoConfig.maxthrottle);
+    serialize16(masterConfig.escAndServoConfig.mincommand);
+
+    serialize16(masterConfig.failsafeConfig.failsafe_throttle);
+
+#ifdef GPS
+    serialize8(masterConfig.gpsConfig.provider); // gps_type
+    serialize8(0); // TODO gps_baudrate (an index, cleanflight uses a uint32_t
+    serialize8(masterConfig.gpsConfig.sbasMode); // gps_ubx_sbas
+#else
+    serialize8(0); // gps_type
+    serialize8(0); // TODO gps_baudrate (an index, cleanflight uses a uint32_t
+    serialize8(0); // gps_ubx_sbas
+#endif
+    serialize8(masterConfig.batteryConfig.multiwiiCurrentMeterOutput);
+    serialize8(masterConfig.rxConfig.rssi_channel);
+    serialize8(0);
+
+    serialize16(masterConfig.mag_declination / 10);
+
+    serialize8(masterConfig.batteryConfig.vbatscale);
+    serialize8(masterConfig.batteryConfig.vbatmincellvoltage);
+    serialize8(masterConfig.batteryConfig.vbatmaxcellvoltage);
+    serialize8(masterConfig.batteryConfig.vbatwarningcellvoltage);
+}
+
+static void mspOutMotorPins(void)
+{
+    uint32_t i;
+
+    // FIXME This is hardcoded and should not be.
+    headSerialReply(8);
+    for (i = 0; i < 8; i++)
+        serialize8(i + 1);
+}
+
+#ifdef GPS
+static void mspOutRawGps(void)
+{
+    headSerialReply(16);
+    serialize8(STATE(GPS_FIX));
+    serialize8(GPS_numSat);
+    serialize32(GPS_coord[LAT]);
+    serialize32(GPS_coord[LON]);
+    serialize16(GPS_altitude);
+    serialize16(GPS_speed);
+    serialize16(GPS_ground_course);
+}
+
+static void mspOutCompGps(void)
+{
+    headSerialReply(5);
+    serialize16(GPS_distanceToHome);
+    serialize16(GPS_directionToHome);
+    serialize8(GPS_update & 1);
+}
+
+static void mspOutWp(void)
+{
+    uint8_t wp_no;
+    int32_t lat = 0;
+    int32_t lon = 0;
+
+    wp_no = read8();    // get the wp number
+    headSerialReply(18);
+    if (wp_no == 0) {
+        lat = GPS_home[LAT];
+        lon = GPS_home[LON];
+    } else if (wp_no == 16) {
+        lat = GPS_hold[LAT];
+        lon = GPS_hold[LON];
+    }
+    serialize8(wp_no);
+    serialize32(lat);
+    serialize32(lon);
+    serialize32(AltHold);           // altitude (cm) will come here -- temporary implementation to test feature with apps
+    serialize16(0);                 // heading  will come here (deg)
+    serialize16(0);                 // time to stay (ms) will come here
+    serialize8(0);                  // nav flag will come here
+}
+
+static void mspOutGpssvinfo(void)
+{
+    uint32_t i;
+
+    headSerialReply(1 + (GPS_numCh * 4));
+    serialize8(GPS_numCh);
+       for (i = 0; i < GPS_numCh; i++){
+           serialize8(GPS_svinfo_chn[i]);
+           serialize8(GPS_svinfo_svid[i]);
+           serialize8(GPS_svinfo_quality[i]);
+           serialize8(GPS_svinfo_cno[i]);
+       }
+}
+
+#endif
+static void mspOutDebug(void)
+{
+    uint32_t i;
+
+    headSerialReply(DEBUG16_VALUE_COUNT * sizeof(debug[0]));
+
+    // output some useful QA statistics
+    // debug[x] = ((hse_value / 1000000) * 1000) + (SystemCoreClock / 1000000);         // XX0YY [crystal clock : core clock]
+
+    for (i = 0; i < DEBUG16_VALUE_COUNT; i++)
+        serialize16(debug[i]);      // 4 variables are here for general monitoring purpose
+}
+
+// Additional commands that are not compatible with MultiWii
+static void mspOutAccTrim(void)
+{
+    headSerialReply(4);
+    serialize16(masterConfig.accelerometerTrims.values.pitch);
+    serialize16(masterConfig.accelerometerTrims.values.roll);
+}
+
+static void mspOutUid(void)
+{
+    headSerialReply(12);
+    serialize32(U_ID_0);
+    serialize32(U_ID_1);
+    serialize32(U_ID_2);
+}
+
+static void mspOutFeature(void)
+{
+    headSerialReply(4);
+    serialize32(featureMask());
+}
+
+static void mspOutBoardAlignment(void)
+{
+    headSerialReply(6);
+    serialize16(masterConfig.boardAlignment.rollDegrees);
+    serialize16(masterConfig.boardAlignment.pitchDegrees);
+    serialize16(masterConfig.boardAlignment.yawDegrees);
+}
+
+static void mspOutVoltageMeterConfig(void)
+{
+    headSerialReply(4);
+    serialize8(masterConfig.batteryConfig.vbatscale);
+    serialize8(masterConfig.batteryConfig.vbatmincellvoltage);
+    serialize8(masterConfig.batteryConfig.vbatmaxcellvoltage);
+    serialize8(masterConfig.batteryConfig.vbatwarningcellvoltage);
+}
+
+static void mspOutCurrentMeterConfig(void)
+{
+    headSerialReply(7);
+    serialize16(masterConfig.batteryConfig.currentMeterScale);
+    serialize16(masterConfig.batteryConfig.currentMeterOffset);
+    serialize8(masterConfig.batteryConfig.currentMeterType);
+    serialize16(masterConfig.batteryConfig.batteryCapacity);
+}
+
+static void mspOutMixer(void)
+{
+    headSerialReply(1);
+    serialize8(masterConfig.mixerMode);
+}
+
+static void mspOutRxConfig(void)
+{
+    headSerialReply(16);
+    serialize8(masterConfig.rxConfig.serialrx_provider);
+    serialize16(masterConfig.rxConfig.maxcheck);
+    serialize16(masterConfig.rxConfig.midrc);
+    serialize16(masterConfig.rxConfig.mincheck);
+    serialize8(masterConfig.rxConfig.spektrum_sat_bind);
+    serialize16(masterConfig.rxConfig.rx_min_usec);
+    serialize16(masterConfig.rxConfig.rx_max_usec);
+    serialize8(masterConfig.rxConfig.rcInterpolation);
+    serialize8(masterConfig.rxConfig.rcInterpolationInterval);
+    serialize16(masterConfig.rxConfig.airModeActivateThreshold);
+}
+
+static void mspOutFailsafeConfig(void)
+{
+    headSerialReply(8);
+    serialize8(masterConfig.failsafeConfig.failsafe_delay);
+    serialize8(masterConfig.failsafeConfig.failsafe_off_delay);
+    serialize16(masterConfig.failsafeConfig.failsafe_throttle);
+    serialize8(masterConfig.failsafeConfig.failsafe_kill_switch);
+    serialize16(masterConfig.failsafeConfig.failsafe_throttle_low_delay);
+    serialize8(masterConfig.failsafeConfig.failsafe_procedure);
+}
+
+static void mspOutRxfailConfig(void)
+{
+    uint32_t i;
+
+    headSerialReply(3 * (rxRuntimeConfig.channelCount));
+    for (i = 0; i < rxRuntimeConfig.channelCount; i++) {
+        serialize8(masterConfig.rxConfig.failsafe_channel_configurations[i].mode);
+        serialize16(RXFAIL_STEP_TO_CHANNEL_VALUE(masterConfig.rxConfig.failsafe_channel_configurations[i].step));
+    }
+}
+
+static void mspOutRssiConfig(void)
+{
+    headSerialReply(1);
+    serialize8(masterConfig.rxConfig.rssi_channel);
+}
+
+static void mspOutRxMap(void)
+{
+    uint32_t i;
+
+    headSerialReply(MAX_MAPPABLE_RX_INPUTS);
+    for (i = 0; i < MAX_MAPPABLE_RX_INPUTS; i++)
+        serialize8(masterConfig.rxConfig.rcmap[i]);
+}
+
+static void mspOutBfConfig(void)
+{
+    headSerialReply(1 + 4 + 1 + 2 + 2 + 2 + 2 + 2);
+    serialize8(masterConfig.mixerMode);
+
+    serialize32(featureMask());
+
+    serialize8(masterConfig.rxConfig.serialrx_provider);
+
+    serialize16(masterConfig.boardAlignment.rollDegrees);
+    serialize16(masterConfig.boardAlignment.pitchDegrees);
+    serialize16(masterConfig.boardAlignment.yawDegrees);
+
+    serialize16(masterConfig.batteryConfig.currentMeterScale);
+    serialize16(masterConfig.batteryConfig.currentMeterOffset);
+}
+
+static void mspOutCfSerialConfig(void)
+{
+    uint32_t i;
+
+    headSerialReply(
+        ((sizeof(uint8_t) + sizeof(uint16_t) + (sizeof(uint8_t) * 4)) * serialGetAvailablePortCount())
+    );
+    for (i = 0; i < SERIAL_PORT_COUNT; i++) {
+        if (!serialIsPortAvailable(masterConfig.serialConfig.portConfigs[i].identifier)) {
+            continue;
+        };
+        serialize8(masterConfig.serialConfig.portConfigs[i].identifier);
+        serialize16(masterConfig.serialConfig.portConfigs[i].functionMask);
+        serialize8(masterConfig.serialConfig.portConfigs[i].msp_baudrateIndex);
+        serialize8(masterConfig.serialConfig.portConfigs[i].gps_baudrateIndex);
+        serialize8(masterConfig.serialConfig.portConfigs[i].telemetry_baudrateIndex);
+        serialize8(masterConfig.serialConfig.portConfigs[i].blackbox_baudrateIndex);
+    }
+}
+
+#ifdef LED_STRIP
+static void mspOutLedColors(void)
+{
+    uint32_t i;
+
+    headSerialReply(LED_CONFIGURABLE_COLOR_COUNT * 4);
+    for (i = 0; i < LED_CONFIGURABLE_COLOR_COUNT; i++) {
+        hsvColor_t *color = &masterConfig.colors[i];
+        serialize16(color->h);
+        serialize8(color->s);
+        serialize8(color->v);
+    }
+}
+
+static void mspOutLedStripConfig(void)
+{
+    uint32_t i;
+
+    headSerialReply(LED_MAX_STRIP_LENGTH * 4);
+    for (i = 0; i < LED_MAX_STRIP_LENGTH; i++) {
+        ledConfig_t *ledConfig = &masterConfig.ledConfigs[i];
+        serialize32(*ledConfig);
+    }
+}
+
+static void mspOutLedStripModecolor(void)
+{
+    headSerialReply(((LED_MODE_COUNT * LED_DIRECTION_COUNT) + LED_SPECIAL_COLOR_COUNT) * 3);
+    for (int i = 0; i < LED_MODE_COUNT; i++) {
+        for (int j = 0; j < LED_DIRECTION_COUNT; j++) {
+            serialize8(i);
+            serialize8(j);
+            serialize8(masterConfig.modeColors[i].color[j]);
+        }
+    }
+
+    for (int j = 0; j < LED_SPECIAL_COLOR_COUNT; j++) {
+        serialize8(LED_MODE_COUNT);
+        serialize8(j);
+        serialize8(masterConfig.specialColors.color[j]);
+    }
+}
+
+#endif
+static void mspOutDataflashSummary(void)
+{
+    serializeDataflashSummaryReply();
+}
+
+#ifdef USE_FLASHFS
+static void mspOutDataflashRead(void)
+{
+    uint32_t readAddress = read32();
+
+    if (currentPort->dataSize >= 4 + 2) {
+        // Bulk read, the host may keep several of these outstanding to hide the round trip time
+        uint16_t readLength = read16();
+        bool allowCompression = currentPort->dataSize >= 4 + 2 + 1 && read8();
+
+        // Large replies hold up the main loop while they're sent, so only allow them on the ground
+        if (readLength > MSP_DATAFLASH_BULK_READ_MAX_SIZE) {
+            readLength = MSP_DATAFLASH_BULK_READ_MAX_SIZE;
+        }
+        if (ARMING_FLAG(ARMED) && readLength > MSP_DATAFLASH_READ_SIZE) {
+            readLength = MSP_DATAFLASH_READ_SIZE;
+        }
+        // Sending more than fits in a UART's TX buffer would mean waiting for it, only the VCP drains fast enough
+        if (mspSerialPort->identifier != SERIAL_PORT_USB_VCP) {
+            const uint8_t txFree = serialTxBytesFree(mspSerialPort);
+            const uint16_t fitsInTxBuffer =
+                txFree > MSP_DATAFLASH_BULK_READ_OVERHEAD ? txFree - MSP_DATAFLASH_BULK_READ_OVERHEAD : 0;
+
+            if (readLength > fitsInTxBuffer) {
+                readLength = fitsInTxBuffer;
+            }
+        }
+
+        serializeDataflashBulkReadReply(readAddress, readLength, allowCompression);
+    } else {
+        serializeDataflashReadReply(readAddress, MSP_DATAFLASH_READ_SIZE);
+    }
+}
+
+#endif
+static void mspOutBlackboxConfig(void)
+{
+    headSerialReply(4);
+
+#ifdef BLACKBOX
+    serialize8(1); //Blackbox supported
+    serialize8(masterConfig.blackbox_device);
+    serialize8(masterConfig.blackbox_rate_num);
+    serialize8(masterConfig.blackbox_rate_denom);
+#else
+    serialize8(0); // Blackbox not supported
+    serialize8(0);
+    serialize8(0);
+    serialize8(0);
+#endif
+}
+
+static void mspOutSdcardSummary(void)
+{
+    serializeSDCardSummaryReply();
+}
+
+static void mspOutSdcardCacheStats(void)
+{
+    serializeSDCardCacheStatsReply();
+}
+
+#ifndef SKIP_RX_LATENCY
+static void mspOutRxLatency(void)
+{
+    serializeRxLatencyReply(currentPort->dataSize >= 1 ? read8() : RX_LATENCY_RC_COMMAND);
+}
+#endif
+
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+static void mspOutSdcardLogList(void)
+{
+    serializeSDCardLogListReply(currentPort->dataSize >= 2 ? read16() : 0);
+}
+
+static void mspOutSdcardLogOpen(void)
+{
+    uint32_t i;
+
+    headSerialReply(1);
+
+    if (currentPort->dataSize >= FAT_FILENAME_LENGTH) {
+        char filename[FAT_FILENAME_LENGTH];
+
+        for (i = 0; i < FAT_FILENAME_LENGTH; i++) {
+            filename[i] = read8();
+        }
+
+        serialize8(blackboxLogReaderOpen(filename));
+    } else {
+        // No filename closes the open log
+        blackboxLogReaderClose();
+        serialize8(BLACKBOX_LOG_READER_READY);
+    }
+}
+
+static void mspOutSdcardLogRead(void)
+{
+    if (currentPort->dataSize < 4 + 2) {
+        headSerialError(0);
+        return;
+    }
+
+    uint32_t readOffset = read32();
+    uint16_t readLength = read16();
+    bool allowCompression = currentPort->dataSize >= 4 + 2 + 1 && read8();
+
+    if (readLength > MSP_SDCARD_LOG_READ_MAX_SIZE) {
+        readLength = MSP_SDCARD_LOG_READ_MAX_SIZE;
+    }
+
+    serializeSDCardLogReadReply(readOffset, readLength, allowCompression);
+}
+
+#endif
+static void mspOutTransponderConfig(void)
+{
+#ifdef TRANSPONDER
+    uint32_t i;
+
+    headSerialReply(1 + sizeof(masterConfig.transponderData));
+
+    serialize8(1); //Transponder supported
+
+    for (i = 0; i < sizeof(masterConfig.transponderData); i++) {
+        serialize8(masterConfig.transponderData[i]);
+    }
+#else
+    headSerialReply(1);
+    serialize8(0); // Transponder not supported
+#endif
+}
+
+static void mspOutOsdConfig(void)
+{
+#ifdef OSD
+    uint32_t i;
+
+    headSerialReply(2 + (OSD_MAX_ITEMS * 2));
+    serialize8(1); // OSD supported
+    // send video system (AUTO/PAL/NTSC)
+    serialize8(masterConfig.osdProfile.video_system);
+    for (i = 0; i < OSD_MAX_ITEMS; i++) {
+        serialize16(masterConfig.osdProfile.item_pos[i]);
+    }
+#else
+    headSerialReply(1);
+    serialize8(0); // OSD not supported
+#endif
+}
+
+static void mspOutBfBuildInfo(void)
+{
+    uint32_t i;
+
+    headSerialReply(11 + 4 + 4);
+    for (i = 0; i < 11; i++)
+    serialize8(buildDate[i]); // MMM DD YYYY as ascii, MMM = Jan/Feb... etc
+    serialize32(0); // future exp
+    serialize32(0); // future exp
+}
+
+static void mspOut3d(void)
+{
+    headSerialReply(2 * 3);
+    serialize16(masterConfig.flight3DConfig.deadband3d_low);
+    serialize16(masterConfig.flight3DConfig.deadband3d_high);
+    serialize16(masterConfig.flight3DConfig.neutral3d);
+}
+
+static void mspOutRcDeadband(void)
+{
+    headSerialReply(5);
+    serialize8(masterConfig.rcControlsConfig.deadband);
+    serialize8(masterConfig.rcControlsConfig.yaw_deadband);
+    serialize8(masterConfig.rcControlsConfig.alt_hold_deadband);
+    serialize16(masterConfig.flight3DConfig.deadband3d_throttle);
+}
+
+static void mspOutSensorAlignment(void)
+{
+    headSerialReply(3);
+    serialize8(masterConfig.sensorAlignmentConfig.gyro_align);
+    serialize8(masterConfig.sensorAlignmentConfig.acc_align);
+    serialize8(masterConfig.sensorAlignmentConfig.mag_align);
+}
+
+static void mspOutAdvancedConfig(void)
+{
+    headSerialReply(6);
+    if (masterConfig.gyro_lpf) {
+        serialize8(8); // If gyro_lpf != OFF then looptime is set to 1000
+        serialize8(1);
+    } else {
+        serialize8(masterConfig.gyro_sync_denom);
+        serialize8(masterConfig.pid_process_denom);
+    }
+    serialize8(masterConfig.use_unsyncedPwm);
+    serialize8(masterConfig.motor_pwm_protocol);
+    serialize16(masterConfig.motor_pwm_rate);
+}
+
+static void mspOutFilterConfig(void)
+{
+    headSerialReply(5);
+    serialize8(masterConfig.gyro_soft_lpf_hz);
+    serialize16(currentProfile->pidProfile.dterm_lpf_hz);
+    serialize16(currentProfile->pidProfile.yaw_lpf_hz);
+}
+
+static void mspOutPidAdvanced(void)
+{
+    headSerialReply(17);
+    serialize16(currentProfile->pidProfile.rollPitchItermIgnoreRate);
+    serialize16(currentProfile->pidProfile.yawItermIgnoreRate);
+    serialize16(currentProfile->pidProfile.yaw_p_limit);
+    serialize8(currentProfile->pidProfile.deltaMethod);
+    serialize8(currentProfile->pidProfile.vbatPidCompensation);
+    serialize8(currentProfile->pidProfile.ptermSetpointWeight);
+    serialize8(currentProfile->pidProfile.dtermSetpointWeight);
+    serialize8(currentProfile->pidProfile.toleranceBand);
+    serialize8(currentProfile->pidProfile.toleranceBandReduction);
+    serialize8(currentProfile->pidProfile.itermThrottleGain);
+    serialize16(currentProfile->pidProfile.rateAccelLimit);
+    serialize16(currentProfile->pidProfile.yawRateAccelLimit);
+}
+
+static void mspOutSensorConfig(void)
+{
+    headSerialReply(3);
+    serialize8(masterConfig.acc_hardware);
+    serialize8(masterConfig.baro_hardware);
+    serialize8(masterConfig.mag_hardware);
+}
+
+static void mspOutSubscriptions(void)
+{
+    const mspPortSubscriptions_t *portSubscriptions = mspGetPortSubscriptions(currentPort);
+
+    headSerialReply(1 + portSubscriptions->count * 4);
+    serialize8(portSubscriptions->count);
+
+    for (int i = 0; i < portSubscriptions->count; i++) {
+        serialize16(portSubscriptions->subscriptions[i].cmdMSP);
+        serialize16(portSubscriptions->subscriptions[i].period);
+    }
+}
+
+static const mspOutCommand_t mspOutCommands[] = {
+    { MSP_API_VERSION, mspOutApiVersion, 0 },
+    { MSP_FC_VARIANT, mspOutFcVariant, 0 },
+    { MSP_FC_VERSION, mspOutFcVersion, 0 },
+    { MSP_BOARD_INFO, mspOutBoardInfo, 0 },
+    { MSP_BUILD_INFO, mspOutBuildInfo, 0 },
+    { MSP_IDENT, mspOutIdent, 0 },
+    { MSP_STATUS_EX, mspOutStatusEx, 0 },
+    { MSP_NAME, mspOutName, 0 },
+    { MSP_STATUS, mspOutStatus, 0 },
+    { MSP_RAW_IMU, mspOutRawImu, 0 },
+#ifdef USE_SERVOS
+    { MSP_SERVO, mspOutServo, 0 },
+    { MSP_SERVO_CONFIGURATIONS, mspOutServoConfigurations, 0 },
+    { MSP_SERVO_MIX_RULES, mspOutServoMixRules, 0 },
+#endif
+    { MSP_MOTOR, mspOutMotor, 0 },
+    { MSP_RC, mspOutRc, 0 },
+    { MSP_ATTITUDE, mspOutAttitude, 0 },
+    { MSP_ALTITUDE, mspOutAltitude, 0 },
+    { MSP_SONAR_ALTITUDE, mspOutSonarAltitude, 0 },
+    { MSP_ANALOG, mspOutAnalog, 0 },
+    { MSP_ARMING_CONFIG, mspOutArmingConfig, 0 },
+    { MSP_LOOP_TIME, mspOutLoopTime, 0 },
+    { MSP_RC_TUNING, mspOutRcTuning, 0 },
+    { MSP_PID, mspOutPid, 0 },
+    { MSP_PIDNAMES, mspOutPidnames, 0 },
+    { MSP_PID_CONTROLLER, mspOutPidController, 0 },
+    { MSP_MODE_RANGES, mspOutModeRanges, 0 },
+    { MSP_ADJUSTMENT_RANGES, mspOutAdjustmentRanges, 0 },
+    { MSP_BOXNAMES, mspOutBoxnames, 0 },
+    { MSP_BOXIDS, mspOutBoxids, 0 },
+    { MSP_MISC, mspOutMisc, 0 },
+    { MSP_MOTOR_PINS, mspOutMotorPins, 0 },
+#ifdef GPS
+    { MSP_RAW_GPS, mspOutRawGps, 0 },
+    { MSP_COMP_GPS, mspOutCompGps, 0 },
+    { MSP_WP, mspOutWp, MSP_FLAG_TAKES_PARAMETERS },
+    { MSP_GPSSVINFO, mspOutGpssvinfo, 0 },
+#endif
+    { MSP_DEBUG, mspOutDebug, 0 },
+    { MSP_ACC_TRIM, mspOutAccTrim, 0 },
+    { MSP_UID, mspOutUid, 0 },
+    { MSP_FEATURE, mspOutFeature, 0 },
+    { MSP_BOARD_ALIGNMENT, mspOutBoardAlignment, 0 },
+    { MSP_VOLTAGE_METER_CONFIG, mspOutVoltageMeterConfig, 0 },
+    { MSP_CURRENT_METER_CONFIG, mspOutCurrentMeterConfig, 0 },
+    { MSP_MIXER, mspOutMixer, 0 },
+    { MSP_RX_CONFIG, mspOutRxConfig, 0 },
+    { MSP_FAILSAFE_CONFIG, mspOutFailsafeConfig, 0 },
+    { MSP_RXFAIL_CONFIG, mspOutRxfailConfig, 0 },
+    { MSP_RSSI_CONFIG, mspOutRssiConfig, 0 },
+    { MSP_RX_MAP, mspOutRxMap, 0 },
+    { MSP_BF_CONFIG, mspOutBfConfig, 0 },
+    { MSP_CF_SERIAL_CONFIG, mspOutCfSerialConfig, 0 },
+#ifdef LED_STRIP
+    { MSP_LED_COLORS, mspOutLedColors, 0 },
+    { MSP_LED_STRIP_CONFIG, mspOutLedStripConfig, 0 },
+    { MSP_LED_STRIP_MODECOLOR, mspOutLedStripModecolor, 0 },
+#endif
+    { MSP_DATAFLASH_SUMMARY, mspOutDataflashSummary, 0 },
+#ifdef USE_FLASHFS
+    { MSP_DATAFLASH_READ, mspOutDataflashRead, MSP_FLAG_TAKES_PARAMETERS },
+#endif
+    { MSP_BLACKBOX_CONFIG, mspOutBlackboxConfig, 0 },
+    { MSP_SDCARD_SUMMARY, mspOutSdcardSummary, 0 },
+    { MSP_SDCARD_CACHE_STATS, mspOutSdcardCacheStats, 0 },
+#ifndef SKIP_RX_LATENCY
+    { MSP_RX_LATENCY, mspOutRxLatency, MSP_FLAG_TAKES_PARAMETERS },
+#endif
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+    { MSP_SDCARD_LOG_LIST, mspOutSdcardLogList, MSP_FLAG_TAKES_PARAMETERS },
+    { MSP_SDCARD_LOG_OPEN, mspOutSdcardLogOpen, MSP_FLAG_TAKES_PARAMETERS },
+    { MSP_SDCARD_LOG_READ, mspOutSdcardLogRead, MSP_FLAG_TAKES_PARAMETERS },
+#endif
+    { MSP_TRANSPONDER_CONFIG, mspOutTransponderConfig, 0 },
+    { MSP_OSD_CONFIG, mspOutOsdConfig, 0 },
+    { MSP_BF_BUILD_INFO, mspOutBfBuildInfo, 0 },
+    { MSP_3D, mspOut3d, 0 },
+    { MSP_RC_DEADBAND, mspOutRcDeadband, 0 },
+    { MSP_SENSOR_ALIGNMENT, mspOutSensorAlignment, 0 },
+    { MSP_ADVANCED_CONFIG, mspOutAdvancedConfig, 0 },
+    { MSP_FILTER_CONFIG, mspOutFilterConfig, 0 },
+    { MSP_PID_ADVANCED, mspOutPidAdvanced, 0 },
+    { MSP_SENSOR_CONFIG, mspOutSensorConfig, 0 },
+    { MSP_SUBSCRIPTIONS, mspOutSubscriptions, 0 },
+};
+
+static const mspOutCommand_t *findOutCommand(uint16_t cmdMSP)
+{
+    for (unsigned i = 0; i < ARRAYLEN(mspOutCommands); i++) {
+        if (mspOutCommands[i].cmdMSP == cmdMSP) {
+            return &mspOutCommands[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool processOutCommand(uint16_t cmdMSP)
+{
+    const mspOutCommand_t *command = findOutCommand(cmdMSP);
+
+    if (command) {
+        command->handler();
+        return true;
+    }
+
+    return false;
+}
+
+static bool mspInSelectSetting(void)
+{
+    uint8_t value;
+
+    value = read8();
+    if ((value & RATEPROFILE_MASK) == 0) {
+        if (!ARMING_FLAG(ARMED)) {
+            if (value >= MAX_PROFILE_COUNT) {
+                value = 0;
+            }
+            changeProfile(value);
+        }
+    } else {
+        value = value & ~RATEPROFILE_MASK;
+
+        if (value >= MAX_RATEPROFILES) {
+            value = 0;
+        }
+        changeControlRateProfile(value);
+    }
+
+    return true;
+}
+
+static bool mspInSetHead(void)
+{
+    magHold = read16();
+
+    return true;
+}
+
+static bool mspInSetRawRc(void)
+{
+#ifndef SKIP_RX_MSP
+    uint32_t i;
+
+    {
+        uint8_t channelCount = currentPort->dataSize / sizeof(uint16_t);
+        if (channelCount > MAX_SUPPORTED_RC_CHANNEL_COUNT) {
+            headSerialError(0);
+        } else {
+            uint16_t frame[MAX_SUPPORTED_RC_CHANNEL_COUNT];
+
+            for (i = 0; i < channelCount; i++) {
+                frame[i] = read16();
+            }
+
+            rxMspFrameReceive(frame, channelCount);
+        }
+    }
+#endif
+
+    return true;
+}
+
+static bool mspInSetAccTrim(void)
+{
+    masterConfig.accelerometerTrims.values.pitch = read16();
+    masterConfig.accelerometerTrims.values.roll  = read16();
+
+    return true;
+}
+
+static bool mspInSetArmingConfig(void)
+{
+    masterConfig.auto_disarm_delay = read8();
+    masterConfig.disarm_kill_switch = read8();
+
+    return true;
+}
+
+static bool mspInSetLoopTime(void)
+{
+    read16();
+
+    return true;
+}
+
+static bool mspInSetPidController(void)
+{
+    currentProfile->pidProfile.pidController = constrain(read8(), 0, 1);
+    pidSetController(currentProfile->pidProfile.pidController);
+
+    return true;
+}
+
+static bool mspInSetPid(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < PID_ITEM_COUNT; i++) {
+        currentProfile->pidProfile.P8[i] = read8();
+        currentProfile->pidProfile.I8[i] = read8();
+        currentProfile->pidProfile.D8[i] = read8();
+    }
+
+    return true;
+}
+
+static bool mspInSetModeRange(void)
+{
+    uint32_t i;
+
+    i = read8();
+    if (i < MAX_MODE_ACTIVATION_CONDITION_COUNT) {
+        modeActivationCondition_t *mac = &masterConfig.modeActivationConditions[i];
+        i = read8();
+        const box_t *box = findBoxByPermenantId(i);
+        if (box) {
+            mac->modeId = box->boxId;
+            mac->auxChannelIndex = read8();
+            mac->range.startStep = read8();
+            mac->range.endStep = read8();
+
+            useRcControlsConfig(masterConfig.modeActivationConditions, &masterConfig.escAndServoConfig, &currentProfile->pidProfile);
+        } else {
+            headSerialError(0);
+        }
+    } else {
+        headSerialError(0);
+    }
+
+    return true;
+}
+
+static bool mspInSetAdjustmentRange(void)
+{
+    uint32_t i;
+
+    i = read8();
+    if (i < MAX_ADJUSTMENT_RANGE_COUNT) {
+        adjustmentRange_t *adjRange = &masterConfig.adjustmentRanges[i];
+        i = read8();
+        if (i < MAX_SIMULTANEOUS_ADJUSTMENT_COUNT) {
+            adjRange->adjustmentIndex = i;
+            adjRange->auxChannelIndex = read8();
+            adjRange->range.startStep = read8();
+            adjRange->range.endStep = read8();
+            adjRange->adjustmentFunction = read8();
+            adjRange->auxSwitchChannelIndex = read8();
+        } else {
+            headSerialError(0);
+        }
+    } else {
+        headSerialError(0);
+    }
+
+    return true;
+}
+
+static bool mspInSetRcTuning(void)
+{
+    uint32_t i;
+    uint8_t value;
+
+    if (currentPort->dataSize >= 10) {
+        currentControlRateProfile->rcRate8 = read8();
+        currentControlRateProfile->rcExpo8 = read8();
+        for (i = 0; i < 3; i++) {
+            value = read8();
+            currentControlRateProfile->rates[i] = MIN(value, i == FD_YAW ? CONTROL_RATE_CONFIG_YAW_RATE_MAX : CONTROL_RATE_CONFIG_ROLL_PITCH_RATE_MAX);
+        }
+        value = read8();
+        currentControlRateProfile->dynThrPID = MIN(value, CONTROL_RATE_CONFIG_TPA_MAX);
+        currentControlRateProfile->thrMid8 = read8();
+        currentControlRateProfile->thrExpo8 = read8();
+        currentControlRateProfile->tpa_breakpoint = read16();
+        if (currentPort->dataSize >= 11) {
+            currentControlRateProfile->rcYawExpo8 = read8();
+        }
+        if (currentPort->dataSize >= 12) {
+            currentControlRateProfile->rcYawRate8 = read8();
+        }
+    } else {
+        headSerialError(0);
+    }
+
+    return true;
+}
+
+static bool mspInSetMisc(void)
+{
+    uint16_t tmp;
+
+    tmp = read16();
+    if (tmp < 1600 && tmp > 1400)
+        masterConfig.rxConfig.midrc = tmp;
+
+    masterConfig.escAndServoConfig.minthrottle = read16();
+    masterConfig.escAndServoConfig.maxthrottle = read16();
+    masterConfig.escAndServoConfig.mincommand = read16();
+
+    masterConfig.failsafeConfig.failsafe_throttle = read16();
+
+#ifdef GPS
+    masterConfig.gpsConfig.provider = read8(); // gps_type
+    read8(); // gps_baudrate
+    masterConfig.gpsConfig.sbasMode = read8(); // gps_ubx_sbas
+#else
+    read8(); // gps_type
+    read8(); // gps_baudrate
+    read8(); // gps_ubx_sbas
+#endif
+    masterConfig.batteryConfig.multiwiiCurrentMeterOutput = read8();
+    masterConfig.rxConfig.rssi_channel = read8();
+    read8();
+
+    masterConfig.mag_declination = read16() * 10;
+
+    masterConfig.batteryConfig.vbatscale = read8();           // actual vbatscale as intended
+    masterConfig.batteryConfig.vbatmincellvoltage = read8();  // vbatlevel_warn1 in MWC2.3 GUI
+    masterConfig.batteryConfig.vbatmaxcellvoltage = read8();  // vbatlevel_warn2 in MWC2.3 GUI
+    masterConfig.batteryConfig.vbatwarningcellvoltage = read8();  // vbatlevel when buzzer starts to alert
+
+    return true;
+}
+
+static bool mspInSetMotor(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < 8; i++) // FIXME should this use MAX_MOTORS or MAX_SUPPORTED_MOTORS instead of 8
+        motor_disarmed[i] = read16();
+
+    return true;
+}
+
+static bool mspInSetServoConfiguration(void)
+{
+#ifdef USE_SERVOS
+    uint32_t i;
+
+    if (currentPort->dataSize != 1 + sizeof(servoParam_t)) {
+        headSerialError(0);
+        return true;
+    }
+    i = read8();
+    if (i >= MAX_SUPPORTED_SERVOS) {
+        headSerialError(0);
+    } else {
+        masterConfig.servoConf[i].min = read16();
+        masterConfig.servoConf[i].max = read16();
+        masterConfig.servoConf[i].middle = read16();
+        masterConfig.servoConf[i].rate = read8();
+        masterConfig.servoConf[i].angleAtMin = read8();
+        masterConfig.servoConf[i].angleAtMax = read8();
+        masterConfig.servoConf[i].forwardFromChannel = read8();
+        masterConfig.servoConf[i].reversedSources = read32();
+    }
+#endif
+
+    return true;
+}
+
+static bool mspInSetServoMixRule(void)
+{
+#ifdef USE_SERVOS
+    uint32_t i;
+
+    i = read8();
+    if (i >= MAX_SERVO_RULES) {
+        headSerialError(0);
+    } else {
+        masterConfig.customServoMixer[i].targetChannel = read8();
+        masterConfig.customServoMixer[i].inputSource = read8();
+        masterConfig.customServoMixer[i].rate = read8();
+        masterConfig.customServoMixer[i].speed = read8();
+        masterConfig.customServoMixer[i].min = read8();
+        masterConfig.customServoMixer[i].max = read8();
+        masterConfig.customServoMixer[i].box = read8();
+        loadCustomServoMixer();
+    }
+#endif
+
+    return true;
+}
+
+static bool mspInSet3d(void)
+{
+    masterConfig.flight3DConfig.deadband3d_low = read16();
+    masterConfig.flight3DConfig.deadband3d_high = read16();
+    masterConfig.flight3DConfig.neutral3d = read16();
+    masterConfig.flight3DConfig.deadband3d_throttle = read16();
+
+    return true;
+}
+
+static bool mspInSetRcDeadband(void)
+{
+    masterConfig.rcControlsConfig.deadband = read8();
+    masterConfig.rcControlsConfig.yaw_deadband = read8();
+    masterConfig.rcControlsConfig.alt_hold_deadband = read8();
+
+    return true;
+}
+
+static bool mspInSetResetCurrPid(void)
+{
+    resetProfile(currentProfile);
+
+    return true;
+}
+
+static bool mspInSetSensorAlignment(void)
+{
+    masterConfig.sensorAlignmentConfig.gyro_align = read8();
+    masterConfig.sensorAlignmentConfig.acc_align = read8();
+    masterConfig.sensorAlignmentConfig.mag_align = read8();
+
+    return true;
+}
+
+static bool mspInResetConf(void)
+{
+    if (!ARMING_FLAG(ARMED)) {
+        resetEEPROM();
+        readEEPROM();
+    }
+
+    return true;
+}
+
+static bool mspInAccCalibration(void)
+{
+    if (!ARMING_FLAG(ARMED))
+        accSetCalibrationCycles(CALIBRATING_ACC_CYCLES);
+
+    return true;
+}
+
+static bool mspInMagCalibration(void)
+{
+    if (!ARMING_FLAG(ARMED))
+        ENABLE_STATE(CALIBRATE_MAG);
+
+    return true;
+}
+
+static bool mspInEepromWrite(void)
+{
+    if (ARMING_FLAG(ARMED)) {
+        headSerialError(0);
+        return true;
+    }
+    writeEEPROM();
+    readEEPROM();
+
+    return true;
+}
+
+#ifdef BLACKBOX
+static bool mspInSetBlackboxConfig(void)
+{
+    // Don't allow config to be updated while Blackbox is logging
+    if (blackboxMayEditConfig()) {
+        masterConfig.blackbox_device = read8();
+        masterConfig.blackbox_rate_num = read8();
+        masterConfig.blackbox_rate_denom = read8();
+    }
+
+    return true;
+}
+
+#endif
+#ifdef TRANSPONDER
+static bool mspInSetTransponderConfig(void)
+{
+    uint32_t i;
+
+    if (currentPort->dataSize != sizeof(masterConfig.transponderData)) {
+        headSerialError(0);
+        return true;
+    }
+
+    for (i = 0; i < sizeof(masterConfig.transponderData); i++) {
+        masterConfig.transponderData[i] = read8();
+    }
+
+    transponderUpdateData(masterConfig.transponderData);
+
+    return true;
+}
+
+#endif
 #ifdef OSD
-    uint8_t addr, font_data[64];
+static bool mspInSetOsdConfig(void)
+{
+    uint8_t addr;
+
+    addr = read8();
+    // set all the other settings
+    if ((int8_t)addr == -1) {
+        masterConfig.osdProfile.video_system = read8();
+    }
+    // set a position setting
+    else {
+        masterConfig.osdProfile.item_pos[addr] = read16();
+    }
+
+    return true;
+}
+
+static bool mspInOsdCharWrite(void)
+{
+    uint32_t i;
+    uint8_t addr;
+    uint8_t font_data[64];
+
+    addr = read8();
+    for (i = 0; i < 54; i++) {
+        font_data[i] = read8();
+    }
+    max7456_write_nvm(addr, font_data);
+
+    return true;
+}
+
+#endif
+#ifdef USE_RTC6705
+static bool mspInSetVtxConfig(void)
+{
+    uint16_t tmp;
+
+    tmp = read16();
+    if  (tmp < 40)
+        masterConfig.vtx_channel = tmp;
+    if (current_vtx_channel != masterConfig.vtx_channel) {
+        current_vtx_channel = masterConfig.vtx_channel;
+        rtc6705_soft_spi_set_channel(vtx_freq[current_vtx_channel]);
+    }
+
+    return true;
+}
+
+#endif
+#ifdef USE_FLASHFS
+static bool mspInDataflashErase(void)
+{
+    flashfsEraseCompletely();
+
+    return true;
+}
+
+#endif
+#ifdef GPS
+static bool mspInSetRawGps(void)
+{
+    if (read8()) {
+        ENABLE_STATE(GPS_FIX);
+    } else {
+        DISABLE_STATE(GPS_FIX);
+    }
+    GPS_numSat = read8();
+    GPS_coord[LAT] = read32();
+    GPS_coord[LON] = read32();
+    GPS_altitude = read16();
+    GPS_speed = read16();
+    GPS_update |= 2;        // New data signalisation to GPS functions // FIXME Magic Numbers
+
+    return true;
+}
+
+static bool mspInSetWp(void)
+{
+    uint8_t wp_no;
+    int32_t lat = 0;
+    int32_t lon = 0;
+    int32_t alt = 0;
+
+    wp_no = read8();    //get the wp number
+    lat = read32();
+    lon = read32();
+    alt = read32();     // to set altitude (cm)
+    read16();           // future: to set heading (deg)
+    read16();           // future: to set time to stay (ms)
+    read8();            // future: to set nav flag
+    if (wp_no == 0) {
+        GPS_home[LAT] = lat;
+        GPS_home[LON] = lon;
+        DISABLE_FLIGHT_MODE(GPS_HOME_MODE);        // with this flag, GPS_set_next_wp will be called in the next loop -- OK with SERIAL GPS / OK with I2C GPS
+        ENABLE_STATE(GPS_FIX_HOME);
+        if (alt != 0)
+            AltHold = alt;          // temporary implementation to test feature with apps
+    } else if (wp_no == 16) {       // OK with SERIAL GPS  --  NOK for I2C GPS / needs more code dev in order to inject GPS coord inside I2C GPS
+        GPS_hold[LAT] = lat;
+        GPS_hold[LON] = lon;
+        if (alt != 0)
+            AltHold = alt;          // temporary implementation to test feature with apps
+        nav_mode = NAV_MODE_WP;
+        GPS_set_next_wp(&GPS_hold[LAT], &GPS_hold[LON]);
+    }
+
+    return true;
+}
+
+#endif
+static bool mspInSetFeature(void)
+{
+    featureClearAll();
+    featureSet(read32()); // features bitmap
+
+    return true;
+}
+
+static bool mspInSetBoardAlignment(void)
+{
+    masterConfig.boardAlignment.rollDegrees = read16();
+    masterConfig.boardAlignment.pitchDegrees = read16();
+    masterConfig.boardAlignment.yawDegrees = read16();
+
+    return true;
+}
+
+static bool mspInSetVoltageMeterConfig(void)
+{
+    masterConfig.batteryConfig.vbatscale = read8();           // actual vbatscale as intended
+    masterConfig.batteryConfig.vbatmincellvoltage = read8();  // vbatlevel_warn1 in MWC2.3 GUI
+    masterConfig.batteryConfig.vbatmaxcellvoltage = read8();  // vbatlevel_warn2 in MWC2.3 GUI
+    masterConfig.batteryConfig.vbatwarningcellvoltage = read8();  // vbatlevel when buzzer starts to alert
+
+    return true;
+}
+
+static bool mspInSetCurrentMeterConfig(void)
+{
+    masterConfig.batteryConfig.currentMeterScale = read16();
+    masterConfig.batteryConfig.currentMeterOffset = read16();
+    masterConfig.batteryConfig.currentMeterType = read8();
+    masterConfig.batteryConfig.batteryCapacity = read16();
+
+    return true;
+}
+
+#ifndef USE_QUAD_MIXER_ONLY
+static bool mspInSetMixer(void)
+{
+    masterConfig.mixerMode = read8();
+
+    return true;
+}
+
+#endif
+static bool mspInSetRxConfig(void)
+{
+    masterConfig.rxConfig.serialrx_provider = read8();
+    masterConfig.rxConfig.maxcheck = read16();
+    masterConfig.rxConfig.midrc = read16();
+    masterConfig.rxConfig.mincheck = read16();
+    masterConfig.rxConfig.spektrum_sat_bind = read8();
+    if (currentPort->dataSize > 8) {
+        masterConfig.rxConfig.rx_min_usec = read16();
+        masterConfig.rxConfig.rx_max_usec = read16();
+    }
+    if (currentPort->dataSize > 12) {
+        masterConfig.rxConfig.rcInterpolation = read8();
+        masterConfig.rxConfig.rcInterpolationInterval = read8();
+        masterConfig.rxConfig.airModeActivateThreshold = read16();
+    }
+
+    return true;
+}
+
+static bool mspInSetFailsafeConfig(void)
+{
+    masterConfig.failsafeConfig.failsafe_delay = read8();
+    masterConfig.failsafeConfig.failsafe_off_delay = read8();
+    masterConfig.failsafeConfig.failsafe_throttle = read16();
+    masterConfig.failsafeConfig.failsafe_kill_switch = read8();
+    masterConfig.failsafeConfig.failsafe_throttle_low_delay = read16();
+    masterConfig.failsafeConfig.failsafe_procedure = read8();
+
+    return true;
+}
+
+static bool mspInSetRxfailConfig(void)
+{
+    uint32_t i;
+
+    i = read8();
+    if (i < MAX_SUPPORTED_RC_CHANNEL_COUNT) {
+        masterConfig.rxConfig.failsafe_channel_configurations[i].mode = read8();
+        masterConfig.rxConfig.failsafe_channel_configurations[i].step = CHANNEL_VALUE_TO_RXFAIL_STEP(read16());
+    } else {
+        headSerialError(0);
+    }
+
+    return true;
+}
+
+static bool mspInSetRssiConfig(void)
+{
+    masterConfig.rxConfig.rssi_channel = read8();
+
+    return true;
+}
+
+static bool mspInSetRxMap(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < MAX_MAPPABLE_RX_INPUTS; i++) {
+        masterConfig.rxConfig.rcmap[i] = read8();
+    }
+
+    return true;
+}
+
+static bool mspInSetBfConfig(void)
+{
+#ifdef USE_QUAD_MIXER_ONLY
+    read8(); // mixerMode ignored
+#else
+    masterConfig.mixerMode = read8(); // mixerMode
 #endif
-    switch (currentPort->cmdMSP) {
-    case MSP_SELECT_SETTING:
-        value = read8();
-        if ((value & RATEPROFILE_MASK) == 0) {
-            if (!ARMING_FLAG(ARMED)) {
-                if (value >= MAX_PROFILE_COUNT) {
-                    value = 0;
-                }
-                changeProfile(value);
-            }
-        } else {
-            value = value & ~RATEPROFILE_MASK;
 
-            if (value >= MAX_RATEPROFILES) {
-                value = 0;
-            }
-            changeControlRateProfile(value);
-        }
+    featureClearAll();
+    featureSet(read32()); // features bitmap
 
-        break;
-    case MSP_SET_HEAD:
-        magHold = read16();
-        break;
-    case MSP_SET_RAW_RC:
-#ifndef SKIP_RX_MSP
-        {
-            uint8_t channelCount = currentPort->dataSize / sizeof(uint16_t);
-            if (channelCount > MAX_SUPPORTED_RC_CHANNEL_COUNT) {
-                headSerialError(0);
-            } else {
-                uint16_t frame[MAX_SUPPORTED_RC_CHANNEL_COUNT];
-
-                for (i = 0; i < channelCount; i++) {
-                    frame[i] = read16();
-                }
+    masterConfig.rxConfig.serialrx_provider = read8(); // serialrx_type
 
-                rxMspFrameReceive(frame, channelCount);
-            }
-        }
-#endif
-        break;
-    case MSP_SET_ACC_TRIM:
-        masterConfig.accelerometerTrims.values.pitch = read16();
-        masterConfig.accelerometerTrims.values.roll  = read16();
-        break;
-    case MSP_SET_ARMING_CONFIG:
-        masterConfig.auto_disarm_delay = read8();
-        masterConfig.disarm_kill_switch = read8();
-        break;
-    case MSP_SET_LOOP_TIME:
-        read16();
-        break;
-    case MSP_SET_PID_CONTROLLER:
-        currentProfile->pidProfile.pidController = constrain(read8(), 0, 1);
-        pidSetController(currentProfile->pidProfile.pidController);
-        break;
-    case MSP_SET_PID:
-        for (i = 0; i < PID_ITEM_COUNT; i++) {
-            currentProfile->pidProfile.P8[i] = read8();
-            currentProfile->pidProfile.I8[i] = read8();
-            currentProfile->pidProfile.D8[i] = read8();
-        }
-        break;
-    case MSP_SET_MODE_RANGE:
-        i = read8();
-        if (i < MAX_MODE_ACTIVATION_CONDITION_COUNT) {
-            modeActivationCondition_t *mac = &masterConfig.modeActivationConditions[i];
-            i = read8();
-            const box_t *box = findBoxByPermenantId(i);
-            if (box) {
-                mac->modeId = box->boxId;
-                mac->auxChannelIndex = read8();
-                mac->range.startStep = read8();
-                mac->range.endStep = read8();
-
-                useRcControlsConfig(masterConfig.modeActivationConditions, &masterConfig.escAndServoConfig, &currentProfile->pidProfile);
-            } else {
-                headSerialError(0);
-            }
-        } else {
-            headSerialError(0);
-        }
-        break;
-    case MSP_SET_ADJUSTMENT_RANGE:
-        i = read8();
-        if (i < MAX_ADJUSTMENT_RANGE_COUNT) {
-            adjustmentRange_t *adjRange = &masterConfig.adjustmentRanges[i];
-            i = read8();
-            if (i < MAX_SIMULTANEOUS_ADJUSTMENT_COUNT) {
-                adjRange->adjustmentIndex = i;
-                adjRange->auxChannelIndex = read8();
-                adjRange->range.startStep = read8();
-                adjRange->range.endStep = read8();
-                adjRange->adjustmentFunction = read8();
-                adjRange->auxSwitchChannelIndex = read8();
-            } else {
-                headSerialError(0);
-            }
-        } else {
-            headSerialError(0);
-        }
-        break;
-
-    case MSP_SET_RC_TUNING:
-        if (currentPort->dataSize >= 10) {
-            currentControlRateProfile->rcRate8 = read8();
-            currentControlRateProfile->rcExpo8 = read8();
-            for (i = 0; i < 3; i++) {
-                value = read8();
-                currentControlRateProfile->rates[i] = MIN(value, i == FD_YAW ? CONTROL_RATE_CONFIG_YAW_RATE_MAX : CONTROL_RATE_CONFIG_ROLL_PITCH_RATE_MAX);
-            }
-            value = read8();
-            currentControlRateProfile->dynThrPID = MIN(value, CONTROL_RATE_CONFIG_TPA_MAX);
-            currentControlRateProfile->thrMid8 = read8();
-            currentControlRateProfile->thrExpo8 = read8();
-            currentControlRateProfile->tpa_breakpoint = read16();
-            if (currentPort->dataSize >= 11) {
-                currentControlRateProfile->rcYawExpo8 = read8();
-            }
-            if (currentPort->dataSize >= 12) {
-                currentControlRateProfile->rcYawRate8 = read8();
-            }
-        } else {
-            headSerialError(0);
-        }
-        break;
-    case MSP_SET_MISC:
-        tmp = read16();
-        if (tmp < 1600 && tmp > 1400)
-            masterConfig.rxConfig.midrc = tmp;
+    masterConfig.boardAlignment.rollDegrees = read16(); // board_align_roll
+    masterConfig.boardAlignment.pitchDegrees = read16(); // board_align_pitch
+    masterConfig.boardAlignment.yawDegrees = read16(); // board_align_yaw
 
-        masterConfig.escAndServoConfig.minthrottle = read16();
-        masterConfig.escAndServoConfig.maxthrottle = read16();
-        masterConfig.escAndServoConfig.mincommand = read16();
+    masterConfig.batteryConfig.currentMeterScale = read16();
+    masterConfig.batteryConfig.currentMeterOffset = read16();
 
-        masterConfig.failsafeConfig.failsafe_throttle = read16();
+    return true;
+}
 
-#ifdef GPS
-        masterConfig.gpsConfig.provider = read8(); // gps_type
-        read8(); // gps_baudrate
-        masterConfig.gpsConfig.sbasMode = read8(); // gps_ubx_sbas
-#else
-        read8(); // gps_type
-        read8(); // gps_baudrate
-        read8(); // gps_ubx_sbas
-#endif
-        masterConfig.batteryConfig.multiwiiCurrentMeterOutput = read8();
-        masterConfig.rxConfig.rssi_channel = read8();
-        read8();
-
-        masterConfig.mag_declination = read16() * 10;
-
-        masterConfig.batteryConfig.vbatscale = read8();           // actual vbatscale as intended
-        masterConfig.batteryConfig.vbatmincellvoltage = read8();  // vbatlevel_warn1 in MWC2.3 GUI
-        masterConfig.batteryConfig.vbatmaxcellvoltage = read8();  // vbatlevel_warn2 in MWC2.3 GUI
-        masterConfig.batteryConfig.vbatwarningcellvoltage = read8();  // vbatlevel when buzzer starts to alert
-        break;
-    case MSP_SET_MOTOR:
-        for (i = 0; i < 8; i++) // FIXME should this use MAX_MOTORS or MAX_SUPPORTED_MOTORS instead of 8
-            motor_disarmed[i] = read16();
-        break;
-    case MSP_SET_SERVO_CONFIGURATION:
-#ifdef USE_SERVOS
-        if (currentPort->dataSize != 1 + sizeof(servoParam_t)) {
-            headSerialError(0);
-            break;
-        }
-        i = read8();
-        if (i >= MAX_SUPPORTED_SERVOS) {
-            headSerialError(0);
-        } else {
-            masterConfig.servoConf[i].min = read16();
-            masterConfig.servoConf[i].max = read16();
-            masterConfig.servoConf[i].middle = read16();
-            masterConfig.servoConf[i].rate = read8();
-            masterConfig.servoConf[i].angleAtMin = read8();
-            masterConfig.servoConf[i].angleAtMax = read8();
-            masterConfig.servoConf[i].forwardFromChannel = read8();
-            masterConfig.servoConf[i].reversedSources = read32();
-        }
-#endif
-        break;
+static bool mspInSetCfSerialConfig(void)
+{
+    uint8_t portConfigSize = sizeof(uint8_t) + sizeof(uint16_t) + (sizeof(uint8_t) * 4);
 
-    case MSP_SET_SERVO_MIX_RULE:
-#ifdef USE_SERVOS
-        i = read8();
-        if (i >= MAX_SERVO_RULES) {
-            headSerialError(0);
-        } else {
-            masterConfig.customServoMixer[i].targetChannel = read8();
-            masterConfig.customServoMixer[i].inputSource = read8();
-            masterConfig.customServoMixer[i].rate = read8();
-            masterConfig.customServoMixer[i].speed = read8();
-            masterConfig.customServoMixer[i].min = read8();
-            masterConfig.customServoMixer[i].max = read8();
-            masterConfig.customServoMixer[i].box = read8();
-            loadCustomServoMixer();
-        }
-#endif
-        break;
-
-    case MSP_SET_3D:
-        masterConfig.flight3DConfig.deadband3d_low = read16();
-        masterConfig.flight3DConfig.deadband3d_high = read16();
-        masterConfig.flight3DConfig.neutral3d = read16();
-        masterConfig.flight3DConfig.deadband3d_throttle = read16();
-        break;
-
-    case MSP_SET_RC_DEADBAND:
-        masterConfig.rcControlsConfig.deadband = read8();
-        masterConfig.rcControlsConfig.yaw_deadband = read8();
-        masterConfig.rcControlsConfig.alt_hold_deadband = read8();
-        break;
-
-    case MSP_SET_RESET_CURR_PID:
-        resetProfile(currentProfile);
-        break;
-
-    case MSP_SET_SENSOR_ALIGNMENT:
-        masterConfig.sensorAlignmentConfig.gyro_align = read8();
-        masterConfig.sensorAlignmentConfig.acc_align = read8();
-        masterConfig.sensorAlignmentConfig.mag_align = read8();
-        break;
-
-    case MSP_RESET_CONF:
-        if (!ARMING_FLAG(ARMED)) {
-            resetEEPROM();
-            readEEPROM();
-        }
-        break;
-    case MSP_ACC_CALIBRATION:
-        if (!ARMING_FLAG(ARMED))
-            accSetCalibrationCycles(CALIBRATING_ACC_CYCLES);
-        break;
-    case MSP_MAG_CALIBRATION:
-        if (!ARMING_FLAG(ARMED))
-            ENABLE_STATE(CALIBRATE_MAG);
-        break;
-    case MSP_EEPROM_WRITE:
-        if (ARMING_FLAG(ARMED)) {
-            headSerialError(0);
-            return true;
-        }
-        writeEEPROM();
-        readEEPROM();
-        break;
+    if (currentPort->dataSize % portConfigSize != 0) {
+        headSerialError(0);
+        return true;
+    }
 
-#ifdef BLACKBOX
-    case MSP_SET_BLACKBOX_CONFIG:
-        // Don't allow config to be updated while Blackbox is logging
-        if (blackboxMayEditConfig()) {
-            masterConfig.blackbox_device = read8();
-            masterConfig.blackbox_rate_num = read8();
-            masterConfig.blackbox_rate_denom = read8();
-        }
-        break;
-#endif
+    uint8_t remainingPortsInPacket = currentPort->dataSize / portConfigSize;
 
-#ifdef TRANSPONDER
-    case MSP_SET_TRANSPONDER_CONFIG:
-        if (currentPort->dataSize != sizeof(masterConfig.transponderData)) {
+    while (remainingPortsInPacket--) {
+        uint8_t identifier = read8();
+
+        serialPortConfig_t *portConfig = serialFindPortConfiguration(identifier);
+        if (!portConfig) {
             headSerialError(0);
             break;
         }
 
-        for (i = 0; i < sizeof(masterConfig.transponderData); i++) {
-            masterConfig.transponderData[i] = read8();
-        }
+        portConfig->identifier = identifier;
+        portConfig->functionMask = read16();
+        portConfig->msp_baudrateIndex = read8();
+        portConfig->gps_baudrateIndex = read8();
+        portConfig->telemetry_baudrateIndex = read8();
+        portConfig->blackbox_baudrateIndex = read8();
+    }
 
-        transponderUpdateData(masterConfig.transponderData);
-        break;
-#endif
-#ifdef OSD
-    case MSP_SET_OSD_CONFIG:
-        addr = read8();
-        // set all the other settings
-        if ((int8_t)addr == -1) {
-            masterConfig.osdProfile.video_system = read8();
-        }
-        // set a position setting
-        else {
-            masterConfig.osdProfile.item_pos[addr] = read16();
-        }
-        break;
-    case MSP_OSD_CHAR_WRITE:
-        addr = read8();
-        for (i = 0; i < 54; i++) {
-            font_data[i] = read8();
-        }
-        max7456_write_nvm(addr, font_data);
-        break;
-#endif
+    return true;
+}
 
-#ifdef USE_RTC6705
-    case MSP_SET_VTX_CONFIG:
-        tmp = read16();
-        if  (tmp < 40)
-            masterConfig.vtx_channel = tmp;
-        if (current_vtx_channel != masterConfig.vtx_channel) {
-            current_vtx_channel = masterConfig.vtx_channel;
-            rtc6705_soft_spi_set_channel(vtx_freq[current_vtx_channel]);
-        }
-        break;
-#endif
+#ifdef LED_STRIP
+static bool mspInSetLedColors(void)
+{
+    uint32_t i;
 
-#ifdef USE_FLASHFS
-    case MSP_DATAFLASH_ERASE:
-        flashfsEraseCompletely();
-        break;
-#endif
+    for (i = 0; i < LED_CONFIGURABLE_COLOR_COUNT; i++) {
+        hsvColor_t *color = &masterConfig.colors[i];
+        color->h = read16();
+        color->s = read8();
+        color->v = read8();
+    }
 
-#ifdef GPS
-    case MSP_SET_RAW_GPS:
-        if (read8()) {
-            ENABLE_STATE(GPS_FIX);
-        } else {
-            DISABLE_STATE(GPS_FIX);
-        }
-        GPS_numSat = read8();
-        GPS_coord[LAT] = read32();
-        GPS_coord[LON] = read32();
-        GPS_altitude = read16();
-        GPS_speed = read16();
-        GPS_update |= 2;        // New data signalisation to GPS functions // FIXME Magic Numbers
-        break;
-    case MSP_SET_WP:
-        wp_no = read8();    //get the wp number
-        lat = read32();
-        lon = read32();
-        alt = read32();     // to set altitude (cm)
-        read16();           // future: to set heading (deg)
-        read16();           // future: to set time to stay (ms)
-        read8();            // future: to set nav flag
-        if (wp_no == 0) {
-            GPS_home[LAT] = lat;
-            GPS_home[LON] = lon;
-            DISABLE_FLIGHT_MODE(GPS_HOME_MODE);        // with this flag, GPS_set_next_wp will be called in the next loop -- OK with SERIAL GPS / OK with I2C GPS
-            ENABLE_STATE(GPS_FIX_HOME);
-            if (alt != 0)
-                AltHold = alt;          // temporary implementation to test feature with apps
-        } else if (wp_no == 16) {       // OK with SERIAL GPS  --  NOK for I2C GPS / needs more code dev in order to inject GPS coord inside I2C GPS
-            GPS_hold[LAT] = lat;
-            GPS_hold[LON] = lon;
-            if (alt != 0)
-                AltHold = alt;          // temporary implementation to test feature with apps
-            nav_mode = NAV_MODE_WP;
-            GPS_set_next_wp(&GPS_hold[LAT], &GPS_hold[LON]);
-        }
-        break;
-#endif
-    case MSP_SET_FEATURE:
-        featureClearAll();
-        featureSet(read32()); // features bitmap
-        break;
-
-    case MSP_SET_BOARD_ALIGNMENT:
-        masterConfig.boardAlignment.rollDegrees = read16();
-        masterConfig.boardAlignment.pitchDegrees = read16();
-        masterConfig.boardAlignment.yawDegrees = read16();
-        break;
-
-    case MSP_SET_VOLTAGE_METER_CONFIG:
-        masterConfig.batteryConfig.vbatscale = read8();           // actual vbatscale as intended
-        masterConfig.batteryConfig.vbatmincellvoltage = read8();  // vbatlevel_warn1 in MWC2.3 GUI
-        masterConfig.batteryConfig.vbatmaxcellvoltage = read8();  // vbatlevel_warn2 in MWC2.3 GUI
-        masterConfig.batteryConfig.vbatwarningcellvoltage = read8();  // vbatlevel when buzzer starts to alert
-        break;
-
-    case MSP_SET_CURRENT_METER_CONFIG:
-        masterConfig.batteryConfig.currentMeterScale = read16();
-        masterConfig.batteryConfig.currentMeterOffset = read16();
-        masterConfig.batteryConfig.currentMeterType = read8();
-        masterConfig.batteryConfig.batteryCapacity = read16();
-        break;
+    return true;
+}
 
-#ifndef USE_QUAD_MIXER_ONLY
-    case MSP_SET_MIXER:
-        masterConfig.mixerMode = read8();
-        break;
-#endif
+static bool mspInSetLedStripConfig(void)
+{
+    uint32_t i;
 
-    case MSP_SET_RX_CONFIG:
-        masterConfig.rxConfig.serialrx_provider = read8();
-        masterConfig.rxConfig.maxcheck = read16();
-        masterConfig.rxConfig.midrc = read16();
-        masterConfig.rxConfig.mincheck = read16();
-        masterConfig.rxConfig.spektrum_sat_bind = read8();
-        if (currentPort->dataSize > 8) {
-            masterConfig.rxConfig.rx_min_usec = read16();
-            masterConfig.rxConfig.rx_max_usec = read16();
-        }
-        if (currentPort->dataSize > 12) {
-            masterConfig.rxConfig.rcInterpolation = read8();
-            masterConfig.rxConfig.rcInterpolationInterval = read8();
-            masterConfig.rxConfig.airModeActivateThreshold = read16();
-        }
-        break;
-
-    case MSP_SET_FAILSAFE_CONFIG:
-        masterConfig.failsafeConfig.failsafe_delay = read8();
-        masterConfig.failsafeConfig.failsafe_off_delay = read8();
-        masterConfig.failsafeConfig.failsafe_throttle = read16();
-        masterConfig.failsafeConfig.failsafe_kill_switch = read8();
-        masterConfig.failsafeConfig.failsafe_throttle_low_delay = read16();
-        masterConfig.failsafeConfig.failsafe_procedure = read8();
-        break;
-
-    case MSP_SET_RXFAIL_CONFIG:
-        i = read8();
-        if (i < MAX_SUPPORTED_RC_CHANNEL_COUNT) {
-            masterConfig.rxConfig.failsafe_channel_configurations[i].mode = read8();
-            masterConfig.rxConfig.failsafe_channel_configurations[i].step = CHANNEL_VALUE_TO_RXFAIL_STEP(read16());
-        } else {
-            headSerialError(0);
-        }
-        break;
+    // Start index followed by the config of one or more consecutive LEDs, MSPv2 fits the whole strip
+    i = read8();
+    uint8_t ledCount = (currentPort->dataSize - 1) / 4;
+
+    if (ledCount == 0 || i + ledCount > LED_MAX_STRIP_LENGTH || currentPort->dataSize != 1 + ledCount * 4) {
+        headSerialError(0);
+        return true;
+    }
+    while (ledCount--) {
+        masterConfig.ledConfigs[i++] = read32();
+    }
+    reevaluateLedConfig();
 
-    case MSP_SET_RSSI_CONFIG:
-        masterConfig.rxConfig.rssi_channel = read8();
-        break;
+    return true;
+}
 
-    case MSP_SET_RX_MAP:
-        for (i = 0; i < MAX_MAPPABLE_RX_INPUTS; i++) {
-            masterConfig.rxConfig.rcmap[i] = read8();
-        }
-        break;
+static bool mspInSetLedStripModecolor(void)
+{
+    ledModeIndex_e modeIdx = read8();
+    int funIdx = read8();
+    int color = read8();
 
-    case MSP_SET_BF_CONFIG:
+    if (!setModeColor(modeIdx, funIdx, color))
+        return false;
+
+    return true;
+}
 
-#ifdef USE_QUAD_MIXER_ONLY
-        read8(); // mixerMode ignored
-#else
-        masterConfig.mixerMode = read8(); // mixerMode
 #endif
+static bool mspInReboot(void)
+{
+    isRebootScheduled = true;
 
-        featureClearAll();
-        featureSet(read32()); // features bitmap
+    return true;
+}
 
-        masterConfig.rxConfig.serialrx_provider = read8(); // serialrx_type
+#ifdef USE_SERIAL_4WAY_BLHELI_INTERFACE
+static bool mspInSet4wayIf(void)
+{
+    // get channel number
+    // switch all motor lines HI
+    // reply the count of ESC found
+    headSerialReply(1);
+    serialize8(esc4wayInit());
+    // because we do not come back after calling Process4WayInterface
+    // proceed with a success reply first
+    tailSerialReply();
+    // wait for all data to send
+    waitForSerialPortToFinishTransmitting(currentPort->port);
+    // rem: App: Wait at least appx. 500 ms for BLHeli to jump into
+    // bootloader mode before try to connect any ESC
+    // Start to activate here
+    esc4wayProcess(currentPort->port);
+    // former used MSP uart is still active
+    // proceed as usual with MSP commands
 
-        masterConfig.boardAlignment.rollDegrees = read16(); // board_align_roll
-        masterConfig.boardAlignment.pitchDegrees = read16(); // board_align_pitch
-        masterConfig.boardAlignment.yawDegrees = read16(); // board_align_yaw
+    return true;
+}
 
-        masterConfig.batteryConfig.currentMeterScale = read16();
-        masterConfig.batteryConfig.currentMeterOffset = read16();
-        break;
+#endif
+static bool mspInSetAdvancedConfig(void)
+{
+    masterConfig.gyro_sync_denom = read8();
+    masterConfig.pid_process_denom = read8();
+    masterConfig.use_unsyncedPwm = read8();
+    masterConfig.motor_pwm_protocol = read8();
+    masterConfig.motor_pwm_rate = read16();
 
-    case MSP_SET_CF_SERIAL_CONFIG:
-        {
-            uint8_t portConfigSize = sizeof(uint8_t) + sizeof(uint16_t) + (sizeof(uint8_t) * 4);
+    return true;
+}
 
-            if (currentPort->dataSize % portConfigSize != 0) {
-                headSerialError(0);
-                break;
-            }
+static bool mspInSetFilterConfig(void)
+{
+    masterConfig.gyro_soft_lpf_hz = read8();
+    currentProfile->pidProfile.dterm_lpf_hz = read16();
+    currentProfile->pidProfile.yaw_lpf_hz = read16();
 
-            uint8_t remainingPortsInPacket = currentPort->dataSize / portConfigSize;
+    return true;
+}
 
-            while (remainingPortsInPacket--) {
-                uint8_t identifier = read8();
+static bool mspInSetPidAdvanced(void)
+{
+    currentProfile->pidProfile.rollPitchItermIgnoreRate = read16();
+    currentProfile->pidProfile.yawItermIgnoreRate = read16();
+    currentProfile->pidProfile.yaw_p_limit = read16();
+    currentProfile->pidProfile.deltaMethod = read8();
+    currentProfile->pidProfile.vbatPidCompensation = read8();
+    currentProfile->pidProfile.ptermSetpointWeight = read8();
+    currentProfile->pidProfile.dtermSetpointWeight = read8();
+    currentProfile->pidProfile.toleranceBand = read8();
+    currentProfile->pidProfile.toleranceBandReduction = read8();
+    currentProfile->pidProfile.itermThrottleGain = read8();
+    currentProfile->pidProfile.rateAccelLimit = read16();
+    currentProfile->pidProfile.yawRateAccelLimit = read16();
 
-                serialPortConfig_t *portConfig = serialFindPortConfiguration(identifier);
-                if (!portConfig) {
-                    headSerialError(0);
-                    break;
-                }
+    return true;
+}
 
-                portConfig->identifier = identifier;
-                portConfig->functionMask = read16();
-                portConfig->msp_baudrateIndex = read8();
-                portConfig->gps_baudrateIndex = read8();
-                portConfig->telemetry_baudrateIndex = read8();
-                portConfig->blackbox_baudrateIndex = read8();
-            }
-        }
-        break;
+static bool mspInSetSensorConfig(void)
+{
+    masterConfig.acc_hardware = read8();
+    masterConfig.baro_hardware = read8();
+    masterConfig.mag_hardware = read8();
 
-#ifdef LED_STRIP
-    case MSP_SET_LED_COLORS:
-        for (i = 0; i < LED_CONFIGURABLE_COLOR_COUNT; i++) {
-            hsvColor_t *color = &masterConfig.colors[i];
-            color->h = read16();
-            color->s = read8();
-            color->v = read8();
-        }
-        break;
+    return true;
+}
 
-    case MSP_SET_LED_STRIP_CONFIG:
-        {
-            i = read8();
-            if (i >= LED_MAX_STRIP_LENGTH || currentPort->dataSize != (1 + 4)) {
-                headSerialError(0);
-                break;
-            }
-            ledConfig_t *ledConfig = &masterConfig.ledConfigs[i];
-            *ledConfig = read32();
-            reevaluateLedConfig();
-        }
-        break;
+static bool mspInSetName(void)
+{
+    uint32_t i;
 
-    case MSP_SET_LED_STRIP_MODECOLOR:
-        {
-            ledModeIndex_e modeIdx = read8();
-            int funIdx = read8();
-            int color = read8();
+    memset(masterConfig.name, 0, ARRAYLEN(masterConfig.name));
+    for (i = 0; i < MIN(MAX_NAME_LENGTH, currentPort->dataSize); i++) {
+        masterConfig.name[i] = read8();
+    }
 
-            if (!setModeColor(modeIdx, funIdx, color))
-                return false;
+    return true;
+}
+
+/*
+ * Replace this port's subscriptions with the (command, period in ms) pairs in the payload, an empty payload cancels
+ * them all. The first replies are sent straight away.
+ */
+static bool mspInSetSubscriptions(void)
+{
+    mspPortSubscriptions_t *portSubscriptions = mspGetPortSubscriptions(currentPort);
+    mspSubscription_t subscriptions[MSP_MAX_SUBSCRIPTIONS];
+    const uint8_t count = currentPort->dataSize / 4;
+    const uint32_t now = millis();
+
+    if (currentPort->dataSize % 4 != 0 || count > MSP_MAX_SUBSCRIPTIONS) {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        subscriptions[i].cmdMSP = read16();
+        subscriptions[i].period = read16();
+        subscriptions[i].nextPushAt = now;
+
+        const mspOutCommand_t *command = findOutCommand(subscriptions[i].cmdMSP);
+
+        if (!command || (command->flags & MSP_FLAG_TAKES_PARAMETERS) || subscriptions[i].period < MSP_SUBSCRIPTION_MIN_PERIOD) {
+            return false;
         }
-        break;
-#endif
-    case MSP_REBOOT:
-        isRebootScheduled = true;
-        break;
+    }
+
+    memcpy(portSubscriptions->subscriptions, subscriptions, count * sizeof(mspSubscription_t));
+    portSubscriptions->count = count;
+    portSubscriptions->mspVersion = currentPort->mspVersion;
+
+    return true;
+}
 
+static const mspInCommand_t mspInCommands[] = {
+    { MSP_SELECT_SETTING, mspInSelectSetting },
+    { MSP_SET_HEAD, mspInSetHead },
+    { MSP_SET_RAW_RC, mspInSetRawRc },
+    { MSP_SET_ACC_TRIM, mspInSetAccTrim },
+    { MSP_SET_ARMING_CONFIG, mspInSetArmingConfig },
+    { MSP_SET_LOOP_TIME, mspInSetLoopTime },
+    { MSP_SET_PID_CONTROLLER, mspInSetPidController },
+    { MSP_SET_PID, mspInSetPid },
+    { MSP_SET_MODE_RANGE, mspInSetModeRange },
+    { MSP_SET_ADJUSTMENT_RANGE, mspInSetAdjustmentRange },
+    { MSP_SET_RC_TUNING, mspInSetRcTuning },
+    { MSP_SET_MISC, mspInSetMisc },
+    { MSP_SET_MOTOR, mspInSetMotor },
+    { MSP_SET_SERVO_CONFIGURATION, mspInSetServoConfiguration },
+    { MSP_SET_SERVO_MIX_RULE, mspInSetServoMixRule },
+    { MSP_SET_3D, mspInSet3d },
+    { MSP_SET_RC_DEADBAND, mspInSetRcDeadband },
+    { MSP_SET_RESET_CURR_PID, mspInSetResetCurrPid },
+    { MSP_SET_SENSOR_ALIGNMENT, mspInSetSensorAlignment },
+    { MSP_RESET_CONF, mspInResetConf },
+    { MSP_ACC_CALIBRATION, mspInAccCalibration },
+    { MSP_MAG_CALIBRATION, mspInMagCalibration },
+    { MSP_EEPROM_WRITE, mspInEepromWrite },
+#ifdef BLACKBOX
+    { MSP_SET_BLACKBOX_CONFIG, mspInSetBlackboxConfig },
+#endif
+#ifdef TRANSPONDER
+    { MSP_SET_TRANSPONDER_CONFIG, mspInSetTransponderConfig },
+#endif
+#ifdef OSD
+    { MSP_SET_OSD_CONFIG, mspInSetOsdConfig },
+    { MSP_OSD_CHAR_WRITE, mspInOsdCharWrite },
+#endif
+#ifdef USE_RTC6705
+    { MSP_SET_VTX_CONFIG, mspInSetVtxConfig },
+#endif
+#ifdef USE_FLASHFS
+    { MSP_DATAFLASH_ERASE, mspInDataflashErase },
+#endif
+#ifdef GPS
+    { MSP_SET_RAW_GPS, mspInSetRawGps },
+    { MSP_SET_WP, mspInSetWp },
+#endif
+    { MSP_SET_FEATURE, mspInSetFeature },
+    { MSP_SET_BOARD_ALIGNMENT, mspInSetBoardAlignment },
+    { MSP_SET_VOLTAGE_METER_CONFIG, mspInSetVoltageMeterConfig },
+    { MSP_SET_CURRENT_METER_CONFIG, mspInSetCurrentMeterConfig },
+#ifndef USE_QUAD_MIXER_ONLY
+    { MSP_SET_MIXER, mspInSetMixer },
+#endif
+    { MSP_SET_RX_CONFIG, mspInSetRxConfig },
+    { MSP_SET_FAILSAFE_CONFIG, mspInSetFailsafeConfig },
+    { MSP_SET_RXFAIL_CONFIG, mspInSetRxfailConfig },
+    { MSP_SET_RSSI_CONFIG, mspInSetRssiConfig },
+    { MSP_SET_RX_MAP, mspInSetRxMap },
+    { MSP_SET_BF_CONFIG, mspInSetBfConfig },
+    { MSP_SET_CF_SERIAL_CONFIG, mspInSetCfSerialConfig },
+#ifdef LED_STRIP
+    { MSP_SET_LED_COLORS, mspInSetLedColors },
+    { MSP_SET_LED_STRIP_CONFIG, mspInSetLedStripConfig },
+    { MSP_SET_LED_STRIP_MODECOLOR, mspInSetLedStripModecolor },
+#endif
+    { MSP_REBOOT, mspInReboot },
 #ifdef USE_SERIAL_4WAY_BLHELI_INTERFACE
-    case MSP_SET_4WAY_IF:
-        // get channel number
-        // switch all motor lines HI
-        // reply the count of ESC found
-        headSerialReply(1);
-        serialize8(esc4wayInit());
-        // because we do not come back after calling Process4WayInterface
-        // proceed with a success reply first
-        tailSerialReply();
-        // flush the transmit buffer
-        bufWriterFlush(writer);
-        // wait for all data to send
-        waitForSerialPortToFinishTransmitting(currentPort->port);
-        // rem: App: Wait at least appx. 500 ms for BLHeli to jump into
-        // bootloader mode before try to connect any ESC
-        // Start to activate here
-        esc4wayProcess(currentPort->port);
-        // former used MSP uart is still active
-        // proceed as usual with MSP commands
-        break;
+    { MSP_SET_4WAY_IF, mspInSet4wayIf },
 #endif
+    { MSP_SET_ADVANCED_CONFIG, mspInSetAdvancedConfig },
+    { MSP_SET_FILTER_CONFIG, mspInSetFilterConfig },
+    { MSP_SET_PID_ADVANCED, mspInSetPidAdvanced },
+    { MSP_SET_SENSOR_CONFIG, mspInSetSensorConfig },
+    { MSP_SET_NAME, mspInSetName },
+    { MSP_SET_SUBSCRIPTIONS, mspInSetSubscriptions },
+};
+
+static bool processInCommand(void)
+{
+    for (unsigned i = 0; i < ARRAYLEN(mspInCommands); i++) {
+        if (mspInCommands[i].cmdMSP == currentPort->cmdMSP) {
+            if (!mspInCommands[i].handler()) {
+                return false;
+            }
 
-    case MSP_SET_ADVANCED_CONFIG :
-        masterConfig.gyro_sync_denom = read8();
-        masterConfig.pid_process_denom = read8();
-        masterConfig.use_unsyncedPwm = read8();
-        masterConfig.motor_pwm_protocol = read8();
-        masterConfig.motor_pwm_rate = read16();
-        break;
-    case MSP_SET_FILTER_CONFIG :
-        masterConfig.gyro_soft_lpf_hz = read8();
-        currentProfile->pidProfile.dterm_lpf_hz = read16();
-        currentProfile->pidProfile.yaw_lpf_hz = read16();
-        break;
-    case MSP_SET_PID_ADVANCED:
-        currentProfile->pidProfile.rollPitchItermIgnoreRate = read16();
-        currentProfile->pidProfile.yawItermIgnoreRate = read16();
-        currentProfile->pidProfile.yaw_p_limit = read16();
-        currentProfile->pidProfile.deltaMethod = read8();
-        currentProfile->pidProfile.vbatPidCompensation = read8();
-        currentProfile->pidProfile.ptermSetpointWeight = read8();
-        currentProfile->pidProfile.dtermSetpointWeight = read8();
-        currentProfile->pidProfile.toleranceBand = read8();
-        currentProfile->pidProfile.toleranceBandReduction = read8();
-        currentProfile->pidProfile.itermThrottleGain = read8();
-        currentProfile->pidProfile.rateAccelLimit = read16();
-        currentProfile->pidProfile.yawRateAccelLimit = read16();
-        break;
-    case MSP_SET_SENSOR_CONFIG:
-        masterConfig.acc_hardware = read8();
-        masterConfig.baro_hardware = read8();
-        masterConfig.mag_hardware = read8();
-        break;
-       
-    case MSP_SET_NAME:
-        memset(masterConfig.name, 0, ARRAYLEN(masterConfig.name));
-        for (i = 0; i < MIN(MAX_NAME_LENGTH, currentPort->dataSize); i++) {
-            masterConfig.name[i] = read8();
+            // Acknowledge, unless the handler has already replied
+            headSerialReply(0);
+            return true;
         }
-        break;
-    default:
-        // we do not know how to handle the (valid) message, indicate error MSP $M!
-        return false;
     }
-    headSerialReply(0);
-    return true;
+
+    return false;
 }
 
 STATIC_UNIT_TESTED void mspProcessReceivedCommand() {
@@ -1892,57 +2885,28 @@ STATIC_UNIT_TESTED void mspProcessReceivedCommand() {
     currentPort->c_state = IDLE;
 }
 
-static bool mspProcessReceivedData(uint8_t c)
-{
-    if (currentPort->c_state == IDLE) {
-        if (c == '$') {
-            currentPort->c_state = HEADER_START;
-        } else {
-            return false;
-        }
-    } else if (currentPort->c_state == HEADER_START) {
-        currentPort->c_state = (c == 'M') ? HEADER_M : IDLE;
-    } else if (currentPort->c_state == HEADER_M) {
-        currentPort->c_state = (c == '<') ? HEADER_ARROW : IDLE;
-    } else if (currentPort->c_state == HEADER_ARROW) {
-        if (c > MSP_PORT_INBUF_SIZE) {
-            currentPort->c_state = IDLE;
-
-        } else {
-            currentPort->dataSize = c;
-            currentPort->offset = 0;
-            currentPort->checksum = 0;
-            currentPort->indRX = 0;
-            currentPort->checksum ^= c;
-            currentPort->c_state = HEADER_SIZE;
-        }
-    } else if (currentPort->c_state == HEADER_SIZE) {
-        currentPort->cmdMSP = c;
-        currentPort->checksum ^= c;
-        currentPort->c_state = HEADER_CMD;
-    } else if (currentPort->c_state == HEADER_CMD && currentPort->offset < currentPort->dataSize) {
-        currentPort->checksum ^= c;
-        currentPort->inBuf[currentPort->offset++] = c;
-    } else if (currentPort->c_state == HEADER_CMD && currentPort->offset >= currentPort->dataSize) {
-        if (currentPort->checksum == c) {
-            currentPort->c_state = COMMAND_RECEIVED;
-        } else {
-            currentPort->c_state = IDLE;
-        }
-    }
-    return true;
-}
-
 STATIC_UNIT_TESTED void setCurrentPort(mspPort_t *port)
 {
     currentPort = port;
     mspSerialPort = currentPort->port;
 }
 
+/*
+ * Don't start on another command unless its reply is likely to fit in the port's transmit buffer, since waiting for
+ * the buffer to drain would blow the time budget.
+ */
+#define MSP_TX_FREE_TO_CONTINUE 64
+
+/**
+ * Process commands received by the MSP ports. Each port gets to process at least one command per call, then further
+ * commands are processed while the scheduler's time budget for the task lasts.
+ */
 void mspProcess(void)
 {
     uint8_t portIndex;
     mspPort_t *candidatePort;
+    const uint32_t startTime = micros();
+    const uint32_t timeBudget = getTaskTimeBudget();
 
     for (portIndex = 0; portIndex < MAX_MSP_PORT_COUNT; portIndex++) {
         candidatePort = &mspPorts[portIndex];
@@ -1951,15 +2915,21 @@ void mspProcess(void)
         }
 
         setCurrentPort(candidatePort);
-        // Big enough to fit a MSP_STATUS in one write.
-        uint8_t buf[sizeof(bufWriter_t) + 20];
-        writer = bufWriterInit(buf, sizeof(buf),
-                               (bufWrite_t)serialWriteBufShim, currentPort->port);
+        mspReplyInit(&mspReply, mspReplyBuffer, sizeof(mspReplyBuffer), mspSerialWrite, currentPort->port);
+
+        mspRxChunk_t *rxChunk = &mspRxChunks[portIndex];
 
-        while (serialRxBytesWaiting(mspSerialPort)) {
+        while (true) {
+            if (rxChunk->position >= rxChunk->length) {
+                rxChunk->length = serialReadBuf(mspSerialPort, rxChunk->data, sizeof(rxChunk->data));
+                rxChunk->position = 0;
+                if (rxChunk->length == 0) {
+                    break;
+                }
+            }
 
-            uint8_t c = serialRead(mspSerialPort);
-            bool consumed = mspProcessReceivedData(c);
+            uint8_t c = rxChunk->data[rxChunk->position++];
+            bool consumed = mspFrameProcessReceivedData(currentPort, c);
 
             if (!consumed && !ARMING_FLAG(ARMED)) {
                 evaluateOtherData(mspSerialPort, c);
@@ -1967,12 +2937,13 @@ void mspProcess(void)
 
             if (currentPort->c_state == COMMAND_RECEIVED) {
                 mspProcessReceivedCommand();
-                break; // process one command at a time so as not to block.
+
+                if (isRebootScheduled || micros() - startTime >= timeBudget || serialTxBytesFree(mspSerialPort) < MSP_TX_FREE_TO_CONTINUE) {
+                    break; // leave the rest for next time so as not to block.
+                }
             }
         }
 
-        bufWriterFlush(writer);
-
         if (isRebootScheduled) {
             waitForSerialPortToFinishTransmitting(candidatePort->port);
             stopPwmAllMotors();
@@ -1984,3 +2955,84 @@ void mspProcess(void)
         }
     }
 }
+
+static void mspBufWriterShim(void *arg, const uint8_t *data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        bufWriterAppend((bufWriter_t *)arg, data[i]);
+    }
+}
+
+/**
+ * Send the replies to any subscribed commands that are due. The replies for each port are gathered into one write.
+ */
+void mspPushSubscriptions(void)
+{
+#ifdef USE_CLI
+    if (cliMode) {
+        return;
+    }
+#endif
+
+    const uint32_t now = millis();
+
+    for (int portIndex = 0; portIndex < MAX_MSP_PORT_COUNT; portIndex++) {
+        mspPort_t *candidatePort = &mspPorts[portIndex];
+        mspPortSubscriptions_t *portSubscriptions = &mspPortSubscriptions[portIndex];
+
+        if (!candidatePort->port || portSubscriptions->count == 0) {
+            continue;
+        }
+
+        setCurrentPort(candidatePort);
+
+        static uint8_t burstBuffer[sizeof(bufWriter_t) + 255];
+        bufWriter_t *burst = bufWriterInit(burstBuffer, sizeof(burstBuffer), (bufWrite_t)serialWriteBufShim, currentPort->port);
+
+        mspReplyInit(&mspReply, mspReplyBuffer, sizeof(mspReplyBuffer), mspBufWriterShim, burst);
+
+        // The port may be part way through receiving a command, so put back the state the handlers use afterwards
+        const mspVersion_e savedMspVersion = currentPort->mspVersion;
+        const uint16_t savedCmdMSP = currentPort->cmdMSP;
+        const uint16_t savedDataSize = currentPort->dataSize;
+        const uint16_t savedIndRX = currentPort->indRX;
+
+        currentPort->mspVersion = portSubscriptions->mspVersion;
+        currentPort->dataSize = 0;
+        currentPort->indRX = 0;
+
+        const uint8_t txFree = serialTxBytesFree(currentPort->port);
+        uint16_t burstSize = 0;
+
+        for (int i = 0; i < portSubscriptions->count; i++) {
+            mspSubscription_t *subscription = &portSubscriptions->subscriptions[i];
+
+            if (cmp32(now, subscription->nextPushAt) < 0) {
+                continue;
+            }
+
+            // Leave what doesn't fit in the TX buffer until it has drained, rather than waiting for it
+            if (burstSize + MSP_TX_FREE_TO_CONTINUE > txFree) {
+                break;
+            }
+
+            currentPort->cmdMSP = subscription->cmdMSP;
+            processOutCommand(subscription->cmdMSP);
+            burstSize += mspReply.length + 1; // At least the size of the frame
+            tailSerialReply();
+
+            subscription->nextPushAt += subscription->period;
+            if (cmp32(now, subscription->nextPushAt) >= 0) {
+                // We fell behind, don't try to catch up
+                subscription->nextPushAt = now + subscription->period;
+            }
+        }
+
+        currentPort->mspVersion = savedMspVersion;
+        currentPort->cmdMSP = savedCmdMSP;
+        currentPort->dataSize = savedDataSize;
+        currentPort->indRX = savedIndRX;
+
+        bufWriterFlush(burst);
+    }
+}
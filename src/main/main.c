@@ -566,6 +566,7 @@ void init(void)
     m25p16_init(IOTAG_NONE);
 #endif
 
+    flashfsSetRollingMode(masterConfig.flashfs_erase_ahead_sectors, masterConfig.flashfs_wrap);
     flashfsInit();
 #endif
 
@@ -704,6 +705,7 @@ void main_init(void)
 
     setTaskEnabled(TASK_ATTITUDE, sensors(SENSOR_ACC));
     setTaskEnabled(TASK_SERIAL, true);
+    setTaskEnabled(TASK_MSP_SUBSCRIPTIONS, true);
 #ifdef BEEPER
     setTaskEnabled(TASK_BEEPER, true);
 #endif
@@ -748,6 +750,12 @@ void main_init(void)
 #ifdef USE_BST
     setTaskEnabled(TASK_BST_MASTER_PROCESS, true);
 #endif
+#ifdef USE_FLASHFS
+    setTaskEnabled(TASK_FLASHFS, flashfsGetSize() > 0 && masterConfig.flashfs_erase_ahead_sectors > 0);
+#endif
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+    setTaskEnabled(TASK_SDCARD_LOG_READER, true);
+#endif
 }
 
 void main_step(void)
@@ -0,0 +1,266 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+#include "build/build_config.h"
+
+#include "common/crc.h"
+#include "common/maths.h"
+
+#include "config/config.h"
+
+#include "drivers/system.h"
+#include "drivers/serial.h"
+
+#include "io/serial.h"
+
+#include "rx/rx.h"
+#include "rx/crsf.h"
+
+#define CRSF_MAX_CHANNEL        16
+
+#define CRSF_PORT_OPTIONS       (SERIAL_STOPBITS_1 | SERIAL_PARITY_NO)
+#define CRSF_PORT_MODE          MODE_RXTX   // Telemetry goes back to the receiver on the same port
+
+// A frame of the maximum length takes 1524us at 420000 baud, anything longer is the start of the next frame
+#define CRSF_TIME_NEEDED_PER_FRAME_US   1600
+
+extern uint16_t rssi;           // FIXME dependency on mw.c
+
+static serialPort_t *crsfPort;
+static rxConfig_t *crsfRxConfig;
+static rxRuntimeConfig_t *crsfRxRuntimeConfig;
+
+// Frame being received, written by the receive ISR
+static uint8_t crsfFrame[CRSF_FRAME_SIZE_MAX];
+static uint32_t crsfFrameStartAt;
+
+// Latest complete frames of each kind, for the main loop
+static bool crsfFrameDone = false;
+static uint8_t crsfChannelFrame[CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE];
+static uint32_t crsfChannelFrameStartedAt;
+static bool crsfLinkStatisticsReceived = false;
+static bool crsfLinkStatisticsValid = false;
+static crsfLinkStatistics_t crsfLinkStatistics;
+
+static uint32_t crsfChannelData[CRSF_MAX_CHANNEL];
+
+// Telemetry frame waiting to be sent in the gap after the next channel frame
+static uint8_t crsfTelemetryBuf[CRSF_FRAME_SIZE_MAX];
+static uint8_t crsfTelemetryBufLength = 0;
+
+static void crsfDataReceive(uint16_t c);
+static void crsfDataReceiveSpan(const uint8_t *data, int length);
+static uint16_t crsfReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
+
+bool crsfInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
+{
+    for (int i = 0; i < CRSF_MAX_CHANNEL; i++) {
+        // Centre all channels until the first frame arrives, rounding up so that midrc reads back unchanged
+        crsfChannelData[i] = ((rxConfig->midrc - 881) * 1639 + 1023) / 1024;
+    }
+    if (callback) {
+        *callback = crsfReadRawRC;
+    }
+    rxRuntimeConfig->channelCount = CRSF_MAX_CHANNEL;
+    rxRuntimeConfig->frameTimed = true;
+    crsfRxConfig = rxConfig;
+    crsfRxRuntimeConfig = rxRuntimeConfig;
+
+    serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_RX_SERIAL);
+    if (!portConfig) {
+        return false;
+    }
+
+    crsfPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, crsfDataReceive, CRSF_BAUDRATE, CRSF_PORT_MODE, CRSF_PORT_OPTIONS);
+    if (crsfPort) {
+        serialSetReceiveSpanCallback(crsfPort, crsfDataReceiveSpan);
+    }
+
+    return crsfPort != NULL;
+}
+
+// Called from the receive ISR with a frame that has just been completed
+static void crsfFrameReceived(void)
+{
+    const uint8_t length = crsfFrame[1];
+    const uint8_t *payload = &crsfFrame[3];
+    const uint8_t payloadLength = length - CRSF_FRAME_LENGTH_TYPE_CRC;
+
+    if (crc8DvbS2Update(0, &crsfFrame[2], length - 1) != crsfFrame[length + 1]) {
+        return;
+    }
+
+    switch (crsfFrame[2]) {
+    case CRSF_FRAMETYPE_RC_CHANNELS_PACKED:
+        if (payloadLength == CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE) {
+            memcpy(crsfChannelFrame, payload, CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE);
+            crsfChannelFrameStartedAt = crsfFrameStartAt;
+            crsfFrameDone = true;
+        }
+        break;
+    case CRSF_FRAMETYPE_LINK_STATISTICS:
+        if (payloadLength == CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE) {
+            memcpy(&crsfLinkStatistics, payload, CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE);
+            crsfLinkStatisticsReceived = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void crsfReceiveByte(uint8_t c, uint32_t receivedAt)
+{
+    static uint8_t crsfFramePosition = 0;
+
+    if (receivedAt - crsfFrameStartAt > CRSF_TIME_NEEDED_PER_FRAME_US) {
+        crsfFramePosition = 0;
+    }
+
+    if (crsfFramePosition == 0) {
+        if (c != CRSF_ADDRESS_FLIGHT_CONTROLLER) {
+            return;
+        }
+        crsfFrameStartAt = receivedAt;
+    }
+
+    crsfFrame[crsfFramePosition++] = c;
+
+    if (crsfFramePosition == CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH) {
+        if (c < CRSF_FRAME_LENGTH_TYPE_CRC || c > CRSF_PAYLOAD_SIZE_MAX + CRSF_FRAME_LENGTH_TYPE_CRC) {
+            // Not a frame after all, wait for the next address byte
+            crsfFramePosition = 0;
+        }
+    } else if (crsfFramePosition > CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH
+        && crsfFramePosition == crsfFrame[1] + CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH) {
+        crsfFrameReceived();
+        crsfFramePosition = 0;
+    }
+}
+
+// Receive ISR callback
+static void crsfDataReceive(uint16_t c)
+{
+    crsfReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void crsfDataReceiveSpan(const uint8_t *data, int length)
+{
+    static uint32_t lastSpanStartedAt;
+
+    // Passed on once the line has been idle for a byte, so the first byte arrived this long ago
+    uint32_t spanStartedAt = micros() - (length + 1) * 10 * 1000000UL / CRSF_BAUDRATE;
+
+    // A burst that runs past the end of the DMA buffer is passed on as two spans, timed from their own lengths, and
+    // the second mustn't look like it started before the first or the frame would be dropped as too long
+    if (lastSpanStartedAt - spanStartedAt < CRSF_TIME_NEEDED_PER_FRAME_US) {
+        spanStartedAt = lastSpanStartedAt;
+    }
+    lastSpanStartedAt = spanStartedAt;
+
+    for (int i = 0; i < length; i++) {
+        crsfReceiveByte(data[i], spanStartedAt);
+    }
+}
+
+static void crsfUnpackChannels(const uint8_t *payload)
+{
+    // 11 bits per channel, least significant bit first
+    uint32_t bits = 0;
+    int bitCount = 0;
+
+    for (int i = 0; i < CRSF_MAX_CHANNEL; i++) {
+        while (bitCount < 11) {
+            bits |= (uint32_t)*payload++ << bitCount;
+            bitCount += 8;
+        }
+        crsfChannelData[i] = bits & 0x07FF;
+        bits >>= 11;
+        bitCount -= 11;
+    }
+}
+
+static void crsfRxSendTelemetryData(void)
+{
+    if (crsfTelemetryBufLength) {
+        serialWriteBuf(crsfPort, crsfTelemetryBuf, crsfTelemetryBufLength);
+        crsfTelemetryBufLength = 0;
+    }
+}
+
+uint8_t crsfFrameStatus(void)
+{
+    if (crsfLinkStatisticsReceived) {
+        crsfLinkStatisticsReceived = false;
+        crsfLinkStatisticsValid = true;
+        // An RSSI channel or ADC takes precedence
+        if (crsfRxConfig->rssi_channel == 0 && !feature(FEATURE_RSSI_ADC)) {
+            rssi = (uint16_t)((constrain(crsfLinkStatistics.uplinkLinkQuality, 0, 100) * 1023) / 100);
+        }
+    }
+
+    if (!crsfFrameDone) {
+        return SERIAL_RX_FRAME_PENDING;
+    }
+    crsfFrameDone = false;
+
+    crsfUnpackChannels(crsfChannelFrame);
+    crsfRxRuntimeConfig->frameStartedAt = crsfChannelFrameStartedAt;
+
+    // The receiver sends the next channel frame several milliseconds from now, so there's time to answer
+    crsfRxSendTelemetryData();
+
+    return SERIAL_RX_FRAME_COMPLETE;
+}
+
+static uint16_t crsfReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan)
+{
+    UNUSED(rxRuntimeConfig);
+    // Scale 172..1811 (so 992 in the middle) to 988..2012us
+    return (crsfChannelData[chan] * 1024) / 1639 + 881;
+}
+
+bool crsfGetLinkStatistics(crsfLinkStatistics_t *linkStatistics)
+{
+    *linkStatistics = crsfLinkStatistics;
+    return crsfLinkStatisticsValid;
+}
+
+bool crsfRxIsActive(void)
+{
+    return crsfPort != NULL;
+}
+
+bool crsfRxIsTelemetryBufEmpty(void)
+{
+    return crsfTelemetryBufLength == 0;
+}
+
+void crsfRxWriteTelemetryData(const void *data, int length)
+{
+    length = MIN(length, (int)sizeof(crsfTelemetryBuf));
+    memcpy(crsfTelemetryBuf, data, length);
+    crsfTelemetryBufLength = length;
+}
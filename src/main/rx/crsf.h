@@ -0,0 +1,73 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Team BlackSheep Crossfire (CRSF) frames are
+ *   <address> <length> <type> <payload> <crc>
+ * where length counts the type, payload and CRC, and the CRC is CRC8 (DVB-S2) over the type and payload. Multi-byte
+ * fields are big endian.
+ */
+
+#define CRSF_BAUDRATE                       420000
+
+#define CRSF_ADDRESS_FLIGHT_CONTROLLER      0xC8
+
+#define CRSF_FRAME_SIZE_MAX                 64
+#define CRSF_FRAME_LENGTH_ADDRESS           1
+#define CRSF_FRAME_LENGTH_FRAMELENGTH       1
+#define CRSF_FRAME_LENGTH_TYPE_CRC          2   // Type and CRC, the least a frame's length byte can count
+#define CRSF_PAYLOAD_SIZE_MAX               (CRSF_FRAME_SIZE_MAX - CRSF_FRAME_LENGTH_ADDRESS - CRSF_FRAME_LENGTH_FRAMELENGTH - CRSF_FRAME_LENGTH_TYPE_CRC)
+
+#define CRSF_FRAME_GPS_PAYLOAD_SIZE                 15
+#define CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE      8
+#define CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE     10
+#define CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE         22  // 16 channels of 11 bits
+#define CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE            6
+
+typedef enum {
+    CRSF_FRAMETYPE_GPS = 0x02,
+    CRSF_FRAMETYPE_BATTERY_SENSOR = 0x08,
+    CRSF_FRAMETYPE_LINK_STATISTICS = 0x14,
+    CRSF_FRAMETYPE_RC_CHANNELS_PACKED = 0x16,
+    CRSF_FRAMETYPE_ATTITUDE = 0x1E
+} crsfFrameType_e;
+
+typedef struct crsfLinkStatistics_s {
+    uint8_t uplinkRssiAnt1;     // dBm * -1
+    uint8_t uplinkRssiAnt2;     // dBm * -1
+    uint8_t uplinkLinkQuality;  // Percentage of packets received
+    int8_t uplinkSnr;           // dB
+    uint8_t activeAntenna;
+    uint8_t rfMode;             // 0 = 4Hz, 1 = 50Hz, 2 = 150Hz
+    uint8_t uplinkTxPower;      // 0 = 0mW, 1 = 10mW, 2 = 25mW, 3 = 100mW, 4 = 500mW, 5 = 1000mW, 6 = 2000mW
+    uint8_t downlinkRssi;       // dBm * -1
+    uint8_t downlinkLinkQuality;
+    int8_t downlinkSnr;
+} crsfLinkStatistics_t;
+
+struct rxConfig_s;
+struct rxRuntimeConfig_s;
+bool crsfInit(struct rxConfig_s *rxConfig, struct rxRuntimeConfig_s *rxRuntimeConfig, rcReadRawDataPtr *callback);
+uint8_t crsfFrameStatus(void);
+
+bool crsfGetLinkStatistics(crsfLinkStatistics_t *linkStatistics);
+
+bool crsfRxIsActive(void);
+bool crsfRxIsTelemetryBufEmpty(void);
+void crsfRxWriteTelemetryData(const void *data, int length);
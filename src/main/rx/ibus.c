@@ -32,7 +32,6 @@
 #include "drivers/system.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #ifdef TELEMETRY
@@ -52,6 +51,7 @@ static bool ibusFrameDone = false;
 static uint32_t ibusChannelData[IBUS_MAX_CHANNEL];
 
 static void ibusDataReceive(uint16_t c);
+static void ibusDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t ibusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 bool ibusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
@@ -75,6 +75,9 @@ bool ibusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 #endif
 
     serialPort_t *ibusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, ibusDataReceive, IBUS_BAUDRATE, portShared ? MODE_RXTX : MODE_RX, SERIAL_NOT_INVERTED);
+    if (ibusPort) {
+        serialSetReceiveSpanCallback(ibusPort, ibusDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -87,15 +90,11 @@ bool ibusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 
 static uint8_t ibus[IBUS_BUFFSIZE] = { 0, };
 
-// Receive ISR callback
-static void ibusDataReceive(uint16_t c)
+static void ibusReceiveByte(uint8_t c, uint32_t ibusTime)
 {
-    uint32_t ibusTime;
     static uint32_t ibusTimeLast;
     static uint8_t ibusFramePosition;
 
-    ibusTime = micros();
-
     if ((ibusTime - ibusTimeLast) > 3000)
         ibusFramePosition = 0;
 
@@ -113,6 +112,23 @@ static void ibusDataReceive(uint16_t c)
     }
 }
 
+// Receive ISR callback
+static void ibusDataReceive(uint16_t c)
+{
+    ibusReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void ibusDataReceiveSpan(const uint8_t *data, int length)
+{
+    // Close enough to when each byte arrived to spot the 3ms gap between frames
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        ibusReceiveByte(data[i], now);
+    }
+}
+
 uint8_t ibusFrameStatus(void)
 {
     uint8_t i, offset;
@@ -46,7 +46,6 @@
 
 #include "drivers/system.h"
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 
 #include "io/serial.h"
 
@@ -208,6 +207,7 @@ static uint8_t jetiExBusRequestFrame[EXBUS_MAX_REQUEST_FRAME_SIZE];
 
 static uint16_t jetiExBusChannelData[JETIEXBUS_CHANNEL_COUNT];
 static void jetiExBusDataReceive(uint16_t c);
+static void jetiExBusDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t jetiExBusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 static void jetiExBusFrameReset();
@@ -245,6 +245,9 @@ bool jetiExBusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcR
 
     jetiExBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, jetiExBusDataReceive, JETIEXBUS_BAUDRATE, MODE_RXTX, JETIEXBUS_OPTIONS );
     serialSetMode(jetiExBusPort, MODE_RX);
+    if (jetiExBusPort) {
+        serialSetReceiveSpanCallback(jetiExBusPort, jetiExBusDataReceiveSpan);
+    }
     return jetiExBusPort != NULL;
 }
 
@@ -323,18 +326,14 @@ void jetiExBusFrameReset()
   ...
 */
 
-// Receive ISR callback
-static void jetiExBusDataReceive(uint16_t c)
+static void jetiExBusReceiveByte(uint8_t c, uint32_t now)
 {
-    uint32_t now;
     static uint32_t jetiExBusTimeLast = 0;
-    static int32_t jetiExBusTimeInterval;
+    static uint32_t jetiExBusTimeInterval;
 
     static uint8_t *jetiExBusFrame;
 
     // Check if we shall reset frame position due to time
-    now = micros();
-
     jetiExBusTimeInterval = now - jetiExBusTimeLast;
     jetiExBusTimeLast = now;
 
@@ -369,6 +368,14 @@ static void jetiExBusDataReceive(uint16_t c)
     // Check the header for the message length
     if (jetiExBusFramePosition == EXBUS_HEADER_LEN) {
 
+        // A length too short for the header and CRC would never be reached, and the frame would run off the end of the buffer
+        if (jetiExBusFrame[EXBUS_HEADER_MSG_LEN] < EXBUS_OVERHEAD) {
+            jetiExBusFrameReset();
+            jetiExBusFrameState = EXBUS_STATE_ZERO;
+            jetiExBusRequestState = EXBUS_STATE_ZERO;
+            return;
+        }
+
         if((jetiExBusFrameState == EXBUS_STATE_IN_PROGRESS) && (jetiExBusFrame[EXBUS_HEADER_MSG_LEN] <= EXBUS_MAX_CHANNEL_FRAME_SIZE)) {
             jetiExBusFrameLength = jetiExBusFrame[EXBUS_HEADER_MSG_LEN];
             return;
@@ -398,6 +405,23 @@ static void jetiExBusDataReceive(uint16_t c)
     }
 }
 
+// Receive ISR callback
+static void jetiExBusDataReceive(uint16_t c)
+{
+    jetiExBusReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void jetiExBusDataReceiveSpan(const uint8_t *data, int length)
+{
+    // Bytes in a burst arrived back to back, so they can share a time for finding the gap between frames
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        jetiExBusReceiveByte(data[i], now);
+    }
+}
+
 
 // Check if it is time to read a frame from the data...
 uint8_t jetiExBusFrameStatus()
@@ -551,15 +575,15 @@ void handleJetiExBusTelemetry(void)
         }
 
         if((jetiExBusRequestFrame[EXBUS_HEADER_DATA_ID] == EXBUS_EX_REQUEST) && (calcCRC16(jetiExBusRequestFrame, jetiExBusRequestFrame[EXBUS_HEADER_MSG_LEN]) == 0)) {
-            jetiExSensors[EX_VOLTAGE].value = vbat;
-            jetiExSensors[EX_CURRENT].value = amperage;
-            jetiExSensors[EX_ALTITUDE].value = BaroAlt;
-            jetiExSensors[EX_CAPACITY].value = mAhDrawn;
+            jetiExSensors[EX_VOLTAGE].value = telemetryData.vbat;
+            jetiExSensors[EX_CURRENT].value = telemetryData.amperage;
+            jetiExSensors[EX_ALTITUDE].value = telemetryData.baroAltitude;
+            jetiExSensors[EX_CAPACITY].value = telemetryData.mAhDrawn;
             jetiExSensors[EX_FRAMES_LOST].value = framesLost;
             jetiExSensors[EX_TIME_DIFF].value = timeDiff;
 
             // switch to TX mode
-            if (uartTotalRxBytesWaiting(jetiExBusPort) == 0) {
+            if (serialRxBytesWaiting(jetiExBusPort) == 0) {
                 serialSetMode(jetiExBusPort, MODE_TX);
                 jetiExBusTransceiveState = EXBUS_TRANS_TX;
                 sendJetiExBusTelemetry(jetiExBusRequestFrame[EXBUS_HEADER_PACKET_ID]);
@@ -53,6 +53,7 @@
 #include "rx/xbus.h"
 #include "rx/ibus.h"
 #include "rx/jetiexbus.h"
+#include "rx/crsf.h"
 
 
 //#define DEBUG_RX_SIGNAL_LOSS
@@ -79,6 +80,10 @@ static bool rxIsInFailsafeMode = true;
 static bool rxIsInFailsafeModeNotDataDriven = true;
 
 static uint32_t rxUpdateAt = 0;
+static uint32_t rxFrameStartedAt = 0;       // Latest frame from the receiver
+static bool rxFrameStarted = false;         // rxFrameStartedAt holds a frame, 0 is a valid micros() time
+static uint32_t rcDataFrameStartedAt = 0;   // Frame rcData was last calculated from
+static bool rcDataFrameStarted = false;
 static uint32_t needRxSignalBefore = 0;
 static uint32_t suspendRxSignalUntil = 0;
 static uint8_t  skipRxSamples = 0;
@@ -244,6 +249,10 @@ void serialRxInit(rxConfig_t *rxConfig)
             rxRefreshRate = 5500;
             enabled = jetiExBusInit(rxConfig, &rxRuntimeConfig, &rcReadRawFunc);
             break;
+        case SERIALRX_CRSF:
+            rxRefreshRate = 6667; // 150Hz
+            enabled = crsfInit(rxConfig, &rxRuntimeConfig, &rcReadRawFunc);
+            break;
     }
 
     if (!enabled) {
@@ -280,6 +289,8 @@ uint8_t serialRxFrameStatus(rxConfig_t *rxConfig)
             return ibusFrameStatus();
         case SERIALRX_JETIEXBUS:
             return jetiExBusFrameStatus();
+        case SERIALRX_CRSF:
+            return crsfFrameStatus();
     }
     return SERIAL_RX_FRAME_PENDING;
 }
@@ -298,6 +309,16 @@ bool rxIsReceivingSignal(void)
     return rxSignalReceived;
 }
 
+/*
+ * When the frame rcData was calculated from began to arrive, for measuring the latency from RX to motors. Returns
+ * false until rcData has been calculated from a frame.
+ */
+bool rxGetFrameStartedAt(uint32_t *frameStartedAt)
+{
+    *frameStartedAt = rcDataFrameStartedAt;
+    return rcDataFrameStarted;
+}
+
 bool rxAreFlightChannelsValid(void)
 {
     return rxFlightChannelsValid;
@@ -350,6 +371,9 @@ void updateRx(uint32_t currentTime)
             rxIsInFailsafeMode = (frameStatus & SERIAL_RX_FRAME_FAILSAFE) != 0;
             rxSignalReceived = !rxIsInFailsafeMode;
             needRxSignalBefore = currentTime + DELAY_10_HZ;
+            // Frames from drivers which don't time them count from when they were noticed
+            rxFrameStartedAt = rxRuntimeConfig.frameTimed ? rxRuntimeConfig.frameStartedAt : currentTime;
+            rxFrameStarted = true;
         }
     }
 #endif
@@ -361,6 +385,8 @@ void updateRx(uint32_t currentTime)
             rxSignalReceived = true;
             rxIsInFailsafeMode = false;
             needRxSignalBefore = currentTime + DELAY_5_HZ;
+            rxFrameStartedAt = currentTime;
+            rxFrameStarted = true;
         }
     }
 #endif
@@ -371,6 +397,8 @@ void updateRx(uint32_t currentTime)
             rxSignalReceivedNotDataDriven = true;
             rxIsInFailsafeModeNotDataDriven = false;
             needRxSignalBefore = currentTime + DELAY_10_HZ;
+            rxFrameStartedAt = currentTime;
+            rxFrameStarted = true;
             resetPPMDataReceivedState();
         }
     }
@@ -380,6 +408,8 @@ void updateRx(uint32_t currentTime)
             rxSignalReceivedNotDataDriven = true;
             rxIsInFailsafeModeNotDataDriven = false;
             needRxSignalBefore = currentTime + DELAY_10_HZ;
+            rxFrameStartedAt = currentTime;
+            rxFrameStarted = true;
         }
     }
 #endif
@@ -577,6 +607,8 @@ void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime)
 
     readRxChannelsApplyRanges();
     detectAndApplySignalLossBehaviour();
+    rcDataFrameStartedAt = rxFrameStartedAt;
+    rcDataFrameStarted = rxFrameStarted;
 
     rcSampleIndex++;
 }
@@ -53,7 +53,8 @@ typedef enum {
     SERIALRX_XBUS_MODE_B_RJ01 = 6,
     SERIALRX_IBUS = 7,
     SERIALRX_JETIEXBUS = 8,
-    SERIALRX_PROVIDER_MAX = SERIALRX_JETIEXBUS
+    SERIALRX_CRSF = 9,
+    SERIALRX_PROVIDER_MAX = SERIALRX_CRSF
 } SerialRXType;
 
 #define SERIALRX_PROVIDER_COUNT (SERIALRX_PROVIDER_MAX + 1)
@@ -139,6 +140,8 @@ typedef struct rxConfig_s {
 typedef struct rxRuntimeConfig_s {
     uint8_t channelCount;                  // number of rc channels as reported by current input driver
     uint8_t auxChannelCount;
+    uint32_t frameStartedAt;               // micros() when the latest complete frame began to arrive, set by drivers that know
+    bool frameTimed;                       // set by drivers which fill in frameStartedAt
 } rxRuntimeConfig_t;
 
 extern rxRuntimeConfig_t rxRuntimeConfig;
@@ -151,6 +154,7 @@ void useRxConfig(rxConfig_t *rxConfigToUse);
 void updateRx(uint32_t currentTime);
 bool rxIsReceivingSignal(void);
 bool rxAreFlightChannelsValid(void);
+bool rxGetFrameStartedAt(uint32_t *frameStartedAt);
 bool shouldProcessRx(uint32_t currentTime);
 void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime);
 
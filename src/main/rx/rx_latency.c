@@ -0,0 +1,84 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifndef SKIP_RX_LATENCY
+
+#include "build/debug.h"
+
+#include "common/maths.h"
+
+#include "rx/rx_latency.h"
+
+typedef struct rxLatencyHistogram_s {
+    uint32_t lastFrameStartedAt;    // Frame the stage was last recorded for
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t buckets[RX_LATENCY_BUCKET_COUNT];
+} rxLatencyHistogram_t;
+
+static rxLatencyHistogram_t rxLatencyHistograms[RX_LATENCY_STAGE_COUNT];
+
+void rxLatencyRecord(rxLatencyStage_e stage, uint32_t frameStartedAt, uint32_t currentTime)
+{
+    rxLatencyHistogram_t *histogram = &rxLatencyHistograms[stage];
+
+    if (histogram->count && frameStartedAt == histogram->lastFrameStartedAt) {
+        return;
+    }
+    histogram->lastFrameStartedAt = frameStartedAt;
+
+    const uint32_t latencyUs = currentTime - frameStartedAt;
+
+    if (histogram->count == 0 || latencyUs < histogram->minUs) {
+        histogram->minUs = latencyUs;
+    }
+    histogram->maxUs = MAX(histogram->maxUs, latencyUs);
+    histogram->totalUs += latencyUs;
+    histogram->count++;
+
+    histogram->buckets[MIN(latencyUs / RX_LATENCY_BUCKET_WIDTH_US, RX_LATENCY_BUCKET_COUNT - 1)]++;
+
+    if (debugMode == DEBUG_RX_LATENCY) {
+        debug[stage] = MIN(latencyUs, INT16_MAX);
+    }
+}
+
+void rxLatencyGetStats(rxLatencyStage_e stage, rxLatencyStats_t *stats)
+{
+    const rxLatencyHistogram_t *histogram = &rxLatencyHistograms[stage];
+
+    stats->count = histogram->count;
+    stats->minUs = histogram->minUs;
+    stats->maxUs = histogram->maxUs;
+    stats->averageUs = histogram->count ? histogram->totalUs / histogram->count : 0;
+    memcpy(stats->buckets, histogram->buckets, sizeof(stats->buckets));
+}
+
+void rxLatencyReset(void)
+{
+    memset(rxLatencyHistograms, 0, sizeof(rxLatencyHistograms));
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Latency from the start of an RX frame to the flight controller acting on it, for comparing RX protocols, RX task
+ * rates and RC smoothing settings.
+ *
+ * Each stage is recorded once per frame, the first time it is reached with that frame's data.
+ */
+
+typedef enum {
+    RX_LATENCY_RC_COMMAND = 0,  // Setpoints calculated from the frame's rcCommand
+    RX_LATENCY_MOTORS,          // Motor outputs written after that
+    RX_LATENCY_STAGE_COUNT
+} rxLatencyStage_e;
+
+#define RX_LATENCY_BUCKET_COUNT     16
+#define RX_LATENCY_BUCKET_WIDTH_US  500     // The last bucket also counts everything slower
+
+typedef struct rxLatencyStats_s {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t averageUs;
+    uint32_t buckets[RX_LATENCY_BUCKET_COUNT];
+} rxLatencyStats_t;
+
+void rxLatencyRecord(rxLatencyStage_e stage, uint32_t frameStartedAt, uint32_t currentTime);
+void rxLatencyGetStats(rxLatencyStage_e stage, rxLatencyStats_t *stats);
+void rxLatencyReset(void);
@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -29,7 +30,6 @@
 #include "drivers/inverter.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #ifdef TELEMETRY
@@ -80,9 +80,11 @@ static uint16_t sbusStateFlags = 0;
 
 static bool sbusFrameDone = false;
 static void sbusDataReceive(uint16_t c);
+static void sbusDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t sbusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 static uint32_t sbusChannelData[SBUS_MAX_CHANNEL];
+static rxRuntimeConfig_t *sbusRxRuntimeConfig;
 
 bool sbusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
 {
@@ -92,6 +94,8 @@ bool sbusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
     if (callback)
         *callback = sbusReadRawRC;
     rxRuntimeConfig->channelCount = SBUS_MAX_CHANNEL;
+    rxRuntimeConfig->frameTimed = true;
+    sbusRxRuntimeConfig = rxRuntimeConfig;
 
     serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_RX_SERIAL);
     if (!portConfig) {
@@ -106,6 +110,9 @@ bool sbusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 
     portOptions_t options = (rxConfig->sbus_inversion) ? (SBUS_PORT_OPTIONS | SERIAL_INVERTED) : SBUS_PORT_OPTIONS;
     serialPort_t *sBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sbusDataReceive, SBUS_BAUDRATE, portShared ? MODE_RXTX : MODE_RX, options);
+    if (sBusPort) {
+        serialSetReceiveSpanCallback(sBusPort, sbusDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -158,16 +165,17 @@ typedef union {
 
 static sbusFrame_t sbusFrame;
 
+static uint8_t sbusFramePosition = 0;
+
 // Receive ISR callback
 static void sbusDataReceive(uint16_t c)
 {
-    static uint8_t sbusFramePosition = 0;
     static uint32_t sbusFrameStartAt = 0;
     uint32_t now = micros();
 
-    int32_t sbusFrameTime = now - sbusFrameStartAt;
+    uint32_t sbusFrameTime = now - sbusFrameStartAt;
 
-    if (sbusFrameTime > (long)(SBUS_TIME_NEEDED_PER_FRAME + 500)) {
+    if (sbusFrameTime > SBUS_TIME_NEEDED_PER_FRAME + 500) {
         sbusFramePosition = 0;
     }
 
@@ -183,6 +191,7 @@ static void sbusDataReceive(uint16_t c)
         if (sbusFramePosition < SBUS_FRAME_SIZE) {
             sbusFrameDone = false;
         } else {
+            sbusRxRuntimeConfig->frameStartedAt = sbusFrameStartAt;
             sbusFrameDone = true;
 #ifdef DEBUG_SBUS_PACKETS
         debug[2] = sbusFrameTime;
@@ -191,6 +200,24 @@ static void sbusDataReceive(uint16_t c)
     }
 }
 
+// Receive ISR callback for ports which pass on a burst at a time, which is normally a whole frame
+static void sbusDataReceiveSpan(const uint8_t *data, int length)
+{
+    if (length == SBUS_FRAME_SIZE && data[0] == SBUS_FRAME_BEGIN_BYTE) {
+        memcpy(sbusFrame.bytes, data, SBUS_FRAME_SIZE);
+        sbusFramePosition = 0; // The next byte received one at a time must start a frame
+        // Passed on once the line has been idle for a byte, so the frame started a frame and a byte's time ago
+        sbusRxRuntimeConfig->frameStartedAt = micros() - SBUS_TIME_NEEDED_PER_FRAME - SBUS_TIME_NEEDED_PER_FRAME / SBUS_FRAME_SIZE;
+        sbusFrameDone = true;
+        return;
+    }
+
+    // Part of a frame, or more than one, so resynchronise a byte at a time
+    for (int i = 0; i < length; i++) {
+        sbusDataReceive(data[i]);
+    }
+}
+
 uint8_t sbusFrameStatus(void)
 {
     if (!sbusFrameDone) {
@@ -23,14 +23,14 @@
 
 #include "build/debug.h"
 
+#ifdef SPEKTRUM_BIND
 #include "drivers/io.h"
 #include "drivers/io_impl.h"
-#include "drivers/system.h"
-
 #include "drivers/light_led.h"
+#endif
+#include "drivers/system.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #include "config/config.h"
@@ -60,6 +60,7 @@ static bool spekHiRes = false;
 static volatile uint8_t spekFrame[SPEK_FRAME_SIZE];
 
 static void spektrumDataReceive(uint16_t c);
+static void spektrumDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t spektrumReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 static rxRuntimeConfig_t *rxRuntimeConfigPtr;
@@ -107,6 +108,9 @@ bool spektrumInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcRe
 #endif
 
     serialPort_t *spektrumPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, spektrumDataReceive, SPEKTRUM_BAUDRATE, portShared ? MODE_RXTX : MODE_RX, SERIAL_NOT_INVERTED);
+    if (spektrumPort) {
+        serialSetReceiveSpanCallback(spektrumPort, spektrumDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -117,14 +121,11 @@ bool spektrumInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcRe
     return spektrumPort != NULL;
 }
 
-// Receive ISR callback
-static void spektrumDataReceive(uint16_t c)
+static void spektrumReceiveByte(uint8_t c, uint32_t spekTime)
 {
-    uint32_t spekTime;
     static uint32_t spekTimeLast, spekTimeInterval;
     static uint8_t spekFramePosition;
 
-    spekTime = micros();
     spekTimeInterval = spekTime - spekTimeLast;
     spekTimeLast = spekTime;
     if (spekTimeInterval > 5000) {
@@ -141,6 +142,23 @@ static void spektrumDataReceive(uint16_t c)
     }
 }
 
+// Receive ISR callback
+static void spektrumDataReceive(uint16_t c)
+{
+    spektrumReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void spektrumDataReceiveSpan(const uint8_t *data, int length)
+{
+    // Frames are only told apart by the gap between them, which a single time for the burst still shows
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        spektrumReceiveByte(data[i], now);
+    }
+}
+
 static uint32_t spekChannelData[SPEKTRUM_MAX_SUPPORTED_CHANNEL_COUNT];
 
 uint8_t spektrumFrameStatus(void)
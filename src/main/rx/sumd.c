@@ -26,7 +26,6 @@
 #include "drivers/system.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #ifdef TELEMETRY
@@ -51,6 +50,7 @@ static uint16_t sumdChannels[SUMD_MAX_CHANNEL];
 static uint16_t crc;
 
 static void sumdDataReceive(uint16_t c);
+static void sumdDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t sumdReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 bool sumdInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
@@ -74,6 +74,9 @@ bool sumdInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 #endif
 
     serialPort_t *sumdPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sumdDataReceive, SUMD_BAUDRATE, portShared ? MODE_RXTX : MODE_RX, SERIAL_NOT_INVERTED);
+    if (sumdPort) {
+        serialSetReceiveSpanCallback(sumdPort, sumdDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -103,14 +106,11 @@ static void CRC16(uint8_t value)
 static uint8_t sumd[SUMD_BUFFSIZE] = { 0, };
 static uint8_t sumdChannelCount;
 
-// Receive ISR callback
-static void sumdDataReceive(uint16_t c)
+static void sumdReceiveByte(uint8_t c, uint32_t sumdTime)
 {
-    uint32_t sumdTime;
     static uint32_t sumdTimeLast;
     static uint8_t sumdIndex;
 
-    sumdTime = micros();
     if ((sumdTime - sumdTimeLast) > 4000)
         sumdIndex = 0;
     sumdTimeLast = sumdTime;
@@ -124,8 +124,14 @@ static void sumdDataReceive(uint16_t c)
             crc = 0;
         }
     }
-    if (sumdIndex == 2)
+    if (sumdIndex == 2) {
+        if (c > SUMD_MAX_CHANNEL) {
+            // The CRC would be looked for beyond the end of the buffer
+            sumdIndex = 0;
+            return;
+        }
         sumdChannelCount = (uint8_t)c;
+    }
     if (sumdIndex < SUMD_BUFFSIZE)
         sumd[sumdIndex] = (uint8_t)c;
     sumdIndex++;
@@ -138,6 +144,23 @@ static void sumdDataReceive(uint16_t c)
         }
 }
 
+// Receive ISR callback
+static void sumdDataReceive(uint16_t c)
+{
+    sumdReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void sumdDataReceiveSpan(const uint8_t *data, int length)
+{
+    // One time for the whole burst still shows the 4ms gap before each frame
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        sumdReceiveByte(data[i], now);
+    }
+}
+
 #define SUMD_OFFSET_CHANNEL_1_HIGH 3
 #define SUMD_OFFSET_CHANNEL_1_LOW 4
 #define SUMD_BYTES_PER_CHANNEL 2
@@ -32,7 +32,6 @@
 #include "drivers/system.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #ifdef TELEMETRY
@@ -55,6 +54,7 @@ static uint8_t sumhFrame[SUMH_FRAME_SIZE];
 static uint32_t sumhChannels[SUMH_MAX_CHANNEL_COUNT];
 
 static void sumhDataReceive(uint16_t c);
+static void sumhDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t sumhReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 static serialPort_t *sumhPort;
@@ -86,6 +86,9 @@ bool sumhInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 #endif
 
     sumhPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sumhDataReceive, SUMH_BAUDRATE, portShared ? MODE_RXTX : MODE_RX, SERIAL_NOT_INVERTED);
+    if (sumhPort) {
+        serialSetReceiveSpanCallback(sumhPort, sumhDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -96,14 +99,11 @@ bool sumhInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
     return sumhPort != NULL;
 }
 
-// Receive ISR callback
-static void sumhDataReceive(uint16_t c)
+static void sumhReceiveByte(uint8_t c, uint32_t sumhTime)
 {
-    uint32_t sumhTime;
     static uint32_t sumhTimeLast, sumhTimeInterval;
     static uint8_t sumhFramePosition;
 
-    sumhTime = micros();
     sumhTimeInterval = sumhTime - sumhTimeLast;
     sumhTimeLast = sumhTime;
     if (sumhTimeInterval > 5000) {
@@ -119,6 +119,23 @@ static void sumhDataReceive(uint16_t c)
     }
 }
 
+// Receive ISR callback
+static void sumhDataReceive(uint16_t c)
+{
+    sumhReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void sumhDataReceiveSpan(const uint8_t *data, int length)
+{
+    // The time is only used to find the 5ms gap between frames, so the burst can share one
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        sumhReceiveByte(data[i], now);
+    }
+}
+
 uint8_t sumhFrameStatus(void)
 {
     uint8_t channelIndex;
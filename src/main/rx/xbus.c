@@ -24,7 +24,6 @@
 #include "drivers/system.h"
 
 #include "drivers/serial.h"
-#include "drivers/serial_uart.h"
 #include "io/serial.h"
 
 #ifdef TELEMETRY
@@ -86,6 +85,7 @@ static volatile uint8_t xBusFrame[XBUS_RJ01_FRAME_SIZE];
 static uint16_t xBusChannelData[XBUS_RJ01_CHANNEL_COUNT];
 
 static void xBusDataReceive(uint16_t c);
+static void xBusDataReceiveSpan(const uint8_t *data, int length);
 static uint16_t xBusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 bool xBusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
@@ -134,6 +134,9 @@ bool xBusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRa
 #endif
 
     serialPort_t *xBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, xBusDataReceive, baudRate, portShared ? MODE_RXTX : MODE_RX, SERIAL_NOT_INVERTED);
+    if (xBusPort) {
+        serialSetReceiveSpanCallback(xBusPort, xBusDataReceiveSpan);
+    }
 
 #ifdef TELEMETRY
     if (portShared) {
@@ -267,14 +270,11 @@ static void xBusUnpackRJ01Frame(void)
     xBusUnpackModeBFrame(XBUS_RJ01_OFFSET_BYTES);
 }
 
-// Receive ISR callback
-static void xBusDataReceive(uint16_t c)
+static void xBusReceiveByte(uint8_t c, uint32_t now)
 {
-    uint32_t now;
     static uint32_t xBusTimeLast, xBusTimeInterval;
 
     // Check if we shall reset frame position due to time
-    now = micros();
     xBusTimeInterval = now - xBusTimeLast;
     xBusTimeLast = now;
     if (xBusTimeInterval > XBUS_MAX_FRAME_TIME) {
@@ -299,14 +299,33 @@ static void xBusDataReceive(uint16_t c)
         switch (xBusProvider) {
             case SERIALRX_XBUS_MODE_B:
                 xBusUnpackModeBFrame(0);
+                break;
             case SERIALRX_XBUS_MODE_B_RJ01:
                 xBusUnpackRJ01Frame();
+                break;
         }
         xBusDataIncoming = false;
         xBusFramePosition = 0;
     }
 }
 
+// Receive ISR callback
+static void xBusDataReceive(uint16_t c)
+{
+    xBusReceiveByte(c, micros());
+}
+
+// Receive ISR callback for ports which pass on a burst at a time
+static void xBusDataReceiveSpan(const uint8_t *data, int length)
+{
+    // Only used to find the gap between frames, so one time for the whole burst will do
+    const uint32_t now = micros();
+
+    for (int i = 0; i < length; i++) {
+        xBusReceiveByte(data[i], now);
+    }
+}
+
 // Indicate time to read a frame from the data...
 uint8_t xBusFrameStatus(void)
 {
@@ -33,7 +33,11 @@
 
 #include "drivers/system.h"
 
+// Unused time budget a task can carry over to its next run, as a fraction of its budget
+#define TASK_TIME_BUDGET_MAX_CARRY_DIVISOR 4
+
 static cfTask_t *currentTask = NULL;
+static uint32_t currentTaskTimeBudget = 0;
 
 static uint32_t totalWaitingTasks;
 static uint32_t totalWaitingTasksSamples;
@@ -132,6 +136,8 @@ void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo)
     taskInfo->totalExecutionTime = cfTasks[taskId].totalExecutionTime;
     taskInfo->averageExecutionTime = cfTasks[taskId].averageExecutionTime;
     taskInfo->latestDeltaTime = cfTasks[taskId].taskLatestDeltaTime;
+    taskInfo->timeBudget = cfTasks[taskId].timeBudget;
+    taskInfo->timeBudgetCarry = cfTasks[taskId].timeBudgetCarry;
 }
 #endif
 
@@ -165,6 +171,20 @@ uint32_t getTaskDeltaTime(cfTaskId_e taskId)
     }
 }
 
+/*
+ * Returns the number of microseconds the running task may spend working through queued work (e.g. a batch of
+ * received commands), measured from when the task was called. Tasks without a time budget get zero, and should do
+ * their usual single unit of work.
+ *
+ * The budget includes whatever the task left unused last time (at most a quarter of its budget, so a task that has
+ * been idle can't save up for a long burst), less any overrun, and never extends past the time the next realtime
+ * task is due.
+ */
+uint32_t getTaskTimeBudget(void)
+{
+    return currentTaskTimeBudget;
+}
+
 void schedulerInit(void)
 {
     queueClear();
@@ -246,9 +266,32 @@ void scheduler(void)
 
         // Execute task
         const uint32_t currentTimeBeforeTaskCall = micros();
+        int32_t availableTimeBudget = 0;
+
+        if (selectedTask->timeBudget) {
+            availableTimeBudget = selectedTask->timeBudget + selectedTask->timeBudgetCarry;
+
+            // Don't let the task hold up the next realtime task
+            const uint32_t timeSinceRealtimeCheck = currentTimeBeforeTaskCall - currentTime;
+
+            if (availableTimeBudget < 0 || timeToNextRealtimeTask <= timeSinceRealtimeCheck) {
+                currentTaskTimeBudget = 0;
+            } else {
+                currentTaskTimeBudget = MIN((uint32_t)availableTimeBudget, timeToNextRealtimeTask - timeSinceRealtimeCheck);
+            }
+        } else {
+            currentTaskTimeBudget = 0;
+        }
+
         selectedTask->taskFunc();
         const uint32_t taskExecutionTime = micros() - currentTimeBeforeTaskCall;
 
+        if (selectedTask->timeBudget) {
+            // Unused budget can be spent next time, up to a quarter of a run's worth, and overruns are paid back
+            selectedTask->timeBudgetCarry = constrain(availableTimeBudget - (int32_t)taskExecutionTime,
+                -selectedTask->timeBudget, selectedTask->timeBudget / TASK_TIME_BUDGET_MAX_CARRY_DIVISOR);
+        }
+
         selectedTask->averageExecutionTime = ((uint32_t)selectedTask->averageExecutionTime * 31 + taskExecutionTime) / 32;
 #ifndef SKIP_TASK_STATISTICS
         selectedTask->totalExecutionTime += taskExecutionTime;   // time consumed by scheduler + task
@@ -38,6 +38,8 @@ typedef struct {
     uint32_t     totalExecutionTime;
     uint32_t     averageExecutionTime;
     uint32_t     latestDeltaTime;
+    uint16_t     timeBudget;
+    int32_t      timeBudgetCarry;
 } cfTaskInfo_t;
 
 typedef enum {
@@ -48,6 +50,7 @@ typedef enum {
     TASK_ATTITUDE,
     TASK_RX,
     TASK_SERIAL,
+    TASK_MSP_SUBSCRIPTIONS,
     TASK_BATTERY,
 #ifdef BEEPER
     TASK_BEEPER,
@@ -85,6 +88,12 @@ typedef enum {
 #ifdef USE_BST
     TASK_BST_MASTER_PROCESS,
 #endif
+#ifdef USE_FLASHFS
+    TASK_FLASHFS,
+#endif
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+    TASK_SDCARD_LOG_READER,
+#endif
 
     /* Count of real tasks */
     TASK_COUNT,
@@ -102,12 +111,14 @@ typedef struct {
     void (*taskFunc)(void);
     uint32_t desiredPeriod;         // target period of execution
     const uint8_t staticPriority;   // dynamicPriority grows in steps of this size, shouldn't be zero
+    uint16_t timeBudget;            // microseconds the task may keep working for per run if it has more to do, see getTaskTimeBudget()
 
     /* Scheduling */
     uint16_t dynamicPriority;       // measurement of how old task was last executed, used to avoid task starvation
     uint16_t taskAgeCycles;
     uint32_t lastExecutedAt;        // last time of invocation
     uint32_t lastSignaledAt;        // time of invocation event for event-driven tasks
+    int32_t timeBudgetCarry;        // budget left unused by previous runs, negative if they overran
 
     /* Statistics */
     uint32_t averageExecutionTime;  // Moving average over 6 samples, used to calculate guard interval
@@ -126,6 +137,7 @@ void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo);
 void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros);
 void setTaskEnabled(cfTaskId_e taskId, bool newEnabledState);
 uint32_t getTaskDeltaTime(cfTaskId_e taskId);
+uint32_t getTaskTimeBudget(void);
 
 void schedulerInit(void);
 void scheduler(void);
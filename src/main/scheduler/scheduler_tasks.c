@@ -67,6 +67,14 @@ cfTask_t cfTasks[TASK_COUNT] = {
         .taskFunc = taskHandleSerial,
         .desiredPeriod = 1000000 / 100,     // 100 Hz should be enough to flush up to 115 bytes @ 115200 baud
         .staticPriority = TASK_PRIORITY_LOW,
+        .timeBudget = 250,                  // Lets MSP answer a burst of pipelined requests in one run
+    },
+
+    [TASK_MSP_SUBSCRIPTIONS] = {
+        .taskName = "MSPPUSH",
+        .taskFunc = taskMspPushSubscriptions,
+        .desiredPeriod = 1000000 / 200,     // Fastest subscription period is 5ms
+        .staticPriority = TASK_PRIORITY_LOW,
     },
 
     [TASK_BATTERY] = {
@@ -173,6 +181,24 @@ cfTask_t cfTasks[TASK_COUNT] = {
     },
 #endif
 
+#ifdef USE_FLASHFS
+    [TASK_FLASHFS] = {
+        .taskName = "FLASHFS",
+        .taskFunc = taskFlashfs,
+        .desiredPeriod = 1000000 / 50,          // 50 Hz, sector erases take hundreds of ms anyway
+        .staticPriority = TASK_PRIORITY_LOW,
+    },
+#endif
+
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+    [TASK_SDCARD_LOG_READER] = {
+        .taskName = "SDLOGREAD",
+        .taskFunc = taskSdcardLogReader,
+        .desiredPeriod = 1000000 / 500,         // 500 Hz, each run copies the sectors that are already cached
+        .staticPriority = TASK_PRIORITY_LOW,
+    },
+#endif
+
 #ifdef USE_BST
     [TASK_BST_MASTER_PROCESS] = {
         .taskName = "BST_MASTER_PROCESS",
@@ -24,6 +24,7 @@ void taskUpdateAttitude(void);
 bool taskUpdateRxCheck(uint32_t currentDeltaTime);
 void taskUpdateRxMain(void);
 void taskHandleSerial(void);
+void taskMspPushSubscriptions(void);
 void taskUpdateBattery(void);
 void taskUpdateBeeper(void);
 void taskProcessGPS(void);
@@ -38,6 +39,12 @@ void taskTransponder(void);
 #ifdef OSD
 void taskUpdateOsd(void);
 #endif
+#ifdef USE_FLASHFS
+void taskFlashfs(void);
+#endif
+#if defined(USE_SDCARD) && defined(BLACKBOX)
+void taskSdcardLogReader(void);
+#endif
 #ifdef USE_BST
 void taskBstReadWrite(void);
 void taskBstMasterProcess(void);
@@ -58,6 +58,7 @@
 #undef USE_CLI
 #undef SERIAL_RX
 #define SKIP_TASK_STATISTICS
+#define SKIP_RX_LATENCY
 #define SKIP_CLI_COMMAND_HELP
 #define SKIP_PID_FLOAT
 #endif
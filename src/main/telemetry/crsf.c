@@ -0,0 +1,224 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Crossfire telemetry, sent back to the receiver on the RX port.
+ *
+ * The receiver sends a channel frame every 6.7ms at 150Hz, which takes it about 0.6ms. One telemetry frame at a time
+ * is handed to the RX driver, which sends it once the next channel frame has arrived so that it lands in the gap
+ * before the one after. Battery, attitude and GPS frames take turns, GPS only while there is a GPS.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifdef TELEMETRY
+
+#include "build/build_config.h"
+
+#include "common/axis.h"
+#include "common/crc.h"
+#include "common/maths.h"
+
+#include "config/config.h"
+
+#include "drivers/sensor.h"
+#include "drivers/serial.h"
+
+#include "fc/runtime_config.h"
+
+#include "io/gps.h"
+#include "io/serial.h"
+
+#include "rx/rx.h"
+#include "rx/crsf.h"
+
+#include "sensors/sensors.h"
+
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry_slots.h"
+#include "telemetry/crsf.h"
+
+typedef enum {
+    CRSF_TELEMETRY_BATTERY = 0,
+    CRSF_TELEMETRY_ATTITUDE,
+    CRSF_TELEMETRY_GPS,
+    CRSF_TELEMETRY_FRAME_COUNT
+} crsfTelemetryFrame_e;
+
+#define CRSF_FRAME_SIZE(payloadSize) ((payloadSize) + CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH + CRSF_FRAME_LENGTH_TYPE_CRC)
+
+#define CRSF_TELEMETRY_MAX_MICROS_PER_CALL 100
+
+static telemetrySlot_t crsfTelemetrySlots[CRSF_TELEMETRY_FRAME_COUNT] = {
+    [CRSF_TELEMETRY_BATTERY]  = { .intervalMs = 0, .priority = 1, .maxBytes = CRSF_FRAME_SIZE(CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE) },
+    [CRSF_TELEMETRY_ATTITUDE] = { .intervalMs = 0, .priority = 1, .maxBytes = CRSF_FRAME_SIZE(CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE) },
+    [CRSF_TELEMETRY_GPS]      = { .intervalMs = 0, .priority = 1, .maxBytes = CRSF_FRAME_SIZE(CRSF_FRAME_GPS_PAYLOAD_SIZE) },
+};
+static telemetrySlotScheduler_t crsfTelemetryScheduler;
+
+static bool crsfTelemetryEnabled;
+
+static uint8_t crsfFrame[CRSF_FRAME_SIZE_MAX];
+static uint8_t crsfFramePosition;
+
+static void crsfInitializeFrame(crsfFrameType_e type)
+{
+    crsfFrame[0] = CRSF_ADDRESS_FLIGHT_CONTROLLER;
+    // crsfFrame[1] is the length, filled in by crsfFinalizeFrame()
+    crsfFrame[2] = type;
+    crsfFramePosition = 3;
+}
+
+static void crsfSerialize8(uint8_t v)
+{
+    crsfFrame[crsfFramePosition++] = v;
+}
+
+static void crsfSerialize16(uint16_t v)
+{
+    crsfSerialize8(v >> 8);
+    crsfSerialize8((uint8_t)v);
+}
+
+static void crsfSerialize24(uint32_t v)
+{
+    crsfSerialize8(v >> 16);
+    crsfSerialize16((uint16_t)v);
+}
+
+static void crsfSerialize32(uint32_t v)
+{
+    crsfSerialize16(v >> 16);
+    crsfSerialize16((uint16_t)v);
+}
+
+static void crsfFinalizeFrame(void)
+{
+    crsfFrame[1] = crsfFramePosition - CRSF_FRAME_LENGTH_ADDRESS - CRSF_FRAME_LENGTH_FRAMELENGTH + 1; // Including the CRC
+    crsfSerialize8(crc8DvbS2Update(0, &crsfFrame[2], crsfFramePosition - 2));
+
+    crsfRxWriteTelemetryData(crsfFrame, crsfFramePosition);
+}
+
+/*
+ * Voltage (dV), current (dA), capacity drawn (mAh, u24) and battery remaining (%).
+ */
+static void crsfFrameBatterySensor(void)
+{
+    crsfInitializeFrame(CRSF_FRAMETYPE_BATTERY_SENSOR);
+    crsfSerialize16(telemetryData.vbat);
+    crsfSerialize16(constrain(telemetryData.amperage / 10, 0, UINT16_MAX));
+    crsfSerialize24(constrain(telemetryData.mAhDrawn, 0, 0xFFFFFF));
+    crsfSerialize8(telemetryData.batteryRemainingPercentage);
+    crsfFinalizeFrame();
+}
+
+// Yaw is 0..3600, which is wrapped to -1800..1800 so that the result fits in 16 bits
+static int16_t decidegreesToRadians10000(int16_t angle)
+{
+    if (angle > 1800) {
+        angle -= 3600;
+    }
+    return (int16_t)(1000.0f * angle * RAD);
+}
+
+/*
+ * Pitch, roll and yaw in radians * 10000.
+ */
+static void crsfFrameAttitude(void)
+{
+    crsfInitializeFrame(CRSF_FRAMETYPE_ATTITUDE);
+    crsfSerialize16(decidegreesToRadians10000(telemetryData.pitch));
+    crsfSerialize16(decidegreesToRadians10000(telemetryData.roll));
+    crsfSerialize16(decidegreesToRadians10000(telemetryData.yaw));
+    crsfFinalizeFrame();
+}
+
+#ifdef GPS
+/*
+ * Latitude and longitude (degrees * 10^7), ground speed (km/h * 10), ground course (degrees * 100),
+ * altitude (m + 1000) and number of satellites.
+ */
+static void crsfFrameGps(void)
+{
+    crsfInitializeFrame(CRSF_FRAMETYPE_GPS);
+    crsfSerialize32(telemetryData.gpsCoord[LAT]);
+    crsfSerialize32(telemetryData.gpsCoord[LON]);
+    crsfSerialize16((telemetryData.gpsSpeed * 36 + 50) / 100); // cm/s to km/h * 10
+    crsfSerialize16(telemetryData.gpsGroundCourse * 10);
+    crsfSerialize16(telemetryData.gpsAltitude + 1000);
+    crsfSerialize8(telemetryData.gpsNumSat);
+    crsfFinalizeFrame();
+}
+#endif
+
+void initCrsfTelemetry(telemetryConfig_t *initialTelemetryConfig)
+{
+    UNUSED(initialTelemetryConfig);
+
+    telemetrySlotsInit(&crsfTelemetryScheduler, crsfTelemetrySlots, CRSF_TELEMETRY_FRAME_COUNT,
+        CRSF_FRAME_SIZE_MAX, CRSF_TELEMETRY_MAX_MICROS_PER_CALL);
+
+    crsfTelemetrySlots[CRSF_TELEMETRY_BATTERY].available = true;
+    crsfTelemetrySlots[CRSF_TELEMETRY_ATTITUDE].available = true;
+}
+
+void checkCrsfTelemetryState(void)
+{
+    // Telemetry goes out through the RX driver, so it's available whenever a Crossfire receiver is
+    crsfTelemetryEnabled = crsfRxIsActive();
+}
+
+void handleCrsfTelemetry(void)
+{
+    if (!crsfTelemetryEnabled || !crsfRxIsTelemetryBufEmpty()) {
+        return;
+    }
+
+#ifdef GPS
+    crsfTelemetrySlots[CRSF_TELEMETRY_GPS].available = sensors(SENSOR_GPS);
+#endif
+
+    telemetrySlotsBeginCall(&crsfTelemetryScheduler, telemetryData.capturedAt, CRSF_FRAME_SIZE_MAX);
+
+    // The RX driver takes one frame at a time
+    const int slot = telemetrySlotsNext(&crsfTelemetryScheduler);
+
+    switch (slot) {
+    case CRSF_TELEMETRY_BATTERY:
+        crsfFrameBatterySensor();
+        break;
+    case CRSF_TELEMETRY_ATTITUDE:
+        crsfFrameAttitude();
+        break;
+#ifdef GPS
+    case CRSF_TELEMETRY_GPS:
+        crsfFrameGps();
+        break;
+#endif
+    default:
+        return;
+    }
+
+    telemetrySlotsSent(&crsfTelemetryScheduler, slot);
+}
+
+#endif
@@ -62,6 +62,7 @@
 #include "config/config.h"
 
 #include "telemetry/telemetry.h"
+#include "telemetry/telemetry_slots.h"
 #include "telemetry/frsky.h"
 
 static serialPort_t *frskyPort = NULL;
@@ -77,10 +78,6 @@ static portSharing_e frskyPortSharing;
 
 extern batteryConfig_t *batteryConfig;
 
-extern int16_t telemTemperature1; // FIXME dependency on mw.c
-
-#define CYCLETIME             125
-
 #define PROTOCOL_HEADER       0x5E
 #define PROTOCOL_TAIL         0x5E
 
@@ -133,8 +130,53 @@ extern int16_t telemTemperature1; // FIXME dependency on mw.c
 #define DELAY_FOR_BARO_INITIALISATION (5 * 1000) //5s
 #define BLADE_NUMBER_DIVIDER  5 // should set 12 blades in Taranis
 
-static uint32_t lastCycleTime = 0;
-static uint8_t cycleNum = 0;
+// Each value is a header, an ID and two bytes, which may all need stuffing but the header
+#define FRSKY_VALUE_SIZE_MAX  6
+#define FRSKY_TAIL_SIZE       1
+
+// Spreads what's due at once over several calls instead of filling the TX buffer in one go
+#define FRSKY_MAX_BYTES_PER_CALL    64
+#define FRSKY_MAX_MICROS_PER_CALL   300
+
+typedef enum {
+    FRSKY_SLOT_ACCEL = 0,
+    FRSKY_SLOT_VARIO,
+    FRSKY_SLOT_BARO,
+    FRSKY_SLOT_HEADING,
+    FRSKY_SLOT_TEMPERATURE1,
+    FRSKY_SLOT_RPM,
+    FRSKY_SLOT_VOLTAGE,
+    FRSKY_SLOT_VOLTAGE_AMP,
+    FRSKY_SLOT_AMPERAGE,
+    FRSKY_SLOT_FUEL,
+    FRSKY_SLOT_GPS_SPEED,
+    FRSKY_SLOT_GPS_ALTITUDE,
+    FRSKY_SLOT_SATELLITES,
+    FRSKY_SLOT_LAT_LONG,
+    FRSKY_SLOT_TEXT,
+    FRSKY_SLOT_TIME,
+    FRSKY_SLOT_COUNT
+} frskySlot_e;
+
+static telemetrySlot_t frskySlots[FRSKY_SLOT_COUNT] = {
+    [FRSKY_SLOT_ACCEL]          = { .intervalMs = 125,  .priority = 3, .maxBytes = 3 * FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_VARIO]          = { .intervalMs = 125,  .priority = 3, .maxBytes = FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_BARO]           = { .intervalMs = 500,  .priority = 2, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_HEADING]        = { .intervalMs = 500,  .priority = 2, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_TEMPERATURE1]   = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_RPM]            = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_VOLTAGE]        = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_VOLTAGE_AMP]    = { .intervalMs = 1000, .priority = 1, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_AMPERAGE]       = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_FUEL]           = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_GPS_SPEED]      = { .intervalMs = 1000, .priority = 1, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_GPS_ALTITUDE]   = { .intervalMs = 1000, .priority = 1, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_SATELLITES]     = { .intervalMs = 1000, .priority = 1, .maxBytes = FRSKY_VALUE_SIZE_MAX },
+    [FRSKY_SLOT_LAT_LONG]       = { .intervalMs = 1000, .priority = 1, .maxBytes = 6 * FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_TEXT]           = { .intervalMs = 125,  .priority = 1, .maxBytes = 5 * FRSKY_VALUE_SIZE_MAX, .available = true },
+    [FRSKY_SLOT_TIME]           = { .intervalMs = 5000, .priority = 1, .maxBytes = 2 * FRSKY_VALUE_SIZE_MAX, .available = true },
+};
+static telemetrySlotScheduler_t frskyScheduler;
 static void sendDataHead(uint8_t id)
 {
     serialWrite(frskyPort, PROTOCOL_HEADER);
@@ -174,24 +216,24 @@ static void sendAccel(void)
 
     for (i = 0; i < 3; i++) {
         sendDataHead(ID_ACC_X + i);
-        serialize16(((float)accSmooth[i] / acc.acc_1G) * 1000);
+        serialize16(((float)telemetryData.acc[i] / telemetryData.acc1G) * 1000);
     }
 }
 
 static void sendBaro(void)
 {
     sendDataHead(ID_ALTITUDE_BP);
-    serialize16(BaroAlt / 100);
+    serialize16(telemetryData.baroAltitude / 100);
     sendDataHead(ID_ALTITUDE_AP);
-    serialize16(ABS(BaroAlt % 100));
+    serialize16(ABS(telemetryData.baroAltitude % 100));
 }
 
 #ifdef GPS
 static void sendGpsAltitude(void)
 {
-    uint16_t altitude = GPS_altitude;
+    uint16_t altitude = telemetryData.gpsAltitude;
     //Send real GPS altitude only if it's reliable (there's a GPS fix)
-    if (!STATE(GPS_FIX)) {
+    if (!telemetryData.gpsFix) {
         altitude = 0;
     }
     sendDataHead(ID_GPS_ALTIDUTE_BP);
@@ -201,13 +243,12 @@ static void sendGpsAltitude(void)
 }
 #endif
 
-static void sendThrottleOrBatterySizeAsRpm(rxConfig_t *rxConfig, uint16_t deadband3d_throttle)
+static void sendThrottleOrBatterySizeAsRpm(void)
 {
-    uint16_t throttleForRPM = rcCommand[THROTTLE] / BLADE_NUMBER_DIVIDER;
+    uint16_t throttleForRPM = telemetryData.throttle / BLADE_NUMBER_DIVIDER;
     sendDataHead(ID_RPM);
     if (ARMING_FLAG(ARMED)) {
-        throttleStatus_e throttleStatus = calculateThrottleStatus(rxConfig, deadband3d_throttle);
-        if (throttleStatus == THROTTLE_LOW && feature(FEATURE_MOTOR_STOP))
+        if (telemetryData.throttleStatus == THROTTLE_LOW && feature(FEATURE_MOTOR_STOP))
                     throttleForRPM = 0;
         serialize16(throttleForRPM);
     } else {
@@ -219,19 +260,19 @@ static void sendThrottleOrBatterySizeAsRpm(rxConfig_t *rxConfig, uint16_t deadba
 static void sendTemperature1(void)
 {
     sendDataHead(ID_TEMPRATURE1);
-#ifdef BARO
-    serialize16((baroTemperature + 50)/ 100); //Airmamaf
-#else
-    serialize16(telemTemperature1 / 10);
-#endif
+    serialize16((telemetryData.temperature + 50)/ 100); //Airmamaf
 }
 
 #ifdef GPS
 static void sendSatalliteSignalQualityAsTemperature2(void)
 {
-    uint16_t satellite = GPS_numSat;
-    if (GPS_hdop > GPS_BAD_QUALITY && ( (cycleNum % 16 ) < 8)) {//Every 1s
-        satellite = constrain(GPS_hdop, 0, GPS_MAX_HDOP_VAL);
+    static bool sendHdop = false;
+
+    // With a poor signal, every other time
+    uint16_t satellite = telemetryData.gpsNumSat;
+    sendHdop = !sendHdop;
+    if (telemetryData.gpsHdop > GPS_BAD_QUALITY && sendHdop) {
+        satellite = constrain(telemetryData.gpsHdop, 0, GPS_MAX_HDOP_VAL);
     }
     sendDataHead(ID_TEMPRATURE2);
 
@@ -247,21 +288,18 @@ static void sendSatalliteSignalQualityAsTemperature2(void)
 
 static void sendSpeed(void)
 {
-    if (!STATE(GPS_FIX)) {
-        return;
-    }
     //Speed should be sent in knots (GPS speed is in cm/s)
     sendDataHead(ID_GPS_SPEED_BP);
     //convert to knots: 1cm/s = 0.0194384449 knots
-    serialize16(GPS_speed * 1944 / 100000);
+    serialize16(telemetryData.gpsSpeed * 1944 / 100000);
     sendDataHead(ID_GPS_SPEED_AP);
-    serialize16((GPS_speed * 1944 / 100) % 100);
+    serialize16((telemetryData.gpsSpeed * 1944 / 100) % 100);
 }
 #endif
 
 static void sendTime(void)
 {
-    uint32_t seconds = millis() / 1000;
+    uint32_t seconds = telemetryData.capturedAt / 1000;
     uint8_t minutes = (seconds / 60) % 60;
 
     // if we fly for more than an hour, something's wrong anyway
@@ -337,10 +375,10 @@ static void sendGPSLatLong(void)
 {
     static uint8_t gpsFixOccured = 0;
 
-    if (STATE(GPS_FIX) || gpsFixOccured == 1) {
+    if (telemetryData.gpsFix || gpsFixOccured == 1) {
         // If we have ever had a fix, send the last known lat/long
         gpsFixOccured = 1;
-        sendLatLong(GPS_coord);
+        sendLatLong(telemetryData.gpsCoord);
     } else {
         // otherwise send fake lat/long in order to display compass value
         sendFakeLatLong();
@@ -355,7 +393,7 @@ static void sendGPSLatLong(void)
 static void sendVario(void)
 {
     sendDataHead(ID_VERT_SPEED);
-    serialize16(vario);
+    serialize16(telemetryData.vario);
 }
 
 /*
@@ -381,7 +419,7 @@ static void sendVoltage(void)
      * The actual value sent for cell voltage has resolution of 0.002 volts
      * Since vbat has resolution of 0.1 volts it has to be multiplied by 50
      */
-    cellVoltage = ((uint32_t)vbat * 100 + batteryCellCount) / (batteryCellCount * 2);
+    cellVoltage = ((uint32_t)telemetryData.vbat * 100 + telemetryData.batteryCellCount) / (telemetryData.batteryCellCount * 2);
 
     // Cell number is at bit 9-12
     payload = (currentCell << 4);
@@ -396,7 +434,7 @@ static void sendVoltage(void)
     serialize16(payload);
 
     currentCell++;
-    currentCell %= batteryCellCount;
+    currentCell %= telemetryData.batteryCellCount;
 }
 
 /*
@@ -409,12 +447,12 @@ static void sendVoltageAmp(void)
          * Use new ID 0x39 to send voltage directly in 0.1 volts resolution
          */
         sendDataHead(ID_VOLTAGE_AMP);
-        serialize16(vbat);
+        serialize16(telemetryData.vbat);
     } else {
-        uint16_t voltage = (vbat * 110) / 21;
+        uint16_t voltage = (telemetryData.vbat * 110) / 21;
         uint16_t vfasVoltage;
         if (telemetryConfig->frsky_vfas_cell_voltage) {
-            vfasVoltage = voltage / batteryCellCount;
+            vfasVoltage = voltage / telemetryData.batteryCellCount;
         } else {
             vfasVoltage = voltage;
         }
@@ -428,7 +466,7 @@ static void sendVoltageAmp(void)
 static void sendAmperage(void)
 {
     sendDataHead(ID_CURRENT);
-    serialize16((uint16_t)(amperage / 10));
+    serialize16((uint16_t)(telemetryData.amperage / 10));
 }
 
 static void sendFuelLevel(void)
@@ -436,16 +474,16 @@ static void sendFuelLevel(void)
     sendDataHead(ID_FUEL_LEVEL);
 
     if (batteryConfig->batteryCapacity > 0) {
-        serialize16((uint16_t)calculateBatteryCapacityRemainingPercentage());
+        serialize16((uint16_t)telemetryData.batteryRemainingPercentage);
     } else {
-        serialize16((uint16_t)constrain(mAhDrawn, 0, 0xFFFF));
+        serialize16((uint16_t)constrain(telemetryData.mAhDrawn, 0, 0xFFFF));
     }
 }
 
 static void sendHeading(void)
 {
     sendDataHead(ID_COURSE_BP);
-    serialize16(DECIDEGREES_TO_DEGREES(attitude.values.yaw));
+    serialize16(DECIDEGREES_TO_DEGREES(telemetryData.yaw));
     sendDataHead(ID_COURSE_AP);
     serialize16(0);
 }
@@ -453,6 +491,7 @@ static void sendHeading(void)
 void initFrSkyTelemetry(telemetryConfig_t *initialTelemetryConfig)
 {
     telemetryConfig = initialTelemetryConfig;
+    telemetrySlotsInit(&frskyScheduler, frskySlots, FRSKY_SLOT_COUNT, FRSKY_MAX_BYTES_PER_CALL, FRSKY_MAX_MICROS_PER_CALL);
     portConfig = findSerialPortConfig(FUNCTION_TELEMETRY_FRSKY);
     frskyPortSharing = determinePortSharing(portConfig, FUNCTION_TELEMETRY_FRSKY);
 }
@@ -478,11 +517,6 @@ void configureFrSkyTelemetryPort(void)
     frskyTelemetryEnabled = true;
 }
 
-bool hasEnoughTimeLapsedSinceLastTelemetryTransmission(uint32_t currentMillis)
-{
-    return currentMillis - lastCycleTime >= CYCLETIME;
-}
-
 void checkFrSkyTelemetryState(void)
 {
     if (portConfig && telemetryCheckRxPortShared(portConfig)) {
@@ -558,95 +592,146 @@ static void clearTelemetryText(void)
   */
 }
 
-void handleFrSkyTelemetry(rxConfig_t *rxConfig, uint16_t deadband3d_throttle)
-{
-    if (!frskyTelemetryEnabled) {
-        return;
-    }
-
-    uint32_t now = millis();
-
-    if (!hasEnoughTimeLapsedSinceLastTelemetryTransmission(now)) {
-        return;
-    }
+/* Telemetry text stream
 
-    lastCycleTime = now;
+Sent after everything else that's due (if there is a buffer
+overrun the text is disposable)
 
-    cycleNum++;
+Sends all chars from a small FIFO every transmission cycle.
 
-    // Sent every 125ms
-    sendAccel();
-    sendVario();
-    sendTelemetryTail();
+FIFO is (could be) filled up elsewhere by high priority text.
+If FIFO is not fully filled then spare place is filled up
+by the text from buffer. This way the display is gradually
+refreshed.
 
-    if ((cycleNum % 4) == 0) {      // Sent every 500ms
-        if (lastCycleTime > DELAY_FOR_BARO_INITIALISATION) { //Allow 5s to boot correctly
-            sendBaro();
-        }
-        sendHeading();
-        sendTelemetryTail();
-    }
+Note: the speed of text link is 5 chars per transmittion.
+Approximately 40 chars a second at maximum.
 
-    if ((cycleNum % 8) == 0) {      // Sent every 1s
-        sendTemperature1();
-        sendThrottleOrBatterySizeAsRpm(rxConfig, deadband3d_throttle);
+*/
+static void sendTelemetryText(void)
+{
+    // temporary hack - create text here (should be moved elsewhere shared by all users of status line)
+    composeStatus(statusLine,sizeof(statusLine));
 
-        if (feature(FEATURE_VBAT)) {
-            sendVoltage();
-            sendVoltageAmp();
-            sendAmperage();
-            sendFuelLevel();
-        }
+    fillUpTelemetryTextTransmitBuffer(statusLine,sizeof(statusLine));
+    sendTelemetryTextTransmitBuffer();
+}
 
+static void sendPosition(void)
+{
 #ifdef GPS
-        if (sensors(SENSOR_GPS)) {
-            sendSpeed();
-            sendGpsAltitude();
-            sendSatalliteSignalQualityAsTemperature2();
-            sendGPSLatLong();
-        }
-        else {
-            sendFakeLatLongThatAllowsHeadingDisplay();
-        }
-#else
-        sendFakeLatLongThatAllowsHeadingDisplay();
+    if (sensors(SENSOR_GPS)) {
+        sendGPSLatLong();
+        return;
+    }
 #endif
+    sendFakeLatLongThatAllowsHeadingDisplay();
+}
 
-        sendTelemetryTail();
-    } else {
-
-    /* Telemetry text stream
-
-    Added to the HUB stream as last item (if there is a buffer
-    overrun the text is disposable)
+static void updateSlotAvailability(void)
+{
+    const bool vbatEnabled = feature(FEATURE_VBAT);
 
-    Sends all chars from a small FIFO every transmission cycle.
+    frskySlots[FRSKY_SLOT_BARO].available = telemetryData.capturedAt > DELAY_FOR_BARO_INITIALISATION; //Allow 5s to boot correctly
+    frskySlots[FRSKY_SLOT_VOLTAGE].available = vbatEnabled;
+    frskySlots[FRSKY_SLOT_VOLTAGE_AMP].available = vbatEnabled;
+    frskySlots[FRSKY_SLOT_AMPERAGE].available = vbatEnabled;
+    frskySlots[FRSKY_SLOT_FUEL].available = vbatEnabled;
 
-    FIFO is (could be) filled up elsewhere by high priority text.
-    If FIFO is not fully filled then spare place is filled up
-    by the text from buffer. This way the display is gradually
-    refreshed.
+#ifdef GPS
+    const bool gpsPresent = sensors(SENSOR_GPS);
 
-    Note: the speed of text link is 5 chars per transmittion.
-    Approximately 40 chars a second at maximum.
+    frskySlots[FRSKY_SLOT_GPS_SPEED].available = gpsPresent && telemetryData.gpsFix;
+    frskySlots[FRSKY_SLOT_GPS_ALTITUDE].available = gpsPresent;
+    frskySlots[FRSKY_SLOT_SATELLITES].available = gpsPresent;
+#endif
+}
 
-    Telemetry text stream is not beeing send when long 1/1s message
-    has already been composed and put into queue
+static void sendSlot(frskySlot_e slot)
+{
+    switch (slot) {
+    case FRSKY_SLOT_ACCEL:
+        sendAccel();
+        break;
+    case FRSKY_SLOT_VARIO:
+        sendVario();
+        break;
+    case FRSKY_SLOT_BARO:
+        sendBaro();
+        break;
+    case FRSKY_SLOT_HEADING:
+        sendHeading();
+        break;
+    case FRSKY_SLOT_TEMPERATURE1:
+        sendTemperature1();
+        break;
+    case FRSKY_SLOT_RPM:
+        sendThrottleOrBatterySizeAsRpm();
+        break;
+    case FRSKY_SLOT_VOLTAGE:
+        sendVoltage();
+        break;
+    case FRSKY_SLOT_VOLTAGE_AMP:
+        sendVoltageAmp();
+        break;
+    case FRSKY_SLOT_AMPERAGE:
+        sendAmperage();
+        break;
+    case FRSKY_SLOT_FUEL:
+        sendFuelLevel();
+        break;
+#ifdef GPS
+    case FRSKY_SLOT_GPS_SPEED:
+        sendSpeed();
+        break;
+    case FRSKY_SLOT_GPS_ALTITUDE:
+        sendGpsAltitude();
+        break;
+    case FRSKY_SLOT_SATELLITES:
+        sendSatalliteSignalQualityAsTemperature2();
+        break;
+#endif
+    case FRSKY_SLOT_LAT_LONG:
+        sendPosition();
+        break;
+    case FRSKY_SLOT_TEXT:
+        sendTelemetryText();
+        break;
+    case FRSKY_SLOT_TIME:
+        sendTime();
+        break;
+    default:
+        break;
+    }
+}
 
-    */
+/*
+ * Acceleration and vario go out every 125ms, baro and heading every 500ms, the rest every 1s and the time every 5s.
+ * Whatever is due is spread over as many calls as it takes to fit.
+ */
+void handleFrSkyTelemetry(void)
+{
+    if (!frskyTelemetryEnabled) {
+        return;
+    }
 
-    // temporary hack - create text here (should be moved elsewhere shared by all users of status line)
-    composeStatus(statusLine,sizeof(statusLine));
+    const uint8_t bytesFree = serialTxBytesFree(frskyPort);
+    if (bytesFree <= FRSKY_TAIL_SIZE) {
+        return;
+    }
 
-    fillUpTelemetryTextTransmitBuffer(statusLine,sizeof(statusLine));
-    sendTelemetryTextTransmitBuffer();
+    updateSlotAvailability();
+    telemetrySlotsBeginCall(&frskyScheduler, telemetryData.capturedAt, bytesFree - FRSKY_TAIL_SIZE);
 
-    sendTelemetryTail();
+    bool sent = false;
+    int slot;
+    while ((slot = telemetrySlotsNext(&frskyScheduler)) != TELEMETRY_SLOT_NONE) {
+        sendSlot(slot);
+        telemetrySlotsSent(&frskyScheduler, slot);
+        sent = true;
     }
 
-    if (cycleNum == 40) {     //Frame 3: Sent every 5s
-        cycleNum = 0;
-        sendTime();
+    if (sent) {
         sendTelemetryTail();
     }
 }
@@ -75,6 +75,7 @@
 #include "flight/navigation.h"
 
 #include "telemetry/telemetry.h"
+#include "telemetry/telemetry_slots.h"
 #include "telemetry/ltm.h"
 
 #include "config/config.h"
@@ -82,9 +83,28 @@
 
 
 #define TELEMETRY_LTM_INITIAL_PORT_MODE MODE_TX
-#define LTM_CYCLETIME   100
 
-extern uint16_t rssi;           // FIXME dependency on mw.c
+// About a quarter of a second at 2400 baud
+#define LTM_MAX_BYTES_PER_CALL      64
+#define LTM_MAX_MICROS_PER_CALL     200
+
+typedef enum {
+    LTM_FRAME_A = 0,
+    LTM_FRAME_S,
+    LTM_FRAME_G,
+    LTM_FRAME_O,
+    LTM_FRAME_COUNT
+} ltmFrame_e;
+
+// Sizes include the header and checksum
+static telemetrySlot_t ltmSlots[LTM_FRAME_COUNT] = {
+    [LTM_FRAME_A] = { .intervalMs = 100, .priority = 3, .maxBytes = 10, .available = true },
+    [LTM_FRAME_S] = { .intervalMs = 200, .priority = 2, .maxBytes = 11, .available = true },
+    [LTM_FRAME_G] = { .intervalMs = 200, .priority = 2, .maxBytes = 18 },
+    [LTM_FRAME_O] = { .intervalMs = 1000, .priority = 1, .maxBytes = 18, .available = true },
+};
+static telemetrySlotScheduler_t ltmScheduler;
+
 static serialPort_t *ltmPort;
 static serialPortConfig_t *portConfig;
 static telemetryConfig_t *telemetryConfig;
@@ -135,28 +155,24 @@ static void ltm_gframe(void)
     uint8_t gps_fix_type = 0;
     int32_t ltm_alt;
 
-    if (!sensors(SENSOR_GPS))
-        return;
-
-    if (!STATE(GPS_FIX))
+    if (!telemetryData.gpsFix)
         gps_fix_type = 1;
-    else if (GPS_numSat < 5)
+    else if (telemetryData.gpsNumSat < 5)
         gps_fix_type = 2;
     else
         gps_fix_type = 3;
 
     ltm_initialise_packet('G');
-    ltm_serialise_32(GPS_coord[LAT]);
-    ltm_serialise_32(GPS_coord[LON]);
-    ltm_serialise_8((uint8_t)(GPS_speed / 100));
-
-#if defined(BARO) || defined(SONAR)
-    ltm_alt = (sensors(SENSOR_SONAR) || sensors(SENSOR_BARO)) ? altitudeHoldGetEstimatedAltitude() : GPS_altitude * 100;
-#else
-    ltm_alt = GPS_altitude * 100;
-#endif
+    ltm_serialise_32(telemetryData.gpsCoord[LAT]);
+    ltm_serialise_32(telemetryData.gpsCoord[LON]);
+    ltm_serialise_8((uint8_t)(telemetryData.gpsSpeed / 100));
+
+    if (sensors(SENSOR_SONAR) || sensors(SENSOR_BARO))
+        ltm_alt = telemetryData.estimatedAltitude;
+    else
+        ltm_alt = telemetryData.gpsAltitude * 100;
     ltm_serialise_32(ltm_alt);
-    ltm_serialise_8((GPS_numSat << 2) | gps_fix_type);
+    ltm_serialise_8((telemetryData.gpsNumSat << 2) | gps_fix_type);
     ltm_finalise();
 #endif
 }
@@ -197,9 +213,9 @@ static void ltm_sframe(void)
     if (failsafeIsActive())
         lt_statemode |= 2;
     ltm_initialise_packet('S');
-    ltm_serialise_16(vbat * 100);    //vbat converted to mv
+    ltm_serialise_16(telemetryData.vbat * 100);    //vbat converted to mv
     ltm_serialise_16(0);             //  current, not implemented
-    ltm_serialise_8((uint8_t)((rssi * 254) / 1023));        // scaled RSSI (uchar)
+    ltm_serialise_8((uint8_t)((telemetryData.rssi * 254) / 1023));        // scaled RSSI (uchar)
     ltm_serialise_8(0);              // no airspeed
     ltm_serialise_8((lt_flightmode << 2) | lt_statemode);
     ltm_finalise();
@@ -212,9 +228,9 @@ static void ltm_sframe(void)
 static void ltm_aframe()
 {
     ltm_initialise_packet('A');
-    ltm_serialise_16(DECIDEGREES_TO_DEGREES(attitude.values.pitch));
-    ltm_serialise_16(DECIDEGREES_TO_DEGREES(attitude.values.roll));
-    ltm_serialise_16(DECIDEGREES_TO_DEGREES(attitude.values.yaw));
+    ltm_serialise_16(DECIDEGREES_TO_DEGREES(telemetryData.pitch));
+    ltm_serialise_16(DECIDEGREES_TO_DEGREES(telemetryData.roll));
+    ltm_serialise_16(DECIDEGREES_TO_DEGREES(telemetryData.yaw));
     ltm_finalise();
 }
 
@@ -226,45 +242,48 @@ static void ltm_aframe()
 static void ltm_oframe()
 {
     ltm_initialise_packet('O');
-#if defined(GPS)
-    ltm_serialise_32(GPS_home[LAT]);
-    ltm_serialise_32(GPS_home[LON]);
-#else
-    ltm_serialise_32(0);
-    ltm_serialise_32(0);
-#endif
+    ltm_serialise_32(telemetryData.gpsHome[LAT]);
+    ltm_serialise_32(telemetryData.gpsHome[LON]);
     ltm_serialise_32(0);                // Don't have GPS home altitude
     ltm_serialise_8(1);                 // OSD always ON
-    ltm_serialise_8(STATE(GPS_FIX_HOME) ? 1 : 0);
+    ltm_serialise_8(telemetryData.gpsFixHome ? 1 : 0);
     ltm_finalise();
 }
 
-static void process_ltm(void)
-{
-    static uint8_t ltm_scheduler;
-    ltm_aframe();
-    if (ltm_scheduler & 1)
-        ltm_gframe();
-    else
-        ltm_sframe();
-    if (ltm_scheduler == 0)
-        ltm_oframe();
-    ltm_scheduler++;
-    ltm_scheduler %= 10;
-}
-
+/*
+ * A frames go out at 10Hz, S and G frames at 5Hz and O frames at 1Hz, as far as the port keeps up. When it doesn't,
+ * the frames left waiting longest go first so that none of them stops being sent.
+ */
 void handleLtmTelemetry(void)
 {
-    static uint32_t ltm_lastCycleTime;
-    uint32_t now;
     if (!ltmEnabled)
         return;
     if (!ltmPort)
         return;
-    now = millis();
-    if ((now - ltm_lastCycleTime) >= LTM_CYCLETIME) {
-        process_ltm();
-        ltm_lastCycleTime = now;
+
+#if defined(GPS)
+    ltmSlots[LTM_FRAME_G].available = sensors(SENSOR_GPS);
+#endif
+
+    telemetrySlotsBeginCall(&ltmScheduler, telemetryData.capturedAt, serialTxBytesFree(ltmPort));
+
+    int slot;
+    while ((slot = telemetrySlotsNext(&ltmScheduler)) != TELEMETRY_SLOT_NONE) {
+        switch (slot) {
+        case LTM_FRAME_A:
+            ltm_aframe();
+            break;
+        case LTM_FRAME_S:
+            ltm_sframe();
+            break;
+        case LTM_FRAME_G:
+            ltm_gframe();
+            break;
+        case LTM_FRAME_O:
+            ltm_oframe();
+            break;
+        }
+        telemetrySlotsSent(&ltmScheduler, slot);
     }
 }
 
@@ -278,6 +297,7 @@ void freeLtmTelemetryPort(void)
 void initLtmTelemetry(telemetryConfig_t *initialTelemetryConfig)
 {
     telemetryConfig = initialTelemetryConfig;
+    telemetrySlotsInit(&ltmScheduler, ltmSlots, LTM_FRAME_COUNT, LTM_MAX_BYTES_PER_CALL, LTM_MAX_MICROS_PER_CALL);
     portConfig = findSerialPortConfig(FUNCTION_TELEMETRY_LTM);
     ltmPortSharing = determinePortSharing(portConfig, FUNCTION_TELEMETRY_LTM);
 }
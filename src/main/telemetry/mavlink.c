@@ -0,0 +1,461 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MAVLink v2 telemetry, for ground stations and companion computers.
+ *
+ * Only what's needed to send a handful of common.xml messages is here, without the generated MAVLink headers. Messages
+ * are grouped like MAVLink's data streams, each group sent at its own rate: attitude fast, the HUD a little slower,
+ * and status and position slowest. As MAVLink v2 allows, zeros at the end of a payload are left off.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifdef TELEMETRY
+
+#include "build/build_config.h"
+
+#include "common/axis.h"
+#include "common/crc.h"
+#include "common/maths.h"
+
+#include "drivers/system.h"
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/serial.h"
+
+#include "fc/runtime_config.h"
+
+#include "io/gps.h"
+#include "io/serial.h"
+
+#include "rx/rx.h"
+
+#include "scheduler/scheduler.h"
+
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+
+#include "flight/imu.h"
+
+#include "config/config.h"
+
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry_slots.h"
+#include "telemetry/mavlink.h"
+
+#define TELEMETRY_MAVLINK_INITIAL_PORT_MODE MODE_TX
+
+#define MAVLINK_STX_V2                  0xFD
+#define MAVLINK_HEADER_LENGTH           10  // STX, length, flags, sequence, system, component and a 24 bit message ID
+#define MAVLINK_CHECKSUM_LENGTH         2
+#define MAVLINK_PAYLOAD_LENGTH_MAX      31  // The longest message sent here
+
+#define MAVLINK_FRAME_LENGTH(payloadLength) (MAVLINK_HEADER_LENGTH + (payloadLength) + MAVLINK_CHECKSUM_LENGTH)
+
+#define MAVLINK_SYSTEM_ID               1
+#define MAVLINK_COMPONENT_ID            1   // MAV_COMP_ID_AUTOPILOT1
+#define MAVLINK_VERSION                 3
+
+#define MAVLINK_MAX_BYTES_PER_CALL      128
+#define MAVLINK_MAX_MICROS_PER_CALL     300
+
+// Message IDs, payload lengths and CRC_EXTRA from common.xml
+#define MAVLINK_MSG_ID_HEARTBEAT                0
+#define MAVLINK_MSG_HEARTBEAT_LENGTH            9
+#define MAVLINK_MSG_HEARTBEAT_CRC               50
+#define MAVLINK_MSG_ID_SYS_STATUS               1
+#define MAVLINK_MSG_SYS_STATUS_LENGTH           31
+#define MAVLINK_MSG_SYS_STATUS_CRC              124
+#define MAVLINK_MSG_ID_GPS_RAW_INT              24
+#define MAVLINK_MSG_GPS_RAW_INT_LENGTH          30
+#define MAVLINK_MSG_GPS_RAW_INT_CRC             24
+#define MAVLINK_MSG_ID_ATTITUDE                 30
+#define MAVLINK_MSG_ATTITUDE_LENGTH             28
+#define MAVLINK_MSG_ATTITUDE_CRC                39
+#define MAVLINK_MSG_ID_GLOBAL_POSITION_INT      33
+#define MAVLINK_MSG_GLOBAL_POSITION_INT_LENGTH  28
+#define MAVLINK_MSG_GLOBAL_POSITION_INT_CRC     104
+#define MAVLINK_MSG_ID_VFR_HUD                  74
+#define MAVLINK_MSG_VFR_HUD_LENGTH              20
+#define MAVLINK_MSG_VFR_HUD_CRC                 20
+
+// Values from common.xml enums
+#define MAV_TYPE_FIXED_WING                     1
+#define MAV_TYPE_QUADROTOR                      2
+#define MAV_AUTOPILOT_GENERIC                   0
+#define MAV_MODE_FLAG_CUSTOM_MODE_ENABLED       (1 << 0)
+#define MAV_MODE_FLAG_STABILIZE_ENABLED         (1 << 4)
+#define MAV_MODE_FLAG_MANUAL_INPUT_ENABLED      (1 << 6)
+#define MAV_MODE_FLAG_SAFETY_ARMED              (1 << 7)
+#define MAV_STATE_STANDBY                       3
+#define MAV_STATE_ACTIVE                        4
+#define MAV_SYS_STATUS_SENSOR_3D_GYRO           (1 << 0)
+#define MAV_SYS_STATUS_SENSOR_3D_ACCEL          (1 << 1)
+#define MAV_SYS_STATUS_SENSOR_3D_MAG            (1 << 2)
+#define MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE (1 << 3)
+#define MAV_SYS_STATUS_SENSOR_GPS               (1 << 5)
+#define GPS_FIX_TYPE_NO_FIX                     1
+#define GPS_FIX_TYPE_2D_FIX                     2
+#define GPS_FIX_TYPE_3D_FIX                     3
+
+// Rates of the groups of messages, like MAVLink's data streams
+#define MAVLINK_EXTRA1_INTERVAL_MS              100     // Attitude
+#define MAVLINK_EXTRA2_INTERVAL_MS              200     // HUD
+#define MAVLINK_EXTENDED_STATUS_INTERVAL_MS     500     // Battery and sensors
+#define MAVLINK_POSITION_INTERVAL_MS            500     // GPS
+#define MAVLINK_HEARTBEAT_INTERVAL_MS           1000
+
+typedef enum {
+    MAVLINK_SLOT_HEARTBEAT = 0,
+    MAVLINK_SLOT_SYS_STATUS,
+    MAVLINK_SLOT_ATTITUDE,
+    MAVLINK_SLOT_VFR_HUD,
+    MAVLINK_SLOT_GPS_RAW_INT,
+    MAVLINK_SLOT_GLOBAL_POSITION_INT,
+    MAVLINK_SLOT_COUNT
+} mavlinkSlot_e;
+
+static telemetrySlot_t mavlinkSlots[MAVLINK_SLOT_COUNT] = {
+    [MAVLINK_SLOT_HEARTBEAT]            = { .intervalMs = MAVLINK_HEARTBEAT_INTERVAL_MS, .priority = 3, .available = true,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_HEARTBEAT_LENGTH) },
+    [MAVLINK_SLOT_SYS_STATUS]           = { .intervalMs = MAVLINK_EXTENDED_STATUS_INTERVAL_MS, .priority = 1, .available = true,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_SYS_STATUS_LENGTH) },
+    [MAVLINK_SLOT_ATTITUDE]             = { .intervalMs = MAVLINK_EXTRA1_INTERVAL_MS, .priority = 3, .available = true,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_ATTITUDE_LENGTH) },
+    [MAVLINK_SLOT_VFR_HUD]              = { .intervalMs = MAVLINK_EXTRA2_INTERVAL_MS, .priority = 2, .available = true,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_VFR_HUD_LENGTH) },
+    [MAVLINK_SLOT_GPS_RAW_INT]          = { .intervalMs = MAVLINK_POSITION_INTERVAL_MS, .priority = 1,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_GPS_RAW_INT_LENGTH) },
+    [MAVLINK_SLOT_GLOBAL_POSITION_INT]  = { .intervalMs = MAVLINK_POSITION_INTERVAL_MS, .priority = 1,
+                                            .maxBytes = MAVLINK_FRAME_LENGTH(MAVLINK_MSG_GLOBAL_POSITION_INT_LENGTH) },
+};
+static telemetrySlotScheduler_t mavlinkScheduler;
+
+static serialPort_t *mavlinkPort;
+static serialPortConfig_t *portConfig;
+static telemetryConfig_t *telemetryConfig;
+static bool mavlinkTelemetryEnabled;
+static portSharing_e mavlinkPortSharing;
+
+static uint8_t mavlinkFrame[MAVLINK_FRAME_LENGTH(MAVLINK_PAYLOAD_LENGTH_MAX)];
+static uint8_t mavlinkFramePosition;
+static uint8_t mavlinkSequence;
+
+static void mavlinkInitializeMessage(uint32_t messageId)
+{
+    mavlinkFrame[0] = MAVLINK_STX_V2;
+    // mavlinkFrame[1] is the payload length, filled in by mavlinkFinalizeMessage()
+    mavlinkFrame[2] = 0;    // No incompatible flags, i.e. not signed
+    mavlinkFrame[3] = 0;
+    mavlinkFrame[4] = mavlinkSequence++;
+    mavlinkFrame[5] = MAVLINK_SYSTEM_ID;
+    mavlinkFrame[6] = MAVLINK_COMPONENT_ID;
+    mavlinkFrame[7] = messageId;
+    mavlinkFrame[8] = messageId >> 8;
+    mavlinkFrame[9] = messageId >> 16;
+    mavlinkFramePosition = MAVLINK_HEADER_LENGTH;
+}
+
+// Payload fields are little endian, in the order common.xml puts them on the wire, largest types first
+static void mavlinkSerialize8(uint8_t v)
+{
+    mavlinkFrame[mavlinkFramePosition++] = v;
+}
+
+static void mavlinkSerialize16(uint16_t v)
+{
+    mavlinkSerialize8((uint8_t)v);
+    mavlinkSerialize8(v >> 8);
+}
+
+static void mavlinkSerialize32(uint32_t v)
+{
+    mavlinkSerialize16((uint16_t)v);
+    mavlinkSerialize16(v >> 16);
+}
+
+static void mavlinkSerialize64(uint64_t v)
+{
+    mavlinkSerialize32((uint32_t)v);
+    mavlinkSerialize32(v >> 32);
+}
+
+static void mavlinkSerializeFloat(float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    mavlinkSerialize32(bits);
+}
+
+/*
+ * Drops the zeros at the end of the payload, keeping at least one byte, and adds the checksum. CRC_EXTRA is a hash of
+ * the message's definition, so that a receiver with a different idea of the message's layout rejects it.
+ */
+static void mavlinkFinalizeMessage(uint8_t crcExtra)
+{
+    while (mavlinkFramePosition > MAVLINK_HEADER_LENGTH + 1 && mavlinkFrame[mavlinkFramePosition - 1] == 0) {
+        mavlinkFramePosition--;
+    }
+    mavlinkFrame[1] = mavlinkFramePosition - MAVLINK_HEADER_LENGTH;
+
+    uint16_t crc = crc16Mcrf4xxUpdate(0xFFFF, &mavlinkFrame[1], mavlinkFramePosition - 1);
+    crc = crc16Mcrf4xx(crc, crcExtra);
+    mavlinkSerialize16(crc);
+
+    serialWriteBuf(mavlinkPort, mavlinkFrame, mavlinkFramePosition);
+}
+
+static void mavlinkSendHeartbeat(void)
+{
+    uint8_t baseMode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED | MAV_MODE_FLAG_MANUAL_INPUT_ENABLED;
+    if (FLIGHT_MODE(ANGLE_MODE) || FLIGHT_MODE(HORIZON_MODE)) {
+        baseMode |= MAV_MODE_FLAG_STABILIZE_ENABLED;
+    }
+    if (ARMING_FLAG(ARMED)) {
+        baseMode |= MAV_MODE_FLAG_SAFETY_ARMED;
+    }
+
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_HEARTBEAT);
+    mavlinkSerialize32(flightModeFlags);                        // custom_mode
+    mavlinkSerialize8(STATE(FIXED_WING) ? MAV_TYPE_FIXED_WING : MAV_TYPE_QUADROTOR);
+    mavlinkSerialize8(MAV_AUTOPILOT_GENERIC);
+    mavlinkSerialize8(baseMode);
+    mavlinkSerialize8(ARMING_FLAG(ARMED) ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY);
+    mavlinkSerialize8(MAVLINK_VERSION);
+    mavlinkFinalizeMessage(MAVLINK_MSG_HEARTBEAT_CRC);
+}
+
+static uint32_t mavlinkSensorsPresent(void)
+{
+    uint32_t present = MAV_SYS_STATUS_SENSOR_3D_GYRO;
+
+    if (sensors(SENSOR_ACC)) {
+        present |= MAV_SYS_STATUS_SENSOR_3D_ACCEL;
+    }
+    if (sensors(SENSOR_MAG)) {
+        present |= MAV_SYS_STATUS_SENSOR_3D_MAG;
+    }
+    if (sensors(SENSOR_BARO)) {
+        present |= MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE;
+    }
+    if (sensors(SENSOR_GPS)) {
+        present |= MAV_SYS_STATUS_SENSOR_GPS;
+    }
+
+    return present;
+}
+
+static void mavlinkSendSysStatus(void)
+{
+    const uint32_t sensorsPresent = mavlinkSensorsPresent();
+
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_SYS_STATUS);
+    mavlinkSerialize32(sensorsPresent);                         // onboard_control_sensors_present
+    mavlinkSerialize32(sensorsPresent);                         // onboard_control_sensors_enabled
+    mavlinkSerialize32(sensorsPresent);                         // onboard_control_sensors_health
+    mavlinkSerialize16(averageSystemLoadPercent * 10);          // load, 0.1%
+    mavlinkSerialize16(feature(FEATURE_VBAT) ? telemetryData.vbat * 100 : UINT16_MAX);     // voltage_battery, mV
+    mavlinkSerialize16(feature(FEATURE_CURRENT_METER) ? constrain(telemetryData.amperage, 0, INT16_MAX) : -1); // current_battery, cA
+    mavlinkSerialize16(0);                                      // drop_rate_comm
+    mavlinkSerialize16(0);                                      // errors_comm
+    mavlinkSerialize16(0);                                      // errors_count1
+    mavlinkSerialize16(0);                                      // errors_count2
+    mavlinkSerialize16(0);                                      // errors_count3
+    mavlinkSerialize16(0);                                      // errors_count4
+    mavlinkSerialize8(feature(FEATURE_VBAT) ? telemetryData.batteryRemainingPercentage : -1);  // battery_remaining, %
+    mavlinkFinalizeMessage(MAVLINK_MSG_SYS_STATUS_CRC);
+}
+
+// MAVLink angles are -pi to pi
+static float decidegreesToRadians(int16_t angle)
+{
+    if (angle > 1800) {
+        angle -= 3600;
+    }
+    return DECIDEGREES_TO_RADIANS(angle);
+}
+
+static void mavlinkSendAttitude(void)
+{
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_ATTITUDE);
+    mavlinkSerialize32(telemetryData.capturedAt);               // time_boot_ms
+    mavlinkSerializeFloat(decidegreesToRadians(telemetryData.roll));
+    mavlinkSerializeFloat(decidegreesToRadians(-telemetryData.pitch));  // Nose up is positive
+    mavlinkSerializeFloat(decidegreesToRadians(telemetryData.yaw));
+    mavlinkSerializeFloat(0);                                   // rollspeed
+    mavlinkSerializeFloat(0);                                   // pitchspeed
+    mavlinkSerializeFloat(0);                                   // yawspeed
+    mavlinkFinalizeMessage(MAVLINK_MSG_ATTITUDE_CRC);
+}
+
+static void mavlinkSendVfrHud(void)
+{
+    const int32_t altitude = sensors(SENSOR_BARO) || sensors(SENSOR_SONAR) ? telemetryData.estimatedAltitude : telemetryData.gpsAltitude * 100;
+
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_VFR_HUD);
+    mavlinkSerializeFloat(0);                                   // airspeed
+    mavlinkSerializeFloat(telemetryData.gpsSpeed / 100.0f);     // groundspeed, m/s
+    mavlinkSerializeFloat(altitude / 100.0f);                   // alt, m
+    mavlinkSerializeFloat(telemetryData.vario / 100.0f);        // climb, m/s
+    mavlinkSerialize16(DECIDEGREES_TO_DEGREES(telemetryData.yaw));  // heading, degrees
+    mavlinkSerialize16(scaleRange(constrain(telemetryData.throttle, PWM_RANGE_MIN, PWM_RANGE_MAX), PWM_RANGE_MIN, PWM_RANGE_MAX, 0, 100)); // throttle, %
+    mavlinkFinalizeMessage(MAVLINK_MSG_VFR_HUD_CRC);
+}
+
+#ifdef GPS
+static void mavlinkSendGpsRawInt(void)
+{
+    uint8_t fixType;
+    if (!telemetryData.gpsFix) {
+        fixType = GPS_FIX_TYPE_NO_FIX;
+    } else if (telemetryData.gpsNumSat < 5) {
+        fixType = GPS_FIX_TYPE_2D_FIX;
+    } else {
+        fixType = GPS_FIX_TYPE_3D_FIX;
+    }
+
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_GPS_RAW_INT);
+    mavlinkSerialize64((uint64_t)telemetryData.capturedAt * 1000); // time_usec
+    mavlinkSerialize32(telemetryData.gpsCoord[LAT]);            // lat, degrees * 10^7
+    mavlinkSerialize32(telemetryData.gpsCoord[LON]);            // lon
+    mavlinkSerialize32(telemetryData.gpsAltitude * 1000);       // alt, mm
+    mavlinkSerialize16(telemetryData.gpsHdop);                  // eph, HDOP * 100
+    mavlinkSerialize16(UINT16_MAX);                             // epv, unknown
+    mavlinkSerialize16(telemetryData.gpsSpeed);                 // vel, cm/s
+    mavlinkSerialize16(telemetryData.gpsGroundCourse * 10);     // cog, degrees * 100
+    mavlinkSerialize8(fixType);
+    mavlinkSerialize8(telemetryData.gpsNumSat);                 // satellites_visible
+    mavlinkFinalizeMessage(MAVLINK_MSG_GPS_RAW_INT_CRC);
+}
+
+static void mavlinkSendGlobalPositionInt(void)
+{
+    mavlinkInitializeMessage(MAVLINK_MSG_ID_GLOBAL_POSITION_INT);
+    mavlinkSerialize32(telemetryData.capturedAt);               // time_boot_ms
+    mavlinkSerialize32(telemetryData.gpsCoord[LAT]);            // lat, degrees * 10^7
+    mavlinkSerialize32(telemetryData.gpsCoord[LON]);            // lon
+    mavlinkSerialize32(telemetryData.gpsAltitude * 1000);       // alt, mm above sea level
+    mavlinkSerialize32(telemetryData.estimatedAltitude * 10);   // relative_alt, mm above home
+    mavlinkSerialize16(0);                                      // vx, cm/s north
+    mavlinkSerialize16(0);                                      // vy, cm/s east
+    mavlinkSerialize16(-telemetryData.vario);                   // vz, cm/s down
+    mavlinkSerialize16(DECIDEGREES_TO_DEGREES(telemetryData.yaw) * 100); // hdg, degrees * 100
+    mavlinkFinalizeMessage(MAVLINK_MSG_GLOBAL_POSITION_INT_CRC);
+}
+#endif
+
+/*
+ * Sends whatever is due of each group of messages, as far as there's room in the TX buffer.
+ */
+void handleMavlinkTelemetry(void)
+{
+    if (!mavlinkTelemetryEnabled || !mavlinkPort) {
+        return;
+    }
+
+#ifdef GPS
+    mavlinkSlots[MAVLINK_SLOT_GPS_RAW_INT].available = sensors(SENSOR_GPS);
+    mavlinkSlots[MAVLINK_SLOT_GLOBAL_POSITION_INT].available = sensors(SENSOR_GPS);
+#endif
+
+    telemetrySlotsBeginCall(&mavlinkScheduler, telemetryData.capturedAt, serialTxBytesFree(mavlinkPort));
+
+    int slot;
+    while ((slot = telemetrySlotsNext(&mavlinkScheduler)) != TELEMETRY_SLOT_NONE) {
+        switch (slot) {
+        case MAVLINK_SLOT_HEARTBEAT:
+            mavlinkSendHeartbeat();
+            break;
+        case MAVLINK_SLOT_SYS_STATUS:
+            mavlinkSendSysStatus();
+            break;
+        case MAVLINK_SLOT_ATTITUDE:
+            mavlinkSendAttitude();
+            break;
+        case MAVLINK_SLOT_VFR_HUD:
+            mavlinkSendVfrHud();
+            break;
+#ifdef GPS
+        case MAVLINK_SLOT_GPS_RAW_INT:
+            mavlinkSendGpsRawInt();
+            break;
+        case MAVLINK_SLOT_GLOBAL_POSITION_INT:
+            mavlinkSendGlobalPositionInt();
+            break;
+#endif
+        default:
+            break;
+        }
+        telemetrySlotsSent(&mavlinkScheduler, slot);
+    }
+}
+
+void freeMavlinkTelemetryPort(void)
+{
+    closeSerialPort(mavlinkPort);
+    mavlinkPort = NULL;
+    mavlinkTelemetryEnabled = false;
+}
+
+void initMavlinkTelemetry(telemetryConfig_t *initialTelemetryConfig)
+{
+    telemetryConfig = initialTelemetryConfig;
+    telemetrySlotsInit(&mavlinkScheduler, mavlinkSlots, MAVLINK_SLOT_COUNT, MAVLINK_MAX_BYTES_PER_CALL, MAVLINK_MAX_MICROS_PER_CALL);
+    portConfig = findSerialPortConfig(FUNCTION_TELEMETRY_MAVLINK);
+    mavlinkPortSharing = determinePortSharing(portConfig, FUNCTION_TELEMETRY_MAVLINK);
+}
+
+void configureMavlinkTelemetryPort(void)
+{
+    if (!portConfig) {
+        return;
+    }
+
+    baudRate_e baudRateIndex = portConfig->telemetry_baudrateIndex;
+    if (baudRateIndex == BAUD_AUTO) {
+        baudRateIndex = BAUD_57600;
+    }
+
+    mavlinkPort = openSerialPort(portConfig->identifier, FUNCTION_TELEMETRY_MAVLINK, NULL, baudRates[baudRateIndex], TELEMETRY_MAVLINK_INITIAL_PORT_MODE, SERIAL_NOT_INVERTED);
+    if (!mavlinkPort) {
+        return;
+    }
+
+    mavlinkTelemetryEnabled = true;
+}
+
+void checkMavlinkTelemetryState(void)
+{
+    bool newTelemetryEnabledValue = telemetryDetermineEnabledState(mavlinkPortSharing);
+
+    if (newTelemetryEnabledValue == mavlinkTelemetryEnabled) {
+        return;
+    }
+
+    if (newTelemetryEnabledValue) {
+        configureMavlinkTelemetryPort();
+    } else {
+        freeMavlinkTelemetryPort();
+    }
+}
+
+#endif
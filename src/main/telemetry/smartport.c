@@ -56,6 +56,7 @@
 #include "flight/altitudehold.h"
 
 #include "telemetry/telemetry.h"
+#include "telemetry/telemetry_slots.h"
 #include "telemetry/smartport.h"
 
 #include "fc/runtime_config.h"
@@ -111,36 +112,55 @@ enum
     FSSP_DATAID_A4         = 0x0910 ,
 };
 
-const uint16_t frSkyDataIdTable[] = {
-    FSSP_DATAID_SPEED     ,
-    FSSP_DATAID_VFAS      ,
-    FSSP_DATAID_CURRENT   ,
-    //FSSP_DATAID_RPM       ,
-    FSSP_DATAID_ALTITUDE  ,
-    FSSP_DATAID_FUEL      ,
-    //FSSP_DATAID_ADC1      ,
-    //FSSP_DATAID_ADC2      ,
-    FSSP_DATAID_LATLONG   ,
-    FSSP_DATAID_LATLONG   , // twice
-    //FSSP_DATAID_CAP_USED  ,
-    FSSP_DATAID_VARIO     ,
-    //FSSP_DATAID_CELLS     ,
-    //FSSP_DATAID_CELLS_LAST,
-    FSSP_DATAID_HEADING   ,
-    FSSP_DATAID_ACCX      ,
-    FSSP_DATAID_ACCY      ,
-    FSSP_DATAID_ACCZ      ,
-    FSSP_DATAID_T1        ,
-    FSSP_DATAID_T2        ,
-    FSSP_DATAID_GPS_ALT   ,
-    FSSP_DATAID_A4        ,
-    0
+// What's sent in reply to each request, taking turns
+typedef enum {
+    SMARTPORT_SLOT_SPEED = 0,
+    SMARTPORT_SLOT_VFAS,
+    SMARTPORT_SLOT_CURRENT,
+    SMARTPORT_SLOT_ALTITUDE,
+    SMARTPORT_SLOT_FUEL,
+    SMARTPORT_SLOT_LATITUDE,
+    SMARTPORT_SLOT_LONGITUDE,
+    SMARTPORT_SLOT_VARIO,
+    SMARTPORT_SLOT_HEADING,
+    SMARTPORT_SLOT_ACCX,
+    SMARTPORT_SLOT_ACCY,
+    SMARTPORT_SLOT_ACCZ,
+    SMARTPORT_SLOT_T1,
+    SMARTPORT_SLOT_T2,
+    SMARTPORT_SLOT_GPS_ALT,
+    SMARTPORT_SLOT_A4,
+    SMARTPORT_SLOT_COUNT
+} smartPortSlot_e;
+
+// A data frame with every byte after the first escaped
+#define SMARTPORT_PACKAGE_SIZE_MAX 15
+#define SMARTPORT_MAX_MICROS_PER_CALL 200
+
+// Attitude and altitude change quickest, so they go round twice as often as the rest
+static telemetrySlot_t smartPortSlots[SMARTPORT_SLOT_COUNT] = {
+    [SMARTPORT_SLOT_SPEED]      = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_VFAS]       = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_CURRENT]    = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_ALTITUDE]   = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_FUEL]       = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_LATITUDE]   = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_LONGITUDE]  = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_VARIO]      = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_HEADING]    = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_ACCX]       = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_ACCY]       = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_ACCZ]       = { .priority = 2, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_T1]         = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_T2]         = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_GPS_ALT]    = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
+    [SMARTPORT_SLOT_A4]         = { .priority = 1, .maxBytes = SMARTPORT_PACKAGE_SIZE_MAX },
 };
+static telemetrySlotScheduler_t smartPortScheduler;
 
 #define __USE_C99_MATH // for roundf()
 #define SMARTPORT_BAUD 57600
 #define SMARTPORT_UART_MODE MODE_RXTX
-#define SMARTPORT_SERVICE_TIMEOUT_MS 1 // max allowed time to find a value to send
 #define SMARTPORT_NOT_CONNECTED_TIMEOUT_MS 7000
 
 static serialPort_t *smartPortSerialPort = NULL; // The 'SmartPort'(tm) Port.
@@ -152,7 +172,6 @@ static portSharing_e smartPortPortSharing;
 
 char smartPortState = SPSTATE_UNINITIALIZED;
 static uint8_t smartPortHasRequest = 0;
-static uint8_t smartPortIdCnt = 0;
 static uint32_t smartPortLastRequestTime = 0;
 
 static void smartPortDataReceive(uint16_t c)
@@ -211,6 +230,7 @@ static void smartPortSendPackage(uint16_t id, uint32_t val)
 void initSmartPortTelemetry(telemetryConfig_t *initialTelemetryConfig)
 {
     telemetryConfig = initialTelemetryConfig;
+    telemetrySlotsInit(&smartPortScheduler, smartPortSlots, SMARTPORT_SLOT_COUNT, SMARTPORT_PACKAGE_SIZE_MAX, SMARTPORT_MAX_MICROS_PER_CALL);
     portConfig = findSerialPortConfig(FUNCTION_TELEMETRY_SMARTPORT);
     smartPortPortSharing = determinePortSharing(portConfig, FUNCTION_TELEMETRY_SMARTPORT);
 }
@@ -273,10 +293,157 @@ void checkSmartPortTelemetryState(void)
         freeSmartPortTelemetryPort();
 }
 
-void handleSmartPortTelemetry(void)
+static void smartPortUpdateSlotAvailability(void)
+{
+#ifdef GPS
+    const bool gpsFix = sensors(SENSOR_GPS) && telemetryData.gpsFix;
+
+    smartPortSlots[SMARTPORT_SLOT_SPEED].available = gpsFix;
+    smartPortSlots[SMARTPORT_SLOT_LATITUDE].available = gpsFix;
+    smartPortSlots[SMARTPORT_SLOT_LONGITUDE].available = gpsFix;
+    smartPortSlots[SMARTPORT_SLOT_GPS_ALT].available = gpsFix;
+#endif
+    smartPortSlots[SMARTPORT_SLOT_VFAS].available = feature(FEATURE_VBAT);
+    smartPortSlots[SMARTPORT_SLOT_A4].available = feature(FEATURE_VBAT);
+    smartPortSlots[SMARTPORT_SLOT_CURRENT].available = feature(FEATURE_CURRENT_METER);
+    smartPortSlots[SMARTPORT_SLOT_FUEL].available = feature(FEATURE_CURRENT_METER);
+    smartPortSlots[SMARTPORT_SLOT_ALTITUDE].available = sensors(SENSOR_BARO);
+    smartPortSlots[SMARTPORT_SLOT_VARIO].available = sensors(SENSOR_BARO);
+    smartPortSlots[SMARTPORT_SLOT_HEADING].available = true;
+    smartPortSlots[SMARTPORT_SLOT_ACCX].available = true;
+    smartPortSlots[SMARTPORT_SLOT_ACCY].available = true;
+    smartPortSlots[SMARTPORT_SLOT_ACCZ].available = true;
+    smartPortSlots[SMARTPORT_SLOT_T1].available = true;
+    smartPortSlots[SMARTPORT_SLOT_T2].available = feature(FEATURE_GPS);
+}
+
+static void smartPortSendSlot(smartPortSlot_e slot)
 {
-    uint32_t smartPortLastServiceTime = millis();
+    int32_t tmpi;
+    uint32_t tmpui;
+    static uint8_t t1Cnt = 0;
+
+    switch (slot) {
+        case SMARTPORT_SLOT_SPEED       :
+            tmpui = (telemetryData.gpsSpeed * 36 + 36 / 2) / 100;
+            smartPortSendPackage(FSSP_DATAID_SPEED, tmpui); // given in 0.1 m/s, provide in KM/H
+            break;
+        case SMARTPORT_SLOT_VFAS        :
+            {
+                uint16_t vfasVoltage;
+                if (telemetryConfig->frsky_vfas_cell_voltage) {
+                    vfasVoltage = telemetryData.vbat / telemetryData.batteryCellCount;
+                } else {
+                    vfasVoltage = telemetryData.vbat;
+                }
+                smartPortSendPackage(FSSP_DATAID_VFAS, vfasVoltage * 10); // given in 0.1V, convert to volts
+            }
+            break;
+        case SMARTPORT_SLOT_CURRENT     :
+            smartPortSendPackage(FSSP_DATAID_CURRENT, telemetryData.amperage / 10); // given in 10mA steps, unknown requested unit
+            break;
+        case SMARTPORT_SLOT_ALTITUDE    :
+            smartPortSendPackage(FSSP_DATAID_ALTITUDE, telemetryData.baroAltitude); // unknown given unit, requested 100 = 1 meter
+            break;
+        case SMARTPORT_SLOT_FUEL        :
+            smartPortSendPackage(FSSP_DATAID_FUEL, telemetryData.mAhDrawn); // given in mAh, unknown requested unit
+            break;
+        // the same ID is sent for latitude and longitude, the MSB of the sent uint32_t tells them apart
+        case SMARTPORT_SLOT_LATITUDE    :
+            tmpui = abs(telemetryData.gpsCoord[LAT]);  // now we have unsigned value and one bit to spare
+            tmpui = (tmpui + tmpui / 2) / 25;  // 6/100 = 1.5/25, division by power of 2 is fast
+            if (telemetryData.gpsCoord[LAT] < 0) tmpui |= 0x40000000;
+            smartPortSendPackage(FSSP_DATAID_LATLONG, tmpui);
+            break;
+        case SMARTPORT_SLOT_LONGITUDE   :
+            tmpui = abs(telemetryData.gpsCoord[LON]);  // now we have unsigned value and one bit to spare
+            tmpui = (tmpui + tmpui / 2) / 25 | 0x80000000;  // 6/100 = 1.5/25, division by power of 2 is fast
+            if (telemetryData.gpsCoord[LON] < 0) tmpui |= 0x40000000;
+            smartPortSendPackage(FSSP_DATAID_LATLONG, tmpui);
+            break;
+        case SMARTPORT_SLOT_VARIO       :
+            smartPortSendPackage(FSSP_DATAID_VARIO, telemetryData.vario); // unknown given unit but requested in 100 = 1m/s
+            break;
+        case SMARTPORT_SLOT_HEADING     :
+            smartPortSendPackage(FSSP_DATAID_HEADING, telemetryData.yaw * 10); // given in 10*deg, requested in 10000 = 100 deg
+            break;
+        case SMARTPORT_SLOT_ACCX        :
+            smartPortSendPackage(FSSP_DATAID_ACCX, telemetryData.acc[X] / 44);
+            // unknown input and unknown output unit
+            // we can only show 00.00 format, another digit won't display right on Taranis
+            // dividing by roughly 44 will give acceleration in G units
+            break;
+        case SMARTPORT_SLOT_ACCY        :
+            smartPortSendPackage(FSSP_DATAID_ACCY, telemetryData.acc[Y] / 44);
+            break;
+        case SMARTPORT_SLOT_ACCZ        :
+            smartPortSendPackage(FSSP_DATAID_ACCZ, telemetryData.acc[Z] / 44);
+            break;
+        case SMARTPORT_SLOT_T1          :
+            // we send all the flags as decimal digits for easy reading
+
+            // the t1Cnt simply allows the telemetry view to show at least some changes
+            t1Cnt++;
+            if (t1Cnt >= 4) {
+                t1Cnt = 1;
+            }
+            tmpi = t1Cnt * 10000; // start off with at least one digit so the most significant 0 won't be cut off
+            // the Taranis seems to be able to fit 5 digits on the screen
+            // the Taranis seems to consider this number a signed 16 bit integer
+
+            if (ARMING_FLAG(OK_TO_ARM))
+                tmpi += 1;
+            if (ARMING_FLAG(PREVENT_ARMING))
+                tmpi += 2;
+            if (ARMING_FLAG(ARMED))
+                tmpi += 4;
+
+            if (FLIGHT_MODE(ANGLE_MODE))
+                tmpi += 10;
+            if (FLIGHT_MODE(HORIZON_MODE))
+                tmpi += 20;
+            if (FLIGHT_MODE(UNUSED_MODE))
+                tmpi += 40;
+            if (FLIGHT_MODE(PASSTHRU_MODE))
+                tmpi += 40;
+
+            if (FLIGHT_MODE(MAG_MODE))
+                tmpi += 100;
+            if (FLIGHT_MODE(BARO_MODE))
+                tmpi += 200;
+            if (FLIGHT_MODE(SONAR_MODE))
+                tmpi += 400;
+
+            if (FLIGHT_MODE(GPS_HOLD_MODE))
+                tmpi += 1000;
+            if (FLIGHT_MODE(GPS_HOME_MODE))
+                tmpi += 2000;
+            if (FLIGHT_MODE(HEADFREE_MODE))
+                tmpi += 4000;
+
+            smartPortSendPackage(FSSP_DATAID_T1, (uint32_t)tmpi);
+            break;
+        case SMARTPORT_SLOT_T2          :
+            if (sensors(SENSOR_GPS)) {
+                // provide GPS lock status
+                smartPortSendPackage(FSSP_DATAID_T2, (telemetryData.gpsFix ? 1000 : 0) + (telemetryData.gpsFixHome ? 2000 : 0) + telemetryData.gpsNumSat);
+            } else {
+                smartPortSendPackage(FSSP_DATAID_T2, 0);
+            }
+            break;
+        case SMARTPORT_SLOT_GPS_ALT     :
+            smartPortSendPackage(FSSP_DATAID_GPS_ALT, telemetryData.gpsAltitude * 100); // given in 0.1m , requested in 10 = 1m (should be in mm, probably a bug in opentx, tested on 2.0.1.7)
+            break;
+        case SMARTPORT_SLOT_A4          :
+            smartPortSendPackage(FSSP_DATAID_A4, telemetryData.vbat * 10 / telemetryData.batteryCellCount); // given in 0.1V, convert to volts
+            break;
+        default:
+            break;
+    }
+}
 
+void handleSmartPortTelemetry(void)
+{
     if (!smartPortTelemetryEnabled) {
         return;
     }
@@ -298,191 +465,20 @@ void handleSmartPortTelemetry(void)
         return;
     }
 
-    while (smartPortHasRequest) {
-        // Ensure we won't get stuck in the loop if there happens to be nothing available to send in a timely manner - dump the slot if we loop in there for too long.
-        if ((millis() - smartPortLastServiceTime) > SMARTPORT_SERVICE_TIMEOUT_MS) {
-            smartPortHasRequest = 0;
-            return;
-        }
+    if (!smartPortHasRequest) {
+        return;
+    }
 
-        // we can send back any data we want, our table keeps track of the order and frequency of each data type we send
-        uint16_t id = frSkyDataIdTable[smartPortIdCnt];
-        if (id == 0) { // end of table reached, loop back
-            smartPortIdCnt = 0;
-            id = frSkyDataIdTable[smartPortIdCnt];
-        }
-        smartPortIdCnt++;
+    // One reply per request. If there's nothing to send, or no room for it, the receiver moves on to its next sensor.
+    smartPortHasRequest = 0;
 
-        int32_t tmpi;
-        static uint8_t t1Cnt = 0;
+    smartPortUpdateSlotAvailability();
+    telemetrySlotsBeginCall(&smartPortScheduler, telemetryData.capturedAt, serialTxBytesFree(smartPortSerialPort));
 
-        switch(id) {
-#ifdef GPS
-            case FSSP_DATAID_SPEED      :
-                if (sensors(SENSOR_GPS) && STATE(GPS_FIX)) {
-                    uint32_t tmpui = (GPS_speed * 36 + 36 / 2) / 100;
-                    smartPortSendPackage(id, tmpui); // given in 0.1 m/s, provide in KM/H
-                    smartPortHasRequest = 0;
-                }
-                break;
-#endif
-            case FSSP_DATAID_VFAS       :
-                if (feature(FEATURE_VBAT)) {
-                    uint16_t vfasVoltage;
-                    if (telemetryConfig->frsky_vfas_cell_voltage) {
-                        vfasVoltage = vbat / batteryCellCount;
-                    } else {
-                        vfasVoltage = vbat;
-                    }
-                    smartPortSendPackage(id, vfasVoltage * 10); // given in 0.1V, convert to volts
-                    smartPortHasRequest = 0;
-                }
-                break;
-            case FSSP_DATAID_CURRENT    :
-                if (feature(FEATURE_CURRENT_METER)) {
-                    smartPortSendPackage(id, amperage / 10); // given in 10mA steps, unknown requested unit
-                    smartPortHasRequest = 0;
-                }
-                break;
-            //case FSSP_DATAID_RPM        :
-            case FSSP_DATAID_ALTITUDE   :
-                if (sensors(SENSOR_BARO)) {
-                    smartPortSendPackage(id, BaroAlt); // unknown given unit, requested 100 = 1 meter
-                    smartPortHasRequest = 0;
-                }
-                break;
-            case FSSP_DATAID_FUEL       :
-                if (feature(FEATURE_CURRENT_METER)) {
-                    smartPortSendPackage(id, mAhDrawn); // given in mAh, unknown requested unit
-                    smartPortHasRequest = 0;
-                }
-                break;
-            //case FSSP_DATAID_ADC1       :
-            //case FSSP_DATAID_ADC2       :
-#ifdef GPS
-            case FSSP_DATAID_LATLONG    :
-                if (sensors(SENSOR_GPS) && STATE(GPS_FIX)) {
-                    uint32_t tmpui = 0;
-                    // the same ID is sent twice, one for longitude, one for latitude
-                    // the MSB of the sent uint32_t helps FrSky keep track
-                    // the even/odd bit of our counter helps us keep track
-                    if (smartPortIdCnt & 1) {
-                        tmpui = abs(GPS_coord[LON]);  // now we have unsigned value and one bit to spare
-                        tmpui = (tmpui + tmpui / 2) / 25 | 0x80000000;  // 6/100 = 1.5/25, division by power of 2 is fast
-                        if (GPS_coord[LON] < 0) tmpui |= 0x40000000;
-                    }
-                    else {
-                        tmpui = abs(GPS_coord[LAT]);  // now we have unsigned value and one bit to spare
-                        tmpui = (tmpui + tmpui / 2) / 25;  // 6/100 = 1.5/25, division by power of 2 is fast
-                        if (GPS_coord[LAT] < 0) tmpui |= 0x40000000;
-                    }
-                    smartPortSendPackage(id, tmpui);
-                    smartPortHasRequest = 0;
-                }
-                break;
-#endif
-            //case FSSP_DATAID_CAP_USED   :
-            case FSSP_DATAID_VARIO      :
-                if (sensors(SENSOR_BARO)) {
-                    smartPortSendPackage(id, vario); // unknown given unit but requested in 100 = 1m/s
-                    smartPortHasRequest = 0;
-                }
-                break;
-            case FSSP_DATAID_HEADING    :
-                smartPortSendPackage(id, attitude.values.yaw * 10); // given in 10*deg, requested in 10000 = 100 deg
-                smartPortHasRequest = 0;
-                break;
-            case FSSP_DATAID_ACCX       :
-                smartPortSendPackage(id, accSmooth[X] / 44);
-                // unknown input and unknown output unit
-                // we can only show 00.00 format, another digit won't display right on Taranis
-                // dividing by roughly 44 will give acceleration in G units
-                smartPortHasRequest = 0;
-                break;
-            case FSSP_DATAID_ACCY       :
-                smartPortSendPackage(id, accSmooth[Y] / 44);
-                smartPortHasRequest = 0;
-                break;
-            case FSSP_DATAID_ACCZ       :
-                smartPortSendPackage(id, accSmooth[Z] / 44);
-                smartPortHasRequest = 0;
-                break;
-            case FSSP_DATAID_T1         :
-                // we send all the flags as decimal digits for easy reading
-
-                // the t1Cnt simply allows the telemetry view to show at least some changes
-                t1Cnt++;
-                if (t1Cnt >= 4) {
-                    t1Cnt = 1;
-                }
-                tmpi = t1Cnt * 10000; // start off with at least one digit so the most significant 0 won't be cut off
-                // the Taranis seems to be able to fit 5 digits on the screen
-                // the Taranis seems to consider this number a signed 16 bit integer
-
-                if (ARMING_FLAG(OK_TO_ARM))
-                    tmpi += 1;
-                if (ARMING_FLAG(PREVENT_ARMING))
-                    tmpi += 2;
-                if (ARMING_FLAG(ARMED))
-                    tmpi += 4;
-
-                if (FLIGHT_MODE(ANGLE_MODE))
-                    tmpi += 10;
-                if (FLIGHT_MODE(HORIZON_MODE))
-                    tmpi += 20;
-                if (FLIGHT_MODE(UNUSED_MODE))
-                    tmpi += 40;
-                if (FLIGHT_MODE(PASSTHRU_MODE))
-                    tmpi += 40;
-
-                if (FLIGHT_MODE(MAG_MODE))
-                    tmpi += 100;
-                if (FLIGHT_MODE(BARO_MODE))
-                    tmpi += 200;
-                if (FLIGHT_MODE(SONAR_MODE))
-                    tmpi += 400;
-
-                if (FLIGHT_MODE(GPS_HOLD_MODE))
-                    tmpi += 1000;
-                if (FLIGHT_MODE(GPS_HOME_MODE))
-                    tmpi += 2000;
-                if (FLIGHT_MODE(HEADFREE_MODE))
-                    tmpi += 4000;
-
-                smartPortSendPackage(id, (uint32_t)tmpi);
-                smartPortHasRequest = 0;
-                break;
-            case FSSP_DATAID_T2         :
-                if (sensors(SENSOR_GPS)) {
-#ifdef GPS
-                    // provide GPS lock status
-                    smartPortSendPackage(id, (STATE(GPS_FIX) ? 1000 : 0) + (STATE(GPS_FIX_HOME) ? 2000 : 0) + GPS_numSat);
-                    smartPortHasRequest = 0;
-#endif
-                }
-                else if (feature(FEATURE_GPS)) {
-                    smartPortSendPackage(id, 0);
-                    smartPortHasRequest = 0;
-                }
-                break;
-#ifdef GPS
-            case FSSP_DATAID_GPS_ALT    :
-                if (sensors(SENSOR_GPS) && STATE(GPS_FIX)) {
-                    smartPortSendPackage(id, GPS_altitude * 100); // given in 0.1m , requested in 10 = 1m (should be in mm, probably a bug in opentx, tested on 2.0.1.7)
-                    smartPortHasRequest = 0;
-                }
-                break;
-#endif
-            case FSSP_DATAID_A4         :
-                if (feature(FEATURE_VBAT)) {
-                    smartPortSendPackage(id, vbat * 10 / batteryCellCount ); // given in 0.1V, convert to volts
-                    smartPortHasRequest = 0;
-                }
-                break;
-            default:
-                break;
-                // if nothing is sent, smartPortHasRequest isn't cleared, we already incremented the counter, just loop back to the start
-        }
+    const int slot = telemetrySlotsNext(&smartPortScheduler);
+    if (slot != TELEMETRY_SLOT_NONE) {
+        smartPortSendSlot(slot);
+        telemetrySlotsSent(&smartPortScheduler, slot);
     }
 }
 
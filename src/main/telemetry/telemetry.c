@@ -23,16 +23,33 @@
 
 #ifdef TELEMETRY
 
+#include "common/axis.h"
+
+#include "drivers/system.h"
 #include "drivers/timer.h"
 #include "drivers/serial.h"
 #include "drivers/serial_softserial.h"
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
 #include "io/serial.h"
+#include "io/gps.h"
 
 #include "rx/rx.h"
 #include "fc/rc_controls.h"
 
 #include "fc/runtime_config.h"
 
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "sensors/barometer.h"
+#include "sensors/battery.h"
+
+#include "flight/mixer.h"
+#include "flight/pid.h"
+#include "flight/imu.h"
+#include "flight/altitudehold.h"
+#include "flight/navigation.h"
+
 #include "config/config.h"
 
 #include "telemetry/telemetry.h"
@@ -40,10 +57,17 @@
 #include "telemetry/hott.h"
 #include "telemetry/smartport.h"
 #include "telemetry/ltm.h"
+#include "telemetry/mavlink.h"
 #include "telemetry/jetiexbus.h"
+#include "telemetry/crsf.h"
 
 static telemetryConfig_t *telemetryConfig;
 
+telemetryData_t telemetryData;
+
+extern uint16_t rssi;              // FIXME dependency on mw.c
+extern int16_t telemTemperature1;  // FIXME dependency on mw.c
+
 void telemetryUseConfig(telemetryConfig_t *telemetryConfigToUse)
 {
     telemetryConfig = telemetryConfigToUse;
@@ -55,7 +79,9 @@ void telemetryInit(void)
     initHoTTTelemetry(telemetryConfig);
     initSmartPortTelemetry(telemetryConfig);
     initLtmTelemetry(telemetryConfig);
+    initMavlinkTelemetry(telemetryConfig);
     initJetiExBusTelemetry(telemetryConfig);
+    initCrsfTelemetry(telemetryConfig);
 
     telemetryCheckState();
 }
@@ -87,16 +113,77 @@ void telemetryCheckState(void)
     checkHoTTTelemetryState();
     checkSmartPortTelemetryState();
     checkLtmTelemetryState();
+    checkMavlinkTelemetryState();
     checkJetiExBusTelemetryState();
+    checkCrsfTelemetryState();
+}
+
+void telemetryCaptureData(rxConfig_t *rxConfig, uint16_t deadband3d_throttle)
+{
+    telemetryData_t *data = &telemetryData;
+
+    data->capturedAt = millis();
+
+    data->vbat = vbat;
+    data->batteryCellCount = batteryCellCount;
+    data->batteryRemainingPercentage = calculateBatteryCapacityRemainingPercentage();
+    data->batteryState = getBatteryState();
+    data->amperage = amperage;
+    data->mAhDrawn = mAhDrawn;
+
+    data->roll = attitude.values.roll;
+    data->pitch = attitude.values.pitch;
+    data->yaw = attitude.values.yaw;
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        data->acc[axis] = accSmooth[axis];
+    }
+    data->acc1G = acc.acc_1G;
+
+    data->baroAltitude = BaroAlt;
+    data->vario = vario;
+#if defined(BARO) || defined(SONAR)
+    data->estimatedAltitude = altitudeHoldGetEstimatedAltitude();
+#else
+    data->estimatedAltitude = 0;
+#endif
+#ifdef BARO
+    data->temperature = baroTemperature;
+#else
+    data->temperature = telemTemperature1 * 10;
+#endif
+
+    data->rssi = rssi;
+    data->throttle = rcCommand[THROTTLE];
+    data->throttleStatus = calculateThrottleStatus(rxConfig, deadband3d_throttle);
+
+#ifdef GPS
+    data->gpsCoord[LAT] = GPS_coord[LAT];
+    data->gpsCoord[LON] = GPS_coord[LON];
+    data->gpsHome[LAT] = GPS_home[LAT];
+    data->gpsHome[LON] = GPS_home[LON];
+    data->gpsAltitude = GPS_altitude;
+    data->gpsSpeed = GPS_speed;
+    data->gpsGroundCourse = GPS_ground_course;
+    data->gpsHdop = GPS_hdop;
+    data->gpsDistanceToHome = GPS_distanceToHome;
+    data->gpsDirectionToHome = GPS_directionToHome;
+    data->gpsNumSat = GPS_numSat;
+#endif
+    data->gpsFix = STATE(GPS_FIX);
+    data->gpsFixHome = STATE(GPS_FIX_HOME);
 }
 
 void telemetryProcess(rxConfig_t *rxConfig, uint16_t deadband3d_throttle)
 {
-    handleFrSkyTelemetry(rxConfig, deadband3d_throttle);
+    telemetryCaptureData(rxConfig, deadband3d_throttle);
+
+    handleFrSkyTelemetry();
     handleHoTTTelemetry();
     handleSmartPortTelemetry();
     handleLtmTelemetry();
+    handleMavlinkTelemetry();
     handleJetiExBusTelemetry();
+    handleCrsfTelemetry();
 }
 
 #endif
@@ -46,12 +46,57 @@ typedef struct telemetryConfig_s {
     uint8_t hottAlarmSoundInterval;
 } telemetryConfig_t;
 
+/*
+ * What the telemetry protocols report, captured once at the start of each telemetryProcess() so that everything sent in
+ * one go is from the same moment, e.g. a voltage and the current drawn at that voltage.
+ */
+typedef struct telemetryData_s {
+    uint32_t capturedAt;                // ms
+
+    uint16_t vbat;                      // 0.1V
+    uint8_t batteryCellCount;
+    uint8_t batteryRemainingPercentage;
+    uint8_t batteryState;               // batteryState_e
+    int32_t amperage;                   // 0.01A
+    int32_t mAhDrawn;
+
+    int16_t roll;                       // decidegrees
+    int16_t pitch;
+    int16_t yaw;
+    int32_t acc[3];                     // Smoothed, acc1G is 1G
+    uint16_t acc1G;
+
+    int32_t baroAltitude;               // cm
+    int32_t estimatedAltitude;          // cm
+    int32_t vario;                      // cm/s
+    int32_t temperature;                // 0.01 degrees C, from the baro if there is one, or else the gyro
+
+    uint16_t rssi;                      // 0-1023
+    int16_t throttle;                   // rcCommand
+    uint8_t throttleStatus;             // throttleStatus_e
+
+    int32_t gpsCoord[2];                // degrees * 10^7
+    int32_t gpsHome[2];
+    uint16_t gpsAltitude;               // m
+    uint16_t gpsSpeed;                  // cm/s
+    uint16_t gpsGroundCourse;           // decidegrees
+    uint16_t gpsHdop;
+    uint16_t gpsDistanceToHome;         // m
+    int16_t gpsDirectionToHome;         // degrees
+    uint8_t gpsNumSat;
+    bool gpsFix;
+    bool gpsFixHome;
+} telemetryData_t;
+
+extern telemetryData_t telemetryData;
+
 void telemetryInit(void);
 bool telemetryCheckRxPortShared(serialPortConfig_t *portConfig);
 extern serialPort_t *telemetrySharedPort;
 
 void telemetryCheckState(void);
 struct rxConfig_s;
+void telemetryCaptureData(struct rxConfig_s *rxConfig, uint16_t deadband3d_throttle);
 void telemetryProcess(struct rxConfig_s *rxConfig, uint16_t deadband3d_throttle);
 
 bool telemetryDetermineEnabledState(portSharing_e portSharing);
@@ -0,0 +1,105 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+#ifdef TELEMETRY
+
+#include "common/maths.h"
+
+#include "drivers/system.h"
+
+#include "telemetry/telemetry_slots.h"
+
+// Slots overdue by longer than this count the same, which keeps the weighting in range
+#define TELEMETRY_SLOT_MAX_OVERDUE_MS 0xFFFF
+
+void telemetrySlotsInit(telemetrySlotScheduler_t *scheduler, telemetrySlot_t *slots, uint8_t slotCount,
+    uint16_t maxBytesPerCall, uint16_t maxMicrosPerCall)
+{
+    scheduler->slots = slots;
+    scheduler->slotCount = slotCount;
+    scheduler->maxBytesPerCall = maxBytesPerCall;
+    scheduler->maxMicrosPerCall = maxMicrosPerCall;
+    scheduler->bytesLeft = 0;
+    scheduler->nextSlot = 0;
+
+    for (int i = 0; i < slotCount; i++) {
+        slots[i].lastSentAt = 0;
+    }
+}
+
+void telemetrySlotsBeginCall(telemetrySlotScheduler_t *scheduler, uint32_t currentTimeMs, uint16_t bytesFree)
+{
+    scheduler->callStartedAt = micros();
+    scheduler->currentTimeMs = currentTimeMs;
+    scheduler->bytesLeft = MIN(bytesFree, scheduler->maxBytesPerCall);
+}
+
+/*
+ * Returns the slot to send next, or TELEMETRY_SLOT_NONE if nothing is due or the call has used up its budget.
+ */
+int telemetrySlotsNext(telemetrySlotScheduler_t *scheduler)
+{
+    if (micros() - scheduler->callStartedAt >= scheduler->maxMicrosPerCall) {
+        return TELEMETRY_SLOT_NONE;
+    }
+
+    int best = TELEMETRY_SLOT_NONE;
+    uint32_t bestScore = 0;
+
+    for (int n = 0; n < scheduler->slotCount; n++) {
+        const int index = (scheduler->nextSlot + n) % scheduler->slotCount;
+        const telemetrySlot_t *slot = &scheduler->slots[index];
+
+        if (!slot->available) {
+            continue;
+        }
+
+        const uint32_t age = scheduler->currentTimeMs - slot->lastSentAt;
+        if (age < slot->intervalMs) {
+            continue;
+        }
+
+        const uint32_t score = (MIN(age - slot->intervalMs, TELEMETRY_SLOT_MAX_OVERDUE_MS) + 1) * slot->priority;
+        if (best == TELEMETRY_SLOT_NONE || score > bestScore) {
+            best = index;
+            bestScore = score;
+        }
+    }
+
+    // Rather than send something smaller in its place, let the most overdue slot have the whole of the next call
+    if (best != TELEMETRY_SLOT_NONE && scheduler->slots[best].maxBytes > scheduler->bytesLeft) {
+        return TELEMETRY_SLOT_NONE;
+    }
+
+    return best;
+}
+
+void telemetrySlotsSent(telemetrySlotScheduler_t *scheduler, int slotIndex)
+{
+    telemetrySlot_t *slot = &scheduler->slots[slotIndex];
+
+    slot->lastSentAt = scheduler->currentTimeMs;
+    scheduler->bytesLeft -= MIN(slot->maxBytes, scheduler->bytesLeft);
+    scheduler->nextSlot = (slotIndex + 1) % scheduler->slotCount;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Decides what a telemetry protocol sends next, and how much it may send in one call of telemetryProcess().
+ *
+ * A protocol describes each thing it can send (a sensor ID, a frame type) as a slot with how often it should go out
+ * and a priority. Of the slots that are due, the one that has been overdue longest, weighted by its priority, goes
+ * first, and slots equally overdue take turns. A call ends when the next slot wouldn't fit in the bytes left or the
+ * time is up, so one protocol can't hold up the rest of the main loop however much it has to send.
+ */
+
+typedef struct telemetrySlot_s {
+    uint16_t intervalMs;        // How often to send it, 0 for as often as there is room
+    uint8_t priority;           // Weighs how long it has been overdue, higher goes sooner
+    uint8_t maxBytes;           // The most it writes, including any byte stuffing
+    bool available;             // Cleared while there's nothing to send, e.g. GPS without a fix
+    uint32_t lastSentAt;        // ms
+} telemetrySlot_t;
+
+typedef struct telemetrySlotScheduler_s {
+    telemetrySlot_t *slots;
+    uint8_t slotCount;
+    uint16_t maxBytesPerCall;
+    uint16_t maxMicrosPerCall;
+
+    // The call in progress
+    uint32_t callStartedAt;     // us
+    uint32_t currentTimeMs;
+    uint16_t bytesLeft;
+    uint8_t nextSlot;           // Where to start looking, so that slots equally overdue take turns
+} telemetrySlotScheduler_t;
+
+#define TELEMETRY_SLOT_NONE -1
+
+void telemetrySlotsInit(telemetrySlotScheduler_t *scheduler, telemetrySlot_t *slots, uint8_t slotCount,
+    uint16_t maxBytesPerCall, uint16_t maxMicrosPerCall);
+void telemetrySlotsBeginCall(telemetrySlotScheduler_t *scheduler, uint32_t currentTimeMs, uint16_t bytesFree);
+int telemetrySlotsNext(telemetrySlotScheduler_t *scheduler);
+void telemetrySlotsSent(telemetrySlotScheduler_t *scheduler, int slotIndex);
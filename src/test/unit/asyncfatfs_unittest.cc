@@ -0,0 +1,668 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+    #include "drivers/sdcard.h"
+    #include "io/asyncfatfs/asyncfatfs.h"
+    #include "io/asyncfatfs/fat_standard.h"
+
+    #include "sdcard_sim.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_SECTORS_PER_CLUSTER 8
+
+// The main loop calls afatfs_poll() once per iteration
+#define TEST_LOOP_MICROS 250
+
+static afatfsFilePtr_t openedFile;
+static bool openCompleted;
+
+static void fileOpened(afatfsFilePtr_t file)
+{
+    openedFile = file;
+    openCompleted = true;
+}
+
+static bool closeCompleted;
+
+static void fileClosed(void)
+{
+    closeCompleted = true;
+}
+
+static uint32_t maxPollMicros;
+
+static void pollOnce(void)
+{
+    uint32_t start = sdcardSimMicros();
+
+    afatfs_poll();
+
+    uint32_t spent = sdcardSimMicros() - start;
+    if (spent > maxPollMicros) {
+        maxPollMicros = spent;
+    }
+
+    sdcardSimAdvanceMicros(TEST_LOOP_MICROS);
+}
+
+static bool pollUntil(bool *flag, uint32_t timeoutMicros)
+{
+    uint32_t start = sdcardSimMicros();
+
+    while (!*flag && sdcardSimMicros() - start < timeoutMicros) {
+        pollOnce();
+    }
+
+    return *flag;
+}
+
+static bool mount(void)
+{
+    afatfs_init();
+    sdcard_init(true);
+
+    uint32_t start = sdcardSimMicros();
+
+    while (afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_INITIALIZATION && sdcardSimMicros() - start < 60000000) {
+        pollOnce();
+    }
+
+    return afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_READY;
+}
+
+static bool unmount(void)
+{
+    for (int i = 0; i < 100000; i++) {
+        if (afatfs_destroy(false)) {
+            return true;
+        }
+        sdcardSimAdvanceMicros(TEST_LOOP_MICROS);
+    }
+
+    return false;
+}
+
+static bool initCard(const sdcardSimConfig_t *config)
+{
+    maxPollMicros = 0;
+
+    return sdcardSimInit(config) && sdcardSimFormatFAT32(TEST_SECTORS_PER_CLUSTER) && mount();
+}
+
+static afatfsFilePtr_t openFile(const char *filename, const char *mode)
+{
+    openCompleted = false;
+    openedFile = NULL;
+
+    if (!afatfs_fopen(filename, mode, fileOpened) || !pollUntil(&openCompleted, 10000000)) {
+        return NULL;
+    }
+
+    return openedFile;
+}
+
+static bool closeFile(afatfsFilePtr_t file)
+{
+    closeCompleted = false;
+
+    for (int i = 0; i < 10000 && !afatfs_fclose(file, fileClosed); i++) {
+        pollOnce();
+    }
+
+    return pollUntil(&closeCompleted, 10000000);
+}
+
+static uint8_t patternByte(uint32_t offset)
+{
+    // Not a divisor of the sector size, so misplaced sectors are noticed
+    return offset % 251;
+}
+
+static uint32_t writePattern(afatfsFilePtr_t file, uint32_t offset, uint32_t length)
+{
+    uint8_t buffer[256];
+
+    if (length > sizeof(buffer)) {
+        length = sizeof(buffer);
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        buffer[i] = patternByte(offset + i);
+    }
+
+    return afatfs_fwrite(file, buffer, length);
+}
+
+// Read the whole file back, returning its length or -1 if it doesn't match the pattern
+static int32_t verifyPattern(const char *filename)
+{
+    afatfsFilePtr_t file = openFile(filename, "r");
+    uint8_t buffer[512];
+    uint32_t offset = 0;
+
+    if (!file) {
+        return -1;
+    }
+
+    for (int idle = 0; !afatfs_feof(file) && idle < 100000; ) {
+        uint32_t bytesRead = afatfs_fread(file, buffer, sizeof(buffer));
+
+        if (bytesRead == 0) {
+            idle++;
+            pollOnce();
+            continue;
+        }
+
+        idle = 0;
+
+        for (uint32_t i = 0; i < bytesRead; i++, offset++) {
+            if (buffer[i] != patternByte(offset)) {
+                closeFile(file);
+                return -1;
+            }
+        }
+    }
+
+    closeFile(file);
+
+    return offset;
+}
+
+TEST(AsyncFatfsTest, MountsFreshCard)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+
+    // when
+    bool mounted = initCard(&config);
+
+    // then
+    EXPECT_TRUE(mounted);
+    EXPECT_FALSE(afatfs_isFull());
+    // nearly all of the card has been handed to the freefile
+    EXPECT_GT(afatfs_getContiguousFreeSpace(), (uint32_t)900 * 1024 * 1024);
+
+    unmount();
+}
+
+TEST(AsyncFatfsTest, WrittenDataSurvivesRemount)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    ASSERT_TRUE(initCard(&config));
+
+    // when
+    afatfsFilePtr_t file = openFile("test.txt", "w");
+    ASSERT_TRUE(file != NULL);
+
+    uint32_t written = 0;
+    while (written < 100000) {
+        written += writePattern(file, written, 200);
+        pollOnce();
+    }
+    ASSERT_TRUE(closeFile(file));
+    ASSERT_TRUE(unmount());
+    ASSERT_TRUE(mount());
+
+    // then
+    EXPECT_EQ((int32_t)written, verifyPattern("test.txt"));
+
+    unmount();
+}
+
+TEST(AsyncFatfsTest, RecoversFromCardErrors)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    ASSERT_TRUE(initCard(&config));
+
+    afatfsFilePtr_t file = openFile("errors.txt", "as");
+    ASSERT_TRUE(file != NULL);
+
+    // when
+    uint32_t written = 0;
+    for (int i = 0; written < 200000; i++) {
+        if (i % 500 == 100) {
+            sdcardSimInjectFailure(SDCARD_BLOCK_OPERATION_WRITE);
+        }
+        if (i % 500 == 300) {
+            sdcardSimInjectStall(100000);
+        }
+
+        written += writePattern(file, written, 100);
+        pollOnce();
+    }
+    ASSERT_TRUE(closeFile(file));
+
+    // then
+    EXPECT_GT(sdcardSimGetStats()->failures, 0);
+    EXPECT_EQ(AFATFS_FILESYSTEM_STATE_READY, afatfs_getFilesystemState());
+    EXPECT_EQ((int32_t)written, verifyPattern("errors.txt"));
+
+    // when
+    sdcardSimInjectFailure(SDCARD_BLOCK_OPERATION_READ);
+
+    // then
+    EXPECT_EQ((int32_t)written, verifyPattern("errors.txt"));
+
+    unmount();
+}
+
+TEST(AsyncFatfsTest, ImageFileKeepsCardContents)
+{
+    // given
+    const char *filename = "asyncfatfs_unittest.img";
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.imageFilename = filename;
+
+    remove(filename);
+    ASSERT_TRUE(initCard(&config));
+
+    afatfsFilePtr_t file = openFile("image.txt", "w");
+    ASSERT_TRUE(file != NULL);
+
+    uint32_t written = 0;
+    while (written < 5000) {
+        written += writePattern(file, written, 200);
+        pollOnce();
+    }
+    ASSERT_TRUE(closeFile(file));
+    ASSERT_TRUE(unmount());
+    sdcardSimClose();
+
+    // when
+    config.numBlocks = 0; // take the size from the image
+    ASSERT_TRUE(sdcardSimInit(&config));
+    ASSERT_TRUE(mount());
+
+    // then
+    EXPECT_EQ((int32_t)written, verifyPattern("image.txt"));
+
+    unmount();
+    sdcardSimClose();
+    remove(filename);
+}
+
+/*
+ * Throw random operations, card stalls and card errors at the filesystem and make sure that it never ends up in the
+ * fatal state and still mounts afterwards.
+ */
+TEST(AsyncFatfsTest, Fuzz)
+{
+    static const char * const filenames[] = {"a.txt", "b.txt", "c.txt", "d.bin", "e"};
+    static const char * const modes[] = {"r", "w", "a", "r+", "w+", "as", "ws"};
+    enum { MAX_FILES = 3 };
+
+    afatfsFilePtr_t files[MAX_FILES] = {NULL};
+    uint8_t buffer[700];
+
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.writeStallInterval = 97;
+    config.writeStallMicros = 20000;
+    ASSERT_TRUE(initCard(&config));
+
+    srand(42);
+
+    for (int step = 0; step < 20000; step++) {
+        int slot = rand() % MAX_FILES;
+        afatfsFilePtr_t file = files[slot];
+
+        switch (rand() % 12) {
+            case 0:
+                if (!file) {
+                    openCompleted = false;
+                    if (afatfs_fopen(filenames[rand() % 5], modes[rand() % 7], fileOpened) && pollUntil(&openCompleted, 10000000)) {
+                        files[slot] = openedFile;
+                    }
+                }
+            break;
+            case 1:
+                if (file && afatfs_fclose(file, NULL)) {
+                    files[slot] = NULL;
+                }
+            break;
+            case 2:
+                if (file && rand() % 4 == 0 && afatfs_funlink(file, NULL)) {
+                    files[slot] = NULL;
+                }
+            break;
+            case 3:
+                if (file) {
+                    afatfs_fseek(file, rand() % 20000, (afatfsSeek_e) (rand() % 3));
+                }
+            break;
+            case 4:
+            case 5:
+                if (file) {
+                    afatfs_fread(file, buffer, rand() % sizeof(buffer));
+                }
+            break;
+            case 6:
+            case 7:
+            case 8:
+                if (file) {
+                    memset(buffer, step, sizeof(buffer));
+                    afatfs_fwrite(file, buffer, rand() % sizeof(buffer));
+                }
+            break;
+            case 9:
+                if (rand() % 50 == 0) {
+                    sdcardSimInjectFailure((sdcardBlockOperation_e) (rand() % 2));
+                }
+            break;
+            case 10:
+                if (rand() % 50 == 0) {
+                    sdcardSimInjectStall(rand() % 200000);
+                }
+            break;
+            default:
+                ;
+        }
+
+        for (int i = rand() % 8; i >= 0; i--) {
+            pollOnce();
+        }
+
+        ASSERT_NE(AFATFS_FILESYSTEM_STATE_FATAL, afatfs_getFilesystemState()) << "at step " << step;
+    }
+
+    // then
+    EXPECT_TRUE(unmount());
+    EXPECT_TRUE(mount());
+    EXPECT_TRUE(unmount());
+}
+
+/*
+ * Benchmark Blackbox-style logging: the log file is created like Blackbox does it, then the main loop writes a frame
+ * every few iterations and polls the filesystem in every iteration. Bytes that don't fit in the cache are dropped, just
+ * like Blackbox ignores failed writes.
+ */
+
+#define BENCHMARK_DURATION_MICROS   10000000
+#define BENCHMARK_INTRA_INTERVAL    32
+
+typedef struct benchmarkResult_s {
+    uint32_t createMicros;
+    uint32_t bytesOffered;
+    uint32_t bytesWritten;
+    uint32_t maxPollMicros;
+} benchmarkResult_t;
+
+static void runLoggingBenchmark(const char *filename, int loopsPerFrame, int frameBytes, benchmarkResult_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    uint32_t createStart = sdcardSimMicros();
+    afatfsFilePtr_t file = openFile(filename, "as");
+    ASSERT_TRUE(file != NULL);
+    result->createMicros = sdcardSimMicros() - createStart;
+
+    maxPollMicros = 0;
+
+    uint32_t start = sdcardSimMicros();
+
+    for (int loop = 0; sdcardSimMicros() - start < BENCHMARK_DURATION_MICROS; loop++) {
+        if (loop % loopsPerFrame == 0) {
+            int frame = loop / loopsPerFrame;
+            uint32_t bytes = frame % BENCHMARK_INTRA_INTERVAL == 0 ? frameBytes * 2 : frameBytes;
+
+            result->bytesOffered += bytes;
+            while (bytes > 0) {
+                uint32_t chunk = writePattern(file, result->bytesWritten, bytes);
+
+                if (chunk == 0) {
+                    break;
+                }
+                result->bytesWritten += chunk;
+                bytes -= chunk;
+            }
+        }
+
+        pollOnce();
+    }
+
+    result->maxPollMicros = maxPollMicros;
+
+    ASSERT_TRUE(closeFile(file));
+}
+
+static void printBenchmarkResult(const char *name, const benchmarkResult_t *result)
+{
+    const sdcardSimStats_t *stats = sdcardSimGetStats();
+
+    printf("%s: created in %u us, %u bytes/s written, %u of %u bytes dropped, worst poll %u us, "
+        "%u multi-block writes, %u busy rejections\n",
+        name, result->createMicros,
+        (uint32_t) ((uint64_t) result->bytesWritten * 1000000 / BENCHMARK_DURATION_MICROS),
+        result->bytesOffered - result->bytesWritten, result->bytesOffered,
+        result->maxPollMicros, stats->multiBlockWrites, stats->busyRejections);
+}
+
+TEST(AsyncFatfsBenchmark, BlackboxLogging)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    ASSERT_TRUE(initCard(&config));
+    sdcardSimResetStats();
+
+    // when
+    benchmarkResult_t result;
+    runLoggingBenchmark("LOG00001.TXT", 4, 40, &result); // 1kHz logging
+
+    // then
+    printBenchmarkResult("1kHz logging", &result);
+    EXPECT_EQ(result.bytesOffered, result.bytesWritten);
+    EXPECT_EQ((int32_t)result.bytesWritten, verifyPattern("LOG00001.TXT"));
+
+    unmount();
+}
+
+TEST(AsyncFatfsBenchmark, HighRateLoggingWithCardStalls)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.writeStallInterval = 200;
+    config.writeStallMicros = 50000;
+    ASSERT_TRUE(initCard(&config));
+    sdcardSimResetStats();
+
+    // when
+    benchmarkResult_t result;
+    runLoggingBenchmark("LOG00001.TXT", 1, 60, &result); // 4kHz logging
+
+    // then
+    printBenchmarkResult("4kHz logging with stalls", &result);
+    EXPECT_GT(result.bytesWritten, 0);
+    EXPECT_EQ((int32_t)result.bytesWritten, verifyPattern("LOG00001.TXT"));
+
+    unmount();
+}
+
+/*
+ * Benchmark sustained throughput when a contiguous file is written as fast as the filesystem will accept data,
+ * compared to the limit imposed by the SPI bus and the card's programming time for each block of a multi-block write.
+ */
+TEST(AsyncFatfsBenchmark, SustainedStreamingWrite)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.multiWriteBusyMicros = 2; // A fast card which is ready for the next block almost as soon as it has the CRC
+    ASSERT_TRUE(initCard(&config));
+
+    afatfsFilePtr_t file = openFile("LOG00001.TXT", "as");
+    ASSERT_TRUE(file != NULL);
+    sdcardSimResetStats();
+
+    // when
+    uint32_t written = 0;
+    uint32_t start = sdcardSimMicros();
+
+    while (sdcardSimMicros() - start < BENCHMARK_DURATION_MICROS) {
+        uint32_t chunk;
+
+        do {
+            chunk = writePattern(file, written, 256);
+            written += chunk;
+        } while (chunk > 0);
+
+        pollOnce();
+    }
+
+    uint32_t elapsed = sdcardSimMicros() - start;
+    ASSERT_TRUE(closeFile(file));
+
+    // then
+    uint32_t blockNanos = (SDCARD_SIM_BLOCK_SIZE + 2) * config.spiByteNanos + config.multiWriteBusyMicros * 1000;
+    uint32_t limit = (uint64_t) SDCARD_SIM_BLOCK_SIZE * 1000000000 / blockNanos;
+    uint32_t rate = (uint64_t) written * 1000000 / elapsed;
+
+    printf("streaming write: %u bytes/s, %u%% of the %u bytes/s card limit, %u multi-block writes\n",
+        rate, (uint32_t) ((uint64_t) rate * 100 / limit), limit, sdcardSimGetStats()->multiBlockWrites);
+
+    EXPECT_EQ((int32_t)written, verifyPattern("LOG00001.TXT"));
+
+    unmount();
+}
+
+/*
+ * Benchmark how long it takes from power-on until the first byte of a new log is accepted on a 32GB card, both on a
+ * freshly formatted card and on one which is nearly full of old logs (where the log's clusters have to be found by
+ * searching the FAT). The pilot is assumed to wait a while after power-on before arming.
+ */
+
+#define LARGE_CARD_BLOCKS           (32 * 1024 * 2048) // 32GB
+#define LARGE_CARD_OCCUPIED_BLOCKS  (30 * 1024 * 2048)
+#define PRE_ARM_IDLE_MICROS         60000000
+
+/**
+ * Mark the clusters [firstCluster...endCluster) as being in use in both FATs of the simulated card, as if they held
+ * old logs.
+ */
+static void markClustersOccupied(uint32_t firstCluster, uint32_t endCluster)
+{
+    uint8_t block[SDCARD_SIM_BLOCK_SIZE];
+
+    sdcardSimReadBlockDirect(0, block);
+    uint32_t partitionStart = ((mbrPartitionEntry_t *) (block + 446))->lbaBegin;
+
+    sdcardSimReadBlockDirect(partitionStart, block);
+    fatVolumeID_t *volume = (fatVolumeID_t *) block;
+    uint32_t fatStart = partitionStart + volume->reservedSectorCount;
+    uint32_t fatSectors = volume->fatDescriptor.fat32.FATSize32;
+
+    const uint32_t entriesPerSector = SDCARD_SIM_BLOCK_SIZE / sizeof(uint32_t);
+
+    for (uint32_t fatSector = firstCluster / entriesPerSector; fatSector * entriesPerSector < endCluster; fatSector++) {
+        uint32_t *entries = (uint32_t *) block;
+
+        sdcardSimReadBlockDirect(fatStart + fatSector, block);
+
+        for (uint32_t i = 0; i < entriesPerSector; i++) {
+            uint32_t cluster = fatSector * entriesPerSector + i;
+
+            if (cluster >= firstCluster && cluster < endCluster) {
+                entries[i] = 0x0FFFFFFF; // A one-cluster file
+            }
+        }
+
+        sdcardSimWriteBlockDirect(fatStart + fatSector, block);
+        sdcardSimWriteBlockDirect(fatStart + fatSectors + fatSector, block);
+    }
+}
+
+static void runFirstWriteBenchmark(const char *name, const char *mode)
+{
+    uint32_t powerOn = sdcardSimMicros();
+
+    ASSERT_TRUE(mount());
+    uint32_t mountMicros = sdcardSimMicros() - powerOn;
+
+    while (sdcardSimMicros() - powerOn < PRE_ARM_IDLE_MICROS) {
+        pollOnce();
+    }
+
+    uint32_t arm = sdcardSimMicros();
+
+    afatfsFilePtr_t file = openFile("LOG00001.TXT", mode);
+    ASSERT_TRUE(file != NULL);
+
+    while (writePattern(file, 0, 1) == 0 && sdcardSimMicros() - arm < 600000000) {
+        pollOnce();
+    }
+
+    uint32_t firstWriteMicros = sdcardSimMicros() - arm;
+
+    printf("%s: mounted in %u ms, first write %u ms after arming, %u blocks read\n",
+        name, mountMicros / 1000, firstWriteMicros / 1000, sdcardSimGetStats()->blocksRead);
+
+    EXPECT_LT(firstWriteMicros, 600000000u);
+
+    ASSERT_TRUE(closeFile(file));
+}
+
+TEST(AsyncFatfsBenchmark, FirstWriteOnFreshLargeCard)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.numBlocks = LARGE_CARD_BLOCKS;
+    ASSERT_TRUE(sdcardSimInit(&config));
+    ASSERT_TRUE(sdcardSimFormatFAT32(TEST_SECTORS_PER_CLUSTER));
+
+    // then
+    runFirstWriteBenchmark("fresh 32GB card", "as");
+
+    unmount();
+}
+
+TEST(AsyncFatfsBenchmark, FirstWriteOnNearlyFullLargeCard)
+{
+    // given
+    sdcardSimConfig_t config;
+    sdcardSimDefaultConfig(&config);
+    config.numBlocks = LARGE_CARD_BLOCKS;
+    ASSERT_TRUE(sdcardSimInit(&config));
+    ASSERT_TRUE(sdcardSimFormatFAT32(TEST_SECTORS_PER_CLUSTER));
+    markClustersOccupied(FAT_SMALLEST_LEGAL_CLUSTER_NUMBER + 1, LARGE_CARD_OCCUPIED_BLOCKS / TEST_SECTORS_PER_CLUSTER);
+
+    // The freefile is created from the free space at the end of the card
+    ASSERT_TRUE(mount());
+    ASSERT_TRUE(unmount());
+    sdcardSimResetStats();
+
+    // then
+    runFirstWriteBenchmark("nearly full 32GB card", "a");
+
+    unmount();
+}
@@ -0,0 +1,430 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "blackbox/blackbox_log_reader.h"
+
+    #include "drivers/sdcard.h"
+
+    #include "fc/runtime_config.h"
+
+    #include "io/asyncfatfs/asyncfatfs.h"
+
+    #include "sdcard_sim.h"
+
+    bool blackboxSDCardChangeIntoLogDirectory(void);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_SECTORS_PER_CLUSTER 8
+
+// The main loop calls afatfs_poll() once per iteration, and the log reader task runs every 2ms
+#define TEST_LOOP_MICROS        250
+#define TEST_READER_TASK_LOOPS  8
+
+// The host gets a reply to one read request per USB frame
+#define TEST_HOST_REQUEST_LOOPS 4
+
+#define TEST_LOG_COUNT          11
+
+static bool blackboxLogging;
+static uint32_t loopCount;
+
+static void pollOnce(void)
+{
+    afatfs_poll();
+
+    if (++loopCount % TEST_READER_TASK_LOOPS == 0) {
+        blackboxLogReaderPoll();
+    }
+
+    sdcardSimAdvanceMicros(TEST_LOOP_MICROS);
+}
+
+static bool mount(void)
+{
+    afatfs_init();
+    sdcard_init(true);
+
+    for (int i = 0; i < 1000000 && afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_INITIALIZATION; i++) {
+        pollOnce();
+    }
+
+    return afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_READY;
+}
+
+static void unmount(void)
+{
+    for (int i = 0; i < 100000 && !afatfs_destroy(false); i++) {
+        sdcardSimAdvanceMicros(TEST_LOOP_MICROS);
+    }
+}
+
+static afatfsFilePtr_t openedFile;
+static bool openCompleted;
+
+static void fileOpened(afatfsFilePtr_t file)
+{
+    openedFile = file;
+    openCompleted = true;
+}
+
+static uint8_t patternByte(int logIndex, uint32_t offset)
+{
+    return (offset + logIndex * 7) % 251;
+}
+
+static uint32_t logSize(int logIndex)
+{
+    return 1000 + logIndex * 9973;
+}
+
+static void createLog(int logIndex)
+{
+    char filename[20];
+
+    snprintf(filename, sizeof(filename), "LOG%05d.TXT", logIndex + 1);
+
+    openCompleted = false;
+    afatfs_fopen(filename, "as", fileOpened);
+    while (!openCompleted) {
+        pollOnce();
+    }
+    ASSERT_TRUE(openedFile != NULL);
+
+    for (uint32_t offset = 0; offset < logSize(logIndex); ) {
+        uint8_t buffer[256];
+        uint32_t length = logSize(logIndex) - offset;
+
+        if (length > sizeof(buffer)) {
+            length = sizeof(buffer);
+        }
+
+        for (uint32_t i = 0; i < length; i++) {
+            buffer[i] = patternByte(logIndex, offset + i);
+        }
+
+        offset += afatfs_fwrite(openedFile, buffer, length);
+        pollOnce();
+    }
+
+    while (!afatfs_fclose(openedFile, NULL)) {
+        pollOnce();
+    }
+}
+
+/**
+ * Make a card with some logs on it, and another file in the log directory which isn't a log.
+ */
+static void initCardWithLogs(void)
+{
+    sdcardSimConfig_t config;
+
+    sdcardSimDefaultConfig(&config);
+    ASSERT_TRUE(sdcardSimInit(&config));
+    ASSERT_TRUE(sdcardSimFormatFAT32(TEST_SECTORS_PER_CLUSTER));
+    ASSERT_TRUE(mount());
+
+    while (!blackboxSDCardChangeIntoLogDirectory()) {
+        pollOnce();
+    }
+
+    openCompleted = false;
+    afatfs_fopen("NOTES.TXT", "w", fileOpened);
+    while (!openCompleted) {
+        pollOnce();
+    }
+    afatfs_fwrite(openedFile, (const uint8_t *) "hello", 5);
+    while (!afatfs_fclose(openedFile, NULL)) {
+        pollOnce();
+    }
+
+    for (int i = 0; i < TEST_LOG_COUNT; i++) {
+        createLog(i);
+    }
+
+    // Let all the writes reach the card
+    for (int i = 0; i < 10000 && !afatfs_flush(); i++) {
+        pollOnce();
+    }
+}
+
+static blackboxLogReaderStatus_e openLog(const char *filename)
+{
+    blackboxLogReaderStatus_e status;
+
+    for (int i = 0; i < 10000; i++) {
+        status = blackboxLogReaderOpen(filename);
+
+        if (status != BLACKBOX_LOG_READER_BUSY) {
+            break;
+        }
+
+        pollOnce();
+    }
+
+    return status;
+}
+
+/**
+ * Download the open log the way a ground station would, returning the number of bytes that matched the expected
+ * contents of the given log.
+ */
+static uint32_t downloadLog(int logIndex, uint32_t startOffset, uint32_t *elapsedMicros)
+{
+    uint32_t offset = startOffset;
+    uint32_t start = sdcardSimMicros();
+
+    for (int i = 0; i < 1000000; i++) {
+        if (i % TEST_HOST_REQUEST_LOOPS == 0) {
+            const uint8_t *data;
+            uint16_t length;
+            uint32_t fileSize;
+
+            blackboxLogReaderStatus_e status = blackboxLogReaderRead(offset, &data, &length, &fileSize);
+
+            if (status == BLACKBOX_LOG_READER_FAILED) {
+                break;
+            }
+
+            if (status == BLACKBOX_LOG_READER_READY) {
+                if (length == 0) {
+                    // End of the log
+                    break;
+                }
+
+                for (uint16_t j = 0; j < length; j++, offset++) {
+                    if (data[j] != patternByte(logIndex, offset)) {
+                        return offset - startOffset;
+                    }
+                }
+            }
+        }
+
+        pollOnce();
+    }
+
+    if (elapsedMicros) {
+        *elapsedMicros = sdcardSimMicros() - start;
+    }
+
+    return offset - startOffset;
+}
+
+// Stand in for the Blackbox device, which owns the log directory
+static enum {
+    LOG_DIRECTORY_INITIAL,
+    LOG_DIRECTORY_WAITING,
+    LOG_DIRECTORY_CHANGE_INTO,
+    LOG_DIRECTORY_READY,
+} logDirectoryState;
+
+static afatfsFilePtr_t logDirectory;
+
+static void logDirectoryCreated(afatfsFilePtr_t directory)
+{
+    logDirectory = directory;
+    logDirectoryState = directory ? LOG_DIRECTORY_CHANGE_INTO : LOG_DIRECTORY_INITIAL;
+}
+
+class BlackboxLogReaderTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        armingFlags = 0;
+        blackboxLogging = false;
+        logDirectoryState = LOG_DIRECTORY_INITIAL;
+
+        initCardWithLogs();
+    }
+
+    virtual void TearDown() {
+        blackboxLogReaderClose();
+
+        for (int i = 0; i < 100; i++) {
+            pollOnce();
+        }
+
+        unmount();
+        sdcardSimClose();
+    }
+};
+
+TEST_F(BlackboxLogReaderTest, ListsLogsInPages)
+{
+    // given
+    const blackboxLogReaderEntry_t *entries = NULL;
+    uint8_t count = 0;
+    bool more = false;
+    blackboxLogReaderStatus_e status = BLACKBOX_LOG_READER_BUSY;
+
+    // when
+    for (int i = 0; i < 10000 && status == BLACKBOX_LOG_READER_BUSY; i++) {
+        status = blackboxLogReaderList(0, &entries, &count, &more);
+        pollOnce();
+    }
+
+    // then
+    EXPECT_EQ(BLACKBOX_LOG_READER_READY, status);
+    EXPECT_EQ(BLACKBOX_LOG_READER_LIST_PAGE_SIZE, count);
+    EXPECT_TRUE(more);
+    EXPECT_EQ(0, memcmp(entries[0].filename, "LOG00001TXT", FAT_FILENAME_LENGTH));
+    EXPECT_EQ(logSize(0), entries[0].size);
+    EXPECT_EQ(logSize(7), entries[7].size);
+
+    // when
+    status = BLACKBOX_LOG_READER_BUSY;
+    for (int i = 0; i < 10000 && status == BLACKBOX_LOG_READER_BUSY; i++) {
+        status = blackboxLogReaderList(BLACKBOX_LOG_READER_LIST_PAGE_SIZE, &entries, &count, &more);
+        pollOnce();
+    }
+
+    // then
+    EXPECT_EQ(BLACKBOX_LOG_READER_READY, status);
+    EXPECT_EQ(TEST_LOG_COUNT - BLACKBOX_LOG_READER_LIST_PAGE_SIZE, count);
+    EXPECT_FALSE(more);
+    EXPECT_EQ(0, memcmp(entries[count - 1].filename, "LOG00011TXT", FAT_FILENAME_LENGTH));
+}
+
+TEST_F(BlackboxLogReaderTest, DownloadsLog)
+{
+    // given
+    int logIndex = TEST_LOG_COUNT - 1;
+    uint32_t elapsed;
+
+    ASSERT_EQ(BLACKBOX_LOG_READER_READY, openLog("LOG00011TXT"));
+
+    // when
+    uint32_t downloaded = downloadLog(logIndex, 0, &elapsed);
+
+    // then
+    EXPECT_EQ(logSize(logIndex), downloaded);
+
+    printf("log download: %u bytes in %u ms, %u bytes/s\n", downloaded, elapsed / 1000,
+        (uint32_t) ((uint64_t) downloaded * 1000000 / elapsed));
+}
+
+TEST_F(BlackboxLogReaderTest, SeeksWhenHostSkipsAhead)
+{
+    // given
+    int logIndex = 5;
+    uint32_t startOffset = 12345;
+
+    ASSERT_EQ(BLACKBOX_LOG_READER_READY, openLog("LOG00006TXT"));
+
+    // when
+    uint32_t downloaded = downloadLog(logIndex, startOffset, NULL);
+
+    // then
+    EXPECT_EQ(logSize(logIndex) - startOffset, downloaded);
+}
+
+TEST_F(BlackboxLogReaderTest, FailsToOpenMissingLog)
+{
+    EXPECT_EQ(BLACKBOX_LOG_READER_FAILED, openLog("LOG00099TXT"));
+}
+
+TEST_F(BlackboxLogReaderTest, GivesUpWhenArmed)
+{
+    // given
+    ASSERT_EQ(BLACKBOX_LOG_READER_READY, openLog("LOG00002TXT"));
+
+    // when
+    ENABLE_ARMING_FLAG(ARMED);
+    blackboxLogging = true;
+
+    for (int i = 0; i < 100; i++) {
+        pollOnce();
+    }
+
+    // then
+    const uint8_t *data;
+    uint16_t length;
+    uint32_t fileSize;
+
+    EXPECT_EQ(BLACKBOX_LOG_READER_FAILED, blackboxLogReaderRead(0, &data, &length, &fileSize));
+
+    // The log's file handle was given back, so Blackbox can open its files
+    afatfsFilePtr_t files[2];
+
+    for (int i = 0; i < 2; i++) {
+        openCompleted = false;
+        afatfs_fopen(i == 0 ? "A.TXT" : "B.TXT", "w", fileOpened);
+        while (!openCompleted) {
+            pollOnce();
+        }
+        files[i] = openedFile;
+        EXPECT_TRUE(files[i] != NULL);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        while (files[i] && !afatfs_fclose(files[i], NULL)) {
+            pollOnce();
+        }
+    }
+
+    // when
+    DISABLE_ARMING_FLAG(ARMED);
+    blackboxLogging = false;
+
+    // then
+    EXPECT_EQ(BLACKBOX_LOG_READER_READY, openLog("LOG00002TXT"));
+    EXPECT_EQ(logSize(1), downloadLog(1, 0, NULL));
+}
+
+// STUBS
+
+extern "C" {
+
+uint8_t armingFlags;
+
+bool blackboxMayEditConfig()
+{
+    return !blackboxLogging;
+}
+
+bool blackboxSDCardChangeIntoLogDirectory(void)
+{
+    switch (logDirectoryState) {
+        case LOG_DIRECTORY_INITIAL:
+            logDirectoryState = LOG_DIRECTORY_WAITING;
+            afatfs_mkdir("logs", logDirectoryCreated);
+        break;
+
+        case LOG_DIRECTORY_CHANGE_INTO:
+            if (afatfs_chdir(logDirectory)) {
+                afatfs_fclose(logDirectory, NULL);
+                logDirectoryState = LOG_DIRECTORY_READY;
+            }
+        break;
+
+        default:
+            ;
+    }
+
+    return logDirectoryState == LOG_DIRECTORY_READY;
+}
+
+}
@@ -0,0 +1,376 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/flash_m25p16.h"
+
+#include "flash_m25p16_sim.h"
+
+// The same timeouts that the real driver uses
+#define DEFAULT_TIMEOUT_MILLIS       6
+#define SECTOR_ERASE_TIMEOUT_MILLIS  5000
+#define BULK_ERASE_TIMEOUT_MILLIS    21000
+
+// Bytes clocked for each command, excluding data
+#define COMMAND_WITH_ADDRESS_BYTES   4
+#define READ_STATUS_BYTES            2
+
+static flashGeometry_t geometry = {.pageSize = M25P16_PAGESIZE};
+
+static flashSimConfig_t simConfig;
+static flashSimStats_t stats;
+
+static uint8_t *memory = NULL;
+static uint8_t *programmed = NULL; // One flag per byte, set when a byte has been programmed since it was last erased
+static FILE *imageFile = NULL;
+
+static uint64_t nowNanos = 0;
+static uint64_t busyUntilNanos = 0;
+
+// Page program in progress
+static bool programming = false;
+static bool programIgnored = false;
+static uint32_t programAddress;
+static uint32_t programLength;
+
+static void flashSimSpiTransfer(int bytes)
+{
+    nowNanos += (uint64_t) bytes * simConfig.spiByteNanos;
+}
+
+static bool flashSimIsBusy(void)
+{
+    return nowNanos < busyUntilNanos;
+}
+
+static void flashSimWriteThrough(uint32_t address, uint32_t length)
+{
+    if (imageFile) {
+        fseek(imageFile, address, SEEK_SET);
+        fwrite(memory + address, 1, length, imageFile);
+    }
+}
+
+static void flashSimErase(uint32_t start, uint32_t length)
+{
+    memset(memory + start, 0xFF, length);
+    memset(programmed + start, 0, length);
+
+    flashSimWriteThrough(start, length);
+}
+
+void flashSimDefaultConfig(flashSimConfig_t *config)
+{
+    memset(config, 0, sizeof(*config));
+
+    // M25P16: 2MB
+    config->sectors = 32;
+    config->pagesPerSector = 256;
+
+    config->pageProgramMicros = 640;
+    config->sectorEraseMicros = 600000;
+    config->bulkEraseMicros = 13000000;
+
+    // About 18MHz SPI clock
+    config->spiByteNanos = 450;
+}
+
+/**
+ * Create the simulated device. If an image filename is configured, the flash contents are loaded from that file if it
+ * exists (the remainder of the device is erased) and all changes are written through to it.
+ */
+bool flashSimInit(const flashSimConfig_t *config)
+{
+    flashSimClose();
+
+    simConfig = *config;
+
+    geometry.sectors = config->sectors;
+    geometry.pagesPerSector = config->pagesPerSector;
+    geometry.sectorSize = geometry.pagesPerSector * geometry.pageSize;
+    geometry.totalSize = geometry.sectorSize * geometry.sectors;
+
+    memory = malloc(geometry.totalSize);
+    programmed = calloc(geometry.totalSize, 1);
+
+    if (!memory || !programmed) {
+        flashSimClose();
+        return false;
+    }
+
+    memset(memory, 0xFF, geometry.totalSize);
+
+    if (config->imageFilename) {
+        imageFile = fopen(config->imageFilename, "r+b");
+
+        if (imageFile) {
+            size_t loaded = fread(memory, 1, geometry.totalSize, imageFile);
+
+            for (size_t i = 0; i < loaded; i++) {
+                programmed[i] = memory[i] != 0xFF;
+            }
+        } else {
+            imageFile = fopen(config->imageFilename, "w+b");
+
+            if (!imageFile) {
+                flashSimClose();
+                return false;
+            }
+        }
+
+        flashSimWriteThrough(0, geometry.totalSize);
+    }
+
+    nowNanos = 0;
+    busyUntilNanos = 0;
+    programming = false;
+
+    flashSimResetStats();
+
+    return true;
+}
+
+void flashSimClose(void)
+{
+    if (imageFile) {
+        fclose(imageFile);
+        imageFile = NULL;
+    }
+
+    free(memory);
+    free(programmed);
+
+    memory = NULL;
+    programmed = NULL;
+
+    geometry.sectors = 0;
+    geometry.pagesPerSector = 0;
+    geometry.sectorSize = 0;
+    geometry.totalSize = 0;
+}
+
+/**
+ * Set the flash contents in the range [start...end) directly, bytes which aren't 0xFF are considered programmed.
+ */
+void flashSimFill(uint32_t start, uint32_t end, uint8_t value)
+{
+    memset(memory + start, value, end - start);
+    memset(programmed + start, value != 0xFF, end - start);
+
+    flashSimWriteThrough(start, end - start);
+}
+
+const uint8_t *flashSimGetMemory(void)
+{
+    return memory;
+}
+
+bool flashSimIsProgrammed(uint32_t address)
+{
+    return programmed[address];
+}
+
+uint32_t flashSimMicros(void)
+{
+    return nowNanos / 1000;
+}
+
+void flashSimAdvanceMicros(uint32_t delta)
+{
+    nowNanos += (uint64_t) delta * 1000;
+}
+
+const flashSimStats_t *flashSimGetStats(void)
+{
+    return &stats;
+}
+
+void flashSimResetStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+// m25p16 driver API
+
+bool m25p16_init(ioTag_t csTag)
+{
+    (void) csTag;
+
+    return geometry.sectors > 0;
+}
+
+bool m25p16_isReady()
+{
+    flashSimSpiTransfer(READ_STATUS_BYTES);
+
+    return !flashSimIsBusy();
+}
+
+bool m25p16_waitForReady(uint32_t timeoutMillis)
+{
+    if (!m25p16_isReady()) {
+        uint64_t deadline = nowNanos + (uint64_t) timeoutMillis * 1000000;
+        uint64_t waitStart = nowNanos;
+
+        nowNanos = busyUntilNanos < deadline ? busyUntilNanos : deadline;
+
+        uint32_t waitedMicros = (nowNanos - waitStart) / 1000;
+
+        stats.blockingWaits++;
+        stats.blockingMicros += waitedMicros;
+        if (waitedMicros > stats.maxBlockingMicros) {
+            stats.maxBlockingMicros = waitedMicros;
+        }
+    }
+
+    return !flashSimIsBusy();
+}
+
+void m25p16_eraseSector(uint32_t address)
+{
+    m25p16_waitForReady(SECTOR_ERASE_TIMEOUT_MILLIS);
+
+    flashSimSpiTransfer(1 + COMMAND_WITH_ADDRESS_BYTES); // Write enable and the erase command itself
+
+    if (flashSimIsBusy()) {
+        stats.commandsWhileBusy++;
+        return;
+    }
+
+    uint32_t sector = (address % geometry.totalSize) / geometry.sectorSize;
+
+    flashSimErase(sector * geometry.sectorSize, geometry.sectorSize);
+
+    if (stats.sectorErases < FLASH_SIM_ERASE_LOG_SIZE) {
+        stats.eraseLog[stats.sectorErases] = sector;
+    }
+    stats.sectorErases++;
+
+    busyUntilNanos = nowNanos + (uint64_t) simConfig.sectorEraseMicros * 1000;
+}
+
+void m25p16_eraseCompletely()
+{
+    m25p16_waitForReady(BULK_ERASE_TIMEOUT_MILLIS);
+
+    flashSimSpiTransfer(2);
+
+    if (flashSimIsBusy()) {
+        stats.commandsWhileBusy++;
+        return;
+    }
+
+    flashSimErase(0, geometry.totalSize);
+
+    stats.bulkErases++;
+
+    busyUntilNanos = nowNanos + (uint64_t) simConfig.bulkEraseMicros * 1000;
+}
+
+void m25p16_pageProgramBegin(uint32_t address)
+{
+    m25p16_waitForReady(DEFAULT_TIMEOUT_MILLIS);
+
+    flashSimSpiTransfer(1 + COMMAND_WITH_ADDRESS_BYTES);
+
+    programming = true;
+    programIgnored = flashSimIsBusy();
+    programAddress = address % geometry.totalSize;
+    programLength = 0;
+
+    if (programIgnored) {
+        stats.commandsWhileBusy++;
+    }
+}
+
+void m25p16_pageProgramContinue(const uint8_t *data, int length)
+{
+    flashSimSpiTransfer(length);
+
+    if (!programming || programIgnored) {
+        return;
+    }
+
+    const uint32_t pageStart = programAddress - programAddress % geometry.pageSize;
+
+    for (int i = 0; i < length; i++) {
+        // Like the real device, the address wraps around within the page
+        uint32_t address = pageStart + (programAddress + programLength) % geometry.pageSize;
+
+        if (programmed[address]) {
+            stats.programOverUnerased++;
+        }
+
+        programmed[address] = 1;
+        memory[address] &= data[i];
+
+        programLength++;
+    }
+}
+
+void m25p16_pageProgramFinish()
+{
+    if (programming && !programIgnored && programLength > 0) {
+        uint32_t bytes = programLength < geometry.pageSize ? programLength : geometry.pageSize;
+
+        stats.pagePrograms++;
+        stats.bytesProgrammed += programLength;
+
+        flashSimWriteThrough(programAddress - programAddress % geometry.pageSize, geometry.pageSize);
+
+        busyUntilNanos = nowNanos + (uint64_t) simConfig.pageProgramMicros * 1000 * bytes / geometry.pageSize;
+    }
+
+    programming = false;
+}
+
+void m25p16_pageProgram(uint32_t address, const uint8_t *data, int length)
+{
+    m25p16_pageProgramBegin(address);
+
+    m25p16_pageProgramContinue(data, length);
+
+    m25p16_pageProgramFinish();
+}
+
+int m25p16_readBytes(uint32_t address, uint8_t *buffer, int length)
+{
+    if (!m25p16_waitForReady(DEFAULT_TIMEOUT_MILLIS)) {
+        return 0;
+    }
+
+    flashSimSpiTransfer(COMMAND_WITH_ADDRESS_BYTES + length);
+
+    for (int i = 0; i < length; i++) {
+        // Reads wrap around the end of the device
+        buffer[i] = memory[(address + i) % geometry.totalSize];
+    }
+
+    stats.bytesRead += length;
+
+    return length;
+}
+
+const flashGeometry_t* m25p16_getGeometry()
+{
+    return &geometry;
+}
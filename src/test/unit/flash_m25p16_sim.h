@@ -0,0 +1,75 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Simulated M25P16 flash chip for host tests, implementing the m25p16_* API from drivers/flash_m25p16.h.
+ *
+ * The simulator keeps a virtual clock in microseconds. SPI transfers advance the clock by the configured time per
+ * byte, program and erase commands keep the device busy for their configured durations, and m25p16_waitForReady()
+ * advances the clock until the device becomes ready (or the timeout expires), recording a blocking event.
+ */
+
+#define FLASH_SIM_ERASE_LOG_SIZE 64
+
+typedef struct flashSimConfig_s {
+    uint16_t sectors;
+    uint16_t pagesPerSector;
+
+    // Busy times, defaults are the typical figures from the M25P16 datasheet
+    uint32_t pageProgramMicros;     // For a full page, shorter programs take proportionally less time
+    uint32_t sectorEraseMicros;
+    uint32_t bulkEraseMicros;
+    uint32_t spiByteNanos;          // Time to clock one byte over the SPI bus
+
+    const char *imageFilename;      // Backing file for the flash contents, or NULL to keep them in RAM only
+} flashSimConfig_t;
+
+typedef struct flashSimStats_s {
+    uint32_t pagePrograms;
+    uint32_t bytesProgrammed;
+    uint32_t bytesRead;
+    uint32_t sectorErases;
+    uint32_t bulkErases;
+
+    uint32_t programOverUnerased;   // Bytes programmed without being erased first
+    uint32_t commandsWhileBusy;     // Program and erase commands that the real device would have ignored
+
+    uint32_t blockingWaits;         // Calls to m25p16_waitForReady() which had to wait for the device
+    uint32_t blockingMicros;        // Total time spent waiting in those calls
+    uint32_t maxBlockingMicros;
+
+    uint16_t eraseLog[FLASH_SIM_ERASE_LOG_SIZE]; // Indexes of the first erased sectors, in order
+} flashSimStats_t;
+
+void flashSimDefaultConfig(flashSimConfig_t *config);
+bool flashSimInit(const flashSimConfig_t *config);
+void flashSimClose(void);
+
+void flashSimFill(uint32_t start, uint32_t end, uint8_t value);
+const uint8_t *flashSimGetMemory(void);
+bool flashSimIsProgrammed(uint32_t address);
+
+uint32_t flashSimMicros(void);
+void flashSimAdvanceMicros(uint32_t delta);
+
+const flashSimStats_t *flashSimGetStats(void);
+void flashSimResetStats(void);
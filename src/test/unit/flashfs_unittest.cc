@@ -0,0 +1,336 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "drivers/flash_m25p16.h"
+    #include "io/flashfs.h"
+
+    #include "flash_m25p16_sim.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_FLASH_SECTORS 8
+#define TEST_FLASH_PAGES_PER_SECTOR 16
+#define TEST_FLASH_SECTOR_SIZE (TEST_FLASH_PAGES_PER_SECTOR * M25P16_PAGESIZE)
+#define TEST_FLASH_SIZE (TEST_FLASH_SECTORS * TEST_FLASH_SECTOR_SIZE)
+
+// Time the erase-ahead task is given between write attempts
+#define TEST_TASK_INTERVAL_MICROS 1000
+
+static void initSmallFlash(uint8_t fill)
+{
+    flashSimConfig_t config;
+
+    flashSimDefaultConfig(&config);
+    config.sectors = TEST_FLASH_SECTORS;
+    config.pagesPerSector = TEST_FLASH_PAGES_PER_SECTOR;
+    config.sectorEraseMicros = 3 * TEST_TASK_INTERVAL_MICROS;
+
+    flashSimInit(&config);
+    flashSimFill(0, TEST_FLASH_SIZE, fill);
+}
+
+// Simulate the erase-ahead task running between writes, then make sure the written data reaches the flash
+static void writeAndDrain(const uint8_t *data, unsigned int len)
+{
+    for (int i = 0; i < 10; i++) {
+        flashSimAdvanceMicros(TEST_TASK_INTERVAL_MICROS);
+        flashfsEraseAhead();
+    }
+
+    flashfsWrite(data, len, false);
+
+    for (int i = 0; i < 100 && !flashfsFlushAsync(); i++) {
+        flashSimAdvanceMicros(TEST_TASK_INTERVAL_MICROS);
+        flashfsEraseAhead();
+    }
+}
+
+TEST(FlashfsUnittest, TestRollingModeErasesAheadBeforeWriting)
+{
+    // given
+    initSmallFlash(0x00); // dirty chip
+    flashfsSetRollingMode(2, true);
+
+    // when
+    flashfsInit();
+
+    // then
+    EXPECT_EQ(0, flashfsGetOffset());
+    EXPECT_FALSE(flashfsIsEOF());
+
+    // when
+    for (int i = 0; i < 20; i++) {
+        flashSimAdvanceMicros(TEST_TASK_INTERVAL_MICROS);
+        flashfsEraseAhead();
+    }
+
+    // then
+    const flashSimStats_t *stats = flashSimGetStats();
+    EXPECT_EQ(2, stats->sectorErases);
+    EXPECT_EQ(0, stats->eraseLog[0]);
+    EXPECT_EQ(1, stats->eraseLog[1]);
+    EXPECT_EQ(0, stats->commandsWhileBusy);
+    EXPECT_EQ(0, stats->blockingWaits);
+
+    // when
+    uint8_t data[100];
+    memset(data, 0x55, sizeof(data));
+    for (int i = 0; i < 100; i++) {
+        writeAndDrain(data, sizeof(data));
+    }
+
+    // then
+    EXPECT_EQ(0, stats->programOverUnerased);
+    EXPECT_EQ(0, stats->commandsWhileBusy);
+    EXPECT_EQ(0x55, flashSimGetMemory()[0]);
+    EXPECT_EQ(0x55, flashSimGetMemory()[TEST_FLASH_SECTOR_SIZE * 2 + 1]);
+}
+
+TEST(FlashfsUnittest, TestRollingModeWrapsAndNeverErasesNewestData)
+{
+    // given
+    initSmallFlash(0x00);
+    flashfsSetRollingMode(TEST_FLASH_SECTORS, true);
+    flashfsInit();
+
+    // when
+    uint8_t data[50];
+    for (int i = 0; i < 1200; i++) {
+        memset(data, i, sizeof(data));
+        writeAndDrain(data, sizeof(data));
+    }
+    flashfsFlushSync();
+
+    // then
+    EXPECT_EQ(0, flashSimGetStats()->programOverUnerased);
+    EXPECT_FALSE(flashfsIsEOF());
+    EXPECT_LT(flashfsGetOffset(), (uint32_t)TEST_FLASH_SIZE);
+
+    // the sector holding the byte before the write pointer must not have been erased since it was written
+    uint32_t lastWritten = (flashfsGetOffset() + TEST_FLASH_SIZE - 1) % TEST_FLASH_SIZE;
+    EXPECT_TRUE(flashSimIsProgrammed(lastWritten));
+    EXPECT_EQ((uint8_t)1199, flashSimGetMemory()[lastWritten]);
+}
+
+TEST(FlashfsUnittest, TestRollingModeResumesAfterPreviousFreeSpace)
+{
+    // given
+    initSmallFlash(0xFF);
+    flashSimFill(0, TEST_FLASH_SECTOR_SIZE + 2048, 0x00);
+    flashfsSetRollingMode(1, true);
+
+    // when
+    flashfsInit();
+
+    // then
+    EXPECT_EQ((uint32_t)TEST_FLASH_SECTOR_SIZE + 2048, flashfsGetOffset());
+}
+
+TEST(FlashfsUnittest, TestRollingModeWithoutWrapStopsAtEnd)
+{
+    // given
+    initSmallFlash(0xFF);
+    flashfsSetRollingMode(1, false);
+    flashfsInit();
+
+    // when
+    uint8_t data[50];
+    memset(data, 0xAA, sizeof(data));
+    for (int i = 0; i < 700; i++) {
+        writeAndDrain(data, sizeof(data));
+    }
+
+    // then
+    EXPECT_TRUE(flashfsIsEOF());
+    EXPECT_EQ(0, flashSimGetStats()->programOverUnerased);
+}
+
+/*
+ * Benchmark flashfs with blackbox-like traffic on a simulated M25P16: a 1kHz log of inter frames with an intra
+ * frame every 32 iterations, written a byte at a time and flushed once per iteration like Blackbox does, with the
+ * erase-ahead task running at its scheduled rate.
+ */
+
+#define BENCHMARK_LOOP_MICROS       1000
+#define BENCHMARK_DURATION_MICROS   5000000
+#define BENCHMARK_INTER_FRAME_BYTES 40
+#define BENCHMARK_INTRA_FRAME_BYTES 90
+#define BENCHMARK_INTRA_INTERVAL    32
+#define BENCHMARK_ERASE_TASK_MICROS 20000
+
+typedef struct benchmarkResult_s {
+    uint32_t bytesOffered;
+    uint32_t bytesDropped;
+    uint32_t bytesWritten;
+    uint32_t peakBufferUsed;
+    uint32_t elapsedMicros;
+} benchmarkResult_t;
+
+static void runBlackboxBenchmark(benchmarkResult_t *result)
+{
+    uint32_t lastEraseTaskAt = 0;
+    uint32_t startOffset = flashfsGetOffset();
+
+    memset(result, 0, sizeof(*result));
+    flashSimResetStats();
+
+    uint32_t startMicros = flashSimMicros();
+
+    for (uint32_t iteration = 0; flashSimMicros() - startMicros < BENCHMARK_DURATION_MICROS; iteration++) {
+        uint32_t loopStart = flashSimMicros();
+        int frameBytes = iteration % BENCHMARK_INTRA_INTERVAL == 0 ? BENCHMARK_INTRA_FRAME_BYTES : BENCHMARK_INTER_FRAME_BYTES;
+
+        for (int i = 0; i < frameBytes; i++) {
+            result->bytesOffered++;
+
+            // Writing a byte into a full buffer would overwrite buffered data, so count it as dropped instead
+            if (flashfsGetWriteBufferFreeSpace() == 0) {
+                result->bytesDropped++;
+            } else {
+                flashfsWriteByte(i);
+            }
+        }
+
+        uint32_t bufferUsed = flashfsGetWriteBufferSize() - flashfsGetWriteBufferFreeSpace();
+        if (bufferUsed > result->peakBufferUsed) {
+            result->peakBufferUsed = bufferUsed;
+        }
+
+        flashfsFlushAsync();
+
+        if (flashSimMicros() - lastEraseTaskAt >= BENCHMARK_ERASE_TASK_MICROS) {
+            lastEraseTaskAt = flashSimMicros();
+            flashfsEraseAhead();
+        }
+
+        // The rest of the loop is spent elsewhere
+        uint32_t spent = flashSimMicros() - loopStart;
+        if (spent < BENCHMARK_LOOP_MICROS) {
+            flashSimAdvanceMicros(BENCHMARK_LOOP_MICROS - spent);
+        }
+    }
+
+    flashfsFlushSync();
+
+    result->bytesWritten = flashfsGetOffset() - startOffset;
+    result->elapsedMicros = flashSimMicros() - startMicros;
+}
+
+static void printBenchmarkResult(const char *name, const benchmarkResult_t *result)
+{
+    const flashSimStats_t *stats = flashSimGetStats();
+
+    printf("%s: %u bytes/s written, %u of %u bytes dropped, peak buffer %u/%u, "
+        "%u sector erases, %u blocking waits (%u us total, %u us max)\n",
+        name,
+        (uint32_t) ((uint64_t) result->bytesWritten * 1000000 / result->elapsedMicros),
+        result->bytesDropped, result->bytesOffered,
+        result->peakBufferUsed, flashfsGetWriteBufferSize(),
+        stats->sectorErases, stats->blockingWaits, stats->blockingMicros, stats->maxBlockingMicros);
+}
+
+TEST(FlashfsBenchmark, BlackboxTrafficOnErasedChip)
+{
+    // given
+    flashSimConfig_t config;
+    flashSimDefaultConfig(&config);
+    flashSimInit(&config);
+
+    flashfsSetRollingMode(0, false);
+    flashfsInit();
+
+    // when
+    benchmarkResult_t result;
+    runBlackboxBenchmark(&result);
+
+    // then
+    printBenchmarkResult("erased chip", &result);
+
+    EXPECT_EQ(0, result.bytesDropped);
+    EXPECT_EQ(result.bytesOffered, result.bytesWritten);
+    EXPECT_EQ(0, flashSimGetStats()->programOverUnerased);
+    EXPECT_EQ(0, flashSimGetStats()->commandsWhileBusy);
+}
+
+TEST(FlashfsBenchmark, BlackboxTrafficOnDirtyChipInRollingMode)
+{
+    // given
+    flashSimConfig_t config;
+    flashSimDefaultConfig(&config);
+    flashSimInit(&config);
+    flashSimFill(0, flashfsGetSize(), 0x00);
+
+    flashfsSetRollingMode(2, true);
+    flashfsInit();
+
+    // when
+    benchmarkResult_t result;
+    runBlackboxBenchmark(&result);
+
+    // then
+    printBenchmarkResult("dirty chip, rolling", &result);
+
+    EXPECT_EQ(0, flashSimGetStats()->programOverUnerased);
+    EXPECT_EQ(0, flashSimGetStats()->commandsWhileBusy);
+    EXPECT_EQ(result.bytesOffered - result.bytesDropped, result.bytesWritten);
+
+    // Data is dropped while a sector erase keeps the chip busy, which the write buffer is far too small to ride out,
+    // and until the erase task next runs to find it done, but nowhere else
+    const uint64_t offeredDuringErases = (uint64_t)result.bytesOffered * flashSimGetStats()->sectorErases
+        * (config.sectorEraseMicros + BENCHMARK_ERASE_TASK_MICROS) / result.elapsedMicros;
+    EXPECT_LE(result.bytesDropped, offeredDuringErases);
+    EXPECT_LT(result.bytesDropped, result.bytesOffered * 2 / 5);
+}
+
+TEST(FlashfsBenchmark, ImageFileKeepsFlashContents)
+{
+    // given
+    const char *filename = "flashfs_unittest.img";
+    flashSimConfig_t config;
+    flashSimDefaultConfig(&config);
+    config.sectors = TEST_FLASH_SECTORS;
+    config.pagesPerSector = TEST_FLASH_PAGES_PER_SECTOR;
+    config.imageFilename = filename;
+
+    remove(filename);
+    flashSimInit(&config);
+    flashfsSetRollingMode(0, false);
+    flashfsInit();
+
+    // when
+    const uint8_t data[] = "blackbox";
+    flashfsWrite(data, sizeof(data), true);
+    flashfsFlushSync();
+    flashSimClose();
+
+    flashSimInit(&config);
+    flashfsInit();
+
+    // then
+    EXPECT_EQ(0, memcmp(flashSimGetMemory(), data, sizeof(data)));
+    EXPECT_EQ(2048, flashfsGetOffset());
+
+    flashSimClose();
+    remove(filename);
+}
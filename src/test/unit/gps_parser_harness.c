@@ -0,0 +1,683 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include "platform.h"
+
+#include "common/utils.h"
+
+#include "config/config.h"
+
+#include "drivers/serial.h"
+#include "io/serial.h"
+#include "io/gps.h"
+
+#include "fc/runtime_config.h"
+
+#include "gps_parser_harness.h"
+
+// Everything the receivers here send, in the order they send it
+static const uint8_t neo6mNmeaMessages[] = {
+    GPS_PARSER_NMEA_RMC, GPS_PARSER_NMEA_VTG, GPS_PARSER_NMEA_GGA, GPS_PARSER_NMEA_GSA, GPS_PARSER_NMEA_GSV, GPS_PARSER_NMEA_GLL
+};
+static const uint8_t mt3339NmeaMessages[] = {
+    GPS_PARSER_NMEA_GGA, GPS_PARSER_NMEA_GSA, GPS_PARSER_NMEA_GSV, GPS_PARSER_NMEA_RMC, GPS_PARSER_NMEA_VTG
+};
+static const uint8_t sirfNmeaMessages[] = {
+    GPS_PARSER_NMEA_GGA, GPS_PARSER_NMEA_GSA, GPS_PARSER_NMEA_GSV, GPS_PARSER_NMEA_RMC
+};
+static const uint8_t neo6mUbxMessages[] = {
+    GPS_PARSER_UBX_POSLLH, GPS_PARSER_UBX_STATUS, GPS_PARSER_UBX_SOL, GPS_PARSER_UBX_VELNED, GPS_PARSER_UBX_SVINFO
+};
+static const uint8_t neo6mUcenterUbxMessages[] = {
+    GPS_PARSER_UBX_STATUS, GPS_PARSER_UBX_POSLLH, GPS_PARSER_UBX_VELNED, GPS_PARSER_UBX_CLOCK, GPS_PARSER_UBX_SOL, GPS_PARSER_UBX_SVINFO
+};
+static const uint8_t navPvtMessages[] = {
+    GPS_PARSER_UBX_PVT, GPS_PARSER_UBX_SVINFO
+};
+
+const gpsParserReceiver_t gpsParserReceivers[] = {
+    { "u-blox 6 NMEA",        GPS_NMEA,  neo6mNmeaMessages,        ARRAYLEN(neo6mNmeaMessages),        1, 200, 5, 3, 0 },
+    { "MediaTek MT3339 NMEA", GPS_NMEA,  mt3339NmeaMessages,       ARRAYLEN(mt3339NmeaMessages),       5, 100, 4, 2, 0 },
+    { "SiRFstar IV NMEA",     GPS_NMEA,  sirfNmeaMessages,         ARRAYLEN(sirfNmeaMessages),         5, 1000, 4, 1, 0 },
+    { "u-blox 6 UBX",         GPS_UBLOX, neo6mUbxMessages,         ARRAYLEN(neo6mUbxMessages),         5, 200, 0, 0, 0 },
+    { "u-blox 6 u-center UBX", GPS_UBLOX, neo6mUcenterUbxMessages, ARRAYLEN(neo6mUcenterUbxMessages),  1, 1000, 0, 0, 0 },
+    { "u-blox 7 NAV-PVT",     GPS_UBLOX, navPvtMessages,           ARRAYLEN(navPvtMessages),          10, 100, 0, 0, 84 },
+    { "u-blox 8 NAV-PVT",     GPS_UBLOX, navPvtMessages,           ARRAYLEN(navPvtMessages),          10, 100, 0, 0, 92 },
+};
+
+const int gpsParserReceiverCount = ARRAYLEN(gpsParserReceivers);
+
+const char * const gpsParserMessageNames[] = {
+    "NMEA GGA", "NMEA RMC", "NMEA VTG", "NMEA GSA", "NMEA GSV", "NMEA GLL",
+    "UBX POSLLH", "UBX STATUS", "UBX SOL", "UBX VELNED", "UBX SVINFO", "UBX PVT", "UBX CLOCK"
+};
+
+#define TRACK_NO_FIX_EPOCHS     5
+#define TRACK_START_TIME_OF_WEEK 345600000  // Wednesday midnight
+
+void gpsParserTrackFix(const gpsParserReceiver_t *receiver, int epoch, bool southWest, gpsParserFix_t *fix)
+{
+    memset(fix, 0, sizeof(*fix));
+
+    fix->timeOfWeek = TRACK_START_TIME_OF_WEEK + epoch * receiver->epochMillis;
+    fix->fix = epoch >= TRACK_NO_FIX_EPOCHS;
+    fix->numSat = fix->fix ? 6 + epoch % 7 : 2;
+    fix->pdop = fix->fix ? 120 + epoch % 50 : 9999;
+
+    // Heading round in a circle at 5m/s, climbing slowly
+    if (southWest) {
+        fix->coord[LAT] = -346037000 - epoch * 37;
+        fix->coord[LON] = -583816000 - epoch * 53;
+    } else {
+        fix->coord[LAT] = 473977420 + epoch * 37;
+        fix->coord[LON] = 85455940 + epoch * 53;
+    }
+    fix->altitude = 408000 + epoch * 257;
+
+    const double angle = epoch * 0.15;
+    fix->velned[VEL_NORTH] = lrint(500 * cos(angle));
+    fix->velned[VEL_EAST] = lrint(500 * sin(angle));
+    fix->velned[VEL_DOWN] = -20;
+    fix->speed = lrint(hypot(fix->velned[VEL_NORTH], fix->velned[VEL_EAST]));
+
+    double course = atan2(fix->velned[VEL_EAST], fix->velned[VEL_NORTH]) * 180 / M_PI;
+    if (course < 0) {
+        course += 360;
+    }
+    fix->groundCourse = (uint16_t)(course * 10) % 3600;
+}
+
+static uint8_t satelliteSvid(int index)
+{
+    return 2 + index * 3;
+}
+
+static uint8_t satelliteCno(int index)
+{
+    return 25 + (index * 7) % 20;
+}
+
+// NMEA
+
+typedef struct nmeaSentence_s {
+    char *start;
+    char *end;
+} nmeaSentence_t;
+
+static void nmeaBegin(nmeaSentence_t *sentence, uint8_t *buffer)
+{
+    sentence->start = sentence->end = (char *)buffer;
+}
+
+static void nmeaPrintf(nmeaSentence_t *sentence, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    sentence->end += vsprintf(sentence->end, format, args);
+    va_end(args);
+}
+
+// Closes the sentence with its checksum, the XOR of everything between '$' and '*'
+static int nmeaEnd(nmeaSentence_t *sentence)
+{
+    uint8_t checksum = 0;
+    for (const char *c = sentence->start + 1; c < sentence->end; c++) {
+        checksum ^= *c;
+    }
+    nmeaPrintf(sentence, "*%02X\r\n", checksum);
+    return sentence->end - sentence->start;
+}
+
+static void nmeaTime(nmeaSentence_t *sentence, const gpsParserFix_t *fix)
+{
+    const uint32_t secondOfDay = (fix->timeOfWeek / 1000) % 86400;
+    nmeaPrintf(sentence, "%02u%02u%02u.%02u", secondOfDay / 3600, (secondOfDay / 60) % 60, secondOfDay % 60, (fix->timeOfWeek % 1000) / 10);
+}
+
+// ddmm.mmmm for latitude, dddmm.mmmm for longitude, then the hemisphere
+static void nmeaCoordinate(nmeaSentence_t *sentence, const gpsParserReceiver_t *receiver, int32_t coord, int degreeDigits, const char *hemispheres)
+{
+    const uint32_t absolute = coord < 0 ? -coord : coord;
+    const double minutes = (absolute % GPS_DEGREES_DIVIDER) * 60.0 / GPS_DEGREES_DIVIDER;
+
+    nmeaPrintf(sentence, "%0*u%0*.*f,%c", degreeDigits, absolute / GPS_DEGREES_DIVIDER,
+        receiver->minuteDecimals + 3, receiver->minuteDecimals, minutes, hemispheres[coord < 0]);
+}
+
+static void nmeaPosition(nmeaSentence_t *sentence, const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix)
+{
+    nmeaCoordinate(sentence, receiver, fix->coord[LAT], 2, "NS");
+    nmeaPrintf(sentence, ",");
+    nmeaCoordinate(sentence, receiver, fix->coord[LON], 3, "EW");
+}
+
+static double knots(uint16_t cmPerSecond)
+{
+    return cmPerSecond / 51.4444;
+}
+
+static int buildNmeaGga(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    nmeaSentence_t sentence;
+    nmeaBegin(&sentence, buffer);
+
+    nmeaPrintf(&sentence, "$GPGGA,");
+    nmeaTime(&sentence, fix);
+    if (fix->fix) {
+        nmeaPrintf(&sentence, ",");
+        nmeaPosition(&sentence, receiver, fix);
+        nmeaPrintf(&sentence, ",1,%02u,%.2f,%.1f,M,47.3,M,,", fix->numSat, fix->pdop / 100.0, fix->altitude / 1000.0);
+    } else {
+        nmeaPrintf(&sentence, ",,,,,0,%02u,99.99,,,,,,", fix->numSat);
+    }
+    return nmeaEnd(&sentence);
+}
+
+static int buildNmeaRmc(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    nmeaSentence_t sentence;
+    nmeaBegin(&sentence, buffer);
+
+    nmeaPrintf(&sentence, "$GPRMC,");
+    nmeaTime(&sentence, fix);
+    if (fix->fix) {
+        nmeaPrintf(&sentence, ",A,");
+        nmeaPosition(&sentence, receiver, fix);
+        nmeaPrintf(&sentence, ",%.*f,%.2f,221026,,,A", receiver->speedDecimals, knots(fix->speed), fix->groundCourse / 10.0);
+    } else {
+        nmeaPrintf(&sentence, ",V,,,,,,,221026,,,N");
+    }
+    return nmeaEnd(&sentence);
+}
+
+static int buildNmeaVtg(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    nmeaSentence_t sentence;
+    nmeaBegin(&sentence, buffer);
+
+    if (fix->fix) {
+        nmeaPrintf(&sentence, "$GPVTG,%.2f,T,,M,%.*f,N,%.*f,K,A", fix->groundCourse / 10.0,
+            receiver->speedDecimals, knots(fix->speed), receiver->speedDecimals, fix->speed * 0.036);
+    } else {
+        nmeaPrintf(&sentence, "$GPVTG,,,,,,,,,N");
+    }
+    return nmeaEnd(&sentence);
+}
+
+static int buildNmeaGsa(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    nmeaSentence_t sentence;
+    nmeaBegin(&sentence, buffer);
+
+    nmeaPrintf(&sentence, "$GPGSA,A,%c", fix->fix ? '3' : '1');
+    for (int i = 0; i < 12; i++) {
+        if (i < fix->numSat) {
+            nmeaPrintf(&sentence, ",%02u", satelliteSvid(i));
+        } else {
+            nmeaPrintf(&sentence, ",");
+        }
+    }
+    nmeaPrintf(&sentence, ",%.2f,%.2f,%.2f", fix->pdop / 100.0, fix->pdop / 120.0, fix->pdop / 80.0);
+    return nmeaEnd(&sentence);
+}
+
+static int buildNmeaGsv(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+    UNUSED(fix);
+
+    const int sentenceCount = (GPS_PARSER_SATELLITES + 3) / 4;
+    int length = 0;
+
+    for (int s = 0; s < sentenceCount; s++) {
+        nmeaSentence_t sentence;
+        nmeaBegin(&sentence, buffer + length);
+
+        nmeaPrintf(&sentence, "$GPGSV,%d,%d,%02d", sentenceCount, s + 1, GPS_PARSER_SATELLITES);
+        for (int i = s * 4; i < s * 4 + 4 && i < GPS_PARSER_SATELLITES; i++) {
+            nmeaPrintf(&sentence, ",%02u,%02d,%03d,%02u", satelliteSvid(i), 10 + i * 6, i * 30, satelliteCno(i));
+        }
+        length += nmeaEnd(&sentence);
+    }
+    return length;
+}
+
+static int buildNmeaGll(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    nmeaSentence_t sentence;
+    nmeaBegin(&sentence, buffer);
+
+    nmeaPrintf(&sentence, "$GPGLL,");
+    if (fix->fix) {
+        nmeaPosition(&sentence, receiver, fix);
+    } else {
+        nmeaPrintf(&sentence, ",,,");
+    }
+    nmeaPrintf(&sentence, ",");
+    nmeaTime(&sentence, fix);
+    nmeaPrintf(&sentence, fix->fix ? ",A,A" : ",V,N");
+    return nmeaEnd(&sentence);
+}
+
+// UBX
+
+#define UBX_CLASS_NAV   0x01
+#define UBX_NAV_POSLLH  0x02
+#define UBX_NAV_STATUS  0x03
+#define UBX_NAV_SOL     0x06
+#define UBX_NAV_PVT     0x07
+#define UBX_NAV_VELNED  0x12
+#define UBX_NAV_CLOCK   0x22
+#define UBX_NAV_SVINFO  0x30
+
+#define UBX_FIX_NONE    0x00
+#define UBX_FIX_3D      0x03
+#define UBX_FIX_OK      0x01
+
+static void put8(uint8_t *payload, int offset, uint8_t value)
+{
+    payload[offset] = value;
+}
+
+static void put16(uint8_t *payload, int offset, uint16_t value)
+{
+    payload[offset] = value;
+    payload[offset + 1] = value >> 8;
+}
+
+static void put32(uint8_t *payload, int offset, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        payload[offset + i] = value >> (i * 8);
+    }
+}
+
+// Wraps the payload, which the caller has put at buffer + 6, in a frame
+static int ubxFrame(uint8_t *buffer, uint8_t msgId, int payloadLength)
+{
+    buffer[0] = 0xB5;
+    buffer[1] = 0x62;
+    buffer[2] = UBX_CLASS_NAV;
+    buffer[3] = msgId;
+    put16(buffer, 4, payloadLength);
+
+    uint8_t ckA = 0, ckB = 0;
+    for (int i = 2; i < 6 + payloadLength; i++) {
+        ckA += buffer[i];
+        ckB += ckA;
+    }
+    buffer[6 + payloadLength] = ckA;
+    buffer[7 + payloadLength] = ckB;
+    return 8 + payloadLength;
+}
+
+static uint8_t ubxFixType(const gpsParserFix_t *fix)
+{
+    return fix->fix ? UBX_FIX_3D : UBX_FIX_NONE;
+}
+
+static uint8_t ubxFixFlags(const gpsParserFix_t *fix)
+{
+    return fix->fix ? UBX_FIX_OK : 0;
+}
+
+static int buildUbxPosllh(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    uint8_t *payload = buffer + 6;
+    memset(payload, 0, 28);
+    put32(payload, 0, fix->timeOfWeek);
+    put32(payload, 4, fix->coord[LON]);
+    put32(payload, 8, fix->coord[LAT]);
+    put32(payload, 12, fix->altitude + 47300);
+    put32(payload, 16, fix->altitude);
+    put32(payload, 20, 1800);
+    put32(payload, 24, 2900);
+    return ubxFrame(buffer, UBX_NAV_POSLLH, 28);
+}
+
+static int buildUbxStatus(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    uint8_t *payload = buffer + 6;
+    memset(payload, 0, 16);
+    put32(payload, 0, fix->timeOfWeek);
+    put8(payload, 4, ubxFixType(fix));
+    put8(payload, 5, ubxFixFlags(fix));
+    put32(payload, 8, 28500);
+    put32(payload, 12, fix->timeOfWeek % 3600000);
+    return ubxFrame(buffer, UBX_NAV_STATUS, 16);
+}
+
+static int buildUbxSol(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    uint8_t *payload = buffer + 6;
+    memset(payload, 0, 52);
+    put32(payload, 0, fix->timeOfWeek);
+    put16(payload, 8, 2337);
+    put8(payload, 10, ubxFixType(fix));
+    put8(payload, 11, ubxFixFlags(fix) | 0x0C);  // Week and time of week valid
+    put32(payload, 24, 350);
+    put16(payload, 44, fix->pdop);
+    put8(payload, 47, fix->numSat);
+    return ubxFrame(buffer, UBX_NAV_SOL, 52);
+}
+
+static int buildUbxVelned(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    uint8_t *payload = buffer + 6;
+    memset(payload, 0, 36);
+    put32(payload, 0, fix->timeOfWeek);
+    put32(payload, 4, fix->velned[VEL_NORTH]);
+    put32(payload, 8, fix->velned[VEL_EAST]);
+    put32(payload, 12, fix->velned[VEL_DOWN]);
+    put32(payload, 16, fix->speed + 1);
+    put32(payload, 20, fix->speed);
+    put32(payload, 24, fix->groundCourse * 10000 + 4321);
+    put32(payload, 28, 40);
+    put32(payload, 32, 150000);
+    return ubxFrame(buffer, UBX_NAV_VELNED, 36);
+}
+
+int gpsParserBuildSvinfo(const gpsParserFix_t *fix, int channels, uint8_t *buffer)
+{
+    uint8_t *payload = buffer + 6;
+    const int length = 8 + 12 * channels;
+    memset(payload, 0, length);
+    put32(payload, 0, fix->timeOfWeek);
+    put8(payload, 4, channels);
+    put8(payload, 5, 0x02);         // u-blox 6
+    for (int i = 0; i < channels; i++) {
+        uint8_t *channel = payload + 8 + 12 * i;
+        put8(channel, 0, i);
+        put8(channel, 1, satelliteSvid(i));
+        put8(channel, 2, i < fix->numSat ? 0x0D : 0x04);
+        put8(channel, 3, i < fix->numSat ? 0x07 : 0x04);
+        put8(channel, 4, satelliteCno(i));
+        put8(channel, 5, 10 + i * 6);
+        put16(channel, 6, i * 30);
+        put32(channel, 8, -120 + i * 20);
+    }
+    return ubxFrame(buffer, UBX_NAV_SVINFO, length);
+}
+
+static int buildUbxSvinfo(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    return gpsParserBuildSvinfo(fix, GPS_PARSER_SATELLITES, buffer);
+}
+
+static int buildUbxPvt(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    uint8_t *payload = buffer + 6;
+    const int length = receiver->pvtLength ? receiver->pvtLength : 92;
+    memset(payload, 0, length);
+    put32(payload, 0, fix->timeOfWeek);
+    put16(payload, 4, 2026);
+    put8(payload, 6, 10);
+    put8(payload, 7, 22);
+    put8(payload, 11, 0x07);        // Date, time and fully resolved
+    put8(payload, 20, ubxFixType(fix));
+    put8(payload, 21, ubxFixFlags(fix));
+    put8(payload, 23, fix->numSat);
+    put32(payload, 24, fix->coord[LON]);
+    put32(payload, 28, fix->coord[LAT]);
+    put32(payload, 32, fix->altitude + 47300);
+    put32(payload, 36, fix->altitude);
+    put32(payload, 40, 1800);
+    put32(payload, 44, 2900);
+    put32(payload, 48, fix->velned[VEL_NORTH] * 10);
+    put32(payload, 52, fix->velned[VEL_EAST] * 10);
+    put32(payload, 56, fix->velned[VEL_DOWN] * 10);
+    put32(payload, 60, fix->speed * 10);
+    put32(payload, 64, fix->groundCourse * 10000 + 4321);
+    put32(payload, 68, 400);
+    put32(payload, 72, 1500000);
+    put16(payload, 76, fix->pdop);
+    return ubxFrame(buffer, UBX_NAV_PVT, length);
+}
+
+static int buildUbxClock(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    UNUSED(receiver);
+
+    uint8_t *payload = buffer + 6;
+    memset(payload, 0, 20);
+    put32(payload, 0, fix->timeOfWeek);
+    put32(payload, 4, 512345);
+    put32(payload, 8, -2345);
+    put32(payload, 12, 35);
+    put32(payload, 16, 1200);
+    return ubxFrame(buffer, UBX_NAV_CLOCK, 20);
+}
+
+typedef int (*gpsParserBuildMessageFnPtr)(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix, uint8_t *buffer);
+
+// In gpsParserMessage_e order
+static const gpsParserBuildMessageFnPtr messageBuilders[] = {
+    buildNmeaGga,
+    buildNmeaRmc,
+    buildNmeaVtg,
+    buildNmeaGsa,
+    buildNmeaGsv,
+    buildNmeaGll,
+    buildUbxPosllh,
+    buildUbxStatus,
+    buildUbxSol,
+    buildUbxVelned,
+    buildUbxSvinfo,
+    buildUbxPvt,
+    buildUbxClock,
+};
+
+int gpsParserBuildMessage(const gpsParserReceiver_t *receiver, gpsParserMessage_e message, const gpsParserFix_t *fix, uint8_t *buffer)
+{
+    return messageBuilders[message](receiver, fix, buffer);
+}
+
+int gpsParserBuildEpoch(const gpsParserReceiver_t *receiver, int epoch, const gpsParserFix_t *fix, uint8_t *buffer, int *messageCount)
+{
+    int length = 0;
+    *messageCount = 0;
+
+    for (int i = 0; i < receiver->messageCount; i++) {
+        const gpsParserMessage_e message = receiver->messages[i];
+
+        if ((message == GPS_PARSER_NMEA_GSV || message == GPS_PARSER_UBX_SVINFO) && epoch % receiver->satelliteEpochs != 0) {
+            continue;
+        }
+        length += gpsParserBuildMessage(receiver, message, fix, buffer + length);
+        *messageCount += message == GPS_PARSER_NMEA_GSV ? (GPS_PARSER_SATELLITES + 3) / 4 : 1;
+    }
+    return length;
+}
+
+static gpsConfig_t harnessGpsConfig;
+
+void gpsParserInit(gpsProvider_e provider)
+{
+    memset(&harnessGpsConfig, 0, sizeof(harnessGpsConfig));
+    harnessGpsConfig.provider = provider;
+    gpsInit(NULL, &harnessGpsConfig);
+
+    // Run whatever an earlier test left part way through out of the parser
+    for (int i = 0; i < 1024; i++) {
+        gpsNewFrame(0);
+    }
+    gpsNewFrame('\n');
+
+    stateFlags = 0;
+}
+
+// Returns how many times the parser reported a new fix
+int gpsParserReceive(const uint8_t *data, int length)
+{
+    int fixes = 0;
+    for (int i = 0; i < length; i++) {
+        if (gpsNewFrame(data[i])) {
+            fixes++;
+        }
+    }
+    return fixes;
+}
+
+// What the parsers need from the rest of the firmware
+
+uint8_t stateFlags;
+
+const uint32_t baudRates[] = {0, 9600, 19200, 38400, 57600, 115200, 230400, 250000};
+
+static serialPort_t gpsPort;
+static serialPortConfig_t gpsPortConfig;
+
+uint32_t millis(void)
+{
+    return 0;
+}
+
+bool feature(uint32_t mask)
+{
+    UNUSED(mask);
+
+    return false;
+}
+
+void featureClear(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void sensorsSet(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void sensorsClear(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void onGpsNewData(void)
+{
+}
+
+void updateDisplay(void)
+{
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    gpsPortConfig.gps_baudrateIndex = BAUD_115200;
+    return &gpsPortConfig;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+    UNUSED(callback);
+
+    gpsPort.baudRate = baudRates[baudRate];
+    gpsPort.mode = mode;
+    gpsPort.options = options;
+
+    return &gpsPort;
+}
+
+baudRate_e lookupBaudRateIndex(uint32_t baudRate)
+{
+    UNUSED(baudRate);
+
+    return BAUD_115200;
+}
+
+uint32_t serialGetBaudRate(serialPort_t *instance)
+{
+    return instance->baudRate;
+}
+
+void serialSetBaudRate(serialPort_t *instance, uint32_t baudRate)
+{
+    instance->baudRate = baudRate;
+}
+
+void serialSetMode(serialPort_t *instance, portMode_t mode)
+{
+    instance->mode = mode;
+}
+
+bool isSerialTransmitBufferEmpty(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return true;
+}
+
+void serialWrite(serialPort_t *instance, uint8_t ch)
+{
+    UNUSED(instance);
+    UNUSED(ch);
+}
+
+void serialPrint(serialPort_t *instance, const char *str)
+{
+    UNUSED(instance);
+    UNUSED(str);
+}
+
+// Bytes are passed straight to the parser rather than through gpsThread()
+int serialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(maxCount);
+
+    return 0;
+}
+
+void waitForSerialPortToFinishTransmitting(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void serialPassthrough(serialPort_t *left, serialPort_t *right, serialConsumer *leftC, serialConsumer *rightC)
+{
+    UNUSED(left);
+    UNUSED(right);
+    UNUSED(leftC);
+    UNUSED(rightC);
+}
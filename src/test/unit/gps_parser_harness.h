@@ -0,0 +1,91 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io/gps.h"
+
+/*
+ * Drives the GPS parsers in io/gps.c without a UART, for checking, fuzzing and timing them on the host.
+ *
+ * Streams are built the way each receiver sends them: the same sentences or messages in the same order each epoch,
+ * with the receiver's own number formats, and satellite information only every few epochs. Every epoch is built from a
+ * known fix along a test track, so what was decoded can be checked against what was sent.
+ */
+
+#define GPS_PARSER_EPOCH_SIZE_MAX   1024
+#define GPS_PARSER_SATELLITES       12
+
+typedef enum {
+    GPS_PARSER_NMEA_GGA = 0,
+    GPS_PARSER_NMEA_RMC,
+    GPS_PARSER_NMEA_VTG,
+    GPS_PARSER_NMEA_GSA,
+    GPS_PARSER_NMEA_GSV,        // One sentence for every four satellites
+    GPS_PARSER_NMEA_GLL,
+    GPS_PARSER_UBX_POSLLH,
+    GPS_PARSER_UBX_STATUS,
+    GPS_PARSER_UBX_SOL,
+    GPS_PARSER_UBX_VELNED,
+    GPS_PARSER_UBX_SVINFO,
+    GPS_PARSER_UBX_PVT,
+    GPS_PARSER_UBX_CLOCK,       // Enabled by u-center's default configuration, and ignored
+    GPS_PARSER_MESSAGE_COUNT
+} gpsParserMessage_e;
+
+// A fix as the receiver computed it, before it is formatted for sending
+typedef struct gpsParserFix_s {
+    bool fix;                   // 3D fix
+    uint32_t timeOfWeek;        // ms
+    int32_t coord[2];           // LAT/LON, degrees * 10^7
+    int32_t altitude;           // mm above mean sea level
+    int16_t velned[3];          // cm/s
+    uint16_t speed;             // cm/s over the ground
+    uint16_t groundCourse;      // degrees * 10
+    uint8_t numSat;
+    uint16_t pdop;              // * 100
+} gpsParserFix_t;
+
+typedef struct gpsParserReceiver_s {
+    const char *name;
+    gpsProvider_e provider;
+    const uint8_t *messages;    // gpsParserMessage_e sent every epoch, in order
+    uint8_t messageCount;
+    uint8_t satelliteEpochs;    // GSV or SVINFO are only sent every this many epochs
+    uint16_t epochMillis;
+    uint8_t minuteDecimals;     // NMEA latitude and longitude
+    uint8_t speedDecimals;      // NMEA speed in knots
+    uint8_t pvtLength;          // NAV-PVT grew from 84 to 92 bytes with u-blox 8
+} gpsParserReceiver_t;
+
+extern const gpsParserReceiver_t gpsParserReceivers[];
+extern const int gpsParserReceiverCount;
+
+extern const char * const gpsParserMessageNames[];
+
+void gpsParserTrackFix(const gpsParserReceiver_t *receiver, int epoch, bool southWest, gpsParserFix_t *fix);
+
+int gpsParserBuildMessage(const gpsParserReceiver_t *receiver, gpsParserMessage_e message, const gpsParserFix_t *fix, uint8_t *buffer);
+// NAV-SVINFO for any number of channels, where the receivers' streams have GPS_PARSER_SATELLITES
+int gpsParserBuildSvinfo(const gpsParserFix_t *fix, int channels, uint8_t *buffer);
+int gpsParserBuildEpoch(const gpsParserReceiver_t *receiver, int epoch, const gpsParserFix_t *fix, uint8_t *buffer, int *messageCount);
+
+void gpsParserInit(gpsProvider_e provider);
+int gpsParserReceive(const uint8_t *data, int length);
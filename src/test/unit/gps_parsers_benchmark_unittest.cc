@@ -0,0 +1,141 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "io/gps.h"
+
+    #include "gps_parser_harness.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * Times the GPS parsers, which gpsThread() runs a byte at a time, over each receiver's stream and over each kind of
+ * sentence or message on its own.
+ *
+ * The parsers are built optimised, but for the host rather than the flight controller, so the figures are only good
+ * for comparing receivers and messages and for spotting a change that makes parsing slower.
+ */
+
+#define BENCHMARK_EPOCHS        20000
+#define BENCHMARK_MESSAGES      50000
+#define BENCHMARK_STREAM_EPOCHS 64
+
+static uint8_t stream[BENCHMARK_STREAM_EPOCHS * GPS_PARSER_EPOCH_SIZE_MAX];
+
+static uint64_t nanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Returns how long it took to parse the stream as many times as it takes to make up the epochs
+static uint64_t receiveStream(int length, int repeats, int *fixes)
+{
+    *fixes = 0;
+
+    const uint64_t startedAt = nanos();
+    for (int i = 0; i < repeats; i++) {
+        *fixes += gpsParserReceive(stream, length);
+    }
+    return nanos() - startedAt;
+}
+
+TEST(GpsParsersBenchmarkTest, TimeReceiverStreams)
+{
+    printf("%24s %12s %12s %12s %12s\n", "receiver", "bytes/fix", "ns/byte", "ns/message", "ns/fix");
+
+    for (int i = 0; i < gpsParserReceiverCount; i++) {
+        const gpsParserReceiver_t *receiver = &gpsParserReceivers[i];
+        SCOPED_TRACE(receiver->name);
+
+        // given a stream with a fix in every epoch
+        gpsParserInit(receiver->provider);
+
+        int length = 0;
+        int messages = 0;
+        for (int epoch = 0; epoch < BENCHMARK_STREAM_EPOCHS; epoch++) {
+            gpsParserFix_t fix;
+            int messageCount;
+
+            gpsParserTrackFix(receiver, BENCHMARK_STREAM_EPOCHS + epoch, false, &fix);
+            length += gpsParserBuildEpoch(receiver, epoch, &fix, stream + length, &messageCount);
+            messages += messageCount;
+        }
+        const int repeats = BENCHMARK_EPOCHS / BENCHMARK_STREAM_EPOCHS;
+
+        // when
+        int fixes;
+        receiveStream(length, repeats, &fixes);   // Warm up
+        const uint64_t totalNanos = receiveStream(length, repeats, &fixes);
+
+        // then every epoch was decoded, so it was the real work that was timed
+        EXPECT_EQ(repeats * BENCHMARK_STREAM_EPOCHS, fixes);
+
+        printf("%24s %12.1f %12.2f %12.1f %12.1f\n", receiver->name, (double)length / BENCHMARK_STREAM_EPOCHS,
+            (double)totalNanos / ((uint64_t)length * repeats), (double)totalNanos / ((uint64_t)messages * repeats),
+            (double)totalNanos / fixes);
+    }
+}
+
+TEST(GpsParsersBenchmarkTest, TimeEachMessage)
+{
+    printf("%24s %12s %12s %12s\n", "message", "bytes", "ns/byte", "ns/message");
+
+    for (int m = 0; m < GPS_PARSER_MESSAGE_COUNT; m++) {
+        const gpsParserMessage_e message = (gpsParserMessage_e)m;
+        SCOPED_TRACE(gpsParserMessageNames[message]);
+
+        // given the message as sent by the first receiver that sends it
+        const gpsParserReceiver_t *receiver = NULL;
+        for (int i = 0; i < gpsParserReceiverCount && !receiver; i++) {
+            if (memchr(gpsParserReceivers[i].messages, message, gpsParserReceivers[i].messageCount)) {
+                receiver = &gpsParserReceivers[i];
+            }
+        }
+        ASSERT_TRUE(receiver != NULL);
+        gpsParserInit(receiver->provider);
+
+        gpsParserFix_t fix;
+        gpsParserTrackFix(receiver, BENCHMARK_STREAM_EPOCHS, false, &fix);
+        const int length = gpsParserBuildMessage(receiver, message, &fix, stream);
+
+        // GSV comes as several sentences
+        const int sentences = message == GPS_PARSER_NMEA_GSV ? (GPS_PARSER_SATELLITES + 3) / 4 : 1;
+        const int repeats = BENCHMARK_MESSAGES / sentences;
+
+        // when
+        int fixes;
+        receiveStream(length, repeats, &fixes);   // Warm up
+        const uint32_t packetCount = GPS_packetCount;
+        const uint64_t totalNanos = receiveStream(length, repeats, &fixes);
+
+        // then every message passed its checksum, so it was the real work that was timed
+        EXPECT_EQ((uint32_t)(repeats * sentences), GPS_packetCount - packetCount);
+
+        printf("%24s %12.1f %12.2f %12.1f\n", gpsParserMessageNames[message], (double)length / sentences,
+            (double)totalNanos / ((uint64_t)length * repeats), (double)totalNanos / ((uint64_t)repeats * sentences));
+    }
+}
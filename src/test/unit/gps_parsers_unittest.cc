@@ -0,0 +1,387 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "fc/runtime_config.h"
+
+    #include "io/gps.h"
+
+    #include "gps_parser_harness.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * The NMEA and UBX parsers are fed the streams of several receivers and checked against the fixes the streams were
+ * built from, then fed mutated streams and noise. The test is built with the address and undefined behaviour
+ * sanitizers, so a parser that strays outside its buffers fails it even if nothing visibly goes wrong.
+ */
+
+#define TRACK_EPOCHS            60
+#define FUZZ_EPOCHS_PER_RECEIVER 3000
+#define FUZZ_SEED               0x5EED1234
+
+// NMEA gives minutes to 4 or 5 decimal places, of which the parser keeps 4
+#define NMEA_COORD_TOLERANCE    30
+// NMEA gives speed in knots, of which the parser keeps one decimal place
+#define NMEA_SPEED_TOLERANCE    8
+
+static uint32_t randomState;
+
+// xorshift32, so that failures can be reproduced
+static uint32_t randomNumber(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static uint32_t randomBelow(uint32_t limit)
+{
+    return randomNumber() % limit;
+}
+
+static bool sendsMessage(const gpsParserReceiver_t *receiver, gpsParserMessage_e message)
+{
+    return memchr(receiver->messages, message, receiver->messageCount) != NULL;
+}
+
+static int messageIndex(const gpsParserReceiver_t *receiver, gpsParserMessage_e message)
+{
+    return (const uint8_t *)memchr(receiver->messages, message, receiver->messageCount) - receiver->messages;
+}
+
+// The UBX parser sets the fix flag from the status it saw before POSLLH, which for a receiver that sends POSLLH first
+// is the status from the epoch before
+static bool fixLagsAnEpoch(const gpsParserReceiver_t *receiver)
+{
+    return sendsMessage(receiver, GPS_PARSER_UBX_POSLLH)
+        && messageIndex(receiver, GPS_PARSER_UBX_POSLLH) < messageIndex(receiver, GPS_PARSER_UBX_STATUS);
+}
+
+static void expectFixDecoded(const gpsParserReceiver_t *receiver, const gpsParserFix_t *fix)
+{
+    if (receiver->provider == GPS_NMEA) {
+        EXPECT_NEAR(fix->coord[LAT], GPS_coord[LAT], NMEA_COORD_TOLERANCE);
+        EXPECT_NEAR(fix->coord[LON], GPS_coord[LON], NMEA_COORD_TOLERANCE);
+        EXPECT_NEAR(fix->altitude / 1000, GPS_altitude, 1);
+        EXPECT_NEAR(fix->speed, GPS_speed, NMEA_SPEED_TOLERANCE);
+        EXPECT_NEAR(fix->groundCourse, GPS_ground_course, 1);
+    } else {
+        EXPECT_EQ(fix->coord[LAT], GPS_coord[LAT]);
+        EXPECT_EQ(fix->coord[LON], GPS_coord[LON]);
+        EXPECT_EQ(fix->altitude / 1000, GPS_altitude);
+        EXPECT_EQ(fix->speed, GPS_speed);
+        EXPECT_EQ(fix->groundCourse, GPS_ground_course);
+        EXPECT_EQ(fix->pdop, GPS_hdop);
+    }
+    EXPECT_EQ(fix->numSat, GPS_numSat);
+
+    if (sendsMessage(receiver, GPS_PARSER_UBX_PVT)) {
+        EXPECT_TRUE(GPS_velnedValid);
+        EXPECT_EQ(fix->timeOfWeek, GPS_timeOfWeek);
+        EXPECT_EQ(fix->velned[VEL_NORTH], GPS_velned[VEL_NORTH]);
+        EXPECT_EQ(fix->velned[VEL_EAST], GPS_velned[VEL_EAST]);
+        EXPECT_EQ(fix->velned[VEL_DOWN], GPS_velned[VEL_DOWN]);
+    } else {
+        EXPECT_FALSE(GPS_velnedValid);
+    }
+}
+
+static void expectSatellitesDecoded(void)
+{
+    EXPECT_EQ(GPS_PARSER_SATELLITES, GPS_numCh);
+    for (int i = 0; i < GPS_PARSER_SATELLITES; i++) {
+        EXPECT_EQ(2 + i * 3, GPS_svinfo_svid[i]) << "satellite " << i;
+        EXPECT_EQ(25 + (i * 7) % 20, GPS_svinfo_cno[i]) << "satellite " << i;
+    }
+}
+
+// Sends the track and checks every epoch was decoded as sent
+static void replayTrack(const gpsParserReceiver_t *receiver, bool southWest, int firstEpoch, int epochs)
+{
+    bool previousFix = false;
+
+    for (int epoch = firstEpoch; epoch < firstEpoch + epochs; epoch++) {
+        SCOPED_TRACE(epoch);
+
+        gpsParserFix_t fix;
+        uint8_t buffer[GPS_PARSER_EPOCH_SIZE_MAX];
+        int messageCount;
+
+        gpsParserTrackFix(receiver, epoch, southWest, &fix);
+        const int length = gpsParserBuildEpoch(receiver, epoch, &fix, buffer, &messageCount);
+
+        // when
+        const uint32_t packetCount = GPS_packetCount;
+        const int fixes = gpsParserReceive(buffer, length);
+
+        // then
+        EXPECT_EQ(1, fixes);
+        EXPECT_EQ(messageCount, (int)(GPS_packetCount - packetCount));
+
+        // The fix flag from before the first epoch is whatever an earlier test left
+        const bool fixKnown = epoch > firstEpoch || !fixLagsAnEpoch(receiver);
+        const bool expectedFix = fix.fix && (previousFix || !fixLagsAnEpoch(receiver));
+        if (fixKnown) {
+            EXPECT_EQ(expectedFix, STATE(GPS_FIX) != 0);
+        }
+        if (fixKnown && expectedFix) {
+            expectFixDecoded(receiver, &fix);
+        }
+        previousFix = fix.fix;
+    }
+}
+
+TEST(GpsParsersTest, DecodeEveryReceiversStream)
+{
+    for (int i = 0; i < gpsParserReceiverCount; i++) {
+        const gpsParserReceiver_t *receiver = &gpsParserReceivers[i];
+
+        for (int southWest = 0; southWest <= 1; southWest++) {
+            SCOPED_TRACE(testing::Message() << receiver->name << (southWest ? " south west" : " north east"));
+
+            // given
+            gpsParserInit(receiver->provider);
+            const uint32_t svInfoReceivedCount = GPS_svInfoReceivedCount;
+
+            // expect
+            replayTrack(receiver, southWest, 0, TRACK_EPOCHS);
+
+            EXPECT_GT(GPS_svInfoReceivedCount, svInfoReceivedCount);
+            expectSatellitesDecoded();
+        }
+    }
+}
+
+TEST(GpsParsersTest, DecodeReferenceSentences)
+{
+    // given
+    gpsParserInit(GPS_NMEA);
+
+    // The examples everybody quotes for GGA and RMC
+    const char *gga = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+    const char *rmc = "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+
+    // when
+    const int fixes = gpsParserReceive((const uint8_t *)gga, strlen(gga)) + gpsParserReceive((const uint8_t *)rmc, strlen(rmc));
+
+    // then
+    EXPECT_EQ(1, fixes);
+    EXPECT_TRUE(STATE(GPS_FIX));
+    EXPECT_EQ(481173000, GPS_coord[LAT]);      // 48 degrees 7.038 minutes
+    EXPECT_EQ(115166666, GPS_coord[LON]);      // 11 degrees 31 minutes
+    EXPECT_EQ(8, GPS_numSat);
+    EXPECT_EQ(545, GPS_altitude);
+    EXPECT_EQ(1152, GPS_speed);                // 22.4 knots
+    EXPECT_EQ(844, GPS_ground_course);
+}
+
+TEST(GpsParsersTest, RejectBadChecksums)
+{
+    for (int i = 0; i < gpsParserReceiverCount; i++) {
+        const gpsParserReceiver_t *receiver = &gpsParserReceivers[i];
+        SCOPED_TRACE(receiver->name);
+
+        // given
+        gpsParserInit(receiver->provider);
+
+        gpsParserFix_t fix;
+        gpsParserTrackFix(receiver, TRACK_EPOCHS, false, &fix);
+
+        const uint32_t errors = gpsData.errors;
+        int fixes = 0;
+        for (int m = 0; m < receiver->messageCount; m++) {
+            uint8_t buffer[GPS_PARSER_EPOCH_SIZE_MAX];
+            const int length = gpsParserBuildMessage(receiver, (gpsParserMessage_e)receiver->messages[m], &fix, buffer);
+
+            // when the checksum is wrong, which for NMEA is the two hex digits before the line ending
+            if (receiver->provider == GPS_NMEA) {
+                buffer[length - 4] = buffer[length - 4] == '0' ? '1' : '0';
+            } else {
+                buffer[length - 1] ^= 0x01;
+            }
+            fixes += gpsParserReceive(buffer, length);
+        }
+
+        // then
+        EXPECT_EQ(0, fixes);
+        EXPECT_FALSE(STATE(GPS_FIX));
+        if (receiver->provider == GPS_UBLOX) {
+            EXPECT_EQ(receiver->messageCount, (int)(gpsData.errors - errors));
+        }
+    }
+}
+
+TEST(GpsParsersTest, SkipSvinfoTooLongToParse)
+{
+    // given a u-blox 8 tracking more satellites than the receive buffer has room for
+    const gpsParserReceiver_t *receiver = &gpsParserReceivers[gpsParserReceiverCount - 1];
+    gpsParserInit(receiver->provider);
+
+    gpsParserFix_t fix;
+    gpsParserTrackFix(receiver, TRACK_EPOCHS, false, &fix);
+
+    uint8_t buffer[GPS_PARSER_EPOCH_SIZE_MAX];
+    int length = gpsParserBuildSvinfo(&fix, 40, buffer);
+    length += gpsParserBuildMessage(receiver, GPS_PARSER_UBX_PVT, &fix, buffer + length);
+
+    const uint32_t errors = gpsData.errors;
+    const uint32_t packetCount = GPS_packetCount;
+    const uint32_t svInfoReceivedCount = GPS_svInfoReceivedCount;
+
+    // when
+    const int fixes = gpsParserReceive(buffer, length);
+
+    // then the SVINFO is counted out and dropped, and the NAV-PVT after it decoded
+    EXPECT_EQ(1, fixes);
+    EXPECT_EQ(errors, gpsData.errors);
+    EXPECT_EQ(packetCount + 2, GPS_packetCount);
+    EXPECT_EQ(svInfoReceivedCount, GPS_svInfoReceivedCount);
+    expectFixDecoded(receiver, &fix);
+}
+
+TEST(GpsParsersTest, ResyncAfterImpossibleLength)
+{
+    // given
+    const gpsParserReceiver_t *receiver = &gpsParserReceivers[gpsParserReceiverCount - 1];
+    gpsParserInit(receiver->provider);
+
+    gpsParserFix_t fix;
+    gpsParserTrackFix(receiver, TRACK_EPOCHS, false, &fix);
+
+    // a header with a length no message has
+    uint8_t buffer[GPS_PARSER_EPOCH_SIZE_MAX] = { 0xB5, 0x62, 0x01, 0x30, 0xFF, 0xFF };
+    const int length = 6 + gpsParserBuildMessage(receiver, GPS_PARSER_UBX_PVT, &fix, buffer + 6);
+
+    const uint32_t errors = gpsData.errors;
+
+    // when
+    const int fixes = gpsParserReceive(buffer, length);
+
+    // then the parser gives up on it at once, rather than swallowing the NAV-PVT as payload
+    EXPECT_EQ(1, fixes);
+    EXPECT_EQ(errors + 1, gpsData.errors);
+    expectFixDecoded(receiver, &fix);
+}
+
+// Mangles a stream the way a bad connection might, returning its new length
+static int mutateStream(uint8_t *data, int length)
+{
+    const int mutations = 1 + randomBelow(4);
+
+    for (int i = 0; i < mutations && length > 0; i++) {
+        const int position = randomBelow(length);
+
+        switch (randomBelow(6)) {
+        case 0:
+            data[position] ^= 1 << randomBelow(8);
+            break;
+        case 1:
+            data[position] = randomNumber();
+            break;
+        case 2:
+            memmove(&data[position], &data[position + 1], length - position - 1);
+            length--;
+            break;
+        case 3:
+            if (length < GPS_PARSER_EPOCH_SIZE_MAX) {
+                memmove(&data[position + 1], &data[position], length - position);
+                data[position] = randomNumber();
+                length++;
+            }
+            break;
+        case 4:
+            // A digit where the parser expects a separator, making a field longer than any real one
+            data[position] = '0' + randomBelow(10);
+            break;
+        case 5:
+            length = position;
+            break;
+        }
+    }
+
+    return length;
+}
+
+TEST(GpsParsersTest, SurviveMutatedStreams)
+{
+    randomState = FUZZ_SEED;
+
+    for (int i = 0; i < gpsParserReceiverCount; i++) {
+        const gpsParserReceiver_t *receiver = &gpsParserReceivers[i];
+        SCOPED_TRACE(receiver->name);
+
+        // given
+        gpsParserInit(receiver->provider);
+
+        // when
+        int fixesAccepted = 0;
+        for (int epoch = 0; epoch < FUZZ_EPOCHS_PER_RECEIVER; epoch++) {
+            gpsParserFix_t fix;
+            uint8_t buffer[GPS_PARSER_EPOCH_SIZE_MAX];
+            int messageCount;
+
+            gpsParserTrackFix(receiver, epoch, false, &fix);
+            const int length = mutateStream(buffer, gpsParserBuildEpoch(receiver, epoch, &fix, buffer, &messageCount));
+            fixesAccepted += gpsParserReceive(buffer, length);
+        }
+
+        // then the parser picks up again once the stream is good, after a message that was cut off has run out
+        gpsParserInit(receiver->provider);
+        replayTrack(receiver, false, TRACK_EPOCHS, 10);
+
+        printf("%24s: accepted %4d fixes from %d mutated epochs\n", receiver->name, fixesAccepted, FUZZ_EPOCHS_PER_RECEIVER);
+    }
+}
+
+TEST(GpsParsersTest, SurviveNoise)
+{
+    randomState = FUZZ_SEED;
+
+    for (int i = 0; i < gpsParserReceiverCount; i++) {
+        const gpsParserReceiver_t *receiver = &gpsParserReceivers[i];
+        SCOPED_TRACE(receiver->name);
+
+        // given
+        gpsParserInit(receiver->provider);
+
+        // when
+        for (int burst = 0; burst < FUZZ_EPOCHS_PER_RECEIVER; burst++) {
+            uint8_t noise[GPS_PARSER_EPOCH_SIZE_MAX];
+            const int length = randomBelow(sizeof(noise));
+
+            // Mostly printable, with the characters NMEA gives meaning to, for the NMEA parser to get its teeth into
+            for (int b = 0; b < length; b++) {
+                noise[b] = randomBelow(4) ? ",.*$0123456789ABCDEFGPNSEW\r\n"[randomBelow(28)] : randomNumber();
+            }
+            gpsParserReceive(noise, length);
+        }
+
+        // then
+        gpsParserInit(receiver->provider);
+        replayTrack(receiver, false, TRACK_EPOCHS, 10);
+    }
+}
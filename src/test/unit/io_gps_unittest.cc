@@ -0,0 +1,491 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "drivers/serial.h"
+
+    #include "fc/runtime_config.h"
+
+    #include "io/serial.h"
+    #include "io/gps.h"
+
+    #include "config/config.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define UBX_CLASS_NAV   0x01
+#define UBX_CLASS_CFG   0x06
+#define UBX_NAV_POSLLH  0x02
+#define UBX_NAV_SOL     0x06
+#define UBX_NAV_PVT     0x07
+#define UBX_NAV_VELNED  0x12
+#define UBX_CFG_MSG     0x01
+#define UBX_CFG_RATE    0x08
+#define UBX_CFG_SBAS    0x16
+
+#define UBX_NAV_PVT_LENGTH  92      // u-blox 8, u-blox 7 sends 84
+
+static gpsConfig_t testGpsConfig;
+static uint32_t testMillis;
+static std::vector<uint8_t> written;
+
+typedef struct ubxMessage_s {
+    uint8_t msgClass;
+    uint8_t msgId;
+    std::vector<uint8_t> payload;
+} ubxMessage_t;
+
+static std::vector<uint8_t> ubxFrame(uint8_t msgClass, uint8_t msgId, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> frame = { 0xB5, 0x62, msgClass, msgId, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8) };
+    frame.insert(frame.end(), payload.begin(), payload.end());
+
+    uint8_t ckA = 0, ckB = 0;
+    for (size_t i = 2; i < frame.size(); i++) {
+        ckA += frame[i];
+        ckB += ckA;
+    }
+    frame.push_back(ckA);
+    frame.push_back(ckB);
+    return frame;
+}
+
+// Returns how many of the bytes completed a new fix
+static int feed(const std::vector<uint8_t> &bytes)
+{
+    int fixes = 0;
+    for (uint8_t c : bytes) {
+        if (gpsNewFrame(c)) {
+            fixes++;
+        }
+    }
+    return fixes;
+}
+
+static void put8(std::vector<uint8_t> &payload, int offset, uint8_t value)
+{
+    payload[offset] = value;
+}
+
+static void put16(std::vector<uint8_t> &payload, int offset, uint16_t value)
+{
+    payload[offset] = value;
+    payload[offset + 1] = value >> 8;
+}
+
+static void put32(std::vector<uint8_t> &payload, int offset, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        payload[offset + i] = value >> (i * 8);
+    }
+}
+
+// Field offsets from the u-blox 8 receiver description, UBX-NAV-PVT
+static std::vector<uint8_t> navPvtPayload(uint32_t timeOfWeek, uint8_t fixType, bool fixOk)
+{
+    std::vector<uint8_t> payload(UBX_NAV_PVT_LENGTH, 0);
+
+    put32(payload, 0, timeOfWeek);
+    put8(payload, 20, fixType);
+    put8(payload, 21, fixOk ? 0x01 : 0x00);
+    put8(payload, 23, 12);                      // numSV
+    put32(payload, 24, -1223890570);            // lon
+    put32(payload, 28, 473977420);              // lat
+    put32(payload, 32, 160500);                 // height, mm
+    put32(payload, 36, 112250);                 // hMSL, mm
+    put32(payload, 48, 1500);                   // velN, mm/s
+    put32(payload, 52, (uint32_t)-2000);        // velE
+    put32(payload, 56, 300);                    // velD
+    put32(payload, 60, 2500);                   // gSpeed
+    put32(payload, 64, 30687000);               // headMot, deg * 1e-5
+    put16(payload, 76, 135);                    // pDOP
+
+    return payload;
+}
+
+// Takes every UBX message with a good checksum out of what's been written to the receiver
+static std::vector<ubxMessage_t> writtenUbxMessages(int *badChecksums)
+{
+    std::vector<ubxMessage_t> messages;
+    *badChecksums = 0;
+
+    size_t i = 0;
+    while (i + 8 <= written.size()) {
+        if (written[i] != 0xB5 || written[i + 1] != 0x62) {
+            i++;
+            continue;
+        }
+        const uint16_t length = written[i + 4] | (written[i + 5] << 8);
+        if (i + 8 + length > written.size()) {
+            break;
+        }
+        const std::vector<uint8_t> payload(written.begin() + i + 6, written.begin() + i + 6 + length);
+        const std::vector<uint8_t> expected = ubxFrame(written[i + 2], written[i + 3], payload);
+
+        if (!std::equal(expected.begin(), expected.end(), written.begin() + i)) {
+            (*badChecksums)++;
+            i++;
+            continue;
+        }
+        messages.push_back({ written[i + 2], written[i + 3], payload });
+        i += expected.size();
+    }
+    return messages;
+}
+
+static bool isSbasConfigured(void)
+{
+    int badChecksums;
+    for (const ubxMessage_t &message : writtenUbxMessages(&badChecksums)) {
+        if (message.msgClass == UBX_CLASS_CFG && message.msgId == UBX_CFG_SBAS) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The rate set for a NAV message by CFG-MSG, the last one sent winning, or -1 if none was
+static int navMessageRate(const std::vector<ubxMessage_t> &messages, uint8_t msgId)
+{
+    int rate = -1;
+    for (const ubxMessage_t &message : messages) {
+        if (message.msgClass == UBX_CLASS_CFG && message.msgId == UBX_CFG_MSG
+            && message.payload[0] == UBX_CLASS_NAV && message.payload[1] == msgId) {
+            rate = message.payload[2];
+        }
+    }
+    return rate;
+}
+
+static int measurementPeriodMs(const std::vector<ubxMessage_t> &messages)
+{
+    int period = -1;
+    for (const ubxMessage_t &message : messages) {
+        if (message.msgClass == UBX_CLASS_CFG && message.msgId == UBX_CFG_RATE) {
+            period = message.payload[0] | (message.payload[1] << 8);
+        }
+    }
+    return period;
+}
+
+class GpsUbloxTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        memset(&testGpsConfig, 0, sizeof(testGpsConfig));
+        testGpsConfig.provider = GPS_UBLOX;
+        testGpsConfig.autoConfig = GPS_AUTOCONFIG_ON;
+
+        stateFlags = 0;
+        testMillis = 1000;
+        written.clear();
+
+        gpsInit(NULL, &testGpsConfig);
+    }
+
+    void configureReceiver(void) {
+        for (int i = 0; i < 10000 && !isSbasConfigured(); i++) {
+            testMillis += 250;
+            gpsThread();
+        }
+    }
+};
+
+TEST_F(GpsUbloxTest, ConfiguresSeparateMessagesAt5HzByDefault)
+{
+    // when
+    configureReceiver();
+
+    // then
+    int badChecksums;
+    const std::vector<ubxMessage_t> messages = writtenUbxMessages(&badChecksums);
+    EXPECT_EQ(0, badChecksums);
+    EXPECT_EQ(1, navMessageRate(messages, UBX_NAV_POSLLH));
+    EXPECT_EQ(1, navMessageRate(messages, UBX_NAV_SOL));
+    EXPECT_EQ(1, navMessageRate(messages, UBX_NAV_VELNED));
+    EXPECT_EQ(0, navMessageRate(messages, UBX_NAV_PVT));
+    EXPECT_EQ(200, measurementPeriodMs(messages));
+}
+
+TEST_F(GpsUbloxTest, ConfiguresNavPvtAt10Hz)
+{
+    // given
+    testGpsConfig.ubloxNavPvt = GPS_NAV_PVT_ON;
+
+    // when
+    configureReceiver();
+
+    // then
+    int badChecksums;
+    const std::vector<ubxMessage_t> messages = writtenUbxMessages(&badChecksums);
+    EXPECT_EQ(0, badChecksums);
+    EXPECT_EQ(1, navMessageRate(messages, UBX_NAV_PVT));
+    EXPECT_EQ(0, navMessageRate(messages, UBX_NAV_POSLLH));
+    EXPECT_EQ(0, navMessageRate(messages, UBX_NAV_SOL));
+    EXPECT_EQ(0, navMessageRate(messages, UBX_NAV_VELNED));
+    EXPECT_EQ(100, measurementPeriodMs(messages));
+}
+
+TEST_F(GpsUbloxTest, DecodesWholeFixFromOneNavPvt)
+{
+    // when
+    const int fixes = feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, navPvtPayload(345600100, 3, true)));
+
+    // then
+    EXPECT_EQ(1, fixes);
+    EXPECT_TRUE(STATE(GPS_FIX));
+    EXPECT_EQ(12, GPS_numSat);
+    EXPECT_EQ(473977420, GPS_coord[LAT]);
+    EXPECT_EQ(-1223890570, GPS_coord[LON]);
+    EXPECT_EQ(112, GPS_altitude);
+    EXPECT_EQ(250, GPS_speed);
+    EXPECT_EQ(3068, GPS_ground_course);
+    EXPECT_EQ(135, GPS_hdop);
+
+    EXPECT_TRUE(GPS_velnedValid);
+    EXPECT_EQ(345600100U, GPS_timeOfWeek);
+    EXPECT_EQ(150, GPS_velned[VEL_NORTH]);
+    EXPECT_EQ(-200, GPS_velned[VEL_EAST]);
+    EXPECT_EQ(30, GPS_velned[VEL_DOWN]);
+}
+
+TEST_F(GpsUbloxTest, DecodesShorterNavPvtFromUblox7)
+{
+    // given
+    std::vector<uint8_t> payload = navPvtPayload(1000, 3, true);
+    payload.resize(84);
+
+    // when
+    const int fixes = feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, payload));
+
+    // then
+    EXPECT_EQ(1, fixes);
+    EXPECT_EQ(473977420, GPS_coord[LAT]);
+}
+
+TEST_F(GpsUbloxTest, IgnoresTruncatedNavPvt)
+{
+    // given
+    std::vector<uint8_t> payload = navPvtPayload(1000, 3, true);
+    payload.resize(60);
+
+    // when
+    const int fixes = feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, payload));
+
+    // then
+    EXPECT_EQ(0, fixes);
+    EXPECT_FALSE(STATE(GPS_FIX));
+}
+
+TEST_F(GpsUbloxTest, ReportsNoFixFrom2DOrInvalidNavPvt)
+{
+    // when
+    feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, navPvtPayload(1000, 2, true)));
+
+    // then
+    EXPECT_FALSE(STATE(GPS_FIX));
+
+    // when
+    feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, navPvtPayload(1100, 3, false)));
+
+    // then
+    EXPECT_FALSE(STATE(GPS_FIX));
+
+    // when
+    feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, navPvtPayload(1200, 3, true)));
+
+    // then
+    EXPECT_TRUE(STATE(GPS_FIX));
+}
+
+TEST_F(GpsUbloxTest, NeedsPositionAndVelocityFromSeparateMessages)
+{
+    // given a fix from NAV-PVT, as when the receiver is reconfigured
+    feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, navPvtPayload(1000, 3, true)));
+
+    std::vector<uint8_t> posllh(28, 0);
+    put32(posllh, 4, 1);
+    put32(posllh, 8, 2);
+    std::vector<uint8_t> velned(36, 0);
+    put32(velned, 20, 300);
+
+    // when
+    const int positionFixes = feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_POSLLH, posllh));
+
+    // then
+    EXPECT_EQ(0, positionFixes);
+    EXPECT_FALSE(GPS_velnedValid);
+
+    // when
+    const int velocityFixes = feed(ubxFrame(UBX_CLASS_NAV, UBX_NAV_VELNED, velned));
+
+    // then
+    EXPECT_EQ(1, velocityFixes);
+    EXPECT_EQ(2, GPS_coord[LAT]);
+    EXPECT_EQ(300, GPS_speed);
+    EXPECT_FALSE(GPS_velnedValid);
+}
+
+// STUBS
+
+extern "C" {
+
+uint8_t stateFlags;
+
+const uint32_t baudRates[] = {0, 9600, 19200, 38400, 57600, 115200, 230400, 250000};
+
+static serialPort_t testGpsPort;
+static serialPortConfig_t testGpsPortConfig;
+static uint32_t testBaudRate;
+
+uint32_t millis(void)
+{
+    return testMillis;
+}
+
+bool feature(uint32_t mask)
+{
+    UNUSED(mask);
+
+    return false;
+}
+
+void featureClear(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void sensorsSet(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void sensorsClear(uint32_t mask)
+{
+    UNUSED(mask);
+}
+
+void onGpsNewData(void)
+{
+}
+
+void updateDisplay(void)
+{
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    testGpsPortConfig.gps_baudrateIndex = BAUD_115200;
+    return &testGpsPortConfig;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+    UNUSED(callback);
+    UNUSED(options);
+
+    testBaudRate = baudRates[baudRate];
+    testGpsPort.mode = mode;
+    return &testGpsPort;
+}
+
+baudRate_e lookupBaudRateIndex(uint32_t baudRate)
+{
+    for (int index = 0; index <= BAUD_250000; index++) {
+        if (baudRates[index] == baudRate) {
+            return (baudRate_e)index;
+        }
+    }
+    return BAUD_AUTO;
+}
+
+uint32_t serialGetBaudRate(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return testBaudRate;
+}
+
+void serialSetBaudRate(serialPort_t *instance, uint32_t baudRate)
+{
+    UNUSED(instance);
+
+    testBaudRate = baudRate;
+}
+
+void serialSetMode(serialPort_t *instance, portMode_t mode)
+{
+    instance->mode = mode;
+}
+
+bool isSerialTransmitBufferEmpty(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return true;
+}
+
+void serialWrite(serialPort_t *instance, uint8_t ch)
+{
+    UNUSED(instance);
+
+    written.push_back(ch);
+}
+
+void serialPrint(serialPort_t *instance, const char *str)
+{
+    UNUSED(instance);
+
+    written.insert(written.end(), str, str + strlen(str));
+}
+
+int serialReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(maxCount);
+
+    return 0;
+}
+
+void waitForSerialPortToFinishTransmitting(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void serialPassthrough(serialPort_t *left, serialPort_t *right, serialConsumer *leftC, serialConsumer *rightC)
+{
+    UNUSED(left);
+    UNUSED(right);
+    UNUSED(leftC);
+    UNUSED(rightC);
+}
+
+}
@@ -0,0 +1,531 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "build/debug.h"
+    #include "build/version.h"
+
+    #include "common/axis.h"
+    #include "common/color.h"
+    #include "common/packbits.h"
+    #include "common/utils.h"
+
+    #include "drivers/system.h"
+    #include "drivers/sensor.h"
+    #include "drivers/accgyro.h"
+    #include "drivers/compass.h"
+    #include "drivers/serial.h"
+    #include "drivers/flash_m25p16.h"
+    #include "drivers/timer.h"
+    #include "drivers/pwm_rx.h"
+
+    #include "rx/rx.h"
+    #include "rx/msp.h"
+    #include "rx/rx_latency.h"
+
+    #include "io/escservo.h"
+    #include "fc/rc_controls.h"
+    #include "io/gps.h"
+    #include "io/gimbal.h"
+    #include "io/serial.h"
+    #include "io/ledstrip.h"
+    #include "io/flashfs.h"
+    #include "io/transponder_ir.h"
+    #include "io/msp_frame.h"
+    #include "io/msp_protocol.h"
+    #include "io/serial_msp.h"
+
+    #include "telemetry/telemetry.h"
+
+    #include "scheduler/scheduler.h"
+
+    #include "sensors/boardalignment.h"
+    #include "sensors/sensors.h"
+    #include "sensors/battery.h"
+    #include "sensors/acceleration.h"
+    #include "sensors/barometer.h"
+    #include "sensors/compass.h"
+    #include "sensors/gyro.h"
+
+    #include "flight/mixer.h"
+    #include "flight/pid.h"
+    #include "flight/imu.h"
+    #include "flight/failsafe.h"
+    #include "flight/navigation.h"
+
+    #include "fc/mw.h"
+    #include "fc/runtime_config.h"
+
+    #include "config/config.h"
+    #include "config/config_profile.h"
+    #include "config/config_master.h"
+
+    #include "flash_m25p16_sim.h"
+    #include "serial_sim.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// The period of TASK_SERIAL
+#define TEST_SERIAL_TASK_MICROS     10000
+
+// How finely the clock is stepped while waiting for a reply
+#define TEST_CLOCK_STEP_MICROS      100
+
+#define TEST_FLASH_SECTORS          1
+#define TEST_FLASH_PAGES_PER_SECTOR 64
+#define TEST_FLASH_SIZE             (TEST_FLASH_SECTORS * TEST_FLASH_PAGES_PER_SECTOR * M25P16_PAGESIZE)
+
+// The largest bulk read the flight controller will send in one reply
+#define TEST_BULK_READ_MAX_SIZE     4096
+
+static serialSimPort_t host, fc;
+static serialPortConfig_t fcPortConfig;
+static uint32_t fcNextPollAt;
+static bool hostTimedOut;
+
+typedef struct testReply_s {
+    bool error;
+    uint16_t cmdMSP;
+    uint16_t size;
+    uint8_t payload[4 + 2 + 1 + TEST_BULK_READ_MAX_SIZE];
+} testReply_t;
+
+class SerialMspTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        serialSimInit();
+        serialSimLink(&host, &fc, 115200, true);
+
+        memset(&fcPortConfig, 0, sizeof(fcPortConfig));
+        fcPortConfig.identifier = SERIAL_PORT_USART1;
+        fcPortConfig.functionMask = FUNCTION_MSP;
+
+        mspReleasePortIfAllocated(&fc.port);
+        mspAllocateSerialPorts(&masterConfig.serialConfig);
+        fcNextPollAt = serialSimMicros();
+        hostTimedOut = false;
+    }
+
+    virtual void TearDown() {
+        serialSimClose();
+        flashSimClose();
+    }
+};
+
+// Run the MSP task on the flight controller end when it's due, as the scheduler would
+static void fcPoll(void)
+{
+    if (serialSimMicros() < fcNextPollAt) {
+        return;
+    }
+    fcNextPollAt += TEST_SERIAL_TASK_MICROS;
+
+    mspProcess();
+}
+
+static void hostSendRequest(uint8_t cmdMSP, const uint8_t *payload, uint8_t size)
+{
+    uint8_t frame[6 + 255];
+    int length = 0;
+
+    frame[length++] = '$';
+    frame[length++] = 'M';
+    frame[length++] = '<';
+    frame[length++] = size;
+    frame[length++] = cmdMSP;
+    memcpy(&frame[length], payload, size);
+    length += size;
+
+    uint8_t checksum = 0;
+    for (int i = 3; i < length; i++) {
+        checksum ^= frame[i];
+    }
+    frame[length++] = checksum;
+
+    serialWriteBuf(&host.port, frame, length);
+}
+
+static void hostSendDataflashRead(uint32_t address, uint16_t size, bool allowCompression = false)
+{
+    const uint8_t payload[] = {
+        (uint8_t)address, (uint8_t)(address >> 8), (uint8_t)(address >> 16), (uint8_t)(address >> 24),
+        (uint8_t)size, (uint8_t)(size >> 8), allowCompression
+    };
+
+    hostSendRequest(MSP_DATAFLASH_READ, payload, allowCompression ? sizeof(payload) : sizeof(payload) - 1);
+}
+
+static uint8_t hostReadByte(void)
+{
+    const uint32_t start = serialSimMicros();
+
+    while (serialRxBytesWaiting(&host.port) == 0) {
+        if (hostTimedOut || serialSimMicros() - start > 1000000) {
+            if (!hostTimedOut) {
+                ADD_FAILURE() << "No reply";
+            }
+            hostTimedOut = true;
+            return 0;
+        }
+
+        serialSimAdvanceMicros(TEST_CLOCK_STEP_MICROS);
+        fcPoll();
+    }
+
+    return serialRead(&host.port);
+}
+
+/**
+ * Wait for an MSP v1 reply, including jumbo frames, and check its framing.
+ */
+static void hostReadReply(testReply_t *reply)
+{
+    EXPECT_EQ('$', hostReadByte());
+    EXPECT_EQ('M', hostReadByte());
+
+    const uint8_t direction = hostReadByte();
+    EXPECT_TRUE(direction == '>' || direction == '!');
+    reply->error = direction == '!';
+
+    uint8_t checksum = 0;
+    uint8_t c;
+
+    c = hostReadByte();
+    checksum ^= c;
+    reply->size = c;
+
+    c = hostReadByte();
+    checksum ^= c;
+    reply->cmdMSP = c;
+
+    if (reply->size == JUMBO_FRAME_SIZE_LIMIT) {
+        c = hostReadByte();
+        checksum ^= c;
+        reply->size = c;
+
+        c = hostReadByte();
+        checksum ^= c;
+        reply->size |= c << 8;
+    }
+
+    ASSERT_LE(reply->size, sizeof(reply->payload));
+
+    for (int i = 0; i < reply->size; i++) {
+        reply->payload[i] = hostReadByte();
+        checksum ^= reply->payload[i];
+    }
+
+    EXPECT_EQ(checksum, hostReadByte());
+}
+
+TEST_F(SerialMspTest, SubscribesToCommandWithoutParameters)
+{
+    // given
+    const uint8_t payload[] = { MSP_ATTITUDE, 0, 100, 0 };
+    testReply_t reply;
+
+    // when
+    hostSendRequest(MSP_SET_SUBSCRIPTIONS, payload, sizeof(payload));
+    hostReadReply(&reply);
+
+    // then
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(MSP_SET_SUBSCRIPTIONS, reply.cmdMSP);
+    EXPECT_EQ(0, reply.size);
+}
+
+TEST_F(SerialMspTest, RejectsSubscriptionToWaypoints)
+{
+    // given MSP_WP, which needs the waypoint number in the payload
+    const uint8_t payload[] = { MSP_WP, 0, 100, 0 };
+    testReply_t reply;
+
+    // when
+    hostSendRequest(MSP_SET_SUBSCRIPTIONS, payload, sizeof(payload));
+    hostReadReply(&reply);
+
+    // then
+    EXPECT_TRUE(reply.error);
+    EXPECT_EQ(MSP_SET_SUBSCRIPTIONS, reply.cmdMSP);
+}
+
+static uint8_t testFlashByte(uint32_t address)
+{
+    return address * 7 + (address >> 8);
+}
+
+static void initTestFlash(void)
+{
+    flashSimConfig_t config;
+
+    flashSimDefaultConfig(&config);
+    config.sectors = TEST_FLASH_SECTORS;
+    config.pagesPerSector = TEST_FLASH_PAGES_PER_SECTOR;
+    flashSimInit(&config);
+
+    uint8_t page[M25P16_PAGESIZE];
+
+    for (uint32_t address = 0; address < TEST_FLASH_SIZE; address += sizeof(page)) {
+        for (unsigned i = 0; i < sizeof(page); i++) {
+            page[i] = testFlashByte(address + i);
+        }
+        m25p16_pageProgram(address, page, sizeof(page));
+        m25p16_waitForReady(10);
+    }
+
+    flashfsInit();
+}
+
+/**
+ * Check a bulk read reply's header and data, returning the number of flash bytes it covered.
+ */
+static uint16_t expectDataflashReply(const testReply_t *reply, uint32_t address)
+{
+    EXPECT_FALSE(reply->error);
+    EXPECT_EQ(MSP_DATAFLASH_READ, reply->cmdMSP);
+
+    const uint32_t replyAddress = reply->payload[0] | (reply->payload[1] << 8) | (reply->payload[2] << 16) | ((uint32_t)reply->payload[3] << 24);
+    const uint16_t size = reply->payload[4] | (reply->payload[5] << 8);
+
+    EXPECT_EQ(address, replyAddress);
+    EXPECT_EQ(0, reply->payload[6]); // not compressed
+    EXPECT_EQ(4 + 2 + 1 + size, reply->size);
+
+    for (int i = 0; i < size; i++) {
+        if (reply->payload[7 + i] != testFlashByte(address + i)) {
+            ADD_FAILURE() << "Wrong data at " << address + i;
+            break;
+        }
+    }
+
+    return size;
+}
+
+TEST_F(SerialMspTest, BulkReadFitsInUartTxBuffer)
+{
+    // given
+    initTestFlash();
+    testReply_t reply;
+
+    // when
+    hostSendDataflashRead(0, TEST_BULK_READ_MAX_SIZE);
+    hostReadReply(&reply);
+
+    // then the reply was cut down to what the TX buffer had room for, so sending it didn't stall the main loop
+    const uint16_t size = expectDataflashReply(&reply, 0);
+    EXPECT_GT(size, 0);
+    EXPECT_LE(size, SERIAL_SIM_BUFFER_SIZE);
+    EXPECT_EQ(0U, fc.stats.txWaitNanos);
+}
+
+TEST_F(SerialMspTest, BulkReadOverVcpIsNotCut)
+{
+    // given a read bigger than a UART's TX buffer, but not so big that the simulated host's RX buffer overflows
+    initTestFlash();
+    fc.port.identifier = SERIAL_PORT_USB_VCP;
+    testReply_t reply;
+
+    // when
+    hostSendDataflashRead(0, 400);
+    hostReadReply(&reply);
+
+    // then
+    EXPECT_EQ(400, expectDataflashReply(&reply, 0));
+}
+
+TEST_F(SerialMspTest, CompressedBulkReadReadsFlashOnce)
+{
+    // given a stretch of flash that compresses well
+    initTestFlash();
+    flashSimFill(100, 300, 0x00);
+    flashSimResetStats();
+    fc.port.identifier = SERIAL_PORT_USB_VCP;
+    testReply_t reply;
+
+    // when
+    hostSendDataflashRead(0, 400, true);
+    hostReadReply(&reply);
+
+    // then
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(400, reply.payload[4] | (reply.payload[5] << 8));
+    EXPECT_EQ(1, reply.payload[6]); // PackBits
+    EXPECT_LT(reply.size, 4 + 2 + 1 + 400);
+
+    uint8_t decoded[400];
+    ASSERT_EQ(400, packbitsDecode(&reply.payload[7], reply.size - 7, decoded, sizeof(decoded)));
+    for (int i = 0; i < 400; i++) {
+        if (decoded[i] != (i >= 100 && i < 300 ? 0 : testFlashByte(i))) {
+            ADD_FAILURE() << "Wrong data at " << i;
+            break;
+        }
+    }
+
+    // and measuring the compressed size didn't mean reading the flash a second time
+    EXPECT_EQ(400U, flashSimGetStats()->bytesRead);
+}
+
+TEST_F(SerialMspTest, BenchmarkBulkReadOverUart)
+{
+    // given
+    initTestFlash();
+    testReply_t reply;
+    uint32_t address = 0;
+    int replies = 0;
+
+    // when the whole flash is read, asking for as much as possible each time
+    const uint32_t start = serialSimMicros();
+
+    while (address < TEST_FLASH_SIZE) {
+        hostSendDataflashRead(address, TEST_BULK_READ_MAX_SIZE);
+        hostReadReply(&reply);
+
+        const uint16_t size = expectDataflashReply(&reply, address);
+        ASSERT_GT(size, 0);
+
+        address += size;
+        replies++;
+    }
+
+    const uint32_t elapsed = serialSimMicros() - start;
+    const double bytesPerSecond = TEST_FLASH_SIZE / (elapsed / 1000000.0);
+    const double lineBytesPerSecond = 1000000000.0 / serialSimByteNanos(&fc);
+
+    printf("%u bytes in %d replies over %u baud: %.1f KB/s, %.0f%% of the line rate\n",
+        TEST_FLASH_SIZE, replies, fc.port.baudRate, bytesPerSecond / 1024, 100 * bytesPerSecond / lineBytesPerSecond);
+
+    // then the flight controller never waited on its TX buffer, and the link was still kept busy
+    EXPECT_EQ(0U, fc.stats.txWaitNanos);
+    EXPECT_GT(bytesPerSecond, lineBytesPerSecond / 2);
+}
+
+// STUBS
+
+extern "C" {
+
+int16_t debug[DEBUG16_VALUE_COUNT];
+
+const char * const shortGitRevision = "TEST";
+const char * const buildDate = "Jan 01 2016";
+const char * const buildTime = "00:00:00";
+
+master_t masterConfig;
+profile_t *currentProfile;
+controlRateConfig_t *currentControlRateProfile;
+
+uint8_t armingFlags;
+uint16_t flightModeFlags;
+uint8_t stateFlags;
+uint32_t rcModeActivationMask;
+
+uint16_t cycleTime;
+uint16_t rssi;
+int16_t magHold;
+int16_t rcData[MAX_SUPPORTED_RC_CHANNEL_COUNT];
+rxRuntimeConfig_t rxRuntimeConfig;
+uint16_t averageSystemLoadPercent;
+
+acc_t acc;
+gyro_t gyro;
+int32_t accSmooth[XYZ_AXIS_COUNT];
+int32_t gyroADC[XYZ_AXIS_COUNT];
+int32_t magADC[XYZ_AXIS_COUNT];
+attitudeEulerAngles_t attitude;
+
+int16_t motor[MAX_SUPPORTED_MOTORS];
+int16_t motor_disarmed[MAX_SUPPORTED_MOTORS];
+int16_t servo[MAX_SUPPORTED_SERVOS];
+
+uint16_t vbat;
+int32_t amperage;
+int32_t mAhDrawn;
+
+int32_t AltHold;
+int32_t vario;
+
+int32_t GPS_coord[2];
+int32_t GPS_home[2];
+int32_t GPS_hold[2];
+uint8_t GPS_numSat;
+uint8_t GPS_update;
+uint16_t GPS_altitude;
+uint16_t GPS_speed;
+uint16_t GPS_ground_course;
+uint16_t GPS_distanceToHome;
+int16_t GPS_directionToHome;
+uint8_t GPS_numCh;
+uint8_t GPS_svinfo_chn[16];
+uint8_t GPS_svinfo_svid[16];
+uint8_t GPS_svinfo_quality[16];
+uint8_t GPS_svinfo_cno[16];
+navigationMode_e nav_mode;
+
+const uint32_t baudRates[] = { 0, 9600, 19200, 38400, 57600, 115200, 230400, 250000 };
+
+uint32_t micros(void) { return serialSimMicros(); }
+uint32_t millis(void) { return serialSimMicros() / 1000; }
+uint32_t getTaskTimeBudget(void) { return 500; }
+
+bool feature(uint32_t) { return false; }
+void featureSet(uint32_t) {}
+void featureClearAll(void) {}
+uint32_t featureMask(void) { return 0; }
+bool sensors(uint32_t) { return false; }
+uint16_t disableFlightMode(flightModeFlags_e) { return 0; }
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e) { return &fcPortConfig; }
+serialPortConfig_t *findNextSerialPortConfig(serialPortFunction_e) { return NULL; }
+serialPortConfig_t *serialFindPortConfiguration(serialPortIdentifier_e) { return NULL; }
+serialPort_t *openSerialPort(serialPortIdentifier_e, serialPortFunction_e, serialReceiveCallbackPtr, uint32_t, portMode_t, portOptions_t) {
+    return &fc.port;
+}
+void closeSerialPort(serialPort_t *) {}
+bool serialIsPortAvailable(serialPortIdentifier_e) { return false; }
+uint8_t serialGetAvailablePortCount(void) { return 0; }
+void waitForSerialPortToFinishTransmitting(serialPort_t *) {}
+void evaluateOtherData(serialPort_t *, uint8_t) {}
+
+uint8_t getCurrentProfile(void) { return 0; }
+uint8_t getCurrentControlRateProfile(void) { return 0; }
+void changeProfile(uint8_t) {}
+void changeControlRateProfile(uint8_t) {}
+void resetProfile(profile_t *) {}
+void readEEPROM(void) {}
+void writeEEPROM(void) {}
+void resetEEPROM(void) {}
+void useRcControlsConfig(modeActivationCondition_t *, escAndServoConfig_t *, pidProfile_t *) {}
+void pidSetController(pidControllerType_e) {}
+void loadCustomServoMixer(void) {}
+void accSetCalibrationCycles(uint16_t) {}
+int32_t altitudeHoldGetEstimatedAltitude(void) { return 0; }
+void GPS_set_next_wp(int32_t *, int32_t *) {}
+void rxMspFrameReceive(uint16_t *, int) {}
+void rxLatencyGetStats(rxLatencyStage_e, rxLatencyStats_t *stats) { memset(stats, 0, sizeof(*stats)); }
+void reevaluateLedConfig(void) {}
+bool setModeColor(ledModeIndex_e, int, int) { return false; }
+void transponderUpdateData(uint8_t *) {}
+void stopPwmAllMotors(void) {}
+void systemReset(void) {}
+
+}
@@ -0,0 +1,347 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+    #include "max7456_unittest_platform.h"
+
+    #include "drivers/io.h"
+    #include "drivers/bus_spi.h"
+    #include "drivers/dma.h"
+    #include "drivers/max7456.h"
+
+    extern uint16_t max7456_tx[];
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * The MAX7456's display memory, driven by the register writes the driver sends either over SPI or by DMA.
+ */
+typedef struct testChip_s {
+    uint8_t memory[512];
+    uint16_t address;
+    bool autoIncrement;
+    uint8_t vm0;
+
+    int pendingRegister;    // SPI register write waiting for its data byte, or -1
+} testChip_t;
+
+static testChip_t chip;
+
+// The DMA transfer that's been started and not yet completed
+static uint32_t dmaTransferBytes;
+static int dmaTransfers;
+
+static SPI_TypeDef testSpi;
+static DMA_Channel_TypeDef testDmaChannel;
+static DMA_TypeDef testDma;
+static dmaChannelDescriptor_t testDmaDescriptor;
+static dmaCallbackHandlerFuncPtr testDmaHandler;
+
+SPI_TypeDef *testMax7456Spi = &testSpi;
+DMA_Channel_TypeDef *testMax7456DmaChannel = &testDmaChannel;
+
+static void chipWrite(uint8_t reg, uint8_t data)
+{
+    switch (reg) {
+    case MAX7456ADD_VM0:
+        chip.vm0 = data;
+        break;
+    case MAX7456ADD_DMAH:
+        chip.address = (chip.address & 0xFF) | ((data & 0x01) << 8);
+        break;
+    case MAX7456ADD_DMAL:
+        chip.address = (chip.address & 0x100) | data;
+        break;
+    case MAX7456ADD_DMM:
+        if (data & CLEAR_DISPLAY) {
+            memset(chip.memory, 0, sizeof(chip.memory));
+        }
+        chip.autoIncrement = data & 0x01;
+        break;
+    case MAX7456ADD_DMDI:
+        if (chip.autoIncrement && data == END_STRING) {
+            chip.autoIncrement = false;
+            break;
+        }
+        chip.memory[chip.address] = data;
+        if (chip.autoIncrement) {
+            chip.address++;
+        }
+        break;
+    }
+}
+
+// Finish the DMA transfer in progress, applying its register writes
+static void completeDma(void)
+{
+    ASSERT_GT(dmaTransferBytes, 0U);
+
+    for (uint32_t i = 0; i < dmaTransferBytes / 2; i++) {
+        chipWrite(max7456_tx[i] & 0xFF, max7456_tx[i] >> 8);
+    }
+    dmaTransferBytes = 0;
+
+    testDma.ISR = DMA_IT_TCIF;
+    testDmaHandler(&testDmaDescriptor);
+    testDma.ISR = 0;
+}
+
+// Keep updating the screen until it's all been sent
+static int drawScreen(void)
+{
+    int updates = 0;
+
+    while (true) {
+        bool complete = max7456_draw_screen();
+        updates++;
+        if (dmaTransferBytes) {
+            completeDma();
+        }
+        if (complete || updates > 100) {
+            return updates;
+        }
+    }
+}
+
+static void expectChipShowsScreen(void)
+{
+    const MAX7456_CHAR_TYPE *screen = max7456_get_screen_buffer();
+
+    for (int i = 0; i < max_screen_size; i++) {
+        const uint8_t c = screen[i] >> 8;
+
+        if (c != END_STRING && chip.memory[i] != c) {
+            ADD_FAILURE() << "Screen and chip differ at " << i;
+            return;
+        }
+    }
+}
+
+class Max7456Test : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        memset(&chip, 0, sizeof(chip));
+        chip.pendingRegister = -1;
+        memset(chip.memory, 0x55, sizeof(chip.memory)); // whatever was there before
+        dmaTransferBytes = 0;
+        dmaTransfers = 0;
+
+        max7456_init(PAL);
+        drawScreen();
+        dmaTransfers = 0;
+    }
+};
+
+TEST_F(Max7456Test, InitSendsWholeScreen)
+{
+    // then
+    EXPECT_EQ(VIDEO_BUFFER_CHARS_PAL, max_screen_size);
+    EXPECT_TRUE(chip.vm0 & OSD_ENABLE);
+    expectChipShowsScreen();
+}
+
+TEST_F(Max7456Test, SendsNothingWhenScreenIsUnchanged)
+{
+    // when
+    max7456_draw_screen();
+
+    // then
+    EXPECT_EQ(0, dmaTransfers);
+}
+
+TEST_F(Max7456Test, MergesNearbyChanges)
+{
+    // given changes closer together than the cost of starting a run, and one further away
+    max7456_write_string("A", 10);
+    max7456_write_string("B", 13);
+    max7456_write_string("C", 100);
+
+    // when
+    EXPECT_TRUE(max7456_draw_screen());
+
+    // then there are two runs: DMAH, DMAL, DMM, the characters and the 0xFF each, then the DMM at the end
+    EXPECT_EQ(1, dmaTransfers);
+    EXPECT_EQ((3 + 4 + 1) + (3 + 1 + 1) + 1U, dmaTransferBytes / 2);
+    completeDma();
+    expectChipShowsScreen();
+}
+
+TEST_F(Max7456Test, NeverSendsEndStringCharacter)
+{
+    // given a change with a 0xFF in the middle, which would end auto-increment mode
+    const char text[] = { 'A', 'B', (char)END_STRING, 'C', 'D', 0 };
+    max7456_write_string(text, 40);
+
+    // when
+    drawScreen();
+
+    // then the characters either side of it arrived where they should, and the chip kept what it had under the 0xFF
+    expectChipShowsScreen();
+    EXPECT_EQ(' ', chip.memory[42]);
+    EXPECT_EQ('C', chip.memory[43]);
+    EXPECT_EQ('D', chip.memory[44]);
+}
+
+TEST_F(Max7456Test, RetriesWhileDmaIsBusy)
+{
+    // given a transfer that's still in progress
+    max7456_write_string("A", 10);
+    EXPECT_TRUE(max7456_draw_screen());
+    EXPECT_EQ(1, dmaTransfers);
+
+    // when
+    max7456_write_string("B", 20);
+
+    // then the next update is refused rather than waiting for the bus
+    EXPECT_FALSE(max7456_draw_screen());
+    EXPECT_EQ(1, dmaTransfers);
+
+    // when the transfer finishes
+    completeDma();
+    EXPECT_TRUE(max7456_draw_screen());
+    completeDma();
+
+    // then
+    EXPECT_EQ(2, dmaTransfers);
+    expectChipShowsScreen();
+}
+
+TEST_F(Max7456Test, LeavesWhatDoesntFitForNextUpdate)
+{
+    // given changes broken up by 0xFF characters, so every run holds a single character
+    MAX7456_CHAR_TYPE *screen = max7456_get_screen_buffer();
+    for (int i = 0; i < max_screen_size; i++) {
+        screen[i] = MAX7456_CHAR(i % 2 ? END_STRING : 'A' + i % 26);
+    }
+
+    // when
+    bool complete = max7456_draw_screen();
+
+    // then the transfer was cut short at the end of the buffer, which holds a single run covering the whole screen
+    EXPECT_FALSE(complete);
+    EXPECT_LE(dmaTransferBytes / 2, 1U + 3 + VIDEO_BUFFER_CHARS_PAL + 1 + 1);
+    completeDma();
+
+    // when
+    int updates = drawScreen();
+
+    // then the rest followed
+    EXPECT_GT(updates, 1);
+    EXPECT_LT(updates, 10);
+    expectChipShowsScreen();
+}
+
+TEST_F(Max7456Test, InvalidateResendsScreenAfterChipReset)
+{
+    // given
+    max7456_write_string("12.6V", -29);
+    drawScreen();
+
+    // when the chip loses its display memory and settings
+    memset(chip.memory, 0, sizeof(chip.memory));
+    chip.vm0 = 0;
+
+    max7456_invalidate_screen();
+    drawScreen();
+
+    // then
+    EXPECT_TRUE(chip.vm0 & OSD_ENABLE);
+    expectChipShowsScreen();
+}
+
+TEST_F(Max7456Test, RandomEditsReachChip)
+{
+    MAX7456_CHAR_TYPE *screen = max7456_get_screen_buffer();
+
+    srand(1);
+
+    for (int round = 0; round < 2000; round++) {
+        // given
+        const int edits = rand() % 20;
+        for (int i = 0; i < edits; i++) {
+            screen[rand() % max_screen_size] = MAX7456_CHAR(rand() % 8 == 0 ? END_STRING : ' ' + rand() % 90);
+        }
+
+        // when
+        drawScreen();
+
+        // then
+        expectChipShowsScreen();
+        if (HasFailure()) {
+            return;
+        }
+    }
+}
+
+// STUBS
+
+extern "C" {
+
+void delay(uint32_t) {}
+
+void IOInit(IO_t, resourceOwner_t, resourceType_t, uint8_t) {}
+void IOConfigGPIO(IO_t, ioConfig_t) {}
+void IOHi(IO_t) {}
+
+void IOLo(IO_t)
+{
+    // a new SPI transaction
+    chip.pendingRegister = -1;
+}
+
+void spiSetDivisor(SPI_TypeDef *, uint16_t) {}
+
+uint8_t spiTransferByte(SPI_TypeDef *, uint8_t data)
+{
+    if (chip.pendingRegister < 0) {
+        chip.pendingRegister = data;
+    } else {
+        chipWrite(chip.pendingRegister, data);
+        chip.pendingRegister = -1;
+    }
+
+    return 0;
+}
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *, uint16_t) { return RESET; }
+void SPI_I2S_DMACmd(SPI_TypeDef *, uint16_t, FunctionalState) {}
+
+void DMA_DeInit(DMA_Channel_TypeDef *) {}
+void DMA_StructInit(DMA_InitTypeDef *init) { memset(init, 0, sizeof(*init)); }
+void DMA_Cmd(DMA_Channel_TypeDef *, FunctionalState) {}
+void DMA_ITConfig(DMA_Channel_TypeDef *, uint32_t, FunctionalState) {}
+
+void DMA_Init(DMA_Channel_TypeDef *, DMA_InitTypeDef *init)
+{
+    dmaTransferBytes = init->DMA_BufferSize;
+    dmaTransfers++;
+}
+
+void dmaSetHandler(dmaHandlerIdentifier_e, dmaCallbackHandlerFuncPtr callback, uint32_t, uint32_t)
+{
+    testDmaDescriptor.dma = &testDma;
+    testDmaDescriptor.channel = &testDmaChannel;
+    testDmaHandler = callback;
+}
+
+}
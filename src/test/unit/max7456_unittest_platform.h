@@ -0,0 +1,76 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * The parts of the STM32 standard peripheral library the MAX7456 driver uses, which max7456_unittest stubs out.
+ * The Makefile includes this ahead of the driver's own includes, so no other test sees it.
+ */
+
+#include <stdint.h>
+
+#include "platform.h"
+
+#define NVIC_PriorityGroup_2 ((uint32_t)0x500)
+
+typedef struct
+{
+    volatile uint16_t DR;
+} SPI_TypeDef;
+
+#define SPI_I2S_FLAG_RXNE 0x0001
+#define SPI_I2S_DMAReq_Tx 0x0002
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *, uint16_t);
+void SPI_I2S_DMACmd(SPI_TypeDef *, uint16_t, FunctionalState);
+
+typedef struct {
+    volatile uint32_t ISR;
+    volatile uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    uint32_t DMA_PeripheralBaseAddr;
+    uint32_t DMA_MemoryBaseAddr;
+    uint32_t DMA_DIR;
+    uint32_t DMA_BufferSize;
+    uint32_t DMA_PeripheralInc;
+    uint32_t DMA_MemoryInc;
+    uint32_t DMA_PeripheralDataSize;
+    uint32_t DMA_MemoryDataSize;
+    uint32_t DMA_Mode;
+    uint32_t DMA_Priority;
+} DMA_InitTypeDef;
+
+#define DMA_DIR_PeripheralDST           0x0010
+#define DMA_PeripheralInc_Disable       0x0000
+#define DMA_MemoryInc_Enable            0x0080
+#define DMA_PeripheralDataSize_Byte     0x0000
+#define DMA_MemoryDataSize_Byte         0x0000
+#define DMA_Mode_Normal                 0x0000
+#define DMA_Priority_Low                0x0000
+#define DMA_IT_TC                       0x0002
+
+void DMA_DeInit(DMA_Channel_TypeDef *);
+void DMA_StructInit(DMA_InitTypeDef *);
+void DMA_Init(DMA_Channel_TypeDef *, DMA_InitTypeDef *);
+void DMA_ITConfig(DMA_Channel_TypeDef *, uint32_t, FunctionalState);
+
+// The SPI and DMA channel the driver is built for, which the test defines
+extern SPI_TypeDef *testMax7456Spi;
+extern DMA_Channel_TypeDef *testMax7456DmaChannel;
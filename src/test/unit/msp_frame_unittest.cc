@@ -0,0 +1,411 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+    #include "common/crc.h"
+    #include "io/msp_frame.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_LED_STRIP_LENGTH   32
+#define TEST_LED_CONFIG_SIZE    4
+
+// USB VCP polls once per 1ms frame, so each request and each reply waits for at least one frame
+#define TEST_ROUND_TRIP_MICROS  2000
+
+typedef struct testFrame_s {
+    uint8_t data[MSP_PORT_INBUF_SIZE + 16];
+    int length;
+} testFrame_t;
+
+static mspPort_t mspPort;
+
+static void buildV1Frame(testFrame_t *frame, uint8_t cmd, const uint8_t *payload, uint8_t size)
+{
+    uint8_t checksum = size ^ cmd;
+
+    frame->length = 0;
+    frame->data[frame->length++] = '$';
+    frame->data[frame->length++] = 'M';
+    frame->data[frame->length++] = '<';
+    frame->data[frame->length++] = size;
+    frame->data[frame->length++] = cmd;
+
+    for (int i = 0; i < size; i++) {
+        frame->data[frame->length++] = payload[i];
+        checksum ^= payload[i];
+    }
+
+    frame->data[frame->length++] = checksum;
+}
+
+static void buildV2Frame(testFrame_t *frame, uint16_t cmd, const uint8_t *payload, uint16_t size)
+{
+    frame->length = 0;
+    frame->data[frame->length++] = '$';
+    frame->data[frame->length++] = 'X';
+    frame->data[frame->length++] = '<';
+    frame->data[frame->length++] = 0;
+    frame->data[frame->length++] = cmd & 0xFF;
+    frame->data[frame->length++] = cmd >> 8;
+    frame->data[frame->length++] = size & 0xFF;
+    frame->data[frame->length++] = size >> 8;
+
+    memcpy(frame->data + frame->length, payload, size);
+    frame->length += size;
+
+    frame->data[frame->length] = crc8DvbS2Update(0, frame->data + 3, frame->length - 3);
+    frame->length++;
+}
+
+/**
+ * Feed the frame to the parser, returning true if it completed a command.
+ */
+static bool receiveFrame(const testFrame_t *frame)
+{
+    for (int i = 0; i < frame->length; i++) {
+        EXPECT_TRUE(mspFrameProcessReceivedData(&mspPort, frame->data[i]));
+
+        if (mspPort.c_state == COMMAND_RECEIVED) {
+            EXPECT_EQ(frame->length - 1, i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+class MspFrameTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        memset(&mspPort, 0, sizeof(mspPort));
+    }
+};
+
+TEST_F(MspFrameTest, Crc8MatchesDvbS2CheckValue)
+{
+    EXPECT_EQ(0xBC, crc8DvbS2Update(0, "123456789", 9));
+}
+
+TEST_F(MspFrameTest, ReceivesV1Command)
+{
+    // given
+    testFrame_t frame;
+    uint8_t payload[] = {1, 2, 3};
+
+    buildV1Frame(&frame, 102, payload, sizeof(payload));
+
+    // when
+    ASSERT_TRUE(receiveFrame(&frame));
+
+    // then
+    EXPECT_EQ(MSP_V1, mspPort.mspVersion);
+    EXPECT_EQ(102, mspPort.cmdMSP);
+    EXPECT_EQ(sizeof(payload), mspPort.dataSize);
+    EXPECT_EQ(0, memcmp(payload, mspPort.inBuf, sizeof(payload)));
+}
+
+TEST_F(MspFrameTest, ReceivesLargeV2Command)
+{
+    // given
+    testFrame_t frame;
+    uint8_t payload[MSP_PORT_INBUF_SIZE];
+
+    for (unsigned i = 0; i < sizeof(payload); i++) {
+        payload[i] = i * 13;
+    }
+
+    buildV2Frame(&frame, 0x1234, payload, sizeof(payload));
+
+    // when
+    ASSERT_TRUE(receiveFrame(&frame));
+
+    // then
+    EXPECT_EQ(MSP_V2, mspPort.mspVersion);
+    EXPECT_EQ(0x1234, mspPort.cmdMSP);
+    EXPECT_EQ(sizeof(payload), mspPort.dataSize);
+    EXPECT_EQ(0, memcmp(payload, mspPort.inBuf, sizeof(payload)));
+}
+
+TEST_F(MspFrameTest, AcceptsBothVersionsOnOnePort)
+{
+    testFrame_t frame;
+    uint8_t payload[] = {0xAA, 0x55};
+
+    for (int i = 0; i < 4; i++) {
+        if (i % 2) {
+            buildV2Frame(&frame, 100 + i, payload, sizeof(payload));
+        } else {
+            buildV1Frame(&frame, 100 + i, payload, sizeof(payload));
+        }
+
+        ASSERT_TRUE(receiveFrame(&frame));
+        EXPECT_EQ(i % 2 ? MSP_V2 : MSP_V1, mspPort.mspVersion);
+        EXPECT_EQ(100 + i, mspPort.cmdMSP);
+
+        mspPort.c_state = IDLE;
+    }
+}
+
+TEST_F(MspFrameTest, DropsCorruptV2Frame)
+{
+    // given
+    testFrame_t frame;
+    uint8_t payload[] = {1, 2, 3, 4};
+
+    buildV2Frame(&frame, 1, payload, sizeof(payload));
+    frame.data[9] ^= 0x01;
+
+    // when
+    EXPECT_FALSE(receiveFrame(&frame));
+
+    // then
+    EXPECT_EQ(IDLE, mspPort.c_state);
+
+    // and the next good frame still gets through
+    buildV2Frame(&frame, 1, payload, sizeof(payload));
+    EXPECT_TRUE(receiveFrame(&frame));
+}
+
+TEST_F(MspFrameTest, DropsV2FrameTooLargeForBuffer)
+{
+    const uint8_t header[] = {'$', 'X', '<', 0, 1, 0, (MSP_PORT_INBUF_SIZE + 1) & 0xFF, (MSP_PORT_INBUF_SIZE + 1) >> 8};
+
+    for (unsigned i = 0; i < sizeof(header); i++) {
+        mspFrameProcessReceivedData(&mspPort, header[i]);
+    }
+
+    EXPECT_EQ(IDLE, mspPort.c_state);
+
+    // Payload bytes that follow aren't mistaken for MSP
+    EXPECT_FALSE(mspFrameProcessReceivedData(&mspPort, 'x'));
+}
+
+TEST_F(MspFrameTest, LeavesOtherDataForOtherProtocols)
+{
+    EXPECT_FALSE(mspFrameProcessReceivedData(&mspPort, '#'));
+    EXPECT_EQ(IDLE, mspPort.c_state);
+}
+
+typedef struct testPort_s {
+    uint8_t data[8192];
+    int length;
+    int writes;
+} testPort_t;
+
+static testPort_t testPort;
+
+static void testPortWrite(void *arg, const uint8_t *data, int len)
+{
+    testPort_t *port = (testPort_t *)arg;
+
+    memcpy(port->data + port->length, data, len);
+    port->length += len;
+    port->writes++;
+}
+
+class MspReplyTest : public ::testing::Test {
+protected:
+    uint8_t replyBuffer[MSP_PORT_OUTBUF_SIZE];
+    mspReply_t reply;
+
+    virtual void SetUp() {
+        memset(&testPort, 0, sizeof(testPort));
+        mspReplyInit(&reply, replyBuffer, sizeof(replyBuffer), testPortWrite, &testPort);
+    }
+
+    void appendPattern(int len) {
+        for (int i = 0; i < len; i++) {
+            mspReplyAppend(&reply, i * 7);
+        }
+    }
+};
+
+static void expectPattern(const uint8_t *data, int len)
+{
+    for (int i = 0; i < len; i++) {
+        ASSERT_EQ((uint8_t)(i * 7), data[i]);
+    }
+}
+
+TEST_F(MspReplyTest, PatchesV1HeaderWithMeasuredSize)
+{
+    // when
+    EXPECT_TRUE(mspReplyBegin(&reply, MSP_V1, 101, false, 0));
+    appendPattern(11);
+    mspReplyFinish(&reply);
+
+    // then
+    EXPECT_EQ(1, testPort.writes);
+    ASSERT_EQ(5 + 11 + 1, testPort.length);
+    EXPECT_EQ(0, memcmp("$M>", testPort.data, 3));
+    EXPECT_EQ(11, testPort.data[3]);
+    EXPECT_EQ(101, testPort.data[4]);
+    expectPattern(testPort.data + 5, 11);
+
+    uint8_t checksum = 0;
+    for (int i = 3; i < testPort.length - 1; i++) {
+        checksum ^= testPort.data[i];
+    }
+    EXPECT_EQ(checksum, testPort.data[testPort.length - 1]);
+}
+
+TEST_F(MspReplyTest, UsesJumboFrameForLargeV1Reply)
+{
+    // when
+    mspReplyBegin(&reply, MSP_V1, 116, false, 300);
+    appendPattern(300);
+    mspReplyFinish(&reply);
+
+    // then
+    ASSERT_EQ(7 + 300 + 1, testPort.length);
+    EXPECT_EQ(JUMBO_FRAME_SIZE_LIMIT, testPort.data[3]);
+    EXPECT_EQ(116, testPort.data[4]);
+    EXPECT_EQ(300, testPort.data[5] | (testPort.data[6] << 8));
+    expectPattern(testPort.data + 7, 300);
+}
+
+TEST_F(MspReplyTest, WritesV2ReplyTheParserAccepts)
+{
+    // when
+    mspReplyBegin(&reply, MSP_V2, 0x4321, false, 0);
+    appendPattern(200);
+    mspReplyFinish(&reply);
+
+    // then
+    EXPECT_EQ(1, testPort.writes);
+    ASSERT_EQ(8 + 200 + 1, testPort.length);
+    EXPECT_EQ(0, memcmp("$X>", testPort.data, 3));
+
+    // Turn it into a command and check it with the receive side
+    testPort.data[2] = '<';
+    testFrame_t frame;
+    memcpy(frame.data, testPort.data, testPort.length);
+    frame.length = testPort.length;
+    memset(&mspPort, 0, sizeof(mspPort));
+
+    ASSERT_TRUE(receiveFrame(&frame));
+    EXPECT_EQ(0x4321, mspPort.cmdMSP);
+    EXPECT_EQ(200, mspPort.dataSize);
+    expectPattern(mspPort.inBuf, 200);
+}
+
+TEST_F(MspReplyTest, StreamsRepliesLargerThanBuffer)
+{
+    // given
+    static uint8_t block[1024];
+    const int replySize = 2 + sizeof(block) * 4;
+
+    for (unsigned i = 0; i < sizeof(block); i++) {
+        block[i] = i;
+    }
+
+    // when
+    mspReplyBegin(&reply, MSP_V2, 0x71, false, replySize);
+    mspReplyAppend(&reply, 0xAA);
+    mspReplyAppend(&reply, 0x55);
+    for (int i = 0; i < 4; i++) {
+        mspReplyAppendBuf(&reply, block, sizeof(block));
+    }
+    mspReplyFinish(&reply);
+
+    // then
+    ASSERT_EQ(8 + replySize + 1, testPort.length);
+    EXPECT_EQ(replySize, testPort.data[6] | (testPort.data[7] << 8));
+    EXPECT_EQ(0, memcmp(block, testPort.data + 8 + 2 + 3 * sizeof(block), sizeof(block)));
+    EXPECT_EQ(crc8DvbS2Update(0, testPort.data + 3, testPort.length - 4), testPort.data[testPort.length - 1]);
+}
+
+TEST_F(MspReplyTest, SendsErrorInsteadOfTruncatedReply)
+{
+    // when
+    mspReplyBegin(&reply, MSP_V1, 10, false, 0);
+    appendPattern(MSP_PORT_OUTBUF_SIZE);
+    mspReplyFinish(&reply);
+
+    // then
+    ASSERT_EQ(6, testPort.length);
+    EXPECT_EQ(0, memcmp("$M!", testPort.data, 3));
+    EXPECT_EQ(0, testPort.data[3]);
+}
+
+TEST_F(MspReplyTest, KeepsFirstHeader)
+{
+    // when
+    EXPECT_TRUE(mspReplyBegin(&reply, MSP_V1, 10, true, 0));
+    EXPECT_FALSE(mspReplyBegin(&reply, MSP_V1, 10, false, 0));
+    mspReplyFinish(&reply);
+    mspReplyFinish(&reply);
+
+    // then
+    EXPECT_EQ(1, testPort.writes);
+    EXPECT_EQ(0, memcmp("$M!", testPort.data, 3));
+}
+
+/*
+ * Upload a full LED strip configuration the way the configurator does: one LED per MSP_SET_LED_STRIP_CONFIG command
+ * over MSPv1 (the 64 byte receive buffer doesn't fit more), or the whole strip in one MSPv2 command.
+ */
+static void benchmarkLedStripUpload(mspVersion_e version, int ledsPerCommand)
+{
+    testFrame_t frame;
+    uint8_t payload[1 + TEST_LED_STRIP_LENGTH * TEST_LED_CONFIG_SIZE];
+    int commands = 0;
+    int bytes = 0;
+
+    clock_t start = clock();
+
+    for (int repeat = 0; repeat < 1000; repeat++) {
+        for (int led = 0; led < TEST_LED_STRIP_LENGTH; led += ledsPerCommand) {
+            uint16_t size = 1 + ledsPerCommand * TEST_LED_CONFIG_SIZE;
+
+            payload[0] = led;
+            memset(payload + 1, led, size - 1);
+
+            if (version == MSP_V2) {
+                buildV2Frame(&frame, 49, payload, size);
+            } else {
+                buildV1Frame(&frame, 49, payload, size);
+            }
+
+            ASSERT_TRUE(receiveFrame(&frame));
+            mspPort.c_state = IDLE;
+
+            if (repeat == 0) {
+                commands++;
+                bytes += frame.length;
+            }
+        }
+    }
+
+    double parseMicros = (double)(clock() - start) * 1000000 / CLOCKS_PER_SEC / 1000;
+
+    printf("MSPv%d LED strip upload: %d commands, %d bytes, %.1f us to parse, ~%d ms of round trips\n",
+        version == MSP_V2 ? 2 : 1, commands, bytes, parseMicros, commands * TEST_ROUND_TRIP_MICROS / 1000);
+}
+
+TEST_F(MspFrameTest, BenchmarkLedStripUpload)
+{
+    benchmarkLedStripUpload(MSP_V1, 1);
+    benchmarkLedStripUpload(MSP_V2, TEST_LED_STRIP_LENGTH);
+}
@@ -0,0 +1,276 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+    #include "common/packbits.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+typedef struct testOutput_s {
+    uint8_t data[16384];
+    int length;
+} testOutput_t;
+
+static void testWrite(void *arg, uint8_t data)
+{
+    testOutput_t *output = (testOutput_t *)arg;
+
+    output->data[output->length++] = data;
+}
+
+static uint32_t encodeInPieces(const uint8_t *data, int len, int pieceSize, testOutput_t *output)
+{
+    packbitsEncoder_t encoder;
+
+    output->length = 0;
+    packbitsEncoderInit(&encoder, testWrite, output);
+
+    for (int i = 0; i < len; i += pieceSize) {
+        packbitsEncode(&encoder, data + i, len - i < pieceSize ? len - i : pieceSize);
+    }
+
+    return packbitsEncoderFinish(&encoder);
+}
+
+static void expectRoundTrip(const uint8_t *data, int len)
+{
+    static testOutput_t encoded;
+    static uint8_t decoded[8192];
+
+    uint32_t encodedSize = encodeInPieces(data, len, len > 0 ? len : 1, &encoded);
+
+    EXPECT_EQ((int)encodedSize, encoded.length);
+    ASSERT_EQ(len, packbitsDecode(encoded.data, encoded.length, decoded, sizeof(decoded)));
+    EXPECT_EQ(0, memcmp(data, decoded, len));
+}
+
+/*
+ * Something like a Blackbox log: frames of small varint-encoded deltas with the occasional larger value, followed by
+ * erased flash.
+ */
+static void fillBlackboxLike(uint8_t *data, int len, int loggedLen)
+{
+    srand(1);
+
+    for (int i = 0; i < loggedLen; i++) {
+        int r = rand() % 16;
+
+        if (i % 40 == 0) {
+            data[i] = 'P';
+        } else if (r < 7) {
+            data[i] = 0;
+        } else if (r < 12) {
+            data[i] = rand() % 8;
+        } else {
+            data[i] = rand();
+        }
+    }
+
+    memset(data + loggedLen, 0xFF, len - loggedLen);
+}
+
+TEST(PackbitsTest, EncodesRunsAndLiterals)
+{
+    // given
+    const uint8_t data[] = {1, 2, 3, 7, 7, 7, 7, 7, 4, 4, 5};
+    const uint8_t expected[] = {2, 1, 2, 3, (uint8_t)-4, 7, 2, 4, 4, 5};
+    testOutput_t output;
+
+    // when
+    uint32_t encodedSize = encodeInPieces(data, sizeof(data), sizeof(data), &output);
+
+    // then
+    EXPECT_EQ(sizeof(expected), encodedSize);
+    EXPECT_EQ(0, memcmp(expected, output.data, sizeof(expected)));
+}
+
+TEST(PackbitsTest, RoundTrips)
+{
+    static uint8_t data[4096];
+
+    // empty
+    expectRoundTrip(data, 0);
+
+    // long runs, longer than a single packet can describe
+    memset(data, 0xFF, sizeof(data));
+    expectRoundTrip(data, sizeof(data));
+
+    // no runs at all, longer than a single literal packet
+    for (unsigned i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+    expectRoundTrip(data, sizeof(data));
+
+    // runs of every length mixed with literals
+    int i = 0;
+    for (int runLength = 1; i + runLength + 1 <= (int)sizeof(data) && runLength < 140; runLength++) {
+        memset(data + i, runLength, runLength);
+        i += runLength;
+        data[i++] = 0xAA;
+    }
+    expectRoundTrip(data, i);
+
+    fillBlackboxLike(data, sizeof(data), 3000);
+    expectRoundTrip(data, sizeof(data));
+}
+
+TEST(PackbitsTest, OutputDoesNotDependOnPieceSize)
+{
+    // given
+    static uint8_t data[4096];
+    static testOutput_t whole, pieces;
+    fillBlackboxLike(data, sizeof(data), 2000);
+
+    // when
+    encodeInPieces(data, sizeof(data), sizeof(data), &whole);
+
+    // then
+    const int pieceSizes[] = {1, 7, 64, 129};
+    for (unsigned i = 0; i < sizeof(pieceSizes) / sizeof(pieceSizes[0]); i++) {
+        encodeInPieces(data, sizeof(data), pieceSizes[i], &pieces);
+
+        ASSERT_EQ(whole.length, pieces.length);
+        EXPECT_EQ(0, memcmp(whole.data, pieces.data, whole.length));
+    }
+}
+
+TEST(PackbitsTest, CountsWithoutWriter)
+{
+    // given
+    uint8_t data[300];
+    fillBlackboxLike(data, sizeof(data), 200);
+    testOutput_t output;
+    packbitsEncoder_t encoder;
+
+    // when
+    packbitsEncoderInit(&encoder, NULL, NULL);
+    packbitsEncode(&encoder, data, sizeof(data));
+    uint32_t countedSize = packbitsEncoderFinish(&encoder);
+
+    // then
+    EXPECT_EQ(encodeInPieces(data, sizeof(data), sizeof(data), &output), countedSize);
+}
+
+TEST(PackbitsTest, WorstCaseExpansion)
+{
+    // given
+    uint8_t data[1280];
+    for (unsigned i = 0; i < sizeof(data); i++) {
+        data[i] = i & 1;
+    }
+    testOutput_t output;
+
+    // when
+    uint32_t encodedSize = encodeInPieces(data, sizeof(data), sizeof(data), &output);
+
+    // then
+    EXPECT_EQ(sizeof(data) + sizeof(data) / PACKBITS_MAX_LITERALS, encodedSize);
+}
+
+TEST(PackbitsTest, RejectsBadStreams)
+{
+    uint8_t output[16];
+
+    // truncated literal packet
+    const uint8_t truncatedLiteral[] = {3, 1, 2};
+    EXPECT_EQ(-1, packbitsDecode(truncatedLiteral, sizeof(truncatedLiteral), output, sizeof(output)));
+
+    // run missing its byte
+    const uint8_t truncatedRun[] = {(uint8_t)-3};
+    EXPECT_EQ(-1, packbitsDecode(truncatedRun, sizeof(truncatedRun), output, sizeof(output)));
+
+    // too big for the output
+    const uint8_t tooLong[] = {(uint8_t)-100, 0};
+    EXPECT_EQ(-1, packbitsDecode(tooLong, sizeof(tooLong), output, sizeof(output)));
+
+    // no-op packets are skipped
+    const uint8_t noOp[] = {128, 0, 42};
+    EXPECT_EQ(1, packbitsDecode(noOp, sizeof(noOp), output, sizeof(output)));
+    EXPECT_EQ(42, output[0]);
+}
+
+/*
+ * Estimate the time to download a flash chip with MSP_DATAFLASH_READ, for the legacy 128 byte requests answered one at
+ * a time and for bulk requests with compression and several requests kept outstanding.
+ */
+
+#define BENCHMARK_IMAGE_SIZE        (256 * 1024)
+#define BENCHMARK_LOGGED_SIZE       (200 * 1024)
+#define BENCHMARK_LINK_BYTES_PER_S  11520       // 115200 baud UART
+#define BENCHMARK_ROUND_TRIP_MICROS 5000        // Host turnaround plus waiting for the MSP task to run
+
+#define MSP_V1_OVERHEAD             6           // $M>, size, command, checksum
+#define MSP_V1_JUMBO_OVERHEAD       (MSP_V1_OVERHEAD + 2)
+#define MSP_DATAFLASH_REQUEST_SIZE  (MSP_V1_OVERHEAD + 4 + 2 + 1)
+
+static uint32_t benchmarkDownload(const uint8_t *image, uint32_t chunkSize, bool compress, bool pipelined)
+{
+    packbitsEncoder_t encoder;
+    uint64_t micros = 0;
+
+    for (uint32_t address = 0; address < BENCHMARK_IMAGE_SIZE; address += chunkSize) {
+        uint32_t payloadSize = chunkSize;
+
+        if (compress) {
+            packbitsEncoderInit(&encoder, NULL, NULL);
+            packbitsEncode(&encoder, image + address, chunkSize);
+
+            uint32_t encodedSize = packbitsEncoderFinish(&encoder);
+            if (encodedSize < payloadSize) {
+                payloadSize = encodedSize;
+            }
+        }
+
+        uint32_t replySize = payloadSize + (chunkSize > 128 ? 4 + 2 + 1 + MSP_V1_JUMBO_OVERHEAD : 4 + MSP_V1_OVERHEAD);
+
+        micros += (uint64_t)replySize * 1000000 / BENCHMARK_LINK_BYTES_PER_S;
+
+        // With requests pipelined the next request is already waiting, so the link never goes idle
+        if (!pipelined) {
+            micros += BENCHMARK_ROUND_TRIP_MICROS + (uint64_t)MSP_DATAFLASH_REQUEST_SIZE * 1000000 / BENCHMARK_LINK_BYTES_PER_S;
+        }
+    }
+
+    return (uint64_t)BENCHMARK_IMAGE_SIZE * 1000000 / micros;
+}
+
+TEST(PackbitsBenchmark, DataflashDownloadRate)
+{
+    // given
+    static uint8_t image[BENCHMARK_IMAGE_SIZE];
+    fillBlackboxLike(image, BENCHMARK_IMAGE_SIZE, BENCHMARK_LOGGED_SIZE);
+
+    // when
+    uint32_t legacy = benchmarkDownload(image, 128, false, false);
+    uint32_t bulk = benchmarkDownload(image, 4096, false, false);
+    uint32_t bulkCompressed = benchmarkDownload(image, 4096, true, false);
+    uint32_t bulkCompressedPipelined = benchmarkDownload(image, 4096, true, true);
+
+    // then
+    printf("dataflash download: legacy %u bytes/s, bulk %u bytes/s, compressed %u bytes/s, compressed and pipelined %u bytes/s\n",
+        legacy, bulk, bulkCompressed, bulkCompressedPipelined);
+
+    EXPECT_GT(bulk, legacy);
+    EXPECT_GT(bulkCompressed, bulk);
+    EXPECT_GT(bulkCompressedPipelined, bulkCompressed);
+}
@@ -52,6 +52,11 @@ typedef struct
     void* test;
 } TIM_TypeDef;
 
+typedef struct
+{
+    void* test;
+} I2C_TypeDef;
+
 typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
 typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
 
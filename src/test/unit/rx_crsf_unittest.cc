@@ -0,0 +1,350 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/crc.h"
+
+    #include "config/config.h"
+
+    #include "drivers/serial.h"
+    #include "io/serial.h"
+    #include "rx/rx.h"
+    #include "rx/crsf.h"
+
+    #include "serial_sim.h"
+
+    extern uint16_t rssi;
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define CRSF_CHANNELS               16
+#define CRSF_RC_FRAME_SIZE          (CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + 4)
+
+// Crossfire receivers send a channel frame every 6.7ms in 150Hz mode
+#define TEST_FRAME_PERIOD_MICROS    6667
+
+/*
+ * A byte stream as a receiver sends it: six channel frames with the throttle rising by 40 each time, and a link
+ * statistics frame (-52dBm, 100% link quality) after the third.
+ */
+static const uint8_t recordedStream[] = {
+    0xC8, 0x18, 0x16, 0xCD, 0xBB, 0x1D, 0x2B, 0xEE, 0xA7, 0xBA, 0xD6, 0x35, 0x10, 0x7D, 0xB0, 0x93, 0x9E, 0xFB, 0x56, 0x87, 0x41, 0xF2, 0xFD, 0x0E, 0x75, 0x0E,
+    0xC8, 0x18, 0x16, 0x9C, 0x93, 0x1D, 0x35, 0x86, 0xC7, 0x38, 0xBE, 0x5D, 0x50, 0x7C, 0x7B, 0xFB, 0x9F, 0xFE, 0xFC, 0x86, 0x3F, 0xFC, 0x4D, 0xCF, 0x76, 0x0C,
+    0xC8, 0x18, 0x16, 0x67, 0xFB, 0x1D, 0x3F, 0x72, 0x67, 0x35, 0xAE, 0x81, 0xAF, 0x7D, 0xAC, 0xA3, 0xDE, 0xF8, 0xEE, 0xE6, 0xBC, 0x00, 0x9A, 0x6E, 0x78, 0x7C,
+    0xC8, 0x0C, 0x14, 0x34, 0x3A, 0x64, 0x09, 0x00, 0x02, 0x03, 0x2C, 0x62, 0xFD, 0x6C,
+    0xC8, 0x18, 0x16, 0x52, 0x53, 0x1E, 0x49, 0xA8, 0x17, 0xB3, 0x96, 0xB9, 0x4F, 0x7F, 0xC1, 0x83, 0x9D, 0xF5, 0x8E, 0x86, 0x3D, 0x10, 0xCA, 0xED, 0x79, 0x26,
+    0xC8, 0x18, 0x16, 0x1D, 0xEB, 0x1E, 0x53, 0xAE, 0xC7, 0xB4, 0x9A, 0xA1, 0x2F, 0x84, 0xAD, 0x7B, 0x1D, 0xF9, 0x02, 0x67, 0x3D, 0x09, 0x72, 0x4D, 0x76, 0xDD,
+    0xC8, 0x18, 0x16, 0x46, 0xC3, 0x1D, 0x5D, 0xFC, 0xF7, 0xB2, 0x81, 0xD5, 0x6F, 0x81, 0xB4, 0x93, 0x1D, 0x06, 0xE1, 0x76, 0xBF, 0x07, 0x12, 0x6D, 0x78, 0x91,
+};
+
+// What the last frame of the stream decodes to, in us
+static const uint16_t recordedStreamLastChannels[CRSF_CHANNELS] = {
+    1404, 1475, 1113, 1519, 1390, 1362, 1513, 1527, 1473, 1472, 1535, 1430, 1515, 1530, 1403, 1482
+};
+
+static serialSimPort_t receiver, fc;
+
+static rxConfig_t rxConfig;
+static rxRuntimeConfig_t testRxRuntimeConfig;
+static rcReadRawDataPtr readRawRC;
+
+static int buildRcFrame(uint8_t *frame, const uint16_t *channels)
+{
+    memset(frame, 0, CRSF_RC_FRAME_SIZE);
+    frame[0] = CRSF_ADDRESS_FLIGHT_CONTROLLER;
+    frame[1] = CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + 2;
+    frame[2] = CRSF_FRAMETYPE_RC_CHANNELS_PACKED;
+
+    // 11 bits per channel, least significant bit first
+    for (int ch = 0; ch < CRSF_CHANNELS; ch++) {
+        for (int bit = 0; bit < 11; bit++) {
+            if (channels[ch] & (1 << bit)) {
+                const int position = ch * 11 + bit;
+                frame[3 + position / 8] |= 1 << (position % 8);
+            }
+        }
+    }
+
+    frame[CRSF_RC_FRAME_SIZE - 1] = crc8DvbS2Update(0, &frame[2], CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + 1);
+
+    return CRSF_RC_FRAME_SIZE;
+}
+
+static void sendRcFrame(uint16_t value)
+{
+    uint16_t channels[CRSF_CHANNELS];
+    uint8_t frame[CRSF_RC_FRAME_SIZE];
+
+    for (int ch = 0; ch < CRSF_CHANNELS; ch++) {
+        channels[ch] = value;
+    }
+    buildRcFrame(frame, channels);
+    serialWriteBuf(&receiver.port, frame, sizeof(frame));
+}
+
+// Sends the recorded stream a frame at a time, returning how many channel frames were decoded
+static int playRecordedStream(void)
+{
+    int framesDecoded = 0;
+
+    for (unsigned offset = 0; offset < sizeof(recordedStream); offset += recordedStream[offset + 1] + 2) {
+        serialWriteBuf(&receiver.port, (uint8_t *)&recordedStream[offset], recordedStream[offset + 1] + 2);
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS / 2);
+
+        if (crsfFrameStatus() == SERIAL_RX_FRAME_COMPLETE) {
+            framesDecoded++;
+        }
+    }
+
+    return framesDecoded;
+}
+
+class CrsfTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        serialSimInit();
+
+        memset(&rxConfig, 0, sizeof(rxConfig));
+        rxConfig.midrc = 1500;
+
+        ASSERT_TRUE(crsfInit(&rxConfig, &testRxRuntimeConfig, &readRawRC));
+        ASSERT_TRUE(crsfRxIsActive());
+
+        // Let the link settle so that the first frame isn't taken for the continuation of an earlier one
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    }
+
+    virtual void TearDown() {
+        // Drop anything left over from the test
+        crsfFrameStatus();
+        serialSimClose();
+    }
+};
+
+TEST_F(CrsfTest, CentresChannelsBeforeFirstFrame)
+{
+    EXPECT_EQ(CRSF_CHANNELS, testRxRuntimeConfig.channelCount);
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, crsfFrameStatus());
+    EXPECT_EQ(1500, readRawRC(&testRxRuntimeConfig, 0));
+}
+
+TEST_F(CrsfTest, DecodesRecordedStream)
+{
+    // when
+    const int framesDecoded = playRecordedStream();
+
+    // then
+    EXPECT_EQ(6, framesDecoded);
+    for (int ch = 0; ch < CRSF_CHANNELS; ch++) {
+        EXPECT_EQ(recordedStreamLastChannels[ch], readRawRC(&testRxRuntimeConfig, ch)) << "channel " << ch;
+    }
+
+    crsfLinkStatistics_t linkStatistics;
+    ASSERT_TRUE(crsfGetLinkStatistics(&linkStatistics));
+    EXPECT_EQ(52, linkStatistics.uplinkRssiAnt1);
+    EXPECT_EQ(100, linkStatistics.uplinkLinkQuality);
+    EXPECT_EQ(9, linkStatistics.uplinkSnr);
+    EXPECT_EQ(2, linkStatistics.rfMode);
+    EXPECT_EQ(-3, linkStatistics.downlinkSnr);
+}
+
+TEST_F(CrsfTest, DecodesRecordedStreamOneByteAtATime)
+{
+    // given a port which can't pass on a burst at a time
+    fc.port.spanCallback = NULL;
+
+    // when
+    const int framesDecoded = playRecordedStream();
+
+    // then
+    EXPECT_EQ(6, framesDecoded);
+    EXPECT_EQ(recordedStreamLastChannels[2], readRawRC(&testRxRuntimeConfig, 2));
+}
+
+TEST_F(CrsfTest, DecodesBackToBackFrames)
+{
+    // when the whole stream arrives without gaps
+    serialWriteBuf(&receiver.port, (uint8_t *)recordedStream, sizeof(recordedStream));
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+    // then the last channel frame is the one decoded
+    EXPECT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+    for (int ch = 0; ch < CRSF_CHANNELS; ch++) {
+        EXPECT_EQ(recordedStreamLastChannels[ch], readRawRC(&testRxRuntimeConfig, ch)) << "channel " << ch;
+    }
+}
+
+TEST_F(CrsfTest, ScalesChannelsToMicroseconds)
+{
+    // when
+    sendRcFrame(172);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+
+    // then
+    EXPECT_EQ(988, readRawRC(&testRxRuntimeConfig, 0));
+
+    // when
+    sendRcFrame(992);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+
+    // then
+    EXPECT_EQ(1500, readRawRC(&testRxRuntimeConfig, 0));
+
+    // when
+    sendRcFrame(1811);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+
+    // then
+    EXPECT_EQ(2012, readRawRC(&testRxRuntimeConfig, 15));
+}
+
+TEST_F(CrsfTest, IgnoresFrameWithBadCrc)
+{
+    // given
+    uint8_t frame[CRSF_RC_FRAME_SIZE];
+    memcpy(frame, recordedStream, sizeof(frame));
+    frame[10] ^= 0x01;
+
+    // when
+    serialWriteBuf(&receiver.port, frame, sizeof(frame));
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+    // then
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, crsfFrameStatus());
+}
+
+TEST_F(CrsfTest, ResynchronisesAfterPartialFrame)
+{
+    // given the tail end of a frame, as when the receiver is plugged in part way through one
+    fc.port.spanCallback = NULL;
+    serialWriteBuf(&receiver.port, (uint8_t *)recordedStream + 5, CRSF_RC_FRAME_SIZE - 5);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, crsfFrameStatus());
+
+    // when
+    sendRcFrame(1811);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+    // then
+    EXPECT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+    EXPECT_EQ(2012, readRawRC(&testRxRuntimeConfig, 0));
+}
+
+TEST_F(CrsfTest, TimesFramesFromTheirFirstByte)
+{
+    for (int i = 0; i < 2; i++) {
+        // given the span and byte at a time paths
+        if (i == 1) {
+            fc.port.spanCallback = NULL;
+        }
+
+        // when
+        const uint32_t sentAt = serialSimMicros();
+        sendRcFrame(992);
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+        ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+
+        // then
+        EXPECT_NEAR(sentAt, testRxRuntimeConfig.frameStartedAt, 30);
+    }
+}
+
+TEST_F(CrsfTest, FeedsLinkQualityToRssi)
+{
+    // given
+    rssi = 0;
+
+    // when
+    playRecordedStream();
+
+    // then
+    EXPECT_EQ(1023, rssi);
+}
+
+TEST_F(CrsfTest, SendsTelemetryAfterChannelFrame)
+{
+    // given
+    static const uint8_t telemetry[] = { 0xC8, 0x04, 0x08, 0x00, 0x00, 0x00 };
+    crsfRxWriteTelemetryData(telemetry, sizeof(telemetry));
+    EXPECT_FALSE(crsfRxIsTelemetryBufEmpty());
+
+    // when
+    sendRcFrame(992);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, crsfFrameStatus());
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS / 2);
+
+    // then
+    EXPECT_TRUE(crsfRxIsTelemetryBufEmpty());
+    ASSERT_EQ(sizeof(telemetry), serialRxBytesWaiting(&receiver.port));
+    for (unsigned i = 0; i < sizeof(telemetry); i++) {
+        EXPECT_EQ(telemetry[i], serialRead(&receiver.port));
+    }
+}
+
+// STUBS
+
+extern "C" {
+
+uint16_t rssi;
+
+static serialPortConfig_t portConfig;
+
+uint32_t micros(void)
+{
+    return serialSimMicros();
+}
+
+bool feature(uint32_t mask)
+{
+    UNUSED(mask);
+
+    return false;
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    return &portConfig;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+
+    serialSimLink(&receiver, &fc, baudRate, true);
+    receiver.port.options = fc.port.options = options;
+    fc.port.mode = mode;
+    fc.port.callback = callback;
+
+    return &fc.port;
+}
+
+}
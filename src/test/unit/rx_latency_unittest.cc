@@ -0,0 +1,178 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "build/debug.h"
+
+    #include "rx/rx_latency.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+class RxLatencyTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        rxLatencyReset();
+        debugMode = DEBUG_NONE;
+    }
+};
+
+TEST_F(RxLatencyTest, StartsEmpty)
+{
+    // when
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+
+    // then
+    EXPECT_EQ(0U, stats.count);
+    EXPECT_EQ(0U, stats.averageUs);
+    for (int i = 0; i < RX_LATENCY_BUCKET_COUNT; i++) {
+        EXPECT_EQ(0U, stats.buckets[i]);
+    }
+}
+
+TEST_F(RxLatencyTest, RecordsEachFrameOnce)
+{
+    // when the flight loop runs several times with the data from each frame
+    for (uint32_t frameStartedAt = 10000; frameStartedAt < 10000 + 3 * 9000; frameStartedAt += 9000) {
+        rxLatencyRecord(RX_LATENCY_RC_COMMAND, frameStartedAt, frameStartedAt + 3200);
+        rxLatencyRecord(RX_LATENCY_RC_COMMAND, frameStartedAt, frameStartedAt + 3325);
+        rxLatencyRecord(RX_LATENCY_RC_COMMAND, frameStartedAt, frameStartedAt + 3450);
+    }
+
+    // then only the first time counts
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_RC_COMMAND, &stats);
+
+    EXPECT_EQ(3U, stats.count);
+    EXPECT_EQ(3200U, stats.minUs);
+    EXPECT_EQ(3200U, stats.maxUs);
+    EXPECT_EQ(3U, stats.buckets[3200 / RX_LATENCY_BUCKET_WIDTH_US]);
+
+    // and the other stage is untouched
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+    EXPECT_EQ(0U, stats.count);
+}
+
+TEST_F(RxLatencyTest, RecordsFrameStartedAtZero)
+{
+    // when a frame started just as micros() wrapped round to 0, and the flight loop runs twice with it
+    rxLatencyRecord(RX_LATENCY_MOTORS, 0, 3000);
+    rxLatencyRecord(RX_LATENCY_MOTORS, 0, 3125);
+
+    // then it counts once, like any other frame
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+    EXPECT_EQ(1U, stats.count);
+    EXPECT_EQ(3000U, stats.maxUs);
+
+    // when the next frame arrives
+    rxLatencyRecord(RX_LATENCY_MOTORS, 9000, 9000 + 3000);
+
+    // then
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+    EXPECT_EQ(2U, stats.count);
+}
+
+TEST_F(RxLatencyTest, CalculatesMinMaxAndAverage)
+{
+    // when
+    rxLatencyRecord(RX_LATENCY_MOTORS, 1000, 1000 + 4000);
+    rxLatencyRecord(RX_LATENCY_MOTORS, 2000, 2000 + 1000);
+    rxLatencyRecord(RX_LATENCY_MOTORS, 3000, 3000 + 2500);
+
+    // then
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+
+    EXPECT_EQ(3U, stats.count);
+    EXPECT_EQ(1000U, stats.minUs);
+    EXPECT_EQ(4000U, stats.maxUs);
+    EXPECT_EQ(2500U, stats.averageUs);
+    EXPECT_EQ(1U, stats.buckets[1000 / RX_LATENCY_BUCKET_WIDTH_US]);
+    EXPECT_EQ(1U, stats.buckets[2500 / RX_LATENCY_BUCKET_WIDTH_US]);
+    EXPECT_EQ(1U, stats.buckets[4000 / RX_LATENCY_BUCKET_WIDTH_US]);
+}
+
+TEST_F(RxLatencyTest, CountsSlowFramesInLastBucket)
+{
+    // when
+    rxLatencyRecord(RX_LATENCY_MOTORS, 1000, 1000 + RX_LATENCY_BUCKET_COUNT * RX_LATENCY_BUCKET_WIDTH_US);
+    rxLatencyRecord(RX_LATENCY_MOTORS, 2000, 2000 + 1000000);
+
+    // then
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_MOTORS, &stats);
+
+    EXPECT_EQ(2U, stats.buckets[RX_LATENCY_BUCKET_COUNT - 1]);
+    EXPECT_EQ(1000000U, stats.maxUs);
+}
+
+TEST_F(RxLatencyTest, HandlesMicrosWrapping)
+{
+    // when
+    rxLatencyRecord(RX_LATENCY_RC_COMMAND, UINT32_MAX - 999, 1000);
+
+    // then
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_RC_COMMAND, &stats);
+
+    EXPECT_EQ(2000U, stats.minUs);
+}
+
+TEST_F(RxLatencyTest, LogsLatencyToDebugWhenSelected)
+{
+    // given
+    debugMode = DEBUG_RX_LATENCY;
+
+    // when
+    rxLatencyRecord(RX_LATENCY_RC_COMMAND, 1000, 1000 + 3100);
+    rxLatencyRecord(RX_LATENCY_MOTORS, 1000, 1000 + 3300);
+
+    // then
+    EXPECT_EQ(3100, debug[RX_LATENCY_RC_COMMAND]);
+    EXPECT_EQ(3300, debug[RX_LATENCY_MOTORS]);
+}
+
+TEST_F(RxLatencyTest, Resets)
+{
+    // given
+    rxLatencyRecord(RX_LATENCY_RC_COMMAND, 1000, 1000 + 3100);
+
+    // when
+    rxLatencyReset();
+
+    // then
+    rxLatencyStats_t stats;
+    rxLatencyGetStats(RX_LATENCY_RC_COMMAND, &stats);
+    EXPECT_EQ(0U, stats.count);
+    EXPECT_EQ(0U, stats.maxUs);
+}
+
+// STUBS
+
+extern "C" {
+
+int16_t debug[DEBUG16_VALUE_COUNT];
+uint8_t debugMode;
+
+}
@@ -0,0 +1,465 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#include "common/crc.h"
+#include "common/utils.h"
+
+#include "config/config.h"
+
+#include "drivers/serial.h"
+#include "io/serial.h"
+
+#include "rx/rx.h"
+#include "rx/sbus.h"
+#include "rx/spektrum.h"
+#include "rx/sumd.h"
+#include "rx/sumh.h"
+#include "rx/xbus.h"
+#include "rx/ibus.h"
+#include "rx/jetiexbus.h"
+#include "rx/crsf.h"
+
+#include "telemetry/telemetry.h"
+
+#include "rx_parser_harness.h"
+
+bool sbusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+bool spektrumInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+bool sumdInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+bool sumhInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+
+uint8_t xBusRj01CRC8(uint8_t inData, uint8_t seed);
+
+// Long enough for every driver to give up on a partial frame
+#define RX_PARSER_SETTLE_MICROS     50000
+
+static rxConfig_t harnessRxConfig;
+static rxRuntimeConfig_t harnessRxRuntimeConfig;
+static rcReadRawDataPtr readRawRC;
+
+static const rxParserProtocol_t *protocol;
+static serialPort_t rxPort;
+static serialPortConfig_t rxPortConfig;
+
+static uint32_t nowMicros = 0;
+
+// CRC16-CCITT as used by SUMD and XBUS, most significant bit first
+static uint16_t crc16Ccitt(uint16_t crc, uint8_t a)
+{
+    crc ^= (uint16_t)a << 8;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+// The same polynomial least significant bit first, as used by Jeti EX Bus
+static uint16_t crc16Kermit(uint16_t crc, uint8_t a)
+{
+    crc ^= a;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+    return crc;
+}
+
+// Packs 11 bit values least significant bit first, as SBUS and CRSF do
+static void pack11BitChannels(uint8_t *data, const uint16_t *values, int count)
+{
+    uint32_t bits = 0;
+    int bitCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        bits |= (uint32_t)values[i] << bitCount;
+        bitCount += 11;
+        while (bitCount >= 8) {
+            *data++ = bits & 0xFF;
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    if (bitCount) {
+        *data = bits & 0xFF;
+    }
+}
+
+static int buildSbusFrame(uint8_t *frame, const uint16_t *channels)
+{
+    uint16_t values[16];
+
+    // Decoded as 0.625 * value + 880
+    for (int i = 0; i < 16; i++) {
+        values[i] = ((channels[i] - 880) * 8 + 4) / 5;
+    }
+
+    memset(frame, 0, 25);
+    frame[0] = 0x0F;
+    pack11BitChannels(&frame[1], values, 16);
+    return 25;
+}
+
+static int buildSpektrumFrame(uint8_t *frame, const uint16_t *channels, int channelShift, int valueShift)
+{
+    frame[0] = 0;       // Fades
+    frame[1] = valueShift ? 0x12 : 0x01;  // DSMX 11ms for 2048 mode, DSM2 22ms for 1024
+
+    for (int i = 0; i < 7; i++) {
+        const uint16_t value = (channels[i] - 988) << valueShift;
+        frame[2 + i * 2] = (i << channelShift) | (value >> 8);
+        frame[3 + i * 2] = value & 0xFF;
+    }
+    return 16;
+}
+
+static int buildSpektrum1024Frame(uint8_t *frame, const uint16_t *channels)
+{
+    return buildSpektrumFrame(frame, channels, 2, 0);
+}
+
+static int buildSpektrum2048Frame(uint8_t *frame, const uint16_t *channels)
+{
+    return buildSpektrumFrame(frame, channels, 3, 1);
+}
+
+static int buildSumdFrame(uint8_t *frame, const uint16_t *channels)
+{
+    const int channelCount = 8;
+    int length = 0;
+
+    frame[length++] = 0xA8;
+    frame[length++] = 0x01;     // Valid, not failsafe
+    frame[length++] = channelCount;
+    for (int i = 0; i < channelCount; i++) {
+        frame[length++] = (channels[i] * 8) >> 8;
+        frame[length++] = (channels[i] * 8) & 0xFF;
+    }
+
+    uint16_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc = crc16Ccitt(crc, frame[i]);
+    }
+    frame[length++] = crc >> 8;
+    frame[length++] = crc & 0xFF;
+    return length;
+}
+
+static int buildSumhFrame(uint8_t *frame, const uint16_t *channels)
+{
+    memset(frame, 0, 21);
+    frame[0] = 0xA8;
+
+    // Decoded as value / 6.4 - 375
+    for (int i = 0; i < 8; i++) {
+        const uint16_t value = ((channels[i] + 375) * 32 + 4) / 5;
+        frame[3 + i * 2] = value >> 8;
+        frame[4 + i * 2] = value & 0xFF;
+    }
+    return 21;
+}
+
+static int buildXbusModeBFrame(uint8_t *frame, const uint16_t *channels)
+{
+    int length = 0;
+
+    frame[length++] = 0xA1;
+    // Decoded as 800 + value * 1400 / 4096
+    for (int i = 0; i < 12; i++) {
+        const uint16_t value = ((channels[i] - 800) * 4096 + 1399) / 1400;
+        frame[length++] = value >> 8;
+        frame[length++] = value & 0xFF;
+    }
+
+    uint16_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc = crc16Ccitt(crc, frame[i]);
+    }
+    frame[length++] = crc >> 8;
+    frame[length++] = crc & 0xFF;
+    return length;
+}
+
+static int buildXbusRj01Frame(uint8_t *frame, const uint16_t *channels)
+{
+    // A mode B frame wrapped in three bytes of header and three of trailer, the last being a CRC8 of the lot
+    frame[0] = 0xA1;
+    frame[1] = 30;
+    frame[2] = 0;
+    const int length = 3 + buildXbusModeBFrame(&frame[3], channels);
+    frame[length] = 0;
+    frame[length + 1] = 0;
+
+    // Sealed the way the driver checks it, which passes the CRC and data the other way around to xBusRj01CRC8()
+    uint8_t crc = 0;
+    for (int i = 0; i < length + 2; i++) {
+        crc = xBusRj01CRC8(crc, frame[i]);
+    }
+    frame[length + 2] = crc;
+    return length + 3;
+}
+
+static int buildIbusFrame(uint8_t *frame, const uint16_t *channels)
+{
+    int length = 0;
+
+    frame[length++] = 0x20;
+    frame[length++] = 0x40;
+    // 14 channels, of which the driver uses 10
+    for (int i = 0; i < 14; i++) {
+        const uint16_t value = i < 10 ? channels[i] : 1500;
+        frame[length++] = value & 0xFF;
+        frame[length++] = value >> 8;
+    }
+
+    uint16_t checksum = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+        checksum -= frame[i];
+    }
+    frame[length++] = checksum & 0xFF;
+    frame[length++] = checksum >> 8;
+    return length;
+}
+
+static int buildJetiExBusFrame(uint8_t *frame, const uint16_t *channels)
+{
+    const int channelCount = 16;
+    int length = 0;
+
+    frame[length++] = 0x3E;
+    frame[length++] = 0x03;     // Channel data, no telemetry wanted
+    frame[length++] = 6 + channelCount * 2 + 2;
+    frame[length++] = 0;        // Packet ID
+    frame[length++] = 0x31;     // Channel data
+    frame[length++] = channelCount * 2;
+    for (int i = 0; i < channelCount; i++) {
+        frame[length++] = (channels[i] * 8) & 0xFF;
+        frame[length++] = (channels[i] * 8) >> 8;
+    }
+
+    uint16_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc = crc16Kermit(crc, frame[i]);
+    }
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+    return length;
+}
+
+static int buildCrsfFrame(uint8_t *frame, const uint16_t *channels)
+{
+    uint16_t values[16];
+
+    // Decoded as value * 1024 / 1639 + 881
+    for (int i = 0; i < 16; i++) {
+        values[i] = ((channels[i] - 881) * 1639 + 1023) / 1024;
+    }
+
+    frame[0] = CRSF_ADDRESS_FLIGHT_CONTROLLER;
+    frame[1] = CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + CRSF_FRAME_LENGTH_TYPE_CRC;
+    frame[2] = CRSF_FRAMETYPE_RC_CHANNELS_PACKED;
+    pack11BitChannels(&frame[3], values, 16);
+    frame[3 + CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE] = crc8DvbS2Update(0, &frame[2], CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + 1);
+    return CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + 4;
+}
+
+const rxParserProtocol_t rxParserProtocols[] = {
+    { "SBUS",             SERIALRX_SBUS,              sbusInit,      sbusFrameStatus,      buildSbusFrame,         16, 0, 120,  9000 },
+    { "Spektrum 1024",    SERIALRX_SPEKTRUM1024,      spektrumInit,  spektrumFrameStatus,  buildSpektrum1024Frame,  7, 0,  87, 22000 },
+    { "Spektrum 2048",    SERIALRX_SPEKTRUM2048,      spektrumInit,  spektrumFrameStatus,  buildSpektrum2048Frame,  7, 0,  87, 11000 },
+    { "SUMD",             SERIALRX_SUMD,              sumdInit,      sumdFrameStatus,      buildSumdFrame,          8, 0,  87, 10000 },
+    { "SUMH",             SERIALRX_SUMH,              sumhInit,      sumhFrameStatus,      buildSumhFrame,          8, 1,  87, 10000 },
+    { "XBUS mode B",      SERIALRX_XBUS_MODE_B,       xBusInit,      xBusFrameStatus,      buildXbusModeBFrame,    12, 0,  87, 14000 },
+    { "XBUS mode B RJ01", SERIALRX_XBUS_MODE_B_RJ01,  xBusInit,      xBusFrameStatus,      buildXbusRj01Frame,     12, 0,  40, 14000 },
+    { "IBUS",             SERIALRX_IBUS,              ibusInit,      ibusFrameStatus,      buildIbusFrame,         10, 0,  87,  7000 },
+    { "Jeti EX Bus",      SERIALRX_JETIEXBUS,         jetiExBusInit, jetiExBusFrameStatus, buildJetiExBusFrame,    16, 0,  80, 10000 },
+    { "CRSF",             SERIALRX_CRSF,              crsfInit,      crsfFrameStatus,      buildCrsfFrame,         16, 0,  24,  6667 },
+};
+
+const int rxParserProtocolCount = ARRAYLEN(rxParserProtocols);
+
+bool rxParserInit(const rxParserProtocol_t *newProtocol)
+{
+    protocol = newProtocol;
+
+    memset(&harnessRxConfig, 0, sizeof(harnessRxConfig));
+    harnessRxConfig.serialrx_provider = protocol->provider;
+    harnessRxConfig.midrc = 1500;
+    memset(&harnessRxRuntimeConfig, 0, sizeof(harnessRxRuntimeConfig));
+    memset(&rxPort, 0, sizeof(rxPort));
+
+    if (!protocol->init(&harnessRxConfig, &harnessRxRuntimeConfig, &readRawRC) || !rxPort.callback) {
+        return false;
+    }
+
+    // Let the line go quiet, so the driver doesn't take the first byte for part of a frame from an earlier test
+    rxParserAdvanceMicros(RX_PARSER_SETTLE_MICROS);
+    return true;
+}
+
+void rxParserReceive(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        nowMicros += protocol->byteMicros;
+        rxPort.callback(data[i]);
+    }
+}
+
+void rxParserReceiveBurst(const uint8_t *data, int length, int splitAt)
+{
+    // Passed on once the line has been idle for a byte
+    nowMicros += (length + 1) * protocol->byteMicros;
+
+    if (splitAt <= 0 || splitAt >= length) {
+        splitAt = length;
+    }
+
+    const int spans[2] = { splitAt, length - splitAt };
+    for (int i = 0; i < 2; i++) {
+        if (spans[i] == 0) {
+            continue;
+        }
+        if (rxPort.spanCallback) {
+            rxPort.spanCallback(data, spans[i]);
+        } else {
+            for (int j = 0; j < spans[i]; j++) {
+                rxPort.callback(data[j]);
+            }
+        }
+        data += spans[i];
+    }
+}
+
+bool rxParserTakesBursts(void)
+{
+    return rxPort.spanCallback != NULL;
+}
+
+void rxParserAdvanceMicros(uint32_t delta)
+{
+    nowMicros += delta;
+}
+
+uint32_t rxParserMicros(void)
+{
+    return nowMicros;
+}
+
+uint8_t rxParserFrameStatus(void)
+{
+    return protocol->frameStatus();
+}
+
+uint8_t rxParserChannelCount(void)
+{
+    return harnessRxRuntimeConfig.channelCount;
+}
+
+uint16_t rxParserReadRawRC(uint8_t channel)
+{
+    return readRawRC(&harnessRxRuntimeConfig, channel);
+}
+
+// What the drivers need from the rest of the firmware
+
+uint16_t rssi;
+
+telemetryData_t telemetryData;
+
+serialPort_t *telemetrySharedPort = NULL;
+
+uint32_t micros(void)
+{
+    return nowMicros;
+}
+
+bool feature(uint32_t mask)
+{
+    UNUSED(mask);
+
+    return false;
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    return &rxPortConfig;
+}
+
+bool telemetryCheckRxPortShared(serialPortConfig_t *portConfig)
+{
+    UNUSED(portConfig);
+
+    return false;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+
+    rxPort.callback = callback;
+    rxPort.baudRate = baudRate;
+    rxPort.mode = mode;
+    rxPort.options = options;
+
+    return &rxPort;
+}
+
+// Only used by rxParserReceiveBurst(), rxParserReceive() passes bytes on one at a time as an interrupt driven UART does
+void serialSetReceiveSpanCallback(serialPort_t *instance, serialReceiveSpanCallbackPtr spanCallback)
+{
+    instance->spanCallback = spanCallback;
+}
+
+void serialSetMode(serialPort_t *instance, portMode_t mode)
+{
+    instance->mode = mode;
+}
+
+void serialWrite(serialPort_t *instance, uint8_t ch)
+{
+    UNUSED(instance);
+    UNUSED(ch);
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(count);
+}
+
+uint32_t serialRxBytesWaiting(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return 0;
+}
+
+bool isSerialTransmitBufferEmpty(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rx/rx.h"
+
+/*
+ * Drives the serial RX drivers without a UART, for fuzzing and timing their receive callbacks on the host.
+ *
+ * Each protocol has a frame builder, so tests can make valid frames carrying known channel values and mutate them as
+ * they like. Bytes are passed to the driver's receive callback the way the UART interrupt would, with micros()
+ * advancing by a byte's time on the wire for each one, or to its span callback a burst at a time the way a UART with
+ * RX DMA does when the line goes idle. The clock never goes backwards, as the drivers keep the time of the last byte
+ * they saw from one test to the next.
+ */
+
+#define RX_PARSER_FRAME_SIZE_MAX    64
+#define RX_PARSER_CHANNELS_MAX      16
+
+typedef bool (*rxParserInitFnPtr)(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+typedef uint8_t (*rxParserFrameStatusFnPtr)(void);
+
+// Encodes channel values, in us, into a frame and returns its length
+typedef int (*rxParserBuildFrameFnPtr)(uint8_t *frame, const uint16_t *channels);
+
+typedef struct rxParserProtocol_s {
+    const char *name;
+    uint8_t provider;                       // SERIALRX_*
+    rxParserInitFnPtr init;
+    rxParserFrameStatusFnPtr frameStatus;
+    rxParserBuildFrameFnPtr buildFrame;
+    uint8_t channelCount;                   // Channels a frame carries
+    uint8_t tolerance;                      // How far decoded values can be from what was sent, where the units don't map exactly to us
+    uint16_t byteMicros;                    // Time a byte takes on the wire
+    uint16_t framePeriodMicros;             // How often receivers send a frame
+} rxParserProtocol_t;
+
+extern const rxParserProtocol_t rxParserProtocols[];
+extern const int rxParserProtocolCount;
+
+bool rxParserInit(const rxParserProtocol_t *protocol);
+
+void rxParserReceive(const uint8_t *data, int length);
+// Bursts that run past the end of the DMA buffer are passed on as two spans, the first splitAt bytes long
+void rxParserReceiveBurst(const uint8_t *data, int length, int splitAt);
+bool rxParserTakesBursts(void);       // The driver has a span callback rather than taking bursts a byte at a time
+void rxParserAdvanceMicros(uint32_t delta);
+uint32_t rxParserMicros(void);
+
+uint8_t rxParserFrameStatus(void);
+uint8_t rxParserChannelCount(void);
+uint16_t rxParserReadRawRC(uint8_t channel);
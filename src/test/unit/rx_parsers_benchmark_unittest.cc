@@ -0,0 +1,120 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "rx/rx.h"
+
+    #include "rx_parser_harness.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * Times each serial RX driver's receive callback, which runs in the UART interrupt and so takes time from the gyro
+ * loop for every byte, and its frame decoding, which runs in the RX task once a frame is complete.
+ *
+ * The drivers are built optimised, but for the host rather than the flight controller, so the figures are only good
+ * for comparing protocols and for spotting a change that makes one slower.
+ */
+
+#define BENCHMARK_FRAMES        100000
+#define BENCHMARK_FRAME_VARIANTS 64
+
+typedef struct benchmarkFrame_s {
+    uint8_t data[RX_PARSER_FRAME_SIZE_MAX];
+    int length;
+} benchmarkFrame_t;
+
+static benchmarkFrame_t frames[BENCHMARK_FRAME_VARIANTS];
+
+static uint64_t nanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void buildFrames(const rxParserProtocol_t *protocol)
+{
+    for (int i = 0; i < BENCHMARK_FRAME_VARIANTS; i++) {
+        uint16_t channels[RX_PARSER_CHANNELS_MAX];
+
+        for (int ch = 0; ch < RX_PARSER_CHANNELS_MAX; ch++) {
+            channels[ch] = 1000 + (i * 37 + ch * 101) % 1001;
+        }
+        frames[i].length = protocol->buildFrame(frames[i].data, channels);
+    }
+}
+
+// Returns how long it took to pass on the frames, and decode them too if asked
+static uint64_t receiveFrames(const rxParserProtocol_t *protocol, bool decode, int *framesDecoded)
+{
+    *framesDecoded = 0;
+
+    const uint64_t startedAt = nanos();
+    for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+        const benchmarkFrame_t *frame = &frames[i % BENCHMARK_FRAME_VARIANTS];
+
+        rxParserReceive(frame->data, frame->length);
+        rxParserAdvanceMicros(protocol->framePeriodMicros);
+
+        if (decode && (rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE)) {
+            (*framesDecoded)++;
+        }
+    }
+    return nanos() - startedAt;
+}
+
+TEST(RxParsersBenchmarkTest, TimeReceiveAndDecode)
+{
+    printf("%16s %12s %12s %12s %12s\n", "protocol", "bytes/frame", "ns/byte", "ns decoding", "ns/frame");
+
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+        buildFrames(protocol);
+
+        int framesDecoded;
+        uint64_t bytes = 0;
+        for (int f = 0; f < BENCHMARK_FRAMES; f++) {
+            bytes += frames[f % BENCHMARK_FRAME_VARIANTS].length;
+        }
+
+        // when
+        receiveFrames(protocol, true, &framesDecoded);  // Warm up
+        const uint64_t receiveNanos = receiveFrames(protocol, false, &framesDecoded);
+        const uint64_t totalNanos = receiveFrames(protocol, true, &framesDecoded);
+
+        // then every frame was decoded, so it was the real work that was timed
+        EXPECT_EQ(BENCHMARK_FRAMES, framesDecoded);
+
+        const double nanosPerByte = (double)receiveNanos / bytes;
+        const double decodeNanos = totalNanos > receiveNanos ? (double)(totalNanos - receiveNanos) / BENCHMARK_FRAMES : 0;
+        printf("%16s %12.1f %12.2f %12.1f %12.1f\n", protocol->name, (double)bytes / BENCHMARK_FRAMES,
+            nanosPerByte, decodeNanos, (double)totalNanos / BENCHMARK_FRAMES);
+    }
+}
@@ -0,0 +1,367 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "rx/rx.h"
+
+    #include "rx_parser_harness.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * Every serial RX driver is fed valid frames, mutated frames and noise. The test is built with the address and
+ * undefined behaviour sanitizers, so a receive callback or frame decoder that strays outside its buffers fails it even
+ * if nothing visibly goes wrong.
+ */
+
+#define FUZZ_FRAMES_PER_PROTOCOL    5000
+#define FUZZ_SEED                   0x5EED1234
+
+static uint32_t randomState;
+
+// xorshift32, so that failures can be reproduced
+static uint32_t randomNumber(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static uint32_t randomBelow(uint32_t limit)
+{
+    return randomNumber() % limit;
+}
+
+// The channel values the frame with this index carries, in us
+static void frameChannels(int frameIndex, uint16_t *channels)
+{
+    for (int ch = 0; ch < RX_PARSER_CHANNELS_MAX; ch++) {
+        channels[ch] = 1000 + (frameIndex * 37 + ch * 101) % 1001;
+    }
+}
+
+static void expectChannels(const rxParserProtocol_t *protocol, const uint16_t *channels)
+{
+    for (int ch = 0; ch < protocol->channelCount; ch++) {
+        EXPECT_NEAR(channels[ch], rxParserReadRawRC(ch), protocol->tolerance) << "channel " << ch;
+    }
+}
+
+// Reads everything a driver offers, as the main loop would
+static void readAllChannels(void)
+{
+    for (int ch = 0; ch < rxParserChannelCount(); ch++) {
+        rxParserReadRawRC(ch);
+    }
+}
+
+// Mangles a frame the way a bad connection might, returning its new length
+static int mutateFrame(uint8_t *frame, int length)
+{
+    const int mutations = 1 + randomBelow(3);
+
+    for (int i = 0; i < mutations && length > 0; i++) {
+        const int position = randomBelow(length);
+
+        switch (randomBelow(5)) {
+        case 0:
+            frame[position] ^= 1 << randomBelow(8);
+            break;
+        case 1:
+            frame[position] = randomNumber();
+            break;
+        case 2:
+            memmove(&frame[position], &frame[position + 1], length - position - 1);
+            length--;
+            break;
+        case 3:
+            if (length < RX_PARSER_FRAME_SIZE_MAX) {
+                memmove(&frame[position + 1], &frame[position], length - position);
+                frame[position] = randomNumber();
+                length++;
+            }
+            break;
+        case 4:
+            length = position;
+            break;
+        }
+    }
+
+    return length;
+}
+
+// Sends bytes with the occasional pause part way through, as when the receiver is busy or a byte is lost on the wire
+static void receiveWithGaps(const rxParserProtocol_t *protocol, const uint8_t *data, int length)
+{
+    while (length > 0) {
+        const int chunk = 1 + randomBelow(length);
+
+        rxParserReceive(data, chunk);
+        data += chunk;
+        length -= chunk;
+
+        if (randomBelow(8) == 0) {
+            rxParserAdvanceMicros(randomBelow(protocol->framePeriodMicros * 2));
+        }
+    }
+}
+
+static void expectValidFrameDecoded(const rxParserProtocol_t *protocol, int frameIndex)
+{
+    uint16_t channels[RX_PARSER_CHANNELS_MAX];
+    uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+
+    frameChannels(frameIndex, channels);
+    const int length = protocol->buildFrame(frame, channels);
+
+    rxParserReceive(frame, length);
+    rxParserAdvanceMicros(protocol->framePeriodMicros);
+
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE);
+    expectChannels(protocol, channels);
+}
+
+TEST(RxParsersTest, DecodeValidFrames)
+{
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        for (int frameIndex = 0; frameIndex < 20; frameIndex++) {
+            // expect
+            expectValidFrameDecoded(protocol, frameIndex);
+        }
+    }
+}
+
+TEST(RxParsersTest, WaitForTheRestOfAFrame)
+{
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        uint16_t channels[RX_PARSER_CHANNELS_MAX];
+        uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+        frameChannels(0, channels);
+        const int length = protocol->buildFrame(frame, channels);
+
+        // when
+        rxParserReceive(frame, length - 1);
+
+        // then
+        EXPECT_EQ(SERIAL_RX_FRAME_PENDING, rxParserFrameStatus());
+
+        // when
+        rxParserReceive(&frame[length - 1], 1);
+
+        // then
+        EXPECT_EQ(SERIAL_RX_FRAME_COMPLETE, rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE);
+        expectChannels(protocol, channels);
+    }
+}
+
+TEST(RxParsersTest, DecodeFramesPassedOnInBursts)
+{
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+        EXPECT_TRUE(rxParserTakesBursts());
+
+        for (int frameIndex = 0; frameIndex < 20; frameIndex++) {
+            uint16_t channels[RX_PARSER_CHANNELS_MAX];
+            uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+            frameChannels(frameIndex, channels);
+            const int length = protocol->buildFrame(frame, channels);
+
+            // when each frame arrives in one go, with every other one split at the end of the DMA buffer
+            rxParserReceiveBurst(frame, length, frameIndex % 2 ? 1 + frameIndex % (length - 1) : 0);
+            rxParserAdvanceMicros(protocol->framePeriodMicros);
+
+            // then
+            ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE) << "frame " << frameIndex;
+            expectChannels(protocol, channels);
+        }
+    }
+}
+
+TEST(RxParsersTest, DecodeXbusModeBFrameLikeRj01Header)
+{
+    const rxParserProtocol_t *protocol = NULL;
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        if (rxParserProtocols[i].provider == SERIALRX_XBUS_MODE_B) {
+            protocol = &rxParserProtocols[i];
+        }
+    }
+    ASSERT_TRUE(protocol != NULL);
+
+    // given a mode B frame whose second byte is the length an RJ01 frame has there
+    ASSERT_TRUE(rxParserInit(protocol));
+
+    uint16_t channels[RX_PARSER_CHANNELS_MAX];
+    uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+    frameChannels(0, channels);
+    channels[0] = 3430;
+    const int length = protocol->buildFrame(frame, channels);
+    ASSERT_EQ(30, frame[1]);
+
+    // when
+    rxParserReceive(frame, length);
+
+    // then it is decoded once, as mode B only
+    EXPECT_EQ(SERIAL_RX_FRAME_COMPLETE, rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE);
+    expectChannels(protocol, channels);
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, rxParserFrameStatus());
+}
+
+TEST(RxParsersTest, ResynchroniseAfterLongSilence)
+{
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given a frame cut off part way through
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        uint16_t channels[RX_PARSER_CHANNELS_MAX];
+        uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+        frameChannels(99, channels);
+        rxParserReceive(frame, protocol->buildFrame(frame, channels) / 2);
+
+        // when nothing more arrives for over half the range of micros(), some 36 minutes
+        rxParserAdvanceMicros(0x80000000 + protocol->framePeriodMicros);
+
+        // then the partial frame is still dropped
+        expectValidFrameDecoded(protocol, 1);
+    }
+}
+
+TEST(RxParsersTest, SurviveMutatedFrames)
+{
+    randomState = FUZZ_SEED;
+
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        // when
+        int framesAccepted = 0;
+        for (int frameIndex = 0; frameIndex < FUZZ_FRAMES_PER_PROTOCOL; frameIndex++) {
+            uint16_t channels[RX_PARSER_CHANNELS_MAX];
+            uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+
+            frameChannels(frameIndex, channels);
+            const int length = mutateFrame(frame, protocol->buildFrame(frame, channels));
+
+            receiveWithGaps(protocol, frame, length);
+            rxParserAdvanceMicros(randomBelow(protocol->framePeriodMicros));
+
+            if (rxParserFrameStatus() & SERIAL_RX_FRAME_COMPLETE) {
+                framesAccepted++;
+            }
+            readAllChannels();
+        }
+
+        // then the driver picks up again once the link is good
+        rxParserAdvanceMicros(protocol->framePeriodMicros * 4);
+        expectValidFrameDecoded(protocol, 0);
+
+        // Protocols without a checksum accept plenty of these
+        printf("%16s: accepted %4d of %d mutated frames\n", protocol->name, framesAccepted, FUZZ_FRAMES_PER_PROTOCOL);
+    }
+}
+
+TEST(RxParsersTest, SurviveNoise)
+{
+    randomState = FUZZ_SEED;
+
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        // when
+        for (int burst = 0; burst < FUZZ_FRAMES_PER_PROTOCOL; burst++) {
+            uint8_t noise[RX_PARSER_FRAME_SIZE_MAX];
+            const int length = randomBelow(sizeof(noise));
+
+            for (int b = 0; b < length; b++) {
+                noise[b] = randomNumber();
+            }
+            receiveWithGaps(protocol, noise, length);
+
+            rxParserFrameStatus();
+            readAllChannels();
+        }
+
+        // then
+        rxParserAdvanceMicros(protocol->framePeriodMicros * 4);
+        expectValidFrameDecoded(protocol, 0);
+    }
+}
+
+TEST(RxParsersTest, SurviveBytesArrivingBackToBack)
+{
+    randomState = FUZZ_SEED;
+
+    for (int i = 0; i < rxParserProtocolCount; i++) {
+        const rxParserProtocol_t *protocol = &rxParserProtocols[i];
+        SCOPED_TRACE(protocol->name);
+
+        // given
+        ASSERT_TRUE(rxParserInit(protocol));
+
+        // when there is never a pause long enough for the driver to resynchronise on
+        for (int frameIndex = 0; frameIndex < FUZZ_FRAMES_PER_PROTOCOL; frameIndex++) {
+            uint16_t channels[RX_PARSER_CHANNELS_MAX];
+            uint8_t frame[RX_PARSER_FRAME_SIZE_MAX];
+
+            frameChannels(frameIndex, channels);
+            const int length = mutateFrame(frame, protocol->buildFrame(frame, channels));
+            rxParserReceive(frame, length);
+
+            rxParserFrameStatus();
+            readAllChannels();
+        }
+
+        // then
+        rxParserAdvanceMicros(protocol->framePeriodMicros * 4);
+        expectValidFrameDecoded(protocol, 0);
+    }
+}
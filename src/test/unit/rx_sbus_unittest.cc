@@ -0,0 +1,286 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "drivers/serial.h"
+    #include "io/serial.h"
+    #include "rx/rx.h"
+    #include "rx/sbus.h"
+    #include "telemetry/telemetry.h"
+
+    #include "serial_sim.h"
+
+    bool sbusInit(rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define SBUS_FRAME_SIZE         25
+#define SBUS_CHANNELS           16
+
+// FrSky receivers send a frame every 9ms
+#define TEST_FRAME_PERIOD_MICROS 9000
+
+static serialSimPort_t receiver, fc;
+
+static rxConfig_t rxConfig;
+static rxRuntimeConfig_t testRxRuntimeConfig;
+static rcReadRawDataPtr readRawRC;
+
+// How often the driver's receive callbacks were called, which is how often the UART interrupt would fire
+static int byteCallbacks;
+static int spanCallbacks;
+static serialReceiveCallbackPtr sbusByteCallback;
+static serialReceiveSpanCallbackPtr sbusSpanCallback;
+
+static void countingByteCallback(uint16_t c)
+{
+    byteCallbacks++;
+    sbusByteCallback(c);
+}
+
+static void countingSpanCallback(const uint8_t *data, int length)
+{
+    spanCallbacks++;
+    sbusSpanCallback(data, length);
+}
+
+static void buildFrame(uint8_t *frame, const uint16_t *channels, uint8_t flags)
+{
+    memset(frame, 0, SBUS_FRAME_SIZE);
+    frame[0] = 0x0F;
+
+    // 11 bits per channel, least significant bit first
+    for (int ch = 0; ch < SBUS_CHANNELS; ch++) {
+        for (int bit = 0; bit < 11; bit++) {
+            if (channels[ch] & (1 << bit)) {
+                const int position = ch * 11 + bit;
+                frame[1 + position / 8] |= 1 << (position % 8);
+            }
+        }
+    }
+
+    frame[23] = flags;
+}
+
+// The channel values the frame with this index carries, in SBUS units
+static void frameChannels(int frameIndex, uint16_t *channels)
+{
+    for (int ch = 0; ch < SBUS_CHANNELS; ch++) {
+        channels[ch] = 173 + (frameIndex * 37 + ch * 101) % 1640;
+    }
+}
+
+static void sendFrame(int frameIndex)
+{
+    uint16_t channels[SBUS_CHANNELS];
+    uint8_t frame[SBUS_FRAME_SIZE];
+
+    frameChannels(frameIndex, channels);
+    buildFrame(frame, channels, 0);
+    serialWriteBuf(&receiver.port, frame, sizeof(frame));
+}
+
+static void expectFrameDecoded(int frameIndex)
+{
+    uint16_t channels[SBUS_CHANNELS];
+    frameChannels(frameIndex, channels);
+
+    ASSERT_EQ(SERIAL_RX_FRAME_COMPLETE, sbusFrameStatus());
+
+    for (int ch = 0; ch < SBUS_CHANNELS; ch++) {
+        EXPECT_EQ((uint16_t)(0.625f * channels[ch] + 880), readRawRC(&testRxRuntimeConfig, ch)) << "frame " << frameIndex << " channel " << ch;
+    }
+}
+
+class SbusTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        serialSimInit();
+
+        memset(&rxConfig, 0, sizeof(rxConfig));
+        rxConfig.midrc = 1500;
+
+        ASSERT_TRUE(sbusInit(&rxConfig, &testRxRuntimeConfig, &readRawRC));
+        ASSERT_TRUE(fc.port.spanCallback != NULL);
+
+        sbusByteCallback = fc.port.callback;
+        sbusSpanCallback = fc.port.spanCallback;
+        fc.port.callback = countingByteCallback;
+        fc.port.spanCallback = countingSpanCallback;
+        byteCallbacks = spanCallbacks = 0;
+
+        // Let the link settle so that the first frame isn't taken for the continuation of an earlier one
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    }
+
+    virtual void TearDown() {
+        serialSimClose();
+    }
+};
+
+TEST_F(SbusTest, DecodesFramePassedOnWhenLineGoesIdle)
+{
+    // when
+    const uint32_t sentAt = serialSimMicros();
+    sendFrame(0);
+    serialSimAdvanceMicros(SBUS_FRAME_SIZE * 120 - 10);
+
+    // then nothing has been passed on while the frame is still arriving
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, sbusFrameStatus());
+
+    // when
+    serialSimAdvanceMicros(200);
+
+    // then
+    expectFrameDecoded(0);
+    EXPECT_EQ(1, spanCallbacks);
+    EXPECT_EQ(0, byteCallbacks);
+
+    // and the frame is timed from when it started to arrive
+    EXPECT_NEAR(sentAt, testRxRuntimeConfig.frameStartedAt, 120);
+}
+
+TEST_F(SbusTest, DecodesStreamOfFrames)
+{
+    // The RX buffer wraps every few frames, splitting a frame into two spans
+    const int frameCount = 50;
+
+    for (int i = 0; i < frameCount; i++) {
+        // when
+        sendFrame(i);
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+        // then
+        expectFrameDecoded(i);
+        if (HasFatalFailure()) {
+            return;
+        }
+    }
+
+    // Frames split at the end of the buffer arrive in two spans in one go
+    const int splitFrames = (frameCount * SBUS_FRAME_SIZE) / SERIAL_SIM_BUFFER_SIZE;
+    EXPECT_EQ(frameCount + splitFrames, spanCallbacks);
+    EXPECT_EQ(0U, fc.stats.rxOverruns);
+
+    printf("%d SBUS frames: %d receive callbacks, against %d with one per byte\n",
+        frameCount, spanCallbacks, frameCount * SBUS_FRAME_SIZE);
+}
+
+TEST_F(SbusTest, DecodesFramesOneByteAtATime)
+{
+    // given a port which can't pass on a burst at a time
+    fc.port.spanCallback = NULL;
+
+    for (int i = 0; i < 5; i++) {
+        // when
+        const uint32_t sentAt = serialSimMicros();
+        sendFrame(i);
+        serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+        // then
+        expectFrameDecoded(i);
+        EXPECT_NEAR(sentAt, testRxRuntimeConfig.frameStartedAt, 120);
+    }
+    EXPECT_EQ(5 * SBUS_FRAME_SIZE, byteCallbacks);
+}
+
+TEST_F(SbusTest, ResynchronisesAfterPartialFrame)
+{
+    // given the tail end of a frame, as when the receiver is plugged in part way through one
+    uint16_t channels[SBUS_CHANNELS];
+    uint8_t frame[SBUS_FRAME_SIZE];
+    frameChannels(99, channels);
+    buildFrame(frame, channels, 0);
+
+    serialWriteBuf(&receiver.port, frame + 10, SBUS_FRAME_SIZE - 10);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+    EXPECT_EQ(SERIAL_RX_FRAME_PENDING, sbusFrameStatus());
+
+    // when
+    sendFrame(1);
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+    // then
+    expectFrameDecoded(1);
+}
+
+TEST_F(SbusTest, ReportsFailsafeFlag)
+{
+    // given
+    uint16_t channels[SBUS_CHANNELS];
+    uint8_t frame[SBUS_FRAME_SIZE];
+    frameChannels(0, channels);
+    buildFrame(frame, channels, 1 << 3);
+
+    // when
+    serialWriteBuf(&receiver.port, frame, sizeof(frame));
+    serialSimAdvanceMicros(TEST_FRAME_PERIOD_MICROS);
+
+    // then
+    EXPECT_EQ(SERIAL_RX_FRAME_COMPLETE | SERIAL_RX_FRAME_FAILSAFE, sbusFrameStatus());
+}
+
+// STUBS
+
+extern "C" {
+
+serialPort_t *telemetrySharedPort = NULL;
+
+static serialPortConfig_t portConfig;
+
+uint32_t micros(void)
+{
+    return serialSimMicros();
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    return &portConfig;
+}
+
+bool telemetryCheckRxPortShared(serialPortConfig_t *config)
+{
+    UNUSED(config);
+
+    return false;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+
+    serialSimLink(&receiver, &fc, baudRate, true);
+    receiver.port.options = fc.port.options = options;
+    fc.port.mode = mode;
+    fc.port.callback = callback;
+
+    return &fc.port;
+}
+
+}
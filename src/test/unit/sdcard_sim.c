@@ -0,0 +1,804 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/sdcard.h"
+#include "io/asyncfatfs/fat_standard.h"
+
+#include "sdcard_sim.h"
+
+// Blocks per chunk of RAM storage, chunks are only allocated once something non-zero is written to them
+#define SDCARD_SIM_CHUNK_BLOCKS      128
+
+// Match SDCARD_NON_DMA_CHUNK_SIZE and SDCARD_WRITE_QUEUE_LENGTH in the real driver
+#define SDCARD_SIM_NON_DMA_CHUNK     256
+#define SDCARD_SIM_WRITE_QUEUE_LENGTH 2
+
+#define SDCARD_SIM_PARTITION_START   8192
+#define SDCARD_SIM_RESERVED_SECTORS  32
+#define SDCARD_SIM_FSINFO_SECTOR     1
+#define SDCARD_SIM_BACKUP_BOOT       6
+
+typedef enum {
+    SDCARD_SIM_STATE_NOT_PRESENT,
+    SDCARD_SIM_STATE_RESET,
+    SDCARD_SIM_STATE_READY,
+    SDCARD_SIM_STATE_READING,
+    SDCARD_SIM_STATE_SENDING_WRITE,
+    SDCARD_SIM_STATE_WAITING_FOR_WRITE,
+    SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS,
+    SDCARD_SIM_STATE_STOPPING_MULTIPLE_BLOCK_WRITE
+} sdcardSimState_e;
+
+static sdcardSimConfig_t simConfig;
+static sdcardSimStats_t stats;
+
+static sdcardMetadata_t metadata;
+
+static uint8_t **chunks = NULL;
+static uint32_t numChunks = 0;
+static FILE *imageFile = NULL;
+
+static uint64_t nowNanos = 0;
+static uint64_t busyUntilNanos = 0;
+
+static sdcardSimState_e state = SDCARD_SIM_STATE_NOT_PRESENT;
+
+static uint32_t multiWriteBlocksRemain;
+static uint32_t multiWriteNextBlock;
+static uint32_t writeCount;
+
+static bool failNextRead, failNextWrite;
+static uint32_t pendingStallMicros;
+
+static struct {
+    uint8_t *buffer;
+    uint32_t blockIndex;
+    sdcard_operationCompleteCallback_c callback;
+    uint32_t callbackData;
+    int chunkIndex;
+    uint64_t startNanos;
+} pendingOperation;
+
+static struct {
+    uint8_t *buffer;
+    sdcard_operationCompleteCallback_c callback;
+    uint32_t callbackData;
+} writeQueue[SDCARD_SIM_WRITE_QUEUE_LENGTH];
+
+static int writeQueueHead, writeQueueCount;
+
+static sdcard_profilerCallback_c profiler = NULL;
+
+static void sdcardSimSpend(uint64_t nanos)
+{
+    nowNanos += nanos;
+}
+
+static void sdcardSimSpiTransfer(int bytes)
+{
+    sdcardSimSpend((uint64_t) bytes * simConfig.spiByteNanos);
+}
+
+static void sdcardSimCommand(void)
+{
+    sdcardSimSpend((uint64_t) simConfig.commandMicros * 1000);
+}
+
+static bool sdcardSimIsBusy(void)
+{
+    return nowNanos < busyUntilNanos;
+}
+
+/**
+ * Clock idle bytes until the card is ready or maxBytes have been sent, like sdcard_waitForIdle() in the real driver.
+ */
+static bool sdcardSimWaitForIdle(int maxBytes)
+{
+    for (int i = 0; i < maxBytes; i++) {
+        sdcardSimSpiTransfer(1);
+
+        if (!sdcardSimIsBusy()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void sdcardSimBusyFor(uint32_t micros)
+{
+    busyUntilNanos = nowNanos + (uint64_t) micros * 1000;
+}
+
+static void sdcardSimCallEnd(uint64_t startNanos)
+{
+    uint32_t spent = (nowNanos - startNanos) / 1000;
+
+    stats.callMicros += spent;
+    if (spent > stats.maxCallMicros) {
+        stats.maxCallMicros = spent;
+    }
+}
+
+void sdcardSimDefaultConfig(sdcardSimConfig_t *config)
+{
+    memset(config, 0, sizeof(*config));
+
+    // 1GB
+    config->numBlocks = 1024 * 2048;
+
+    config->useDMA = true;
+
+    // Typical figures for a class 10 card on a 21MHz SPI bus
+    config->spiByteNanos = 380;
+    config->commandMicros = 20;
+    config->readLatencyMicros = 400;
+    config->writeBusyMicros = 1500;
+    config->multiWriteBusyMicros = 250;
+    config->stopTransmissionMicros = 1000;
+    config->resetMicros = 50000;
+}
+
+/**
+ * Create the simulated card. If an image filename is configured, the card's contents are those of the file (which is
+ * extended to the card size if needed) and all writes go through to it.
+ */
+bool sdcardSimInit(const sdcardSimConfig_t *config)
+{
+    sdcardSimClose();
+
+    simConfig = *config;
+
+    if (config->imageFilename) {
+        imageFile = fopen(config->imageFilename, "r+b");
+
+        if (!imageFile) {
+            imageFile = fopen(config->imageFilename, "w+b");
+        }
+
+        if (!imageFile) {
+            return false;
+        }
+
+        if (simConfig.numBlocks == 0) {
+            fseek(imageFile, 0, SEEK_END);
+            simConfig.numBlocks = ftell(imageFile) / SDCARD_SIM_BLOCK_SIZE;
+        }
+    } else {
+        numChunks = (simConfig.numBlocks + SDCARD_SIM_CHUNK_BLOCKS - 1) / SDCARD_SIM_CHUNK_BLOCKS;
+        chunks = calloc(numChunks, sizeof(*chunks));
+
+        if (!chunks) {
+            return false;
+        }
+    }
+
+    if (simConfig.numBlocks == 0) {
+        sdcardSimClose();
+        return false;
+    }
+
+    memset(&metadata, 0, sizeof(metadata));
+    memcpy(metadata.productName, "SIMSD", sizeof(metadata.productName));
+    metadata.numBlocks = simConfig.numBlocks;
+
+    nowNanos = 0;
+    busyUntilNanos = 0;
+    state = SDCARD_SIM_STATE_NOT_PRESENT;
+    multiWriteBlocksRemain = 0;
+    writeQueueHead = writeQueueCount = 0;
+    writeCount = 0;
+    failNextRead = failNextWrite = false;
+    pendingStallMicros = 0;
+    profiler = NULL;
+
+    sdcardSimResetStats();
+
+    return true;
+}
+
+void sdcardSimClose(void)
+{
+    if (imageFile) {
+        fclose(imageFile);
+        imageFile = NULL;
+    }
+
+    if (chunks) {
+        for (uint32_t i = 0; i < numChunks; i++) {
+            free(chunks[i]);
+        }
+        free(chunks);
+        chunks = NULL;
+    }
+
+    numChunks = 0;
+    state = SDCARD_SIM_STATE_NOT_PRESENT;
+}
+
+void sdcardSimReadBlockDirect(uint32_t blockIndex, uint8_t *buffer)
+{
+    memset(buffer, 0, SDCARD_SIM_BLOCK_SIZE);
+
+    if (imageFile) {
+        fseek(imageFile, (long) blockIndex * SDCARD_SIM_BLOCK_SIZE, SEEK_SET);
+        // Short reads past the end of a sparse file leave zeros in the buffer
+        if (fread(buffer, 1, SDCARD_SIM_BLOCK_SIZE, imageFile) != SDCARD_SIM_BLOCK_SIZE) {
+            clearerr(imageFile);
+        }
+    } else {
+        uint8_t *chunk = chunks[blockIndex / SDCARD_SIM_CHUNK_BLOCKS];
+
+        if (chunk) {
+            memcpy(buffer, chunk + (blockIndex % SDCARD_SIM_CHUNK_BLOCKS) * SDCARD_SIM_BLOCK_SIZE, SDCARD_SIM_BLOCK_SIZE);
+        }
+    }
+}
+
+void sdcardSimWriteBlockDirect(uint32_t blockIndex, const uint8_t *buffer)
+{
+    if (imageFile) {
+        fseek(imageFile, (long) blockIndex * SDCARD_SIM_BLOCK_SIZE, SEEK_SET);
+        fwrite(buffer, 1, SDCARD_SIM_BLOCK_SIZE, imageFile);
+    } else {
+        uint8_t **chunk = &chunks[blockIndex / SDCARD_SIM_CHUNK_BLOCKS];
+
+        if (!*chunk) {
+            bool allZero = true;
+
+            for (int i = 0; i < SDCARD_SIM_BLOCK_SIZE && allZero; i++) {
+                allZero = buffer[i] == 0;
+            }
+
+            if (allZero) {
+                return;
+            }
+
+            *chunk = calloc(SDCARD_SIM_CHUNK_BLOCKS, SDCARD_SIM_BLOCK_SIZE);
+        }
+
+        memcpy(*chunk + (blockIndex % SDCARD_SIM_CHUNK_BLOCKS) * SDCARD_SIM_BLOCK_SIZE, buffer, SDCARD_SIM_BLOCK_SIZE);
+    }
+}
+
+static void sdcardSimWrite32(uint8_t *buffer, int offset, uint32_t value)
+{
+    memcpy(buffer + offset, &value, sizeof(value));
+}
+
+/**
+ * Write a fresh FAT32 filesystem to the card: an MBR with one partition starting at block 8192, with two FATs and an
+ * empty root directory in cluster 2. The card must be big enough to hold more than 65524 clusters.
+ */
+bool sdcardSimFormatFAT32(uint8_t sectorsPerCluster)
+{
+    uint8_t block[SDCARD_SIM_BLOCK_SIZE];
+
+    uint32_t partitionSectors = simConfig.numBlocks - SDCARD_SIM_PARTITION_START;
+
+    // FAT size calculation from the Microsoft FAT specification
+    uint32_t fatSizeDivisor = (256 * sectorsPerCluster + 2) / 2;
+    uint32_t fatSectors = (partitionSectors - SDCARD_SIM_RESERVED_SECTORS + fatSizeDivisor - 1) / fatSizeDivisor;
+
+    uint32_t numClusters = (partitionSectors - SDCARD_SIM_RESERVED_SECTORS - 2 * fatSectors) / sectorsPerCluster;
+
+    if (simConfig.numBlocks <= SDCARD_SIM_PARTITION_START || numClusters <= FAT16_MAX_CLUSTERS) {
+        return false;
+    }
+
+    // MBR
+    memset(block, 0, sizeof(block));
+
+    mbrPartitionEntry_t *partition = (mbrPartitionEntry_t *) (block + 446);
+    partition->type = MBR_PARTITION_TYPE_FAT32_LBA;
+    partition->lbaBegin = SDCARD_SIM_PARTITION_START;
+    partition->numSectors = partitionSectors;
+
+    block[510] = 0x55;
+    block[511] = 0xAA;
+
+    sdcardSimWriteBlockDirect(0, block);
+
+    // Volume ID, and its backup
+    memset(block, 0, sizeof(block));
+
+    fatVolumeID_t *volume = (fatVolumeID_t *) block;
+    volume->jmpBoot[0] = 0xEB;
+    volume->jmpBoot[1] = 0x58;
+    volume->jmpBoot[2] = 0x90;
+    memcpy(volume->oemName, "MSWIN4.1", sizeof(volume->oemName));
+    volume->bytesPerSector = SDCARD_SIM_BLOCK_SIZE;
+    volume->sectorsPerCluster = sectorsPerCluster;
+    volume->reservedSectorCount = SDCARD_SIM_RESERVED_SECTORS;
+    volume->numFATs = 2;
+    volume->media = 0xF8;
+    volume->sectorsPerTrack = 63;
+    volume->numHeads = 255;
+    volume->hiddenSectors = SDCARD_SIM_PARTITION_START;
+    volume->totalSectors32 = partitionSectors;
+    volume->fatDescriptor.fat32.FATSize32 = fatSectors;
+    volume->fatDescriptor.fat32.rootCluster = FAT_SMALLEST_LEGAL_CLUSTER_NUMBER;
+    volume->fatDescriptor.fat32.fsInfo = SDCARD_SIM_FSINFO_SECTOR;
+    volume->fatDescriptor.fat32.backupBootSector = SDCARD_SIM_BACKUP_BOOT;
+    volume->fatDescriptor.fat32.driveNumber = 0x80;
+    volume->fatDescriptor.fat32.bootSignature = 0x29;
+    volume->fatDescriptor.fat32.volumeID = 0x12345678;
+    memcpy(volume->fatDescriptor.fat32.volumeLabel, "NO NAME    ", sizeof(volume->fatDescriptor.fat32.volumeLabel));
+    memcpy(volume->fatDescriptor.fat32.fileSystemType, "FAT32   ", sizeof(volume->fatDescriptor.fat32.fileSystemType));
+
+    block[510] = FAT_VOLUME_ID_SIGNATURE_1;
+    block[511] = FAT_VOLUME_ID_SIGNATURE_2;
+
+    sdcardSimWriteBlockDirect(SDCARD_SIM_PARTITION_START, block);
+    sdcardSimWriteBlockDirect(SDCARD_SIM_PARTITION_START + SDCARD_SIM_BACKUP_BOOT, block);
+
+    // FSInfo, with the free cluster count and next free cluster unknown
+    memset(block, 0, sizeof(block));
+    sdcardSimWrite32(block, 0, 0x41615252);
+    sdcardSimWrite32(block, 484, 0x61417272);
+    sdcardSimWrite32(block, 488, 0xFFFFFFFF);
+    sdcardSimWrite32(block, 492, 0xFFFFFFFF);
+    sdcardSimWrite32(block, 508, 0xAA550000);
+
+    sdcardSimWriteBlockDirect(SDCARD_SIM_PARTITION_START + SDCARD_SIM_FSINFO_SECTOR, block);
+
+    // Empty FATs, a zeroed root directory cluster
+    const uint32_t fatStart = SDCARD_SIM_PARTITION_START + SDCARD_SIM_RESERVED_SECTORS;
+    const uint32_t rootDirectoryStart = fatStart + 2 * fatSectors;
+
+    memset(block, 0, sizeof(block));
+    for (uint32_t i = 1; i < fatSectors; i++) {
+        sdcardSimWriteBlockDirect(fatStart + i, block);
+        sdcardSimWriteBlockDirect(fatStart + fatSectors + i, block);
+    }
+    for (uint32_t i = 0; i < sectorsPerCluster; i++) {
+        sdcardSimWriteBlockDirect(rootDirectoryStart + i, block);
+    }
+
+    // Reserved entries for clusters 0 and 1, then the root directory's end of chain
+    sdcardSimWrite32(block, 0, 0x0FFFFFF8);
+    sdcardSimWrite32(block, 4, 0x0FFFFFFF);
+    sdcardSimWrite32(block, 8, 0x0FFFFFFF);
+
+    sdcardSimWriteBlockDirect(fatStart, block);
+    sdcardSimWriteBlockDirect(fatStart + fatSectors, block);
+
+    return true;
+}
+
+/**
+ * Make the next read or write operation fail, causing the card to reset.
+ */
+void sdcardSimInjectFailure(sdcardBlockOperation_e operation)
+{
+    if (operation == SDCARD_BLOCK_OPERATION_READ) {
+        failNextRead = true;
+    } else {
+        failNextWrite = true;
+    }
+}
+
+/**
+ * Keep the card busy for this much longer after the next block write.
+ */
+void sdcardSimInjectStall(uint32_t micros)
+{
+    pendingStallMicros += micros;
+}
+
+uint32_t sdcardSimMicros(void)
+{
+    return nowNanos / 1000;
+}
+
+void sdcardSimAdvanceMicros(uint32_t delta)
+{
+    nowNanos += (uint64_t) delta * 1000;
+}
+
+const sdcardSimStats_t *sdcardSimGetStats(void)
+{
+    return &stats;
+}
+
+void sdcardSimResetStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void sdcardSimFailQueuedWrites(void)
+{
+    uint32_t blockIndex = pendingOperation.blockIndex;
+
+    while (writeQueueCount > 0) {
+        int head = writeQueueHead;
+
+        blockIndex++;
+        writeQueueHead = (writeQueueHead + 1) % SDCARD_SIM_WRITE_QUEUE_LENGTH;
+        writeQueueCount--;
+
+        if (writeQueue[head].callback) {
+            writeQueue[head].callback(SDCARD_BLOCK_OPERATION_WRITE, blockIndex, NULL, writeQueue[head].callbackData);
+        }
+    }
+}
+
+static void sdcardSimReset(void)
+{
+    sdcardSimFailQueuedWrites();
+
+    state = SDCARD_SIM_STATE_RESET;
+    multiWriteBlocksRemain = 0;
+    sdcardSimBusyFor(simConfig.resetMicros);
+}
+
+static void sdcardSimFinishOperation(sdcardBlockOperation_e operation, uint8_t *buffer)
+{
+    if (profiler) {
+        profiler(operation, pendingOperation.blockIndex, (nowNanos - pendingOperation.startNanos) / 1000);
+    }
+
+    if (pendingOperation.callback) {
+        pendingOperation.callback(operation, pendingOperation.blockIndex, buffer, pendingOperation.callbackData);
+    }
+}
+
+static sdcardOperationStatus_e sdcardSimEndWriteBlocks(void)
+{
+    // Stop transmission token
+    sdcardSimSpiTransfer(2);
+
+    multiWriteBlocksRemain = 0;
+
+    if (simConfig.stopTransmissionMicros == 0) {
+        state = SDCARD_SIM_STATE_READY;
+        return SDCARD_OPERATION_SUCCESS;
+    }
+
+    state = SDCARD_SIM_STATE_STOPPING_MULTIPLE_BLOCK_WRITE;
+    sdcardSimBusyFor(simConfig.stopTransmissionMicros);
+
+    return SDCARD_OPERATION_IN_PROGRESS;
+}
+
+static void sdcardSimFinishSendingWrite(void)
+{
+    if (failNextWrite) {
+        failNextWrite = false;
+        stats.failures++;
+
+        sdcardSimReset();
+
+        sdcardSimFinishOperation(SDCARD_BLOCK_OPERATION_WRITE, NULL);
+        return;
+    }
+
+    sdcardSimWriteBlockDirect(pendingOperation.blockIndex, pendingOperation.buffer);
+
+    stats.blocksWritten++;
+    writeCount++;
+
+    uint32_t busyMicros = multiWriteBlocksRemain > 0 ? simConfig.multiWriteBusyMicros : simConfig.writeBusyMicros;
+
+    if (simConfig.writeStallInterval > 0 && writeCount % simConfig.writeStallInterval == 0) {
+        busyMicros += simConfig.writeStallMicros;
+        stats.stalls++;
+    }
+    if (pendingStallMicros > 0) {
+        busyMicros += pendingStallMicros;
+        pendingStallMicros = 0;
+        stats.stalls++;
+    }
+
+    state = SDCARD_SIM_STATE_WAITING_FOR_WRITE;
+    sdcardSimBusyFor(busyMicros);
+
+    // Like the real driver, the caller gets their buffer back as soon as it has been transmitted
+    sdcardSimFinishOperation(SDCARD_BLOCK_OPERATION_WRITE, pendingOperation.buffer);
+}
+
+static void sdcardSimStartWrite(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData, uint64_t startNanos)
+{
+    pendingOperation.buffer = buffer;
+    pendingOperation.blockIndex = blockIndex;
+    pendingOperation.callback = callback;
+    pendingOperation.callbackData = callbackData;
+    pendingOperation.startNanos = startNanos;
+
+    state = SDCARD_SIM_STATE_SENDING_WRITE;
+
+    if (simConfig.useDMA) {
+        busyUntilNanos = nowNanos + (uint64_t) (SDCARD_SIM_BLOCK_SIZE + 2) * simConfig.spiByteNanos;
+    } else {
+        // The first chunk is sent right away
+        sdcardSimSpiTransfer(SDCARD_SIM_NON_DMA_CHUNK);
+        pendingOperation.chunkIndex = 1;
+    }
+}
+
+static bool sdcardSimQueueWrite(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    if (writeQueueCount == SDCARD_SIM_WRITE_QUEUE_LENGTH
+        || multiWriteBlocksRemain <= 1u + writeQueueCount
+        || blockIndex != pendingOperation.blockIndex + 1 + writeQueueCount) {
+        return false;
+    }
+
+    int tail = (writeQueueHead + writeQueueCount) % SDCARD_SIM_WRITE_QUEUE_LENGTH;
+
+    writeQueue[tail].buffer = buffer;
+    writeQueue[tail].callback = callback;
+    writeQueue[tail].callbackData = callbackData;
+
+    writeQueueCount++;
+
+    return true;
+}
+
+static void sdcardSimStartQueuedWrite(void)
+{
+    int head = writeQueueHead;
+
+    writeQueueHead = (writeQueueHead + 1) % SDCARD_SIM_WRITE_QUEUE_LENGTH;
+    writeQueueCount--;
+
+    sdcardSimStartWrite(multiWriteNextBlock, writeQueue[head].buffer, writeQueue[head].callback, writeQueue[head].callbackData, nowNanos);
+}
+
+// sdcard driver API
+
+void sdcard_init(bool useDMA)
+{
+    (void) useDMA; // The simulator's configuration decides
+
+    if (numChunks == 0 && !imageFile) {
+        return;
+    }
+
+    sdcardSimReset();
+}
+
+bool sdcard_poll(void)
+{
+    uint64_t startNanos = nowNanos;
+
+    switch (state) {
+        case SDCARD_SIM_STATE_RESET:
+            if (!sdcardSimIsBusy()) {
+                sdcardSimCommand();
+                state = SDCARD_SIM_STATE_READY;
+            }
+        break;
+
+        case SDCARD_SIM_STATE_READING:
+            if (!sdcardSimIsBusy()) {
+                sdcardSimSpiTransfer(SDCARD_SIM_BLOCK_SIZE + 2);
+
+                if (failNextRead) {
+                    failNextRead = false;
+                    stats.failures++;
+
+                    sdcardSimReset();
+
+                    sdcardSimFinishOperation(SDCARD_BLOCK_OPERATION_READ, NULL);
+                } else {
+                    sdcardSimReadBlockDirect(pendingOperation.blockIndex, pendingOperation.buffer);
+                    stats.blocksRead++;
+
+                    state = SDCARD_SIM_STATE_READY;
+
+                    sdcardSimFinishOperation(SDCARD_BLOCK_OPERATION_READ, pendingOperation.buffer);
+                }
+            }
+        break;
+
+        case SDCARD_SIM_STATE_SENDING_WRITE:
+            if (simConfig.useDMA) {
+                if (!sdcardSimIsBusy()) {
+                    sdcardSimFinishSendingWrite();
+                }
+            } else {
+                sdcardSimSpiTransfer(SDCARD_SIM_NON_DMA_CHUNK);
+                pendingOperation.chunkIndex++;
+
+                if (pendingOperation.chunkIndex == SDCARD_SIM_BLOCK_SIZE / SDCARD_SIM_NON_DMA_CHUNK) {
+                    sdcardSimFinishSendingWrite();
+                }
+            }
+
+            if (state != SDCARD_SIM_STATE_WAITING_FOR_WRITE) {
+                break;
+            }
+            // Fall through - like the real driver, check right away whether the card is ready for the next block
+
+        case SDCARD_SIM_STATE_WAITING_FOR_WRITE:
+            if (sdcardSimWaitForIdle(8)) {
+                if (multiWriteBlocksRemain > 1) {
+                    multiWriteBlocksRemain--;
+                    multiWriteNextBlock++;
+                    state = SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS;
+
+                    if (writeQueueCount > 0) {
+                        sdcardSimStartQueuedWrite();
+                    }
+                } else if (multiWriteBlocksRemain == 1) {
+                    sdcardSimEndWriteBlocks();
+                } else {
+                    state = SDCARD_SIM_STATE_READY;
+                }
+            }
+        break;
+
+        case SDCARD_SIM_STATE_STOPPING_MULTIPLE_BLOCK_WRITE:
+            sdcardSimSpiTransfer(1);
+
+            if (!sdcardSimIsBusy()) {
+                state = SDCARD_SIM_STATE_READY;
+            }
+        break;
+
+        default:
+            ;
+    }
+
+    sdcardSimCallEnd(startNanos);
+
+    return state == SDCARD_SIM_STATE_READY || state == SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS;
+}
+
+sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    uint64_t startNanos = nowNanos;
+
+    switch (state) {
+        case SDCARD_SIM_STATE_SENDING_WRITE:
+        case SDCARD_SIM_STATE_WAITING_FOR_WRITE:
+            if (sdcardSimQueueWrite(blockIndex, buffer, callback, callbackData)) {
+                sdcardSimCallEnd(startNanos);
+                return SDCARD_OPERATION_IN_PROGRESS;
+            }
+
+            stats.busyRejections++;
+            sdcardSimCallEnd(startNanos);
+            return SDCARD_OPERATION_BUSY;
+
+        case SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS:
+            if (blockIndex != multiWriteNextBlock && sdcardSimEndWriteBlocks() != SDCARD_OPERATION_SUCCESS) {
+                stats.busyRejections++;
+                sdcardSimCallEnd(startNanos);
+                return SDCARD_OPERATION_BUSY;
+            }
+            if (state == SDCARD_SIM_STATE_READY) {
+                sdcardSimCommand();
+            }
+        break;
+
+        case SDCARD_SIM_STATE_READY:
+            sdcardSimCommand();
+        break;
+
+        default:
+            stats.busyRejections++;
+            sdcardSimCallEnd(startNanos);
+            return SDCARD_OPERATION_BUSY;
+    }
+
+    sdcardSimStartWrite(blockIndex, buffer, callback, callbackData, startNanos);
+
+    sdcardSimCallEnd(startNanos);
+
+    return SDCARD_OPERATION_IN_PROGRESS;
+}
+
+sdcardOperationStatus_e sdcard_beginWriteBlocks(uint32_t blockIndex, uint32_t blockCount)
+{
+    uint64_t startNanos = nowNanos;
+    sdcardOperationStatus_e result = SDCARD_OPERATION_SUCCESS;
+
+    if (state == SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS && blockIndex == multiWriteNextBlock) {
+        // Continue the multi-block write already in progress
+    } else if (
+        state == SDCARD_SIM_STATE_READY
+        || (state == SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS && sdcardSimEndWriteBlocks() == SDCARD_OPERATION_SUCCESS)
+    ) {
+        // Set the pre-erase count, then start the write
+        sdcardSimCommand();
+        sdcardSimCommand();
+
+        state = SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS;
+        multiWriteBlocksRemain = blockCount;
+        multiWriteNextBlock = blockIndex;
+
+        stats.multiBlockWrites++;
+    } else {
+        stats.busyRejections++;
+        result = SDCARD_OPERATION_BUSY;
+    }
+
+    sdcardSimCallEnd(startNanos);
+
+    return result;
+}
+
+bool sdcard_readBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    uint64_t startNanos = nowNanos;
+
+    if (state == SDCARD_SIM_STATE_WRITING_MULTIPLE_BLOCKS) {
+        sdcardSimEndWriteBlocks();
+    }
+
+    if (state != SDCARD_SIM_STATE_READY) {
+        stats.busyRejections++;
+        sdcardSimCallEnd(startNanos);
+        return false;
+    }
+
+    sdcardSimCommand();
+
+    pendingOperation.buffer = buffer;
+    pendingOperation.blockIndex = blockIndex;
+    pendingOperation.callback = callback;
+    pendingOperation.callbackData = callbackData;
+    pendingOperation.startNanos = startNanos;
+
+    state = SDCARD_SIM_STATE_READING;
+    sdcardSimBusyFor(simConfig.readLatencyMicros);
+
+    sdcardSimCallEnd(startNanos);
+
+    return true;
+}
+
+void sdcardInsertionDetectDeinit(void)
+{
+}
+
+void sdcardInsertionDetectInit(void)
+{
+}
+
+bool sdcard_isInserted()
+{
+    return numChunks > 0 || imageFile != NULL;
+}
+
+bool sdcard_isInitialized()
+{
+    return state >= SDCARD_SIM_STATE_READY;
+}
+
+bool sdcard_isFunctional()
+{
+    return state != SDCARD_SIM_STATE_NOT_PRESENT;
+}
+
+const sdcardMetadata_t* sdcard_getMetadata()
+{
+    return &metadata;
+}
+
+void sdcard_setProfilerCallback(sdcard_profilerCallback_c callback)
+{
+    profiler = callback;
+}
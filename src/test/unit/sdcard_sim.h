@@ -0,0 +1,85 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drivers/sdcard.h"
+
+/*
+ * Simulated SD card for host tests, implementing the sdcard_* API from drivers/sdcard.h.
+ *
+ * The card's blocks are kept in an image file, or sparsely in RAM (blocks which were never written read as zeros) so
+ * that images of many gigabytes can be simulated cheaply.
+ *
+ * Like the flash simulator, the card keeps a virtual clock. Time spent clocking commands and data over the SPI bus
+ * is charged to the caller synchronously (and recorded as the latency of that call), while reads and writes keep the
+ * card busy for their configured durations, which only pass when the test calls sdcardSimAdvanceMicros().
+ */
+
+#define SDCARD_SIM_BLOCK_SIZE 512
+
+typedef struct sdcardSimConfig_s {
+    uint32_t numBlocks;                 // Card size, or zero to use the size of an existing image file
+
+    bool useDMA;                        // If false block data is sent synchronously, a chunk per sdcard_poll() like the real driver
+
+    uint32_t spiByteNanos;              // Time to clock one byte over the SPI bus
+    uint32_t commandMicros;             // Time to send a command and receive its response
+    uint32_t readLatencyMicros;         // Time from a read command until the card starts sending data
+    uint32_t writeBusyMicros;           // Time the card is busy programming a block written with a single block write
+    uint32_t multiWriteBusyMicros;      // Ditto for blocks in a multi-block write (which are pre-erased)
+    uint32_t stopTransmissionMicros;    // Time the card is busy after ending a multi-block write
+    uint32_t resetMicros;               // Time to reinitialise the card after an error
+
+    uint32_t writeStallInterval;        // Every this many block writes the card stalls, e.g. for garbage collection (0 for never)
+    uint32_t writeStallMicros;
+
+    const char *imageFilename;          // Backing file for the card contents, or NULL to keep them in RAM only
+} sdcardSimConfig_t;
+
+typedef struct sdcardSimStats_s {
+    uint32_t blocksRead;
+    uint32_t blocksWritten;
+    uint32_t multiBlockWrites;          // Multi-block write sequences started
+    uint32_t busyRejections;            // Operations refused because the card was busy
+    uint32_t failures;                  // Operations that failed due to injected errors
+    uint32_t stalls;
+
+    uint32_t callMicros;                // Total time spent synchronously in sdcard_* calls
+    uint32_t maxCallMicros;             // Longest single call
+} sdcardSimStats_t;
+
+void sdcardSimDefaultConfig(sdcardSimConfig_t *config);
+bool sdcardSimInit(const sdcardSimConfig_t *config);
+void sdcardSimClose(void);
+
+bool sdcardSimFormatFAT32(uint8_t sectorsPerCluster);
+
+void sdcardSimReadBlockDirect(uint32_t blockIndex, uint8_t *buffer);
+void sdcardSimWriteBlockDirect(uint32_t blockIndex, const uint8_t *buffer);
+
+void sdcardSimInjectFailure(sdcardBlockOperation_e operation);
+void sdcardSimInjectStall(uint32_t micros);
+
+uint32_t sdcardSimMicros(void);
+void sdcardSimAdvanceMicros(uint32_t delta);
+
+const sdcardSimStats_t *sdcardSimGetStats(void);
+void sdcardSimResetStats(void);
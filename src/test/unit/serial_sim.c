@@ -0,0 +1,478 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "drivers/serial.h"
+
+#include "serial_sim.h"
+
+static serialSimPort_t *ports[SERIAL_SIM_MAX_PORTS];
+static int numPorts = 0;
+
+static uint64_t nowNanos = 0;
+
+static const struct serialPortVTable serialSimVTable[];
+
+static uint32_t ringUsed(uint32_t head, uint32_t tail)
+{
+    return (head - tail) & (SERIAL_SIM_BUFFER_SIZE - 1);
+}
+
+static uint32_t serialSimRxWaiting(serialPort_t *instance)
+{
+    return ringUsed(instance->rxBufferHead, instance->rxBufferTail);
+}
+
+static uint32_t serialSimTxUsed(const serialSimPort_t *simPort)
+{
+    return ringUsed(simPort->port.txBufferHead, simPort->port.txBufferTail);
+}
+
+static uint8_t serialSimTxFree(serialPort_t *instance)
+{
+    uint32_t bytesFree = (SERIAL_SIM_BUFFER_SIZE - 1) - serialSimTxUsed((serialSimPort_t *)instance);
+
+    // Like the UART drivers, we can't report more than fits in the return type
+    return bytesFree > 255 ? 255 : bytesFree;
+}
+
+uint32_t serialSimByteNanos(const serialSimPort_t *simPort)
+{
+    if (simPort->port.baudRate == 0) {
+        return 0;
+    }
+
+    uint32_t bits = 1 + 8 + 1; // Start, data and stop bits
+
+    if (simPort->port.options & SERIAL_PARITY_EVEN) {
+        bits++;
+    }
+    if (simPort->port.options & SERIAL_STOPBITS_2) {
+        bits++;
+    }
+
+    return (uint64_t)bits * 1000000000 / simPort->port.baudRate;
+}
+
+static void serialSimReceive(serialSimPort_t *simPort, uint8_t c)
+{
+    if ((simPort->port.mode & MODE_RX) == 0) {
+        return;
+    }
+
+    if (simPort->port.callback && simPort->port.spanCallback) {
+        // Keep it until the line goes idle, as the RX DMA would
+        if (serialSimRxWaiting(&simPort->port) == SERIAL_SIM_BUFFER_SIZE - 1) {
+            simPort->stats.rxOverruns++;
+            return;
+        }
+        simPort->rxBuffer[simPort->port.rxBufferHead] = c;
+        simPort->port.rxBufferHead = (simPort->port.rxBufferHead + 1) % SERIAL_SIM_BUFFER_SIZE;
+        simPort->spanPending = true;
+        simPort->rxIdleAtNanos = nowNanos + serialSimByteNanos(simPort);
+    } else if (simPort->port.callback) {
+        // Interrupt driven drivers see each byte as it arrives
+        simPort->port.callback(c);
+    } else if (serialSimRxWaiting(&simPort->port) == SERIAL_SIM_BUFFER_SIZE - 1) {
+        simPort->stats.rxOverruns++;
+        return;
+    } else {
+        simPort->rxBuffer[simPort->port.rxBufferHead] = c;
+        simPort->port.rxBufferHead = (simPort->port.rxBufferHead + 1) % SERIAL_SIM_BUFFER_SIZE;
+    }
+
+    simPort->stats.bytesReceived++;
+}
+
+// Pass what has arrived to the span callback, in one span per contiguous run of the RX buffer like the UART driver
+static void serialSimDeliverSpans(serialSimPort_t *simPort)
+{
+    simPort->spanPending = false;
+
+    while (serialSimRxWaiting(&simPort->port) > 0) {
+        const uint32_t tail = simPort->port.rxBufferTail;
+        const uint32_t head = simPort->port.rxBufferHead;
+        const uint32_t length = head > tail ? head - tail : SERIAL_SIM_BUFFER_SIZE - tail;
+
+        simPort->port.rxBufferTail = (tail + length) % SERIAL_SIM_BUFFER_SIZE;
+        simPort->port.spanCallback(&simPort->rxBuffer[tail], length);
+    }
+}
+
+static uint8_t serialSimPopTx(serialSimPort_t *simPort)
+{
+    uint8_t c = simPort->txBuffer[simPort->port.txBufferTail];
+    simPort->port.txBufferTail = (simPort->port.txBufferTail + 1) % SERIAL_SIM_BUFFER_SIZE;
+    simPort->stats.bytesSent++;
+
+    return c;
+}
+
+// Deliver the oldest byte in the TX buffer to the other end of the link
+static void serialSimTransmitByte(serialSimPort_t *simPort)
+{
+    uint8_t c = serialSimPopTx(simPort);
+
+    if (simPort->peer) {
+        serialSimReceive(simPort->peer, c);
+    }
+}
+
+static uint64_t serialSimNextByteDoneAt(const serialSimPort_t *simPort)
+{
+    return simPort->lineFreeAtNanos + serialSimByteNanos(simPort);
+}
+
+/**
+ * Move the clock forwards, delivering bytes from paced ports in the order they finish being sent. Bytes written by
+ * RX callbacks along the way are written at the time the byte which triggered them arrived.
+ */
+static void serialSimAdvanceNanos(uint64_t delta)
+{
+    const uint64_t targetNanos = nowNanos + delta;
+
+    while (true) {
+        serialSimPort_t *nextPort = NULL;
+        uint64_t nextDoneAt = targetNanos;
+        serialSimPort_t *nextIdlePort = NULL;
+        uint64_t nextIdleAt = targetNanos;
+
+        for (int i = 0; i < numPorts; i++) {
+            serialSimPort_t *simPort = ports[i];
+
+            if (simPort->paced && serialSimTxUsed(simPort) > 0 && serialSimNextByteDoneAt(simPort) <= nextDoneAt) {
+                nextPort = simPort;
+                nextDoneAt = serialSimNextByteDoneAt(simPort);
+            }
+            if (simPort->spanPending && simPort->rxIdleAtNanos <= nextIdleAt) {
+                nextIdlePort = simPort;
+                nextIdleAt = simPort->rxIdleAtNanos;
+            }
+        }
+
+        // A byte which arrives just as the line would have gone idle keeps it busy
+        if (nextPort && (!nextIdlePort || nextDoneAt <= nextIdleAt)) {
+            nowNanos = nextDoneAt;
+            nextPort->lineFreeAtNanos = nextDoneAt;
+            serialSimTransmitByte(nextPort);
+        } else if (nextIdlePort) {
+            nowNanos = nextIdleAt;
+            serialSimDeliverSpans(nextIdlePort);
+        } else {
+            break;
+        }
+    }
+
+    nowNanos = targetNanos;
+}
+
+static void serialSimFlushPty(serialSimPort_t *simPort)
+{
+    while (serialSimTxUsed(simPort) > 0) {
+        uint32_t tail = simPort->port.txBufferTail;
+        uint32_t chunk = simPort->port.txBufferHead > tail ? simPort->port.txBufferHead - tail : SERIAL_SIM_BUFFER_SIZE - tail;
+
+        ssize_t written = write(simPort->ptyFd, &simPort->txBuffer[tail], chunk);
+        if (written <= 0) {
+            break;
+        }
+
+        simPort->port.txBufferTail = (tail + written) % SERIAL_SIM_BUFFER_SIZE;
+        simPort->stats.bytesSent += written;
+    }
+}
+
+static void serialSimWriteByte(serialPort_t *instance, uint8_t ch)
+{
+    serialSimPort_t *simPort = (serialSimPort_t *)instance;
+
+    if ((instance->mode & MODE_TX) == 0) {
+        return;
+    }
+
+    if (serialSimTxFree(instance) == 0) {
+        if (simPort->ptyFd >= 0) {
+            serialSimFlushPty(simPort);
+
+            if (serialSimTxFree(instance) == 0) {
+                simPort->stats.txDropped++;
+                return;
+            }
+        } else if (simPort->paced) {
+            // Wait for the byte being sent to finish, as serialWriteBuf() would
+            const uint64_t waitNanos = serialSimNextByteDoneAt(simPort) - nowNanos;
+
+            serialSimAdvanceNanos(waitNanos);
+            simPort->stats.txWaitNanos += waitNanos;
+        }
+    }
+
+    if (serialSimTxUsed(simPort) == 0 && simPort->lineFreeAtNanos < nowNanos) {
+        // The line was idle, so this byte starts now
+        simPort->lineFreeAtNanos = nowNanos;
+    }
+
+    simPort->txBuffer[instance->txBufferHead] = ch;
+    instance->txBufferHead = (instance->txBufferHead + 1) % SERIAL_SIM_BUFFER_SIZE;
+
+    if (simPort->ptyFd < 0 && !simPort->paced) {
+        serialSimTransmitByte(simPort);
+    }
+}
+
+// Bytes sent over an unpaced link arrive all at once, so the line goes idle straight after each write
+static void serialSimIdleAfterUnpacedWrite(serialSimPort_t *simPort)
+{
+    if (!simPort->paced && simPort->peer && simPort->peer->spanPending) {
+        serialSimDeliverSpans(simPort->peer);
+    }
+}
+
+static void serialSimWrite(serialPort_t *instance, uint8_t ch)
+{
+    serialSimWriteByte(instance, ch);
+    serialSimIdleAfterUnpacedWrite((serialSimPort_t *)instance);
+}
+
+static void serialSimWriteBuf(serialPort_t *instance, void *data, int count)
+{
+    const uint8_t *p = data;
+
+    while (count-- > 0) {
+        serialSimWriteByte(instance, *p++);
+    }
+    serialSimIdleAfterUnpacedWrite((serialSimPort_t *)instance);
+}
+
+static uint8_t serialSimRead(serialPort_t *instance)
+{
+    if (serialSimRxWaiting(instance) == 0) {
+        return 0;
+    }
+
+    uint8_t c = ((serialSimPort_t *)instance)->rxBuffer[instance->rxBufferTail];
+    instance->rxBufferTail = (instance->rxBufferTail + 1) % SERIAL_SIM_BUFFER_SIZE;
+
+    return c;
+}
+
+static int serialSimReadBuf(serialPort_t *instance, uint8_t *data, int maxCount)
+{
+    serialSimPort_t *simPort = (serialSimPort_t *)instance;
+    int count = 0;
+
+    // Copies contiguous spans like the UART driver does, so that code is exercised by the same access pattern
+    while (count < maxCount) {
+        uint32_t chunk = serialSimRxWaiting(instance);
+        if (chunk == 0) {
+            break;
+        }
+
+        if (chunk > (uint32_t)(maxCount - count)) {
+            chunk = maxCount - count;
+        }
+        if (chunk > SERIAL_SIM_BUFFER_SIZE - instance->rxBufferTail) {
+            chunk = SERIAL_SIM_BUFFER_SIZE - instance->rxBufferTail;
+        }
+
+        memcpy(data + count, &simPort->rxBuffer[instance->rxBufferTail], chunk);
+        instance->rxBufferTail = (instance->rxBufferTail + chunk) % SERIAL_SIM_BUFFER_SIZE;
+        count += chunk;
+    }
+
+    return count;
+}
+
+static void serialSimSetBaudRate(serialPort_t *instance, uint32_t baudRate)
+{
+    instance->baudRate = baudRate;
+}
+
+static bool serialSimIsTransmitBufferEmpty(serialPort_t *instance)
+{
+    return serialSimTxUsed((serialSimPort_t *)instance) == 0;
+}
+
+static void serialSimSetMode(serialPort_t *instance, portMode_t mode)
+{
+    instance->mode = mode;
+}
+
+static const struct serialPortVTable serialSimVTable[] = {
+    {
+        .serialWrite = serialSimWrite,
+        .serialTotalRxWaiting = serialSimRxWaiting,
+        .serialTotalTxFree = serialSimTxFree,
+        .serialRead = serialSimRead,
+        .serialSetBaudRate = serialSimSetBaudRate,
+        .isSerialTransmitBufferEmpty = serialSimIsTransmitBufferEmpty,
+        .setMode = serialSimSetMode,
+        .writeBuf = serialSimWriteBuf,
+        .readBuf = serialSimReadBuf,
+        .beginWrite = NULL,
+        .endWrite = NULL
+    }
+};
+
+static bool serialSimInitPort(serialSimPort_t *simPort, uint32_t baudRate)
+{
+    if (numPorts >= SERIAL_SIM_MAX_PORTS) {
+        return false;
+    }
+
+    memset(simPort, 0, sizeof(*simPort));
+
+    simPort->port.vTable = serialSimVTable;
+    simPort->port.mode = MODE_RXTX;
+    simPort->port.options = SERIAL_NOT_INVERTED;
+    simPort->port.baudRate = baudRate;
+    simPort->port.rxBufferSize = SERIAL_SIM_BUFFER_SIZE;
+    simPort->port.txBufferSize = SERIAL_SIM_BUFFER_SIZE;
+    simPort->port.rxBuffer = simPort->rxBuffer;
+    simPort->port.txBuffer = simPort->txBuffer;
+    simPort->ptyFd = -1;
+    simPort->lineFreeAtNanos = nowNanos;
+
+    ports[numPorts++] = simPort;
+
+    return true;
+}
+
+void serialSimInit(void)
+{
+    serialSimClose();
+}
+
+void serialSimClose(void)
+{
+    for (int i = 0; i < numPorts; i++) {
+        if (ports[i]->ptyFd >= 0) {
+            close(ports[i]->ptyFd);
+            ports[i]->ptyFd = -1;
+        }
+    }
+
+    numPorts = 0;
+    nowNanos = 0;
+}
+
+/**
+ * Connect two ports to each other. If paced, bytes take the time to send at the baud rate to arrive, otherwise they
+ * arrive as soon as they are written.
+ */
+void serialSimLink(serialSimPort_t *a, serialSimPort_t *b, uint32_t baudRate, bool paced)
+{
+    serialSimInitPort(a, baudRate);
+    serialSimInitPort(b, baudRate);
+
+    a->peer = b;
+    b->peer = a;
+    a->paced = b->paced = paced;
+}
+
+/**
+ * Back the port with a new pseudo-terminal, whose path is returned (or NULL on failure). Data is passed through in
+ * real time by serialSimPollPty().
+ */
+const char *serialSimOpenPty(serialSimPort_t *simPort, uint32_t baudRate)
+{
+    if (!serialSimInitPort(simPort, baudRate)) {
+        return NULL;
+    }
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct termios settings;
+
+    if (grantpt(fd) < 0 || unlockpt(fd) < 0 || tcgetattr(fd, &settings) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Pass bytes through untouched, with no echo or line editing
+    cfmakeraw(&settings);
+    tcsetattr(fd, TCSANOW, &settings);
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    simPort->ptyFd = fd;
+    snprintf(simPort->ptyName, sizeof(simPort->ptyName), "%s", ptsname(fd));
+
+    return simPort->ptyName;
+}
+
+/**
+ * Exchange data between the pseudo-terminal backed ports and whatever has the other side of them open.
+ */
+void serialSimPollPty(void)
+{
+    for (int i = 0; i < numPorts; i++) {
+        serialSimPort_t *simPort = ports[i];
+
+        if (simPort->ptyFd < 0) {
+            continue;
+        }
+
+        serialSimFlushPty(simPort);
+
+        uint8_t chunk[64];
+        ssize_t count;
+
+        // Leave what doesn't fit in the RX buffer in the terminal's own buffer, rather than overrunning
+        while (simPort->port.callback || serialSimRxWaiting(&simPort->port) < SERIAL_SIM_BUFFER_SIZE - 1) {
+            size_t room = simPort->port.callback ? sizeof(chunk) : (SERIAL_SIM_BUFFER_SIZE - 1) - serialSimRxWaiting(&simPort->port);
+
+            count = read(simPort->ptyFd, chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+            if (count <= 0) {
+                break;
+            }
+
+            for (ssize_t j = 0; j < count; j++) {
+                serialSimReceive(simPort, chunk[j]);
+            }
+
+            // There's no telling when the line went idle, so treat each read as a burst
+            if (simPort->spanPending) {
+                serialSimDeliverSpans(simPort);
+            }
+        }
+    }
+}
+
+uint32_t serialSimMicros(void)
+{
+    return nowNanos / 1000;
+}
+
+void serialSimAdvanceMicros(uint32_t delta)
+{
+    serialSimAdvanceNanos((uint64_t)delta * 1000);
+}
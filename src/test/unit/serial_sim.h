@@ -0,0 +1,81 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drivers/serial.h"
+
+/*
+ * Simulated serial ports for host tests, implementing serialPort_t so that code written against drivers/serial.h can
+ * be run unmodified.
+ *
+ * Ports are either linked in pairs (what one end writes, the other end receives), or backed by a Linux
+ * pseudo-terminal so that a real program such as the configurator can open the other side.
+ *
+ * Linked ports keep a virtual clock like the flash and SD card simulators. When pacing is on, written bytes sit in the
+ * TX buffer and are only delivered as the clock passes the time it takes to send them at the port's baud rate, so the
+ * TX buffer fills up like a real UART's. A writer that waits for room in the buffer is charged that time. Received
+ * bytes go to the port's RX callback if it has one (like an interrupt driven RX driver), or into its RX buffer.
+ *
+ * Ports with a span callback as well get what has arrived once the line has been idle for a byte's time, like a UART
+ * with RX DMA and idle line detection.
+ */
+
+#define SERIAL_SIM_BUFFER_SIZE  256    // Same as the UART drivers
+#define SERIAL_SIM_MAX_PORTS    8
+
+typedef struct serialSimStats_s {
+    uint32_t bytesSent;         // Bytes that left the TX buffer
+    uint32_t bytesReceived;     // Bytes delivered to the RX buffer or callback
+    uint32_t rxOverruns;        // Bytes dropped because the RX buffer was full
+    uint32_t txDropped;         // Bytes dropped because nothing was reading the other side of the pseudo-terminal
+    uint64_t txWaitNanos;       // Time writers spent waiting for room in the TX buffer
+} serialSimStats_t;
+
+typedef struct serialSimPort_s {
+    serialPort_t port;
+
+    uint8_t rxBuffer[SERIAL_SIM_BUFFER_SIZE];
+    uint8_t txBuffer[SERIAL_SIM_BUFFER_SIZE];
+
+    struct serialSimPort_s *peer;   // The other end of a linked pair
+    int ptyFd;                      // Master side of the pseudo-terminal, or -1
+    char ptyName[64];               // Path of the side for other programs to open
+
+    bool paced;
+    uint64_t lineFreeAtNanos;       // When the byte being sent finishes
+
+    bool spanPending;               // Bytes are waiting to be passed to the span callback
+    uint64_t rxIdleAtNanos;         // When the RX line counts as idle, if nothing more arrives
+
+    serialSimStats_t stats;
+} serialSimPort_t;
+
+void serialSimInit(void);
+void serialSimClose(void);
+
+void serialSimLink(serialSimPort_t *a, serialSimPort_t *b, uint32_t baudRate, bool paced);
+const char *serialSimOpenPty(serialSimPort_t *simPort, uint32_t baudRate);
+
+void serialSimPollPty(void);
+
+uint32_t serialSimMicros(void);
+void serialSimAdvanceMicros(uint32_t delta);
+uint32_t serialSimByteNanos(const serialSimPort_t *simPort);
@@ -0,0 +1,443 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+    #include "common/crc.h"
+    #include "common/utils.h"
+    #include "drivers/serial.h"
+    #include "io/msp_frame.h"
+
+    #include "serial_sim.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// The period of TASK_SERIAL
+#define TEST_SERIAL_TASK_MICROS     10000
+
+// How finely the clock is stepped while waiting for something to arrive
+#define TEST_CLOCK_STEP_MICROS      10
+
+static serialSimPort_t host, fc;
+
+class SerialSimTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        serialSimInit();
+    }
+
+    virtual void TearDown() {
+        serialSimClose();
+    }
+};
+
+static void writePattern(serialPort_t *port, int start, int count)
+{
+    for (int i = start; i < start + count; i++) {
+        serialWrite(port, i * 7);
+    }
+}
+
+static void expectPattern(const uint8_t *data, int start, int count)
+{
+    for (int i = 0; i < count; i++) {
+        ASSERT_EQ((uint8_t)((start + i) * 7), data[i]);
+    }
+}
+
+TEST_F(SerialSimTest, LinkedPortsPassBytesBothWays)
+{
+    // given
+    serialSimLink(&host, &fc, 115200, false);
+
+    // when
+    serialPrint(&host.port, "ping");
+    serialPrint(&fc.port, "pong!");
+
+    // then
+    ASSERT_EQ(4U, serialRxBytesWaiting(&fc.port));
+    ASSERT_EQ(5U, serialRxBytesWaiting(&host.port));
+
+    EXPECT_EQ('p', serialRead(&fc.port));
+    EXPECT_EQ('i', serialRead(&fc.port));
+
+    uint8_t data[8];
+    EXPECT_EQ(2, serialReadBuf(&fc.port, data, sizeof(data)));
+    EXPECT_EQ(0, memcmp("ng", data, 2));
+
+    EXPECT_EQ(5, serialReadBuf(&host.port, data, sizeof(data)));
+    EXPECT_EQ(0, memcmp("pong!", data, 5));
+    EXPECT_EQ(0U, serialRxBytesWaiting(&host.port));
+}
+
+TEST_F(SerialSimTest, ReadBufCopiesAcrossEndOfRing)
+{
+    // given
+    uint8_t data[SERIAL_SIM_BUFFER_SIZE];
+    serialSimLink(&host, &fc, 115200, false);
+
+    writePattern(&host.port, 0, 200);
+    ASSERT_EQ(200, serialReadBuf(&fc.port, data, sizeof(data)));
+
+    // when
+    writePattern(&host.port, 200, 200);
+
+    // then
+    ASSERT_EQ(200, serialReadBuf(&fc.port, data, sizeof(data)));
+    expectPattern(data, 200, 200);
+}
+
+TEST_F(SerialSimTest, ReadBufFallsBackToByteReads)
+{
+    // given
+    uint8_t data[SERIAL_SIM_BUFFER_SIZE];
+    serialSimLink(&host, &fc, 115200, false);
+
+    struct serialPortVTable vTableWithoutReadBuf = *fc.port.vTable;
+    vTableWithoutReadBuf.readBuf = NULL;
+    fc.port.vTable = &vTableWithoutReadBuf;
+
+    // when
+    writePattern(&host.port, 0, 150);
+
+    // then
+    EXPECT_EQ(100, serialReadBuf(&fc.port, data, 100));
+    expectPattern(data, 0, 100);
+    EXPECT_EQ(50, serialReadBuf(&fc.port, data, sizeof(data)));
+    expectPattern(data, 100, 50);
+}
+
+TEST_F(SerialSimTest, DropsBytesWhenRxBufferIsFull)
+{
+    // given
+    serialSimLink(&host, &fc, 115200, false);
+
+    // when
+    writePattern(&host.port, 0, 300);
+
+    // then
+    EXPECT_EQ((uint32_t)SERIAL_SIM_BUFFER_SIZE - 1, serialRxBytesWaiting(&fc.port));
+    EXPECT_EQ(300U - (SERIAL_SIM_BUFFER_SIZE - 1), fc.stats.rxOverruns);
+}
+
+TEST_F(SerialSimTest, PacedBytesTakeTimeToSend)
+{
+    // given
+    serialSimLink(&host, &fc, 115200, true);
+    const uint32_t byteNanos = serialSimByteNanos(&host);
+    EXPECT_EQ(86805U, byteNanos); // 10 bits at 115200 baud
+
+    // when
+    writePattern(&host.port, 0, 10);
+
+    // then
+    EXPECT_EQ(0U, serialRxBytesWaiting(&fc.port));
+    EXPECT_EQ(SERIAL_SIM_BUFFER_SIZE - 1 - 10, serialTxBytesFree(&host.port));
+
+    serialSimAdvanceMicros(5 * byteNanos / 1000 + 1);
+    EXPECT_EQ(5U, serialRxBytesWaiting(&fc.port));
+    EXPECT_FALSE(isSerialTransmitBufferEmpty(&host.port));
+
+    serialSimAdvanceMicros(5 * byteNanos / 1000);
+    EXPECT_EQ(10U, serialRxBytesWaiting(&fc.port));
+    EXPECT_TRUE(isSerialTransmitBufferEmpty(&host.port));
+}
+
+TEST_F(SerialSimTest, WriterWaitsForRoomInTxBuffer)
+{
+    // given
+    serialSimLink(&host, &fc, 1000000, true);
+    const uint32_t byteNanos = serialSimByteNanos(&host);
+
+    // when
+    writePattern(&host.port, 0, 300);
+
+    // then the writer was held up until all but a buffer's worth had been sent
+    const uint32_t sentWhileWaiting = 300 - (SERIAL_SIM_BUFFER_SIZE - 1);
+    EXPECT_EQ(sentWhileWaiting, fc.stats.bytesReceived);
+    EXPECT_EQ((uint64_t)sentWhileWaiting * byteNanos, host.stats.txWaitNanos);
+    EXPECT_EQ(sentWhileWaiting * byteNanos / 1000, serialSimMicros());
+
+    uint8_t data[SERIAL_SIM_BUFFER_SIZE];
+    EXPECT_EQ((int)sentWhileWaiting, serialReadBuf(&fc.port, data, sizeof(data)));
+    expectPattern(data, 0, sentWhileWaiting);
+}
+
+static uint32_t callbackArrivals[32];
+static uint8_t callbackBytes[32];
+static int callbackCount;
+
+static void recordArrival(uint16_t c)
+{
+    callbackBytes[callbackCount] = c;
+    callbackArrivals[callbackCount] = serialSimMicros();
+    callbackCount++;
+}
+
+TEST_F(SerialSimTest, CallbackSeesBytesAsTheyArrive)
+{
+    // given an SBUS style link, 100000 baud with even parity and two stop bits
+    serialSimLink(&host, &fc, 100000, true);
+    host.port.options = fc.port.options = (portOptions_t)(SERIAL_PARITY_EVEN | SERIAL_STOPBITS_2);
+    fc.port.callback = recordArrival;
+    callbackCount = 0;
+
+    // when
+    writePattern(&host.port, 0, 25);
+    serialSimAdvanceMicros(10000);
+
+    // then
+    ASSERT_EQ(25, callbackCount);
+    expectPattern(callbackBytes, 0, 25);
+    for (int i = 0; i < callbackCount; i++) {
+        EXPECT_EQ((uint32_t)(i + 1) * 120, callbackArrivals[i]);
+    }
+    EXPECT_EQ(0U, serialRxBytesWaiting(&fc.port));
+}
+
+TEST_F(SerialSimTest, PtyPassesBytesBothWays)
+{
+    // given
+    const char *ptyName = serialSimOpenPty(&fc, 115200);
+    if (!ptyName) {
+        printf("No pseudo-terminals available, skipping\n");
+        return;
+    }
+
+    int fd = open(ptyName, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    ASSERT_GE(fd, 0);
+
+    uint8_t data[16];
+
+    // when
+    ASSERT_EQ(5, write(fd, "hello", 5));
+
+    int count = 0;
+    for (int attempt = 0; attempt < 100 && count < 5; attempt++) {
+        serialSimPollPty();
+        count += serialReadBuf(&fc.port, data + count, sizeof(data) - count);
+        usleep(1000);
+    }
+
+    // then
+    ASSERT_EQ(5, count);
+    EXPECT_EQ(0, memcmp("hello", data, 5));
+
+    // when
+    serialPrint(&fc.port, "world");
+    serialSimPollPty();
+
+    count = 0;
+    for (int attempt = 0; attempt < 100 && count < 5; attempt++) {
+        ssize_t got = read(fd, data + count, sizeof(data) - count);
+        if (got > 0) {
+            count += got;
+        }
+        usleep(1000);
+    }
+
+    // then
+    ASSERT_EQ(5, count);
+    EXPECT_EQ(0, memcmp("world", data, 5));
+
+    close(fd);
+}
+
+/*
+ * A flight controller end which answers MSP commands with a reply of the requested size, polling its port at the
+ * period of the serial task the way mspProcess() does.
+ */
+static mspPort_t fcMspPort;
+static uint8_t fcReplyBuffer[MSP_PORT_OUTBUF_SIZE];
+static mspReply_t fcReply;
+static uint32_t fcNextPollAt;
+static uint32_t fcPollMicros;
+
+static void fcWrite(void *arg, const uint8_t *data, int len)
+{
+    serialWriteBuf((serialPort_t *)arg, (uint8_t *)data, len);
+}
+
+static void fcInit(uint32_t pollMicros)
+{
+    memset(&fcMspPort, 0, sizeof(fcMspPort));
+    fcMspPort.port = &fc.port;
+    mspReplyInit(&fcReply, fcReplyBuffer, sizeof(fcReplyBuffer), fcWrite, &fc.port);
+    fcPollMicros = pollMicros;
+    fcNextPollAt = serialSimMicros();
+}
+
+static void fcPoll(void)
+{
+    if (serialSimMicros() < fcNextPollAt) {
+        return;
+    }
+    fcNextPollAt += fcPollMicros;
+
+    uint8_t chunk[32];
+    int count;
+
+    while ((count = serialReadBuf(&fc.port, chunk, sizeof(chunk))) > 0) {
+        for (int i = 0; i < count; i++) {
+            mspFrameProcessReceivedData(&fcMspPort, chunk[i]);
+
+            if (fcMspPort.c_state == COMMAND_RECEIVED) {
+                // The command's payload is the size of the reply it wants
+                const uint16_t replySize = fcMspPort.inBuf[0] | (fcMspPort.inBuf[1] << 8);
+
+                mspReplyBegin(&fcReply, fcMspPort.mspVersion, fcMspPort.cmdMSP, false, replySize);
+                for (int j = 0; j < replySize; j++) {
+                    mspReplyAppend(&fcReply, j);
+                }
+                mspReplyFinish(&fcReply);
+
+                fcMspPort.c_state = IDLE;
+            }
+        }
+    }
+}
+
+static int hostSendRequest(mspVersion_e mspVersion, uint16_t cmdMSP, uint16_t replySize)
+{
+    uint8_t frame[16];
+    int length = 0;
+
+    frame[length++] = '$';
+    frame[length++] = mspVersion == MSP_V2 ? 'X' : 'M';
+    frame[length++] = '<';
+
+    if (mspVersion == MSP_V2) {
+        frame[length++] = 0;
+        frame[length++] = cmdMSP & 0xFF;
+        frame[length++] = cmdMSP >> 8;
+        frame[length++] = 2;
+        frame[length++] = 0;
+    } else {
+        frame[length++] = 2;
+        frame[length++] = cmdMSP;
+    }
+
+    frame[length++] = replySize & 0xFF;
+    frame[length++] = replySize >> 8;
+
+    uint8_t checksum = 0;
+    for (int i = 3; i < length; i++) {
+        checksum = mspChecksumUpdate(mspVersion, checksum, frame[i]);
+    }
+    frame[length++] = checksum;
+
+    serialWriteBuf(&host.port, frame, length);
+
+    return length;
+}
+
+static int replyFrameSize(mspVersion_e mspVersion, uint16_t payloadSize)
+{
+    if (mspVersion == MSP_V2) {
+        return 8 + payloadSize + 1;
+    }
+    return (payloadSize >= JUMBO_FRAME_SIZE_LIMIT ? 7 : 5) + payloadSize + 1;
+}
+
+/**
+ * Send a request and wait for the whole reply to arrive, returning how long that took.
+ */
+static uint32_t hostRoundTrip(mspVersion_e mspVersion, uint16_t replySize)
+{
+    const uint32_t start = serialSimMicros();
+    const int expected = replyFrameSize(mspVersion, replySize);
+    int received = 0;
+    uint8_t chunk[64];
+
+    hostSendRequest(mspVersion, 100, replySize);
+
+    while (received < expected) {
+        serialSimAdvanceMicros(TEST_CLOCK_STEP_MICROS);
+        fcPoll();
+        received += serialReadBuf(&host.port, chunk, sizeof(chunk));
+
+        if (serialSimMicros() - start > 1000000) {
+            ADD_FAILURE() << "No reply";
+            break;
+        }
+    }
+
+    EXPECT_EQ(expected, received);
+
+    return serialSimMicros() - start;
+}
+
+TEST_F(SerialSimTest, MspRepliesArriveOverPacedLink)
+{
+    // given
+    serialSimLink(&host, &fc, 115200, true);
+    fcInit(TEST_SERIAL_TASK_MICROS);
+
+    // when
+    uint32_t micros = hostRoundTrip(MSP_V1, 16);
+
+    // then the reply took no less than the wire time and no more than an extra poll period
+    const uint32_t wireMicros = (uint64_t)(8 + replyFrameSize(MSP_V1, 16)) * serialSimByteNanos(&host) / 1000;
+    EXPECT_GE(micros, wireMicros);
+    EXPECT_LE(micros, wireMicros + TEST_SERIAL_TASK_MICROS + TEST_CLOCK_STEP_MICROS);
+
+    EXPECT_EQ(0U, fc.stats.rxOverruns);
+    EXPECT_EQ(0U, host.stats.rxOverruns);
+}
+
+TEST_F(SerialSimTest, BenchmarkMspRoundTrips)
+{
+    static const uint32_t baudRates[] = { 115200, 1000000 };
+    static const uint32_t pollPeriods[] = { TEST_SERIAL_TASK_MICROS, 1000 };
+    static const uint16_t replySizes[] = { 16, 200 };
+
+    for (unsigned b = 0; b < ARRAYLEN(baudRates); b++) {
+        for (unsigned p = 0; p < ARRAYLEN(pollPeriods); p++) {
+            for (unsigned r = 0; r < ARRAYLEN(replySizes); r++) {
+                serialSimInit();
+                serialSimLink(&host, &fc, baudRates[b], true);
+                fcInit(pollPeriods[p]);
+
+                const int roundTrips = 50;
+                uint32_t worst = 0;
+                const uint32_t start = serialSimMicros();
+
+                for (int i = 0; i < roundTrips; i++) {
+                    uint32_t micros = hostRoundTrip(MSP_V2, replySizes[r]);
+                    worst = micros > worst ? micros : worst;
+                }
+
+                const uint32_t total = serialSimMicros() - start;
+                const uint32_t replyBytes = roundTrips * replyFrameSize(MSP_V2, replySizes[r]);
+
+                printf("%7u baud, polled every %5u us, %3u byte replies: %5u us average, %5u us worst, %6.1f KB/s of replies\n",
+                    baudRates[b], pollPeriods[p], replySizes[r], total / roundTrips, worst,
+                    replyBytes / (total / 1000000.0) / 1024);
+
+                EXPECT_EQ(0U, fc.stats.rxOverruns);
+                EXPECT_EQ(0U, host.stats.rxOverruns);
+            }
+        }
+    }
+}
@@ -0,0 +1,255 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/crc.h"
+    #include "common/maths.h"
+
+    #include "drivers/sensor.h"
+    #include "drivers/accgyro.h"
+    #include "drivers/serial.h"
+
+    #include "fc/runtime_config.h"
+
+    #include "io/gps.h"
+    #include "io/serial.h"
+
+    #include "rx/rx.h"
+    #include "rx/crsf.h"
+
+    #include "sensors/sensors.h"
+
+    #include "telemetry/telemetry.h"
+    #include "telemetry/crsf.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+static uint8_t telemetryBuf[CRSF_FRAME_SIZE_MAX];
+static int telemetryBufLength;
+static bool rxIsActive;
+static bool gpsPresent;
+
+// Checks the frame the telemetry handed to the RX driver, and returns its payload
+static const uint8_t *expectFrame(crsfFrameType_e type, int payloadLength)
+{
+    EXPECT_EQ(payloadLength + 4, telemetryBufLength);
+    EXPECT_EQ(CRSF_ADDRESS_FLIGHT_CONTROLLER, telemetryBuf[0]);
+    EXPECT_EQ(payloadLength + 2, telemetryBuf[1]);
+    EXPECT_EQ(type, telemetryBuf[2]);
+    EXPECT_EQ(crc8DvbS2Update(0, &telemetryBuf[2], payloadLength + 1), telemetryBuf[payloadLength + 3]);
+
+    return &telemetryBuf[3];
+}
+
+static int32_t readBigEndian(const uint8_t *p, int size)
+{
+    int32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+class CrsfTelemetryTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        rxIsActive = true;
+        gpsPresent = true;
+        telemetryBufLength = 0;
+        memset(&telemetryData, 0, sizeof(telemetryData));
+
+        initCrsfTelemetry(NULL);
+        checkCrsfTelemetryState();
+    }
+
+    // Lets the RX driver send the frame
+    void frameSent() {
+        telemetryBufLength = 0;
+    }
+};
+
+TEST_F(CrsfTelemetryTest, DoesNothingWithoutCrossfireReceiver)
+{
+    // given
+    rxIsActive = false;
+    checkCrsfTelemetryState();
+
+    // when
+    handleCrsfTelemetry();
+
+    // then
+    EXPECT_EQ(0, telemetryBufLength);
+}
+
+TEST_F(CrsfTelemetryTest, WaitsForPreviousFrameToBeSent)
+{
+    // given
+    handleCrsfTelemetry();
+    const uint8_t firstType = telemetryBuf[2];
+
+    // when
+    handleCrsfTelemetry();
+
+    // then
+    EXPECT_EQ(firstType, telemetryBuf[2]);
+}
+
+TEST_F(CrsfTelemetryTest, SendsBatteryAttitudeAndGpsInTurn)
+{
+    // given
+    telemetryData.vbat = 168;                   // 16.8V
+    telemetryData.amperage = 1234;              // 12.34A
+    telemetryData.mAhDrawn = 654;
+    telemetryData.batteryRemainingPercentage = 75;
+    telemetryData.roll = 450;
+    telemetryData.pitch = -100;
+    telemetryData.yaw = 1800;
+    telemetryData.gpsCoord[LAT] = 473977420;
+    telemetryData.gpsCoord[LON] = -1223890570;
+    telemetryData.gpsSpeed = 1000;              // 10m/s
+    telemetryData.gpsGroundCourse = 2705;
+    telemetryData.gpsAltitude = 120;
+    telemetryData.gpsNumSat = 11;
+
+    // when
+    handleCrsfTelemetry();
+
+    // then
+    const uint8_t *battery = expectFrame(CRSF_FRAMETYPE_BATTERY_SENSOR, CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE);
+    EXPECT_EQ(168, readBigEndian(&battery[0], 2));
+    EXPECT_EQ(123, readBigEndian(&battery[2], 2));
+    EXPECT_EQ(654, readBigEndian(&battery[4], 3));
+    EXPECT_EQ(75, battery[7]);
+
+    // when
+    frameSent();
+    handleCrsfTelemetry();
+
+    // then
+    const uint8_t *angles = expectFrame(CRSF_FRAMETYPE_ATTITUDE, CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE);
+    EXPECT_NEAR(-1745, (int16_t)readBigEndian(&angles[0], 2), 1);
+    EXPECT_NEAR(7854, (int16_t)readBigEndian(&angles[2], 2), 1);
+    EXPECT_NEAR(31416, (int16_t)readBigEndian(&angles[4], 2), 1);
+
+    // when
+    frameSent();
+    handleCrsfTelemetry();
+
+    // then
+    const uint8_t *gps = expectFrame(CRSF_FRAMETYPE_GPS, CRSF_FRAME_GPS_PAYLOAD_SIZE);
+    EXPECT_EQ(473977420, readBigEndian(&gps[0], 4));
+    EXPECT_EQ(-1223890570, readBigEndian(&gps[4], 4));
+    EXPECT_EQ(360, readBigEndian(&gps[8], 2));
+    EXPECT_EQ(27050, readBigEndian(&gps[10], 2));
+    EXPECT_EQ(1120, readBigEndian(&gps[12], 2));
+    EXPECT_EQ(11, gps[14]);
+
+    // when
+    frameSent();
+    handleCrsfTelemetry();
+
+    // then it starts over
+    expectFrame(CRSF_FRAMETYPE_BATTERY_SENSOR, CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE);
+}
+
+TEST_F(CrsfTelemetryTest, SendsWesterlyYawAsNegativeAngle)
+{
+    // given a heading of 270 degrees, which is out of range of the attitude frame unless wrapped
+    telemetryData.yaw = 2700;
+
+    // when
+    handleCrsfTelemetry();
+    frameSent();
+    handleCrsfTelemetry();
+
+    // then
+    const uint8_t *angles = expectFrame(CRSF_FRAMETYPE_ATTITUDE, CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE);
+    EXPECT_NEAR(-15708, (int16_t)readBigEndian(&angles[4], 2), 1);
+
+    // given
+    telemetryData.yaw = 3599;
+
+    // when
+    frameSent();
+    for (int i = 0; i < 3; i++) {
+        handleCrsfTelemetry();
+        if (telemetryBuf[2] == CRSF_FRAMETYPE_ATTITUDE)
+            break;
+        frameSent();
+    }
+
+    // then
+    angles = expectFrame(CRSF_FRAMETYPE_ATTITUDE, CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE);
+    EXPECT_NEAR(-17, (int16_t)readBigEndian(&angles[4], 2), 1);
+}
+
+TEST_F(CrsfTelemetryTest, SkipsGpsWithoutGpsSensor)
+{
+    // given
+    gpsPresent = false;
+
+    for (int i = 0; i < 6; i++) {
+        // when
+        handleCrsfTelemetry();
+
+        // then
+        EXPECT_NE(CRSF_FRAMETYPE_GPS, telemetryBuf[2]);
+        frameSent();
+    }
+}
+
+// STUBS
+
+extern "C" {
+
+telemetryData_t telemetryData;
+
+uint32_t micros(void)
+{
+    return 0;
+}
+
+bool sensors(uint32_t mask)
+{
+    return mask == SENSOR_GPS && gpsPresent;
+}
+
+bool crsfRxIsActive(void)
+{
+    return rxIsActive;
+}
+
+bool crsfRxIsTelemetryBufEmpty(void)
+{
+    return telemetryBufLength == 0;
+}
+
+void crsfRxWriteTelemetryData(const void *data, int length)
+{
+    memcpy(telemetryBuf, data, length);
+    telemetryBufLength = length;
+}
+
+}
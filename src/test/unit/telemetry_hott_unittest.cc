@@ -22,7 +22,7 @@
 #include <limits.h>
 
 extern "C" {
-    #include "debug.h"
+    #include "build/debug.h"
 
     #include "platform.h"
 
@@ -43,7 +43,7 @@ extern "C" {
     #include "flight/pid.h"
     #include "flight/gps_conversion.h"
 
-    #include "config/runtime_config.h"
+    #include "fc/runtime_config.h"
 }
 
 #include "unittest_macros.h"
@@ -134,9 +134,9 @@ TEST(TelemetryHottTest, PrepareGPSMessage_Altitude1m)
     // given
     HOTT_GPS_MSG_t *hottGPSMessage = getGPSMessageForTest();
 
-    stateFlags = GPS_FIX;
+    telemetryData.gpsFix = true;
     uint16_t altitudeInMeters = 1;
-    GPS_altitude = altitudeInMeters * (1 / 0.1f); // 1 = 0.1m
+    telemetryData.gpsAltitude = altitudeInMeters; // m
 
     // when
     hottPrepareGPSResponse(hottGPSMessage);
@@ -158,16 +158,7 @@ uint16_t batteryWarningVoltage;
 uint8_t useHottAlarmSoundPeriod (void) { return 0; }
 
 
-uint8_t GPS_numSat;
-int32_t GPS_coord[2];
-uint16_t GPS_speed;                 // speed in 0.1m/s
-uint16_t GPS_distanceToHome;        // distance to home point in meters
-uint16_t GPS_altitude;              // altitude in 0.1m
-uint16_t vbat;
-int16_t GPS_directionToHome;        // direction to home or hol point in degrees
-
-int32_t amperage;
-int32_t mAhDrawn;
+telemetryData_t telemetryData;
 
 uint32_t fixedMillis = 0;
 
@@ -177,7 +168,7 @@ uint32_t millis(void) {
 
 uint32_t micros(void) { return 0; }
 
-uint8_t serialRxBytesWaiting(serialPort_t *instance) {
+uint32_t serialRxBytesWaiting(serialPort_t *instance) {
     UNUSED(instance);
     return 0;
 }
@@ -237,9 +228,5 @@ portSharing_e determinePortSharing(serialPortConfig_t *, serialPortFunction_e) {
     return PORTSHARING_NOT_SHARED;
 }
 
-batteryState_e getBatteryState(void) {
-	return BATTERY_OK;
-}
-
 }
 
@@ -0,0 +1,603 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/utils.h"
+
+    #include "drivers/sensor.h"
+    #include "drivers/serial.h"
+
+    #include "fc/runtime_config.h"
+
+    #include "io/gps.h"
+    #include "io/serial.h"
+
+    #include "config/config.h"
+
+    #include "sensors/sensors.h"
+
+    #include "telemetry/telemetry.h"
+    #include "telemetry/mavlink.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+/*
+ * A MAVLink v2 decoder written from the protocol description, sharing nothing with the encoder: the checksum is
+ * computed a bit at a time, and each message's CRC_EXTRA is worked out from its definition in common.xml.
+ */
+
+typedef struct mavlinkField_s {
+    const char *type;
+    const char *name;
+} mavlinkField_t;
+
+typedef struct mavlinkMessageDefinition_s {
+    uint32_t id;
+    const char *name;
+    std::vector<mavlinkField_t> fields;     // In wire order
+} mavlinkMessageDefinition_t;
+
+static const mavlinkMessageDefinition_t messageDefinitions[] = {
+    { 0, "HEARTBEAT", {
+        { "uint32_t", "custom_mode" }, { "uint8_t", "type" }, { "uint8_t", "autopilot" }, { "uint8_t", "base_mode" },
+        { "uint8_t", "system_status" }, { "uint8_t", "mavlink_version" } } },
+    { 1, "SYS_STATUS", {
+        { "uint32_t", "onboard_control_sensors_present" }, { "uint32_t", "onboard_control_sensors_enabled" },
+        { "uint32_t", "onboard_control_sensors_health" }, { "uint16_t", "load" }, { "uint16_t", "voltage_battery" },
+        { "int16_t", "current_battery" }, { "uint16_t", "drop_rate_comm" }, { "uint16_t", "errors_comm" },
+        { "uint16_t", "errors_count1" }, { "uint16_t", "errors_count2" }, { "uint16_t", "errors_count3" },
+        { "uint16_t", "errors_count4" }, { "int8_t", "battery_remaining" } } },
+    { 24, "GPS_RAW_INT", {
+        { "uint64_t", "time_usec" }, { "int32_t", "lat" }, { "int32_t", "lon" }, { "int32_t", "alt" },
+        { "uint16_t", "eph" }, { "uint16_t", "epv" }, { "uint16_t", "vel" }, { "uint16_t", "cog" },
+        { "uint8_t", "fix_type" }, { "uint8_t", "satellites_visible" } } },
+    { 30, "ATTITUDE", {
+        { "uint32_t", "time_boot_ms" }, { "float", "roll" }, { "float", "pitch" }, { "float", "yaw" },
+        { "float", "rollspeed" }, { "float", "pitchspeed" }, { "float", "yawspeed" } } },
+    { 33, "GLOBAL_POSITION_INT", {
+        { "uint32_t", "time_boot_ms" }, { "int32_t", "lat" }, { "int32_t", "lon" }, { "int32_t", "alt" },
+        { "int32_t", "relative_alt" }, { "int16_t", "vx" }, { "int16_t", "vy" }, { "int16_t", "vz" },
+        { "uint16_t", "hdg" } } },
+    { 74, "VFR_HUD", {
+        { "float", "airspeed" }, { "float", "groundspeed" }, { "float", "alt" }, { "float", "climb" },
+        { "int16_t", "heading" }, { "uint16_t", "throttle" } } },
+};
+
+static uint16_t referenceCrc(uint16_t crc, const void *data, int length)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (int i = 0; i < length; i++) {
+        crc ^= p[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t referenceCrcString(uint16_t crc, const char *s)
+{
+    return referenceCrc(crc, s, strlen(s));
+}
+
+static int fieldSize(const char *type)
+{
+    if (!strcmp(type, "uint64_t")) return 8;
+    if (!strcmp(type, "uint32_t") || !strcmp(type, "int32_t") || !strcmp(type, "float")) return 4;
+    if (!strcmp(type, "uint16_t") || !strcmp(type, "int16_t")) return 2;
+    return 1;
+}
+
+static const mavlinkMessageDefinition_t *findDefinition(uint32_t id)
+{
+    for (unsigned i = 0; i < ARRAYLEN(messageDefinitions); i++) {
+        if (messageDefinitions[i].id == id) {
+            return &messageDefinitions[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t crcExtra(const mavlinkMessageDefinition_t *definition)
+{
+    uint16_t crc = referenceCrcString(0xFFFF, definition->name);
+    crc = referenceCrcString(crc, " ");
+    for (const mavlinkField_t &field : definition->fields) {
+        crc = referenceCrcString(crc, field.type);
+        crc = referenceCrcString(crc, " ");
+        crc = referenceCrcString(crc, field.name);
+        crc = referenceCrcString(crc, " ");
+    }
+    return (crc & 0xFF) ^ (crc >> 8);
+}
+
+static int payloadLength(const mavlinkMessageDefinition_t *definition)
+{
+    int length = 0;
+    for (const mavlinkField_t &field : definition->fields) {
+        length += fieldSize(field.type);
+    }
+    return length;
+}
+
+typedef struct mavlinkMessage_s {
+    uint32_t id;
+    uint8_t sequence;
+    uint8_t systemId;
+    uint8_t componentId;
+    uint8_t sentLength;             // Before zero extension
+    uint8_t payload[255];
+
+    int64_t field(const char *name) const {
+        const mavlinkMessageDefinition_t *definition = findDefinition(id);
+        int offset = 0;
+        for (const mavlinkField_t &f : definition->fields) {
+            const int size = fieldSize(f.type);
+            if (!strcmp(f.name, name)) {
+                uint64_t value = 0;
+                for (int i = size - 1; i >= 0; i--) {
+                    value = (value << 8) | payload[offset + i];
+                }
+                if (f.type[0] == 'i' && size < 8 && (value & (1ULL << (size * 8 - 1)))) {
+                    value |= ~0ULL << (size * 8);
+                }
+                return (int64_t)value;
+            }
+            offset += size;
+        }
+        ADD_FAILURE() << "no field " << name;
+        return 0;
+    }
+
+    float floatField(const char *name) const {
+        const uint32_t bits = field(name);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+} mavlinkMessage_t;
+
+static std::vector<uint8_t> written;
+static std::vector<mavlinkMessage_t> messages;
+static int rejectedFrames;
+
+// Takes every complete frame out of what's been written
+static void decodeWritten(void)
+{
+    size_t i = 0;
+    while (i < written.size()) {
+        if (written[i] != 0xFD) {
+            i++;
+            continue;
+        }
+        if (i + 10 > written.size()) {
+            break;
+        }
+        const uint8_t length = written[i + 1];
+        if (i + 10 + length + 2 > written.size()) {
+            break;
+        }
+
+        mavlinkMessage_t message;
+        memset(&message, 0, sizeof(message));
+        message.sequence = written[i + 4];
+        message.systemId = written[i + 5];
+        message.componentId = written[i + 6];
+        message.id = written[i + 7] | (written[i + 8] << 8) | (written[i + 9] << 16);
+        message.sentLength = length;
+        memcpy(message.payload, &written[i + 10], length);
+
+        const mavlinkMessageDefinition_t *definition = findDefinition(message.id);
+        uint16_t crc = referenceCrc(0xFFFF, &written[i + 1], 9 + length);
+        if (definition) {
+            const uint8_t extra = crcExtra(definition);
+            crc = referenceCrc(crc, &extra, 1);
+        }
+        const uint16_t sentCrc = written[i + 10 + length] | (written[i + 11 + length] << 8);
+
+        if (!definition || crc != sentCrc || written[i + 2] != 0 || length == 0 || length > payloadLength(definition)) {
+            rejectedFrames++;
+            i++;
+            continue;
+        }
+
+        messages.push_back(message);
+        i += 10 + length + 2;
+    }
+    written.erase(written.begin(), written.begin() + i);
+}
+
+static int countMessages(uint32_t id)
+{
+    int count = 0;
+    for (const mavlinkMessage_t &message : messages) {
+        if (message.id == id) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static const mavlinkMessage_t *lastMessage(uint32_t id)
+{
+    for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
+        if (it->id == id) {
+            return &*it;
+        }
+    }
+    return NULL;
+}
+
+#define MAVLINK_MSG_ID_HEARTBEAT            0
+#define MAVLINK_MSG_ID_SYS_STATUS           1
+#define MAVLINK_MSG_ID_GPS_RAW_INT          24
+#define MAVLINK_MSG_ID_ATTITUDE             30
+#define MAVLINK_MSG_ID_GLOBAL_POSITION_INT  33
+#define MAVLINK_MSG_ID_VFR_HUD              74
+
+// The telemetry task runs at 250Hz
+#define TEST_CALL_INTERVAL_MS   4
+
+// Long enough for every group to have gone once, as not all fit in one call
+#define TEST_ROUND_MS          100
+
+static uint8_t txBytesFree;
+static bool gpsPresent;
+static uint32_t enabledFeatures;
+
+static void runFor(uint32_t milliseconds)
+{
+    const uint32_t end = telemetryData.capturedAt + milliseconds;
+    while (telemetryData.capturedAt < end) {
+        telemetryData.capturedAt += TEST_CALL_INTERVAL_MS;
+        handleMavlinkTelemetry();
+    }
+    decodeWritten();
+}
+
+class MavlinkTelemetryTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        written.clear();
+        messages.clear();
+        rejectedFrames = 0;
+        txBytesFree = 255;
+        gpsPresent = true;
+        enabledFeatures = FEATURE_VBAT | FEATURE_CURRENT_METER;
+        armingFlags = 0;
+        flightModeFlags = 0;
+        stateFlags = 0;
+
+        memset(&telemetryData, 0, sizeof(telemetryData));
+        telemetryData.capturedAt = 10000;
+
+        initMavlinkTelemetry(NULL);
+        checkMavlinkTelemetryState();
+    }
+};
+
+TEST_F(MavlinkTelemetryTest, SendsFramesReferenceDecoderAccepts)
+{
+    // when
+    runFor(2000);
+
+    // then
+    EXPECT_EQ(0, rejectedFrames);
+    EXPECT_EQ(0U, written.size());
+    ASSERT_FALSE(messages.empty());
+
+    for (const mavlinkMessage_t &message : messages) {
+        EXPECT_EQ(1, message.systemId);
+        EXPECT_EQ(1, message.componentId);
+    }
+}
+
+TEST_F(MavlinkTelemetryTest, NumbersFramesInSequence)
+{
+    // when
+    runFor(2000);
+
+    // then
+    ASSERT_GT(messages.size(), 1U);
+    for (size_t i = 1; i < messages.size(); i++) {
+        EXPECT_EQ((uint8_t)(messages[i - 1].sequence + 1), messages[i].sequence);
+    }
+}
+
+TEST_F(MavlinkTelemetryTest, SendsEachGroupAtItsRate)
+{
+    // given that the first round has gone
+    runFor(TEST_CALL_INTERVAL_MS);
+    messages.clear();
+
+    // when
+    runFor(10000);
+
+    // then
+    EXPECT_NEAR(100, countMessages(MAVLINK_MSG_ID_ATTITUDE), 1);
+    EXPECT_NEAR(50, countMessages(MAVLINK_MSG_ID_VFR_HUD), 1);
+    EXPECT_NEAR(20, countMessages(MAVLINK_MSG_ID_SYS_STATUS), 1);
+    EXPECT_NEAR(20, countMessages(MAVLINK_MSG_ID_GPS_RAW_INT), 1);
+    EXPECT_NEAR(20, countMessages(MAVLINK_MSG_ID_GLOBAL_POSITION_INT), 1);
+    EXPECT_NEAR(10, countMessages(MAVLINK_MSG_ID_HEARTBEAT), 1);
+}
+
+TEST_F(MavlinkTelemetryTest, LeavesOutGpsWithoutGps)
+{
+    // given
+    gpsPresent = false;
+
+    // when
+    runFor(2000);
+
+    // then
+    EXPECT_EQ(0, countMessages(MAVLINK_MSG_ID_GPS_RAW_INT));
+    EXPECT_EQ(0, countMessages(MAVLINK_MSG_ID_GLOBAL_POSITION_INT));
+    EXPECT_GT(countMessages(MAVLINK_MSG_ID_ATTITUDE), 0);
+}
+
+TEST_F(MavlinkTelemetryTest, WaitsForRoomInTxBuffer)
+{
+    // given room for less than the smallest frame
+    txBytesFree = 20;
+
+    // when
+    runFor(1000);
+
+    // then
+    EXPECT_TRUE(messages.empty());
+
+    // when
+    txBytesFree = 255;
+    runFor(TEST_CALL_INTERVAL_MS);
+
+    // then what's waiting goes, most overdue first, but no more than fits in one call
+    EXPECT_GT(messages.size(), 0U);
+    size_t bytes = 0;
+    for (const mavlinkMessage_t &message : messages) {
+        bytes += 10 + message.sentLength + 2;
+    }
+    EXPECT_LE(bytes, 128U);
+}
+
+TEST_F(MavlinkTelemetryTest, ReportsHeartbeat)
+{
+    // given
+    ENABLE_ARMING_FLAG(ARMED);
+    flightModeFlags |= ANGLE_MODE;
+
+    // when
+    runFor(TEST_CALL_INTERVAL_MS);
+
+    // then
+    const mavlinkMessage_t *heartbeat = lastMessage(MAVLINK_MSG_ID_HEARTBEAT);
+    ASSERT_TRUE(heartbeat != NULL);
+    EXPECT_EQ(2, heartbeat->field("type"));                     // MAV_TYPE_QUADROTOR
+    EXPECT_EQ(0x80 | 0x40 | 0x10 | 0x01, heartbeat->field("base_mode"));
+    EXPECT_EQ(4, heartbeat->field("system_status"));            // MAV_STATE_ACTIVE
+    EXPECT_EQ(3, heartbeat->field("mavlink_version"));
+}
+
+TEST_F(MavlinkTelemetryTest, ReportsBattery)
+{
+    // given
+    telemetryData.vbat = 168;
+    telemetryData.amperage = 1234;
+    telemetryData.batteryRemainingPercentage = 75;
+
+    // when
+    runFor(TEST_ROUND_MS);
+
+    // then
+    const mavlinkMessage_t *status = lastMessage(MAVLINK_MSG_ID_SYS_STATUS);
+    ASSERT_TRUE(status != NULL);
+    EXPECT_EQ(16800, status->field("voltage_battery"));
+    EXPECT_EQ(1234, status->field("current_battery"));
+    EXPECT_EQ(75, status->field("battery_remaining"));
+}
+
+TEST_F(MavlinkTelemetryTest, ReportsUnknownBatteryWithoutSensing)
+{
+    // given
+    enabledFeatures = 0;
+
+    // when
+    runFor(TEST_ROUND_MS);
+
+    // then
+    const mavlinkMessage_t *status = lastMessage(MAVLINK_MSG_ID_SYS_STATUS);
+    ASSERT_TRUE(status != NULL);
+    EXPECT_EQ(UINT16_MAX, status->field("voltage_battery"));
+    EXPECT_EQ(-1, status->field("current_battery"));
+    EXPECT_EQ(-1, status->field("battery_remaining"));
+}
+
+TEST_F(MavlinkTelemetryTest, ReportsAttitudeWithTrailingZerosLeftOff)
+{
+    // given
+    telemetryData.roll = 450;
+    telemetryData.pitch = -100;
+    telemetryData.yaw = 2700;
+
+    // when
+    runFor(TEST_CALL_INTERVAL_MS);
+
+    // then the angular rates, which aren't sent, don't take up room
+    const mavlinkMessage_t *attitude = lastMessage(MAVLINK_MSG_ID_ATTITUDE);
+    ASSERT_TRUE(attitude != NULL);
+    EXPECT_EQ(16, attitude->sentLength);
+    EXPECT_EQ(telemetryData.capturedAt, attitude->field("time_boot_ms"));
+    EXPECT_NEAR(0.7854f, attitude->floatField("roll"), 0.0001f);
+    EXPECT_NEAR(0.1745f, attitude->floatField("pitch"), 0.0001f);
+    EXPECT_NEAR(-1.5708f, attitude->floatField("yaw"), 0.0001f);
+    EXPECT_EQ(0.0f, attitude->floatField("yawspeed"));
+}
+
+TEST_F(MavlinkTelemetryTest, KeepsOneByteOfEmptyPayload)
+{
+    // given nothing to report and the time not yet counting
+    telemetryData.capturedAt = 0;
+    runFor(TEST_CALL_INTERVAL_MS);
+    messages.clear();
+    telemetryData.capturedAt = 0;
+
+    // when
+    runFor(100);
+
+    // then
+    for (const mavlinkMessage_t &message : messages) {
+        EXPECT_GE(message.sentLength, 1);
+    }
+}
+
+TEST_F(MavlinkTelemetryTest, ReportsPosition)
+{
+    // given
+    ENABLE_STATE(GPS_FIX);
+    telemetryData.gpsFix = true;
+    telemetryData.gpsCoord[LAT] = 473977420;
+    telemetryData.gpsCoord[LON] = -1223890570;
+    telemetryData.gpsAltitude = 120;
+    telemetryData.gpsSpeed = 1000;
+    telemetryData.gpsGroundCourse = 2705;
+    telemetryData.gpsHdop = 90;
+    telemetryData.gpsNumSat = 11;
+    telemetryData.estimatedAltitude = 2500;
+    telemetryData.vario = 150;
+    telemetryData.yaw = 900;
+
+    // when
+    runFor(TEST_ROUND_MS);
+
+    // then
+    const mavlinkMessage_t *raw = lastMessage(MAVLINK_MSG_ID_GPS_RAW_INT);
+    ASSERT_TRUE(raw != NULL);
+    EXPECT_EQ(473977420, raw->field("lat"));
+    EXPECT_EQ(-1223890570, raw->field("lon"));
+    EXPECT_EQ(120000, raw->field("alt"));
+    EXPECT_EQ(90, raw->field("eph"));
+    EXPECT_EQ(1000, raw->field("vel"));
+    EXPECT_EQ(27050, raw->field("cog"));
+    EXPECT_EQ(3, raw->field("fix_type"));
+    EXPECT_EQ(11, raw->field("satellites_visible"));
+
+    const mavlinkMessage_t *position = lastMessage(MAVLINK_MSG_ID_GLOBAL_POSITION_INT);
+    ASSERT_TRUE(position != NULL);
+    EXPECT_EQ(473977420, position->field("lat"));
+    EXPECT_EQ(25000, position->field("relative_alt"));
+    EXPECT_EQ(-150, position->field("vz"));
+    EXPECT_EQ(9000, position->field("hdg"));
+}
+
+// STUBS
+
+extern "C" {
+
+uint8_t armingFlags;
+uint16_t flightModeFlags;
+uint8_t stateFlags;
+
+uint16_t averageSystemLoadPercent;
+
+telemetryData_t telemetryData;
+
+const uint32_t baudRates[] = {0, 9600, 19200, 38400, 57600, 115200, 230400, 250000};
+
+static serialPort_t mavlinkTestPort;
+static serialPortConfig_t mavlinkTestPortConfig;
+
+uint32_t micros(void)
+{
+    return 0;
+}
+
+bool feature(uint32_t mask)
+{
+    return enabledFeatures & mask;
+}
+
+bool sensors(uint32_t mask)
+{
+    return mask == SENSOR_GPS && gpsPresent;
+}
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+
+    return &mavlinkTestPortConfig;
+}
+
+portSharing_e determinePortSharing(serialPortConfig_t *portConfig, serialPortFunction_e function)
+{
+    UNUSED(portConfig);
+    UNUSED(function);
+
+    return PORTSHARING_NOT_SHARED;
+}
+
+bool telemetryDetermineEnabledState(portSharing_e portSharing)
+{
+    UNUSED(portSharing);
+
+    return true;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+    UNUSED(callback);
+    UNUSED(baudRate);
+    UNUSED(mode);
+    UNUSED(options);
+
+    return &mavlinkTestPort;
+}
+
+void closeSerialPort(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+uint8_t serialTxBytesFree(serialPort_t *instance)
+{
+    UNUSED(instance);
+
+    return txBytesFree;
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+
+    written.insert(written.end(), data, data + count);
+}
+
+}
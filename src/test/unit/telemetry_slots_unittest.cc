@@ -0,0 +1,259 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "telemetry/telemetry_slots.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_SLOT_COUNT 4
+
+static uint32_t nowMicros;
+// How long each telemetrySlotsNext() takes, as far as micros() is concerned
+static uint32_t microsPerNext;
+
+static telemetrySlot_t slots[TEST_SLOT_COUNT];
+static telemetrySlotScheduler_t scheduler;
+
+class TelemetrySlotsTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        nowMicros = 0;
+        microsPerNext = 0;
+
+        memset(slots, 0, sizeof(slots));
+        for (int i = 0; i < TEST_SLOT_COUNT; i++) {
+            slots[i].intervalMs = 100;
+            slots[i].priority = 1;
+            slots[i].maxBytes = 10;
+            slots[i].available = true;
+        }
+
+        telemetrySlotsInit(&scheduler, slots, TEST_SLOT_COUNT, 64, 500);
+    }
+
+    int next() {
+        const int slot = telemetrySlotsNext(&scheduler);
+        nowMicros += microsPerNext;
+        return slot;
+    }
+
+    // Sends whatever the scheduler picks until it says to stop, and returns how many went
+    int sendAll() {
+        int count = 0;
+        int slot;
+        while ((slot = next()) != TELEMETRY_SLOT_NONE) {
+            telemetrySlotsSent(&scheduler, slot);
+            count++;
+        }
+        return count;
+    }
+};
+
+TEST_F(TelemetrySlotsTest, SendsNothingBeforeItIsDue)
+{
+    // when
+    telemetrySlotsBeginCall(&scheduler, 99, 255);
+
+    // then
+    EXPECT_EQ(TELEMETRY_SLOT_NONE, next());
+}
+
+TEST_F(TelemetrySlotsTest, SendsEachSlotOnceWhenDue)
+{
+    // given
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+    EXPECT_EQ(TEST_SLOT_COUNT, sendAll());
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1050, 255);
+
+    // then
+    EXPECT_EQ(0, sendAll());
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1100, 255);
+
+    // then
+    EXPECT_EQ(TEST_SLOT_COUNT, sendAll());
+}
+
+TEST_F(TelemetrySlotsTest, MostOverdueGoesFirst)
+{
+    // given
+    slots[0].lastSentAt = 900;
+    slots[1].lastSentAt = 700;
+    slots[2].lastSentAt = 800;
+    slots[3].lastSentAt = 950;
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+
+    // then
+    EXPECT_EQ(1, next());
+    telemetrySlotsSent(&scheduler, 1);
+    EXPECT_EQ(2, next());
+    telemetrySlotsSent(&scheduler, 2);
+    EXPECT_EQ(0, next());
+    telemetrySlotsSent(&scheduler, 0);
+    EXPECT_EQ(TELEMETRY_SLOT_NONE, next());
+}
+
+TEST_F(TelemetrySlotsTest, PriorityWeighsHowLongSlotIsOverdue)
+{
+    // given slot 3 overdue by half as long as slot 0, but three times as important
+    slots[0].lastSentAt = 0;
+    slots[1].available = slots[2].available = false;
+    slots[3].lastSentAt = 50;
+    slots[3].priority = 3;
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 200, 255);
+
+    // then
+    EXPECT_EQ(3, next());
+}
+
+TEST_F(TelemetrySlotsTest, SkipsUnavailableSlots)
+{
+    // given
+    slots[1].available = false;
+    slots[3].available = false;
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+
+    // then
+    EXPECT_EQ(2, sendAll());
+    EXPECT_EQ(0U, slots[1].lastSentAt);
+    EXPECT_EQ(0U, slots[3].lastSentAt);
+}
+
+TEST_F(TelemetrySlotsTest, StopsWhenNextSlotDoesNotFit)
+{
+    // given the most overdue slot is too big to go after the first
+    slots[0].lastSentAt = 100;
+    slots[1].lastSentAt = 200;
+    slots[1].maxBytes = 40;
+    slots[2].lastSentAt = 300;
+    slots[3].lastSentAt = 300;
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+    scheduler.bytesLeft = 45;
+
+    // then it waits for the next call rather than letting smaller slots go ahead of it
+    EXPECT_EQ(1, sendAll());
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1010, 255);
+
+    // then
+    EXPECT_EQ(1, next());
+}
+
+TEST_F(TelemetrySlotsTest, SendsNoMoreThanThePortHasRoomFor)
+{
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 25);
+
+    // then
+    EXPECT_EQ(2, sendAll());
+}
+
+TEST_F(TelemetrySlotsTest, SendsNoMoreThanAllowedPerCall)
+{
+    // given
+    for (int i = 0; i < TEST_SLOT_COUNT; i++) {
+        slots[i].maxBytes = 30;
+    }
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+
+    // then
+    EXPECT_EQ(2, sendAll());
+}
+
+TEST_F(TelemetrySlotsTest, StopsWhenTimeIsUp)
+{
+    // given
+    microsPerNext = 200;
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 1000, 255);
+
+    // then
+    EXPECT_EQ(3, sendAll());
+}
+
+TEST_F(TelemetrySlotsTest, EquallyOverdueSlotsTakeTurns)
+{
+    // given slots to be sent as often as there's room
+    for (int i = 0; i < TEST_SLOT_COUNT; i++) {
+        slots[i].intervalMs = 0;
+    }
+    slots[2].available = false;
+
+    const int expected[] = { 0, 1, 3, 0, 1, 3 };
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        // when
+        telemetrySlotsBeginCall(&scheduler, 1000, 255);
+        const int slot = next();
+
+        // then
+        EXPECT_EQ(expected[i], slot);
+        telemetrySlotsSent(&scheduler, slot);
+    }
+}
+
+TEST_F(TelemetrySlotsTest, SurvivesClockWrapping)
+{
+    // given
+    telemetrySlotsBeginCall(&scheduler, UINT32_MAX - 49, 255);
+    EXPECT_EQ(TEST_SLOT_COUNT, sendAll());
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 49, 255);
+
+    // then
+    EXPECT_EQ(TELEMETRY_SLOT_NONE, next());
+
+    // when
+    telemetrySlotsBeginCall(&scheduler, 50, 255);
+
+    // then
+    EXPECT_EQ(TEST_SLOT_COUNT, sendAll());
+}
+
+// STUBS
+
+extern "C" {
+
+uint32_t micros(void)
+{
+    return nowMicros;
+}
+
+}
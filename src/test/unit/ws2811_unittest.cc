@@ -16,11 +16,12 @@
  */
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <limits.h>
 
 extern "C" {
-    #include "build_config.h"
+    #include "build/build_config.h"
 
     #include "common/color.h"
 
@@ -30,6 +31,9 @@ extern "C" {
 #include "unittest_macros.h"
 #include "gtest/gtest.h"
 
+static int hsvConversions;
+static int dmaTransfers;
+
 extern "C" {
 STATIC_UNIT_TESTED extern uint16_t dmaBufferOffset;
 
@@ -90,12 +94,201 @@ TEST(WS2812, updateDMABuffer) {
     byteIndex++;
 }
 
+// The bits the DMA buffer holds for an LED, one compare value per bit, green first
+static void expectLedInDMABuffer(uint16_t ledIndex, uint8_t r, uint8_t g, uint8_t b)
+{
+    uint32_t grb = (g << 16) | (r << 8) | b;
+    const uint8_t *bits = &ledStripDMABuffer[ledIndex * WS2811_BITS_PER_LED];
+
+    for (int bit = 0; bit < WS2811_BITS_PER_LED; bit++) {
+        EXPECT_EQ((grb & (1 << (23 - bit))) ? BIT_COMPARE_1 : BIT_COMPARE_0, bits[bit]) << "led " << ledIndex << " bit " << bit;
+    }
+}
+
+class WS2812StripTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        ws2811LedStripInit();
+        ws2811LedDataTransferInProgress = 0;
+
+        hsvConversions = 0;
+        dmaTransfers = 0;
+    }
+};
+
+TEST_F(WS2812StripTest, InitSendsBlackStrip)
+{
+    // then
+    for (int i = 0; i < WS2811_LED_STRIP_LENGTH; i++) {
+        expectLedInDMABuffer(i, 0, 0, 0);
+    }
+    for (int i = WS2811_DATA_BUFFER_SIZE; i < WS2811_DMA_BUFFER_SIZE; i++) {
+        EXPECT_EQ(0, ledStripDMABuffer[i]);
+    }
+}
+
+TEST_F(WS2812StripTest, UnchangedFrameIsNotSent)
+{
+    // given
+    hsvColor_t color = { 120, 0, 255 };
+    setLedHsv(3, &color);
+    ws2811UpdateStrip();
+    ws2811LedDataTransferInProgress = 0;
+    hsvConversions = dmaTransfers = 0;
+
+    // when
+    setLedHsv(3, &color);
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(0, hsvConversions);
+    EXPECT_EQ(0, dmaTransfers);
+    EXPECT_TRUE(isWS2811LedStripReady());
+}
+
+TEST_F(WS2812StripTest, OnlyChangedLedIsConverted)
+{
+    // given
+    uint8_t before[WS2811_DMA_BUFFER_SIZE];
+    memcpy(before, ledStripDMABuffer, sizeof(before));
+
+    // when
+    hsvColor_t color = { 10, 20, 30 };
+    setLedHsv(5, &color);
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(1, hsvConversions);
+    EXPECT_EQ(1, dmaTransfers);
+    expectLedInDMABuffer(5, 10, 20, 30);
+
+    // and the rest of the buffer is untouched
+    for (int i = 0; i < WS2811_DMA_BUFFER_SIZE; i++) {
+        if (i / WS2811_BITS_PER_LED != 5) {
+            EXPECT_EQ(before[i], ledStripDMABuffer[i]) << "byte " << i;
+        }
+    }
+}
+
+TEST_F(WS2812StripTest, ValueChangesMarkLedDirty)
+{
+    // given
+    hsvColor_t color = { 10, 20, 200 };
+    setLedHsv(0, &color);
+    setLedHsv(31, &color);
+    ws2811UpdateStrip();
+    ws2811LedDataTransferInProgress = 0;
+
+    // when
+    setLedValue(0, 100);
+    scaleLedValue(31, 50);
+    ws2811UpdateStrip();
+
+    // then
+    expectLedInDMABuffer(0, 10, 20, 100);
+    expectLedInDMABuffer(31, 10, 20, 100);
+    EXPECT_EQ(2, dmaTransfers);
+}
+
+TEST_F(WS2812StripTest, ColorChangedAndRestoredIsNotSent)
+{
+    // given a layer which overwrites an LED, and one which puts it back, as happens when the layers are reapplied
+    hsvColor_t black = { 0, 0, 0 };
+    hsvColor_t color = { 10, 20, 30 };
+
+    // when
+    setLedHsv(7, &color);
+    setLedHsv(7, &black);
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(0, dmaTransfers);
+    expectLedInDMABuffer(7, 0, 0, 0);
+}
+
+TEST_F(WS2812StripTest, ChangeDuringTransferIsSentNextTime)
+{
+    // given
+    ws2811LedDataTransferInProgress = 1;
+
+    // when
+    hsvColor_t color = { 10, 20, 30 };
+    setLedHsv(2, &color);
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(0, dmaTransfers);
+
+    // when
+    ws2811LedDataTransferInProgress = 0;
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(1, dmaTransfers);
+    expectLedInDMABuffer(2, 10, 20, 30);
+}
+
+TEST_F(WS2812StripTest, ResendSendsUnchangedStrip)
+{
+    // given a strip that has been sent and not changed since
+    hsvColor_t color = { 10, 20, 30 };
+    setLedHsv(4, &color);
+    ws2811UpdateStrip();
+    ws2811LedDataTransferInProgress = 0;
+    hsvConversions = dmaTransfers = 0;
+
+    // when
+    ws2811ResendStrip();
+    ws2811UpdateStrip();
+
+    // then the buffer is sent again as it was, without converting anything
+    EXPECT_EQ(1, dmaTransfers);
+    EXPECT_EQ(0, hsvConversions);
+    expectLedInDMABuffer(4, 10, 20, 30);
+
+    // and only once
+    ws2811LedDataTransferInProgress = 0;
+    ws2811UpdateStrip();
+    EXPECT_EQ(1, dmaTransfers);
+}
+
+TEST_F(WS2812StripTest, ResendDuringTransferIsSentNextTime)
+{
+    // given
+    ws2811LedDataTransferInProgress = 1;
+
+    // when
+    ws2811ResendStrip();
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(0, dmaTransfers);
+
+    // when
+    ws2811LedDataTransferInProgress = 0;
+    ws2811UpdateStrip();
+
+    // then
+    EXPECT_EQ(1, dmaTransfers);
+}
+
+// STUBS
+
 extern "C" {
+// Not a real conversion, just one that's easy to check: hue, saturation and value become red, green and blue
 rgbColor24bpp_t* hsvToRgb24(const hsvColor_t *c) {
-    UNUSED(c);
-    return NULL;
+    static rgbColor24bpp_t r;
+
+    hsvConversions++;
+    r.rgb.r = c->h;
+    r.rgb.g = c->s;
+    r.rgb.b = c->v;
+    return &r;
 }
 
 void ws2811LedStripHardwareInit(void) {}
-void ws2811LedStripDMAEnable(void) {}
+void ws2811LedStripDMAEnable(void)
+{
+    dmaTransfers++;
+}
 }